@@ -173,8 +173,9 @@ int MySQLConnector::createNewIndexes() {
     int indexedRecordsCount = 0;
     int totalRecordsCount = 0;
 
-    Json::Value record;
-    Json::FastWriter writer;
+    //The records are inserted in batches.
+    const unsigned batchSize = 1000;
+    std::vector<RecordFields> records;
 
     while (1) {
         try {
@@ -182,25 +183,29 @@ int MySQLConnector::createNewIndexes() {
                     "SELECT * FROM " + tableName);
 
             //Iterate all the selected records.
-            while (res->next()) {
-                //Iterate the fields of one record.
-                for (vector<string>::iterator it = fieldNames.begin();
-                        it != fieldNames.end(); ++it) {
-                    record[*it] = res->getString(*it).c_str();
-                }
-
-                std::string jsonString = writer.write(record);
-
-                totalRecordsCount++;
-                if (serverInterface->insertRecord(jsonString) == 0) {
-                    indexedRecordsCount++;
+            bool hasNext = true;
+            while (hasNext) {
+                hasNext = res->next();
+                if (hasNext) {
+                    //Iterate the fields of one record.
+                    records.push_back(RecordFields());
+                    for (vector<string>::iterator it = fieldNames.begin();
+                            it != fieldNames.end(); ++it) {
+                        records.back().push_back(std::make_pair(*it,
+                                std::string(res->getString(*it).c_str())));
+                    }
+                    totalRecordsCount++;
                 }
 
-                if (indexedRecordsCount && (indexedRecordsCount % 1000) == 0)
+                if (records.size() == batchSize
+                        || (!hasNext && !records.empty())) {
+                    indexedRecordsCount += records.size()
+                            - serverInterface->insertRecords(records);
+                    records.clear();
                     Logger::info(
                             "MYSQLCONNECTOR: Indexed %d records so far ...",
                             indexedRecordsCount);
-
+                }
             }
             Logger::info("MYSQLCONNECTOR: Total indexed %d / %d records. ",
                     indexedRecordsCount, totalRecordsCount);
@@ -209,6 +214,7 @@ int MySQLConnector::createNewIndexes() {
             Logger::error(
                     "MYSQLCONNECTOR: SQL error %d while creating new indexes : %s",
                     e.getErrorCode(), e.getSQLState().c_str());
+            records.clear();
             sleep(listenerWaitTime);
         }
     }
@@ -37,10 +37,12 @@
 #include "json/json.h"
 #include "Logger.h"
 #include <cstring>
+#include <climits>
 #include <iostream>
 #include <fstream>
 #include <unistd.h>
 #include "io.h"
+#include "ChangeWaiter.h"
 
 namespace {
 #ifdef ANDROID
@@ -65,6 +67,7 @@ SQLiteConnector::SQLiteConnector() {
     selectStmt = NULL;
     deleteLogStmt = NULL;
     lastAccessedLogRecordTimeStr = DEFAULT_STRING_VALUE;
+    lastAccessedLogRecordRowId = 0;
 }
 
 //Initialize the connector. Establish a connection to Sqlite.
@@ -140,6 +143,10 @@ bool SQLiteConnector::connectToDB() {
         std::string path = srch2Home + "/" + db_path + "/" + db_name;
         rc = sqlite3_open(path.c_str(), &db);
         if (rc == 0) {
+            dbFilePath = path;
+            //The listener reads right after the database is written, wait
+            //for the lock of the writer instead of failing with SQLITE_BUSY.
+            sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
             return true;
         }
 
@@ -227,6 +234,7 @@ int SQLiteConnector::createNewIndexes() {
         int rc = sqlite3_exec(db, sql.str().c_str(), addRecord_callback,
                 (void *) this, &zErrMsg);\
         if (rc == SQLITE_OK) {
+            insertRecordsOfBatch();
             Logger::info("SQLITECONNECTOR: Total indexed %d / %d records. ",
                     indexedRecordsCount, totalRecordsCount);
 
@@ -239,6 +247,7 @@ int SQLiteConnector::createNewIndexes() {
 
         Logger::error("SQLITECONNECTOR: SQL error %d : %s", rc, zErrMsg);
         sqlite3_free(zErrMsg);
+        recordsOfBatch.clear();
 
         Logger::debug("SQLITECONNECTOR: trying again ...");
         sleep(listenerWaitTime);
@@ -247,35 +256,49 @@ int SQLiteConnector::createNewIndexes() {
     return -1;
 }
 
+/*
+ * Insert the rows collected by "addRecord_callback" into the SRCH2 engine
+ * in one batch.
+ */
+void SQLiteConnector::insertRecordsOfBatch() {
+    if (recordsOfBatch.empty()) {
+        return;
+    }
+    indexedRecordsCount += recordsOfBatch.size()
+            - serverInterface->insertRecords(recordsOfBatch);
+    recordsOfBatch.clear();
+    Logger::info("SQLITECONNECTOR: Indexed %d records so far ...",
+            indexedRecordsCount);
+}
+
 /*
  * The callback function of createIndex. Each row of the table will call
- * this function once and do the insertion by the server handler.
+ * this function once. The rows are inserted by the server handler in
+ * batches of BATCH_SIZE rows.
  */
 int addRecord_callback(void *dbConnector, int argc, char **argv,
         char **azColName) {
     totalRecordsCount++;
     SQLiteConnector * sqliteConnector = (SQLiteConnector *) dbConnector;
 
-    Json::Value record;
-    Json::FastWriter writer;
-
+    sqliteConnector->recordsOfBatch.push_back(RecordFields());
+    RecordFields &record = sqliteConnector->recordsOfBatch.back();
     for (int i = 0; i < argc; i++) {
-        record[azColName[i]] = argv[i] ? argv[i] : "NULL";
-    }
-    std::string jsonString = writer.write(record);
-    if (sqliteConnector->serverInterface->insertRecord(jsonString) == 0) {
-        indexedRecordsCount++;
+        record.push_back(std::make_pair(std::string(azColName[i]),
+                std::string(argv[i] ? argv[i] : "NULL")));
     }
 
-    if (indexedRecordsCount && (indexedRecordsCount % 1000) == 0)
-        Logger::info("SQLITECONNECTOR: Indexed %d records so far ...",
-                indexedRecordsCount);
+    if (sqliteConnector->recordsOfBatch.size()
+            >= SQLiteConnector::BATCH_SIZE) {
+        sqliteConnector->insertRecordsOfBatch();
+    }
     return 0;
 }
 
 /*
- * Periodically check updates in the Sqlite log table, and send
- * corresponding requests to the SRCH2 engine
+ * Check updates in the Sqlite log table, and send corresponding requests to
+ * the SRCH2 engine. The listener polls the log table again as soon as the
+ * database file is written, and backs off while it is idle (see ChangeWaiter).
  */
 int SQLiteConnector::runListener() {
     std::string tableName = DEFAULT_STRING_VALUE;
@@ -285,8 +308,16 @@ int SQLiteConnector::runListener() {
     //accessed the log table to retrieve the change history
     loadLastAccessedLogRecordTime();
 
+    ChangeWaiter changeWaiter(listenerWaitTime);
+    if (!changeWaiter.watchFile(dbFilePath)) {
+        Logger::warn("SQLITECONNECTOR: Can not watch the database file %s,"
+                " the log table is polled.", dbFilePath.c_str());
+    }
+
     Json::Value record;
     Json::FastWriter writer;
+    //The consecutive insertions of a poll, inserted in one batch.
+    std::vector<RecordFields> insertedRecords;
 
     Logger::info("SQLITECONNECTOR: waiting for updates ...");
     bool fatal_error = false;
@@ -298,10 +329,16 @@ int SQLiteConnector::runListener() {
          */
         while (1) {
             logRecordTimeChangedFlag = false;
+            unsigned numberOfChanges = 0;
+            time_t timeOfNewestChange = 0;
 
             int rc = sqlite3_bind_text(selectStmt, 1,
                     lastAccessedLogRecordTimeStr.c_str(),
-                    lastAccessedLogRecordTimeStr.size(), SQLITE_STATIC);
+                    lastAccessedLogRecordTimeStr.size(), SQLITE_TRANSIENT);
+            if (rc == SQLITE_OK) {
+                rc = sqlite3_bind_int64(selectStmt, 2,
+                        lastAccessedLogRecordRowId);
+            }
             if (rc != SQLITE_OK) {
                 Logger::error("SQLITECONNECTOR: SQL error %d : %s", rc,
                         sqlite3_errmsg(db));
@@ -318,28 +355,37 @@ int SQLiteConnector::runListener() {
                 res = sqlite3_step(selectStmt);
                 if (res == SQLITE_ROW) {
                     /*
-                     * Get old id, operation and time stamp of the log record.
-                     * The order is same with the order when we create the log table
+                     * Get row id, old id, operation and time stamp of the log
+                     * record. The order is same with the order when we create
+                     * the log table, after the row id of the select statement
+                     * 0 -> row id
                      * 1 -> old id
                      * 2 -> time stamp
                      * 3 -> operation
                      */
+                    lastAccessedLogRecordRowId = sqlite3_column_int64(
+                            selectStmt, 0);
                     std::string oldId = (char*) sqlite3_column_text(selectStmt,
-                            0);
+                            1);
                     lastAccessedLogRecordTimeStr = (char*) sqlite3_column_text(
-                            selectStmt, 1);
+                            selectStmt, 2);
                     logRecordTimeChangedFlag = true;
-                    char* op = (char*) sqlite3_column_text(selectStmt, 2);
+                    ++numberOfChanges;
+                    // the records come in the order of their time stamps
+                    timeOfNewestChange = strtol(
+                            lastAccessedLogRecordTimeStr.c_str(), NULL, 10);
+                    char* op = (char*) sqlite3_column_text(selectStmt, 3);
 
                     //For loop of the attributes of one record.
-                    //Create a Json format string for each record.
                     std::map<std::string, std::string>::iterator it =
                             tableSchema.begin();
-                    int i = 3;
-                    for (i = 3; i < ctotal && it != tableSchema.end();
+                    RecordFields fields;
+                    int i = 4;
+                    for (i = 4; i < ctotal && it != tableSchema.end();
                             i++, it++) {
                         char * val = (char*) sqlite3_column_text(selectStmt, i);
-                        record[it->first.c_str()] = val ? val : "NULL";
+                        fields.push_back(std::make_pair(it->first,
+                                std::string(val ? val : "NULL")));
                     }
 
                     /*
@@ -359,23 +405,34 @@ int SQLiteConnector::runListener() {
                     }
 
                     /*
-                     * Generate the Json format string and call the
-                     * corresponding operation based on the "op" field.
+                     * Call the corresponding operation based on the "op" field.
+                     * The insertions are kept until the next deletion or
+                     * update, or the end of the poll, and inserted in one batch.
                      *
                      * 'i' -> Insertion
                      * 'd' -> Deletion
                      * 'u' -> Update
                      */
-                    std::string jsonString = writer.write(record);
-
-                    Logger::debug("SQLITECONNECTOR: Processing %s ",
-                            jsonString.c_str());
+                    Logger::debug("SQLITECONNECTOR: Processing %s %s ", op,
+                            oldId.c_str());
                     if (strcmp(op, "i") == 0) {
-                        serverInterface->insertRecord(jsonString);
-                    } else if (strcmp(op, "d") == 0) {
+                        insertedRecords.push_back(fields);
+                        continue;
+                    }
+                    if (!insertedRecords.empty()) {
+                        serverInterface->insertRecords(insertedRecords);
+                        insertedRecords.clear();
+                    }
+                    if (strcmp(op, "d") == 0) {
                         serverInterface->deleteRecord(oldId);
                     } else if (strcmp(op, "u") == 0) {
-                        serverInterface->updateRecord(oldId, jsonString);
+                        record.clear();
+                        for (RecordFields::iterator field = fields.begin();
+                                field != fields.end(); ++field) {
+                            record[field->first] = field->second;
+                        }
+                        serverInterface->updateRecord(oldId,
+                                writer.write(record));
                     }
                 } else if (res == SQLITE_BUSY) {
                     //Retry if the database is busy.
@@ -388,6 +445,11 @@ int SQLiteConnector::runListener() {
                 }
             }
 
+            if (!insertedRecords.empty()) {
+                serverInterface->insertRecords(insertedRecords);
+                insertedRecords.clear();
+            }
+
             //If fatal error happens, exit the listener immediately.
             if (fatal_error) {
                 break;
@@ -408,6 +470,7 @@ int SQLiteConnector::runListener() {
                         sqlite3_errmsg(db));
                 break;
             }
+            serverInterface->reportPoll(numberOfChanges, timeOfNewestChange);
 
             /*
              * Every record processed will change the flag to true. So the
@@ -416,7 +479,7 @@ int SQLiteConnector::runListener() {
             if (logRecordTimeChangedFlag) {
                 Logger::info("SQLITECONNECTOR: waiting for updates ...");
             }
-            sleep(listenerWaitTime);
+            changeWaiter.wait(logRecordTimeChangedFlag);
         }
         if (fatal_error) {
             break;
@@ -559,17 +622,24 @@ void SQLiteConnector::setPrimaryKeyName(const std::string& pkName) {
 /*
  * Create the prepared statements for the select/delete queries used in the listener.
  *
- * Select Query: SELECT * FROM log_table WHERE log_table_date > ?
- * ORDER BY log_table_date ASC;
+ * Select Query: SELECT rowid, * FROM log_table WHERE log_table_date > ?1
+ * OR (log_table_date = ?1 AND rowid > ?2) ORDER BY log_table_date ASC, rowid ASC;
  *
- * Delete Query: DELETE * FROM log_table WHERE log_table_date <= ?;
+ * Delete Query: DELETE * FROM log_table WHERE log_table_date < ?;
+ *
+ * The time stamps have a precision of one second, so the row id tells the
+ * records of the last second that were processed from the ones that were
+ * added after the last poll. The records of the last second are kept by the
+ * delete query, so that the new records of that second get greater row ids.
  */
 bool SQLiteConnector::createPreparedStatement() {
     std::stringstream sql;
 
     //Create select prepared statement
-    sql << "SELECT * from " << LOG_TABLE_NAME << " WHERE " << LOG_TABLE_NAME
-            << "_DATE > ? ORDER BY " << LOG_TABLE_NAME << "_DATE ASC; ";
+    sql << "SELECT rowid, * from " << LOG_TABLE_NAME << " WHERE "
+            << LOG_TABLE_NAME << "_DATE > ?1 OR (" << LOG_TABLE_NAME
+            << "_DATE = ?1 AND rowid > ?2) ORDER BY " << LOG_TABLE_NAME
+            << "_DATE ASC, rowid ASC; ";
 
     do {
         int rc = sqlite3_prepare_v2(db, sql.str().c_str(), -1, &selectStmt, 0);
@@ -585,7 +655,7 @@ bool SQLiteConnector::createPreparedStatement() {
     //Create delete prepared statement.
     sql.str("");
     sql << "DELETE FROM " << LOG_TABLE_NAME << " WHERE " << LOG_TABLE_NAME
-            << "_DATE <= ? ;";
+            << "_DATE < ? ;";
 
     do {
         int rc = sqlite3_prepare_v2(db, sql.str().c_str(), -1, &deleteLogStmt,
@@ -742,6 +812,10 @@ void SQLiteConnector::loadLastAccessedLogRecordTime() {
     if (checkFileExisted(path.c_str())) {
         std::ifstream a_file(path.c_str(), std::ios::in | std::ios::binary);
         a_file >> lastAccessedLogRecordTimeStr;
+        //A file saved without the row id skips the whole last second.
+        if (!(a_file >> lastAccessedLogRecordRowId)) {
+            lastAccessedLogRecordRowId = LLONG_MAX;
+        }
         a_file.close();
     } else {
         if(lastAccessedLogRecordTimeStr.compare(DEFAULT_STRING_VALUE)==0){
@@ -772,7 +846,7 @@ void SQLiteConnector::saveLastAccessedLogRecordTime() {
 
     std::string pt = path + "data.bin";
     std::ofstream a_file(pt.c_str(), std::ios::trunc | std::ios::binary);
-    a_file << lastAccessedLogRecordTimeStr;
+    a_file << lastAccessedLogRecordTimeStr << " " << lastAccessedLogRecordRowId;
     a_file.flush();
     a_file.close();
 }
@@ -36,6 +36,7 @@
 #include "DataConnector.h"
 #include <string>
 #include <map>
+#include <vector>
 #include <sqlite3.h>
 
 //The callback function of createIndex.
@@ -58,7 +59,7 @@ public:
     //and send corresponding requests to the SRCH2 engine.
     virtual int runListener();
 
-    //Save the lastAccessedLogRecordTime to the disk
+    //Save the lastAccessedLogRecordTime and lastAccessedLogRecordRowId to the disk
     virtual void saveLastAccessedLogRecordTime();
 
     //Return LOG_TABLE_NAME_DATE
@@ -71,9 +72,18 @@ public:
     void setPrimaryKeyType(const std::string& pkType);
     void setPrimaryKeyName(const std::string& pkName);
 
+    //Insert the rows collected by createIndex into the SRCH2 engine
+    void insertRecordsOfBatch();
+
     //Store the table schema. Key is schema name and value is schema type
     std::map<std::string, std::string> tableSchema;
     ServerInterface *serverInterface;
+
+    //The rows of the table read by createIndex but not inserted yet
+    std::vector<RecordFields> recordsOfBatch;
+    static const unsigned BATCH_SIZE = 1000;
+    //How long a statement waits for a lock held by another connection
+    static const int BUSY_TIMEOUT_MS = 1000;
 private:
     //Config parameters
     std::string LOG_TABLE_NAME;
@@ -94,8 +104,13 @@ private:
      * in this connector.
      */
     std::string lastAccessedLogRecordTimeStr;
+    //The row id of the last processed record in the log table, among the
+    //records of lastAccessedLogRecordTimeStr. It is saved with the time stamp,
+    //so the records of that second are not applied again after a restart.
+    long long lastAccessedLogRecordRowId;
 
     //Parameters for Sqlite
+    std::string dbFilePath;
     sqlite3 *db;
     sqlite3_stmt *selectStmt;
     sqlite3_stmt *deleteLogStmt;
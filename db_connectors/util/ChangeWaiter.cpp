@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ChangeWaiter.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#ifndef __MACH__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace {
+long long getTimeInMilliseconds() {
+    timeval now;
+    gettimeofday(&now, NULL);
+    return (long long) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+}
+
+const unsigned ChangeWaiter::MIN_WAIT_TIME_MS;
+
+ChangeWaiter::ChangeWaiter(unsigned maxWaitTimeInSeconds) {
+    maxWaitTimeInMs = std::max(maxWaitTimeInSeconds * 1000, MIN_WAIT_TIME_MS);
+    waitTimeInMs = MIN_WAIT_TIME_MS;
+    notifyFd = -1;
+}
+
+ChangeWaiter::~ChangeWaiter() {
+    if (notifyFd >= 0) {
+        close(notifyFd);
+    }
+}
+
+bool ChangeWaiter::watchFile(const std::string &path) {
+#ifdef __MACH__
+    return false;
+#else
+    //Watch the directory, since the journal files are created and removed
+    //while the database is written.
+    size_t slash = path.find_last_of('/');
+    std::string directory =
+            slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    watchedFileName =
+            slash == std::string::npos ? path : path.substr(slash + 1);
+
+    notifyFd = inotify_init();
+    if (notifyFd < 0) {
+        return false;
+    }
+    if (inotify_add_watch(notifyFd, directory.c_str(),
+            IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0) {
+        close(notifyFd);
+        notifyFd = -1;
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool ChangeWaiter::readEvents() {
+#ifdef __MACH__
+    return false;
+#else
+    char buffer[4096]
+            __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t length = read(notifyFd, buffer, sizeof(buffer));
+    bool fileChanged = false;
+    for (ssize_t offset = 0; offset < length;) {
+        const inotify_event *event = (const inotify_event *) (buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+        if (event->len == 0) {
+            continue;
+        }
+        std::string name(event->name);
+        //The shared-memory index of a WAL database is written by the
+        //readers too, including this listener.
+        if (name.compare(0, watchedFileName.size(), watchedFileName) == 0
+                && name.find("-shm") == std::string::npos) {
+            fileChanged = true;
+        }
+    }
+    return fileChanged;
+#endif
+}
+
+void ChangeWaiter::wait(bool changesFound) {
+    if (changesFound) {
+        waitTimeInMs = MIN_WAIT_TIME_MS;
+        return;
+    }
+    unsigned timeout = waitTimeInMs;
+    waitTimeInMs = std::min(waitTimeInMs * 2, maxWaitTimeInMs);
+
+#ifndef __MACH__
+    if (notifyFd >= 0) {
+        long long deadline = getTimeInMilliseconds() + timeout;
+        while (true) {
+            long long remaining = deadline - getTimeInMilliseconds();
+            if (remaining <= 0) {
+                return;
+            }
+            pollfd notifyPoll;
+            notifyPoll.fd = notifyFd;
+            notifyPoll.events = POLLIN;
+            notifyPoll.revents = 0;
+            int ready = poll(&notifyPoll, 1, (int) remaining);
+            if (ready < 0 && errno != EINTR) {
+                break;
+            }
+            if (ready > 0 && readEvents()) {
+                //The database was written, it may be written again soon.
+                waitTimeInMs = MIN_WAIT_TIME_MS;
+                return;
+            }
+        }
+    }
+#endif
+    usleep(timeout * 1000);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __CONNECTOR_UTIL_CHANGEWAITER__
+#define __CONNECTOR_UTIL_CHANGEWAITER__
+#include <string>
+
+/*
+ * Decides when the listener of a connector polls the changes of its database again.
+ *
+ * After a poll that found changes the listener polls again at once, so a burst of changes is
+ * applied in consecutive batches. After a poll without changes it waits for a delay that starts
+ * at MIN_WAIT_TIME_MS and doubles after each such poll up to the listenerWaitTime of the
+ * connector, so an idle database costs few round trips.
+ *
+ * If the database is a local file (e.g., SQLite), watchFile() makes a write to the file end the
+ * wait at once (with inotify on Linux), so a change does not wait for the end of the delay.
+ */
+class ChangeWaiter {
+public:
+    static const unsigned MIN_WAIT_TIME_MS = 50;
+
+    ChangeWaiter(unsigned maxWaitTimeInSeconds);
+    ~ChangeWaiter();
+
+    //Watch the writes to the file and its journal files (e.g., "<file>-wal").
+    //Return false if the file can not be watched.
+    bool watchFile(const std::string &path);
+
+    //Wait before the next poll. changesFound tells if the last poll found changes.
+    void wait(bool changesFound);
+
+private:
+    //Read the pending events of the watched directory, return true if one is about the file.
+    bool readEvents();
+
+    unsigned maxWaitTimeInMs;
+    unsigned waitTimeInMs;
+    //-1 if no file is watched
+    int notifyFd;
+    std::string watchedFileName;
+};
+#endif
@@ -284,7 +284,9 @@ typedef enum {
 	PhysicalPlanNode_FilterQuery,
 	PhysicalPlanNode_PhraseSearch,
 	PhysicalPlanNode_KeywordSearch,
-	PhysicalPlanNode_FeedbackRanker
+	PhysicalPlanNode_FeedbackRanker,
+	PhysicalPlanNode_UnionTopKBlockMax,
+	PhysicalPlanNode_ParallelExchange
 } PhysicalPlanNodeType;
 
 typedef enum {
@@ -36,6 +36,7 @@
 #include <instantsearch/Constants.h>
 
 #include <string>
+#include <map>
 #include <stdint.h>
 
 namespace srch2
@@ -124,6 +125,19 @@ public:
     * Adds a record. If primary key is duplicate, insert fails and -1 is returned. Otherwise, 0 is returned.*/
     virtual INDEXWRITE_RETVAL addRecord(const Record *record, Analyzer *analyzer) = 0;
 
+    /*
+    * Adds a record whose tokens were already computed with Analyzer::tokenizeRecord(). It lets a bulk loader
+    * analyze records in several threads and add them in order. Same return values as addRecord().*/
+    virtual INDEXWRITE_RETVAL addAnalyzedRecord(const Record *record,
+            std::map<std::string, TokenAttributeHits> &tokenAttributeHitsMap) = 0;
+
+    /*
+    * Adds a batch of analyzed records in order, taking the lock of the writers and checking the merge condition
+    * once for the whole batch. returnValues gets the return value of addAnalyzedRecord() for each record.*/
+    virtual void addAnalyzedRecords(const std::vector<const Record *> &records,
+            std::vector<std::map<std::string, TokenAttributeHits> > &tokenAttributeHitsMaps,
+            std::vector<INDEXWRITE_RETVAL> &returnValues) = 0;
+
     // Edits the record's access list based on the command type
     virtual INDEXWRITE_RETVAL aclRecordModifyRoles(const std::string &resourcePrimaryKeyID, vector<string> &roleIds, RecordAclCommandType commandType) = 0;
 
@@ -179,10 +193,11 @@ public:
     virtual const bool isCommited() const = 0;
 
     /*
-     * Saves the indexes to disk, in the "directoryName" folder.*/
+     * Saves the indexes to disk, in the "directoryName" folder. Returns OP_SUCCESS only if
+     * every index file was written and synced to the disk.*/
 
-    virtual void save(const std::string& directoryName) = 0;
-    virtual void save() = 0;
+    virtual INDEXWRITE_RETVAL save(const std::string& directoryName) = 0;
+    virtual INDEXWRITE_RETVAL save() = 0;
 
     virtual void exportData(const string &exportedDataFileName) = 0;
 
@@ -278,6 +278,14 @@ public:
 
 	LogicalPlanNode * createGeoLogicalPlanNode(Shape *regionShape);
 
+	/*
+	 * The execution of a plan annotates its tree, may force physical operators on its nodes
+	 * and changes its fuzzy flag (see KeywordSearchOperator::open). This function frees the
+	 * annotations, clears the forced operators and sets the fuzzy flag back to isFuzzy, the
+	 * value set by the rewriter, so that the plan can be executed again.
+	 */
+	void resetExecutionState(bool isFuzzy);
+
 
 	/*
 	 * This function returns a string representation of the logical plan
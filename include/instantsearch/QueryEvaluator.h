@@ -50,28 +50,42 @@ public:
 	unsigned keywordPopularityThreshold;
 	unsigned getAllMaximumNumberOfResults;
 	unsigned getAllTopKReplacementK;
+	// subtrees of the physical plan run in parallel only if the estimated number of results
+	// of their parent reaches this number
+	unsigned parallelExecutionMinimumNumberOfResults;
+	// if not NULL, the search stops as soon as the caller sets it, e.g., when nobody waits for its
+	// results anymore, and returns the results found so far
+	const volatile bool *cancelled;
 
 	QueryEvaluatorRuntimeParametersContainer(){
 		keywordPopularityThreshold = 50000;
 		getAllMaximumNumberOfResults = 500;
+		parallelExecutionMinimumNumberOfResults = 10000;
+		cancelled = NULL;
 	}
 
 	QueryEvaluatorRuntimeParametersContainer(unsigned keywordPopularityThreshold){
 		this->keywordPopularityThreshold = keywordPopularityThreshold;
 		this->getAllMaximumNumberOfResults = 500;
 		this->getAllTopKReplacementK = 500;
+		this->parallelExecutionMinimumNumberOfResults = 10000;
+		this->cancelled = NULL;
 	}
 
 	QueryEvaluatorRuntimeParametersContainer(unsigned keywordPopularityThreshold, unsigned getAllMaximumNumberOfResults, unsigned getAllTopKReplacementK){
 		this->keywordPopularityThreshold = keywordPopularityThreshold;
 		this->getAllMaximumNumberOfResults = getAllMaximumNumberOfResults;
 		this->getAllTopKReplacementK = getAllTopKReplacementK;
+		this->parallelExecutionMinimumNumberOfResults = 10000;
+		this->cancelled = NULL;
 	}
 
 	QueryEvaluatorRuntimeParametersContainer(const QueryEvaluatorRuntimeParametersContainer & copy){
 		this->keywordPopularityThreshold = copy.keywordPopularityThreshold;
 		this->getAllMaximumNumberOfResults = copy.getAllMaximumNumberOfResults;
 		this->getAllTopKReplacementK = copy.getAllTopKReplacementK;
+		this->parallelExecutionMinimumNumberOfResults = copy.parallelExecutionMinimumNumberOfResults;
+		this->cancelled = copy.cancelled;
 	}
 };
 
@@ -46,6 +46,7 @@ namespace instantsearch
 
 class QueryEvaluator;
 class QueryResults;
+class DocValuesReadView;
 
 class ResultsPostProcessorFilter
 {
@@ -117,6 +118,12 @@ class RefiningAttributeExpressionEvaluator
 {
 public:
 	virtual bool evaluate(std::map<std::string, TypedValue> & refiningAttributeValues) = 0 ;
+	// Evaluates the expression on a batch of records by reading their values from the doc-values columns.
+	// selection holds the positions in recordIds of the records to evaluate and is narrowed to the ones
+	// that pass. Returns false if the expression cannot be evaluated on the columns (selection is then
+	// undefined) and the caller calls evaluate() for each record instead.
+	virtual bool evaluateBatch(const DocValuesReadView & docValues, const unsigned * recordIds,
+			std::vector<unsigned> & selection) { return false; }
 	virtual ~RefiningAttributeExpressionEvaluator(){};
 	virtual string toString() = 0;
 };
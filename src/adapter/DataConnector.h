@@ -27,12 +27,27 @@
 #ifndef __DATACONNECTOR_H__
 #define __DATACONNECTOR_H__
 
+#include <ctime>
 #include <string>
+#include <utility>
+#include <vector>
+
+/*
+ *  A record given as the names and values of its fields, e.g., the columns of a row
+ *  of a table. The values are converted to the types of the attributes in the schema
+ *  like the string values of a JSON record, and "NULL" is an empty value. A name may
+ *  appear several times to give the values of a multi-valued attribute.
+ */
+typedef std::vector<std::pair<std::string, std::string> > RecordFields;
 
 /*
  *  The abstract class ServerInterface provides the interface of the engine to
  *  an external data connector. Its implementation is within the 
  *  engine.
+ *
+ *  Connectors are shared libraries built separately from the engine, so new
+ *  functions are only appended to the class. This keeps the functions that a
+ *  connector built against an older version calls at the same place.
  */
 
 class ServerInterface {
@@ -100,6 +115,48 @@ public:
      *    -1 : value not found, and the value will be empty.
      */
     virtual int configLookUp(const std::string& key, std::string & value) = 0;
+
+    /*
+     * This function inserts a batch of records (in JSON format) of this
+     * source to the SRCH2 indexes. It is much faster than inserting the
+     * records one by one, e.g., to load a whole table in createNewIndexes().
+     *
+     * Parameters:
+     *  jsonStrings : JSON format strings, one record in each.
+     *
+     * Return value:
+     *   The number of records that were not inserted, 0 if all of
+     *   them were inserted.
+     */
+    virtual int insertRecords(const std::vector<std::string>& jsonStrings) = 0;
+
+    /*
+     * This function inserts a batch of records given as their fields, which
+     * saves encoding them as JSON and parsing them again in the engine.
+     *
+     * Parameters:
+     *  records : The fields of each record.
+     *
+     * Return value:
+     *   The number of records that were not inserted, 0 if all of
+     *   them were inserted.
+     */
+    virtual int insertRecords(const std::vector<RecordFields>& records) = 0;
+
+    /*
+     * This function reports a poll of the changes of the source by the
+     * listener. The engine reports the freshness of the indexes in /info
+     * from it, so it should be called after each poll, including the polls
+     * that found no change.
+     *
+     * Parameters:
+     *   numberOfChanges: The number of changes applied by the poll.
+     *   timeOfNewestChange: The time (in seconds since the epoch) at which
+     *        the newest of these changes was made in the source, or 0 if
+     *        it is not known.
+     */
+    virtual void reportPoll(unsigned numberOfChanges,
+            time_t timeOfNewestChange) = 0;
 };
 
 /*
@@ -53,6 +53,9 @@ ServerInterfaceInternal::ServerInterfaceInternal(void *server) {
     this->server = (srch2::httpwrapper::Srch2Server*) server;
 }
 
+//Changes made by a connector are not written to the write-ahead log of the core: after a crash
+//the connector resumes from the timestamp it saved with the last save of the indexes.
+
 //Called by the connector, accepts json format record and insert into the index
 int ServerInterfaceInternal::insertRecord(const std::string& jsonString) {
     stringstream debugMsg;
@@ -83,6 +86,119 @@ int ServerInterfaceInternal::insertRecord(const std::string& jsonString) {
     }
 }
 
+//Called by the connector, accepts a batch of json format records and insert them into the index
+int ServerInterfaceInternal::insertRecords(
+        const std::vector<std::string>& jsonStrings) {
+    std::vector<Json::Value> roots(jsonStrings.size());
+    Json::Reader reader;
+    for (unsigned i = 0; i < jsonStrings.size(); ++i) {
+        if (!reader.parse(jsonStrings[i], roots[i], false)) {
+            Logger::error("JSON object parse error %s", jsonStrings[i].c_str());
+            // an object without the primary key is not inserted
+            roots[i] = Json::Value(Json::nullValue);
+        }
+    }
+    return insertParsedRecords(roots);
+}
+
+//Called by the connector, accepts a batch of records given as their fields and insert them into
+//the index. The fields become members of json objects without going through a json string.
+int ServerInterfaceInternal::insertRecords(
+        const std::vector<RecordFields>& records) {
+    std::vector<Json::Value> roots(records.size(),
+            Json::Value(Json::objectValue));
+    for (unsigned i = 0; i < records.size(); ++i) {
+        for (RecordFields::const_iterator field = records[i].begin();
+                field != records[i].end(); ++field) {
+            Json::Value &member = roots[i][field->first];
+            if (member.isNull()) {
+                member = field->second;
+            } else {
+                // another value of a multi-valued attribute
+                if (!member.isArray()) {
+                    Json::Value firstValue = member;
+                    member = Json::Value(Json::arrayValue);
+                    member.append(firstValue);
+                }
+                member.append(field->second);
+            }
+        }
+    }
+    return insertParsedRecords(roots);
+}
+
+int ServerInterfaceInternal::insertParsedRecords(
+        const std::vector<Json::Value>& roots) {
+    // bounds the time the lock of the writers is held by one batch
+    const unsigned batchSize = 1000;
+
+    srch2is::Indexer *indexer = this->server->indexer;
+    const srch2::httpwrapper::CoreInfo_t *indexDataConfig =
+            this->server->indexDataConfig;
+    srch2is::Schema *storedSchema = srch2is::Schema::create();
+    srch2::util::RecordSerializerUtil::populateStoredSchema(storedSchema,
+            indexer->getSchema());
+    srch2::util::RecordSerializer recSerializer(*storedSchema);
+    // Do NOT delete analyzer because it is thread specific.
+    srch2is::Analyzer *analyzer =
+            srch2::httpwrapper::AnalyzerFactory::getCurrentThreadAnalyzerWithSynonyms(
+                    indexDataConfig);
+
+    int numberOfFailedRecords = 0;
+    std::vector<const srch2is::Record *> records;
+    std::vector<std::map<std::string, srch2is::TokenAttributeHits> > tokenAttributeHitsMaps;
+    std::vector<srch2is::INDEXWRITE_RETVAL> returnValues;
+    for (unsigned batchStart = 0; batchStart < roots.size(); batchStart += batchSize) {
+        const unsigned batchEnd = std::min<unsigned>(batchStart + batchSize, roots.size());
+        for (unsigned i = batchStart; i < batchEnd; ++i) {
+            srch2is::Record *record = new srch2is::Record(indexer->getSchema());
+            std::stringstream errorStream;
+            if (!srch2::httpwrapper::JSONRecordParser::_JSONValueObjectToRecord(
+                    record, roots[i], indexDataConfig, errorStream, recSerializer)) {
+                Logger::error("INSERT : failed to parse the record %s : %s",
+                        record->getPrimaryKey().c_str(), errorStream.str().c_str());
+                ++numberOfFailedRecords;
+                delete record;
+                continue;
+            }
+            records.push_back(record);
+            tokenAttributeHitsMaps.resize(records.size());
+            analyzer->tokenizeRecord(record, tokenAttributeHitsMaps.back());
+        }
+
+        // the records beyond the document limit are not added
+        const unsigned numberOfDocuments = indexer->getNumberOfDocumentsInIndex();
+        const unsigned documentLimit = indexDataConfig->getDocumentLimit();
+        const unsigned numberOfRecordsToAdd = numberOfDocuments >= documentLimit ? 0 :
+                std::min<unsigned>(records.size(), documentLimit - numberOfDocuments);
+        if (numberOfRecordsToAdd < records.size()) {
+            Logger::error("INSERT : document limit reached, %u records are not inserted.",
+                    (unsigned) (records.size() - numberOfRecordsToAdd));
+            numberOfFailedRecords += records.size() - numberOfRecordsToAdd;
+            for (unsigned i = numberOfRecordsToAdd; i < records.size(); ++i) {
+                delete records[i];
+            }
+            records.resize(numberOfRecordsToAdd);
+            tokenAttributeHitsMaps.resize(numberOfRecordsToAdd);
+        }
+
+        indexer->addAnalyzedRecords(records, tokenAttributeHitsMaps, returnValues);
+        for (unsigned i = 0; i < records.size(); ++i) {
+            if (returnValues[i] != srch2is::OP_SUCCESS) {
+                Logger::debug("INSERT : {\"rid\":\"%s\",\"insert\":\"failed\","
+                        "\"reason\":\"The record with same primary key already exists\"}",
+                        records[i]->getPrimaryKey().c_str());
+                ++numberOfFailedRecords;
+            }
+            delete records[i];
+        }
+        records.clear();
+        tokenAttributeHitsMaps.clear();
+    }
+    delete storedSchema;
+    return numberOfFailedRecords;
+}
+
 //Called by the connector, accepts record pkey and delete from the index
 int ServerInterfaceInternal::deleteRecord(const std::string& primaryKey) {
     stringstream debugMsg;
@@ -181,11 +297,17 @@ int ServerInterfaceInternal::updateRecord(const std::string& pk,
 
 //Call save index to the disk manually.
 int ServerInterfaceInternal::saveChanges() {
-    server->indexer->save();
+    server->saveIndexes();
     Logger::debug("ServerInterface calls saveChanges");
     return 0;
 }
 
+//Called by the listener of the connector after each poll of the changes
+void ServerInterfaceInternal::reportPoll(unsigned numberOfChanges,
+        time_t timeOfNewestChange) {
+    server->connectorFreshness.reportPoll(numberOfChanges, timeOfNewestChange);
+}
+
 /*
  * Find the config file value. the key is the same name in the config file.
  * Also, change the input string to lower case to match the key.
@@ -34,7 +34,9 @@
 #define __SERVERINTERFACEINTERNAL__ 
 #include "DataConnector.h"
 #include "Srch2Server.h"
+#include "json/json.h"
 #include <string>
+#include <vector>
 
 class ServerInterfaceInternal: public ServerInterface {
 
@@ -43,10 +45,14 @@ public:
     virtual ~ServerInterfaceInternal();
 
     virtual int insertRecord(const std::string& jsonString);
+    virtual int insertRecords(const std::vector<std::string>& jsonStrings);
+    virtual int insertRecords(const std::vector<RecordFields>& records);
     virtual int deleteRecord(const std::string& primaryKey);
     virtual int updateRecord(const std::string& pk,
             const std::string& jsonSrting);
     virtual int saveChanges();
+    virtual void reportPoll(unsigned numberOfChanges,
+            time_t timeOfNewestChange);
 
     /*
      * "configLookUp" will provide key based lookup from engine's connector
@@ -58,6 +64,13 @@ public:
     //return false if the source is not database
     bool isDatabase();
 private:
+    /*
+     * Inserts the records in batches: each batch is parsed and analyzed by the calling
+     * thread and then added to the index with one acquisition of the lock of the writers.
+     * Returns the number of records that were not inserted.
+     */
+    int insertParsedRecords(const std::vector<Json::Value>& roots);
+
     srch2::httpwrapper::Srch2Server *server;
 };
 #endif /* __SERVERINTERFACEINTERNAL__ */
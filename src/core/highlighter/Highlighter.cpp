@@ -718,6 +718,7 @@ TermOffsetAlgorithm::TermOffsetAlgorithm (const Indexer * indexer,
 
 	const IndexReaderWriter* rwIndexer =  dynamic_cast<const IndexReaderWriter *>(indexer);
 	fwdIndex = rwIndexer->getForwardIndex();
+	trieReadView = rwIndexer->getTrie_ReadView();
 	fwdIndex->getForwardListDirectory_ReadView(readView);
 
 }
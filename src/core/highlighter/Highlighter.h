@@ -205,6 +205,8 @@ private:
 			vector<CandidateKeywordInfo>& completeKeywordsId,
 			const unsigned *keywordIdsPtr, unsigned keywordsInRec);
 	ForwardIndex* fwdIndex;
+	// held with the read view of the forward index, so that a merge does not free its forward lists
+	boost::shared_ptr<TrieRootNodeAndFreeList> trieReadView;
 	boost::shared_ptr<vectorview<ForwardListPtr> > readView;
 	boost::unordered_map<unsigned, vector<CandidateKeywordInfo>* > cache;
 };
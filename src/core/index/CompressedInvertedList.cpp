@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "index/CompressedInvertedList.h"
+
+#include <algorithm>
+
+using srch2::util::BlockPacking;
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+CompressedInvertedList::CompressedInvertedList()
+{
+    this->numberOfElements = 0;
+    this->blocks = NULL;
+    this->numberOfBlocks = 0;
+    this->packedWords = NULL;
+    this->numberOfPackedWords = 0;
+    this->pendingMaxScore = 0;
+}
+
+CompressedInvertedList::CompressedInvertedList(unsigned size, const InvertedListBlockInfo *blocks,
+        unsigned numberOfBlocks, const unsigned *packedWords, unsigned numberOfPackedWords)
+{
+    ASSERT(numberOfBlocks == (size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    this->numberOfElements = size;
+    this->blocks = blocks;
+    this->numberOfBlocks = numberOfBlocks;
+    this->packedWords = packedWords;
+    this->numberOfPackedWords = numberOfPackedWords;
+    this->pendingMaxScore = 0;
+}
+
+void CompressedInvertedList::append(unsigned recordId, float score)
+{
+    if (this->pendingRecordIds.empty()) {
+        this->pendingRecordIds.reserve(BLOCK_SIZE);
+        this->pendingMaxScore = score;
+    } else if (score > this->pendingMaxScore) {
+        this->pendingMaxScore = score;
+    }
+    this->pendingRecordIds.push_back(recordId);
+    ++this->numberOfElements;
+    if (this->pendingRecordIds.size() == BLOCK_SIZE)
+        flushPendingBlock();
+}
+
+void CompressedInvertedList::finalize()
+{
+    if (!this->pendingRecordIds.empty())
+        flushPendingBlock();
+    std::vector<unsigned>().swap(this->pendingRecordIds);
+    this->blocks = this->blockStorage.empty() ? NULL : &this->blockStorage[0];
+    this->numberOfBlocks = this->blockStorage.size();
+    this->packedWords = this->packedWordStorage.empty() ? NULL : &this->packedWordStorage[0];
+    this->numberOfPackedWords = this->packedWordStorage.size();
+}
+
+void CompressedInvertedList::flushPendingBlock()
+{
+    const std::vector<unsigned> &recordIds = this->pendingRecordIds;
+    InvertedListBlockInfo block;
+    block.packedOffset = this->packedWordStorage.size();
+    block.minRecordId = *std::min_element(recordIds.begin(), recordIds.end());
+    block.maxRecordId = *std::max_element(recordIds.begin(), recordIds.end());
+    block.maxScore = this->pendingMaxScore;
+    this->blockStorage.push_back(block);
+
+    if (recordIds.size() == BLOCK_SIZE) {
+        unsigned bitWidth = BlockPacking::getBitWidth(block.maxRecordId - block.minRecordId);
+        this->packedWordStorage.resize(block.packedOffset + BlockPacking::getNumberOfWords(bitWidth));
+        BlockPacking::pack(&recordIds[0], block.minRecordId, bitWidth, &this->packedWordStorage[block.packedOffset]);
+    } else {
+        // the last block of the list is too short to be worth packing
+        this->packedWordStorage.insert(this->packedWordStorage.end(), recordIds.begin(), recordIds.end());
+    }
+    this->pendingRecordIds.clear();
+}
+
+unsigned CompressedInvertedList::decodeBlock(unsigned blockIndex, unsigned *out) const
+{
+    unsigned blockSize = getBlockSize(blockIndex);
+    const InvertedListBlockInfo &block = this->blocks[blockIndex];
+    const unsigned *in = this->packedWords + block.packedOffset;
+    if (blockSize < BLOCK_SIZE) {
+        std::copy(in, in + blockSize, out);
+        return blockSize;
+    }
+    unsigned endOffset = blockIndex + 1 < this->numberOfBlocks ?
+            this->blocks[blockIndex + 1].packedOffset : this->numberOfPackedWords;
+    unsigned bitWidth = (endOffset - block.packedOffset) / BlockPacking::LANES;
+    BlockPacking::unpack(in, block.minRecordId, bitWidth, out);
+    return BLOCK_SIZE;
+}
+
+unsigned CompressedInvertedList::getNumberOfBytes() const
+{
+    return sizeof(CompressedInvertedList) + this->numberOfBlocks * sizeof(InvertedListBlockInfo)
+            + this->numberOfPackedWords * sizeof(unsigned);
+}
+
+InvertedListCursor::InvertedListCursor()
+{
+    this->numberOfElements = 0;
+    this->position = 0;
+    this->decodedBlockIndex = (unsigned) -1;
+}
+
+InvertedListCursor::InvertedListCursor(const boost::shared_ptr<const CompressedInvertedList> &compressedList)
+{
+    this->compressedList = compressedList;
+    this->numberOfElements = compressedList->size();
+    this->position = 0;
+    this->decodedBlockIndex = (unsigned) -1;
+}
+
+InvertedListCursor::InvertedListCursor(const boost::shared_ptr<vectorview<unsigned> > &readView)
+{
+    this->readView = readView;
+    this->numberOfElements = readView->size();
+    this->position = 0;
+    this->decodedBlockIndex = (unsigned) -1;
+}
+
+bool InvertedListCursor::getBlockMaxScore(float &maxScore) const
+{
+    if (this->compressedList.get() == NULL || isDone())
+        return false;
+    maxScore = this->compressedList->getBlockInfo(this->position / CompressedInvertedList::BLOCK_SIZE).maxScore;
+    return true;
+}
+
+bool InvertedListCursor::getBlockMaxRecordId(unsigned &maxRecordId) const
+{
+    if (this->compressedList.get() == NULL || isDone())
+        return false;
+    maxRecordId = this->compressedList->getBlockInfo(this->position / CompressedInvertedList::BLOCK_SIZE).maxRecordId;
+    return true;
+}
+
+void InvertedListCursor::skipToNextBlock()
+{
+    if (this->compressedList.get() == NULL) {
+        this->position = this->numberOfElements;
+        return;
+    }
+    this->position = (this->position / CompressedInvertedList::BLOCK_SIZE + 1) * CompressedInvertedList::BLOCK_SIZE;
+    if (this->position > this->numberOfElements)
+        this->position = this->numberOfElements;
+}
+
+void InvertedListCursor::decodeBlock(unsigned blockIndex)
+{
+    if (this->decodedRecordIds.empty()) {
+        unsigned blockSize = CompressedInvertedList::BLOCK_SIZE;
+        this->decodedRecordIds.resize(std::min(this->numberOfElements, blockSize));
+    }
+    this->compressedList->decodeBlock(blockIndex, &this->decodedRecordIds[0]);
+    this->decodedBlockIndex = blockIndex;
+}
+
+}
+}
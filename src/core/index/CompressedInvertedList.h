@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __INDEX_COMPRESSEDINVERTEDLIST_H__
+#define __INDEX_COMPRESSEDINVERTEDLIST_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "util/cowvector/cowvector.h"
+#include "util/BlockPacking.h"
+#include "util/Assert.h"
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+/*
+ *  Skip data of one block of a compressed inverted list.
+ *  The block occupies the packed words [packedOffset, next block's packedOffset).
+ */
+struct InvertedListBlockInfo
+{
+    unsigned packedOffset;
+    // the minimum record id of the block is also the base of its frame of reference
+    unsigned minRecordId;
+    unsigned maxRecordId;
+    // the maximum term record static score of the block
+    float maxScore;
+};
+
+/*
+ *  A block-packed copy of the committed read view of an inverted list, in blocks of BLOCK_SIZE
+ *  record ids, that queries read through InvertedListCursor. It is kept in addition to the
+ *  cowvector of the list, which stays the base of the writer, so it adds to the index memory.
+ *
+ *  Inverted lists are sorted by score, not by record id, so record ids are not delta-encoded
+ *  from their predecessors but relative to the minimum of their block (frame of reference),
+ *  and bit packed with util/BlockPacking.h. A last block shorter than BLOCK_SIZE is stored
+ *  unpacked. Each block keeps its maximum record id and maximum score, which lets a reader skip
+ *  a whole block without decoding it.
+ *
+ *  A list is immutable once built. It is built by appending the elements in list order and
+ *  calling finalize(), or it points to blocks stored elsewhere, e.g. in a mapped snapshot.
+ */
+class CompressedInvertedList
+{
+public:
+    static const unsigned BLOCK_SIZE = srch2::util::BlockPacking::BLOCK_SIZE;
+
+    CompressedInvertedList();
+    // the list does not own the arrays, which must outlive it
+    CompressedInvertedList(unsigned size, const InvertedListBlockInfo *blocks, unsigned numberOfBlocks,
+            const unsigned *packedWords, unsigned numberOfPackedWords);
+
+    void append(unsigned recordId, float score);
+    void finalize();
+
+    unsigned size() const {
+        return this->numberOfElements;
+    }
+
+    unsigned getNumberOfBlocks() const {
+        return this->numberOfBlocks;
+    }
+
+    const InvertedListBlockInfo &getBlockInfo(unsigned blockIndex) const {
+        ASSERT(blockIndex < this->numberOfBlocks);
+        return this->blocks[blockIndex];
+    }
+
+    // number of record ids in the block
+    unsigned getBlockSize(unsigned blockIndex) const {
+        ASSERT(blockIndex < this->numberOfBlocks);
+        if (blockIndex + 1 < this->numberOfBlocks)
+            return BLOCK_SIZE;
+        return this->numberOfElements - blockIndex * BLOCK_SIZE;
+    }
+
+    // decodes the block into "out", which must have room for getBlockSize(blockIndex) values.
+    // Returns the number of decoded values.
+    unsigned decodeBlock(unsigned blockIndex, unsigned *out) const;
+
+    const InvertedListBlockInfo *getBlocks() const {
+        return this->blocks;
+    }
+
+    const unsigned *getPackedWords() const {
+        return this->packedWords;
+    }
+
+    unsigned getNumberOfPackedWords() const {
+        return this->numberOfPackedWords;
+    }
+
+    unsigned getNumberOfBytes() const;
+
+private:
+    // the arrays may point into the storage vectors, so a list cannot be copied
+    CompressedInvertedList(const CompressedInvertedList &);
+    CompressedInvertedList &operator=(const CompressedInvertedList &);
+
+    void flushPendingBlock();
+
+    unsigned numberOfElements;
+    const InvertedListBlockInfo *blocks;
+    unsigned numberOfBlocks;
+    const unsigned *packedWords;
+    unsigned numberOfPackedWords;
+
+    // storage of a list built by append(); empty when the list points to external arrays
+    std::vector<InvertedListBlockInfo> blockStorage;
+    std::vector<unsigned> packedWordStorage;
+    // elements appended since the last full block
+    std::vector<unsigned> pendingRecordIds;
+    float pendingMaxScore;
+};
+
+/*
+ *  A reader of one inverted list read view, used by the operators which scan inverted lists.
+ *
+ *  When the list has a compressed read view, the cursor decodes one block at a time, when an
+ *  element of that block is first accessed. Otherwise it reads the uncompressed read view.
+ *  Both views hold the same elements in the same order, so positions are interchangeable.
+ *  The cursor keeps a reference to the view it reads, so it stays valid after a merge.
+ */
+class InvertedListCursor
+{
+public:
+    InvertedListCursor();
+    InvertedListCursor(const boost::shared_ptr<const CompressedInvertedList> &compressedList);
+    InvertedListCursor(const boost::shared_ptr<vectorview<unsigned> > &readView);
+
+    unsigned size() const {
+        return this->numberOfElements;
+    }
+
+    bool isCompressed() const {
+        return this->compressedList.get() != NULL;
+    }
+
+    // random access to an element. Accesses in increasing order decode each block only once.
+    unsigned getElement(unsigned position) {
+        ASSERT(position < this->numberOfElements);
+        if (this->compressedList.get() == NULL)
+            return this->readView->getElement(position);
+        unsigned blockIndex = position / CompressedInvertedList::BLOCK_SIZE;
+        if (blockIndex != this->decodedBlockIndex)
+            decodeBlock(blockIndex);
+        return this->decodedRecordIds[position % CompressedInvertedList::BLOCK_SIZE];
+    }
+
+    /*
+     *  Sequential interface
+     */
+    unsigned getPosition() const {
+        return this->position;
+    }
+
+    void seek(unsigned position) {
+        this->position = position;
+    }
+
+    bool isDone() const {
+        return this->position >= this->numberOfElements;
+    }
+
+    unsigned getRecordId() {
+        return getElement(this->position);
+    }
+
+    void next() {
+        ++this->position;
+    }
+
+    // Skip data of the block of the current position. Without a compressed view, the whole
+    // list is one block whose bounds are unknown, so these return false.
+    bool getBlockMaxScore(float &maxScore) const;
+    bool getBlockMaxRecordId(unsigned &maxRecordId) const;
+    // moves to the first element of the next block, without decoding the current one
+    void skipToNextBlock();
+
+private:
+    void decodeBlock(unsigned blockIndex);
+
+    boost::shared_ptr<const CompressedInvertedList> compressedList;
+    boost::shared_ptr<vectorview<unsigned> > readView;
+    unsigned numberOfElements;
+    unsigned position;
+    unsigned decodedBlockIndex;
+    std::vector<unsigned> decodedRecordIds;
+};
+
+}
+}
+
+#endif // __INDEX_COMPRESSEDINVERTEDLIST_H__
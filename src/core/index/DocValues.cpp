@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DocValues.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <stdexcept>
+#include "util/cowvector/cowvector.h"
+#include "util/RecordSerializer.h"
+#include "util/RecordSerializerUtil.h"
+#include "util/MappedFile.h"
+#include "util/Assert.h"
+#include "serialization/FlatSnapshot.h"
+
+using namespace std;
+using srch2::util::RecordSerializer;
+using srch2::util::RecordSerializerUtil;
+using srch2::util::MappedFile;
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+// the arrays of the columns start at offsets aligned to the widest value
+static const unsigned FLAT_ARRAY_ALIGNMENT = 8;
+
+struct FlatDocValuesInfo {
+    uint64_t numberOfRecords;
+};
+
+/*
+ * The header of a saved column. Its values (the ordinals of a text column) are numberOfRecords elements
+ * at valuesOffset in FlatSection_DocValuesArrays. The dictionary of a text column is the dictionarySize
+ * values between the dictionarySize + 1 offsets that start at firstDictionaryOffset in
+ * FlatSection_DocValuesDictionaryOffsets.
+ */
+struct FlatDocValuesColumn {
+    uint32_t refiningAttributeId;
+    uint32_t type;
+    uint64_t valuesOffset;
+    uint64_t firstDictionaryOffset;
+    uint64_t dictionarySize;
+};
+
+/*
+ *  The writer side of a column. Values are appended in record id order.
+ */
+class DocValuesColumn
+{
+public:
+    virtual ~DocValuesColumn() {}
+    virtual void append(const TypedValue &value) = 0;
+    virtual void appendDefault() = 0;
+    virtual void commit() = 0;
+    virtual void merge() = 0;
+    virtual DocValuesColumnReadView *getReadView() const = 0;
+
+    // appends the committed values (the ordinals of a text column) to the current section
+    virtual void saveValues(FlatSnapshotWriter &writer) const = 0;
+    // appends the dictionary of a text column to the current section and the offset of each value
+    // and the end offset to offsets. Returns the number of values, 0 for the other columns.
+    virtual unsigned saveDictionary(FlatSnapshotWriter &writer, vector<uint64_t> &offsets) const { return 0; }
+};
+
+static inline void getColumnValue(const TypedValue &value, int &result) { result = value.getIntTypedValue(); }
+static inline void getColumnValue(const TypedValue &value, float &result) { result = value.getFloatTypedValue(); }
+static inline void getColumnValue(const TypedValue &value, double &result) { result = value.getDoubleTypedValue(); }
+static inline void getColumnValue(const TypedValue &value, long &result) {
+    result = value.getType() == ATTRIBUTE_TYPE_TIME ? value.getTimeTypedValue() : value.getLongTypedValue();
+}
+
+// false if one of the selected records of the batch is newer than a column of columnSize records
+static bool isSelectionInColumn(unsigned columnSize, const unsigned *recordIds, const vector<unsigned> &selection)
+{
+    unsigned maxRecordId = 0;
+    for (unsigned i = 0; i < selection.size(); ++i)
+        maxRecordId = max(maxRecordId, recordIds[selection[i]]);
+    return selection.empty() || maxRecordId < columnSize;
+}
+
+/*
+ * The loop of selectInRange(). Every selected position is written back and the output index only
+ * advances when its value passes, so there is no branch on the outcome of the comparisons and the
+ * batch is filtered with a run of loads, compares and adds.
+ */
+template <class T, class ValueReader>
+static void selectPositionsInRange(const ValueReader &reader, bool hasLowerBound, const T &lowerBound,
+        bool hasUpperBound, const T &upperBound, bool negative, const unsigned *recordIds,
+        vector<unsigned> &selection)
+{
+    unsigned selected = 0;
+    for (unsigned i = 0; i < selection.size(); ++i) {
+        const unsigned position = selection[i];
+        const T &value = reader(recordIds[position]);
+        const bool inRange = (!hasLowerBound | (lowerBound <= value)) & (!hasUpperBound | (value <= upperBound));
+        selection[selected] = position;
+        selected += inRange != negative;
+    }
+    selection.resize(selected);
+}
+
+template <class T>
+class FixedWidthValueReader
+{
+public:
+    FixedWidthValueReader(const vectorview<T> &values) : values(values) {}
+    T operator()(unsigned recordId) const { return values.getElement(recordId); }
+private:
+    const vectorview<T> &values;
+};
+
+template <class T>
+class FixedWidthColumnReadView : public DocValuesColumnReadView
+{
+public:
+    FixedWidthColumnReadView(FilterType type, const boost::shared_ptr<vectorview<T> > &values)
+        : type(type), values(values) {}
+
+    unsigned size() const { return values->size(); }
+
+    void getTypedValue(unsigned recordId, TypedValue &value) const {
+        value.setTypedValue(values->getElement(recordId), type);
+    }
+
+    FilterType getType() const { return type; }
+
+    bool selectInRange(const TypedValue *lowerBound, const TypedValue *upperBound, bool negative,
+            const unsigned *recordIds, vector<unsigned> &selection) const {
+        if (!isSelectionInColumn(size(), recordIds, selection))
+            return false;
+        T lower = T(), upper = T();
+        if (lowerBound != NULL)
+            getColumnValue(*lowerBound, lower);
+        if (upperBound != NULL)
+            getColumnValue(*upperBound, upper);
+        selectPositionsInRange(FixedWidthValueReader<T>(*values), lowerBound != NULL, lower,
+                upperBound != NULL, upper, negative, recordIds, selection);
+        return true;
+    }
+
+private:
+    FilterType type;
+    boost::shared_ptr<vectorview<T> > values;
+};
+
+// int, long, float, double and time values
+template <class T>
+class FixedWidthColumn : public DocValuesColumn
+{
+public:
+    FixedWidthColumn(FilterType type) : type(type) {}
+
+    // a committed column whose values stay in a mapped snapshot
+    FixedWidthColumn(FilterType type, T *mappedValues, unsigned numberOfRecords)
+        : type(type), values(mappedValues, numberOfRecords) {}
+
+    void append(const TypedValue &value) {
+        T columnValue;
+        getColumnValue(value, columnValue);
+        values.getWriteView()->push_back(columnValue);
+    }
+
+    void appendDefault() {
+        values.getWriteView()->push_back(T());
+    }
+
+    void commit() { values.commit(); }
+
+    void merge() { values.merge(&readViewsMgr); }
+
+    DocValuesColumnReadView *getReadView() const {
+        boost::shared_ptr<vectorview<T> > valuesReadView;
+        values.getReadView(valuesReadView);
+        return new FixedWidthColumnReadView<T>(type, valuesReadView);
+    }
+
+    void saveValues(FlatSnapshotWriter &writer) const {
+        boost::shared_ptr<vectorview<T> > valuesReadView;
+        values.getReadView(valuesReadView);
+        if (valuesReadView->size() > 0)
+            writer.append(&valuesReadView->getElement(0), valuesReadView->size() * sizeof(T));
+    }
+
+private:
+    FilterType type;
+    cowvector<T> values;
+    ReadViewManager<T> readViewsMgr;
+};
+
+class DictionaryValueReader
+{
+public:
+    DictionaryValueReader(const vectorview<unsigned> &ordinals, const vectorview<const string *> &dictionary)
+        : ordinals(ordinals), dictionary(dictionary) {}
+    const string &operator()(unsigned recordId) const {
+        return *dictionary.getElement(ordinals.getElement(recordId));
+    }
+private:
+    const vectorview<unsigned> &ordinals;
+    const vectorview<const string *> &dictionary;
+};
+
+class DictionaryColumnReadView : public DocValuesColumnReadView
+{
+public:
+    DictionaryColumnReadView(const boost::shared_ptr<vectorview<unsigned> > &ordinals,
+            const boost::shared_ptr<vectorview<const string *> > &dictionary)
+        : ordinals(ordinals), dictionary(dictionary) {}
+
+    unsigned size() const { return ordinals->size(); }
+
+    void getTypedValue(unsigned recordId, TypedValue &value) const {
+        value.setTypedValue(*dictionary->getElement(ordinals->getElement(recordId)), ATTRIBUTE_TYPE_TEXT);
+    }
+
+    FilterType getType() const { return ATTRIBUTE_TYPE_TEXT; }
+
+    bool selectInRange(const TypedValue *lowerBound, const TypedValue *upperBound, bool negative,
+            const unsigned *recordIds, vector<unsigned> &selection) const {
+        if (!isSelectionInColumn(size(), recordIds, selection))
+            return false;
+        const string noBound;
+        selectPositionsInRange(DictionaryValueReader(*ordinals, *dictionary),
+                lowerBound != NULL, lowerBound != NULL ? lowerBound->getTextTypedValue() : noBound,
+                upperBound != NULL, upperBound != NULL ? upperBound->getTextTypedValue() : noBound,
+                negative, recordIds, selection);
+        return true;
+    }
+
+private:
+    boost::shared_ptr<vectorview<unsigned> > ordinals;
+    boost::shared_ptr<vectorview<const string *> > dictionary;
+};
+
+// text values, as ordinals in a dictionary of the distinct values
+class DictionaryColumn : public DocValuesColumn
+{
+public:
+    DictionaryColumn() {}
+
+    // a committed column whose ordinals stay in a mapped snapshot. The dictionary is copied.
+    DictionaryColumn(unsigned *mappedOrdinals, unsigned numberOfRecords, const char *dictionaryData,
+            const uint64_t *dictionaryOffsets, unsigned dictionarySize)
+        : ordinals(mappedOrdinals, numberOfRecords) {
+        for (unsigned ordinal = 0; ordinal < dictionarySize; ++ordinal) {
+            values.push_back(string(dictionaryData + dictionaryOffsets[ordinal],
+                    dictionaryOffsets[ordinal + 1] - dictionaryOffsets[ordinal]));
+            ordinalOfValue.insert(make_pair(values.back(), ordinal));
+            dictionary.getWriteView()->push_back(&values.back());
+        }
+        dictionary.commit();
+    }
+
+    void append(const TypedValue &value) {
+        appendValue(value.getTextTypedValue());
+    }
+
+    void appendDefault() {
+        appendValue("");
+    }
+
+    void commit() {
+        ordinals.commit();
+        dictionary.commit();
+    }
+
+    void merge() {
+        ordinals.merge(&ordinalsReadViewsMgr);
+        dictionary.merge(&dictionaryReadViewsMgr);
+    }
+
+    DocValuesColumnReadView *getReadView() const {
+        boost::shared_ptr<vectorview<unsigned> > ordinalsReadView;
+        boost::shared_ptr<vectorview<const string *> > dictionaryReadView;
+        ordinals.getReadView(ordinalsReadView);
+        dictionary.getReadView(dictionaryReadView);
+        return new DictionaryColumnReadView(ordinalsReadView, dictionaryReadView);
+    }
+
+    void saveValues(FlatSnapshotWriter &writer) const {
+        boost::shared_ptr<vectorview<unsigned> > ordinalsReadView;
+        ordinals.getReadView(ordinalsReadView);
+        if (ordinalsReadView->size() > 0)
+            writer.append(&ordinalsReadView->getElement(0), ordinalsReadView->size() * sizeof(unsigned));
+    }
+
+    // the values of the committed ordinals are the first ones of the deque
+    unsigned saveDictionary(FlatSnapshotWriter &writer, vector<uint64_t> &offsets) const {
+        boost::shared_ptr<vectorview<const string *> > dictionaryReadView;
+        dictionary.getReadView(dictionaryReadView);
+        for (unsigned ordinal = 0; ordinal < dictionaryReadView->size(); ++ordinal) {
+            offsets.push_back(writer.getCurrentSectionLength());
+            writer.append(values[ordinal].data(), values[ordinal].size());
+        }
+        offsets.push_back(writer.getCurrentSectionLength());
+        return dictionaryReadView->size();
+    }
+
+private:
+    void appendValue(const string &value) {
+        map<string, unsigned>::iterator ordinal = ordinalOfValue.find(value);
+        if (ordinal == ordinalOfValue.end()) {
+            // a deque never moves its elements, so the dictionary can point to them
+            values.push_back(value);
+            ordinal = ordinalOfValue.insert(make_pair(value, (unsigned) dictionary.getWriteView()->size())).first;
+            dictionary.getWriteView()->push_back(&values.back());
+        }
+        ordinals.getWriteView()->push_back(ordinal->second);
+    }
+
+    cowvector<unsigned> ordinals;
+    ReadViewManager<unsigned> ordinalsReadViewsMgr;
+    cowvector<const string *> dictionary;
+    ReadViewManager<const string *> dictionaryReadViewsMgr;
+    // only used by the writer
+    deque<string> values;
+    map<string, unsigned> ordinalOfValue;
+};
+
+DocValuesReadView::~DocValuesReadView() {
+    for (unsigned i = 0; i < columns.size(); ++i)
+        delete columns[i];
+}
+
+bool DocValuesReadView::getBatchOfAttributes(const vector<unsigned> &refiningAttributeIds, unsigned recordId,
+        vector<TypedValue> *typedValues) const {
+    for (unsigned i = 0; i < refiningAttributeIds.size(); ++i) {
+        const DocValuesColumnReadView *column = getColumn(refiningAttributeIds[i]);
+        if (column == NULL || recordId >= column->size())
+            return false;
+    }
+    unsigned firstValue = typedValues->size();
+    typedValues->resize(firstValue + refiningAttributeIds.size());
+    for (unsigned i = 0; i < refiningAttributeIds.size(); ++i) {
+        columns[refiningAttributeIds[i]]->getTypedValue(recordId, typedValues->at(firstValue + i));
+    }
+    return true;
+}
+
+DocValues::DocValues(const Schema *schema) {
+    this->schema = schema;
+    this->storedSchema = Schema::create();
+    RecordSerializerUtil::populateStoredSchema(this->storedSchema, schema);
+    this->recordSerializer = new RecordSerializer(*this->storedSchema);
+
+    const map<string, unsigned> *refiningAttributes = schema->getRefiningAttributes();
+    this->columns.resize(refiningAttributes->size(), NULL);
+    for (map<string, unsigned>::const_iterator attribute = refiningAttributes->begin();
+            attribute != refiningAttributes->end(); ++attribute) {
+        if (schema->isRefiningAttributeMultiValued(attribute->second))
+            continue;
+        FilterType type = schema->getTypeOfRefiningAttribute(attribute->second);
+        DocValuesColumn *column = NULL;
+        switch (type) {
+        case ATTRIBUTE_TYPE_INT:
+            column = new FixedWidthColumn<int>(type);
+            break;
+        case ATTRIBUTE_TYPE_LONG:
+        case ATTRIBUTE_TYPE_TIME:
+            column = new FixedWidthColumn<long>(type);
+            break;
+        case ATTRIBUTE_TYPE_FLOAT:
+            column = new FixedWidthColumn<float>(type);
+            break;
+        case ATTRIBUTE_TYPE_DOUBLE:
+            column = new FixedWidthColumn<double>(type);
+            break;
+        case ATTRIBUTE_TYPE_TEXT:
+            column = new DictionaryColumn();
+            break;
+        default:
+            continue;
+        }
+        if (attribute->second >= this->columns.size())
+            this->columns.resize(attribute->second + 1, NULL);
+        this->columns[attribute->second] = column;
+        this->columnNames.push_back(attribute->first);
+        this->columnAttributeIds.push_back(attribute->second);
+    }
+
+    this->numberOfRecords = 0;
+    this->committed = false;
+    this->mergeRequired = false;
+    pthread_spin_init(&this->readViewSpinlock, 0);
+    // readers see no columns until the commit
+    this->readView.reset(new DocValuesReadView());
+}
+
+DocValues::~DocValues() {
+    this->readView.reset();
+    for (unsigned i = 0; i < this->columns.size(); ++i)
+        delete this->columns[i];
+    delete this->recordSerializer;
+    delete this->storedSchema;
+    pthread_spin_destroy(&this->readViewSpinlock);
+}
+
+void DocValues::addRecord(unsigned recordId, const StoredRecordBuffer &storedRecord) {
+    ASSERT(recordId == this->numberOfRecords);
+    if (storedRecord.length == 0) {
+        for (unsigned i = 0; i < this->columnAttributeIds.size(); ++i)
+            this->columns[this->columnAttributeIds[i]]->appendDefault();
+    } else {
+        vector<TypedValue> typedValues;
+        RecordSerializerUtil::getBatchOfAttributes(this->columnNames, this->schema,
+                *this->recordSerializer, storedRecord.start.get(), &typedValues);
+        for (unsigned i = 0; i < this->columnAttributeIds.size(); ++i)
+            this->columns[this->columnAttributeIds[i]]->append(typedValues[i]);
+    }
+    ++this->numberOfRecords;
+    this->mergeRequired = true;
+}
+
+void DocValues::commit() {
+    if (this->committed)
+        return;
+    for (unsigned i = 0; i < this->columnAttributeIds.size(); ++i)
+        this->columns[this->columnAttributeIds[i]]->commit();
+    this->committed = true;
+    this->mergeRequired = false;
+    this->publishReadView();
+}
+
+void DocValues::merge() {
+    if (!this->committed || !this->mergeRequired)
+        return;
+    for (unsigned i = 0; i < this->columnAttributeIds.size(); ++i)
+        this->columns[this->columnAttributeIds[i]]->merge();
+    this->mergeRequired = false;
+    this->publishReadView();
+}
+
+void DocValues::getReadView(boost::shared_ptr<const DocValuesReadView> &readView) const {
+    pthread_spin_lock(&this->readViewSpinlock);
+    readView = this->readView;
+    pthread_spin_unlock(&this->readViewSpinlock);
+}
+
+// Readers take all the columns at once, so the columns of one view always cover the same records.
+void DocValues::publishReadView() {
+    DocValuesReadView *newReadView = new DocValuesReadView();
+    newReadView->columns.resize(this->columns.size(), NULL);
+    for (unsigned i = 0; i < this->columnAttributeIds.size(); ++i) {
+        unsigned attributeId = this->columnAttributeIds[i];
+        newReadView->columns[attributeId] = this->columns[attributeId]->getReadView();
+    }
+    newReadView->mapping = this->mapping;
+    boost::shared_ptr<const DocValuesReadView> oldReadView;
+    pthread_spin_lock(&this->readViewSpinlock);
+    oldReadView = this->readView;
+    this->readView.reset(newReadView);
+    pthread_spin_unlock(&this->readViewSpinlock);
+    // the old view is released outside the lock
+}
+
+void DocValues::save(FlatSnapshotWriter &writer) const {
+    ASSERT(this->committed && !this->mergeRequired);
+    FlatDocValuesInfo info;
+    info.numberOfRecords = this->numberOfRecords;
+    writer.addSection(FlatSection_DocValuesInfo, &info, sizeof(info));
+
+    vector<FlatDocValuesColumn> flatColumns(this->columnAttributeIds.size());
+    static const char padding[FLAT_ARRAY_ALIGNMENT] = { 0 };
+    writer.beginSection(FlatSection_DocValuesArrays);
+    for (unsigned i = 0; i < this->columnAttributeIds.size(); ++i) {
+        const unsigned attributeId = this->columnAttributeIds[i];
+        unsigned remainder = writer.getCurrentSectionLength() % FLAT_ARRAY_ALIGNMENT;
+        if (remainder != 0)
+            writer.append(padding, FLAT_ARRAY_ALIGNMENT - remainder);
+        flatColumns[i].refiningAttributeId = attributeId;
+        flatColumns[i].type = this->schema->getTypeOfRefiningAttribute(attributeId);
+        flatColumns[i].valuesOffset = writer.getCurrentSectionLength();
+        this->columns[attributeId]->saveValues(writer);
+    }
+    writer.endSection();
+
+    vector<uint64_t> dictionaryOffsets;
+    writer.beginSection(FlatSection_DocValuesDictionaryData);
+    for (unsigned i = 0; i < this->columnAttributeIds.size(); ++i) {
+        flatColumns[i].firstDictionaryOffset = dictionaryOffsets.size();
+        flatColumns[i].dictionarySize =
+                this->columns[this->columnAttributeIds[i]]->saveDictionary(writer, dictionaryOffsets);
+    }
+    writer.endSection();
+    writer.addSection(FlatSection_DocValuesDictionaryOffsets,
+            dictionaryOffsets.empty() ? NULL : &dictionaryOffsets[0], dictionaryOffsets.size() * sizeof(uint64_t));
+    writer.addSection(FlatSection_DocValuesColumns, flatColumns.empty() ? NULL : &flatColumns[0],
+            flatColumns.size() * sizeof(FlatDocValuesColumn));
+}
+
+// the width of the elements of the saved array of a column of type
+static unsigned getValueWidth(FilterType type) {
+    switch (type) {
+    case ATTRIBUTE_TYPE_INT:
+        return sizeof(int);
+    case ATTRIBUTE_TYPE_LONG:
+    case ATTRIBUTE_TYPE_TIME:
+        return sizeof(long);
+    case ATTRIBUTE_TYPE_FLOAT:
+        return sizeof(float);
+    case ATTRIBUTE_TYPE_DOUBLE:
+        return sizeof(double);
+    case ATTRIBUTE_TYPE_TEXT:
+        return sizeof(unsigned);
+    default:
+        return 0;
+    }
+}
+
+bool DocValues::load(const FlatSnapshotReader &reader, unsigned numberOfRecords) {
+    ASSERT(!this->committed && this->numberOfRecords == 0);
+    const string &fileName = reader.getMappedFile()->getFileName();
+    uint64_t length, numberOfColumns, numberOfDictionaryOffsets, dictionaryDataLength, arraysLength;
+    const FlatDocValuesInfo *info = reader.getSectionAsArray<FlatDocValuesInfo>(FlatSection_DocValuesInfo, length);
+    const FlatDocValuesColumn *flatColumns =
+            reader.getSectionAsArray<FlatDocValuesColumn>(FlatSection_DocValuesColumns, numberOfColumns);
+    const char *arrays = reader.getSection(FlatSection_DocValuesArrays, arraysLength);
+    const uint64_t *dictionaryOffsets =
+            reader.getSectionAsArray<uint64_t>(FlatSection_DocValuesDictionaryOffsets, numberOfDictionaryOffsets);
+    const char *dictionaryData = reader.getSection(FlatSection_DocValuesDictionaryData, dictionaryDataLength);
+    if (length != 1)
+        throw std::runtime_error("Corrupted doc values in snapshot " + fileName);
+
+    // the columns must be the ones of the schema, and cover the records of the forward index
+    if (info->numberOfRecords != numberOfRecords || numberOfColumns != this->columnAttributeIds.size())
+        return false;
+    for (unsigned i = 0; i < numberOfColumns; ++i) {
+        const FlatDocValuesColumn &flatColumn = flatColumns[i];
+        if (flatColumn.refiningAttributeId != this->columnAttributeIds[i]
+                || flatColumn.type != (uint32_t) this->schema->getTypeOfRefiningAttribute(flatColumn.refiningAttributeId))
+            return false;
+        const uint64_t width = getValueWidth((FilterType) flatColumn.type);
+        if (flatColumn.valuesOffset % FLAT_ARRAY_ALIGNMENT != 0 || flatColumn.valuesOffset > arraysLength
+                || numberOfRecords * width > arraysLength - flatColumn.valuesOffset)
+            throw std::runtime_error("Corrupted doc values in snapshot " + fileName);
+        if (flatColumn.type != ATTRIBUTE_TYPE_TEXT)
+            continue;
+        if (flatColumn.firstDictionaryOffset > numberOfDictionaryOffsets
+                || flatColumn.dictionarySize >= numberOfDictionaryOffsets - flatColumn.firstDictionaryOffset)
+            throw std::runtime_error("Corrupted doc values in snapshot " + fileName);
+        const uint64_t *offsets = dictionaryOffsets + flatColumn.firstDictionaryOffset;
+        for (unsigned ordinal = 0; ordinal < flatColumn.dictionarySize; ++ordinal) {
+            if (offsets[ordinal] > offsets[ordinal + 1] || offsets[ordinal + 1] > dictionaryDataLength)
+                throw std::runtime_error("Corrupted doc values in snapshot " + fileName);
+        }
+    }
+
+    for (unsigned i = 0; i < numberOfColumns; ++i) {
+        const FlatDocValuesColumn &flatColumn = flatColumns[i];
+        // the mapping is private, so the arrays can be wrapped by cowvectors like the forward lists
+        char *values = (char *) arrays + flatColumn.valuesOffset;
+        DocValuesColumn *column = NULL;
+        switch (flatColumn.type) {
+        case ATTRIBUTE_TYPE_INT:
+            column = new FixedWidthColumn<int>(ATTRIBUTE_TYPE_INT, (int *) values, numberOfRecords);
+            break;
+        case ATTRIBUTE_TYPE_LONG:
+        case ATTRIBUTE_TYPE_TIME:
+            column = new FixedWidthColumn<long>((FilterType) flatColumn.type, (long *) values, numberOfRecords);
+            break;
+        case ATTRIBUTE_TYPE_FLOAT:
+            column = new FixedWidthColumn<float>(ATTRIBUTE_TYPE_FLOAT, (float *) values, numberOfRecords);
+            break;
+        case ATTRIBUTE_TYPE_DOUBLE:
+            column = new FixedWidthColumn<double>(ATTRIBUTE_TYPE_DOUBLE, (double *) values, numberOfRecords);
+            break;
+        case ATTRIBUTE_TYPE_TEXT:
+            column = new DictionaryColumn((unsigned *) values, numberOfRecords, dictionaryData,
+                    dictionaryOffsets + flatColumn.firstDictionaryOffset, flatColumn.dictionarySize);
+            break;
+        }
+        delete this->columns[flatColumn.refiningAttributeId];
+        this->columns[flatColumn.refiningAttributeId] = column;
+    }
+
+    this->mapping = reader.getMappedFile();
+    this->numberOfRecords = numberOfRecords;
+    this->committed = true;
+    this->mergeRequired = false;
+    this->publishReadView();
+    return true;
+}
+
+}
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __INDEX_DOCVALUES_H__
+#define __INDEX_DOCVALUES_H__
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <instantsearch/Record.h>
+#include <instantsearch/Schema.h>
+#include <instantsearch/TypedValue.h>
+#include "util/mypthread.h"
+
+namespace srch2
+{
+namespace util
+{
+class RecordSerializer;
+class MappedFile;
+}
+
+namespace instantsearch
+{
+
+class FlatSnapshotWriter;
+class FlatSnapshotReader;
+
+/*
+ *  The committed values of one refining attribute, indexed by internal record id.
+ */
+class DocValuesColumnReadView
+{
+public:
+    virtual ~DocValuesColumnReadView() {}
+    // the number of records covered by the column
+    virtual unsigned size() const = 0;
+    // recordId must be less than size()
+    virtual void getTypedValue(unsigned recordId, TypedValue &value) const = 0;
+    virtual FilterType getType() const = 0;
+
+    /*
+     * Narrows selection, the positions in recordIds of the records of a batch that are still selected,
+     * to the records whose value is in [lowerBound, upperBound], or out of it if negative is true.
+     * A NULL bound is unbounded; the bounds must have the type of the column. selection must be
+     * sorted and stays sorted. Returns false without changing selection if one of the selected
+     * records is newer than the column.
+     */
+    virtual bool selectInRange(const TypedValue *lowerBound, const TypedValue *upperBound, bool negative,
+            const unsigned *recordIds, std::vector<unsigned> &selection) const = 0;
+};
+
+/*
+ *  The read view of all the columns. It is published by DocValues::commit() and DocValues::merge()
+ *  and held by a reader for its whole query (see IndexReadStateSharedPtr_Token).
+ */
+class DocValuesReadView
+{
+public:
+    ~DocValuesReadView();
+
+    // NULL if the attribute has no column, i.e., it is multi-valued
+    const DocValuesColumnReadView *getColumn(unsigned refiningAttributeId) const {
+        return refiningAttributeId < columns.size() ? columns[refiningAttributeId] : NULL;
+    }
+
+    /*
+     * Appends the values of the refining attributes of a record to typedValues, in the order of
+     * refiningAttributeIds. Returns false without appending anything if one of the attributes has
+     * no column or the record is newer than this read view. The caller then decodes the stored
+     * record with RecordSerializerUtil::getBatchOfAttributes() instead.
+     */
+    bool getBatchOfAttributes(const std::vector<unsigned> &refiningAttributeIds, unsigned recordId,
+            std::vector<TypedValue> *typedValues) const;
+
+private:
+    friend class DocValues;
+    // indexed by refining attribute id, owned by the view
+    std::vector<DocValuesColumnReadView *> columns;
+    // the snapshot the arrays of loaded columns point into, if any
+    boost::shared_ptr<srch2::util::MappedFile> mapping;
+};
+
+class DocValuesColumn;
+
+/*
+ *  A columnar copy of the single-valued refining attributes of the records, indexed by internal
+ *  record id, so that filters, facets and sorts read a value with an array lookup instead of
+ *  decoding the stored record of the forward list.
+ *
+ *  Int, long, float, double and time attributes are kept in fixed-width arrays. Text attributes
+ *  are dictionary encoded: the array keeps the ordinal of the value of each record in a dictionary
+ *  of the distinct values. The values are lower-cased like the ones RecordSerializerUtil decodes.
+ *  Multi-valued attributes have no column.
+ *
+ *  The arrays are cowvectors, so appends are invisible to readers until merge() publishes a new
+ *  read view. Record ids are never reused, so the columns only grow; the values of deleted records
+ *  stay in place and readers check the validity of a record in the forward index. The columns are
+ *  saved as a flat snapshot, whose arrays are mapped when the index is loaded. Indexes saved without
+ *  one rebuild the columns from the stored records.
+ */
+class DocValues
+{
+public:
+    DocValues(const Schema *schema);
+    ~DocValues();
+
+    // Appends the values of the next record, decoded from its stored record. An empty stored record
+    // (e.g., of a record freed before the index was saved) appends default values.
+    void addRecord(unsigned recordId, const StoredRecordBuffer &storedRecord);
+
+    // the number of records appended so far
+    unsigned getNumberOfRecords() const { return numberOfRecords; }
+
+    // called at the end of the bulk load. The columns are not visible to readers before.
+    void commit();
+    // publishes the records appended since the last merge
+    void merge();
+
+    void getReadView(boost::shared_ptr<const DocValuesReadView> &readView) const;
+
+    /*
+     * Adds the columns to a flat snapshot: FlatSection_DocValuesInfo, FlatSection_DocValuesColumns with
+     * a header per column, FlatSection_DocValuesArrays with the value (or ordinal) array of every column
+     * and FlatSection_DocValuesDictionaryOffsets/Data with the dictionaries of the text columns.
+     * Called by the writer after a merge.
+     */
+    void save(FlatSnapshotWriter &writer) const;
+    /*
+     * Loads the committed columns of a snapshot written by save(), instead of adding the records and
+     * committing. The arrays stay in the mapping of the snapshot; only the dictionaries are copied.
+     * Returns false without changing anything if the snapshot was saved with other columns or another
+     * number of records than numberOfRecords. Throws std::runtime_error if the sections are corrupted.
+     */
+    bool load(const FlatSnapshotReader &reader, unsigned numberOfRecords);
+
+private:
+    void publishReadView();
+
+    // indexed by refining attribute id, NULL for the attributes without a column
+    std::vector<DocValuesColumn *> columns;
+    std::vector<std::string> columnNames;
+    std::vector<unsigned> columnAttributeIds;
+
+    // the schema of the stored records, used to decode them
+    Schema *storedSchema;
+    const Schema *schema;
+    srch2::util::RecordSerializer *recordSerializer;
+
+    unsigned numberOfRecords;
+    bool committed;
+    bool mergeRequired;
+
+    boost::shared_ptr<const DocValuesReadView> readView;
+    mutable pthread_spinlock_t readViewSpinlock;
+    // the snapshot the columns were loaded from, NULL if they were built from the records
+    boost::shared_ptr<srch2::util::MappedFile> mapping;
+};
+
+}
+}
+
+#endif /* __INDEX_DOCVALUES_H__ */
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ExternalRecordIdMap.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "serialization/FlatSnapshot.h"
+#include "util/MappedFile.h"
+#include "util/ULEB128.h"
+#include "util/Assert.h"
+
+using namespace std;
+using srch2::util::ULEB128;
+using srch2::util::MappedFile;
+using srch2::util::EpochManager;
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+// keys are stored in chunks of at least this size, which never move
+static const unsigned KEY_CHUNK_SIZE = 64 * 1024;
+static const unsigned MINIMUM_CAPACITY = 16;
+// bytes of the ULEB128 encoding of a 32 bit length
+static const unsigned MAX_KEY_LENGTH_BYTES = 5;
+
+/*
+ * The slot of a saved table. keyOffset is the offset of the key in FlatSection_ExternalRecordIdMapKeys,
+ * or EMPTY_KEY_OFFSET if the slot is empty.
+ */
+struct FlatExternalRecordIdMapSlot {
+    uint64_t keyOffset;
+    uint32_t hash;
+    uint32_t value;
+};
+static const uint64_t EMPTY_KEY_OFFSET = (uint64_t) -1;
+
+class ExternalRecordIdMap::Table
+{
+public:
+    Table(unsigned capacity) : capacity(capacity), numberOfKeys(0), numberOfUsedSlots(0), chunkUsed(0) {
+        // the capacity is a power of two, so that a hash is turned into a slot with a mask
+        ASSERT((capacity & (capacity - 1)) == 0);
+        this->slots = new Slot[capacity];
+        memset(this->slots, 0, capacity * sizeof(Slot));
+    }
+
+    ~Table() {
+        delete[] this->slots;
+        for (unsigned i = 0; i < this->chunks.size(); ++i)
+            delete[] this->chunks[i];
+    }
+
+    // Returns the slot of the key, or the empty slot that ends its probe sequence. Readers call it
+    // while the writer fills other slots.
+    Slot *findSlot(const char *key, unsigned length, uint32_t hash) const {
+        const unsigned mask = this->capacity - 1;
+        for (unsigned index = hash & mask; ; index = (index + 1) & mask) {
+            Slot *slot = this->slots + index;
+            const char *slotKey = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+            if (slotKey == NULL)
+                return slot;
+            if (slot->hash == hash && isKeyEqual(slotKey, key, length))
+                return slot;
+        }
+    }
+
+    // Copies the key into the arena, prefixed by its length
+    const char *storeKey(const char *key, unsigned length) {
+        uint8_t lengthBytes[MAX_KEY_LENGTH_BYTES];
+        short numberOfLengthBytes;
+        ULEB128::uInt32ToVarLengthBytes(length, lengthBytes, &numberOfLengthBytes);
+        const unsigned size = numberOfLengthBytes + length;
+        if (this->chunks.empty() || this->chunkUsed + size > KEY_CHUNK_SIZE) {
+            this->chunks.push_back(new char[std::max(size, KEY_CHUNK_SIZE)]);
+            this->chunkUsed = 0;
+        }
+        char *storedKey = this->chunks.back() + this->chunkUsed;
+        memcpy(storedKey, lengthBytes, numberOfLengthBytes);
+        memcpy(storedKey + numberOfLengthBytes, key, length);
+        // a key longer than a chunk fills its own chunk
+        this->chunkUsed += size;
+        return storedKey;
+    }
+
+    // the key must be in the empty slot returned by findSlot(), which is published last
+    void fillSlot(Slot *slot, const char *key, unsigned length, uint32_t hash, unsigned value) {
+        slot->hash = hash;
+        slot->value = value;
+        __atomic_store_n(&slot->key, this->storeKey(key, length), __ATOMIC_RELEASE);
+        ++this->numberOfUsedSlots;
+        ++this->numberOfKeys;
+    }
+
+    static const char *getKey(const char *storedKey, unsigned &length) {
+        short numberOfLengthBytes;
+        ULEB128::varLengthBytesToUInt32((const uint8_t *) storedKey, &length, &numberOfLengthBytes);
+        return storedKey + numberOfLengthBytes;
+    }
+
+    static bool isKeyEqual(const char *storedKey, const char *key, unsigned length) {
+        unsigned storedLength;
+        const char *storedKeyData = getKey(storedKey, storedLength);
+        return storedLength == length && memcmp(storedKeyData, key, length) == 0;
+    }
+
+    Slot *slots;
+    const unsigned capacity;
+    // keys not erased, and slots with a key (erased or not). Only changed by the writer.
+    unsigned numberOfKeys;
+    unsigned numberOfUsedSlots;
+
+    std::vector<char *> chunks;
+    unsigned chunkUsed;
+    // the snapshot that holds the keys of a loaded table
+    boost::shared_ptr<MappedFile> mapping;
+};
+
+ExternalRecordIdMap::ExternalRecordIdMap(): retiredTables(epochs) {
+    this->table = new Table(MINIMUM_CAPACITY);
+}
+
+ExternalRecordIdMap::~ExternalRecordIdMap() {
+    this->retiredTables.clear();
+    delete this->table;
+}
+
+// FNV-1a followed by the finalizer of MurmurHash3, which spreads the bits over the mask of the table
+uint32_t ExternalRecordIdMap::getHash(const char *key, unsigned length) {
+    uint32_t hash = 2166136261u;
+    for (unsigned i = 0; i < length; ++i) {
+        hash ^= (uint8_t) key[i];
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+const ExternalRecordIdMap::Table *ExternalRecordIdMap::getTable() const {
+    return __atomic_load_n(&this->table, __ATOMIC_ACQUIRE);
+}
+
+void ExternalRecordIdMap::publishTable(Table *newTable) {
+    const Table *oldTable = this->table;
+    __atomic_store_n(&this->table, newTable, __ATOMIC_RELEASE);
+    // readers that loaded the old table before the store are in an epoch the retire tag is not older than
+    this->retiredTables.retire(boost::shared_ptr<const Table>(oldTable));
+}
+
+void ExternalRecordIdMap::rehash(unsigned minimumSize) {
+    const Table *oldTable = this->table;
+    unsigned capacity = MINIMUM_CAPACITY;
+    // at most half full after the rehash
+    while (capacity < 2 * minimumSize)
+        capacity *= 2;
+    Table *newTable = new Table(capacity);
+    for (unsigned i = 0; i < oldTable->capacity; ++i) {
+        const Slot &slot = oldTable->slots[i];
+        if (slot.key == NULL || slot.value == ERASED_VALUE)
+            continue;
+        unsigned length;
+        const char *key = Table::getKey(slot.key, length);
+        newTable->fillSlot(newTable->findSlot(key, length, slot.hash), key, length, slot.hash, slot.value);
+    }
+    this->publishTable(newTable);
+}
+
+void ExternalRecordIdMap::setValue(const string &key, unsigned value) {
+    ASSERT(value != ERASED_VALUE);
+    boost::mutex::scoped_lock lock(this->writerMutex);
+    // old tables are released here too, not only when the next one is published
+    if (this->retiredTables.size() > 0)
+        this->retiredTables.reclaim();
+    const uint32_t hash = getHash(key.data(), key.size());
+    Table *table = this->table;
+    Slot *slot = table->findSlot(key.data(), key.size(), hash);
+    if (slot->key != NULL) {
+        if (slot->value == ERASED_VALUE)
+            ++table->numberOfKeys;
+        __atomic_store_n(&slot->value, value, __ATOMIC_RELEASE);
+        return;
+    }
+    // keep the table at most three quarters full, counting the erased slots
+    if (4 * (table->numberOfUsedSlots + 1) > 3 * table->capacity) {
+        this->rehash(table->numberOfKeys + 1);
+        table = this->table;
+        slot = table->findSlot(key.data(), key.size(), hash);
+    }
+    table->fillSlot(slot, key.data(), key.size(), hash, value);
+}
+
+bool ExternalRecordIdMap::getValue(const string &key, unsigned &value) const {
+    const uint32_t hash = getHash(key.data(), key.size());
+    EpochManager::ReaderSlot *readerSlot = this->epochs.enter();
+    const Slot *slot = this->getTable()->findSlot(key.data(), key.size(), hash);
+    unsigned slotValue = ERASED_VALUE;
+    if (slot->key != NULL)
+        slotValue = __atomic_load_n(&slot->value, __ATOMIC_ACQUIRE);
+    EpochManager::exit(readerSlot);
+    if (slotValue == ERASED_VALUE)
+        return false;
+    value = slotValue;
+    return true;
+}
+
+void ExternalRecordIdMap::erase(const string &key) {
+    boost::mutex::scoped_lock lock(this->writerMutex);
+    Table *table = this->table;
+    Slot *slot = table->findSlot(key.data(), key.size(), getHash(key.data(), key.size()));
+    if (slot->key == NULL || slot->value == ERASED_VALUE)
+        return;
+    __atomic_store_n(&slot->value, ERASED_VALUE, __ATOMIC_RELEASE);
+    --table->numberOfKeys;
+}
+
+unsigned ExternalRecordIdMap::size() const {
+    EpochManager::ReaderSlot *readerSlot = this->epochs.enter();
+    unsigned numberOfKeys = this->getTable()->numberOfKeys;
+    EpochManager::exit(readerSlot);
+    return numberOfKeys;
+}
+
+void ExternalRecordIdMap::copyTo(map<string, unsigned> &data) const {
+    EpochManager::ReaderSlot *readerSlot = this->epochs.enter();
+    const Table *table = this->getTable();
+    for (unsigned i = 0; i < table->capacity; ++i) {
+        const Slot &slot = table->slots[i];
+        if (slot.key == NULL || slot.value == ERASED_VALUE)
+            continue;
+        unsigned length;
+        const char *key = Table::getKey(slot.key, length);
+        data[string(key, length)] = slot.value;
+    }
+    EpochManager::exit(readerSlot);
+}
+
+void ExternalRecordIdMap::save(FlatSnapshotWriter &writer) const {
+    boost::mutex::scoped_lock lock(this->writerMutex);
+    const Table *table = this->table;
+    vector<FlatExternalRecordIdMapSlot> flatSlots(table->capacity);
+    writer.beginSection(FlatSection_ExternalRecordIdMapKeys);
+    for (unsigned i = 0; i < table->capacity; ++i) {
+        const Slot &slot = table->slots[i];
+        FlatExternalRecordIdMapSlot &flatSlot = flatSlots[i];
+        if (slot.key == NULL) {
+            flatSlot.keyOffset = EMPTY_KEY_OFFSET;
+            flatSlot.hash = 0;
+            flatSlot.value = 0;
+            continue;
+        }
+        unsigned length;
+        const char *key = Table::getKey(slot.key, length);
+        flatSlot.keyOffset = writer.getCurrentSectionLength();
+        flatSlot.hash = slot.hash;
+        flatSlot.value = slot.value;
+        writer.append(slot.key, (key - slot.key) + length);
+    }
+    writer.endSection();
+    writer.addSection(FlatSection_ExternalRecordIdMapSlots, &flatSlots[0],
+            flatSlots.size() * sizeof(FlatExternalRecordIdMapSlot));
+}
+
+bool ExternalRecordIdMap::hasSnapshot(const FlatSnapshotReader &reader) {
+    return reader.hasSection(FlatSection_ExternalRecordIdMapSlots);
+}
+
+void ExternalRecordIdMap::load(const FlatSnapshotReader &reader) {
+    const string &fileName = reader.getMappedFile()->getFileName();
+    uint64_t keysLength, numberOfSlots;
+    const char *keys = reader.getSection(FlatSection_ExternalRecordIdMapKeys, keysLength);
+    const FlatExternalRecordIdMapSlot *flatSlots =
+            reader.getSectionAsArray<FlatExternalRecordIdMapSlot>(FlatSection_ExternalRecordIdMapSlots, numberOfSlots);
+    if (numberOfSlots < MINIMUM_CAPACITY || (numberOfSlots & (numberOfSlots - 1)) != 0 || numberOfSlots > (1u << 31))
+        throw std::runtime_error("Corrupted external record id map in snapshot " + fileName);
+
+    boost::mutex::scoped_lock lock(this->writerMutex);
+    Table *newTable = new Table(numberOfSlots);
+    for (unsigned i = 0; i < numberOfSlots; ++i) {
+        const FlatExternalRecordIdMapSlot &flatSlot = flatSlots[i];
+        if (flatSlot.keyOffset == EMPTY_KEY_OFFSET)
+            continue;
+        // the length of the key and the key must be inside the section
+        bool isValid = false;
+        uint64_t keyEnd = flatSlot.keyOffset;
+        uint64_t length = 0;
+        for (unsigned b = 0; b < MAX_KEY_LENGTH_BYTES && keyEnd < keysLength; ++b) {
+            uint8_t byte = (uint8_t) keys[keyEnd++];
+            length |= (uint64_t) (byte & 0x7F) << (7 * b);
+            if ((byte & 0x80) == 0) {
+                isValid = length <= keysLength - keyEnd;
+                break;
+            }
+        }
+        if (!isValid) {
+            delete newTable;
+            throw std::runtime_error("Corrupted external record id map in snapshot " + fileName);
+        }
+        Slot &slot = newTable->slots[i];
+        slot.key = keys + flatSlot.keyOffset;
+        slot.hash = flatSlot.hash;
+        slot.value = flatSlot.value;
+        ++newTable->numberOfUsedSlots;
+        if (slot.value != ERASED_VALUE)
+            ++newTable->numberOfKeys;
+    }
+    // a probe sequence must always end with an empty slot
+    if (newTable->numberOfUsedSlots >= numberOfSlots) {
+        delete newTable;
+        throw std::runtime_error("Corrupted external record id map in snapshot " + fileName);
+    }
+    newTable->mapping = reader.getMappedFile();
+    this->publishTable(newTable);
+}
+
+}
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __INDEX_EXTERNALRECORDIDMAP_H__
+#define __INDEX_EXTERNALRECORDIDMAP_H__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/split_member.hpp>
+#include "util/EpochManager.h"
+
+namespace srch2
+{
+namespace util
+{
+class MappedFile;
+}
+
+namespace instantsearch
+{
+
+class FlatSnapshotWriter;
+class FlatSnapshotReader;
+
+/*
+ *  The map from the external record ids (primary keys) to the internal record ids.
+ *
+ *  It is an open-addressing hash table with linear probing. A slot keeps the hash of its key, its value
+ *  and a pointer to the key, which is stored once in an arena of the table prefixed by its length. The
+ *  keys of a loaded table stay in the mapped snapshot file instead.
+ *
+ *  Readers never lock the table against the writer. The writer fills a new slot before it publishes
+ *  its key pointer, so a reader either sees a complete slot or an empty one. An erased slot keeps its
+ *  key with the value ERASED_VALUE, and only the same key can take it again, so the key of a slot never
+ *  changes under a reader. When the table is too full, the writer builds a larger table with the live
+ *  entries only (and their keys in a new arena) and publishes it with an atomic store. Readers pin an
+ *  epoch while they probe a table instead of taking a lock or a reference, and the old table is released
+ *  once no reader that could have loaded it is still in (see util/EpochManager.h).
+ *
+ *  Writers are serialized by a mutex.
+ */
+class ExternalRecordIdMap
+{
+public:
+    // the internal record id must be smaller than this value
+    static const unsigned ERASED_VALUE = (unsigned) -1;
+
+    ExternalRecordIdMap();
+    ~ExternalRecordIdMap();
+
+    void setValue(const std::string &key, unsigned value);
+    bool getValue(const std::string &key, unsigned &value) const;
+    void erase(const std::string &key);
+
+    // number of keys in the map
+    unsigned size() const;
+
+    /*
+     * Adds the table to a flat snapshot: FlatSection_ExternalRecordIdMapKeys with the keys and
+     * FlatSection_ExternalRecordIdMapSlots with the slots, where each key pointer is replaced by the
+     * offset of the key. The hash function is part of the format.
+     */
+    void save(FlatSnapshotWriter &writer) const;
+    /*
+     * Replaces the content of the map with the table of a snapshot written by save(). The slots are
+     * copied as they are, so nothing is rehashed, and the keys stay in the mapping of the snapshot.
+     * Throws std::runtime_error if the sections are corrupted.
+     */
+    void load(const FlatSnapshotReader &reader);
+    static bool hasSnapshot(const FlatSnapshotReader &reader);
+
+private:
+    struct Slot {
+        // NULL if the slot is empty
+        const char *key;
+        uint32_t hash;
+        unsigned value;
+    };
+    class Table;
+
+    // the published table, only valid while the caller has an epoch pinned or is the writer
+    const Table *getTable() const;
+    void publishTable(Table *newTable);
+    // builds a table with the live entries of the current table, with room for at least minimumSize keys
+    void rehash(unsigned minimumSize);
+
+    static uint32_t getHash(const char *key, unsigned length);
+
+    Table *table;
+    // the epochs of the readers of this map
+    mutable srch2::util::EpochManager epochs;
+    // the tables replaced by the writer, released when no reader can use them anymore
+    srch2::util::EpochRetireList retiredTables;
+    mutable boost::mutex writerMutex;
+
+    friend class boost::serialization::access;
+
+    // Boost archives keep a std::map, the format of the indexes saved before flat snapshots.
+    template<class Archive>
+    void save(Archive & ar, const unsigned int version) const {
+        std::map<std::string, unsigned> data;
+        this->copyTo(data);
+        ar & data;
+    }
+    template<class Archive>
+    void load(Archive & ar, const unsigned int version) {
+        std::map<std::string, unsigned> data;
+        ar & data;
+        for (std::map<std::string, unsigned>::const_iterator entry = data.begin(); entry != data.end(); ++entry)
+            this->setValue(entry->first, entry->second);
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    void copyTo(std::map<std::string, unsigned> &data) const;
+};
+
+}
+}
+
+#endif /* __INDEX_EXTERNALRECORDIDMAP_H__ */
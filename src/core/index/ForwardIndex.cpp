@@ -38,8 +38,11 @@
 #include "boost/algorithm/string/split.hpp"
 #include "boost/algorithm/string/classification.hpp"
 #include <boost/array.hpp>
+#include <boost/static_assert.hpp>
 #include "util/RecordSerializerUtil.h"
+#include "serialization/FlatSnapshot.h"
 #include <instantsearch/Ranker.h>
+#include <stdexcept>
 
 using srch2::util::Logger;
 using std::string;
@@ -53,7 +56,12 @@ namespace instantsearch {
 
 
 
-ForwardIndex::ForwardIndex(const SchemaInternal* schemaInternal) {
+// number of records in a segment of the snapshot
+static const unsigned FORWARD_INDEX_SNAPSHOT_SEGMENT_SIZE = 16384;
+
+ForwardIndex::ForwardIndex(const SchemaInternal* schemaInternal) :
+        forwardListSegments("lists", FORWARD_INDEX_SNAPSHOT_SEGMENT_SIZE),
+        storedRecordSegments("records", FORWARD_INDEX_SNAPSHOT_SEGMENT_SIZE) {
     this->forwardListDirectory = new cowvector<ForwardListPtr>();
     this->schemaInternal = schemaInternal;
     this->commited_WriteView = false;
@@ -62,7 +70,9 @@ ForwardIndex::ForwardIndex(const SchemaInternal* schemaInternal) {
 }
 
 ForwardIndex::ForwardIndex(const SchemaInternal* schemaInternal,
-        unsigned expectedNumberOfDocumentsToInitialize) {
+        unsigned expectedNumberOfDocumentsToInitialize) :
+        forwardListSegments("lists", FORWARD_INDEX_SNAPSHOT_SEGMENT_SIZE),
+        storedRecordSegments("records", FORWARD_INDEX_SNAPSHOT_SEGMENT_SIZE) {
     this->forwardListDirectory = new cowvector<ForwardListPtr>(
             expectedNumberOfDocumentsToInitialize);
     this->schemaInternal = schemaInternal;
@@ -105,11 +115,13 @@ unsigned ForwardIndex::getTotalNumberOfForwardLists_ReadView() const
 void ForwardIndex::setDeleteFlag(unsigned internalRecordId)
 {
     this->forwardListDirectory->getWriteView()->at(internalRecordId).second = false;
+    this->forwardListSegments.markChanged(internalRecordId);
 }
 
 void ForwardIndex::resetDeleteFlag(unsigned internalRecordId)
 {
     this->forwardListDirectory->getWriteView()->at(internalRecordId).second = true;
+    this->forwardListSegments.markChanged(internalRecordId);
 }
 
 
@@ -248,6 +260,7 @@ bool ForwardIndex::appendRoleToResource(shared_ptr<vectorview<ForwardListPtr> >
 
 	if(flPtr.second){
 		flPtr.first->appendRolesToResource(roleIds);
+		this->forwardListSegments.markChanged(recordId);
 		return true;
 	}
 	return false;
@@ -266,6 +279,7 @@ bool ForwardIndex::deleteRoleFromResource(shared_ptr<vectorview<ForwardListPtr>
 
 	if(flPtr.second){
 		flPtr.first->deleteRolesFromResource(roleIds);
+		this->forwardListSegments.markChanged(recordId);
 		return true;
 	}
 	return false;
@@ -283,6 +297,7 @@ bool ForwardIndex::deleteRoleFromResource(shared_ptr<vectorview<ForwardListPtr>
 
 	if(flPtr.second){
 		flPtr.first->deleteRoleFromResource(roleId);
+		this->forwardListSegments.markChanged(recordId);
 		return true;
 	}
 	return false;
@@ -299,6 +314,8 @@ RecordAcl* ForwardIndex::getRecordAccessList(shared_ptr<vectorview<ForwardListPt
 	ForwardListPtr flPtr = forwardListDirectoryReadView->getElement(recordId);
 
 	if(flPtr.second){
+		// the caller may change the access list
+		this->forwardListSegments.markChanged(recordId);
 		return flPtr.first->getAccessList();
 	}
 	return NULL;
@@ -333,16 +350,18 @@ void ForwardIndex::merge()
     }
 }
 
-void ForwardIndex::freeSpaceOfDeletedRecords() {
+void ForwardIndex::freeSpaceOfDeletedRecords(vector<ForwardList *> &freedForwardLists) {
   vectorview<ForwardListPtr> *writeView = this->forwardListDirectory->getWriteView();
   for(boost::unordered_set<unsigned>::iterator iter = this->deletedRecordInternalIds.begin();
       iter != this->deletedRecordInternalIds.end(); ++ iter) {
         unsigned internalRecordId = *iter;
-        // free the memory if it's no longer valid
+        // unlink the list if it's no longer valid. The caller frees it.
         ASSERT(writeView->at(internalRecordId).second == false);
         ASSERT(writeView->at(internalRecordId).first != NULL);
-        delete writeView->at(internalRecordId).first;
+        freedForwardLists.push_back(writeView->at(internalRecordId).first);
         writeView->at(internalRecordId).first = NULL;
+        this->forwardListSegments.markChanged(internalRecordId);
+        this->storedRecordSegments.markChanged(internalRecordId);
     }
   // clear the set
   this->deletedRecordInternalIds.clear();
@@ -560,6 +579,8 @@ void ForwardIndex::addRecord(const Record *record, const unsigned recordId,
     managedForwardListPtr.first = forwardList;
     managedForwardListPtr.second = true;
     this->forwardListDirectory->getWriteView()->push_back(managedForwardListPtr);
+    this->forwardListSegments.markChanged(recordId);
+    this->storedRecordSegments.markChanged(recordId);
 
     this->mergeRequired = true;
 }
@@ -615,6 +636,8 @@ void ForwardIndex::addDummyFirstRecord()			// For Trie bootstrap
     managedForwardListPtr.first = new ForwardList(0);
     managedForwardListPtr.second = false;
     this->forwardListDirectory->getWriteView()->push_back(managedForwardListPtr);
+    this->forwardListSegments.markChanged(0);
+    this->storedRecordSegments.markChanged(0);
 }
 
 void ForwardIndex::getForwardListDirectory_ReadView(shared_ptr<vectorview<ForwardListPtr> > & readView) const{
@@ -624,7 +647,8 @@ void ForwardIndex::getForwardListDirectory_ReadView(shared_ptr<vectorview<Forwar
 // convert the keyword ids for a given record using the given id mapper
 void ForwardIndex::reassignKeywordIds(shared_ptr<vectorview<ForwardListPtr> > & forwardListDirectoryReadView,
 		const unsigned recordId,
-        const map<unsigned, unsigned> &keywordIdMapper) {
+        const map<unsigned, unsigned> &keywordIdMapper,
+        vector<ForwardList *> &replacedForwardLists) {
     bool valid = false;
     // currently the read view and the write view should be the same
     //ForwardList *forwardList = getForwardListToChange(recordId, valid); 
@@ -634,10 +658,16 @@ void ForwardIndex::reassignKeywordIds(shared_ptr<vectorview<ForwardListPtr> > &
     if (valid == false)
         return;
 
-    // TODO: CHECK
+    // Readers may be using the list, so the ids are reassigned on a copy which then replaces it.
+    ForwardList *newForwardList = new ForwardList(forwardList);
     vector<NewKeywordIdKeywordOffsetTriple> forwardListReOrderAtCommit;
-    this->reorderForwardList(forwardList, keywordIdMapper,
+    this->reorderForwardList(newForwardList, keywordIdMapper,
             forwardListReOrderAtCommit);
+    // the copy must be complete before readers can see it
+    __sync_synchronize();
+    this->forwardListDirectory->getWriteView()->at(recordId).first = newForwardList;
+    replacedForwardLists.push_back(forwardList);
+    this->forwardListSegments.markChanged(recordId);
 }
 
 //void ForwardIndex::commit(ForwardList *forwardList, const vector<unsigned> *oldIdToNewIdMap,
@@ -1915,5 +1945,308 @@ void ForwardList::fetchVLBArrayForKeyword(unsigned keyOffset, const uint8_t * pi
 	}
 }
 
+/*
+ * Layout of the forward index in a flat snapshot. The manifest "<fileName>" contains:
+ *  - FlatSection_ForwardIndexInfo : one FlatForwardIndexInfo
+ *  - FlatSection_ForwardListSegments, FlatSection_StoredRecordSegments : the generations of the segments
+ *  - FlatSection_ExternalRecordIdMapKeys, FlatSection_ExternalRecordIdMapSlots : the hash table of the
+ *    externalToInternalRecordIdMap, see ExternalRecordIdMap::save()
+ * Each forward list segment "<fileName>.lists.<segmentId>.<generation>" contains:
+ *  - FlatSection_ForwardListHeaders : one FlatForwardListHeader per entry of the forward list directory
+ *  - FlatSection_ForwardListPayload : for each forward list, the bytes of its data array (aligned to
+ *    sizeof(unsigned), the loaded list reads it in place), its external record id and the roles of its
+ *    access list (each role prefixed by its length).
+ * Each stored record segment "<fileName>.records.<segmentId>.<generation>" contains:
+ *  - FlatSection_StoredRecordOffsets : the offset of the stored record of each forward list
+ *  - FlatSection_StoredRecordData : the stored records
+ * Snapshots written before segments existed have the sections of one forward list segment in the
+ * manifest itself, with the stored record of each list between its data array and its external record id.
+ */
+struct FlatForwardIndexInfo {
+    uint32_t numberOfForwardLists;
+    uint32_t commitedWriteView;
+};
+
+struct FlatForwardListHeader {
+    uint64_t payloadOffset;
+    uint32_t numberOfKeywords;
+    uint16_t recordBoost; // bits of the half precision boost
+    uint8_t valid;
+    uint8_t hasForwardList; // 0 if the list was freed by freeSpaceOfDeletedRecords()
+    uint32_t dataSize;
+    uint32_t attributeIdsIndexSize;
+    uint32_t positionIndexSize;
+    uint32_t offsetIndexSize;
+    uint32_t charLenIndexSize;
+    uint32_t synonymBitMapSize;
+    uint32_t inMemoryDataLen;
+    uint32_t externalRecordIdLen;
+    uint32_t numberOfRoles;
+};
+BOOST_STATIC_ASSERT(sizeof(half) == sizeof(uint16_t));
+
+
+void ForwardIndex::saveForwardLists(const string &fileName, const vectorview<ForwardListPtr> &readView,
+        unsigned begin, unsigned end) {
+    static const char padding[sizeof(unsigned)] = { 0 };
+    FlatSnapshotWriter writer(fileName);
+
+    vector<FlatForwardListHeader> headers(end - begin);
+    writer.beginSection(FlatSection_ForwardListPayload);
+    for (unsigned i = begin; i < end; ++i) {
+        const ForwardListPtr &entry = readView.getElement(i);
+        FlatForwardListHeader &header = headers[i - begin];
+        memset(&header, 0, sizeof(header));
+        header.payloadOffset = writer.getCurrentSectionLength();
+        header.valid = entry.second;
+        ForwardList *forwardList = entry.first;
+        if (forwardList == NULL)
+            continue;
+
+        // the data array is used in place after a load, so it is aligned for its unsigned and float arrays
+        unsigned misalignment = header.payloadOffset % sizeof(unsigned);
+        if (misalignment != 0) {
+            writer.append(padding, sizeof(unsigned) - misalignment);
+            header.payloadOffset = writer.getCurrentSectionLength();
+        }
+        header.hasForwardList = 1;
+        header.numberOfKeywords = forwardList->numberOfKeywords;
+        memcpy(&header.recordBoost, &forwardList->recordBoost, sizeof(header.recordBoost));
+        header.dataSize = forwardList->dataSize;
+        header.attributeIdsIndexSize = forwardList->attributeIdsIndexSize;
+        header.positionIndexSize = forwardList->positionIndexSize;
+        header.offsetIndexSize = forwardList->offsetIndexSize;
+        header.charLenIndexSize = forwardList->charLenIndexSize;
+        header.synonymBitMapSize = forwardList->synonymBitMapSize;
+        header.inMemoryDataLen = forwardList->inMemoryData.get() == NULL ? 0 : forwardList->inMemoryDataLen;
+        header.externalRecordIdLen = forwardList->externalRecordId.size();
+        vector<string> &roles = forwardList->recordAcl.getRoles();
+        header.numberOfRoles = roles.size();
+
+        writer.append(forwardList->data, header.dataSize);
+        writer.append(forwardList->externalRecordId.data(), header.externalRecordIdLen);
+        for (unsigned r = 0; r < roles.size(); ++r) {
+            writer.appendValue<uint32_t>(roles[r].size());
+            writer.append(roles[r].data(), roles[r].size());
+        }
+    }
+    writer.endSection();
+
+    writer.addSection(FlatSection_ForwardListHeaders, headers.empty() ? NULL : &headers[0],
+            headers.size() * sizeof(FlatForwardListHeader));
+    writer.finish();
+}
+
+void ForwardIndex::saveStoredRecords(const string &fileName, const vectorview<ForwardListPtr> &readView,
+        unsigned begin, unsigned end) {
+    FlatSnapshotWriter writer(fileName);
+
+    vector<uint64_t> offsets;
+    offsets.reserve(end - begin + 1);
+    offsets.push_back(0);
+    writer.beginSection(FlatSection_StoredRecordData);
+    for (unsigned i = begin; i < end; ++i) {
+        const ForwardList *forwardList = readView.getElement(i).first;
+        uint32_t length = 0;
+        if (forwardList != NULL && forwardList->inMemoryData.get() != NULL) {
+            length = forwardList->inMemoryDataLen;
+            writer.append(forwardList->inMemoryData.get(), length);
+        }
+        offsets.push_back(offsets.back() + length);
+    }
+    writer.endSection();
+    writer.addSection(FlatSection_StoredRecordOffsets, &offsets[0], offsets.size() * sizeof(uint64_t));
+    writer.finish();
+}
+
+void ForwardIndex::saveSnapshot(const string &fileName) const {
+    shared_ptr<vectorview<ForwardListPtr> > readView;
+    this->forwardListDirectory->getReadView(readView);
+    const unsigned numberOfForwardLists = readView->size();
+    const unsigned segmentSize = this->forwardListSegments.getSegmentSize();
+
+    this->forwardListSegments.beginSave(fileName, numberOfForwardLists);
+    this->storedRecordSegments.beginSave(fileName, numberOfForwardLists);
+    const unsigned numberOfSegments = this->forwardListSegments.getNumberOfSegmentsToSave();
+    for (unsigned segmentId = 0; segmentId < numberOfSegments; ++segmentId) {
+        unsigned begin = segmentId * segmentSize;
+        unsigned end = std::min(begin + segmentSize, numberOfForwardLists);
+        if (this->forwardListSegments.isSegmentToSave(segmentId))
+            saveForwardLists(this->forwardListSegments.startSegment(segmentId), *readView, begin, end);
+        if (this->storedRecordSegments.isSegmentToSave(segmentId))
+            saveStoredRecords(this->storedRecordSegments.startSegment(segmentId), *readView, begin, end);
+    }
+
+    FlatSnapshotWriter writer(fileName);
+    FlatForwardIndexInfo info;
+    memset(&info, 0, sizeof(info));
+    info.numberOfForwardLists = numberOfForwardLists;
+    info.commitedWriteView = this->commited_WriteView;
+    writer.addSection(FlatSection_ForwardIndexInfo, &info, sizeof(info));
+    this->forwardListSegments.addManifestSection(writer, FlatSection_ForwardListSegments);
+    this->storedRecordSegments.addManifestSection(writer, FlatSection_StoredRecordSegments);
+    this->externalToInternalRecordIdMap.save(writer);
+    writer.finish();
+
+    this->forwardListSegments.commitSave();
+    this->storedRecordSegments.commitSave();
+    Logger::debug("Forward index saved: %d forward list segments and %d stored record segments of %d written",
+            this->forwardListSegments.getNumberOfSegmentsWritten(),
+            this->storedRecordSegments.getNumberOfSegmentsWritten(), numberOfSegments);
+}
+
+void ForwardIndex::loadForwardLists(const FlatSnapshotReader &listReader, const FlatSnapshotReader *storedRecordReader,
+        vectorview<ForwardListPtr> *writeView) {
+    const string &fileName = listReader.getMappedFile()->getFileName();
+    uint64_t numberOfHeaders, payloadLength;
+    const FlatForwardListHeader *headers =
+            listReader.getSectionAsArray<FlatForwardListHeader>(FlatSection_ForwardListHeaders, numberOfHeaders);
+    const char *payload = listReader.getSection(FlatSection_ForwardListPayload, payloadLength);
+
+    const uint64_t *storedRecordOffsets = NULL;
+    const char *storedRecordData = NULL;
+    if (storedRecordReader != NULL) {
+        uint64_t numberOfOffsets, storedRecordDataLength;
+        storedRecordOffsets = storedRecordReader->getSectionAsArray<uint64_t>(FlatSection_StoredRecordOffsets,
+                numberOfOffsets);
+        storedRecordData = storedRecordReader->getSection(FlatSection_StoredRecordData, storedRecordDataLength);
+        if (numberOfOffsets != numberOfHeaders + 1 || storedRecordOffsets[numberOfHeaders] > storedRecordDataLength)
+            throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+    }
+    // forward lists may be freed by the writer at any time, so each one keeps a reference
+    // to the mapping for as long as its stored record points into it.
+    const boost::shared_ptr<MappedFile> &storedRecordMapping = storedRecordReader != NULL ?
+            storedRecordReader->getMappedFile() : listReader.getMappedFile();
+
+    for (unsigned i = 0; i < numberOfHeaders; ++i) {
+        const FlatForwardListHeader &header = headers[i];
+        if (!header.hasForwardList) {
+            writeView->push_back(std::make_pair((ForwardList *) NULL, header.valid != 0));
+            continue;
+        }
+        ForwardList *forwardList = new ForwardList();
+        writeView->push_back(std::make_pair(forwardList, header.valid != 0));
+
+        uint64_t payloadSize = (uint64_t) header.dataSize + header.externalRecordIdLen;
+        if (storedRecordReader == NULL)
+            payloadSize += header.inMemoryDataLen;
+        if (header.payloadOffset > payloadLength || payloadSize > payloadLength - header.payloadOffset)
+            throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+        const char *cursor = payload + header.payloadOffset;
+        const char *payloadEnd = payload + payloadLength;
+
+        forwardList->numberOfKeywords = header.numberOfKeywords;
+        // half has no bit-level setter, so its 16 bits are copied as raw memory
+        memcpy((void *) &forwardList->recordBoost, &header.recordBoost, sizeof(header.recordBoost));
+        forwardList->dataSize = header.dataSize;
+        forwardList->attributeIdsIndexSize = header.attributeIdsIndexSize;
+        forwardList->positionIndexSize = header.positionIndexSize;
+        forwardList->offsetIndexSize = header.offsetIndexSize;
+        forwardList->charLenIndexSize = header.charLenIndexSize;
+        forwardList->synonymBitMapSize = header.synonymBitMapSize;
+        // The data array stays in the mapping. Snapshots written before the arrays were aligned
+        // have them at any offset, and those arrays are copied out of the mapping.
+        if (((uintptr_t) cursor) % sizeof(unsigned) == 0) {
+            forwardList->data = (Byte *) cursor;
+            forwardList->dataMapping = listReader.getMappedFile();
+        } else {
+            forwardList->data = new Byte[header.dataSize];
+            memcpy(forwardList->data, cursor, header.dataSize);
+        }
+        cursor += header.dataSize;
+
+        const char *storedRecord = cursor;
+        if (storedRecordReader == NULL) {
+            cursor += header.inMemoryDataLen;
+        } else {
+            if (storedRecordOffsets[i + 1] - storedRecordOffsets[i] != header.inMemoryDataLen)
+                throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+            storedRecord = storedRecordData + storedRecordOffsets[i];
+        }
+        forwardList->inMemoryDataLen = header.inMemoryDataLen;
+        if (header.inMemoryDataLen > 0)
+            forwardList->inMemoryData = boost::shared_ptr<const char>(storedRecordMapping, storedRecord);
+
+        forwardList->externalRecordId.assign(cursor, header.externalRecordIdLen);
+        cursor += header.externalRecordIdLen;
+
+        vector<string> &roles = forwardList->recordAcl.getRoles();
+        roles.resize(header.numberOfRoles);
+        for (unsigned r = 0; r < header.numberOfRoles; ++r) {
+            uint32_t roleLength;
+            if (payloadEnd - cursor < (ptrdiff_t) sizeof(roleLength))
+                throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+            memcpy(&roleLength, cursor, sizeof(roleLength));
+            cursor += sizeof(roleLength);
+            if (payloadEnd - cursor < (ptrdiff_t) roleLength)
+                throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+            roles[r].assign(cursor, roleLength);
+            cursor += roleLength;
+        }
+    }
+}
+
+void ForwardIndex::loadSnapshot(const string &fileName) {
+    FlatSnapshotReader reader(fileName);
+
+    uint64_t infoLength;
+    const FlatForwardIndexInfo *info = (const FlatForwardIndexInfo *) reader.getSection(FlatSection_ForwardIndexInfo, infoLength);
+    if (infoLength != sizeof(FlatForwardIndexInfo)) {
+        Logger::error("Forward index snapshot %s is corrupted", fileName.c_str());
+        throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+    }
+
+    cowvector<ForwardListPtr> *directory = new cowvector<ForwardListPtr>(info->numberOfForwardLists);
+    vectorview<ForwardListPtr> *writeView = directory->getWriteView();
+    try {
+        if (reader.hasSection(FlatSection_ForwardListSegments)) {
+            unsigned numberOfSegments = this->forwardListSegments.load(fileName, reader,
+                    FlatSection_ForwardListSegments);
+            if (this->storedRecordSegments.load(fileName, reader, FlatSection_StoredRecordSegments) != numberOfSegments)
+                throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+            for (unsigned segmentId = 0; segmentId < numberOfSegments; ++segmentId) {
+                FlatSnapshotReader listReader(this->forwardListSegments.getSegmentFileName(segmentId));
+                FlatSnapshotReader storedRecordReader(this->storedRecordSegments.getSegmentFileName(segmentId));
+                loadForwardLists(listReader, &storedRecordReader, writeView);
+            }
+        } else {
+            loadForwardLists(reader, NULL, writeView);
+        }
+        if (writeView->size() != info->numberOfForwardLists)
+            throw std::runtime_error("Corrupted forward index snapshot " + fileName);
+    } catch (std::runtime_error &ex) {
+        Logger::error("Forward index snapshot %s is corrupted", fileName.c_str());
+        for (unsigned i = 0; i < writeView->size(); ++i)
+            delete writeView->getElement(i).first;
+        delete directory;
+        throw;
+    }
+    directory->commit();
+
+    // replace the empty directory created by the constructor
+    delete this->forwardListDirectory;
+    this->forwardListDirectory = directory;
+    // the map can be rebuilt from the forward lists, so a corrupted map does not fail the load
+    bool isRecordIdMapLoaded = false;
+    if (ExternalRecordIdMap::hasSnapshot(reader)) {
+        try {
+            this->externalToInternalRecordIdMap.load(reader);
+            isRecordIdMapLoaded = true;
+        } catch (std::runtime_error &ex) {
+            Logger::warn("%s, rebuilding it from the forward lists", ex.what());
+        }
+    }
+    if (!isRecordIdMapLoaded) {
+        for (unsigned i = 0; i < writeView->size(); ++i) {
+            const ForwardListPtr &entry = directory->getWriteView()->getElement(i);
+            if (entry.second && entry.first != NULL)
+                this->externalToInternalRecordIdMap.setValue(entry.first->externalRecordId, i);
+        }
+    }
+    this->commited_WriteView = info->commitedWriteView != 0;
+    this->forwardListSegments.reserve(writeView->size());
+    this->storedRecordSegments.reserve(writeView->size());
+}
+
 }
 }
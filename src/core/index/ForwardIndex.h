@@ -35,6 +35,8 @@
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/unordered_set.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <fstream>
 #include <vector>
 #include <string>
@@ -51,7 +53,8 @@
 #include "util/mytime.h"
 #include "util/ULEB128.h"
 #include "thirdparty/snappy-1.0.4/snappy.h"
-#include "util/ThreadSafeMap.h"
+#include "index/ExternalRecordIdMap.h"
+#include "serialization/FlatSnapshot.h"
 using std::vector;
 using std::fstream;
 using std::string;
@@ -159,6 +162,10 @@ public:
 		return this->roles;
 	}
 
+	const vector<string>& getRoles() const{
+		return this->roles;
+	}
+
 	void print(){
 		std::cout << "----roles----" << std::endl;
 		for(unsigned i = 0 ; i < roles.size(); ++i){
@@ -385,6 +392,7 @@ public:
         // allocateSpaceAndSetNSAValuesAndPosIndex when other pieces of data are also ready.
         dataSize = 0;
         data = NULL;
+        dataMapping.reset();
         attributeIdsIndexSize = 0;
         positionIndexSize = 0;
         offsetIndexSize = 0;
@@ -392,8 +400,30 @@ public:
         synonymBitMapSize = 0;
     }
 
+    // Copies src, so that the copy can be changed while readers still use src.
+    explicit ForwardList(const ForwardList *src) {
+        numberOfKeywords = src->numberOfKeywords;
+        recordBoost = src->recordBoost;
+        externalRecordId = src->externalRecordId;
+        inMemoryData = src->inMemoryData;
+        inMemoryDataLen = src->inMemoryDataLen;
+        recordAcl.getRoles() = src->recordAcl.getRoles();
+        dataSize = src->dataSize;
+        data = NULL;
+        if (dataSize > 0) {
+            data = new Byte[dataSize];
+            memcpy(data, src->data, dataSize);
+        }
+        attributeIdsIndexSize = src->attributeIdsIndexSize;
+        positionIndexSize = src->positionIndexSize;
+        offsetIndexSize = src->offsetIndexSize;
+        charLenIndexSize = src->charLenIndexSize;
+        synonymBitMapSize = src->synonymBitMapSize;
+    }
+
     virtual ~ForwardList() {
-        if(data != NULL){
+        // a data array in a snapshot mapping is released with the mapping
+        if(data != NULL && dataMapping.get() == NULL){
         	delete[] data;  // data is allocated as an array with new[]
         }
     }
@@ -500,6 +530,8 @@ public:
 
 private:
     friend class boost::serialization::access;
+    // saveSnapshot() and loadSnapshot() access the members directly
+    friend class ForwardIndex;
 
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version) {
@@ -554,6 +586,9 @@ private:
      * ------------------------------------------------------------------------------------------------------------------------
      */
     Byte * data;
+    // the snapshot mapping data points into if the list was loaded from a flat snapshot, otherwise NULL.
+    // The mapping is private, so the in-place updates of merges only copy the pages they write.
+    boost::shared_ptr<srch2::util::MappedFile> dataMapping;
 
     unsigned attributeIdsIndexSize;
     unsigned positionIndexSize;
@@ -703,8 +738,8 @@ private:
     ///vector of forwardLists, where RecordId is the element index.
     cowvector<ForwardListPtr> *forwardListDirectory;
     ReadViewManager<ForwardListPtr> fwdListDirReadViewsMgr;
-    //Used only in WriteView
-    ThreadSafeMap<std::string, unsigned> externalToInternalRecordIdMap;
+    // Changed by the writer, read by the writer and by readers that look up primary keys
+    ExternalRecordIdMap externalToInternalRecordIdMap;
 
     // Build phase structure
     // Stores the order of records, by which it was added to forward index. Used in bulk initial insert
@@ -718,6 +753,20 @@ private:
     // Initialised in constructor and used in calculation of offset in filterAttributesVector. This is lighter than serialising the schema itself.
     const SchemaInternal *schemaInternal;
 
+    // Segments of the forward lists and of their stored records changed since the last save,
+    // see saveSnapshot(). Stored records only change when records are added or freed.
+    mutable FlatSnapshotSegments forwardListSegments;
+    mutable FlatSnapshotSegments storedRecordSegments;
+
+    static void saveForwardLists(const string &fileName, const vectorview<ForwardListPtr> &readView,
+            unsigned begin, unsigned end);
+    static void saveStoredRecords(const string &fileName, const vectorview<ForwardListPtr> &readView,
+            unsigned begin, unsigned end);
+    // Appends the forward lists of a snapshot file to the directory. If storedRecordReader is NULL, the
+    // stored records follow the data of each list in its payload (snapshots written before segments).
+    static void loadForwardLists(const FlatSnapshotReader &listReader, const FlatSnapshotReader *storedRecordReader,
+            vectorview<ForwardListPtr> *writeView);
+
     friend class boost::serialization::access;
 
     template<class Archive>
@@ -811,6 +860,27 @@ public:
 
     static void exportData(ForwardIndex &forwardIndex, const string &exportedDataFileName);
 
+    /*
+     * Saves the committed read view of the forward index as a segmented flat snapshot (see
+     * serialization/FlatSnapshot.h). Each forward list is stored as a fixed size header followed by its
+     * variable length data, and the stored records are kept in separate segments. Saving again to the same
+     * file only writes the segments that changed since the last save.
+     */
+    void saveSnapshot(const string &fileName) const;
+    /*
+     * Loads a flat snapshot written by saveSnapshot(). The data and the stored record of each forward list
+     * point directly into the mapped file, but a ForwardList object is still created for every record.
+     * The externalToInternalRecordIdMap is loaded from the manifest, or rebuilt from the valid lists for
+     * snapshots saved without it.
+     * Throws std::runtime_error if the file is not a compatible snapshot.
+     */
+    void loadSnapshot(const string &fileName);
+
+    // Called by the writer when it changes a forward list in place, so that the next save writes it.
+    void markForwardListChanged(unsigned recordId) {
+        this->forwardListSegments.markChanged(recordId);
+    }
+
     /**
      * Build Phase functions
      */
@@ -854,11 +924,10 @@ public:
     }
     bool isMergeRequired() const { return mergeRequired; }
 
-    // Free the space of those forward lists that have been marked deleted
-    // The caller must acquire the necessary lock to make sure
-    // no readers can access the forward index since some of
-    // its forward lists are being freed.
-    void freeSpaceOfDeletedRecords();
+    // Unlinks the forward lists that have been marked deleted from the directory, and appends them
+    // to freedForwardLists. Readers may still be using them, so the caller frees them once the
+    // readers are gone.
+    void freeSpaceOfDeletedRecords(vector<ForwardList *> &freedForwardLists);
     bool hasDeletedRecords() { return deletedRecordInternalIds.size() > 0; }
     void setSchema(SchemaInternal *schema) {
         this->schemaInternal = schema;
@@ -929,9 +998,12 @@ public:
     INDEXLOOKUP_RETVAL lookupRecord(
             const std::string &externalRecordId, unsigned& internalRecordId) const;
 
+    // Replaces the forward list of the record with a copy that uses the new keyword ids, and appends
+    // the old list to replacedForwardLists. The caller frees it once readers are gone.
     void reassignKeywordIds(shared_ptr<vectorview<ForwardListPtr> > & forwardListDirectoryReadView,
     		const unsigned recordId,
-            const map<unsigned, unsigned> &keywordIdMapper);
+            const map<unsigned, unsigned> &keywordIdMapper,
+            vector<ForwardList *> &replacedForwardLists);
     //void reassignKeywordIds(map<unsigned, unsigned> &reassignedKeywordIdMapper);
 
     /**
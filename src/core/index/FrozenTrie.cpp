@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "index/FrozenTrie.h"
+#include "index/Trie.h"
+#include "util/Assert.h"
+#include "util/encoding.h"
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+FrozenTrie::FrozenTrie(const TrieNode *root)
+{
+    ASSERT(root != NULL);
+    unsigned numberOfNodes = root->getNumberOfNodes();
+    this->nodes.reserve(numberOfNodes);
+    this->characters.reserve(numberOfNodes);
+    this->statistics.reserve(numberOfNodes);
+    this->trieNodes.reserve(numberOfNodes);
+
+    // Breadth-first traversal. The queue is the trieNodes vector itself: when node i is visited, its
+    // children are appended to the end, which makes them adjacent and gives them consecutive indexes.
+    this->trieNodes.push_back(root);
+    for (unsigned nodeIndex = 0; nodeIndex < this->trieNodes.size(); ++nodeIndex) {
+        const TrieNode *trieNode = this->trieNodes[nodeIndex];
+
+        FrozenTrieNode node;
+        node.firstChild = this->trieNodes.size();
+        node.childrenCountDepthTerminalFlag = (trieNode->getChildrenCount() & 0x00ffffff)
+                | ((trieNode->getDepth() & 0x7f) << 24)
+                | (trieNode->isTerminalNode() ? 0x80000000 : 0);
+        node.id = trieNode->getId();
+        // the root of an empty trie does not have descendants
+        node.minId = trieNode->getLeftMostDescendant() == NULL ? 0 : trieNode->getMinId();
+        node.maxId = trieNode->getRightMostDescendant() == NULL ? 0 : trieNode->getMaxId();
+        node.invertedListOffset = trieNode->getInvertedListOffset();
+        this->nodes.push_back(node);
+        this->characters.push_back(trieNode->getCharacter());
+
+        FrozenTrieNodeStatistics nodeStatistics;
+        nodeStatistics.nodeProbabilityValue = trieNode->getNodeProbabilityValue();
+        nodeStatistics.numberOfTerminalNodes = trieNode->getNumberOfTerminalNodes();
+        nodeStatistics.maximumScoreOfLeafNodes = trieNode->getMaximumScoreOfLeafNodes();
+        this->statistics.push_back(nodeStatistics);
+
+        for (unsigned childIterator = 0; childIterator < trieNode->getChildrenCount(); ++childIterator) {
+            this->trieNodes.push_back(trieNode->getChild(childIterator));
+        }
+    }
+}
+
+int FrozenTrie::findNode(const std::vector<CharType> &prefix) const
+{
+    int nodeIndex = ROOT_INDEX;
+    for (unsigned i = 0; i < prefix.size() && nodeIndex != NOT_FOUND; ++i) {
+        nodeIndex = this->findChild(nodeIndex, prefix[i]);
+    }
+    return nodeIndex;
+}
+
+void FrozenTrie::computeActiveNodes(const std::vector<CharType> &prefix, unsigned editDistanceThreshold,
+        bool supportSwapInEditDistance, std::vector<FrozenActiveNode> &activeNodes) const
+{
+    // without errors the only active node is the node of the prefix itself
+    if (editDistanceThreshold == 0) {
+        int nodeIndex = this->findNode(prefix);
+        if (nodeIndex != NOT_FOUND)
+            activeNodes.push_back(FrozenActiveNode(nodeIndex, 0, 0));
+        return;
+    }
+
+    // characters from CHARTYPE_FUZZY_UPPERBOUND on are only matched, which unit costs cannot express
+    bool prefixHasExactOnlyCharacters = false;
+    for (unsigned i = 0; i < prefix.size(); ++i)
+        prefixHasExactOnlyCharacters |= prefix[i] >= CHARTYPE_FUZZY_UPPERBOUND;
+    if (prefix.empty() || prefix.size() > MAXIMUM_BIT_PARALLEL_PREFIX_LENGTH || prefixHasExactOnlyCharacters) {
+        computeActiveNodesWithRows(prefix, editDistanceThreshold, supportSwapInEditDistance, activeNodes);
+        return;
+    }
+    switch (editDistanceThreshold) {
+    case 1:
+        computeActiveNodesBitParallel<1>(prefix, editDistanceThreshold, supportSwapInEditDistance, activeNodes);
+        break;
+    case 2:
+        computeActiveNodesBitParallel<2>(prefix, editDistanceThreshold, supportSwapInEditDistance, activeNodes);
+        break;
+    default:
+        computeActiveNodesBitParallel<-1>(prefix, editDistanceThreshold, supportSwapInEditDistance, activeNodes);
+        break;
+    }
+}
+
+namespace
+{
+
+// the number of bits set in bits below position i, i <= 64
+inline unsigned countBitsBelow(uint64_t bits, unsigned i)
+{
+    return __builtin_popcountll(i >= 64 ? bits : bits & ((1ULL << i) - 1));
+}
+
+// The bit i of the mask of a character is set if the character is prefix[i]. Masks of ASCII
+// characters are looked up in a table, the others in a short list.
+class PrefixCharacterMasks
+{
+public:
+    PrefixCharacterMasks(const std::vector<CharType> &prefix) {
+        std::fill(this->asciiMasks, this->asciiMasks + 128, 0);
+        for (unsigned i = 0; i < prefix.size(); ++i) {
+            uint64_t bit = 1ULL << i;
+            if (prefix[i] < 128) {
+                this->asciiMasks[prefix[i]] |= bit;
+                continue;
+            }
+            unsigned j = 0;
+            while (j < this->otherMasks.size() && this->otherMasks[j].first != prefix[i])
+                ++j;
+            if (j == this->otherMasks.size())
+                this->otherMasks.push_back(std::make_pair(prefix[i], 0));
+            this->otherMasks[j].second |= bit;
+        }
+    }
+
+    inline uint64_t get(CharType character) const {
+        if (character < 128)
+            return this->asciiMasks[character];
+        for (unsigned j = 0; j < this->otherMasks.size(); ++j) {
+            if (this->otherMasks[j].first == character)
+                return this->otherMasks[j].second;
+        }
+        return 0;
+    }
+
+private:
+    uint64_t asciiMasks[128];
+    std::vector<std::pair<CharType, uint64_t> > otherMasks;
+};
+
+// Myers' step in Hyyro's formulation: the deltas of the row of a node from the ones of the row of
+// its parent, the matches of its character and the swaps it ends. Bit i - 1 of diagonalZeros is set
+// if the entry i of the row equals the entry i - 1 of the row of the parent.
+inline void computeRow(uint64_t matches, uint64_t swaps, uint64_t parentPositiveDeltas, uint64_t parentNegativeDeltas,
+        uint64_t rowMask, uint64_t &positiveDeltas, uint64_t &negativeDeltas, uint64_t &diagonalZeros)
+{
+    diagonalZeros = (((matches & parentPositiveDeltas) + parentPositiveDeltas) ^ parentPositiveDeltas)
+            | matches | parentNegativeDeltas | swaps;
+    uint64_t horizontalPositive = parentNegativeDeltas | ~(diagonalZeros | parentPositiveDeltas);
+    uint64_t horizontalNegative = parentPositiveDeltas & diagonalZeros;
+    // entry 0 of the row is one more than entry 0 of the row of the parent
+    horizontalPositive = (horizontalPositive << 1) | 1;
+    horizontalNegative = horizontalNegative << 1;
+    positiveDeltas = (horizontalNegative | ~(diagonalZeros | horizontalPositive)) & rowMask;
+    negativeDeltas = horizontalPositive & diagonalZeros & rowMask;
+}
+
+// Hyyro's extension of Myers' step to swaps: bit i - 1 is set if the characters i - 1 and i of the
+// prefix are the characters of the node and of its parent swapped, and the entry i - 2 of the row of
+// the grandparent is one less than the entry i - 1 of the row of the parent, so that the swap can
+// make the entry i of the row equal to the entry i - 1 of the row of the parent
+inline uint64_t getSwaps(uint64_t matches, uint64_t parentMatches, uint64_t parentDiagonalZeros)
+{
+    return ((~parentDiagonalZeros & matches) << 1) & parentMatches;
+}
+
+/*
+ * The minimum of the entries of the row of a node at the given depth that a pivotal descendant can
+ * extend, or a value above the threshold if it is above the threshold. The descendant has to match
+ * one more character of the prefix, so the last entry of the row does not count. The entries out
+ * of the band around the diagonal are above the threshold.
+ */
+inline unsigned getMinimumOfBand(uint64_t positiveDeltas, uint64_t negativeDeltas, unsigned depth,
+        unsigned threshold, unsigned prefixLength)
+{
+    const unsigned firstEntry = depth > threshold ? depth - threshold : 0;
+    const unsigned lastEntry = std::min(prefixLength - 1, depth + threshold);
+    if (firstEntry > lastEntry)
+        return threshold + 1;
+    unsigned entry = depth + countBitsBelow(positiveDeltas, firstEntry) - countBitsBelow(negativeDeltas, firstEntry);
+    unsigned minimumOfBand = entry;
+    for (unsigned i = firstEntry + 1; i <= lastEntry && minimumOfBand > threshold; ++i) {
+        entry = entry + ((positiveDeltas >> (i - 1)) & 1) - ((negativeDeltas >> (i - 1)) & 1);
+        minimumOfBand = std::min(minimumOfBand, entry);
+    }
+    return minimumOfBand;
+}
+
+}
+
+/*
+ * The same traversal as computeActiveNodesWithRows(), with the row of a node kept as its vertical
+ * deltas: bit i - 1 of positiveDeltas (negativeDeltas) is set if the entry i of the row is one more
+ * (one less) than the entry i - 1. Entry 0 of the row of a node at depth d is d, so entry i is
+ * d + countBitsBelow(positiveDeltas, i) - countBitsBelow(negativeDeltas, i).
+ *
+ * The row of a child is computed from the row of its parent with Myers' algorithm, in the variant
+ * for global alignment where the first entry of a row grows by one at each depth. An entry i of
+ * the row at depth d is at least |i - d|, so only the entries within the threshold of the diagonal
+ * can bring the minimum of the row within the threshold, and only a match of one of the last
+ * threshold + 1 characters of the prefix can make a node pivotal. The children whose character is
+ * not in the prefix are only visited if the row they share is within the threshold, which leaves
+ * most of the last level of the traversal to a lookup of the character masks.
+ */
+template <int StaticThreshold>
+void FrozenTrie::computeActiveNodesBitParallel(const std::vector<CharType> &prefix, unsigned editDistanceThreshold,
+        bool supportSwapInEditDistance, std::vector<FrozenActiveNode> &activeNodes) const
+{
+    const unsigned threshold = StaticThreshold >= 0 ? (unsigned) StaticThreshold : editDistanceThreshold;
+    const unsigned prefixLength = prefix.size();
+    ASSERT(prefixLength > 0 && prefixLength <= MAXIMUM_BIT_PARALLEL_PREFIX_LENGTH);
+    const uint64_t rowMask = prefixLength == 64 ? ~0ULL : (1ULL << prefixLength) - 1;
+    const PrefixCharacterMasks characterMasks(prefix);
+    // the first character of the prefix whose match can make a node pivotal
+    const unsigned firstPivotalCharacter = prefixLength > threshold ? prefixLength - threshold : 1;
+
+    const unsigned maximumDepth = std::min(prefixLength + threshold, Trie::TRIE_MAX_DEPTH);
+    // the deltas of the row of the node on the current path at each depth
+    std::vector<uint64_t> positiveDeltas(maximumDepth + 1);
+    std::vector<uint64_t> negativeDeltas(maximumDepth + 1);
+    // and its diagonal zeros and the matches of its character, for the swaps
+    std::vector<uint64_t> diagonalZeros(maximumDepth + 1);
+    std::vector<uint64_t> pathMatches(maximumDepth + 1);
+    positiveDeltas[0] = rowMask;
+    negativeDeltas[0] = 0;
+    // no swap ends at depth 1
+    diagonalZeros[0] = ~0ULL;
+    pathMatches[0] = 0;
+    if (prefixLength <= threshold)
+        activeNodes.push_back(FrozenActiveNode(ROOT_INDEX, prefixLength, 0));
+
+    std::vector<std::pair<unsigned, unsigned> > stack;
+    const FrozenTrieNode &root = this->nodes[ROOT_INDEX];
+    for (unsigned child = root.firstChild + root.getChildrenCount(); child > root.firstChild; --child)
+        stack.push_back(std::make_pair(child - 1, 1));
+
+    while (!stack.empty()) {
+        unsigned nodeIndex = stack.back().first;
+        unsigned depth = stack.back().second;
+        stack.pop_back();
+        // a character that can only be matched matches nothing in this prefix, so no node of the
+        // subtrie is reachable
+        if (this->characters[nodeIndex] >= CHARTYPE_FUZZY_UPPERBOUND)
+            continue;
+
+        const uint64_t matches = characterMasks.get(this->characters[nodeIndex]);
+        const uint64_t parentPositiveDeltas = positiveDeltas[depth - 1];
+        const uint64_t parentNegativeDeltas = negativeDeltas[depth - 1];
+        const uint64_t parentMatches = supportSwapInEditDistance ? pathMatches[depth - 1] : 0;
+
+        // matches of the characters i >= firstPivotalCharacter, in increasing order of i, so that
+        // the first match with the smallest distance has the smallest prefix edit distance
+        unsigned pivotalDistance = threshold + 1;
+        unsigned pivotalPrefixEditDistance = 0;
+        for (uint64_t pivotalMatches = matches >> (firstPivotalCharacter - 1); pivotalMatches != 0;
+                pivotalMatches &= pivotalMatches - 1) {
+            unsigned i = firstPivotalCharacter + __builtin_ctzll(pivotalMatches);
+            unsigned prefixEditDistance = depth - 1 + countBitsBelow(parentPositiveDeltas, i - 1)
+                    - countBitsBelow(parentNegativeDeltas, i - 1);
+            if (prefixEditDistance + (prefixLength - i) < pivotalDistance) {
+                pivotalDistance = prefixEditDistance + (prefixLength - i);
+                pivotalPrefixEditDistance = prefixEditDistance;
+            }
+        }
+        // swaps of the characters i - 1 and i of the prefix with the characters of the node and its
+        // parent, in the bit i - 1, cost one edit after the entry i - 2 of the row of the grandparent
+        for (uint64_t pivotalSwaps = ((matches << 1) & parentMatches & ~matches) >> (firstPivotalCharacter - 1);
+                pivotalSwaps != 0; pivotalSwaps &= pivotalSwaps - 1) {
+            unsigned i = firstPivotalCharacter + __builtin_ctzll(pivotalSwaps);
+            unsigned prefixEditDistance = depth - 1 + countBitsBelow(positiveDeltas[depth - 2], i - 2)
+                    - countBitsBelow(negativeDeltas[depth - 2], i - 2);
+            if (prefixEditDistance + (prefixLength - i) < pivotalDistance
+                    || (prefixEditDistance + (prefixLength - i) == pivotalDistance
+                            && prefixEditDistance < pivotalPrefixEditDistance)) {
+                pivotalDistance = prefixEditDistance + (prefixLength - i);
+                pivotalPrefixEditDistance = prefixEditDistance;
+            }
+        }
+        if (pivotalDistance <= threshold)
+            activeNodes.push_back(FrozenActiveNode(nodeIndex, pivotalDistance, pivotalPrefixEditDistance));
+
+        if (depth >= maximumDepth)
+            continue;
+
+        uint64_t rowPositiveDeltas, rowNegativeDeltas, rowDiagonalZeros;
+        computeRow(matches, getSwaps(matches, parentMatches, diagonalZeros[depth - 1]), parentPositiveDeltas,
+                parentNegativeDeltas, rowMask, rowPositiveDeltas, rowNegativeDeltas, rowDiagonalZeros);
+        // no descendant can be pivotal if the row is above the threshold
+        if (getMinimumOfBand(rowPositiveDeltas, rowNegativeDeltas, depth, threshold, prefixLength) > threshold)
+            continue;
+        positiveDeltas[depth] = rowPositiveDeltas;
+        negativeDeltas[depth] = rowNegativeDeltas;
+        diagonalZeros[depth] = rowDiagonalZeros;
+        pathMatches[depth] = matches;
+
+        // The children whose character matches no character of the prefix within the band of their
+        // depth all have the same row and are not pivotal. If that row is above the threshold, they
+        // are skipped without being visited. A child matches the character i of the prefix in the
+        // bit i - 1 of its matches, which is in the band if |i - 1 - depth| <= threshold.
+        const unsigned firstBandBit = depth > threshold ? depth - threshold : 0;
+        const uint64_t bandMatchesMask = (depth + threshold + 1 >= 64 ? ~0ULL : (1ULL << (depth + threshold + 1)) - 1)
+                & ~((1ULL << firstBandBit) - 1);
+        bool visitMismatchingChildren = false;
+        if (depth + 1 < maximumDepth) {
+            // (a swap a mismatching child ends lowers only entries out of the band)
+            uint64_t mismatchPositiveDeltas, mismatchNegativeDeltas, mismatchDiagonalZeros;
+            computeRow(0, 0, rowPositiveDeltas, rowNegativeDeltas, rowMask, mismatchPositiveDeltas, mismatchNegativeDeltas,
+                    mismatchDiagonalZeros);
+            visitMismatchingChildren =
+                    getMinimumOfBand(mismatchPositiveDeltas, mismatchNegativeDeltas, depth + 1, threshold, prefixLength)
+                    <= threshold;
+        }
+        const FrozenTrieNode &node = this->nodes[nodeIndex];
+        for (unsigned child = node.firstChild + node.getChildrenCount(); child > node.firstChild; --child) {
+            if (visitMismatchingChildren || (characterMasks.get(this->characters[child - 1]) & bandMatchesMask) != 0)
+                stack.push_back(std::make_pair(child - 1, depth + 1));
+        }
+    }
+}
+
+void FrozenTrie::computeActiveNodesWithRows(const std::vector<CharType> &prefix, unsigned editDistanceThreshold,
+        bool supportSwapInEditDistance, std::vector<FrozenActiveNode> &activeNodes) const
+{
+    const unsigned rowLength = prefix.size() + 1;
+    // Every entry of the row of a node deeper than this is above the threshold.
+    const unsigned maximumDepth = std::min((unsigned) prefix.size() + editDistanceThreshold, Trie::TRIE_MAX_DEPTH);
+    // As in PrefixActiveNodeSet, the characters from CHARTYPE_FUZZY_UPPERBOUND on are never inserted,
+    // deleted, substituted or swapped, and such a character of the prefix is only matched by a child
+    // of a node matched before it, with deletions only in between. These edits cost aboveThreshold
+    // and the entries are capped there, which leaves the ones within the threshold unchanged.
+    const unsigned aboveThreshold = editDistanceThreshold + 1;
+    // the cost of deleting the characters of the prefix after i
+    std::vector<unsigned> deletionsAfter(rowLength);
+    deletionsAfter[rowLength - 1] = 0;
+    for (unsigned i = rowLength - 1; i > 0; --i)
+        deletionsAfter[i - 1] = prefix[i - 1] < CHARTYPE_FUZZY_UPPERBOUND ?
+                std::min(deletionsAfter[i] + 1, aboveThreshold) : aboveThreshold;
+    // rows[depth * rowLength + i] is the edit distance between the first i characters of the prefix
+    // and the string of the node on the current path at that depth. Since the traversal is
+    // depth-first, the row of the parent of a node is always the row of the previous depth.
+    // matchedRows has the same entries for the alignments in which the node is matched, or ends a
+    // swap, and is followed by deletions only.
+    std::vector<unsigned> rows((maximumDepth + 1) * rowLength);
+    std::vector<unsigned> matchedRows((maximumDepth + 1) * rowLength);
+    rows[0] = 0;
+    for (unsigned i = 1; i < rowLength; ++i)
+        rows[i] = prefix[i - 1] < CHARTYPE_FUZZY_UPPERBOUND ? std::min(rows[i - 1] + 1, aboveThreshold) : aboveThreshold;
+    std::copy(rows.begin(), rows.begin() + rowLength, matchedRows.begin());
+    // the characters of the nodes on the current path, for the swaps
+    std::vector<CharType> pathCharacters(maximumDepth + 1);
+    // the root is pivotal for the prefix made of deletions only
+    if (deletionsAfter[0] <= editDistanceThreshold)
+        activeNodes.push_back(FrozenActiveNode(ROOT_INDEX, deletionsAfter[0], 0));
+
+    // stack of (node index, depth) pairs, the root's children pushed in reverse order to visit
+    // them in preorder
+    std::vector<std::pair<unsigned, unsigned> > stack;
+    const FrozenTrieNode &root = this->nodes[ROOT_INDEX];
+    for (unsigned child = root.firstChild + root.getChildrenCount(); child > root.firstChild; --child)
+        stack.push_back(std::make_pair(child - 1, 1));
+
+    while (!stack.empty()) {
+        unsigned nodeIndex = stack.back().first;
+        unsigned depth = stack.back().second;
+        stack.pop_back();
+
+        const CharType character = this->characters[nodeIndex];
+        const bool isFuzzy = character < CHARTYPE_FUZZY_UPPERBOUND;
+        const unsigned *parentRow = &rows[(depth - 1) * rowLength];
+        const unsigned *parentMatchedRow = &matchedRows[(depth - 1) * rowLength];
+        unsigned *row = &rows[depth * rowLength];
+        unsigned *matchedRow = &matchedRows[depth * rowLength];
+        row[0] = isFuzzy ? std::min(parentRow[0] + 1, aboveThreshold) : aboveThreshold;
+        matchedRow[0] = aboveThreshold;
+        pathCharacters[depth] = character;
+        // the row of the grandparent and the character of the parent if the node can end a swap
+        const unsigned *grandparentRow = supportSwapInEditDistance && depth >= 2 && isFuzzy
+                && pathCharacters[depth - 1] < CHARTYPE_FUZZY_UPPERBOUND ? &rows[(depth - 2) * rowLength] : NULL;
+        const CharType parentCharacter = pathCharacters[depth - 1];
+        // A pivotal descendant has to match one more character of the prefix after this node, so
+        // the last entry of the row, the prefix being fully consumed, does not count here.
+        unsigned minimumOfRow = row[0];
+        // The node is pivotal if its character matches a character i of the prefix, or it ends a
+        // swap of the characters i - 1 and i, and the rest of the prefix can be deleted within the
+        // threshold. Its distance is the smallest such cost; among the matches with that cost, the
+        // first one has the smallest prefix edit distance.
+        unsigned pivotalDistance = editDistanceThreshold + 1;
+        unsigned pivotalPrefixEditDistance = 0;
+        for (unsigned i = 1; i < rowLength; ++i) {
+            unsigned matchedDistance = aboveThreshold;
+            if (prefix[i - 1] == character)
+                matchedDistance = isFuzzy ? parentRow[i - 1] : parentMatchedRow[i - 1];
+            // a swap of the characters i - 1 and i of the prefix with the characters of the parent and
+            // the node costs one edit
+            if (grandparentRow != NULL && i >= 2 && prefix[i - 2] == character && prefix[i - 1] == parentCharacter
+                    && character != parentCharacter)
+                matchedDistance = std::min(matchedDistance, grandparentRow[i - 2] + 1);
+            if (matchedDistance + deletionsAfter[i] < pivotalDistance) {
+                pivotalDistance = matchedDistance + deletionsAfter[i];
+                pivotalPrefixEditDistance = matchedDistance;
+            }
+
+            unsigned distance = matchedDistance;
+            if (isFuzzy && prefix[i - 1] < CHARTYPE_FUZZY_UPPERBOUND) {
+                distance = std::min(distance, parentRow[i - 1] + 1);
+                distance = std::min(distance, parentRow[i] + 1);
+                distance = std::min(distance, row[i - 1] + 1);
+                matchedDistance = std::min(matchedDistance, matchedRow[i - 1] + 1);
+            } else if (isFuzzy) {
+                distance = std::min(distance, parentRow[i] + 1);
+            } else if (prefix[i - 1] < CHARTYPE_FUZZY_UPPERBOUND) {
+                distance = std::min(distance, row[i - 1] + 1);
+                matchedDistance = std::min(matchedDistance, matchedRow[i - 1] + 1);
+            }
+            row[i] = std::min(distance, aboveThreshold);
+            matchedRow[i] = std::min(matchedDistance, aboveThreshold);
+            if (i < rowLength - 1)
+                minimumOfRow = std::min(minimumOfRow, distance);
+        }
+
+        if (pivotalDistance <= editDistanceThreshold)
+            activeNodes.push_back(FrozenActiveNode(nodeIndex, pivotalDistance, pivotalPrefixEditDistance));
+
+        // no descendant can be pivotal if the row is above the threshold
+        if (minimumOfRow > editDistanceThreshold || depth >= maximumDepth)
+            continue;
+
+        const FrozenTrieNode &node = this->nodes[nodeIndex];
+        for (unsigned child = node.firstChild + node.getChildrenCount(); child > node.firstChild; --child)
+            stack.push_back(std::make_pair(child - 1, depth + 1));
+    }
+}
+
+unsigned FrozenTrie::getNumberOfBytesOfSearchArrays() const
+{
+    return this->nodes.capacity() * sizeof(FrozenTrieNode) + this->characters.capacity() * sizeof(CharType);
+}
+
+unsigned FrozenTrie::getNumberOfBytes() const
+{
+    return sizeof(FrozenTrie) + this->getNumberOfBytesOfSearchArrays()
+            + this->statistics.capacity() * sizeof(FrozenTrieNodeStatistics)
+            + this->trieNodes.capacity() * sizeof(const TrieNode *);
+}
+
+}
+}
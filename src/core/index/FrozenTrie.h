@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __INDEX_FROZENTRIE_H__
+#define __INDEX_FROZENTRIE_H__
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "util/half.h"
+#include "instantsearch/Constants.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+class TrieNode;
+
+/*
+ *  The hot part of a frozen trie node (24 bytes). The children of a node are the nodes
+ *  [firstChild, firstChild + childrenCount) of the frozen trie, and their characters are
+ *  the same range of FrozenTrie::characters.
+ */
+struct FrozenTrieNode
+{
+    unsigned firstChild;
+    // low 24 bits: number of children, bits 24-30: depth, bit 31: terminal flag
+    unsigned childrenCountDepthTerminalFlag;
+    unsigned id;
+    unsigned minId;
+    unsigned maxId;
+    unsigned invertedListOffset;
+
+    inline unsigned getChildrenCount() const {
+        return this->childrenCountDepthTerminalFlag & 0x00ffffff;
+    }
+    inline unsigned getDepth() const {
+        return (this->childrenCountDepthTerminalFlag >> 24) & 0x7f;
+    }
+    inline bool isTerminalNode() const {
+        return (this->childrenCountDepthTerminalFlag & 0x80000000) != 0;
+    }
+};
+
+// Histogram information of a frozen trie node. It is only needed to rank active nodes and
+// suggestions, so it is kept out of the nodes scanned during the active node computation.
+struct FrozenTrieNodeStatistics
+{
+    float nodeProbabilityValue;
+    unsigned numberOfTerminalNodes;
+    half_float::half maximumScoreOfLeafNodes;
+};
+
+struct FrozenActiveNode
+{
+    unsigned nodeIndex;
+    unsigned editDistance;
+    // the edit distance between the string of the node and the prefix up to the character the node
+    // matches. editDistance adds the deletion of the rest of the prefix.
+    unsigned prefixEditDistance;
+
+    FrozenActiveNode(unsigned nodeIndex, unsigned editDistance, unsigned prefixEditDistance):
+        nodeIndex(nodeIndex), editDistance(editDistance), prefixEditDistance(prefixEditDistance) {}
+};
+
+/*
+ *  A read-only copy of a committed trie in a contiguous, pointer-free layout.
+ *
+ *  The nodes are stored in breadth-first order, so that the children of every node are adjacent.
+ *  A node is addressed by its index (the root is always 0) and its children are an index range.
+ *  The characters of the nodes are stored in a separate packed array, so looking for a child only
+ *  scans the characters of its siblings, which are contiguous and can be compared with SIMD.
+ *
+ *  The frozen trie is built from the read view of the Trie after commit() and merge() (see
+ *  TrieRootNodeAndFreeList::freeze()) and lives as long as that read view. It keeps a pointer to
+ *  the TrieNode of every frozen node so that results can be handed to code working on TrieNodes.
+ *
+ *  It is a copy: the read view keeps its TrieNodes, so the frozen trie adds getNumberOfBytes()
+ *  to the memory of the trie, and a merge that changes the trie nodes or their histogram values
+ *  pays for rebuilding it. FrozenTrie_Test reports both.
+ */
+class FrozenTrie
+{
+public:
+    static const unsigned ROOT_INDEX = 0;
+    static const int NOT_FOUND = -1;
+
+    FrozenTrie(const TrieNode *root);
+
+    inline const FrozenTrieNode &getNode(unsigned nodeIndex) const {
+        return this->nodes[nodeIndex];
+    }
+
+    inline CharType getCharacter(unsigned nodeIndex) const {
+        return this->characters[nodeIndex];
+    }
+
+    inline const FrozenTrieNodeStatistics &getNodeStatistics(unsigned nodeIndex) const {
+        return this->statistics[nodeIndex];
+    }
+
+    inline const TrieNode *getTrieNode(unsigned nodeIndex) const {
+        return this->trieNodes[nodeIndex];
+    }
+
+    inline unsigned getNumberOfNodes() const {
+        return this->nodes.size();
+    }
+
+    // returns the index of the child of nodeIndex with the given character, or NOT_FOUND
+    inline int findChild(unsigned nodeIndex, CharType character) const {
+        const FrozenTrieNode &node = this->nodes[nodeIndex];
+        return findCharacter(&this->characters[0], node.firstChild,
+                node.firstChild + node.getChildrenCount(), character);
+    }
+
+    // returns the index of the node of the given prefix, or NOT_FOUND
+    int findNode(const std::vector<CharType> &prefix) const;
+
+    /*
+     * Finds the pivotal active nodes of the prefix, i.e. the active nodes PrefixActiveNodeSet keeps:
+     * the nodes whose last character matches a character of the prefix, with a transformation
+     * distance within editDistanceThreshold. It is a depth-first traversal that keeps one row of the
+     * edit distance matrix per depth and skips the subtries in which every entry of the row is above
+     * the threshold. The active nodes are appended in preorder.
+     *
+     * With supportSwapInEditDistance a swap of two adjacent characters costs 1 (the optimal string
+     * alignment distance), and a node that ends such a swap is pivotal as well. As in
+     * PrefixActiveNodeSet, the characters from CHARTYPE_FUZZY_UPPERBOUND on are never edited.
+     *
+     * Prefixes of up to 64 characters keep each row in two 64-bit words of vertical deltas, updated
+     * with Myers' bit-parallel algorithm, or with Hyyrö's extension of it for swaps, and only read
+     * the entries within the threshold of the diagonal (Ukkonen's cut-off). Thresholds 1 and 2 have
+     * their own instantiations so that these loops have constant bounds.
+     */
+    void computeActiveNodes(const std::vector<CharType> &prefix, unsigned editDistanceThreshold,
+            bool supportSwapInEditDistance, std::vector<FrozenActiveNode> &activeNodes) const;
+
+    // bytes used by the nodes and the characters, which are the arrays touched by the searches
+    unsigned getNumberOfBytesOfSearchArrays() const;
+
+    unsigned getNumberOfBytes() const;
+
+private:
+    // Sorted children are scanned linearly up to this count and binary searched above it.
+    static const unsigned LINEAR_SCAN_LIMIT = 32;
+    // a row of the edit distance matrix of a longer prefix does not fit in a word
+    static const unsigned MAXIMUM_BIT_PARALLEL_PREFIX_LENGTH = 64;
+
+    // StaticThreshold is the edit distance threshold, or -1 to use editDistanceThreshold
+    template <int StaticThreshold>
+    void computeActiveNodesBitParallel(const std::vector<CharType> &prefix, unsigned editDistanceThreshold,
+            bool supportSwapInEditDistance, std::vector<FrozenActiveNode> &activeNodes) const;
+
+    void computeActiveNodesWithRows(const std::vector<CharType> &prefix, unsigned editDistanceThreshold,
+            bool supportSwapInEditDistance, std::vector<FrozenActiveNode> &activeNodes) const;
+
+    static int findCharacter(const CharType *characters, unsigned begin, unsigned end, CharType character) {
+        if (end - begin > LINEAR_SCAN_LIMIT) {
+            const CharType *position = std::lower_bound(characters + begin, characters + end, character);
+            if (position != characters + end && *position == character)
+                return position - characters;
+            return NOT_FOUND;
+        }
+        unsigned i = begin;
+#ifdef __SSE2__
+        // compare four characters at a time
+        const __m128i key = _mm_set1_epi32((int) character);
+        for (; i + 4 <= end; i += 4) {
+            __m128i block = _mm_loadu_si128((const __m128i *) (characters + i));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(block, key)));
+            if (mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+#endif
+        for (; i < end; ++i) {
+            if (characters[i] == character)
+                return i;
+        }
+        return NOT_FOUND;
+    }
+
+    std::vector<FrozenTrieNode> nodes;
+    std::vector<CharType> characters;
+    std::vector<FrozenTrieNodeStatistics> statistics;
+    std::vector<const TrieNode *> trieNodes;
+};
+
+}
+}
+
+#endif // __INDEX_FROZENTRIE_H__
@@ -55,6 +55,7 @@ public:
     static const char* const analyzerFileName;
     static const char* const indexCountsFileName;
     static const char* const AccessControlFile;
+    static const char* const docValuesFileName;
 
     static const char* const quadTreeFileName;
 
@@ -31,6 +31,8 @@
 #include "index/Trie.h"
 #include "util/Assert.h"
 #include "util/Logger.h"
+#include "serialization/FlatSnapshot.h"
+#include "util/WorkStealingThreadPool.h"
 #include <math.h>
 
 #include <algorithm>
@@ -38,31 +40,123 @@
 #include <iostream>
 
 #include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <boost/bind.hpp>
 
 using std::endl;
 using std::vector;
 using srch2::util::Logger;
+using srch2::util::WorkStealingThreadPool;
+using srch2::util::TaskGroup;
 
 namespace srch2
 {
 namespace instantsearch
 {
+
+// FlatSection_CompressedListHeaders entry of one inverted list. Blocks and packed words are
+// indexes in the FlatSection_CompressedListBlocks and FlatSection_CompressedListPackedWords arrays.
+struct FlatCompressedListHeader {
+    uint64_t firstBlock;
+    uint64_t firstPackedWord;
+    uint32_t numberOfBlocks;
+    uint32_t numberOfPackedWords;
+    uint32_t size;
+    uint32_t isCompressed; // 0 if the list had no compressed read view when it was saved
+};
+
+// builds the compressed read view of a list whose elements are in list order
+static CompressedInvertedList *compressInvertedList(const vector<InvertedListIdAndScore>& invertedListElements)
+{
+    CompressedInvertedList *compressedList = new CompressedInvertedList();
+    for (unsigned i = 0; i < invertedListElements.size(); ++i)
+        compressedList->append(invertedListElements[i].recordId, invertedListElements[i].score);
+    compressedList->finalize();
+    return compressedList;
+}
+
+cowvector<unsigned> *InvertedListContainer::getUncompressedList() const
+{
+    shared_ptr<const CompressedInvertedList> compressedList;
+    cowvector<unsigned> *uncompressedList = this->getDecodedList(compressedList);
+    if (uncompressedList != NULL)
+        return uncompressedList;
+
+    // decoded outside of the lock, since decoding a long list takes a while
+    cowvector<unsigned> *decodedList = new cowvector<unsigned>(std::max(compressedList->size(), 1u));
+    vectorview<unsigned>* &writeView = decodedList->getWriteView();
+    unsigned recordIds[CompressedInvertedList::BLOCK_SIZE];
+    for (unsigned blockIndex = 0; blockIndex < compressedList->getNumberOfBlocks(); ++blockIndex) {
+        unsigned blockSize = compressedList->decodeBlock(blockIndex, recordIds);
+        for (unsigned i = 0; i < blockSize; ++i)
+            writeView->push_back(recordIds[i]);
+    }
+    // committed like a list after a load, the read view and the write view share the array
+    decodedList->commit();
+
+    pthread_spin_lock(&this->compressedReadViewLock);
+    if (this->invList == NULL) {
+        this->invList = decodedList;
+        decodedList = NULL;
+    }
+    uncompressedList = this->invList;
+    pthread_spin_unlock(&this->compressedReadViewLock);
+    delete decodedList;
+    return uncompressedList;
+}
+
+cowvector<unsigned> *InvertedListContainer::releaseUncompressedList()
+{
+    pthread_spin_lock(&this->compressedReadViewLock);
+    cowvector<unsigned> *releasedList = NULL;
+    if (this->compressedReadView) {
+        releasedList = this->invList;
+        this->invList = NULL;
+    }
+    pthread_spin_unlock(&this->compressedReadViewLock);
+    return releasedList;
+}
+
+void InvertedListContainer::compressLoadedList(const unsigned keywordId, const ForwardIndex *forwardIndex)
+{
+    shared_ptr<vectorview<ForwardListPtr> > forwardListDirectoryReadView;
+    forwardIndex->getForwardListDirectory_ReadView(forwardListDirectoryReadView);
+
+    shared_ptr<vectorview<unsigned> > readView;
+    this->getUncompressedList()->getReadView(readView);
+    vector<InvertedListIdAndScore> invertedListElements(readView->size());
+    for (unsigned i = 0; i < readView->size(); i++) {
+        invertedListElements[i].recordId = readView->getElement(i);
+        invertedListElements[i].score = forwardIndex->getTermRecordStaticScore(invertedListElements[i].recordId,
+                forwardIndex->getKeywordOffset(forwardListDirectoryReadView, invertedListElements[i].recordId, keywordId));
+    }
+    readView.reset();
+
+    this->setCompressedReadView(shared_ptr<const CompressedInvertedList>(compressInvertedList(invertedListElements)));
+    // no reader has seen the index yet
+    delete this->releaseUncompressedList();
+}
+
 void InvertedListContainer::sortAndMergeBeforeCommit(const unsigned keywordId, const ForwardIndex *forwardIndex, bool needToSortEachInvertedList)
 {
+    shared_ptr<vectorview<ForwardListPtr> > forwardListDirectoryReadView;
+    forwardIndex->getForwardListDirectory_ReadView(forwardListDirectoryReadView);
+
+    cowvector<unsigned> *invList = this->getUncompressedList();
+    vectorview<unsigned>* &writeView = invList->getWriteView();
+
+    // the scores are also needed for the skip data of the compressed read view
+    vector<InvertedListIdAndScore> invertedListElements(writeView->size());
+    for (unsigned i = 0; i< writeView->size(); i++) {
+        invertedListElements[i].recordId = writeView->getElement(i);
+        invertedListElements[i].score = forwardIndex->getTermRecordStaticScore(invertedListElements[i].recordId,
+        		forwardIndex->getKeywordOffset(forwardListDirectoryReadView, invertedListElements[i].recordId, keywordId));
+    }
+
     // sort this inverted list only if the flag is true.
     // if the flag is false, we only need to commit.
     if (needToSortEachInvertedList) {
-        shared_ptr<vectorview<ForwardListPtr> > forwardListDirectoryReadView;
-        forwardIndex->getForwardListDirectory_ReadView(forwardListDirectoryReadView);
-
-        vectorview<unsigned>* &writeView = this->invList->getWriteView();
-
-        vector<InvertedListIdAndScore> invertedListElements(writeView->size());
-        for (unsigned i = 0; i< writeView->size(); i++) {
-            invertedListElements[i].recordId = writeView->getElement(i);
-            invertedListElements[i].score = forwardIndex->getTermRecordStaticScore(invertedListElements[i].recordId,
-            		forwardIndex->getKeywordOffset(forwardListDirectoryReadView, invertedListElements[i].recordId, keywordId));
-        }
         std::sort(invertedListElements.begin(), invertedListElements.end(), InvertedListContainer::InvertedListElementGreaterThan());
 
         for (unsigned i = 0; i< writeView->size(); i++) {
@@ -70,7 +164,8 @@ void InvertedListContainer::sortAndMergeBeforeCommit(const unsigned keywordId, c
         }
     }
 
-    this->invList->commit();
+    invList->commit();
+    this->setCompressedReadView(shared_ptr<const CompressedInvertedList>(compressInvertedList(invertedListElements)));
 }
 
 // Main idea:
@@ -91,11 +186,12 @@ int InvertedListContainer::sortAndMerge(const unsigned keywordId, ForwardIndex *
 		RankerExpression *rankerExpression, const Schema *schema)
 {
 
+    cowvector<unsigned> *invList = this->getUncompressedList();
     shared_ptr<vectorview<unsigned> > readView;
-    this->invList->getReadView(readView);
+    invList->getReadView(readView);
     unsigned readViewListSize = readView->size();
 
-    vectorview<unsigned>* &writeView = this->invList->getWriteView();
+    vectorview<unsigned>* &writeView = invList->getWriteView();
     unsigned writeViewListSize = writeView->size();
 
     // when merging an inverted list, we want to ignore those records that have
@@ -114,6 +210,12 @@ int InvertedListContainer::sortAndMerge(const unsigned keywordId, ForwardIndex *
     if (invertedListElements.capacity() < writeViewListSize)
     	invertedListElements.reserve(writeViewListSize);
 
+    // A new list is committed in the order of its write view, deleted records included, so its
+    // compressed read view needs the score of each position. Deleted records get a score of 0.
+    vector<float> writeViewScores;
+    if (isNewInvertedList)
+        writeViewScores.resize(writeViewListSize, 0);
+
     // copy the elements from the write view to a vector to sort
     // OPT: avoid this copy
     unsigned validRecordCountFromReadView = 0; // count # of records that are not deleted
@@ -158,10 +260,15 @@ int InvertedListContainer::sortAndMerge(const unsigned keywordId, ForwardIndex *
         float tfBoostProduct = ((ForwardList*)forwardList)->getKeywordTfBoostProduct(keywordOffset);
         float textRelevance =  Ranker::computeTextRelevance(tfBoostProduct, idf);
         float score = rankerExpression->applyExpression(recordLength, recordBoost, textRelevance);
+        float oldScore = forwardList->getKeywordRecordStaticScore(keywordOffset);
         ((ForwardList*)forwardList)->setKeywordRecordStaticScore(keywordOffset, score);
+        if (forwardList->getKeywordRecordStaticScore(keywordOffset) != oldScore)
+            forwardIndex->markForwardListChanged(recordId);
         // add this new <recordId, score> pair to the vector
         InvertedListIdAndScore iliasEntry = {recordId, score};
         invertedListElements.push_back(iliasEntry);
+        if (isNewInvertedList)
+            writeViewScores[invListIter] = score;
         if (!isNewInvertedList && invListIter < readViewListSize) {
         	/*
         	 * increment this counter only if the readview and the writeview are different. If they
@@ -181,8 +288,13 @@ int InvertedListContainer::sortAndMerge(const unsigned keywordId, ForwardIndex *
     // if the read view and the write view are the same, it means we have added a new keyword with a new COWvector.
     // In this case, instead of calling "merge()", we call "commit()" to let this COWvector commit.
     if (readView.get() == writeView) {
-        this->invList->commit();
-        return this->invList->getWriteView()->size();
+        CompressedInvertedList *compressedList = new CompressedInvertedList();
+        for (unsigned i = 0; i < writeViewListSize; ++i)
+            compressedList->append(writeView->getElement(i), writeViewScores[i]);
+        compressedList->finalize();
+        invList->commit();
+        this->setCompressedReadView(shared_ptr<const CompressedInvertedList>(compressedList));
+        return invList->getWriteView()->size();
     }
 
     std::inplace_merge (invertedListElements.begin(),
@@ -200,12 +312,19 @@ int InvertedListContainer::sortAndMerge(const unsigned keywordId, ForwardIndex *
         writeView->at(i) = invertedListElements[i].recordId;
     }
 
-    this->invList->merge();
-    return this->invList->getWriteView()->size();
+    // build the compressed view before the merge so that it is published right after the read view
+    shared_ptr<const CompressedInvertedList> compressedList(compressInvertedList(invertedListElements));
+    invList->merge();
+    this->setCompressedReadView(compressedList);
+    return invList->getWriteView()->size();
 }
 
 
-InvertedIndex::InvertedIndex(ForwardIndex *forwardIndex)
+// number of inverted lists in a segment of the snapshot
+static const unsigned INVERTED_INDEX_SNAPSHOT_SEGMENT_SIZE = 4096;
+
+InvertedIndex::InvertedIndex(ForwardIndex *forwardIndex) :
+        invertedListSegments("lists", INVERTED_INDEX_SNAPSHOT_SEGMENT_SIZE)
 {
     //this->invertedIndexVector = new cowvector<InvertedListContainerPtr>(100);
     this->invertedIndexVector = NULL;
@@ -281,6 +400,7 @@ void InvertedIndex::incrementHitCount(unsigned invertedIndexDirectoryIndex)
         	// This block is executed after bulkload. commit the new list to separate the readview and the writeview.
         	newInvertedListAfterBulkLoad->invList->commit();
             writeView->push_back(newInvertedListAfterBulkLoad);
+            this->invertedListSegments.markChanged(invertedIndexDirectoryIndex);
         }
     }
 }
@@ -341,14 +461,24 @@ void InvertedIndex::commit( ForwardList *forwardList,
                             RankerExpression *rankerExpression,
                             const unsigned forwardListOffset, const unsigned totalNumberOfDocuments,
                             const Schema *schema, const vector<NewKeywordIdKeywordOffsetTriple> &newKeywordIdKeywordOffsetTriple)
+{
+    if (this->commited_WriteView == false) {
+        this->computeRecordStaticScoresAtCommit(forwardList, rankerExpression, totalNumberOfDocuments,
+                newKeywordIdKeywordOffsetTriple);
+        this->addRecordAtCommit(forwardListOffset, newKeywordIdKeywordOffsetTriple);
+    }
+}
+
+void InvertedIndex::computeRecordStaticScoresAtCommit(ForwardList *forwardList, RankerExpression *rankerExpression,
+        const unsigned totalNumberOfDocuments,
+        const vector<NewKeywordIdKeywordOffsetTriple> &newKeywordIdKeywordOffsetTriple) const
 {
     if (this->commited_WriteView == false) {
         //unsigned sumOfOccurancesOfAllKeywordsInRecord = 0;
         float recordBoost = forwardList->getRecordBoost();
+        float recordLength = forwardList->getNumberOfKeywords();
 
         for (unsigned counter = 0; counter < forwardList->getNumberOfKeywords(); counter++) {
-            //unsigned keywordId = forwardIndex->getForwardListElementByDirectory(forwardListOffset , counter);//->keywordId;
-            unsigned keywordId = newKeywordIdKeywordOffsetTriple.at(counter).first;
             unsigned invertedListId = newKeywordIdKeywordOffsetTriple.at(counter).second.second;
             float idf = this->getIdf(totalNumberOfDocuments, invertedListId); // Uses invertedListSizeDirectory at commit stage
 
@@ -357,33 +487,70 @@ void InvertedIndex::commit( ForwardList *forwardList,
             //sumOfOccurancesOfAllKeywordsInRecord += numberOfOccurancesOfGivenKeywordInRecord;
 
             float tfBoostProduct = forwardList->getKeywordTfBoostProduct(counter);
-            float recordLength = forwardList->getNumberOfKeywords();
             float score = this->computeRecordStaticScore(rankerExpression, recordBoost, recordLength, idf, tfBoostProduct);
 
+            forwardList->setKeywordTfBoostProduct(counter, tfBoostProduct);
+            forwardList->setKeywordRecordStaticScore(counter, score);
+        }
+    }
+}
+
+void InvertedIndex::addRecordAtCommit(const unsigned forwardListOffset,
+        const vector<NewKeywordIdKeywordOffsetTriple> &newKeywordIdKeywordOffsetTriple)
+{
+    if (this->commited_WriteView == false) {
+        vectorview<unsigned>* &writeView = this->keywordIds->getWriteView();
+        for (unsigned counter = 0; counter < newKeywordIdKeywordOffsetTriple.size(); counter++) {
+            unsigned keywordId = newKeywordIdKeywordOffsetTriple[counter].first;
+            unsigned invertedListId = newKeywordIdKeywordOffsetTriple[counter].second.second;
+
             //assign keywordId for the invertedListId
-            vectorview<unsigned>* &writeView = this->keywordIds->getWriteView();
             writeView->at(invertedListId) = keywordId;
             this->addInvertedListElement(invertedListId, forwardListOffset);
-            forwardList->setKeywordTfBoostProduct(counter, tfBoostProduct);
-            forwardList->setKeywordRecordStaticScore(counter, score);
         }
     }
 }
 
+// sorts and compresses the inverted lists [begin, end) at commit; lists of different ranges are independent
+static void sortAndMergeInvertedListsBeforeCommit(const vectorview<InvertedListContainerPtr> *invertedListsWriteView,
+        const vectorview<unsigned> *keywordIdsWriteView, const ForwardIndex *forwardIndex,
+        bool needToSortEachInvertedList, unsigned begin, unsigned end)
+{
+    for (unsigned iter = begin; iter < end; ++iter) {
+        invertedListsWriteView->getElement(iter)->sortAndMergeBeforeCommit(keywordIdsWriteView->getElement(iter),
+                forwardIndex, needToSortEachInvertedList);
+        // readers only see the lists after the first commit, so the cowvector can be freed right away
+        delete invertedListsWriteView->getElement(iter)->releaseUncompressedList();
+    }
+}
+
 void InvertedIndex::finalCommit(bool needToSortEachInvertedList)
 {
     vectorview<InvertedListContainerPtr>* &writeView = this->invertedIndexVector->getWriteView();
     unsigned sizeOfList = writeView->size();
     vectorview<unsigned>* &keywordIdsWriteView = this->keywordIds->getWriteView();
 
-    for (unsigned iter = 0; iter < sizeOfList; ++iter) {
-        writeView->at(iter)->sortAndMergeBeforeCommit(keywordIdsWriteView->getElement(iter), this->forwardIndex, needToSortEachInvertedList);
+    WorkStealingThreadPool *pool = WorkStealingThreadPool::getSharedPool();
+    // a few ranges per thread so that a range with long lists does not hold back the others
+    unsigned numberOfRanges = pool->getNumberOfThreads() * 4;
+    unsigned rangeSize = std::max(sizeOfList / numberOfRanges + 1, 1024u);
+    if (pool->getNumberOfThreads() < 2 || sizeOfList <= rangeSize) {
+        sortAndMergeInvertedListsBeforeCommit(writeView, keywordIdsWriteView, this->forwardIndex,
+                needToSortEachInvertedList, 0, sizeOfList);
+    } else {
+        TaskGroup taskGroup(pool);
+        for (unsigned begin = 0; begin < sizeOfList; begin += rangeSize) {
+            taskGroup.run(boost::bind(&sortAndMergeInvertedListsBeforeCommit, writeView, keywordIdsWriteView,
+                    this->forwardIndex, needToSortEachInvertedList, begin, std::min(begin + rangeSize, sizeOfList)));
+        }
+        taskGroup.wait();
     }
 
     this->invertedIndexVector->commit();
     this->keywordIds->commit();
     this->commited_WriteView = true;
     this->invertedListSizeDirectory.clear();
+    this->invertedListSegments.reserve(sizeOfList);
 }
 
 void InvertedIndex::merge(RankerExpression *rankerExpression, unsigned totalNumberOfDocuments,
@@ -407,6 +574,12 @@ void InvertedIndex::merge(RankerExpression *rankerExpression, unsigned totalNumb
     			this->forwardIndex, forwardListDirectoryReadView, invertedListElements,
     			totalNumberOfDocuments, rankerExpression, schema);
     	invertedListElements.clear();
+    	this->invertedListSegments.markChanged(iter->first);
+    	// the compressed read view is published, so the cowvector is not kept until the list changes
+    	// again. Readers of the current read views may still use it (see Trie::retireWithReadView()).
+    	cowvector<unsigned> *releasedList = writeView->at(iter->first)->releaseUncompressedList();
+    	if (releasedList != NULL)
+    		trie->retireWithReadView(boost::shared_ptr<const void>(releasedList));
     	if (finalInvListWriteViewSize == 0) {
             // This inverted list is empty, so we add it to the list
             // of empty leaf node ids to delete later
@@ -454,6 +627,7 @@ unsigned  InvertedIndex::workerMergeTask(RankerExpression *rankerExpression,
                       this->forwardIndex,forwardListDirectoryReadView, invertedListElements,
                       totalNumberOfDocuments, rankerExpression, schema);
             invertedListElements.clear();
+            this->invertedListSegments.markChanged(invertedListId);
 
             if (finalInvListWriteViewSize == 0) {
 	            // This inverted list is empty, so we add it to the list
@@ -501,7 +675,7 @@ void InvertedIndex::parallelMerge()
     // Notify each worker that queue is ready.
     for (unsigned i = 0; i < mergeWorkersCount; ++i) {
     	pthread_mutex_lock(&mergeWorkersArgs[i].perThreadMutex);
-    	__sync_or_and_fetch(&mergeWorkersArgs[i].isDataReady, true);
+    	__atomic_store_n(&mergeWorkersArgs[i].isDataReady, true, __ATOMIC_SEQ_CST);
     	pthread_cond_signal(&mergeWorkersArgs[i].waitConditionVar);
     	pthread_mutex_unlock(&mergeWorkersArgs[i].perThreadMutex);
     }
@@ -579,6 +753,7 @@ void InvertedIndex::addInvertedListElement(unsigned keywordId, unsigned recordId
     ASSERT( keywordId < writeView->size());
 
     writeView->at(keywordId)->addInvertedListElement(recordId);
+    this->invertedListSegments.markChanged(keywordId);
 }
 
 void InvertedIndex::getInvertedListReadView(shared_ptr<vectorview<InvertedListContainerPtr> > & invertedListDirectoryReadView,
@@ -588,6 +763,13 @@ void InvertedIndex::getInvertedListReadView(shared_ptr<vectorview<InvertedListCo
     invertedListDirectoryReadView->getElement(invertedListId)->getInvertedList(invertedListReadView);
 }
 
+void InvertedIndex::getInvertedListCursor(shared_ptr<vectorview<InvertedListContainerPtr> > & invertedListDirectoryReadView,
+		const unsigned invertedListId, InvertedListCursor& cursor) const
+{
+    ASSERT(invertedListId < invertedListDirectoryReadView->size());
+    invertedListDirectoryReadView->getElement(invertedListId)->getInvertedListCursor(cursor);
+}
+
 void InvertedIndex::getInvertedIndexDirectory_ReadView(
 		shared_ptr<vectorview<InvertedListContainerPtr> > & invertedListDirectoryReadView) const{
 	this->invertedIndexVector->getReadView(invertedListDirectoryReadView);
@@ -653,6 +835,245 @@ void InvertedIndex::appendInvertedListKeywordIdsForMerge(const vector<pair<unsig
  }
 
 
+// Writes the inverted lists [begin, end) of the read view to one snapshot file. The lists of the
+// file are addressed relative to its first list. A list is stored as its compressed read view, and
+// only the lists without one (e.g. lists loaded from a boost archive and not merged since) are
+// stored uncompressed.
+static void saveInvertedLists(const string &fileName,
+        const shared_ptr<vectorview<InvertedListContainerPtr> > &directoryReadView, unsigned begin, unsigned end)
+{
+    FlatSnapshotWriter writer(fileName);
+
+    vector<FlatCompressedListHeader> compressedListHeaders(end - begin);
+    vector<shared_ptr<const CompressedInvertedList> > compressedLists(end - begin);
+    uint64_t numberOfBlocks = 0, numberOfPackedWords = 0;
+    for (unsigned i = 0; i < end - begin; ++i) {
+        const InvertedListContainer *list = directoryReadView->getElement(begin + i);
+        list->getCompressedReadView(compressedLists[i]);
+        FlatCompressedListHeader &header = compressedListHeaders[i];
+        memset(&header, 0, sizeof(header));
+        header.firstBlock = numberOfBlocks;
+        header.firstPackedWord = numberOfPackedWords;
+        // a compressed view is only valid with the read view it was built from
+        if (compressedLists[i] && compressedLists[i]->size() == list->getReadViewSize()) {
+            header.numberOfBlocks = compressedLists[i]->getNumberOfBlocks();
+            header.numberOfPackedWords = compressedLists[i]->getNumberOfPackedWords();
+            header.size = compressedLists[i]->size();
+            header.isCompressed = 1;
+            numberOfBlocks += header.numberOfBlocks;
+            numberOfPackedWords += header.numberOfPackedWords;
+        } else {
+            compressedLists[i].reset();
+        }
+    }
+
+    // offsets of the uncompressed lists in the record id array, with one extra entry for the end of the
+    // last list. A compressed list has an empty range.
+    vector<uint64_t> offsets;
+    offsets.reserve(end - begin + 1);
+    offsets.push_back(0);
+    writer.beginSection(FlatSection_InvertedListRecordIds);
+    for (unsigned i = 0; i < end - begin; ++i) {
+        unsigned size = 0;
+        if (!compressedLists[i]) {
+            shared_ptr<vectorview<unsigned> > listReadView;
+            directoryReadView->getElement(begin + i)->getInvertedList(listReadView);
+            size = listReadView->size();
+            if (size > 0)
+                writer.append(&listReadView->getElement(0), size * sizeof(unsigned));
+        }
+        offsets.push_back(offsets.back() + size);
+    }
+    writer.endSection();
+    writer.addSection(FlatSection_InvertedListOffsets, &offsets[0], offsets.size() * sizeof(uint64_t));
+
+    writer.addSection(FlatSection_CompressedListHeaders, compressedListHeaders.empty() ? NULL : &compressedListHeaders[0],
+            compressedListHeaders.size() * sizeof(FlatCompressedListHeader));
+    writer.beginSection(FlatSection_CompressedListBlocks);
+    for (unsigned i = 0; i < compressedLists.size(); ++i) {
+        if (compressedLists[i] && compressedLists[i]->getNumberOfBlocks() > 0)
+            writer.append(compressedLists[i]->getBlocks(),
+                    compressedLists[i]->getNumberOfBlocks() * sizeof(InvertedListBlockInfo));
+    }
+    writer.endSection();
+    writer.beginSection(FlatSection_CompressedListPackedWords);
+    for (unsigned i = 0; i < compressedLists.size(); ++i) {
+        if (compressedLists[i] && compressedLists[i]->getNumberOfPackedWords() > 0)
+            writer.append(compressedLists[i]->getPackedWords(),
+                    compressedLists[i]->getNumberOfPackedWords() * sizeof(unsigned));
+    }
+    writer.endSection();
+    writer.finish();
 }
+
+void InvertedIndex::saveSnapshot(const string &fileName) const
+{
+    ASSERT(invertedIndexVector != NULL);
+    ASSERT(keywordIds != NULL);
+    shared_ptr<vectorview<InvertedListContainerPtr> > directoryReadView;
+    this->invertedIndexVector->getReadView(directoryReadView);
+    shared_ptr<vectorview<unsigned> > keywordIdsReadView;
+    this->keywordIds->getReadView(keywordIdsReadView);
+    const unsigned numberOfLists = directoryReadView->size();
+    const unsigned segmentSize = this->invertedListSegments.getSegmentSize();
+
+    this->invertedListSegments.beginSave(fileName, numberOfLists);
+    const unsigned numberOfSegments = this->invertedListSegments.getNumberOfSegmentsToSave();
+    for (unsigned segmentId = 0; segmentId < numberOfSegments; ++segmentId) {
+        if (this->invertedListSegments.isSegmentToSave(segmentId)) {
+            unsigned begin = segmentId * segmentSize;
+            saveInvertedLists(this->invertedListSegments.startSegment(segmentId), directoryReadView,
+                    begin, std::min(begin + segmentSize, numberOfLists));
+        }
+    }
+
+    // the keyword ids change with every reassignment of keyword ids, so they are kept in the manifest
+    FlatSnapshotWriter writer(fileName);
+    if (keywordIdsReadView->size() > 0)
+        writer.addSection(FlatSection_InvertedListKeywordIds, &keywordIdsReadView->getElement(0),
+                keywordIdsReadView->size() * sizeof(unsigned));
+    else
+        writer.addSection(FlatSection_InvertedListKeywordIds, NULL, 0);
+    this->invertedListSegments.addManifestSection(writer, FlatSection_InvertedListSegments);
+    writer.finish();
+
+    this->invertedListSegments.commitSave();
+    Logger::debug("Inverted index saved: %d of %d segments written",
+            this->invertedListSegments.getNumberOfSegmentsWritten(), numberOfSegments);
+}
+
+// Checks the block layout of a compressed list loaded from a snapshot, so that decoding it
+// never reads outside of its packed words.
+static bool isValidCompressedList(const FlatCompressedListHeader &header, const InvertedListBlockInfo *blocks)
+{
+    const unsigned blockSize = CompressedInvertedList::BLOCK_SIZE;
+    if (header.numberOfBlocks != (header.size + blockSize - 1) / blockSize)
+        return false;
+    for (unsigned blockIndex = 0; blockIndex < header.numberOfBlocks; ++blockIndex) {
+        unsigned begin = blocks[blockIndex].packedOffset;
+        unsigned end = blockIndex + 1 < header.numberOfBlocks ? blocks[blockIndex + 1].packedOffset : header.numberOfPackedWords;
+        if (begin > end || end > header.numberOfPackedWords)
+            return false;
+        unsigned numberOfElements = blockIndex + 1 < header.numberOfBlocks ? blockSize : header.size - blockIndex * blockSize;
+        if (numberOfElements < blockSize) {
+            if (end - begin != numberOfElements)
+                return false;
+        } else if ((end - begin) % srch2::util::BlockPacking::LANES != 0
+                || end - begin > srch2::util::BlockPacking::getNumberOfWords(32)) {
+            return false;
+        }
+    }
+    return true;
 }
 
+void InvertedIndex::loadInvertedLists(const FlatSnapshotReader &reader,
+        vectorview<InvertedListContainerPtr>* &writeView)
+{
+    const string &fileName = reader.getMappedFile()->getFileName();
+    uint64_t numberOfOffsets, numberOfRecordIds;
+    const uint64_t *offsets = reader.getSectionAsArray<uint64_t>(FlatSection_InvertedListOffsets, numberOfOffsets);
+    const unsigned *recordIds = reader.getSectionAsArray<unsigned>(FlatSection_InvertedListRecordIds, numberOfRecordIds);
+    bool valid = numberOfOffsets > 0 && offsets[numberOfOffsets - 1] == numberOfRecordIds;
+    for (uint64_t i = 1; valid && i < numberOfOffsets; ++i)
+        valid = offsets[i - 1] <= offsets[i];
+    if (!valid) {
+        Logger::error("Inverted index snapshot %s is corrupted", fileName.c_str());
+        throw std::runtime_error("Corrupted inverted index snapshot " + fileName);
+    }
+    unsigned numberOfLists = numberOfOffsets - 1;
+
+    // Snapshots written before compressed lists existed do not have these sections. Their
+    // lists are read uncompressed until they are merged.
+    const FlatCompressedListHeader *headers = NULL;
+    const InvertedListBlockInfo *blocks = NULL;
+    const unsigned *packedWords = NULL;
+    uint64_t numberOfBlocks = 0, numberOfPackedWords = 0;
+    if (reader.hasSection(FlatSection_CompressedListHeaders)) {
+        uint64_t numberOfHeaders;
+        headers = reader.getSectionAsArray<FlatCompressedListHeader>(FlatSection_CompressedListHeaders, numberOfHeaders);
+        blocks = reader.getSectionAsArray<InvertedListBlockInfo>(FlatSection_CompressedListBlocks, numberOfBlocks);
+        packedWords = reader.getSectionAsArray<unsigned>(FlatSection_CompressedListPackedWords, numberOfPackedWords);
+        if (numberOfHeaders != numberOfLists) {
+            Logger::error("Inverted index snapshot %s is corrupted", fileName.c_str());
+            throw std::runtime_error("Corrupted inverted index snapshot " + fileName);
+        }
+    }
+
+    // The mapping is private and writable, so the cowvectors can point into it even though
+    // the writer may later update some elements in place.
+    unsigned *mappedRecordIds = const_cast<unsigned *>(recordIds);
+    for (unsigned listId = 0; listId < numberOfLists; ++listId) {
+        uint64_t numberOfUncompressedIds = offsets[listId + 1] - offsets[listId];
+        if (headers == NULL || !headers[listId].isCompressed) {
+            writeView->push_back(new InvertedListContainer(new cowvector<unsigned>(mappedRecordIds + offsets[listId],
+                    numberOfUncompressedIds)));
+            continue;
+        }
+        // Compressed lists have no uncompressed copy, except in the snapshots written before the
+        // uncompressed copy was dropped.
+        const FlatCompressedListHeader &header = headers[listId];
+        if ((numberOfUncompressedIds != 0 && numberOfUncompressedIds != header.size)
+                || header.firstBlock + header.numberOfBlocks > numberOfBlocks
+                || header.firstPackedWord + header.numberOfPackedWords > numberOfPackedWords
+                || !isValidCompressedList(header, blocks + header.firstBlock)) {
+            Logger::error("Inverted index snapshot %s is corrupted", fileName.c_str());
+            throw std::runtime_error("Corrupted inverted index snapshot " + fileName);
+        }
+        shared_ptr<const CompressedInvertedList> compressedList(
+                new CompressedInvertedList(header.size, blocks + header.firstBlock, header.numberOfBlocks,
+                        packedWords + header.firstPackedWord, header.numberOfPackedWords));
+        if (numberOfUncompressedIds == header.size && header.size != 0) {
+            InvertedListContainer *list = new InvertedListContainer(new cowvector<unsigned>(
+                    mappedRecordIds + offsets[listId], numberOfUncompressedIds));
+            list->setCompressedReadView(compressedList);
+            writeView->push_back(list);
+        } else {
+            writeView->push_back(new InvertedListContainer(compressedList));
+        }
+    }
+    this->snapshotMappings.push_back(reader.getMappedFile());
+}
+
+void InvertedIndex::loadSnapshot(const string &fileName)
+{
+    // loading is only supported for a new (empty) inverted index
+    ASSERT(invertedIndexVector == NULL && keywordIds == NULL);
+    FlatSnapshotReader reader(fileName);
+
+    uint64_t numberOfKeywordIds;
+    const unsigned *keywordIdsArray = reader.getSectionAsArray<unsigned>(FlatSection_InvertedListKeywordIds, numberOfKeywordIds);
+
+    this->invertedIndexVector = new cowvector<InvertedListContainerPtr>();
+    vectorview<InvertedListContainerPtr>* &writeView = this->invertedIndexVector->getWriteView();
+    // Snapshots written before segments existed have all the lists in the file itself.
+    if (reader.hasSection(FlatSection_InvertedListSegments)) {
+        unsigned numberOfSegments = this->invertedListSegments.load(fileName, reader, FlatSection_InvertedListSegments);
+        for (unsigned segmentId = 0; segmentId < numberOfSegments; ++segmentId)
+            this->loadInvertedLists(FlatSnapshotReader(this->invertedListSegments.getSegmentFileName(segmentId)), writeView);
+    } else {
+        this->loadInvertedLists(reader, writeView);
+    }
+    this->invertedIndexVector->commit();
+    this->invertedListSegments.reserve(writeView->size());
+
+    this->keywordIds = new cowvector<unsigned>(const_cast<unsigned *>(keywordIdsArray), numberOfKeywordIds);
+    this->snapshotMappings.push_back(reader.getMappedFile());
+    this->commited_WriteView = true;
+}
+
+void InvertedIndex::compressLoadedInvertedLists()
+{
+    ASSERT(this->forwardIndex != NULL);
+    vectorview<InvertedListContainerPtr>* &writeView = this->invertedIndexVector->getWriteView();
+    vectorview<unsigned>* &keywordIdsWriteView = this->keywordIds->getWriteView();
+    for (unsigned invertedListId = 0; invertedListId < writeView->size(); ++invertedListId) {
+        shared_ptr<const CompressedInvertedList> compressedList;
+        writeView->getElement(invertedListId)->getCompressedReadView(compressedList);
+        if (!compressedList)
+            writeView->getElement(invertedListId)->compressLoadedList(
+                    keywordIdsWriteView->getElement(invertedListId), this->forwardIndex);
+    }
+}
+
+}
+}
@@ -32,7 +32,10 @@
 #define __INVERTEDINDEX_H__
 
 #include "util/cowvector/cowvector.h"
+#include "util/MappedFile.h"
+#include "serialization/FlatSnapshot.h"
 #include "index/ForwardIndex.h"
+#include "index/CompressedInvertedList.h"
 
 #include <instantsearch/Ranker.h>
 #include "util/Assert.h"
@@ -127,66 +130,131 @@ private:
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version)
     {
-    	// invList should not be NULL. In the debug mode, alert a developer via ASSERT
-    	ASSERT(invList != NULL);
-        if (invList == NULL)  // In release mode, create new memory.
+    	// invList should not be NULL unless the list only has its compressed read view. In the debug mode,
+    	// alert a developer via ASSERT
+    	ASSERT(invList != NULL || compressedReadView);
+        if (invList == NULL && !compressedReadView)  // In release mode, create new memory.
         	invList = new cowvector<unsigned>();
         // Always use the object reference instead of pointer for boost serialization. During the load phase
         // boost tends to allocate new memory for the pointer leaking the existing one.
-        ar & *invList;
+        ar & *this->getUncompressedList();
     }
 
 public:
 
-    cowvector<unsigned> *invList;
+    // NULL while the list is only stored as its compressed read view, i.e. after it was loaded from
+    // a flat snapshot or committed, until it is decoded again, so it is only accessed through
+    // getUncompressedList() (see below).
+    mutable cowvector<unsigned> *invList;
 
     InvertedListContainer() // TODO for serialization. Remove dependency
     {
     	this->invList = new cowvector<unsigned>;
+        pthread_spin_init(&this->compressedReadViewLock, 0);
     };
 
     InvertedListContainer(unsigned capacity)
     {
         this->invList = new cowvector<unsigned>(capacity);
+        pthread_spin_init(&this->compressedReadViewLock, 0);
+    };
+
+    // takes the ownership of an already built list, e.g. one loaded from a flat snapshot
+    InvertedListContainer(cowvector<unsigned> *invList)
+    {
+        this->invList = invList;
+        pthread_spin_init(&this->compressedReadViewLock, 0);
+    };
+
+    // Creates a list of which only the compressed read view is stored, e.g. a list loaded from a flat
+    // snapshot. The uncompressed list is decoded the first time the writer or a reader needs it.
+    InvertedListContainer(const shared_ptr<const CompressedInvertedList>& compressedReadView)
+    {
+        this->invList = NULL;
+        this->compressedReadView = compressedReadView;
+        pthread_spin_init(&this->compressedReadViewLock, 0);
     };
 
     virtual ~InvertedListContainer()
     {
         delete invList;
+        pthread_spin_destroy(&this->compressedReadViewLock);
     };
 
     const unsigned getInvertedListElement(unsigned index) const
     {
         shared_ptr<vectorview<unsigned> > readView;
-        this->invList->getReadView(readView);
+        this->getUncompressedList()->getReadView(readView);
         return readView->getElement(index);
     };
 
+    // decodes the list if it only has its compressed read view, prefer getInvertedListCursor()
     void getInvertedList(shared_ptr<vectorview<unsigned> >& readview) const
     {
-        this->invList->getReadView(readview);
+        this->getUncompressedList()->getReadView(readview);
+    }
+
+    // The block-packed committed read view, built when the list is committed or merged. Once it is
+    // published the cowvector is released (see releaseUncompressedList()), so between merges a list is
+    // only stored in this form. The cowvector is decoded again when the writer changes the list or a
+    // reader that does not use a cursor asks for it.
+    void getCompressedReadView(shared_ptr<const CompressedInvertedList>& compressedReadView) const
+    {
+        pthread_spin_lock(&this->compressedReadViewLock);
+        compressedReadView = this->compressedReadView;
+        pthread_spin_unlock(&this->compressedReadViewLock);
+    }
+
+    void setCompressedReadView(const shared_ptr<const CompressedInvertedList>& compressedReadView)
+    {
+        pthread_spin_lock(&this->compressedReadViewLock);
+        this->compressedReadView = compressedReadView;
+        pthread_spin_unlock(&this->compressedReadViewLock);
+    }
+
+    // a cursor on the compressed read view if there is one, otherwise on the uncompressed read view
+    void getInvertedListCursor(InvertedListCursor& cursor) const
+    {
+        shared_ptr<const CompressedInvertedList> compressedList;
+        this->getCompressedReadView(compressedList);
+        if (compressedList) {
+            cursor = InvertedListCursor(compressedList);
+        } else {
+            shared_ptr<vectorview<unsigned> > readView;
+            this->getUncompressedList()->getReadView(readView);
+            cursor = InvertedListCursor(readView);
+        }
     }
 
     unsigned getReadViewSize() const
     {
+        shared_ptr<const CompressedInvertedList> compressedList;
+        cowvector<unsigned> *decodedList = this->getDecodedList(compressedList);
+        if (decodedList == NULL)
+            return compressedList->size();
         shared_ptr<vectorview<unsigned> > readView;
-        this->invList->getReadView(readView);
+        decodedList->getReadView(readView);
         return readView->size();
     };
 
     unsigned getWriteViewSize() const
     {
-        return this->invList->getWriteView()->size();
+        // the write view of a list that is not decoded is its read view
+        shared_ptr<const CompressedInvertedList> compressedList;
+        cowvector<unsigned> *decodedList = this->getDecodedList(compressedList);
+        if (decodedList == NULL)
+            return compressedList->size();
+        return decodedList->getWriteView()->size();
     };
 
     void setInvertedListElement(unsigned index, unsigned recordId)
     {
-        this->invList->getWriteView()->at(index) = recordId;
+        this->getUncompressedList()->getWriteView()->at(index) = recordId;
     };
 
     void addInvertedListElement(unsigned recordId)
     {
-        this->invList->getWriteView()->push_back(recordId);
+        this->getUncompressedList()->getWriteView()->push_back(recordId);
     };
 
     void sortAndMergeBeforeCommit(const unsigned keywordId, const ForwardIndex *forwardIndex, bool needToSortEachInvertedList);
@@ -197,6 +265,38 @@ public:
     		vector<InvertedListIdAndScore>& invertedListElements,
     		unsigned totalNumberOfDocuments,
     		RankerExpression *rankerExpression, const Schema *schema);
+
+    // Returns the cowvector of the list, and decodes it from the compressed read view first if the list
+    // was created from that view only. A reader and the writer may both decode it, the first one wins.
+    cowvector<unsigned> *getUncompressedList() const;
+
+    // Called by the writer after the compressed read view of a commit or merge is published. Detaches
+    // the cowvector, so that the compressed read view is the only copy of the list until the list is
+    // decoded again. Readers that took the cowvector before may still use it, so the caller frees it
+    // after them. Returns NULL if the list has no compressed read view.
+    cowvector<unsigned> *releaseUncompressedList();
+
+    // Builds the compressed read view of a list loaded from a boost archive and releases its cowvector.
+    // The list is in the order of its read view, and the scores are taken from the forward index.
+    void compressLoadedList(const unsigned keywordId, const ForwardIndex *forwardIndex);
+
+private:
+    // returns invList, or NULL after setting compressedList to the compressed read view
+    cowvector<unsigned> *getDecodedList(shared_ptr<const CompressedInvertedList>& compressedList) const
+    {
+        pthread_spin_lock(&this->compressedReadViewLock);
+        cowvector<unsigned> *decodedList = this->invList;
+        if (decodedList == NULL)
+            compressedList = this->compressedReadView;
+        pthread_spin_unlock(&this->compressedReadViewLock);
+        return decodedList;
+    }
+
+    // The writer replaces the compressed read view after a merge while readers take copies of it,
+    // so the shared pointer is protected like the read view of a cowvector. The lock also protects
+    // invList while it is NULL.
+    shared_ptr<const CompressedInvertedList> compressedReadView;
+    mutable pthread_spinlock_t compressedReadViewLock;
 };
 
 typedef InvertedListContainer* InvertedListContainerPtr;
@@ -262,6 +362,10 @@ public:
      */
     void getInvertedListReadView(shared_ptr<vectorview<InvertedListContainerPtr> > & invertedListDirectoryReadView,
     		const unsigned invertedListId, shared_ptr<vectorview<unsigned> >& readview) const;
+    // Gets a cursor on the same read view, which decodes the compressed blocks of the list lazily.
+    // Operators that scan inverted lists should use it instead of the read view.
+    void getInvertedListCursor(shared_ptr<vectorview<InvertedListContainerPtr> > & invertedListDirectoryReadView,
+    		const unsigned invertedListId, InvertedListCursor& cursor) const;
     void getInvertedIndexDirectory_ReadView(shared_ptr<vectorview<InvertedListContainerPtr> > & invertedListDirectoryReadView) const;
     void getInvertedIndexKeywordIds_ReadView(shared_ptr<vectorview<unsigned> > & invertedIndexKeywordIdsReadView) const;
     unsigned getInvertedListSize_ReadView(const unsigned invertedListId) const;
@@ -293,11 +397,20 @@ public:
     void commit( ForwardList *forwardList, RankerExpression *rankerExpression,
             const unsigned forwardListOffset, const unsigned totalNumberOfDocuments,
             const Schema *schema, const vector<NewKeywordIdKeywordOffsetTriple> &newKeywordIdKeywordOffsetTriple);
+    // The two halves of commit(). The first one only touches the given forward list and can run for
+    // different forward lists in parallel (with one ranker expression per thread). The second one appends
+    // the record to its inverted lists and must be called in the order of the forward list offsets.
+    void computeRecordStaticScoresAtCommit(ForwardList *forwardList, RankerExpression *rankerExpression,
+            const unsigned totalNumberOfDocuments,
+            const vector<NewKeywordIdKeywordOffsetTriple> &newKeywordIdKeywordOffsetTriple) const;
+    void addRecordAtCommit(const unsigned forwardListOffset,
+            const vector<NewKeywordIdKeywordOffsetTriple> &newKeywordIdKeywordOffsetTriple);
 
     // When we construct the inverted index from a set of records, in the commit phase we need to sort each inverted list,
     // i.e., needToSortEachInvertedList = true.
 	// When we load the inverted index from disk, we do NOT need to sort each inverted list since it's already sorted,
     // i.e., needToSortEachInvertedList = false.
+    // The inverted lists are sorted and compressed in parallel on the shared thread pool.
     void finalCommit(bool needToSortEachInvertedList = true);
     void merge(RankerExpression *rankerExpression,  unsigned totalNumberOfDocuments, const Schema *schema, Trie *trie);
     void parallelMerge();
@@ -370,8 +483,33 @@ public:
      */
     void appendInvertedListKeywordIdsForMerge(const vector<pair<unsigned, unsigned> >& invertedListKeywordIds);
 
+    /*
+     *   Saves the committed read view of the inverted index as a flat snapshot (see serialization/FlatSnapshot.h).
+     *   The inverted lists are split into segments of consecutive list ids, and each segment file stores
+     *   the blocks of its compressed read views back to back, addressed by an array of list headers.
+     *   Only a list without a compressed read view is stored uncompressed. Only the segments with lists
+     *   changed since the last save to the same file are written again.
+     */
+    void saveSnapshot(const string &fileName) const;
+    /*
+     *   Loads a flat snapshot written by saveSnapshot(). The segment files are mapped and the compressed read
+     *   view of each inverted list points directly into the mapping, so the lists are not copied nor
+     *   deserialized. The cowvector of a list is decoded when it is first needed, see
+     *   InvertedListContainer::getUncompressedList().
+     *   Throws std::runtime_error if the file is not a compatible snapshot.
+     */
+    void loadSnapshot(const string &fileName);
+    /*
+     *   Builds the compressed read views of the inverted lists loaded uncompressed, from a boost archive or
+     *   an older snapshot, and releases their cowvectors. Needs the forward index of the lists.
+     */
+    void compressLoadedInvertedLists();
+
 private:
 
+    // appends the inverted lists of one snapshot file to the write view
+    void loadInvertedLists(const FlatSnapshotReader &reader, vectorview<InvertedListContainerPtr>* &writeView);
+
     float getIdf(const unsigned totalNumberOfDocuments, const unsigned keywordId) const;
     float computeRecordStaticScore(RankerExpression *rankerExpression, const float recordBoost,
                        const float recordLength, const float idf,
@@ -388,6 +526,13 @@ private:
 
     ForwardIndex *forwardIndex; //Not serialised, must be assigned after every load and save.
 
+    // Set by loadSnapshot(). The read views of the inverted lists point into these mappings, so they
+    // are released only after the inverted lists are deleted.
+    vector<boost::shared_ptr<srch2::util::MappedFile> > snapshotMappings;
+
+    // inverted lists changed since the last saveSnapshot()
+    mutable FlatSnapshotSegments invertedListSegments;
+
     // Index Build time
     vector<unsigned> invertedListSizeDirectory;
 
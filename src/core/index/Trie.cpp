@@ -344,11 +344,19 @@ TrieRootNodeAndFreeList::TrieRootNodeAndFreeList()
 {
     bool create_root = true;
     this->root = new TrieNode(create_root);
+    this->version = getNewVersion();
 }
 
 TrieRootNodeAndFreeList::TrieRootNodeAndFreeList(const TrieNode *src)
 {
     this->root = new TrieNode(src);
+    this->version = getNewVersion();
+}
+
+unsigned long TrieRootNodeAndFreeList::getNewVersion()
+{
+    static unsigned long lastVersion = 0;
+    return __sync_add_and_fetch(&lastVersion, 1);
 }
 
 
@@ -362,6 +370,11 @@ TrieRootNodeAndFreeList::~TrieRootNodeAndFreeList()
     delete root;
 }
 
+void TrieRootNodeAndFreeList::freeze()
+{
+    this->frozenTrie.reset(new FrozenTrie(this->root));
+}
+
 TrieNodePath::TrieNodePath()
 {
     this->path = NULL;
@@ -737,6 +750,16 @@ unsigned Trie::addKeyword_ThreadSafe(const std::vector<CharType> &keyword,
     vector<CharType> cleanedString;
     cleanString(keyword, cleanedString); // remove bad characters
 
+    // A keyword that is already in the trie does not change it, so its path is not copied and the
+    // next read view keeps the trie nodes, and the version, of the current one. The feedback index
+    // changes the terminal node it gets back, so it always gets a copy.
+    if (terminalNode == NULL) {
+        TrieNode *existingNode = findTerminalNode_WriteView(cleanedString);
+        if (existingNode != NULL) {
+            invertedListOffset = existingNode->getInvertedListOffset();
+            return existingNode->getId();
+        }
+    }
 
     // it's a map from original nodes in the trie to the copy nodes in the pathTrace
     // The reason we need this map is related to reassign ID. Since we create a new cloned path each time we
@@ -820,6 +843,18 @@ unsigned Trie::addKeyword_ThreadSafe(const std::vector<CharType> &keyword,
     return node->getId();
 }
 
+TrieNode *Trie::findTerminalNode_WriteView(const std::vector<CharType> &keyword)
+{
+    TrieNode *node = this->getTrieRootNode_WriteView();
+    for (unsigned i = 0; i < keyword.size(); ++i) {
+        int childPosition = node->findChildNodePosition(keyword[i]);
+        if (childPosition < 0)
+            return NULL;
+        node = node->getChild(childPosition);
+    }
+    return node->isTerminalNode() ? node : NULL;
+}
+
 unsigned Trie::addKeyword_ThreadSafe(const std::string &keyword, unsigned &invertedListOffset)
 {
     bool isNewTrieNode = false;
@@ -895,7 +930,11 @@ int Trie::getNumberOfBytes() const
     boost::shared_ptr<TrieRootNodeAndFreeList > trieRootNode_ReadView;
     this->getTrieRootNode_ReadView(trieRootNode_ReadView);
     const TrieNode *root = trieRootNode_ReadView->root;
-    return root->getNumberOfBytes();
+    unsigned numberOfBytes = root->getNumberOfBytes();
+    // the frozen copy is kept in addition to the trie nodes
+    if (trieRootNode_ReadView->getFrozenTrie() != NULL)
+        numberOfBytes += trieRootNode_ReadView->getFrozenTrie()->getNumberOfBytes();
+    return numberOfBytes;
 }
 
 int Trie::getNumberOfNodes() const
@@ -1359,16 +1398,16 @@ void Trie::calculateNodeHistogramValuesFromChildren(TrieNode *node,
     	    forwardIndex->getForwardListDirectory_ReadView(forwardIndexDirectoryReadView);
     	    shared_ptr<vectorview<unsigned> > invertedIndexKeywordIdsReadView;
     	    invertedIndex->getInvertedIndexKeywordIds_ReadView(invertedIndexKeywordIdsReadView);
-			shared_ptr<vectorview<unsigned> > invertedListReadView;
-			invertedIndex->getInvertedListReadView(invertedListDirectoryReadView,
-					node->getInvertedListOffset(), invertedListReadView);
+			InvertedListCursor invertedList;
+			invertedIndex->getInvertedListCursor(invertedListDirectoryReadView,
+					node->getInvertedListOffset(), invertedList);
 
 			float termRecordStaticScore = 0;
 			vector<unsigned> matchedAttrsList;
 			// move on inverted list to find the first record which is valid
 			unsigned invertedListCursor = 0;
-			while(invertedListCursor < invertedListReadView->size()){
-				unsigned recordId = invertedListReadView->getElement(invertedListCursor++);
+			while(invertedListCursor < invertedList.size()){
+				unsigned recordId = invertedList.getElement(invertedListCursor++);
 				// check if the record is valid
 				// forwardIndexDirectoryReadView
 				unsigned keywordOffset = invertedIndex->getKeywordOffset(forwardIndexDirectoryReadView,
@@ -1392,7 +1431,7 @@ void Trie::calculateNodeHistogramValuesFromChildren(TrieNode *node,
 				ASSERT(termRecordStaticScore == 0);
 				node->initializeInternalNodeHistogramValues(HistogramAggregationTypeJointProbability, 0 , (half)0);
 			}else{
-				float pTerminalNode = (1.0 * invertedListReadView->size()) / totalNumberOfRecords ;
+				float pTerminalNode = (1.0 * invertedList.size()) / totalNumberOfRecords ;
 				node->initializeInternalNodeHistogramValues(HistogramAggregationTypeJointProbability, pTerminalNode , (half)termRecordStaticScore);
 			}
     	}
@@ -1536,6 +1575,12 @@ void Trie::merge(const InvertedIndex * invertedIndex ,
 	if(updateHistogram == true){
 		this->calculateNodeHistogramValuesFromChildren(invertedIndex , forwardIndex , totalNumberOfRecords);
 	}
+	this->publishWriteView(updateHistogram);
+    mergeRequired = false;
+}
+
+void Trie::publishWriteView(bool statisticsChanged)
+{
     // In each merge, we first put the current read view to the end of the queue,
     // and reset the current read view. Then we go through the read views one by one
     // in the order of their arrival. For each read view, we check its reference count.
@@ -1546,8 +1591,24 @@ void Trie::merge(const InvertedIndex * invertedIndex ,
     // We repeat the process until either we reach the end of the queue or we
     // find a read view with a reference count > 1.
     this->oldReadViewQueue.push(this->root_readview);
+    // The new read view is frozen before it is published, so readers never see it without its frozen trie.
+    TrieRootNodeAndFreeList *newReadView = new TrieRootNodeAndFreeList(this->root_writeview);
+    // The write view copies the path of every trie node it changes, from the root. If the children
+    // of its root are the ones of the read view, no node was added or removed.
+    const TrieNode *readViewRoot = this->root_readview->root;
+    bool sameChildren = readViewRoot->getChildrenCount() == this->root_writeview->getChildrenCount();
+    for (unsigned i = 0; sameChildren && i < readViewRoot->getChildrenCount(); ++i)
+        sameChildren = readViewRoot->getChild(i) == this->root_writeview->getChild(i);
+    if (sameChildren)
+        newReadView->version = this->root_readview->version;
+    // The frozen trie copies the ids and histogram values of the nodes, so it can be shared only if
+    // they were not updated in place either.
+    if (sameChildren && !statisticsChanged && this->root_readview->getFrozenTrie() != NULL)
+        newReadView->shareFrozenTrie(*this->root_readview);
+    else
+        newReadView->freeze();
     pthread_spin_lock(&m_spinlock);
-    this->root_readview.reset(new TrieRootNodeAndFreeList(this->root_writeview));
+    this->root_readview.reset(newReadView);
     // We can safely release the lock now, since the only chance the read view can be modified is during merge().
     // But merge() can only happen when another writer comes in, and we assume at any time only one writer can come in.
     // So this case cannot happen.
@@ -1560,7 +1621,12 @@ void Trie::merge(const InvertedIndex * invertedIndex ,
     }
 
     this->root_writeview = new TrieNode(this->root_readview.get()->root);
-    mergeRequired = false;
+}
+
+void Trie::retireWithReadView(const boost::shared_ptr<const void> &object)
+{
+    // Only the writer changes the free lists of the read view, so no lock is needed.
+    this->root_readview->retiredObjects.push_back(object);
 }
 
 void Trie::commit()
@@ -1571,6 +1637,7 @@ void Trie::commit()
     // We change the isCopy of the nodes in the write view.
     this->root_writeview->resetCopyFlag();
     this->root_readview->root = root_writeview;
+    this->root_readview->version = TrieRootNodeAndFreeList::getNewVersion();
     // We create a new write view's root by copying the root of the read review
     this->root_writeview = new TrieNode(this->root_readview->root);
     /**
@@ -1596,6 +1663,8 @@ void Trie::finalCommit_finalizeHistogramInformation(const InvertedIndex * invert
 		const unsigned totalNumberOfResults ){
 	// traverse the trie in preorder to calculate nodeSubTrieValue
 	calculateNodeHistogramValuesFromChildren(invertedIndex , forwardIndex , totalNumberOfResults);
+	// The read view is complete now (ids and histogram values are final), so we can freeze it.
+	this->root_readview->freeze();
 	// now set the commit flag to true to indicate commit is finished
     this->commited = true;
 }
@@ -1618,14 +1687,17 @@ void Trie::removeDeletedNodes()
 
     TrieNode *writeViewRoot = this->getTrieRootNode_WriteView();
     ASSERT(writeViewRoot);
-    if (removeDeletedNodes(writeViewRoot)) {
+    // Readers keep using the current read view while the nodes are removed, so the nodes
+    // are removed from copies and the new trie is published the same way as in merge().
+    if (removeDeletedNodes(writeViewRoot, this->root_readview.get())) {
     	// The whole trie becomes empty. Reinit RV and WV of trie.
     	// Note: we should not do the same steps as the constructor, 
 	// because we do not want to reset the
     	// all whole trie object. Just few member variables as listed below.
     	delete writeViewRoot;
-        this->root_readview.reset( new TrieRootNodeAndFreeList() );
-        this->root_writeview = new TrieNode(this->root_readview.get()->root);
+        bool createRoot = true;
+        this->root_writeview = new TrieNode(createRoot);
+        this->publishWriteView();
         this->numberOfTerminalNodes = 0;
         this->mergeRequired = false;
         this->counterForReassignedKeywordIds = MAX_ALLOCATED_KEYWORD_ID + 1;
@@ -1634,18 +1706,14 @@ void Trie::removeDeletedNodes()
         // Similar to the operations in trie.merge(), we need to "merge"
         // the read view and write view
         writeViewRoot->resetCopyFlag();
-        this->root_readview.reset(new TrieRootNodeAndFreeList(writeViewRoot));
-        if(writeViewRoot) {
-            delete writeViewRoot;
-        }
-        this->root_writeview = new TrieNode(this->root_readview.get()->root);
+        this->publishWriteView();
     }
     // remove these empty leaf nodes
     emptyLeafNodeIds.clear();
 }
 
 // return TRUE if the subtrie of t becomes empty, and FALSE otherwise
-bool Trie::removeDeletedNodes(TrieNode *trieNode)
+bool Trie::removeDeletedNodes(TrieNode *trieNode, TrieRootNodeAndFreeList *readView)
 {
   if (trieNode == NULL)
     return true;
@@ -1690,12 +1758,22 @@ bool Trie::removeDeletedNodes(TrieNode *trieNode)
 
         // check if there is an empty leaf node id in the range [minId, maxId]
         bool found = this->findEmptyLeafNodeIds(minId, maxId);
-        if (found && removeDeletedNodes(trieNode->getChild(childCursor))) {
-           // this subtrie is empty. Then delete this child, and
-           // set the child to NULL
-           delete trieNode->getChild(childCursor);
-           trieNode->setChild(childCursor, NULL);
-           numberOfNulledChildren ++;
+        if (found) {
+           // this subtrie changes, so the child is copied unless it is already a copy
+           TrieNode *child = trieNode->getChild(childCursor);
+           if (!child->isCopy) {
+               TrieNode *childCopy = new TrieNode(child, true);
+               trieNode->setChild(childCursor, childCopy);
+               readView->free_list.push_back(child);
+               child = childCopy;
+           }
+           if (removeDeletedNodes(child, readView)) {
+               // this subtrie is empty. Then delete this child, and
+               // set the child to NULL
+               delete child;
+               trieNode->setChild(childCursor, NULL);
+               numberOfNulledChildren ++;
+           }
         }
        childCursor ++;
     }
@@ -57,6 +57,7 @@
 #include "util/encoding.h"
 #include "util/half.h"
 #include "instantsearch/Constants.h"
+#include "index/FrozenTrie.h"
 
 using std::endl;
 using std::set;
@@ -462,7 +463,17 @@ class TrieRootNodeAndFreeList
 {
 public:
     vector<const TrieNode* > free_list;
+    // Objects of the other index structures that the writer unlinked while this was the read view
+    // (see Trie::retireWithReadView()). They are released together with the free_list.
+    vector<boost::shared_ptr<const void> > retiredObjects;
     TrieNode *root;
+    // A frozen copy of the trie under root, built by freeze() once the read view no longer changes.
+    // NULL until then. It is shared with the previous read view if the trie nodes did not change.
+    boost::shared_ptr<const FrozenTrie> frozenTrie;
+    // Identifies the trie nodes under root. A read view published without adding or removing trie
+    // nodes keeps the version of the previous one, whose nodes it shares except for the root
+    // (see Trie::publishWriteView()). Versions are unique across tries.
+    unsigned long version;
 
     TrieRootNodeAndFreeList();
 
@@ -470,6 +481,30 @@ public:
 
     ~TrieRootNodeAndFreeList();
 
+    // (Re)builds frozenTrie from the trie under root.
+    void freeze();
+
+    // Shares the frozen trie of a read view with the same trie nodes and statistics.
+    void shareFrozenTrie(const TrieRootNodeAndFreeList &readView) {
+        this->frozenTrie = readView.frozenTrie;
+    }
+
+    const FrozenTrie *getFrozenTrie() const {
+        return this->frozenTrie.get();
+    }
+
+    // The trie node of a node of the frozen trie. The root of a shared frozen trie is the root of
+    // the read view it was built from, so it is replaced by the root of this read view.
+    const TrieNode *getFrozenTrieNode(unsigned nodeIndex) const {
+        return nodeIndex == FrozenTrie::ROOT_INDEX ? this->root : this->frozenTrie->getTrieNode(nodeIndex);
+    }
+
+    unsigned long getVersion() const {
+        return this->version;
+    }
+
+    static unsigned long getNewVersion();
+
 private:
     friend class boost::serialization::access;
 
@@ -586,6 +621,7 @@ private:
         // We do NOT need to read the "oldIdToNewIdMapVector" from the disk since it's only used before the commit and is no longer needed.
         commited = true;
         ar >> root_readview;
+        this->root_readview->freeze();
         // free any old memory pointed by this->root_writeview to avoid memory leaks.
         if (this->root_writeview)
         	delete this->root_writeview;
@@ -602,8 +638,16 @@ private:
     		const ForwardIndex * forwardIndex ,
     		const unsigned totalNumberOfRecords );
 
-    // return TRUE if the subtrie of t becomes empty, and FALSE otherwise
-    bool removeDeletedNodes(TrieNode *trieNode);
+    // return TRUE if the subtrie of t becomes empty, and FALSE otherwise.
+    // The nodes of the read view are copied before they are changed, and put into its free list.
+    bool removeDeletedNodes(TrieNode *trieNode, TrieRootNodeAndFreeList *readView);
+
+    // Publishes the write view as the new read view, and frees the old read views without readers.
+    // statisticsChanged tells that the histogram values of the read view nodes were updated in place.
+    void publishWriteView(bool statisticsChanged = false);
+
+    // the trie node of keyword in the write view if it is already a terminal node, or NULL
+    TrieNode *findTerminalNode_WriteView(const std::vector<CharType> &keyword);
 
 public:
 
@@ -766,6 +810,12 @@ public:
     		const unsigned totalNumberOfResults  , bool updateHistogram);
     bool isMergeRequired() { return mergeRequired; }
 
+    // Keeps an object that the writer unlinked from another index structure alive until the readers
+    // of the current read view, and of all the older ones, are gone. Readers get the trie read view
+    // together with the read views of the other structures (IndexData::publishReadState()), so this defers
+    // freeing the object past every reader that may still reach it, without blocking readers.
+    void retireWithReadView(const boost::shared_ptr<const void> &object);
+
     void commit();
 
     /*
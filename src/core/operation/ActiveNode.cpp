@@ -33,11 +33,27 @@ namespace srch2
 namespace instantsearch
 {
 
+namespace
+{
+// Sets with up to this many pivotal active nodes are scanned instead of indexed
+const unsigned PAN_LINEAR_SCAN_LIMIT = 8;
+const unsigned PAN_INITIAL_INDEX_BITS = 5;
+// Above this threshold the incremental computation can miss a pivotal active node that the frozen
+// trie finds, so the frozen trie is not used to keep the results of both paths the same
+const unsigned MAXIMUM_FROZEN_EDIT_DISTANCE_THRESHOLD = 2;
+
+// Fibonacci hashing of the address of a trie node into a slot of an index of 2^bits slots
+inline unsigned hashTrieNode(const TrieNode *trieNode, unsigned bits)
+{
+    return (unsigned) ((((uint64_t) (size_t) trieNode) * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+}
+
 void PrefixActiveNodeSet::getComputedSimilarPrefixes(const Trie *trie, std::vector<std::string> &similarPrefixes)
 {
-    for (std::map<const TrieNode*, PivotalActiveNode >::iterator mapIterator = PANMap.begin();
-            mapIterator != PANMap.end(); mapIterator ++) {
-        const TrieNode *trieNode = mapIterator->first;
+    for (std::vector<PANEntry>::const_iterator panIterator = PANs.begin();
+            panIterator != PANs.end(); panIterator ++) {
+        const TrieNode *trieNode = panIterator->first;
         std::string prefix;
         trie->getPrefixString_NotThreadSafe(trieNode, prefix);
         similarPrefixes.push_back(prefix);
@@ -53,10 +69,10 @@ boost::shared_ptr<PrefixActiveNodeSet> PrefixActiveNodeSet::computeActiveNodeSet
     PrefixActiveNodeSet *newActiveNodeSet = new PrefixActiveNodeSet(newString, this->getEditDistanceThreshold(), this->trieRootNodeSharedPtr, this->supportSwapInEditDistance);
 
     // PAN:
-    for (std::map<const TrieNode*, PivotalActiveNode >::const_iterator mapIterator = PANMap.begin();
-            mapIterator != PANMap.end(); mapIterator ++) {
+    for (std::vector<PANEntry>::const_iterator panIterator = PANs.begin();
+            panIterator != PANs.end(); panIterator ++) {
         // Compute the new active nodes for this trie node
-        _addPANSetForOneNode(mapIterator->first, mapIterator->second, additionalChar, newActiveNodeSet);
+        _addPANSetForOneNode(panIterator->first, panIterator->second, additionalChar, newActiveNodeSet);
     }
 
     boost::shared_ptr<PrefixActiveNodeSet> newActiveNodeSetSharedPtr;
@@ -64,15 +80,64 @@ boost::shared_ptr<PrefixActiveNodeSet> PrefixActiveNodeSet::computeActiveNodeSet
     return newActiveNodeSetSharedPtr;
 }
 
+boost::shared_ptr<PrefixActiveNodeSet> PrefixActiveNodeSet::computeActiveNodeSetFromFrozenTrie(std::vector<CharType> &prefix,
+        const unsigned editDistanceThreshold, const TrieRootNodeSharedPtr &trieRootNodeSharedPtr,
+        bool supportSwapInEditDistance)
+{
+    boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet;
+    const FrozenTrie *frozenTrie = trieRootNodeSharedPtr->getFrozenTrie();
+    if (frozenTrie == NULL || editDistanceThreshold > MAXIMUM_FROZEN_EDIT_DISTANCE_THRESHOLD)
+        return activeNodeSet;
+
+    std::vector<FrozenActiveNode> frozenActiveNodes;
+    frozenTrie->computeActiveNodes(prefix, editDistanceThreshold, supportSwapInEditDistance, frozenActiveNodes);
+
+    activeNodeSet.reset(new PrefixActiveNodeSet(prefix, editDistanceThreshold,
+            const_cast<TrieRootNodeSharedPtr &>(trieRootNodeSharedPtr), supportSwapInEditDistance));
+    activeNodeSet->PANs.reserve(frozenActiveNodes.size());
+    for (unsigned i = 0; i < frozenActiveNodes.size(); ++i) {
+        // the nodes are distinct, and a PAN's transformation distance is its edit distance of prefix
+        // plus the characters of the prefix deleted after it
+        PivotalActiveNode pan;
+        pan.transformationdistance = frozenActiveNodes[i].editDistance;
+        pan.differ = frozenActiveNodes[i].editDistance - frozenActiveNodes[i].prefixEditDistance;
+        pan.editdistanceofPrefix = frozenActiveNodes[i].prefixEditDistance;
+        activeNodeSet->PANs.push_back(std::make_pair(trieRootNodeSharedPtr->getFrozenTrieNode(frozenActiveNodes[i].nodeIndex), pan));
+    }
+    if (activeNodeSet->PANs.size() > PAN_LINEAR_SCAN_LIMIT)
+        activeNodeSet->_buildPANIndex(PAN_INITIAL_INDEX_BITS);
+    return activeNodeSet;
+}
+
+boost::shared_ptr<PrefixActiveNodeSet> PrefixActiveNodeSet::copyForReadView(const TrieRootNodeSharedPtr &readView) const
+{
+    ASSERT(readView->getVersion() == this->trieRootNodeSharedPtr->getVersion());
+    const TrieNode *oldRoot = this->trieRootNodeSharedPtr->root;
+    boost::shared_ptr<PrefixActiveNodeSet> copy(new PrefixActiveNodeSet(*this));
+    copy->trieRootNodeSharedPtr = readView;
+    for (unsigned i = 0; i < copy->PANs.size(); ++i) {
+        if (copy->PANs[i].first == oldRoot) {
+            copy->PANs[i].first = readView->root;
+            if (!copy->PANIndex.empty())
+                copy->_buildPANIndex(copy->PANIndexBits);
+            break;
+        }
+    }
+    // the trie node sets are recomputed from the mapped PANs
+    copy->trieNodeSetVectorComputed = false;
+    copy->prepareForIteration();
+    return copy;
+}
+
 void PrefixActiveNodeSet::printActiveNodes(const Trie* trie) const// Deprecated due to removal of TrieNode->getParent() pointers.
 {
     typedef const TrieNode* trieNodeStar;
-    std::map<trieNodeStar,PivotalActiveNode>::const_iterator mapIterater;
-    for ( mapIterater  = this->PANMap.begin(); mapIterater != this->PANMap.end(); mapIterater++ ) {
-        trieNodeStar trieNode = mapIterater->first;
+    std::vector<PANEntry>::const_iterator panIterator;
+    for ( panIterator  = this->PANs.begin(); panIterator != this->PANs.end(); panIterator++ ) {
+        trieNodeStar trieNode = panIterator->first;
         string prefix;
         trie->getPrefixString(this->trieRootNodeSharedPtr->root, trieNode, prefix);
-        Logger::debug("%s : %d" , prefix.c_str(),mapIterater->second.transformationdistance );
+        Logger::debug("%s : %d" , prefix.c_str(),panIterator->second.transformationdistance );
     }
 }
 
@@ -100,24 +165,69 @@ void PrefixActiveNodeSet::_addPAN(const TrieNode *trieNode, PivotalActiveNode pa
     if (pan.transformationdistance > this->editDistanceThreshold) // do nothing if the new distance is above the threshold
         return;
     //PAN:
-    std::map<const TrieNode*, PivotalActiveNode >::iterator mapIterator = PANMap.find(trieNode);
-    if (mapIterator != PANMap.end()) { // found one
-        if (mapIterator->second.transformationdistance > pan.transformationdistance) // reassign the distance if it's smaller
-            mapIterator->second = pan;
-        else if (mapIterator->second.transformationdistance == pan.transformationdistance) {
-            if ((mapIterator->second.differ < pan.differ)||(mapIterator->second.editdistanceofPrefix > pan.editdistanceofPrefix))
-                mapIterator->second = pan;
+    int position = _findPAN(trieNode);
+    if (position >= 0) { // found one
+        PivotalActiveNode &existingPan = PANs[position].second;
+        if (existingPan.transformationdistance > pan.transformationdistance) // reassign the distance if it's smaller
+            existingPan = pan;
+        else if (existingPan.transformationdistance == pan.transformationdistance) {
+            if ((existingPan.differ < pan.differ)||(existingPan.editdistanceofPrefix > pan.editdistanceofPrefix))
+                existingPan = pan;
         }
         return; // otherwise, do nothing
     }
 
     // insert the new pair
-    PANMap.insert(std::pair<const TrieNode*, PivotalActiveNode >(trieNode, pan));
+    PANs.push_back(std::make_pair(trieNode, pan));
+    if (!PANIndex.empty()) {
+        // keep the index at most half full
+        if (PANs.size() * 2 > PANIndex.size()) {
+            _buildPANIndex(PANIndexBits + 1);
+        } else {
+            unsigned slot = hashTrieNode(trieNode, PANIndexBits);
+            while (PANIndex[slot] != 0)
+                slot = (slot + 1) & (PANIndex.size() - 1);
+            PANIndex[slot] = PANs.size();
+        }
+    } else if (PANs.size() > PAN_LINEAR_SCAN_LIMIT) {
+        _buildPANIndex(PAN_INITIAL_INDEX_BITS);
+    }
 
     // set the flag
     this->trieNodeSetVectorComputed = false;
 }
 
+int PrefixActiveNodeSet::_findPAN(const TrieNode *trieNode) const
+{
+    if (PANIndex.empty()) {
+        for (unsigned i = 0; i < PANs.size(); ++i) {
+            if (PANs[i].first == trieNode)
+                return i;
+        }
+        return -1;
+    }
+    for (unsigned slot = hashTrieNode(trieNode, PANIndexBits); PANIndex[slot] != 0;
+            slot = (slot + 1) & (PANIndex.size() - 1)) {
+        if (PANs[PANIndex[slot] - 1].first == trieNode)
+            return PANIndex[slot] - 1;
+    }
+    return -1;
+}
+
+void PrefixActiveNodeSet::_buildPANIndex(unsigned bits)
+{
+    while ((1u << bits) < PANs.size() * 2)
+        ++bits;
+    PANIndexBits = bits;
+    PANIndex.assign(1u << bits, 0);
+    for (unsigned i = 0; i < PANs.size(); ++i) {
+        unsigned slot = hashTrieNode(PANs[i].first, bits);
+        while (PANIndex[slot] != 0)
+            slot = (slot + 1) & (PANIndex.size() - 1);
+        PANIndex[slot] = i + 1;
+    }
+}
+
 void PrefixActiveNodeSet::addPANUpToDepth(const TrieNode *trieNode, PivotalActiveNode pan, const unsigned curDepth, const unsigned depthLimit, const CharType additionalChar, PrefixActiveNodeSet *newActiveNodeSet)
 {
     // add children
@@ -153,14 +263,20 @@ void PrefixActiveNodeSet::addPANUpToDepth(const TrieNode *trieNode, PivotalActiv
             if(supportSwapInEditDistance){
                 //swap operation: if there was a delete operation, and there are prefix string
                 if (pan.differ > 0 && this->prefix.size()) {
-                    // if the last character of prefix can be found in curent's child, it's swap operation, we will give it the same edit distance as its parent
+                    // if the last character of prefix can be found in curent's child, it's swap operation.
+                    // The swap costs one edit, and the other deleted characters pair up with the
+                    // curDepth characters inserted before the child.
                     int childPosition = child->findChildNodePosition(this->prefix.back());
                     if (childPosition >= 0) {
-                        child= child->getChild(childPosition);
-                        panlocal.transformationdistance = pan.editdistanceofPrefix + max;
+                        // the recursion below still starts from the child, not from this grandchild
+                        const TrieNode *grandchild = child->getChild(childPosition);
+                        int swapMax = curDepth;
+                        if (swapMax < pan.differ - 1)
+                            swapMax = pan.differ - 1;
+                        panlocal.transformationdistance = pan.editdistanceofPrefix + swapMax + 1;
                         panlocal.differ = 0;
-                        panlocal.editdistanceofPrefix = pan.editdistanceofPrefix + max;
-                        newActiveNodeSet->_addPAN(child, panlocal);
+                        panlocal.editdistanceofPrefix = pan.editdistanceofPrefix + swapMax + 1;
+                        newActiveNodeSet->_addPAN(grandchild, panlocal);
                     }
                 }
             }
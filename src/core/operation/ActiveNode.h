@@ -84,8 +84,13 @@ private:
     TrieRootNodeSharedPtr trieRootNodeSharedPtr;
     bool supportSwapInEditDistance;
 
-    //PAN: A map from trie node to its pivotal active nodes
-    std::map<const TrieNode*, PivotalActiveNode > PANMap;
+    //PAN: the pivotal active nodes in the order they were added
+    typedef std::pair<const TrieNode*, PivotalActiveNode> PANEntry;
+    std::vector<PANEntry> PANs;
+    // An open-addressing index of PANs by trie node, with linear probing. A slot holds the position
+    // of its entry in PANs plus one, or 0 if it is empty. Small sets are scanned and have no index.
+    std::vector<unsigned> PANIndex;
+    unsigned PANIndexBits;
 
     // group the trie nodes based on their edit distance to the prefix.
     // used only when it's called by an iterator
@@ -98,6 +103,10 @@ public:
         this->prefix = prefix;
         this->editDistanceThreshold = editDistanceThreshold;
 
+        this->PANs.clear();
+        this->PANIndex.clear();
+        this->PANIndexBits = 0;
+
         this->trieNodeSetVector.clear();
         this->trieNodeSetVectorComputed = false;
 
@@ -156,6 +165,26 @@ public:
 
     boost::shared_ptr<PrefixActiveNodeSet> computeActiveNodeSetIncrementally(const CharType additionalChar);
 
+    /*
+     * Computes the active nodes of a prefix in one pass over the frozen trie of the read view (see
+     * FrozenTrie::computeActiveNodes()) instead of one character at a time. Returns an empty pointer
+     * if the read view has no frozen trie or if the threshold is above 2.
+     */
+    static boost::shared_ptr<PrefixActiveNodeSet> computeActiveNodeSetFromFrozenTrie(std::vector<CharType> &prefix,
+            const unsigned editDistanceThreshold, const TrieRootNodeSharedPtr &trieRootNodeSharedPtr,
+            bool supportSwapInEditDistance);
+
+    /*
+     * With swaps and threshold 2, a node can be pivotal both through a swap and through a cheaper
+     * edit. The incremental computation keeps one of them per node and then misses the nodes that
+     * only the other one leads to (e.g. "naan" for "ana", an insertion and a swap), which the frozen
+     * trie finds. Such sets are computed from the frozen trie unless the whole prefix is cached, so
+     * that a query gets the same active nodes whatever the cache holds.
+     */
+    static bool incrementalComputationCanMissActiveNodes(unsigned editDistanceThreshold, bool supportSwapInEditDistance) {
+        return supportSwapInEditDistance && editDistanceThreshold == 2;
+    }
+
     unsigned getEditDistanceThreshold() const {
         return editDistanceThreshold;
     }
@@ -173,6 +202,17 @@ public:
     	return this->trieRootNodeSharedPtr.get() == rightTrieRootNodeSharedPtr.get();
     }
 
+    const TrieRootNodeSharedPtr &getTrieRootNodeSharedPtr() const {
+        return this->trieRootNodeSharedPtr;
+    }
+
+    /*
+     * A copy of this set for a read view with the same version as the one it was computed on (see
+     * TrieRootNodeAndFreeList::version). Such read views share their trie nodes except for the
+     * root, so the copy only maps the root. The copy is ready for iteration.
+     */
+    boost::shared_ptr<PrefixActiveNodeSet> copyForReadView(const TrieRootNodeSharedPtr &readView) const;
+
     unsigned getNumberOfBytes() const {
 
     	unsigned totalNumberOfBytes = 0;
@@ -190,9 +230,8 @@ public:
         	// so we shouldn't actually consider their cost (no need to loop over trie node vector)
         }
 
-        // PANMap
-        // we assume the overhead of map is 32 bytes for each entry
-        totalNumberOfBytes += PANMap.size() * (sizeof(TrieNode*) + sizeof(PivotalActiveNode) + 32);
+        // PANs and their index
+        totalNumberOfBytes += PANs.capacity() * sizeof(PANEntry) + PANIndex.capacity() * sizeof(unsigned);
 
        	// TrieRootNodeSharedPtr
        	// we assume that memory overhead of shared_ptr is 24 bytes.
@@ -204,7 +243,7 @@ public:
     }
 
     unsigned getNumberOfActiveNodes() {
-        return (unsigned) PANMap.size();
+        return (unsigned) PANs.size();
     }
 
     std::vector<CharType> *getPrefix() {
@@ -241,9 +280,9 @@ public:
     }
 
     unsigned getEditdistanceofPrefix(const TrieNode *&trieNode) {
-        std::map<const TrieNode*, PivotalActiveNode >::iterator iter = PANMap.find(trieNode);
-        ASSERT(iter != PANMap.end());
-        return iter->second.editdistanceofPrefix;
+        int position = _findPAN(trieNode);
+        ASSERT(position >= 0);
+        return PANs[position].second.editdistanceofPrefix;
     }
 
     void printActiveNodes(const Trie* trie) const;// Deprecated due to removal of TrieNode->getParent() pointers.
@@ -269,6 +308,12 @@ private:
     /// then ignore this request.
     void _addPAN(const TrieNode *trieNode, PivotalActiveNode pan);
 
+    // the position of the pivotal active node of trieNode in PANs, or -1
+    int _findPAN(const TrieNode *trieNode) const;
+
+    // (re)builds PANIndex with 2^bits slots
+    void _buildPANIndex(unsigned bits);
+
 
     //PAN:
 
@@ -285,11 +330,10 @@ private:
         for (unsigned i = 0; i <= editDistanceThreshold; i++)
             this->trieNodeSetVector[i].clear();
 
-        // go over the map to populate the vectors.
-
-        for (std::map<const TrieNode*, PivotalActiveNode >::iterator mapIterator = PANMap.begin();
-                mapIterator != PANMap.end(); mapIterator ++) {
-            this->trieNodeSetVector[mapIterator->second.transformationdistance].push_back(mapIterator->first);
+        // go over the pivotal active nodes to populate the vectors.
+        for (std::vector<PANEntry>::const_iterator panIterator = PANs.begin();
+                panIterator != PANs.end(); panIterator ++) {
+            this->trieNodeSetVector[panIterator->second.transformationdistance].push_back(panIterator->first);
         }
 
         // set the flag
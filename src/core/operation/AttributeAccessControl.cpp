@@ -449,6 +449,8 @@ bool  AttributeAccessControl::processAclRequest( vector<string>& fieldTokens,
 void AttributeAccessControl::replaceFromAcl(vector<string>& roleValueTokens, vector<unsigned>& searchableAttrIdsList,
 		vector<unsigned>& refiningAttrIdsList) {
 	AclWriteLock lock(attrAclLock);  // X-lock
+	modifiedSinceLastSave = true;
+	++aclVersion;
 	// replace operation consists of two steps.
 	// 1. delete attribute from all roldIds present in the map but are not in the input roleIds
 	// 2. append attributes for the input roleIds
@@ -514,6 +516,8 @@ void AttributeAccessControl::replaceFromAcl(vector<string>& roleValueTokens, vec
 void AttributeAccessControl::appendToAcl(const string& aclRoleValue, const vector<unsigned>& searchableAttrIdsList,
 		const vector<unsigned>& refiningAttrIdsList) {
 	AclWriteLock lock(attrAclLock); // X-lock
+	modifiedSinceLastSave = true;
+	++aclVersion;
 	AclMapIter iter = attributeAclMap.find(aclRoleValue);
 	if (iter != attributeAclMap.end()) {
 		// if role-id is found then merge the existing attributes list with the new attributes
@@ -567,6 +571,8 @@ void AttributeAccessControl::appendToAcl(const string& aclRoleValue, const vecto
 void AttributeAccessControl::deleteFromAcl(const string& aclRoleValue, const vector<unsigned>& searchableAttrIdsList,
 		const vector<unsigned>& refiningAttrIdsList) {
 	AclWriteLock lock(attrAclLock); // X-lock
+	modifiedSinceLastSave = true;
+	++aclVersion;
 	AclMapIter iter = attributeAclMap.find(aclRoleValue);
 	if (iter != attributeAclMap.end()) {
 		// if role-id is found then copy the difference of existing attributes list and to be
@@ -595,6 +601,21 @@ void AttributeAccessControl::deleteFromAcl(const string& aclRoleValue, const vec
 	}
 }
 
+bool AttributeAccessControl::isModifiedSinceLastSave() const {
+	AclReadLock lock(attrAclLock); // S-lock
+	return modifiedSinceLastSave;
+}
+
+unsigned AttributeAccessControl::getVersion() const {
+	AclReadLock lock(attrAclLock); // S-lock
+	return aclVersion;
+}
+
+void AttributeAccessControl::markSaved() {
+	AclWriteLock lock(attrAclLock); // X-lock
+	modifiedSinceLastSave = false;
+}
+
 /*
  *  This API fetches accessible searchable attributes for a given acl role-id.
  */
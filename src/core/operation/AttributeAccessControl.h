@@ -76,6 +76,8 @@ class AttributeAccessControl {
 public:
 	AttributeAccessControl(const SchemaInternal *schema) {
 		this->schema = schema;
+		this->modifiedSinceLastSave = false;
+		this->aclVersion = 0;
 	}
 	// ----------------------------
 	// read operations
@@ -115,6 +117,15 @@ public:
 	virtual ~AttributeAccessControl() {
 	}
 
+	// True if any write operation changed the acl since the last call to markSaved().
+	// Used by the indexer to persist acl-only changes on save.
+	bool isModifiedSinceLastSave() const;
+	void markSaved();
+
+	// Incremented by every write operation. Used to invalidate what was computed with an older acl,
+	// e.g., the cached query plans of the server.
+	unsigned getVersion() const;
+
 	void toString(stringstream& ss) const;
 
 	// Helper function to validate whether searchable field is accessible for given role-id
@@ -125,6 +136,8 @@ public:
 
 private:
 	mutable AttributeAclLock attrAclLock;
+	bool modifiedSinceLastSave;
+	unsigned aclVersion;
 	// This is the data structure which stores the mapping from acl-role to
 	// attributes accessible by this role. Attributes are stored as pair of searchable
 	// and refining attribute lists.
@@ -31,13 +31,16 @@
 #include <instantsearch/GlobalCache.h>
 #include <instantsearch/Term.h>
 #include "util/BusyBit.h"
+#include "util/ShardedCounter.h"
 #include "operation/ActiveNode.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/unordered_map.hpp>
 #include <string>
 #include <map>
+#include <vector>
 
 using namespace std;
 
@@ -81,350 +84,335 @@ private:
 	unsigned numberOfBytes ;
 };
 
+/*
+ * Counters of one cache. hits and misses are counted by get(), contentions is the number of
+ * times a thread found the lock of a shard taken and had to wait for it, evictions is the number
+ * of entries removed to make room for new ones.
+ */
+struct CacheStatistics{
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long contentions;
+	unsigned long evictions;
+	unsigned long numberOfEntries;
+	unsigned long numberOfBytesUsed;
+	unsigned long byteBudget;
+
+	CacheStatistics(){
+		hits = misses = contentions = evictions = 0;
+		numberOfEntries = numberOfBytesUsed = byteBudget = 0;
+	}
+};
+
 /*
  * this class is the main implementation of cache which contains the cache entries and
  * get/set behaviors.
+ *
+ * Entries are spread over shards by the hash of their key and each shard has its own lock,
+ * hash table and part of the byte budget, so that queries looking up different keys do not
+ * wait for each other. get() only takes the shard lock in shared mode: instead of moving the
+ * entry in an LRU list it sets the reference bit of the entry, and put() evicts with the CLOCK
+ * policy, which gives a second chance to entries referenced since the hand last passed them.
+ * Small caches (e.g. in tests) have a single shard so that an entry can use the whole budget.
  */
 template <class T>
 class CacheContainer{
 
-	struct HashedKeyLinkListElement{
-		HashedKeyLinkListElement * next;
-		HashedKeyLinkListElement * previous;
+	struct Slot{
+		// NULL if the slot is free
+		CacheEntry<T> * entry;
 		unsigned hashedKey;
-		HashedKeyLinkListElement(unsigned hashedKey){
-			this->hashedKey = hashedKey;
-			this->next = NULL;
-			this->previous = NULL;
+		unsigned numberOfBytes;
+		// set by get() under the shared lock, cleared by the clock hand
+		unsigned referenced;
+		Slot(){
+			this->entry = NULL;
+			this->hashedKey = 0;
+			this->numberOfBytes = 0;
+			this->referenced = 0;
+		}
+	};
+
+	struct Shard{
+		boost::shared_mutex access;
+		// hashed key => offset of its slot
+		boost::unordered_map<unsigned, unsigned> slotOffsets;
+		vector<Slot> slots;
+		vector<unsigned> freeSlotOffsets;
+		unsigned clockHand;
+		unsigned long byteBudget;
+		unsigned long totalSizeUsed;
+		// incremented under the exclusive lock
+		unsigned long evictions;
+		Shard(unsigned long byteBudget){
+			this->clockHand = 0;
+			this->byteBudget = byteBudget;
+			this->totalSizeUsed = 0;
+			this->evictions = 0;
 		}
 	};
 
 public:
 	CacheContainer(unsigned long byteSizeOfCache = 134217728)
 	: cacheTotalByteBudget(byteSizeOfCache){
-		totalSizeUsed = 0;
-		elementsLinkListFirst = elementsLinkListLast = NULL;
+		// every shard should be able to hold large entries like the results of a query
+		unsigned numberOfShards = 1;
+		while(numberOfShards < maximumNumberOfShards &&
+				byteSizeOfCache / (numberOfShards * 2) >= minimumShardByteBudget){
+			numberOfShards *= 2;
+		}
+		for(unsigned i = 0 ; i < numberOfShards ; ++i){
+			shards.push_back(new Shard(byteSizeOfCache / numberOfShards));
+		}
 	}
 	~CacheContainer(){
-		boost::unique_lock< boost::shared_mutex > lock(_access);
-		HashedKeyLinkListElement * nextToDelete = elementsLinkListFirst;
-		while(nextToDelete != NULL){
-			HashedKeyLinkListElement * nextOfNextToDelete = nextToDelete->next;
-			delete nextToDelete;
-			nextToDelete = nextOfNextToDelete;
+		clear();
+		for(unsigned i = 0 ; i < shards.size() ; ++i){
+			delete shards[i];
 		}
-		for(typename map<unsigned , pair< CacheEntry<T> * , HashedKeyLinkListElement * > >::iterator cacheEntry = cacheEntries.begin();
-				cacheEntry != cacheEntries.end() ; ++cacheEntry){
-			delete cacheEntry->second.first ;
-		}
-		cacheEntries.clear();
-		lock.unlock();
+		shards.clear();
 	};
 
 	bool put(string & key, boost::shared_ptr<T> & objectPointer){
+		unsigned newEntryHashedKey = hashDJB2(key.c_str());
+		Shard * shard = getShard(newEntryHashedKey);
 
-		boost::unique_lock< boost::shared_mutex > lock(_access);
-
-//		ASSERT(checkCacheConsistency());
 		CacheEntry<T> * newEntry = new CacheEntry<T>(key , objectPointer);
 		unsigned numberOfBytesNeededForNewEntry = getNumberOfBytesUsedByEntry(newEntry);
-		if(numberOfBytesNeededForNewEntry > cacheTotalByteBudget){
+		if(numberOfBytesNeededForNewEntry > shard->byteBudget){
 			// we cannot accept this entry, it's bigger than our budget
 			// Cache is isolated from other modules. No one can "assume" something is in cache and must
 			// always call get() to be able to use it. So not inserting it in cache and returning false is
 			// safe.
 			delete newEntry;
-			lock.unlock();
-//			ASSERT(checkCacheConsistency());
 			return false;
 		}
-		if(numberOfBytesNeededForNewEntry > cacheTotalByteBudget - totalSizeUsed){ // size is bigger than our left budget, we should remove some entries
-			// keep removing entries until enough space is left
-			while(true){
-				LRUCacheReplacementPolicyKickoutOneEntry();
-				if(numberOfBytesNeededForNewEntry <= cacheTotalByteBudget - totalSizeUsed){
-					break;
-				}
-			}
+
+		lockExclusive(shard);
+		boost::unique_lock< boost::shared_mutex > lock(shard->access, boost::adopt_lock);
+
+		// 1. an entry with the same hashed key is replaced, remove it first
+		boost::unordered_map<unsigned, unsigned>::iterator oldSlotOffset = shard->slotOffsets.find(newEntryHashedKey);
+		if(oldSlotOffset != shard->slotOffsets.end()){
+			removeSlot(shard, oldSlotOffset->second);
+			shard->slotOffsets.erase(oldSlotOffset);
 		}
-		// now we can insert this new entry
-		// 1. first find the hashedKey
-		unsigned newEntryHashedKey = hashDJB2(key.c_str());
-		// 2. check to see if this hashKey is in the map
-		typename map<unsigned , pair< CacheEntry<T> * , HashedKeyLinkListElement * > >::iterator cacheEntryWithSameHashedKey = cacheEntries.find(newEntryHashedKey);
-		if(cacheEntryWithSameHashedKey != cacheEntries.end()){ // hashed key exists
-			// replace the old cache entry with the new one and update the size info
-			unsigned sizeOfEntryToRemove = getNumberOfBytesUsedByEntry(cacheEntryWithSameHashedKey->second.first);
-			// update the size
-			// it's important that we += first and then -= because it's unsigned
-			totalSizeUsed += numberOfBytesNeededForNewEntry;
-			ASSERT(totalSizeUsed >= sizeOfEntryToRemove);
-			totalSizeUsed -= sizeOfEntryToRemove;
-			ASSERT(totalSizeUsed <= cacheTotalByteBudget);
-			// This delete operation deletes the instance of CacheEntry. Since
-			// ts_shared_ptr<T> objectPointer is a member, it's destructor will be called
-			// and the counter of shared pointer is decremented by one.
-			delete cacheEntryWithSameHashedKey->second.first;
-			cacheEntryWithSameHashedKey->second.first = newEntry;
-			// move the linked list element to front to make it kicked out later
-			moveLinkedListElementToLast(cacheEntryWithSameHashedKey->second.second);
-			lock.unlock();
-//			ASSERT(checkCacheConsistency());
-			return true;
+		// 2. make room for the new entry
+		while(numberOfBytesNeededForNewEntry > shard->byteBudget - shard->totalSizeUsed){
+			clockKickoutOneEntry(shard);
+		}
+		// 3. put it in a free slot
+		unsigned slotOffset;
+		if(shard->freeSlotOffsets.empty()){
+			slotOffset = shard->slots.size();
+			shard->slots.push_back(Slot());
+		}else{
+			slotOffset = shard->freeSlotOffsets.back();
+			shard->freeSlotOffsets.pop_back();
 		}
-		// 3. if it's not in map push it to the map, append hashedKey to the linkedlist and update the size
-		addNewElementToLinkList(newEntryHashedKey );
-		cacheEntries[newEntryHashedKey] = std::make_pair(  newEntry, elementsLinkListLast );
-		totalSizeUsed += numberOfBytesNeededForNewEntry;
-		ASSERT(totalSizeUsed <= cacheTotalByteBudget);
-		lock.unlock();
-//		ASSERT(checkCacheConsistency());
+		Slot & slot = shard->slots[slotOffset];
+		slot.entry = newEntry;
+		slot.hashedKey = newEntryHashedKey;
+		slot.numberOfBytes = numberOfBytesNeededForNewEntry;
+		// a new entry must be used once before it gets a second chance
+		slot.referenced = 0;
+		shard->slotOffsets[newEntryHashedKey] = slotOffset;
+		shard->totalSizeUsed += numberOfBytesNeededForNewEntry;
+		ASSERT(shard->totalSizeUsed <= shard->byteBudget);
 		return true;
 	}
-	bool get(string & key, boost::shared_ptr<T> & objectPointer) {
 
-		boost::unique_lock< boost::shared_mutex > lock(_access);
-//		ASSERT(checkCacheConsistency());
+	bool get(string & key, boost::shared_ptr<T> & objectPointer) {
 		//1. compute the hashed key
 		unsigned hashedKeyToFind = hashDJB2(key.c_str());
-		typename map<unsigned , pair< CacheEntry<T> * , HashedKeyLinkListElement * > >::iterator cacheEntry = cacheEntries.find(hashedKeyToFind);
-		if(cacheEntry == cacheEntries.end()){ // hashed key doesn't exist
-			lock.unlock();
-//			ASSERT(checkCacheConsistency());
+		Shard * shard = getShard(hashedKeyToFind);
+
+		lockShared(shard);
+		boost::shared_lock< boost::shared_mutex > lock(shard->access, boost::adopt_lock);
+		boost::unordered_map<unsigned, unsigned>::const_iterator slotOffset = shard->slotOffsets.find(hashedKeyToFind);
+		if(slotOffset == shard->slotOffsets.end()){ // hashed key doesn't exist
+			this->misses.add();
 			return false;
 		}
-		if(cacheEntry->second.first->getKey().compare(key) != 0){
-			lock.unlock();
-//			ASSERT(checkCacheConsistency());
+		Slot & slot = shard->slots[slotOffset->second];
+		if(slot.entry->getKey().compare(key) != 0){
+			this->misses.add();
 			return false;
 		}
-		// cache hit , move the corresponding linked list element to the last position to make it
-		// get kicked out laster
-		moveLinkedListElementToLast(cacheEntry->second.second);
+		// cache hit, give the entry a second chance. The bit is only written if it is not set already
+		// so that frequent hits do not keep invalidating the cache line in other cores.
+		if(slot.referenced == 0){
+			__sync_bool_compare_and_swap(&slot.referenced, 0, 1);
+		}
 		// and return the object
-		objectPointer = cacheEntry->second.first->getObjectPointer();
-		lock.unlock();
-//		ASSERT(checkCacheConsistency());
+		objectPointer = slot.entry->getObjectPointer();
+		this->hits.add();
 		return true;
 	}
 
-
 	bool checkCacheConsistency() {
-		boost::shared_lock< boost::shared_mutex > lock(_access);
-		// 1 . check the consistency of linked list
-		if( elementsLinkListFirst == NULL && elementsLinkListLast == NULL ){
-			lock.unlock();
-			return true;
-		}else{
-			if(! (elementsLinkListFirst != NULL && elementsLinkListLast != NULL)){
-				lock.unlock();
-				return false;
-			}
-		}
-		// we know first and last are not null
-
-		if(elementsLinkListFirst->previous != NULL){
-			lock.unlock();
-			return false;
-		}
-		HashedKeyLinkListElement * nextToCheck = elementsLinkListFirst;
-		while(nextToCheck != NULL){
-			if(nextToCheck->previous == NULL){
-				if(nextToCheck != elementsLinkListFirst){
-					lock.unlock();
+		for(unsigned shardOffset = 0 ; shardOffset < shards.size() ; ++shardOffset){
+			Shard * shard = shards[shardOffset];
+			boost::shared_lock< boost::shared_mutex > lock(shard->access);
+			// 1. every hashed key points to a used slot with the same hashed key
+			for(boost::unordered_map<unsigned, unsigned>::const_iterator slotOffset = shard->slotOffsets.begin();
+					slotOffset != shard->slotOffsets.end() ; ++slotOffset){
+				if(slotOffset->second >= shard->slots.size()){
 					return false;
 				}
-			}else{
-				if(nextToCheck->previous->next != nextToCheck){
-					lock.unlock();
+				const Slot & slot = shard->slots[slotOffset->second];
+				if(slot.entry == NULL || slot.hashedKey != slotOffset->first ||
+						getShard(slot.hashedKey) != shard){
 					return false;
 				}
 			}
-			if(nextToCheck->next == NULL){
-				if(nextToCheck != elementsLinkListLast){
-					lock.unlock();
-					return false;
-				}
-			}else{
-				if(nextToCheck->next->previous != nextToCheck){
-					lock.unlock();
-					return false;
+			// 2. every slot is either used or free and the byte size adds up
+			unsigned long byteSize = 0;
+			unsigned numberOfUsedSlots = 0;
+			for(unsigned slotOffset = 0 ; slotOffset < shard->slots.size() ; ++slotOffset){
+				if(shard->slots[slotOffset].entry != NULL){
+					numberOfUsedSlots++;
+					byteSize += shard->slots[slotOffset].numberOfBytes;
 				}
 			}
-			HashedKeyLinkListElement * nextOfNextToCheck = nextToCheck->next;
-			nextToCheck = nextOfNextToCheck;
-		}
-		// 2. check the consistency of map and byte size
-		unsigned byteSize = 0;
-		for(typename map<unsigned , pair< CacheEntry<T> * , HashedKeyLinkListElement * > >::const_iterator cacheEntry = cacheEntries.begin();
-				cacheEntry != cacheEntries.end() ; ++cacheEntry){
-			bool nodeFound = false;
-			HashedKeyLinkListElement * nextToCheck = elementsLinkListFirst;
-			while(nextToCheck != NULL){
-				if(cacheEntry->first == nextToCheck->hashedKey){
-					if(nextToCheck != cacheEntry->second.second){
-						lock.unlock();
-						return false;
-					}
-					if(nodeFound){
-						lock.unlock();
-						return false;
-					}else{
-						nodeFound = true;
-					}
+			if(numberOfUsedSlots != shard->slotOffsets.size() ||
+					numberOfUsedSlots + shard->freeSlotOffsets.size() != shard->slots.size()){
+				return false;
+			}
+			for(unsigned i = 0 ; i < shard->freeSlotOffsets.size() ; ++i){
+				if(shard->slots[shard->freeSlotOffsets[i]].entry != NULL){
+					return false;
 				}
-				HashedKeyLinkListElement * nextOfNextToCheck = nextToCheck->next;
-				nextToCheck = nextOfNextToCheck;
 			}
-			if(nodeFound == false){
-				lock.unlock();
+			if(byteSize != shard->totalSizeUsed || byteSize > shard->byteBudget){
 				return false;
 			}
-			byteSize += getNumberOfBytesUsedByEntry(cacheEntry->second.first);
-		}
-		if(byteSize != totalSizeUsed){
-			lock.unlock();
-			return false;
 		}
-		lock.unlock();
 		return true;
-
 	}
 
 	bool clear(){
-		boost::unique_lock<boost::shared_mutex> lock(_access);
-
-		for(typename map<unsigned , pair< CacheEntry<T> * , HashedKeyLinkListElement * > >::iterator cacheEntry = cacheEntries.begin();
-				cacheEntry != cacheEntries.end() ; ++cacheEntry){
-			delete cacheEntry->second.first ;
-		}
-		cacheEntries.clear();
-		HashedKeyLinkListElement * nextToDelete = elementsLinkListFirst;
-		while(nextToDelete != NULL){
-			HashedKeyLinkListElement * nextOfNextToDelete = nextToDelete->next;
-			delete nextToDelete;
-			nextToDelete = nextOfNextToDelete;
+		for(unsigned shardOffset = 0 ; shardOffset < shards.size() ; ++shardOffset){
+			Shard * shard = shards[shardOffset];
+			lockExclusive(shard);
+			boost::unique_lock< boost::shared_mutex > lock(shard->access, boost::adopt_lock);
+			for(unsigned slotOffset = 0 ; slotOffset < shard->slots.size() ; ++slotOffset){
+				// This delete operation deletes the instance of CacheEntry. Since
+				// ts_shared_ptr<T> objectPointer is a member, it's destructor will be called
+				// and the counter of shared pointer is decremented by one.
+				delete shard->slots[slotOffset].entry;
+			}
+			shard->slots.clear();
+			shard->freeSlotOffsets.clear();
+			shard->slotOffsets.clear();
+			shard->clockHand = 0;
+			shard->totalSizeUsed = 0;
 		}
-		elementsLinkListFirst = elementsLinkListLast = NULL;
-		totalSizeUsed = 0;
-		lock.unlock();
 		return true;
 	}
-private:
-	mutable boost::shared_mutex _access;
 
-	map<unsigned , pair< CacheEntry<T> * , HashedKeyLinkListElement * > > cacheEntries;
+	// adds the counters and the sizes of all shards to statistics
+	void getStatistics(CacheStatistics & statistics) {
+		statistics.hits += this->hits.get();
+		statistics.misses += this->misses.get();
+		statistics.contentions += this->contentions.get();
+		for(unsigned shardOffset = 0 ; shardOffset < shards.size() ; ++shardOffset){
+			Shard * shard = shards[shardOffset];
+			boost::shared_lock< boost::shared_mutex > lock(shard->access);
+			statistics.evictions += shard->evictions;
+			statistics.numberOfEntries += shard->slotOffsets.size();
+			statistics.numberOfBytesUsed += shard->totalSizeUsed;
+			statistics.byteBudget += shard->byteBudget;
+		}
+	}
 
-	// LRU replacement policy always removes elements from the beginning
-	HashedKeyLinkListElement * elementsLinkListFirst;
-	// LRU replacement policy always requires adding new entries to the tail (after last)
-	HashedKeyLinkListElement * elementsLinkListLast;
+	unsigned getNumberOfShards() const {
+		return shards.size();
+	}
 
-	const unsigned long cacheTotalByteBudget;
-	unsigned totalSizeUsed;
+private:
+	static const unsigned maximumNumberOfShards = 16;
+	static const unsigned long minimumShardByteBudget = 1048576;
 
+	vector<Shard *> shards;
+	const unsigned long cacheTotalByteBudget;
+	// Sharded by thread rather than by cache shard: the hits on a popular key all go to the same
+	// cache shard and would otherwise write to the same cache line from every core.
+	srch2::util::ShardedCounter hits;
+	srch2::util::ShardedCounter misses;
+	srch2::util::ShardedCounter contentions;
+
+	Shard * getShard(unsigned hashedKey) const {
+		// the low bits of the hash of similar keys (like the prefixes of a keyword) are close, mix them first
+		unsigned mixedKey = hashedKey ^ (hashedKey >> 16);
+		mixedKey *= 0x45d9f3b;
+		mixedKey ^= mixedKey >> 16;
+		return shards[mixedKey & (shards.size() - 1)];
+	}
 
-	void LRUCacheReplacementPolicyKickoutOneEntry(){
-		// 1. get the oldest element to kick out, which is the first element on linked list
-		unsigned hashedKeyToRemove ;
-		if(removeTheOldestElementFromLinkList(hashedKeyToRemove) == false){
-			return; // cache is empty , these is nothing to remove
+	void lockExclusive(Shard * shard){
+		if(! shard->access.try_lock()){
+			this->contentions.add();
+			shard->access.lock();
 		}
-
-		// 2. remove the entry from the map and update the total byte size used
-		typename map<unsigned , pair< CacheEntry<T> * , HashedKeyLinkListElement * > >::iterator entryToRemove = cacheEntries.find(hashedKeyToRemove);
-		ASSERT(entryToRemove != cacheEntries.end());
-		unsigned numberOfUsedBytesToGetRidOf = getNumberOfBytesUsedByEntry(entryToRemove->second.first);
-		// This delete operation deletes the instance of CacheEntry. Since
-		// ts_shared_ptr<T> objectPointer is a member, it's destructor will be called
-		// and the counter of shared pointer is decremented by one.
-		delete entryToRemove->second.first;
-		cacheEntries.erase(entryToRemove); // remove it from map
-		ASSERT(totalSizeUsed >= numberOfUsedBytesToGetRidOf);
-		totalSizeUsed -= numberOfUsedBytesToGetRidOf;
 	}
 
-	// does not update the size
-	void addNewElementToLinkList(unsigned hashedKey){
-		ASSERT((elementsLinkListFirst == NULL && elementsLinkListLast == NULL) ||
-				(elementsLinkListFirst != NULL && elementsLinkListLast != NULL) );
-
-		if(elementsLinkListFirst == NULL && elementsLinkListLast == NULL){
-			elementsLinkListFirst = elementsLinkListLast = new HashedKeyLinkListElement(hashedKey);
-			return;
+	void lockShared(Shard * shard){
+		if(! shard->access.try_lock_shared()){
+			this->contentions.add();
+			shard->access.lock_shared();
 		}
-
-		ASSERT(elementsLinkListLast->next == NULL);
-
-		elementsLinkListLast->next = new HashedKeyLinkListElement(hashedKey);
-		elementsLinkListLast->next->previous = elementsLinkListLast;
-		elementsLinkListLast = elementsLinkListLast->next;
 	}
 
-	// does not update the size , just removes the first element of linked list
-	bool removeTheOldestElementFromLinkList(unsigned & removedHashedKey){
-		ASSERT((elementsLinkListFirst == NULL && elementsLinkListLast == NULL) ||
-				(elementsLinkListFirst != NULL && elementsLinkListLast != NULL) );
-		if(elementsLinkListFirst == NULL && elementsLinkListLast == NULL){
-			return false; // nothing in linked list to remove
-		}
-		if(elementsLinkListFirst == elementsLinkListLast){ // there is only one element
-			removedHashedKey = elementsLinkListFirst->hashedKey;
-			delete elementsLinkListFirst;
-			elementsLinkListFirst = elementsLinkListLast = NULL;
-			return true;
-		}
-		HashedKeyLinkListElement * newFirst = elementsLinkListFirst->next;
-		ASSERT(newFirst->previous == elementsLinkListFirst);
-		newFirst->previous = NULL;
-		removedHashedKey = elementsLinkListFirst->hashedKey;
-		delete elementsLinkListFirst;
-		elementsLinkListFirst = newFirst;
-		return true;
+	// deletes the entry of a slot and frees the slot, the hashed key must be erased by the caller
+	void removeSlot(Shard * shard, unsigned slotOffset){
+		Slot & slot = shard->slots[slotOffset];
+		ASSERT(slot.entry != NULL);
+		ASSERT(shard->totalSizeUsed >= slot.numberOfBytes);
+		shard->totalSizeUsed -= slot.numberOfBytes;
+		// This delete operation deletes the instance of CacheEntry. Since
+		// ts_shared_ptr<T> objectPointer is a member, it's destructor will be called
+		// and the counter of shared pointer is decremented by one.
+		delete slot.entry;
+		slot.entry = NULL;
+		slot.numberOfBytes = 0;
+		slot.referenced = 0;
+		shard->freeSlotOffsets.push_back(slotOffset);
 	}
 
-	void moveLinkedListElementToLast(HashedKeyLinkListElement * element){
-		ASSERT(element != NULL);
-		ASSERT(! (elementsLinkListFirst == NULL || elementsLinkListLast == NULL));
-		if(elementsLinkListFirst == elementsLinkListLast){
-			// only one entry, no need to move anything
-			return;
-		}
-		if(element == elementsLinkListLast){ // the element is already on the last position
-			ASSERT(element->next == NULL);
-			// no need to do anything
-			return;
+	void clockKickoutOneEntry(Shard * shard){
+		if(shard->slotOffsets.empty()){
+			ASSERT(false);
+			return; // cache is empty , these is nothing to remove
 		}
-		if(element == elementsLinkListFirst){ // the element is the first element
-			ASSERT(element->previous == NULL);
-			ASSERT(element->next->previous == element);
-			elementsLinkListFirst = element->next;
-			elementsLinkListFirst->previous = NULL;
-			ASSERT(elementsLinkListLast->next == NULL);
-			elementsLinkListLast->next = element;
-			element->previous = elementsLinkListLast;
-			element->next = NULL;
-			elementsLinkListLast = element;
+		// the hand clears the reference bits it passes and stops at the first entry without one,
+		// which takes at most two rounds
+		while(true){
+			if(shard->clockHand >= shard->slots.size()){
+				shard->clockHand = 0;
+			}
+			Slot & slot = shard->slots[shard->clockHand];
+			unsigned slotOffset = shard->clockHand;
+			shard->clockHand++;
+			if(slot.entry == NULL){
+				continue;
+			}
+			if(slot.referenced != 0){
+				slot.referenced = 0;
+				continue;
+			}
+			shard->slotOffsets.erase(slot.hashedKey);
+			removeSlot(shard, slotOffset);
+			shard->evictions++;
 			return;
 		}
-		// element is in the middle
-		// 1. connect previous to next and next to previous
-		element->previous->next = element->next;
-		element->next->previous = element->previous;
-		element->next = element->previous = NULL;
-		// 2. put element in the front and make it HEAD
-		ASSERT(elementsLinkListLast->next == NULL);
-		elementsLinkListLast->next = element;
-		element->previous = elementsLinkListLast;
-		elementsLinkListLast = element;
-		return;
 	}
 
 	unsigned getNumberOfBytesUsedByEntry(CacheEntry<T> * entry){
 		/*
-		 * entry + unsigned hashedKey + linkedList element
+		 * entry + slot + hash table node (hashed key, slot offset and next pointer)
 		 */
-		return entry->getNumberOfBytes() + sizeof(unsigned) + sizeof(HashedKeyLinkListElement *) +  sizeof(HashedKeyLinkListElement);
+		return entry->getNumberOfBytes() + sizeof(Slot) + 2 * sizeof(unsigned) + sizeof(void *);
 	}
 
 	// computes the hash value of a string
@@ -442,7 +430,6 @@ private:
 };
 
 
-
 }
 }
 
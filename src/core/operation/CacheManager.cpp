@@ -57,46 +57,304 @@ void PhysicalOperatorsCache::setPhysicalOperatosInfo(string & key , boost::share
 int PhysicalOperatorsCache::clear(){
 	return this->cacheContainer->clear();
 }
+void PhysicalOperatorsCache::getStatistics(CacheStatistics & statistics){
+	this->cacheContainer->getStatistics(statistics);
+}
+
+ActiveNodesCache::ActiveNodesCache(unsigned long byteSizeOfCache){
+	this->clockHand = 0;
+	this->byteBudget = byteSizeOfCache;
+	this->totalSizeUsed = 0;
+	this->evictions = 0;
+}
 
-int ActiveNodesCache::findLongestPrefixActiveNodes(Term *term, boost::shared_ptr<PrefixActiveNodeSet> &in){
+ActiveNodesCache::~ActiveNodesCache(){
+	clear();
+}
+
+int ActiveNodesCache::findLongestPrefixActiveNodes(const std::vector<CharType> &keyword, unsigned editDistanceThreshold,
+		const TrieRootNodeSharedPtr &readView, boost::shared_ptr<PrefixActiveNodeSet> &in){
     // return 0; // If uncommented, disable caching temporarily for debugging purposes
 
-	// find the longest prefix with active nodes in the cache
-	unsigned termThreshold = term->getThreshold();
-	string *keyword = term->getKeyword();
-	for (int i = keyword->size(); i >= 2; i --)
+	unsigned hitDepth = 0;
 	{
-		string prefix = keyword->substr(0, i);
-		std::string exactOrFuzzy =  termThreshold == 0?"0":"1";
-		string key = prefix + "$" + exactOrFuzzy;
-		// Cache key is : keyword+0 (for exact) or keyword+1 (for fuzzy)
-		// for example: terminator => "terminator$0"
-		//         and  terminator~0.5 => "terminator$1"
-		boost::shared_ptr<PrefixActiveNodeSet> cacheHit;
-		if(this->cacheContainer->get(key , cacheHit) == true && cacheHit->getEditDistanceThreshold() >= termThreshold){
-			in = cacheHit;
-			return 1;
+		lockShared();
+		boost::shared_lock< boost::shared_mutex > lock(this->access, boost::adopt_lock);
+		const PrefixNode *node = editDistanceThreshold < this->roots.size() ? this->roots[editDistanceThreshold] : NULL;
+		const PrefixNode *longestPrefixNode = NULL;
+		// find the longest prefix with active nodes of the same trie version in the cache
+		for (unsigned i = 0; node != NULL && i < keyword.size(); ++i) {
+			node = findChild(node, keyword[i]);
+			if (node != NULL && i >= 1 && node->activeNodeSet && node->trieVersion == readView->getVersion()) {
+				longestPrefixNode = node;
+				hitDepth = i + 1;
+			}
 		}
+		if (longestPrefixNode == NULL) {
+			this->misses.add();
+			// no prefix has a cached PrefixActiveNodeSet
+			return 0;
+		}
+		// give the set a second chance
+		if (longestPrefixNode->referenced == 0) {
+			__sync_bool_compare_and_swap(const_cast<unsigned *>(&longestPrefixNode->referenced), 0, 1);
+		}
+		in = longestPrefixNode->activeNodeSet;
 	}
-    // no prefix has a cached PrefixActiveNodeSet
-	return 0;
+	this->hits.add();
+	this->hitDepths[std::min(hitDepth, MAXIMUM_COUNTED_HIT_DEPTH)].add();
 
+	// The set was computed on an older read view of the same version. It is mapped to readView,
+	// and cached in its place so that the older read view can be freed.
+	if (in->getTrieRootNodeSharedPtr().get() != readView.get()) {
+		in = in->copyForReadView(readView);
+		setPrefixActiveNodeSet(in);
+		this->remappedHits.add();
+	}
+	return 1;
 }
 
-
 int ActiveNodesCache::setPrefixActiveNodeSet(boost::shared_ptr<PrefixActiveNodeSet> &prefixActiveNodeSet){
     // return 1; // If uncommented, disable caching temporarily for debugging purposes
 
-	vector<CharType> *prefix = prefixActiveNodeSet->getPrefix();
-	std::stringstream ss ;
-	ss << prefixActiveNodeSet->getEditDistanceThreshold();
-	std::string exactOrFuzzy = ss.str();
-	string key = getUtf8String(*prefix) + "$" + exactOrFuzzy;
-	this->cacheContainer->put(key , prefixActiveNodeSet);
+	const vector<CharType> &prefix = *prefixActiveNodeSet->getPrefix();
+	const unsigned editDistanceThreshold = prefixActiveNodeSet->getEditDistanceThreshold();
+	const TrieRootNodeSharedPtr &readView = prefixActiveNodeSet->getTrieRootNodeSharedPtr();
+	// the prefix nodes that may have to be added are counted in advance so that evictions, which
+	// remove the nodes left empty, happen before they are added
+	const unsigned numberOfBytes = prefixActiveNodeSet->getNumberOfBytes() + prefix.size() * sizeof(PrefixNode);
+	if (prefix.size() < 2 || numberOfBytes > this->byteBudget) {
+		// we cannot accept this set, lookups skip single characters or it's bigger than our budget
+		return 0;
+	}
+
+	// most keystrokes extend prefixes that are already cached, which only needs the shared lock
+	{
+		lockShared();
+		boost::shared_lock< boost::shared_mutex > lock(this->access, boost::adopt_lock);
+		const PrefixNode *node = editDistanceThreshold < this->roots.size() ? this->roots[editDistanceThreshold] : NULL;
+		for (unsigned i = 0; node != NULL && i < prefix.size(); ++i)
+			node = findChild(node, prefix[i]);
+		if (node != NULL && node->activeNodeSet &&
+				node->activeNodeSet->getTrieRootNodeSharedPtr().get() == readView.get()) {
+			return 1;
+		}
+	}
+
+	lockExclusive();
+	boost::unique_lock< boost::shared_mutex > lock(this->access, boost::adopt_lock);
+
+	// 1. make room for the new set
+	while (numberOfBytes > this->byteBudget - this->totalSizeUsed && this->slots.size() > this->freeSlotOffsets.size()) {
+		clockKickoutOneSet();
+	}
+	if (numberOfBytes + sizeof(PrefixNode) > this->byteBudget - this->totalSizeUsed) {
+		// the nodes of the thresholds take the rest of the budget
+		return 0;
+	}
+	// 2. find or add the node of the prefix
+	if (editDistanceThreshold >= this->roots.size()) {
+		this->roots.resize(editDistanceThreshold + 1, NULL);
+	}
+	if (this->roots[editDistanceThreshold] == NULL) {
+		this->roots[editDistanceThreshold] = new PrefixNode(0, NULL);
+		this->totalSizeUsed += sizeof(PrefixNode);
+	}
+	PrefixNode *node = this->roots[editDistanceThreshold];
+	for (unsigned i = 0; i < prefix.size(); ++i) {
+		node = findOrAddChild(node, prefix[i]);
+	}
+	// 3. a set of an older trie version is replaced, a set of a newer one is kept
+	if (node->activeNodeSet) {
+		if (node->trieVersion > readView->getVersion()) {
+			return 1;
+		}
+		this->totalSizeUsed -= node->numberOfBytes;
+		node->numberOfBytes = 0;
+	} else {
+		unsigned slotOffset;
+		if (this->freeSlotOffsets.empty()) {
+			slotOffset = this->slots.size();
+			this->slots.push_back(NULL);
+		} else {
+			slotOffset = this->freeSlotOffsets.back();
+			this->freeSlotOffsets.pop_back();
+		}
+		this->slots[slotOffset] = node;
+		node->slotOffset = slotOffset;
+	}
+	node->activeNodeSet = prefixActiveNodeSet;
+	node->trieVersion = readView->getVersion();
+	node->numberOfBytes = prefixActiveNodeSet->getNumberOfBytes();
+	// a new set must be used once before it gets a second chance
+	node->referenced = 0;
+	this->totalSizeUsed += node->numberOfBytes;
+	ASSERT(this->totalSizeUsed <= this->byteBudget);
 	return 1;
 }
+
 int ActiveNodesCache::clear(){
-	return this->cacheContainer->clear();
+	lockExclusive();
+	boost::unique_lock< boost::shared_mutex > lock(this->access, boost::adopt_lock);
+	for (unsigned i = 0; i < this->roots.size(); ++i) {
+		deleteSubtrie(this->roots[i]);
+	}
+	this->roots.clear();
+	this->slots.clear();
+	this->freeSlotOffsets.clear();
+	this->clockHand = 0;
+	this->totalSizeUsed = 0;
+	return 1;
+}
+
+void ActiveNodesCache::getStatistics(CacheStatistics & statistics){
+	boost::shared_lock< boost::shared_mutex > lock(this->access);
+	statistics.hits += this->hits.get();
+	statistics.misses += this->misses.get();
+	statistics.contentions += this->contentions.get();
+	statistics.evictions += this->evictions;
+	statistics.numberOfEntries += this->slots.size() - this->freeSlotOffsets.size();
+	statistics.numberOfBytesUsed += this->totalSizeUsed;
+	statistics.byteBudget += this->byteBudget;
+}
+
+void ActiveNodesCache::getHitDepths(std::vector<unsigned long> &hitDepths){
+	hitDepths.clear();
+	for(unsigned depth = 0 ; depth <= MAXIMUM_COUNTED_HIT_DEPTH ; ++depth){
+		hitDepths.push_back(this->hitDepths[depth].get());
+	}
+}
+
+unsigned long ActiveNodesCache::getNumberOfRemappedHits(){
+	return this->remappedHits.get();
+}
+
+bool ActiveNodesCache::checkCacheConsistency(){
+	boost::shared_lock< boost::shared_mutex > lock(this->access);
+	unsigned long byteSize = 0;
+	unsigned numberOfSets = 0;
+	// every node is reachable from a root, has a parent that points to it and is not an empty leaf
+	std::vector<const PrefixNode *> nodes;
+	for (unsigned i = 0; i < this->roots.size(); ++i) {
+		if (this->roots[i] != NULL) {
+			nodes.push_back(this->roots[i]);
+		}
+	}
+	while (!nodes.empty()) {
+		const PrefixNode *node = nodes.back();
+		nodes.pop_back();
+		byteSize += sizeof(PrefixNode) + node->numberOfBytes;
+		if (node->activeNodeSet) {
+			numberOfSets++;
+			if (node->slotOffset >= this->slots.size() || this->slots[node->slotOffset] != node) {
+				return false;
+			}
+		} else if (node->children.empty() && node->parent != NULL) {
+			return false;
+		}
+		for (unsigned i = 0; i < node->children.size(); ++i) {
+			if (node->children[i]->parent != node ||
+					(i > 0 && node->children[i - 1]->character >= node->children[i]->character)) {
+				return false;
+			}
+			nodes.push_back(node->children[i]);
+		}
+	}
+	return numberOfSets + this->freeSlotOffsets.size() == this->slots.size() &&
+			byteSize == this->totalSizeUsed && byteSize <= this->byteBudget;
+}
+
+ActiveNodesCache::PrefixNode *ActiveNodesCache::findChild(const PrefixNode *node, CharType character) const{
+	for (unsigned i = 0; i < node->children.size(); ++i) {
+		if (node->children[i]->character >= character) {
+			return node->children[i]->character == character ? node->children[i] : NULL;
+		}
+	}
+	return NULL;
+}
+
+ActiveNodesCache::PrefixNode *ActiveNodesCache::findOrAddChild(PrefixNode *node, CharType character){
+	unsigned position = 0;
+	while (position < node->children.size() && node->children[position]->character < character) {
+		position++;
+	}
+	if (position < node->children.size() && node->children[position]->character == character) {
+		return node->children[position];
+	}
+	PrefixNode *child = new PrefixNode(character, node);
+	node->children.insert(node->children.begin() + position, child);
+	this->totalSizeUsed += sizeof(PrefixNode);
+	return child;
+}
+
+void ActiveNodesCache::removeSet(unsigned slotOffset){
+	PrefixNode *node = this->slots[slotOffset];
+	ASSERT(node != NULL && node->activeNodeSet);
+	ASSERT(this->totalSizeUsed >= node->numberOfBytes);
+	this->totalSizeUsed -= node->numberOfBytes;
+	node->numberOfBytes = 0;
+	node->activeNodeSet.reset();
+	this->slots[slotOffset] = NULL;
+	this->freeSlotOffsets.push_back(slotOffset);
+	// remove the nodes of the prefixes that are left without sets, the roots stay
+	while (node->parent != NULL && !node->activeNodeSet && node->children.empty()) {
+		PrefixNode *parent = node->parent;
+		parent->children.erase(std::find(parent->children.begin(), parent->children.end(), node));
+		delete node;
+		this->totalSizeUsed -= sizeof(PrefixNode);
+		node = parent;
+	}
+}
+
+void ActiveNodesCache::clockKickoutOneSet(){
+	if (this->slots.size() == this->freeSlotOffsets.size()) {
+		ASSERT(false);
+		return; // cache is empty , these is nothing to remove
+	}
+	// the hand clears the reference bits it passes and stops at the first set without one,
+	// which takes at most two rounds
+	while (true) {
+		if (this->clockHand >= this->slots.size()) {
+			this->clockHand = 0;
+		}
+		unsigned slotOffset = this->clockHand;
+		this->clockHand++;
+		PrefixNode *node = this->slots[slotOffset];
+		if (node == NULL) {
+			continue;
+		}
+		if (node->referenced != 0) {
+			node->referenced = 0;
+			continue;
+		}
+		removeSet(slotOffset);
+		this->evictions++;
+		return;
+	}
+}
+
+void ActiveNodesCache::deleteSubtrie(PrefixNode *node){
+	if (node == NULL) {
+		return;
+	}
+	for (unsigned i = 0; i < node->children.size(); ++i) {
+		deleteSubtrie(node->children[i]);
+	}
+	delete node;
+}
+
+void ActiveNodesCache::lockExclusive(){
+	if (! this->access.try_lock()) {
+		this->contentions.add();
+		this->access.lock();
+	}
+}
+
+void ActiveNodesCache::lockShared(){
+	if (! this->access.try_lock_shared()) {
+		this->contentions.add();
+		this->access.lock_shared();
+	}
 }
 
 ActiveNodesCache * CacheManager::getActiveNodesCache(){
@@ -111,6 +369,10 @@ PhysicalOperatorsCache * CacheManager::getPhysicalOperatorsCache(){
 	return this->pCache;
 }
 
+SnippetCache * CacheManager::getSnippetCache(){
+	return this->sCache;
+}
+
 PhysicalPlanRecordItemFactory * CacheManager::getPhysicalPlanRecordItemFactory(){
 	return this->physicalPlanRecordItemFactory;
 }
@@ -124,9 +386,71 @@ void QueryResultsCache::setQueryResults(string & key , boost::shared_ptr<QueryRe
 int QueryResultsCache::clear(){
 	return this->cacheContainer->clear();
 }
+void QueryResultsCache::getStatistics(CacheStatistics & statistics){
+	this->cacheContainer->getStatistics(statistics);
+}
+
+bool SnippetCache::getSnippets(string & key, boost::shared_ptr<SnippetCacheEntry> & in){
+	return this->cacheContainer->get(key , in);
+}
+void SnippetCache::setSnippets(string & key , boost::shared_ptr<SnippetCacheEntry> object){
+	this->cacheContainer->put(key , object);
+}
+int SnippetCache::clear(){
+	return this->cacheContainer->clear();
+}
+void SnippetCache::getStatistics(CacheStatistics & statistics){
+	this->cacheContainer->getStatistics(statistics);
+}
+
+static void printCacheStatistics(std::stringstream & str, const char * cacheName, const CacheStatistics & statistics,
+		const string & otherMembers = ""){
+	str << "\"" << cacheName << "\":{";
+	str << "\"hits\":\"" << statistics.hits << "\",";
+	str << "\"misses\":\"" << statistics.misses << "\",";
+	str << "\"contentions\":\"" << statistics.contentions << "\",";
+	str << "\"evictions\":\"" << statistics.evictions << "\",";
+	str << "\"entries\":\"" << statistics.numberOfEntries << "\",";
+	str << "\"bytes_used\":\"" << statistics.numberOfBytesUsed << "\",";
+	str << "\"byte_budget\":\"" << statistics.byteBudget << "\"";
+	str << otherMembers << "}";
+}
+
+const string CacheManager::getCacheStatisticsString(){
+	CacheStatistics activeNodesStatistics, queryResultsStatistics, physicalOperatorsStatistics, snippetsStatistics;
+	this->aCache->getStatistics(activeNodesStatistics);
+	this->qCache->getStatistics(queryResultsStatistics);
+	this->pCache->getStatistics(physicalOperatorsStatistics);
+	this->sCache->getStatistics(snippetsStatistics);
+	// the number of hits by the length of the cached prefix, and the hits on sets mapped from an older read view
+	std::vector<unsigned long> hitDepths;
+	this->aCache->getHitDepths(hitDepths);
+	std::stringstream activeNodesMembers;
+	activeNodesMembers << ",\"remapped_hits\":\"" << this->aCache->getNumberOfRemappedHits() << "\"";
+	activeNodesMembers << ",\"hit_depths\":{";
+	for(unsigned depth = 2 ; depth < hitDepths.size() ; ++depth){
+		activeNodesMembers << (depth > 2 ? "," : "") << "\"" << depth
+				<< (depth + 1 == hitDepths.size() ? "+" : "") << "\":\"" << hitDepths[depth] << "\"";
+	}
+	activeNodesMembers << "}";
+	std::stringstream str;
+	printCacheStatistics(str, "active_nodes", activeNodesStatistics, activeNodesMembers.str());
+	str << ",";
+	printCacheStatistics(str, "query_results", queryResultsStatistics);
+	str << ",";
+	printCacheStatistics(str, "physical_operators", physicalOperatorsStatistics);
+	str << ",";
+	printCacheStatistics(str, "snippets", snippetsStatistics);
+	return str.str();
+}
 
 int CacheManager::clear(){
-	return this->aCache->clear() && this->qCache->clear() && this->pCache->clear() && this->physicalPlanRecordItemFactory->clear();
+	return this->aCache->clear() && this->qCache->clear() && this->pCache->clear() && this->sCache->clear() &&
+			this->physicalPlanRecordItemFactory->clear();
+}
+
+int CacheManager::clearResults(){
+	return this->qCache->clear() && this->pCache->clear() && this->physicalPlanRecordItemFactory->clear();
 }
 
 
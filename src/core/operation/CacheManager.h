@@ -57,6 +57,7 @@ class PhysicalOperatorsCache {
     bool getPhysicalOperatorsInfo(string & key,  boost::shared_ptr<PhysicalOperatorCacheObject> & in);
     void setPhysicalOperatosInfo(string & key , boost::shared_ptr<PhysicalOperatorCacheObject> object);
     int clear();
+    void getStatistics(CacheStatistics & statistics);
     ~PhysicalOperatorsCache(){
         delete this->cacheContainer;
     }
@@ -68,21 +69,98 @@ private:
 /*
  * This cache module is used to set/get prefixActiveNodeSet objects to incrementally
  * compute new ones.
+ *
+ * The sets are kept in a trie of query prefixes, one for each edit distance threshold, so that
+ * the longest cached prefix of a keyword is found in one walk down its characters. The queries of
+ * all the sessions share it: the keystrokes of one user extend the prefixes typed by others.
+ *
+ * A set is tagged with the version of the trie read view it was computed on (see
+ * TrieRootNodeAndFreeList::version) and only returned to readers of a read view with the same
+ * version. A merge that does not add or remove trie nodes keeps the version, so the sets survive
+ * it and are mapped to the new read view on their first hit. A merge that changes the trie makes
+ * every set stale; the indexer then clears the cache.
+ *
+ * Lookups take the lock in shared mode. Like CacheContainer, the sets are evicted with the CLOCK
+ * policy when their bytes exceed the budget.
  */
 class ActiveNodesCache {
 public:
-    ActiveNodesCache(unsigned long byteSizeOfCache = 134217728){
-        this->cacheContainer = new CacheContainer<PrefixActiveNodeSet>(byteSizeOfCache);
-    }
-    int findLongestPrefixActiveNodes(Term *term, boost::shared_ptr<PrefixActiveNodeSet> &in);
+    typedef boost::shared_ptr<TrieRootNodeAndFreeList> TrieRootNodeSharedPtr;
+
+    // hit depths are counted for the prefixes of up to this many characters, longer ones share the last count
+    static const unsigned MAXIMUM_COUNTED_HIT_DEPTH = 16;
+
+    ActiveNodesCache(unsigned long byteSizeOfCache = 134217728);
+    ~ActiveNodesCache();
+
+    /*
+     * Finds the longest prefix of keyword, of at least 2 characters, that has a set cached with the
+     * threshold and the trie version of readView. Returns 1 and the set, computed on readView,
+     * or 0 if there is none.
+     */
+    int findLongestPrefixActiveNodes(const std::vector<CharType> &keyword, unsigned editDistanceThreshold,
+            const TrieRootNodeSharedPtr &readView, boost::shared_ptr<PrefixActiveNodeSet> &in);
+    // the set must be ready for iteration, it is not changed after it is cached
     int setPrefixActiveNodeSet(boost::shared_ptr<PrefixActiveNodeSet> &prefixActiveNodeSet);
     int clear();
-    ~ActiveNodesCache(){
-        delete cacheContainer;
-    }
+    void getStatistics(CacheStatistics & statistics);
+    // hitDepths[i] is the number of hits on a prefix of i characters, see MAXIMUM_COUNTED_HIT_DEPTH
+    void getHitDepths(std::vector<unsigned long> &hitDepths);
+    // the number of hits on a set computed on an older read view of the same trie version
+    unsigned long getNumberOfRemappedHits();
+    bool checkCacheConsistency();
+
 private:
-    CacheContainer<PrefixActiveNodeSet> * cacheContainer;
+    struct PrefixNode{
+        CharType character;
+        PrefixNode *parent;
+        // sorted by character
+        std::vector<PrefixNode *> children;
+        // empty if no set is cached for the prefix
+        boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet;
+        unsigned long trieVersion;
+        unsigned numberOfBytes;
+        // offset of the node in slots while it has a set
+        unsigned slotOffset;
+        // set by a hit under the shared lock, cleared by the clock hand
+        unsigned referenced;
+        PrefixNode(CharType character, PrefixNode *parent){
+            this->character = character;
+            this->parent = parent;
+            this->trieVersion = 0;
+            this->numberOfBytes = 0;
+            this->slotOffset = 0;
+            this->referenced = 0;
+        }
+    };
+
+    PrefixNode *findChild(const PrefixNode *node, CharType character) const;
+    PrefixNode *findOrAddChild(PrefixNode *node, CharType character);
+    // removes the set of the node in a slot and the nodes left without a set and children
+    void removeSet(unsigned slotOffset);
+    void clockKickoutOneSet();
+    void deleteSubtrie(PrefixNode *node);
+    void lockShared();
+    void lockExclusive();
 
+    boost::shared_mutex access;
+    // indexed by edit distance threshold, NULL until a set with the threshold is cached
+    std::vector<PrefixNode *> roots;
+    // the nodes that have a set, NULL for a free slot
+    std::vector<PrefixNode *> slots;
+    std::vector<unsigned> freeSlotOffsets;
+    unsigned clockHand;
+    unsigned long byteBudget;
+    // the bytes of the sets and of the prefix nodes
+    unsigned long totalSizeUsed;
+    // lookups only hold the shared lock, so their counters are sharded by thread
+    srch2::util::ShardedCounter hits;
+    srch2::util::ShardedCounter misses;
+    srch2::util::ShardedCounter contentions;
+    srch2::util::ShardedCounter remappedHits;
+    srch2::util::ShardedCounter hitDepths[MAXIMUM_COUNTED_HIT_DEPTH + 1];
+    // incremented under the exclusive lock
+    unsigned long evictions;
 };
 
 /*
@@ -154,6 +232,7 @@ public:
     bool getQueryResults(string & key,  boost::shared_ptr<QueryResultsCacheEntry> & in);
     void setQueryResults(string & key , boost::shared_ptr<QueryResultsCacheEntry> object);
     int clear();
+    void getStatistics(CacheStatistics & statistics);
     ~QueryResultsCache(){
         delete this->cacheContainer;
     }
@@ -161,6 +240,43 @@ private:
     CacheContainer<QueryResultsCacheEntry> * cacheContainer;
 };
 
+/*
+ * The snippets of one attribute of a record for the keywords of a query, so that the highlighter
+ * does not decode and analyze the attribute again when the record is returned by the same query
+ * (e.g. the next page) or by a query matching it with the same keywords.
+ * The key contains the internal record id. Record ids are never reused, so the entries are still
+ * valid after records are inserted, updated or deleted and the cache is not cleared on merges.
+ */
+class SnippetCacheEntry{
+public:
+    std::vector<std::string> snippets;
+
+    unsigned getNumberOfBytes() {
+        unsigned result = sizeof(SnippetCacheEntry) + snippets.capacity() * sizeof(std::string);
+        for(unsigned i = 0 ; i < snippets.size() ; ++i){
+            result += snippets[i].capacity();
+        }
+        return result;
+    }
+};
+
+class SnippetCache {
+public:
+    SnippetCache(unsigned long byteSizeOfCache = 134217728){
+        this->cacheContainer = new CacheContainer<SnippetCacheEntry>(byteSizeOfCache);
+    }
+
+    bool getSnippets(string & key, boost::shared_ptr<SnippetCacheEntry> & in);
+    void setSnippets(string & key, boost::shared_ptr<SnippetCacheEntry> object);
+    int clear();
+    void getStatistics(CacheStatistics & statistics);
+    ~SnippetCache(){
+        delete this->cacheContainer;
+    }
+private:
+    CacheContainer<SnippetCacheEntry> * cacheContainer;
+};
+
 
 /*
  * This class is the cache manager. The CacheManager is the holder of different kinds of Cache, e.g.
@@ -172,22 +288,32 @@ public:
     CacheManager(unsigned long byteSizeOfCache = 134217728){
         aCache = new ActiveNodesCache(byteSizeOfCache * 3.0/9); // we don't allocate cache budget equally
         qCache = new QueryResultsCache(byteSizeOfCache * 2.0/9);
-        pCache = new PhysicalOperatorsCache(byteSizeOfCache * 4.0/9);
+        pCache = new PhysicalOperatorsCache(byteSizeOfCache * 3.0/9);
+        sCache = new SnippetCache(byteSizeOfCache * 1.0/9);
         physicalPlanRecordItemFactory = new PhysicalPlanRecordItemFactory();
     }
     virtual ~CacheManager(){
         delete aCache;
         delete qCache;
         delete pCache;
+        delete sCache;
         delete physicalPlanRecordItemFactory;
     }
 
     int clear();
+    // Clears the caches that depend on the records. The cached active nodes only depend on the
+    // trie and are checked against its version (see ActiveNodesCache), and the cached snippets are
+    // keyed by record ids, which are never reused (see SnippetCacheEntry).
+    int clearResults();
     ActiveNodesCache * getActiveNodesCache();
     QueryResultsCache * getQueryResultsCache();
     PhysicalOperatorsCache * getPhysicalOperatorsCache();
+    SnippetCache * getSnippetCache();
     PhysicalPlanRecordItemFactory * getPhysicalPlanRecordItemFactory();
 
+    // hit, miss, contention and size counters of the caches, as members of a JSON object
+    const string getCacheStatisticsString();
+
 
 private:
     ActiveNodesCache * aCache;
@@ -196,6 +322,8 @@ private:
 
     PhysicalOperatorsCache * pCache;
 
+    SnippetCache * sCache;
+
     PhysicalPlanRecordItemFactory * physicalPlanRecordItemFactory;
 
 };
@@ -322,30 +322,32 @@ boost::shared_ptr<PrefixActiveNodeSet> HistogramManager::computeActiveNodeSet(Te
     // 1. Get the longest prefix that has active nodes
     unsigned cachedPrefixLength = 0;
     boost::shared_ptr<PrefixActiveNodeSet> initialPrefixActiveNodeSet ;
-    int cacheResponse = this->queryEvaluator->cacheManager->getActiveNodesCache()->findLongestPrefixActiveNodes(term, initialPrefixActiveNodeSet); //initialPrefixActiveNodeSet is Busy
-
-    if ( cacheResponse == 0) { // NO CacheHit,  response = 0
+    // The cache only returns sets computed on a read view of the trie with the version of ours
+    int cacheResponse = this->queryEvaluator->cacheManager->getActiveNodesCache()->findLongestPrefixActiveNodes(
+            charTypeKeyword, term->getThreshold(), this->queryEvaluator->indexReadToken.readState->trieRootNodeSharedPtr,
+            initialPrefixActiveNodeSet);
+
+    // NO CacheHit (response = 0), or a cached prefix the rest of which could miss active nodes
+    if ( cacheResponse == 0 || (initialPrefixActiveNodeSet->getPrefixLength() < keywordLength
+            && PrefixActiveNodeSet::incrementalComputationCanMissActiveNodes(term->getThreshold(),
+                    this->queryEvaluator->getSchema()->getSupportSwapInEditDistance()))) {
         //std::cout << "|NO Cache|" << std::endl;;
+        // Compute the whole prefix in one pass over the frozen trie if the read view has one
+        boost::shared_ptr<PrefixActiveNodeSet> frozenPrefixActiveNodeSet =
+                PrefixActiveNodeSet::computeActiveNodeSetFromFrozenTrie(charTypeKeyword, term->getThreshold(),
+                        this->queryEvaluator->indexReadToken.readState->trieRootNodeSharedPtr,
+                        this->queryEvaluator->getSchema()->getSupportSwapInEditDistance());
+        if (frozenPrefixActiveNodeSet) {
+            if (keywordLength >= 3) {
+                frozenPrefixActiveNodeSet->prepareForIteration(); // this is the last write operation on it
+                this->queryEvaluator->cacheManager->getActiveNodesCache()->setPrefixActiveNodeSet(frozenPrefixActiveNodeSet);
+            }
+            return frozenPrefixActiveNodeSet;
+        }
         // No prefix has a cached TermActiveNode Set. Create one for the empty std::string "".
-    	initialPrefixActiveNodeSet.reset(new PrefixActiveNodeSet(this->queryEvaluator->indexReadToken.trieRootNodeSharedPtr,
-    			term->getThreshold(), this->queryEvaluator->getSchema()->getSupportSwapInEditDistance()));
-    }
-    else{
-    	/*
-    	 * Indexing explanation :
-    	 * This is the case where a prefixActiveNodeSet (pans) is found in
-    	 * cache with a prefix of term. There is a shared pointer
-    	 * in PANS which is the readview of Trie. If the physical memory address
-    	 * of this shared pointer, and the mem address of the current readview, are
-    	 * not equal. It's not safe to accept this cache entry; a new one must be started.
-    	 */
-    	if(! initialPrefixActiveNodeSet->hasTheSameVersionTrie(
-    			this->queryEvaluator->indexReadToken.trieRootNodeSharedPtr)){
-    		// just like cache wasn't found at all
-    		cacheResponse = 0;
-        	initialPrefixActiveNodeSet.reset(new PrefixActiveNodeSet(this->queryEvaluator->indexReadToken.trieRootNodeSharedPtr,
-        			term->getThreshold(), this->queryEvaluator->getSchema()->getSupportSwapInEditDistance()));
-    	}
+        if (cacheResponse == 0)
+            initialPrefixActiveNodeSet.reset(new PrefixActiveNodeSet(this->queryEvaluator->indexReadToken.readState->trieRootNodeSharedPtr,
+                    term->getThreshold(), this->queryEvaluator->getSchema()->getSupportSwapInEditDistance()));
     }
     cachedPrefixLength = initialPrefixActiveNodeSet->getPrefixLength();
 
@@ -373,7 +375,7 @@ boost::shared_ptr<PrefixActiveNodeSet> HistogramManager::computeActiveNodeSet(Te
 boost::shared_ptr<GeoBusyNodeSet> HistogramManager::computeQuadTreeNodeSet(Shape* shape){
 	// first create a shared pointer of geoActiveNodeSet
 	boost::shared_ptr<GeoBusyNodeSet> geoActiveNodeSet;
-	geoActiveNodeSet.reset(new GeoBusyNodeSet(this->queryEvaluator->indexReadToken.quadTreeRootNodeSharedPtr));
+	geoActiveNodeSet.reset(new GeoBusyNodeSet(this->queryEvaluator->indexReadToken.readState->quadTreeRootNodeSharedPtr));
 	// Then by calling computeQuadTreeNodeSet find all quadTreeNodes inside the query region
 	geoActiveNodeSet->computeQuadTreeNodeSet(*shape);
 	return geoActiveNodeSet;
@@ -403,10 +405,10 @@ void HistogramManager::computeEstimatedProbabilityOfPrefixAndNumberOfLeafNodes(T
 			aggregatedNumberOfLeafNodes ++; // each terminal node is one leaf node when term is complete
 
 			// fetch the inverted list to get its size
-			shared_ptr<vectorview<unsigned> > invertedListReadView;
-			queryEvaluator->indexReadToken.getInvertedListReadView(trieNode->getInvertedListOffset(), invertedListReadView);
+			InvertedListCursor invertedListCursor;
+			queryEvaluator->indexReadToken.getInvertedListCursor(trieNode->getInvertedListOffset(), invertedListCursor);
 			// calculate the probability of this node by using invertedlist size
-			double individualProbabilityOfCompleteTermTrieNode = (invertedListReadView->size() * 1.0) /
+			double individualProbabilityOfCompleteTermTrieNode = (invertedListCursor.size() * 1.0) /
 					this->queryEvaluator->getTotalNumberOfRecords();
 			// use new probability in joint probability
 			aggregatedProbability =
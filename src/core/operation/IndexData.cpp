@@ -37,8 +37,10 @@
 #include <instantsearch/Analyzer.h>
 #include "util/FileOps.h"
 #include "serialization/Serializer.h"
+#include "serialization/FlatSnapshot.h"
 #include "util/RecordSerializerUtil.h"
 #include "util/RecordSerializer.h"
+#include "util/WorkStealingThreadPool.h"
 #include <stdio.h>  /* defines FILENAME_MAX */
 #include <iostream>
 #include <string>
@@ -46,10 +48,14 @@
 #include <map>
 #include <memory>
 #include <exception>
+#include <sstream>
+#include <time.h>
 #include "AttributeAccessControl.h"
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "operation/CacheManager.h"
 
@@ -66,30 +72,34 @@ namespace instantsearch {
 
 /////////////////// Inverted Index Access Methods
 void IndexReadStateSharedPtr_Token::getInvertedListReadView(const unsigned invertedListId, shared_ptr<vectorview<unsigned> >& invertedListReadView) {
-	this->invertedIndex->getInvertedListReadView(this->invertedIndexReadViewSharedPtr, invertedListId, invertedListReadView);
+	this->invertedIndex->getInvertedListReadView(this->readState->invertedIndexReadViewSharedPtr, invertedListId, invertedListReadView);
+}
+
+void IndexReadStateSharedPtr_Token::getInvertedListCursor(const unsigned invertedListId, InvertedListCursor& cursor) {
+	this->invertedIndex->getInvertedListCursor(this->readState->invertedIndexReadViewSharedPtr, invertedListId, cursor);
 }
 
 // given a forworListId and invertedList offset, return the keyword offset
 unsigned IndexReadStateSharedPtr_Token::getKeywordOffset(unsigned forwardListId, unsigned invertedListOffset) {
-	return this->invertedIndex->getKeywordOffset(forwardIndexReadViewSharedPtr, invertedIndexKeywordIdsReadViewSharedPtr,
+	return this->invertedIndex->getKeywordOffset(readState->forwardIndexReadViewSharedPtr, readState->invertedIndexKeywordIdsReadViewSharedPtr,
 			forwardListId, invertedListOffset);
 }
 
 bool IndexReadStateSharedPtr_Token::isValidTermPositionHit(unsigned forwardListId, unsigned keywordOffset,
         const vector<unsigned>& filterAttributesList, ATTRIBUTES_OP attrOp,
         vector<unsigned>& matchingKeywordAttributesList, float &termRecordStaticScore) {
-	return this->invertedIndex->isValidTermPositionHit(forwardIndexReadViewSharedPtr,
+	return this->invertedIndex->isValidTermPositionHit(readState->forwardIndexReadViewSharedPtr,
 			forwardListId, keywordOffset, filterAttributesList,
 			attrOp, matchingKeywordAttributesList, termRecordStaticScore);
 }
 
 ////////////////// Forward Index Access Methods
 const ForwardList *IndexReadStateSharedPtr_Token::getForwardList(unsigned recordId, bool &valid){
-	return this->forwardIndex->getForwardList(forwardIndexReadViewSharedPtr, recordId, valid);
+	return this->forwardIndex->getForwardList(readState->forwardIndexReadViewSharedPtr, recordId, valid);
 }
 
 bool IndexReadStateSharedPtr_Token::hasAccessToForwardList(unsigned recordId, string &roleId){
-	return this->forwardIndex->hasAccessToForwardList(forwardIndexReadViewSharedPtr, recordId, roleId);
+	return this->forwardIndex->hasAccessToForwardList(readState->forwardIndexReadViewSharedPtr, recordId, roleId);
 }
 
 // do binary search to probe in forward list
@@ -98,14 +108,14 @@ bool IndexReadStateSharedPtr_Token::haveWordInRange(const unsigned recordId, con
         ATTRIBUTES_OP attrOp,
         unsigned &matchingKeywordId, vector<unsigned>& matchingKeywordAttributesList,
         float &matchingKeywordRecordStaticScore)  {
-	return this->forwardIndex->haveWordInRange(forwardIndexReadViewSharedPtr,
+	return this->forwardIndex->haveWordInRange(readState->forwardIndexReadViewSharedPtr,
 			recordId, minId, maxId,
 			filteringAttributesList, attrOp,
 			matchingKeywordId, matchingKeywordAttributesList, matchingKeywordRecordStaticScore);
 }
 
 bool IndexReadStateSharedPtr_Token::getExternalRecordIdFromInternalRecordId(const unsigned internalRecordId, std::string &externalRecordId){
-	return this->forwardIndex->getExternalRecordIdFromInternalRecordId(forwardIndexReadViewSharedPtr, internalRecordId, externalRecordId);
+	return this->forwardIndex->getExternalRecordIdFromInternalRecordId(readState->forwardIndexReadViewSharedPtr, internalRecordId, externalRecordId);
 }
 
 bool IndexReadStateSharedPtr_Token::getInternalRecordIdFromExternalRecordId(const std::string &externalRecordId, unsigned &internalRecordId) {
@@ -113,19 +123,20 @@ bool IndexReadStateSharedPtr_Token::getInternalRecordIdFromExternalRecordId(cons
 }
 /////////////////////// Trie Access Methods
 const TrieNode *IndexReadStateSharedPtr_Token::getTrieNodeFromUtf8String(const std::string &keywordStr) {
-	return this->trie->getTrieNodeFromUtf8String(trieRootNodeSharedPtr->root , keywordStr);
+	return this->trie->getTrieNodeFromUtf8String(readState->trieRootNodeSharedPtr->root , keywordStr);
 }
 void IndexReadStateSharedPtr_Token::getPrefixString(const TrieNode* trieNode, std::string &in) {
-	this->trie->getPrefixString(trieRootNodeSharedPtr->root, trieNode, in);
+	this->trie->getPrefixString(readState->trieRootNodeSharedPtr->root, trieNode, in);
 }
 
 void IndexReadStateSharedPtr_Token::getPrefixString(const TrieNode* trieNode, std::vector<CharType> &in) {
-	this->trie->getPrefixString(trieRootNodeSharedPtr->root, trieNode, in);
+	this->trie->getPrefixString(readState->trieRootNodeSharedPtr->root, trieNode, in);
 }
 
 
 IndexData::IndexData(const string &directoryName, Analyzer *analyzer,
-		Schema *schema, const StemmerNormalizerFlagType &stemmerFlag) {
+		Schema *schema, const StemmerNormalizerFlagType &stemmerFlag):
+		retiredReadStates(readerEpochs) {
 
 	this->directoryName = directoryName;
 
@@ -145,6 +156,8 @@ IndexData::IndexData(const string &directoryName, Analyzer *analyzer,
 
 	this->forwardIndex = new ForwardIndex(this->schemaInternal);
 
+	this->docValues = new DocValues(this->schemaInternal);
+
 	this->invertedIndex = new InvertedIndex(this->forwardIndex);
 
 	this->quadTree = new QuadTree();
@@ -158,9 +171,14 @@ IndexData::IndexData(const string &directoryName, Analyzer *analyzer,
 	this->mergeRequired = true;
 
 	this->attributeAcl = new AttributeAccessControl(this->schemaInternal);
+
+	// published by finishBulkLoad(), readers do not use the indexes before
+	this->readState = NULL;
+	this->readersExcluded = false;
 }
 
-IndexData::IndexData(const string& directoryName) {
+IndexData::IndexData(const string& directoryName):
+		retiredReadStates(readerEpochs) {
 	this->directoryName = directoryName;
 
 	if (!checkDirExistence(directoryName.c_str())) {
@@ -191,13 +209,39 @@ IndexData::IndexData(const string& directoryName) {
 		if (isEnabledAttributeBasedSearch(positionIndexType))
 			this->forwardIndex->isAttributeBasedSearch = true;
 
-		serializer.load(*(this->forwardIndex),
-				directoryName + "/" + IndexConfig::forwardIndexFileName);
+		// The forward and inverted indexes are saved as flat snapshots, whose arrays are mapped instead
+		// of being deserialized (the forward lists themselves are still created one by one). Indexes saved
+		// by older engines, and the other structures, are still loaded from boost archives.
+		string forwardIndexFileName = directoryName + "/" + IndexConfig::forwardIndexFileName;
+		if (FlatSnapshotReader::isFlatSnapshot(forwardIndexFileName))
+			this->forwardIndex->loadSnapshot(forwardIndexFileName);
+		else
+			serializer.load(*(this->forwardIndex), forwardIndexFileName);
 		this->forwardIndex->setSchema(this->schemaInternal);
 
-		serializer.load(*(this->invertedIndex),
-				directoryName + "/" + IndexConfig::invertedIndexFileName);
+		// the doc values are mapped from their snapshot. Indexes saved without one, or with columns
+		// that do not match the forward index, rebuild them from the stored records.
+		this->docValues = new DocValues(this->schemaInternal);
+		const unsigned numberOfForwardLists = this->forwardIndex->getTotalNumberOfForwardLists_WriteView();
+		string docValuesFileName = directoryName + "/" + IndexConfig::docValuesFileName;
+		if (!FlatSnapshotReader::isFlatSnapshot(docValuesFileName)
+				|| !this->docValues->load(FlatSnapshotReader(docValuesFileName), numberOfForwardLists)) {
+			for (unsigned recordId = 0; recordId < numberOfForwardLists; ++recordId) {
+				const ForwardList *forwardList = this->forwardIndex->getForwardList_ForCommit(recordId);
+				this->docValues->addRecord(recordId,
+						forwardList == NULL ? StoredRecordBuffer() : forwardList->getInMemoryData());
+			}
+			this->docValues->commit();
+		}
+
+		string invertedIndexFileName = directoryName + "/" + IndexConfig::invertedIndexFileName;
+		if (FlatSnapshotReader::isFlatSnapshot(invertedIndexFileName))
+			this->invertedIndex->loadSnapshot(invertedIndexFileName);
+		else
+			serializer.load(*(this->invertedIndex), invertedIndexFileName);
 		this->invertedIndex->setForwardIndex(this->forwardIndex);
+		// lists saved uncompressed (boost archives, older snapshots) are only kept compressed from here on
+		this->invertedIndex->compressLoadedInvertedLists();
 
 		serializer.load(*(this->quadTree),
 				directoryName + "/" + IndexConfig::quadTreeFileName);
@@ -214,6 +258,9 @@ IndexData::IndexData(const string& directoryName) {
 
 		this->loadCounts(
 				directoryName + "/" + IndexConfig::indexCountsFileName);
+		this->readState = NULL;
+		this->readersExcluded = false;
+		this->publishReadState();
 		this->flagBulkLoadDone = true;
 	} catch (exception& ex) {
 		Logger::error("Error while loading the index files ...");
@@ -247,12 +294,48 @@ bool isSortedAlphabetically(
 // read view for each of them during the lifecycle of a search process.
 void IndexData::getReadView(IndexReadStateSharedPtr_Token &readToken)
 {
-    this->trie->getTrieRootNode_ReadView(readToken.trieRootNodeSharedPtr);
-    this->quadTree->getQuadTreeRootNode_ReadView(readToken.quadTreeRootNodeSharedPtr);
-    this->forwardIndex->getForwardListDirectory_ReadView(readToken.forwardIndexReadViewSharedPtr);
-    this->invertedIndex->getInvertedIndexDirectory_ReadView(readToken.invertedIndexReadViewSharedPtr);
-    this->invertedIndex->getInvertedIndexKeywordIds_ReadView(readToken.invertedIndexKeywordIdsReadViewSharedPtr);
-    this->readCounter->increment();
+    // The read state cannot be released before the reader exits its epoch. A token that already
+    // has one keeps its epoch, which is older.
+    if (readToken.readerSlot == NULL) {
+        // A thread that is already in, with another token, is not made to wait: a merge that excludes
+        // readers waits in synchronize() for that outer read before it changes anything, so waiting
+        // here would never end. The nested read sees the same indexes as the outer one.
+        const bool nested = this->readerEpochs.isEnteredByCurrentThread();
+        readToken.readerSlot = this->readerEpochs.enter();
+        // the flag is read after the epoch is pinned, so excludeReaders() either waits for this reader
+        // or this reader sees the flag
+        while (!nested && this->readersExcluded) {
+            srch2::util::EpochManager::exit(readToken.readerSlot);
+            {
+                boost::unique_lock<boost::mutex> lock(this->readersExcludedMutex);
+                while (this->readersExcluded)
+                    this->readersAdmitted.wait(lock);
+            }
+            readToken.readerSlot = this->readerEpochs.enter();
+        }
+    }
+    readToken.readState = this->readState;
+    this->readCounter->increment(srch2::util::EpochManager::getSlotIndex(readToken.readerSlot));
+}
+
+void IndexData::publishReadState()
+{
+    IndexReadState *newReadState = new IndexReadState();
+    this->trie->getTrieRootNode_ReadView(newReadState->trieRootNodeSharedPtr);
+    this->quadTree->getQuadTreeRootNode_ReadView(newReadState->quadTreeRootNodeSharedPtr);
+    this->forwardIndex->getForwardListDirectory_ReadView(newReadState->forwardIndexReadViewSharedPtr);
+    // taken after the forward index, so it never covers records the forward index view does not have
+    this->docValues->getReadView(newReadState->docValuesReadViewSharedPtr);
+    this->invertedIndex->getInvertedIndexDirectory_ReadView(newReadState->invertedIndexReadViewSharedPtr);
+    this->invertedIndex->getInvertedIndexKeywordIds_ReadView(newReadState->invertedIndexKeywordIdsReadViewSharedPtr);
+
+    IndexReadState *oldReadState = this->readState;
+    // the read state must be complete before readers can see it
+    __sync_synchronize();
+    this->readState = newReadState;
+    if (oldReadState != NULL) {
+        this->retiredReadStates.retire(boost::shared_ptr<const void>(oldReadState));
+    }
 }
 
 void IndexData::initializeIndexReadTokenHolder(IndexReadStateSharedPtr_Token & token) const{
@@ -332,8 +415,29 @@ INDEXWRITE_RETVAL IndexData::_addRecord(const Record *record,
 	return _addRecordWithoutLock(record, analyzer);
 }
 
+INDEXWRITE_RETVAL IndexData::_addAnalyzedRecord(const Record *record,
+		map<string, TokenAttributeHits> &tokenAttributeHitsMap) {
+	return _addAnalyzedRecordWithoutLock(record, tokenAttributeHitsMap);
+}
+
 INDEXWRITE_RETVAL IndexData::_addRecordWithoutLock(const Record *record,
 		Analyzer *analyzer) {
+	//Check for duplicate record before analyzing it
+	unsigned internalRecordIdTemp;
+	if (this->forwardIndex->getInternalRecordIdFromExternalRecordId(
+			record->getPrimaryKey(), internalRecordIdTemp)) {
+		return OP_FAIL;
+	}
+
+	/// analyze the record (tokenize it, remove stop words)
+	map<string, TokenAttributeHits> tokenAttributeHitsMap;
+	analyzer->tokenizeRecord(record, tokenAttributeHitsMap);
+
+	return _addAnalyzedRecordWithoutLock(record, tokenAttributeHitsMap);
+}
+
+INDEXWRITE_RETVAL IndexData::_addAnalyzedRecordWithoutLock(const Record *record,
+		map<string, TokenAttributeHits> &tokenAttributeHitsMap) {
 	/// Get the internalRecordId
 	unsigned internalRecordIdTemp;
 	//Check for duplicate record
@@ -350,9 +454,6 @@ INDEXWRITE_RETVAL IndexData::_addRecordWithoutLock(const Record *record,
 	this->writeCounter->incDocsCounter();
 
 	this->mergeRequired = true;
-	/// analyze the record (tokenize it, remove stop words)
-	map<string, TokenAttributeHits> tokenAttributeHitsMap;
-	analyzer->tokenizeRecord(record, tokenAttributeHitsMap);
 
 	KeywordIdKeywordStringInvertedListIdTriple keywordIdList;
 
@@ -416,6 +517,8 @@ INDEXWRITE_RETVAL IndexData::_addRecordWithoutLock(const Record *record,
 			internalRecordId);
 	this->forwardIndex->addRecord(record, internalRecordId, keywordIdList,
 			tokenAttributeHitsMap);
+	this->docValues->addRecord(internalRecordId,
+			this->forwardIndex->getForwardList_ForCommit(internalRecordId)->getInMemoryData());
 
 	if (this->flagBulkLoadDone) {
 		const unsigned totalNumberofDocuments =
@@ -605,6 +708,25 @@ INDEXWRITE_RETVAL IndexData::_recoverRecord(const std::string &externalRecordId,
 	return success;
 }
 
+// Reorders the forward lists [begin, end) of the current commit chunk with the new keyword ids and computes
+// their static scores. A NULL rankerExpression means a private copy of the index's expression is used.
+void IndexData::commitForwardLists(unsigned begin, unsigned end, RankerExpression *rankerExpression,
+		const unsigned totalNumberOfDocuments, const map<unsigned, unsigned> &oldIdToNewIdMapper,
+		vector<ForwardList *> *forwardLists,
+		vector<vector<NewKeywordIdKeywordOffsetTriple> > *newKeywordIdKeywordOffsetTriples) const {
+	boost::scoped_ptr<RankerExpression> privateRankerExpression;
+	if (rankerExpression == NULL) {
+		privateRankerExpression.reset(new RankerExpression(this->rankerExpression->getExpressionString()));
+		rankerExpression = privateRankerExpression.get();
+	}
+	for (unsigned i = begin; i < end; ++i) {
+		this->forwardIndex->commit(forwardLists->at(i), oldIdToNewIdMapper,
+				newKeywordIdKeywordOffsetTriples->at(i));
+		this->invertedIndex->computeRecordStaticScoresAtCommit(forwardLists->at(i), rankerExpression,
+				totalNumberOfDocuments, newKeywordIdKeywordOffsetTriples->at(i));
+	}
+}
+
 // check if the record exists
 INDEXLOOKUP_RETVAL IndexData::_lookupRecord(
 		const std::string &externalRecordId, unsigned& internalRecordId) const {
@@ -637,6 +759,7 @@ INDEXWRITE_RETVAL IndexData::finishBulkLoad() {
 		// Note: we should commit even if totalNumberofDocuments = 0
 
 		this->forwardIndex->commit();
+		this->docValues->commit();
 		this->trie->commit();
 		this->quadTree->commit();
 		const vector<unsigned> *oldIdToNewIdMapVector =
@@ -648,19 +771,41 @@ INDEXWRITE_RETVAL IndexData::finishBulkLoad() {
 
 		this->invertedIndex->initialiseInvertedIndexCommit();
 
-		for (unsigned forwardIndexIter = 0;
-				forwardIndexIter < totalNumberofDocuments; ++forwardIndexIter) {
-			ForwardList *forwardList =
-					this->forwardIndex->getForwardList_ForCommit(
-							forwardIndexIter);
-			vector<NewKeywordIdKeywordOffsetTriple> newKeywordIdKeywordOffsetTriple;
-			//this->forwardIndex->commit(forwardList, oldIdToNewIdMapVector, newKeywordIdKeywordOffsetTriple);
-			this->forwardIndex->commit(forwardList, oldIdToNewIdMapper,
-					newKeywordIdKeywordOffsetTriple);
-
-			this->invertedIndex->commit(forwardList, this->rankerExpression,
-					forwardIndexIter, totalNumberofDocuments,
-					this->schemaInternal, newKeywordIdKeywordOffsetTriple);
+		// The forward lists are reordered and scored in parallel chunk by chunk, and then the records of the
+		// chunk are appended to the inverted lists in the order of their ids.
+		WorkStealingThreadPool *pool = WorkStealingThreadPool::getSharedPool();
+		const unsigned chunkSize = 65536;
+		const unsigned taskSize = std::max(chunkSize / (pool->getNumberOfThreads() * 4), 256u);
+		vector<ForwardList *> forwardLists;
+		vector<vector<NewKeywordIdKeywordOffsetTriple> > newKeywordIdKeywordOffsetTriples;
+		for (unsigned chunkBegin = 0; chunkBegin < totalNumberofDocuments; chunkBegin += chunkSize) {
+			const unsigned chunkEnd = std::min(chunkBegin + chunkSize, totalNumberofDocuments);
+			forwardLists.resize(chunkEnd - chunkBegin);
+			newKeywordIdKeywordOffsetTriples.resize(chunkEnd - chunkBegin);
+			for (unsigned forwardIndexIter = chunkBegin; forwardIndexIter < chunkEnd; ++forwardIndexIter) {
+				forwardLists[forwardIndexIter - chunkBegin] =
+						this->forwardIndex->getForwardList_ForCommit(forwardIndexIter);
+			}
+
+			if (pool->getNumberOfThreads() < 2 || forwardLists.size() <= taskSize) {
+				commitForwardLists(0, forwardLists.size(), this->rankerExpression, totalNumberofDocuments,
+						oldIdToNewIdMapper, &forwardLists, &newKeywordIdKeywordOffsetTriples);
+			} else {
+				TaskGroup taskGroup(pool);
+				for (unsigned begin = 0; begin < forwardLists.size(); begin += taskSize) {
+					// RankerExpression is not thread-safe, so each task parses its own copy
+					taskGroup.run(boost::bind(&IndexData::commitForwardLists, this, begin,
+							std::min(begin + taskSize, (unsigned) forwardLists.size()), (RankerExpression *) NULL,
+							totalNumberofDocuments, boost::cref(oldIdToNewIdMapper), &forwardLists,
+							&newKeywordIdKeywordOffsetTriples));
+				}
+				taskGroup.wait();
+			}
+
+			for (unsigned forwardIndexIter = chunkBegin; forwardIndexIter < chunkEnd; ++forwardIndexIter) {
+				this->invertedIndex->addRecordAtCommit(forwardIndexIter,
+						newKeywordIdKeywordOffsetTriples[forwardIndexIter - chunkBegin]);
+			}
 		}
 		this->forwardIndex->finalCommit();
 
@@ -680,6 +825,7 @@ INDEXWRITE_RETVAL IndexData::finishBulkLoad() {
 				this->invertedIndex, this->forwardIndex,
 				this->forwardIndex->getTotalNumberOfForwardLists_ReadView());
 
+		this->publishReadState();
 		this->flagBulkLoadDone = true;
 		return OP_SUCCESS;
 	} else {
@@ -687,24 +833,38 @@ INDEXWRITE_RETVAL IndexData::finishBulkLoad() {
 	}
 }
 
+// Returns the milliseconds since phaseStart, and restarts it.
+static double restartPhaseTimer(struct timespec &phaseStart) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double milliseconds = (now.tv_sec - phaseStart.tv_sec) * 1000.0
+			+ (now.tv_nsec - phaseStart.tv_nsec) / 1000000.0;
+	phaseStart = now;
+	return milliseconds;
+}
+
+// Readers are not blocked by a merge, except one that reassigns keyword ids (see excludeReaders()).
+// Each index structure builds its new read view next to the current one and publishes it with a
+// pointer swap, and everything readers may still reach is retired with the current trie read view
+// instead of being freed in place.
 INDEXWRITE_RETVAL IndexData::_merge(CacheManager *cache, bool updateHistogram) {
 	if (!this->mergeRequired)
 		return OP_FAIL;
 
-	// struct timespec tstart;
-	// clock_gettime(CLOCK_REALTIME, &tstart);
-
-	// struct timespec tend;
-	// clock_gettime(CLOCK_REALTIME, &tend);
-	// unsigned time = (tend.tv_sec - tstart.tv_sec) * 1000 + (tend.tv_nsec - tstart.tv_nsec) / 1000000;
+	struct timespec mergeStart, phaseStart;
+	clock_gettime(CLOCK_MONOTONIC, &mergeStart);
+	phaseStart = mergeStart;
 
 	this->forwardIndex->merge();
+	this->docValues->merge();
+	this->mergePhaseHistograms.add(MergePhaseHistograms::ForwardIndexPhase, restartPhaseTimer(phaseStart));
 	if (this->forwardIndex->hasDeletedRecords()) {
 		// free the space for deleted records.
-		// need the global lock to block other readers
-		boost::unique_lock<boost::shared_mutex> lock(
-				globalRwMutexForReadersWriters);
-		this->forwardIndex->freeSpaceOfDeletedRecords();
+		// readers may still be using them, so they are only unlinked from the forward index here
+		vector<ForwardList *> freedForwardLists;
+		this->forwardIndex->freeSpaceOfDeletedRecords(freedForwardLists);
+		this->retireForwardLists(freedForwardLists);
+		this->mergePhaseHistograms.add(MergePhaseHistograms::FreeDeletedRecordsPhase, restartPhaseTimer(phaseStart));
 	}
 
 	//if (this->invertedIndex->mergeWorkersCount <= 1) {
@@ -713,6 +873,7 @@ INDEXWRITE_RETVAL IndexData::_merge(CacheManager *cache, bool updateHistogram) {
 	//} else {
 	//	this->invertedIndex->parallelMerge();
 	//}
+	this->mergePhaseHistograms.add(MergePhaseHistograms::InvertedIndexPhase, restartPhaseTimer(phaseStart));
 
 	// Since trie is the entry point of every search, trie merge should be done after all other merges.
 	// If forwardIndex or invertedIndex is merged before trie, then users can see an inconsistent state of
@@ -724,59 +885,69 @@ INDEXWRITE_RETVAL IndexData::_merge(CacheManager *cache, bool updateHistogram) {
 	invertedIndex = this->invertedIndex;
 
 	// check if we need to reassign some keyword ids
-	if (this->trie->needToReassignKeywordIds()) {
-
-		// struct timespec tstart;
-		// clock_gettime(CLOCK_REALTIME, &tstart);
-
-		// reassign id is not thread safe so we need to grab an exclusive lock
+	const bool reassigningKeywordIds = this->trie->needToReassignKeywordIds();
+	if (reassigningKeywordIds) {
+		// Readers are kept out until the read state of this merge is published, since the new ids are
+		// set on trie nodes the current read views share (see excludeReaders()).
 		// NOTE : all index structure commits are happened before reassign id phase. Only QuadTree is left
 		//        because we need new ids in quadTree commit phase.
-
-		boost::unique_lock<boost::shared_mutex> lock(
-				globalRwMutexForReadersWriters);
-
+		this->excludeReaders();
 		this->reassignKeywordIds();
-
-		lock.unlock();
-
-		// struct timespec tend;
-		// clock_gettime(CLOCK_REALTIME, &tend);
-		// unsigned time = (tend.tv_sec - tstart.tv_s ec) * 1000 +
-		// (double) (tend.tv_nsec - tstart.tv_nsec) / (double)1000000L;
-		// Commit phase: time spent to reassign keyword IDs in the forward index (ms): ==>> time
+		this->mergePhaseHistograms.add(MergePhaseHistograms::ReassignKeywordIdsPhase, restartPhaseTimer(phaseStart));
 	}
 
 	this->trie->merge(invertedIndex, this->forwardIndex,
 			this->forwardIndex->getTotalNumberOfForwardLists_ReadView(),
 			updateHistogram);
+	this->mergePhaseHistograms.add(MergePhaseHistograms::TriePhase, restartPhaseTimer(phaseStart));
 
     // If some leaf nodes have an empty inverted list, we need to get rid of them
     if (this->trie->getEmptyLeafNodeIdSize() > 0) {
-        // we need to acquire the global lock to block all other readers and writers
-        // TODO for future optimization: Instead of taking global rw lock.
-        // We could take the same approach as write operation. i.e., copying the
-        // affected TrieNode paths. Let the read view read the old paths
-        // (which will be freed after the last reader)
-        boost::unique_lock<boost::shared_mutex> lock(globalRwMutexForReadersWriters);
+        // The nodes are removed from copies of their paths, as in insertions, and the removed
+        // nodes are freed after the last reader of the current read view.
         this->trie->removeDeletedNodes();
 
-	// since we are deleting trie nodes, we need to clear the cache while
-	// holding the global RW lock.
+	// since we are deleting trie nodes, we need to clear the cache.
+	// The cached active nodes hold the read view they point into, so they stay valid until then.
 	if (cache != NULL)
 	  cache->clear();
+	this->mergePhaseHistograms.add(MergePhaseHistograms::RemoveDeletedTrieNodesPhase, restartPhaseTimer(phaseStart));
     }
 
 	if (this->schemaInternal->getIndexType()
 			== srch2::instantsearch::LocationIndex) {
 		this->quadTree->merge();
+		this->mergePhaseHistograms.add(MergePhaseHistograms::QuadTreePhase, restartPhaseTimer(phaseStart));
 	}
 
+	// readers see the merge from here on
+	this->publishReadState();
+	if (reassigningKeywordIds)
+		this->admitReaders();
+
 	this->mergeRequired = false;
+	this->mergePhaseHistograms.add(MergePhaseHistograms::TotalPhase, restartPhaseTimer(mergeStart));
 
 	return OP_SUCCESS;
 }
 
+void IndexData::retireForwardLists(const vector<ForwardList *> &forwardLists) {
+	for (unsigned i = 0; i < forwardLists.size(); ++i)
+		this->trie->retireWithReadView(boost::shared_ptr<const void>(forwardLists[i]));
+}
+
+void IndexData::excludeReaders() {
+	this->readersExcluded = true;
+	// readers of this index that pinned their epoch before the flag was set may still read the old ids
+	this->readerEpochs.synchronize();
+}
+
+void IndexData::admitReaders() {
+	boost::unique_lock<boost::mutex> lock(this->readersExcludedMutex);
+	this->readersExcluded = false;
+	this->readersAdmitted.notify_all();
+}
+
 /*
  *
  */
@@ -803,8 +974,10 @@ void IndexData::reassignKeywordIds() {
 	// Now we have the ID mapper.  We want to go through the trie nodes one by one.
 	// For each of them, access its inverted list.  For each record,
 	// use the id mapper to change the integers on the forward list.
+	vector<ForwardList *> replacedForwardLists;
 	changeKeywordIdsOnForwardLists(trieNodeIdMapper, keywordIdMapper,
-			processedRecordIds);
+			processedRecordIds, replacedForwardLists);
+	this->retireForwardLists(replacedForwardLists);
 
 	// apply the ID mapper on the keyword ids of empty leaf nodes
 	this->trie->applyKeywordIdMapperOnEmptyLeafNodes(keywordIdMapper);
@@ -818,7 +991,8 @@ void IndexData::reassignKeywordIds() {
 void IndexData::changeKeywordIdsOnForwardLists(
 		const map<TrieNode *, unsigned> &trieNodeIdMapper,
 		const map<unsigned, unsigned> &keywordIdMapper,
-		map<unsigned, unsigned> &processedRecordIds) {
+		map<unsigned, unsigned> &processedRecordIds,
+		vector<ForwardList *> &replacedForwardLists) {
 	vectorview<unsigned>* &keywordIDsWriteView =
 			this->invertedIndex->getKeywordIds()->getWriteView();
 
@@ -835,26 +1009,26 @@ void IndexData::changeKeywordIdsOnForwardLists(
 		// change the keywordId for a given invertedListId. "node" (leafnode) has a new keywordId
 		keywordIDsWriteView->at(invertedListId) = node->getId();
 		// Since it happens after the commit of other index structures it uses read view
-		shared_ptr<vectorview<unsigned> > readview;
+		InvertedListCursor invertedListCursor;
 		shared_ptr<vectorview<InvertedListContainerPtr> > invertedListDirectoryReadView;
 		this->invertedIndex->getInvertedIndexDirectory_ReadView(
 				invertedListDirectoryReadView);
-		this->invertedIndex->getInvertedListReadView(
-				invertedListDirectoryReadView, invertedListId, readview);
-		unsigned invertedListSize = readview->size();
+		this->invertedIndex->getInvertedListCursor(
+				invertedListDirectoryReadView, invertedListId, invertedListCursor);
+		unsigned invertedListSize = invertedListCursor.size();
 		// go through each record id on the inverted list
 		InvertedListElement invertedListElement;
 		for (unsigned i = 0; i < invertedListSize; i++) {
 			/*if (invertedListElement == NULL)
 			 continue;*/
-			unsigned recordId = readview->getElement(i);
+			unsigned recordId = invertedListCursor.getElement(i);
 
 			// re-map it only it is not done before
 			if (processedRecordIds.find(recordId) == processedRecordIds.end()) {
 
 				this->forwardIndex->reassignKeywordIds(
 						forwardListDirectoryReadView, recordId,
-						keywordIdMapper);
+						keywordIdMapper, replacedForwardLists);
 				processedRecordIds[recordId] = 0; // add it to the set
 			}
 		}
@@ -867,16 +1041,18 @@ void IndexData::_exportData(const string &exportedDataFileName) const {
 }
 
 // Caller should call merge and acquire write lock before calling this function.
-void IndexData::_save(CacheManager *cache, const string &directoryName) const {
+bool IndexData::_save(CacheManager *cache, const string &directoryName) const {
 	ASSERT(mergeRequired == false);
 	Serializer serializer;
+	bool saved = true;
 
 	try {
-		serializer.save(*this->forwardIndex,
+		this->forwardIndex->saveSnapshot(
 				directoryName + "/" + IndexConfig::forwardIndexFileName);
 	} catch (exception &ex) {
 		Logger::error("Error writing forward index file: %s/%s",
 				directoryName.c_str(), IndexConfig::forwardIndexFileName);
+		saved = false;
 	}
 
     // ---------- save schema -----------
@@ -886,15 +1062,28 @@ void IndexData::_save(CacheManager *cache, const string &directoryName) const {
 	} catch (exception &ex) {
 		Logger::error("Error writing schema index file: %s/%s",
 				directoryName.c_str(), IndexConfig::schemaFileName);
+		saved = false;
+	}
+
+	// ---------- save doc values -----------
+	try {
+		FlatSnapshotWriter writer(directoryName + "/" + IndexConfig::docValuesFileName);
+		this->docValues->save(writer);
+		writer.finish();
+	} catch (exception &ex) {
+		Logger::error("Error writing doc values file: %s/%s",
+				directoryName.c_str(), IndexConfig::docValuesFileName);
+		saved = false;
 	}
 
 	// ---------- save invertedIndex -----------
 	try {
-		serializer.save(*this->invertedIndex,
+		this->invertedIndex->saveSnapshot(
 				directoryName + "/" + IndexConfig::invertedIndexFileName);
 	} catch (exception &ex) {
 		Logger::error("Error writing inverted index file: %s/%s",
 				directoryName.c_str(), IndexConfig::invertedIndexFileName);
+		saved = false;
 	}
 
     // ---------- save trie -----------
@@ -904,6 +1093,7 @@ void IndexData::_save(CacheManager *cache, const string &directoryName) const {
     } catch (exception &ex) {
         Logger::error("Error writing trie index file: %s/%s",
                 directoryName.c_str(), IndexConfig::trieFileName);
+        saved = false;
         // can keep running - don't rethrow exception
     }
 
@@ -914,6 +1104,7 @@ void IndexData::_save(CacheManager *cache, const string &directoryName) const {
 	} catch (exception &ex) {
 		Logger::error("Error writing quadtree file: %s/%s",
 				directoryName.c_str(), IndexConfig::quadTreeFileName);
+		saved = false;
 	}
 
     // ---------- save index counts file  -----------
@@ -923,6 +1114,7 @@ void IndexData::_save(CacheManager *cache, const string &directoryName) const {
 	} catch (exception &ex) {
 		Logger::error("Error writing index counts file: %s/%s",
 				directoryName.c_str(), IndexConfig::indexCountsFileName);
+		saved = false;
 	}
 
     // ---------- save permissionMap  -----------
@@ -932,6 +1124,7 @@ void IndexData::_save(CacheManager *cache, const string &directoryName) const {
 	} catch (exception &ex) {
 		Logger::error("Error writing permissionMap file: %s/%s",
 				directoryName.c_str(), IndexConfig::permissionMapFileName);
+		saved = false;
 	}
 
     // ---------- save attributeAcl  -----------
@@ -940,7 +1133,13 @@ void IndexData::_save(CacheManager *cache, const string &directoryName) const {
 	} catch (exception &ex) {
 		Logger::error("Error saving access control file: %s/%s", directoryName.c_str(),
 				IndexConfig::AccessControlFile);
+		saved = false;
 	}
+
+	// the files are synced when they are written, the directory makes their creation durable
+	if (saved && !srch2::util::syncParentDir(directoryName + "/" + IndexConfig::schemaFileName))
+		saved = false;
+	return saved;
 }
 
 void IndexData::printNumberOfBytes() const {
@@ -989,11 +1188,17 @@ void IndexData::saveCounts(const std::string &indeDataPathFileName) const {
 	oa << writeCount_tmp;
 	oa << numDocs_tmp;
 	ofs.close();
+	if (!srch2::util::syncFile(indeDataPathFileName))
+		throw std::runtime_error("Error syncing " + indeDataPathFileName);
 }
 
 IndexData::~IndexData() {
+	// the read views are released before the indexes they belong to
+	this->retiredReadStates.clear();
+	delete this->readState;
 	delete this->trie;
 	delete this->forwardIndex;
+	delete this->docValues;
 
 	delete this->invertedIndex;
 	delete this->quadTree;
@@ -1007,6 +1212,55 @@ IndexData::~IndexData() {
 // Adds resource id to some of the role ids.
 // for each role id if it exists in the permission map it will add this resource id to its vector
 // otherwise it adds new record to the map with this role id and then adds this resource id to it.
+MergePhaseHistograms::MergePhaseHistograms() {
+	memset(this->buckets, 0, sizeof(this->buckets));
+	memset(this->counts, 0, sizeof(this->counts));
+	for (unsigned phase = 0; phase < NumberOfPhases; ++phase) {
+		this->totalMilliseconds[phase] = 0;
+		this->maxMilliseconds[phase] = 0;
+	}
+}
+
+void MergePhaseHistograms::add(Phase phase, double milliseconds) {
+	unsigned bucket = 0;
+	while (bucket + 1 < NUMBER_OF_BUCKETS && milliseconds >= (double) (1u << bucket))
+		++bucket;
+	boost::unique_lock<boost::mutex> lock(this->mutex);
+	++this->buckets[phase][bucket];
+	++this->counts[phase];
+	this->totalMilliseconds[phase] += milliseconds;
+	this->maxMilliseconds[phase] = std::max(this->maxMilliseconds[phase], milliseconds);
+}
+
+string MergePhaseHistograms::getJsonString() const {
+	static const char *phaseNames[NumberOfPhases] = { "forward_index", "free_deleted_records",
+			"inverted_index", "reassign_keyword_ids", "trie", "remove_deleted_trie_nodes", "quad_tree",
+			"total" };
+	boost::unique_lock<boost::mutex> lock(this->mutex);
+	std::stringstream str;
+	str << "{";
+	for (unsigned phase = 0; phase < NumberOfPhases; ++phase) {
+		if (phase > 0)
+			str << ",";
+		str << "\"" << phaseNames[phase] << "\":{\"count\":" << this->counts[phase]
+				<< ",\"total_ms\":" << this->totalMilliseconds[phase]
+				<< ",\"max_ms\":" << this->maxMilliseconds[phase] << ",\"histogram_ms\":{";
+		// the key of a bucket is its exclusive upper bound
+		for (unsigned bucket = 0; bucket < NUMBER_OF_BUCKETS; ++bucket) {
+			if (bucket > 0)
+				str << ",";
+			if (bucket + 1 < NUMBER_OF_BUCKETS)
+				str << "\"<" << (1u << bucket) << "\":";
+			else
+				str << "\">=" << (1u << (bucket - 1)) << "\":";
+			str << this->buckets[phase][bucket];
+		}
+		str << "}}";
+	}
+	str << "}";
+	return str.str();
+}
+
 void PermissionMap::appendResourceToRoles(const string &resourceId, vector<string> &roleIds){
 	for(unsigned i = 0 ; i < roleIds.size() ; i++){
 		map<string, vector<string> >::iterator it = permissionMap.find(roleIds[i]);
@@ -75,8 +75,14 @@
 
 #include "index/Trie.h"
 #include "index/ForwardIndex.h"
+#include "index/DocValues.h"
 #include "geo/QuadTree.h"
 #include "util/RankerExpression.h"
+#include "util/EpochManager.h"
+#include "util/ShardedCounter.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include <string>
 #include <vector>
@@ -103,23 +109,22 @@ class ForwardList;
 typedef std::pair<ForwardList*, bool> ForwardListPtr;
 class InvertedListContainer;
 typedef InvertedListContainer* InvertedListContainerPtr;
+class InvertedListCursor;
 
 
 typedef Trie Trie_Internal;
 //{D-1}: Typedef is not used anywhere
 //typedef TrieNode TrieNode_Internal;
 
-struct IndexReadStateSharedPtr_Token
+/*
+ *  The read views of all the index structures, taken together by the writer after the bulk load and
+ *  after every merge (see IndexData::publishReadState()), so a reader always sees the indexes at the
+ *  same merge. Readers reach it through IndexReadStateSharedPtr_Token without locking or changing a
+ *  reference count. The one it replaces is retired and keeps its read views alive until the readers
+ *  that may still use it have exited their epoch (see util/EpochManager.h).
+ */
+struct IndexReadState
 {
-	void init(InvertedIndex * invertedIndex, ForwardIndex * forwardIndex,
-			Trie * trie, QuadTree * quadTree, const Schema * schema){
-		this->invertedIndex = invertedIndex;
-		this->forwardIndex = forwardIndex;
-		this->trie = trie;
-		this->quadTree = quadTree;
-		this->schema = schema;
-	}
-
     typedef boost::shared_ptr<TrieRootNodeAndFreeList > TrieRootNodeSharedPtr;
     TrieRootNodeSharedPtr trieRootNodeSharedPtr;
 
@@ -135,21 +140,46 @@ struct IndexReadStateSharedPtr_Token
     typedef boost::shared_ptr<QuadTreeRootNodeAndFreeLists> QuadTreeRootNodeSharedPtr;
     QuadTreeRootNodeSharedPtr quadTreeRootNodeSharedPtr;
 
+    typedef boost::shared_ptr<const DocValuesReadView> DocValuesReadViewSharedPtr;
+    DocValuesReadViewSharedPtr docValuesReadViewSharedPtr;
+};
+
+struct IndexReadStateSharedPtr_Token
+{
+	void init(InvertedIndex * invertedIndex, ForwardIndex * forwardIndex,
+			Trie * trie, QuadTree * quadTree, const Schema * schema){
+		this->invertedIndex = invertedIndex;
+		this->forwardIndex = forwardIndex;
+		this->trie = trie;
+		this->quadTree = quadTree;
+		this->schema = schema;
+		this->readState = NULL;
+		this->readerSlot = NULL;
+	}
+
     /*
-     * When this method is called all shared pointers are reset meaning
-     * that reader has lost them.
+     * The read views of the indexes, valid from IndexData::getReadView() until release().
+     * A shared pointer copied from it keeps its read view alive after release().
      */
-    void resetSharedPointers(){
-    	trieRootNodeSharedPtr.reset();
-    	forwardIndexReadViewSharedPtr.reset();
-    	invertedIndexReadViewSharedPtr.reset();
-    	invertedIndexKeywordIdsReadViewSharedPtr.reset();
-    	quadTreeRootNodeSharedPtr.reset();
+    IndexReadState *readState;
+
+    /*
+     * When this method is called the reader has lost the read views. It must be called
+     * by the thread that called IndexData::getReadView().
+     */
+    void release(){
+    	if (readerSlot != NULL) {
+    		srch2::util::EpochManager::exit(readerSlot);
+    	}
+    	readState = NULL;
+    	readerSlot = NULL;
     }
 
 
     /////////////////// Inverted Index Access Methods
     void getInvertedListReadView(const unsigned invertedListId, shared_ptr<vectorview<unsigned> >& invertedListReadView) ;
+    // cursor which decodes the compressed read view of the list lazily, see InvertedIndex::getInvertedListCursor()
+    void getInvertedListCursor(const unsigned invertedListId, InvertedListCursor& cursor) ;
 
     // given a forworListId and invertedList offset, return the keyword offset
     unsigned getKeywordOffset(unsigned forwardListId, unsigned invertedListOffset) ;
@@ -186,39 +216,31 @@ private:
     Trie * trie;
     QuadTree * quadTree;
     const Schema * schema;
+    // the slot of the epoch pinned by the reader, NULL if it has no read views
+    srch2::util::EpochManager::ReaderSlot *readerSlot;
 
+    friend class IndexData;
 };
 
-// Uses spinlock and volatile to increment count.
+// Counts the reads. Each reader increments the shard of its epoch slot (see util/EpochManager.h),
+// so readers on different cores do not write to the same cache line.
 class ReadCounter
 {
     public:
-        ReadCounter(uint64_t counter = 0)
-        {
-            pthread_spin_init(&m_spinlock, 0);
-            this->counter = counter;
-        }
-        
-        ~ReadCounter()
-        {
-            pthread_spin_destroy(&m_spinlock);
-        }
-                
-        void increment()
+        ReadCounter(uint64_t counter = 0): counter(counter) {}
+
+        void increment(unsigned shardIndex)
         {
-            pthread_spin_lock(&m_spinlock);
-            ++this->counter;
-            pthread_spin_unlock(&m_spinlock);   
+            this->counter.addToShard(shardIndex, 1);
         }
-    
+
         uint64_t getCount() const
         {
-            return counter;
+            return this->counter.get();
         }
-            
+
     private:
-        volatile uint64_t counter;
-        mutable pthread_spinlock_t m_spinlock;
+        srch2::util::ShardedCounter counter;
 };
 
 // Assumes the calls to increment are write safe. The caller hold a write lock.
@@ -268,6 +290,41 @@ class WriteCounter
         uint32_t numberOfDocumentsIndex;
 };
 
+// Latency histograms of the phases of IndexData::_merge(), reported by IndexReaderWriter::getIndexHealth().
+// Bucket i counts the merges whose phase took less than 2^i milliseconds, and the last bucket counts
+// the slower ones. The merge thread adds to them while the health requests read them, so they are
+// guarded by a mutex.
+class MergePhaseHistograms
+{
+    public:
+        enum Phase {
+            ForwardIndexPhase,
+            FreeDeletedRecordsPhase,
+            InvertedIndexPhase,
+            ReassignKeywordIdsPhase,
+            TriePhase,
+            RemoveDeletedTrieNodesPhase,
+            QuadTreePhase,
+            TotalPhase,
+            NumberOfPhases
+        };
+        static const unsigned NUMBER_OF_BUCKETS = 16;
+
+        MergePhaseHistograms();
+
+        void add(Phase phase, double milliseconds);
+
+        // a JSON object with the count, total, maximum and histogram of each phase
+        std::string getJsonString() const;
+
+    private:
+        mutable boost::mutex mutex;
+        uint64_t buckets[NumberOfPhases][NUMBER_OF_BUCKETS];
+        uint64_t counts[NumberOfPhases];
+        double totalMilliseconds[NumberOfPhases];
+        double maxMilliseconds[NumberOfPhases];
+};
+
 // we use this permission map for deleting a role core. then we can delete this role id from resources' access list
 // we don't need to use lock for permission map because only writers use this data and the engine makes
 // sure only one writer can access the indexes at any time.
@@ -332,16 +389,41 @@ private:
     
     ReadCounter *readCounter;
     WriteCounter *writeCounter;    
+    MergePhaseHistograms mergePhaseHistograms;
+
+    // the read views of the last bulk load or merge, replaced by publishReadState(). NULL before the bulk load.
+    IndexReadState * volatile readState;
+    // the epochs of the readers of this index only, so a merge never waits for the readers of another one
+    srch2::util::EpochManager readerEpochs;
+    // the replaced read states, used by the writer only
+    srch2::util::EpochRetireList retiredReadStates;
+    // Set by the writer while a merge reassigns keyword ids in place, until it published its read state.
+    // Readers that come meanwhile wait in getReadView().
+    volatile bool readersExcluded;
+    boost::mutex readersExcludedMutex;
+    boost::condition_variable readersAdmitted;
 
     
     /**
      * Internal functions
      */
+    // Takes the read views of all the indexes and publishes them to the readers that come next.
+    // Called by the writer after the read views changed.
+    void publishReadState();
+
     void loadCounts(const std::string &indeDataPathFileName);
     void saveCounts(const std::string &indeDataPathFileName) const;
 
     // This function is called when a necessary lock is already acquired (in M1) or no lock is acquired (in A1).
     INDEXWRITE_RETVAL _addRecordWithoutLock(const Record *record, Analyzer *analyzer);
+    INDEXWRITE_RETVAL _addAnalyzedRecordWithoutLock(const Record *record,
+    		std::map<string, TokenAttributeHits> &tokenAttributeHitsMap);
+
+    // one task of the parallel commit in finishBulkLoad()
+    void commitForwardLists(unsigned begin, unsigned end, RankerExpression *rankerExpression,
+    		const unsigned totalNumberOfDocuments, const std::map<unsigned, unsigned> &oldIdToNewIdMapper,
+    		std::vector<ForwardList *> *forwardLists,
+    		std::vector<std::vector<NewKeywordIdKeywordOffsetTriple> > *newKeywordIdKeywordOffsetTriples) const;
 public:
     
     inline static IndexData* create(const string& directoryName,
@@ -363,6 +445,8 @@ public:
     QuadTree *quadTree;
 
     ForwardIndex *forwardIndex;
+    // columnar copy of the refining attributes of the forward lists
+    DocValues *docValues;
     SchemaInternal *schemaInternal;
     
     AttributeAccessControl *attributeAcl;
@@ -374,11 +458,11 @@ public:
     // Notice that this map is only used by a writer, and it is never used by a reader. So concurrency control is simple.
     PermissionMap* permissionMap;
 
-    // a global RW lock for readers and writers;
-    // Used in several places, such as KeywordIdReassign and memory
-    // recollection for deleted records
-    mutable boost::shared_mutex globalRwMutexForReadersWriters;
-    
+    // Merges do not block readers. The objects a merge unlinks while readers may still use them
+    // (the forward lists of deleted records, the forward lists replaced when keyword ids are
+    // reassigned, the cowvectors of the merged inverted lists and the removed trie nodes) are freed
+    // with the trie read views, after the last reader that may reach them (see Trie::retireWithReadView()).
+
 
     inline bool isMergeRequired() const{
     	return mergeRequired;
@@ -386,11 +470,16 @@ public:
 
     virtual ~IndexData();
 
+    // Pins an epoch and gives the reader the current read views, until readToken.release()
     void getReadView(IndexReadStateSharedPtr_Token &readToken);
     void initializeIndexReadTokenHolder(IndexReadStateSharedPtr_Token & token) const;
 
     // add a record
     INDEXWRITE_RETVAL _addRecord(const Record *record, Analyzer *analyzer);
+
+    // add a record whose tokens were already computed by Analyzer::tokenizeRecord(), e.g., by another thread
+    INDEXWRITE_RETVAL _addAnalyzedRecord(const Record *record,
+    		std::map<string, TokenAttributeHits> &tokenAttributeHitsMap);
     
     // Edit role ids of a record's access list based on command type
     INDEXWRITE_RETVAL _aclModifyRecordAccessList(const std::string& resourcePrimaryKeyID, vector<string> &roleIds, RecordAclCommandType commandType);
@@ -403,6 +492,7 @@ public:
     inline uint64_t _getReadCount() const { return this->readCounter->getCount(); }
     inline uint32_t _getWriteCount() const { return this->writeCounter->getCount(); }
     inline uint32_t _getNumberOfDocumentsInIndex() const { return this->writeCounter->getNumberOfDocuments(); }
+    inline const MergePhaseHistograms &getMergePhaseHistograms() const { return this->mergePhaseHistograms; }
     
     // merge the index
     INDEXWRITE_RETVAL _merge(CacheManager *cache, bool updateHistogram);
@@ -425,9 +515,10 @@ public:
 
     void _exportData(const string& exportedDataFileName) const;
 
-    void _save(CacheManager *cache) const { this->_save(cache, this->directoryName); }
+    // returns false if an index file could not be written or synced to the disk
+    bool _save(CacheManager *cache) const { return this->_save(cache, this->directoryName); }
 
-    void _save(CacheManager *cache, const std::string &directoryName) const;
+    bool _save(CacheManager *cache, const std::string &directoryName) const;
     
     const Schema* getSchema() const;
 
@@ -437,15 +528,26 @@ public:
 
     StoredRecordBuffer getInMemoryData(unsigned internalRecordId) const
     {
+        // The caller may not hold the read views, so the trie read view is held while the
+        // forward list is used in case a merge retires it.
+        boost::shared_ptr<TrieRootNodeAndFreeList> trieRootNodeReadView;
+        this->trie->getTrieRootNode_ReadView(trieRootNodeReadView);
         return this->forwardIndex->getInMemoryData(internalRecordId);
     }
 
     void printNumberOfBytes() const;
 
+    // The reassignment changes the ids of trie nodes that the read views share and replaces forward
+    // lists one at a time, so readers are kept out from excludeReaders() until admitReaders().
+    void excludeReaders();
+    void admitReaders();
     void reassignKeywordIds();
     void changeKeywordIdsOnForwardLists(const map<TrieNode *, unsigned> &trieNodeIdMapper,
                                         const map<unsigned, unsigned> &keywordIdMapper,
-                                        map<unsigned, unsigned> &processedRecordIds);
+                                        map<unsigned, unsigned> &processedRecordIds,
+                                        vector<ForwardList *> &replacedForwardLists);
+    // frees the forward lists after the readers of the current trie read view are gone
+    void retireForwardLists(const vector<ForwardList *> &forwardLists);
 };
 
 }}
@@ -27,6 +27,8 @@
 
 
 #include "operation/IndexerInternal.h"
+#include "operation/CacheManager.h"
+#include "operation/AttributeAccessControl.h"
 #include "util/Logger.h"
 
 namespace srch2
@@ -76,6 +78,47 @@ INDEXWRITE_RETVAL IndexReaderWriter::addRecord(const Record *record, Analyzer* a
     return returnValue;
 }
 
+INDEXWRITE_RETVAL IndexReaderWriter::addAnalyzedRecord(const Record *record,
+        std::map<std::string, TokenAttributeHits> &tokenAttributeHitsMap)
+{
+    pthread_mutex_lock(&lockForWriters);
+    INDEXWRITE_RETVAL returnValue = this->index->_addAnalyzedRecord(record, tokenAttributeHitsMap);
+    if (returnValue == OP_SUCCESS) {
+    	this->writesCounterForMerge++;
+    	this->needToSaveIndexes = true;
+    	if (this->mergeThreadStarted && writesCounterForMerge >= mergeEveryMWrites) {
+        pthread_cond_signal(&countThresholdConditionVariable);
+    	}
+    }
+
+    pthread_mutex_unlock(&lockForWriters);
+    return returnValue;
+}
+
+void IndexReaderWriter::addAnalyzedRecords(const std::vector<const Record *> &records,
+        std::vector<std::map<std::string, TokenAttributeHits> > &tokenAttributeHitsMaps,
+        std::vector<INDEXWRITE_RETVAL> &returnValues)
+{
+    returnValues.resize(records.size());
+    pthread_mutex_lock(&lockForWriters);
+    unsigned numberOfAddedRecords = 0;
+    for (unsigned i = 0; i < records.size(); ++i) {
+        returnValues[i] = this->index->_addAnalyzedRecord(records[i], tokenAttributeHitsMaps[i]);
+        if (returnValues[i] == OP_SUCCESS) {
+            ++numberOfAddedRecords;
+        }
+    }
+    if (numberOfAddedRecords > 0) {
+    	this->writesCounterForMerge += numberOfAddedRecords;
+    	this->needToSaveIndexes = true;
+    	if (this->mergeThreadStarted && writesCounterForMerge >= mergeEveryMWrites) {
+        pthread_cond_signal(&countThresholdConditionVariable);
+    	}
+    }
+
+    pthread_mutex_unlock(&lockForWriters);
+}
+
 INDEXWRITE_RETVAL IndexReaderWriter::aclRecordModifyRoles(const std::string &resourcePrimaryKeyID, vector<string> &roleIds, RecordAclCommandType commandType)
 {
 	pthread_mutex_lock(&lockForWriters);
@@ -86,7 +129,7 @@ INDEXWRITE_RETVAL IndexReaderWriter::aclRecordModifyRoles(const std::string &res
 	// So we need to clear the cache.
 	if(returnValue == OP_SUCCESS){
 	    if (this->cache != NULL)
-	        this->cache->clear();
+	        this->cache->clearResults();
 	    this->needToSaveIndexes = true;
 	}
 
@@ -101,7 +144,7 @@ INDEXWRITE_RETVAL IndexReaderWriter::deleteRoleRecord(const std::string &rolePri
 
 	if(returnValue == OP_SUCCESS){
 		if (this->cache != NULL)
-			this->cache->clear();
+			this->cache->clearResults();
 		this->needToSaveIndexes = true;
 	}
 
@@ -193,15 +236,35 @@ void IndexReaderWriter::exportData(const string &exportedDataFileName)
     pthread_mutex_unlock(&lockForWriters);
 }
 
-void IndexReaderWriter::save()
+const string IndexReaderWriter::getIndexHealth() const
+{
+    std::stringstream str;
+    str << "{\"engine_status\":{";
+    str << "\"search_requests\":\"" << this->index->_getReadCount() << "\",";
+    str << "\"write_requests\":\"" <<  this->index->_getWriteCount() << "\",";
+    str << "\"docs_in_index\":\"" << this->index->_getNumberOfDocumentsInIndex() << "\",";
+    str << this->indexHealthInfo.getIndexHealthString();
+    str << ",\"merge_phases\":" << this->index->getMergePhaseHistograms().getJsonString();
+    str << ",\"queries\":" << this->queryStatistics.getJsonString();
+    if (this->cache != NULL) {
+        str << ",\"cache\":{" << this->cache->getCacheStatisticsString() << "}";
+    }
+    str << "}}";
+    return str.str();
+}
+
+INDEXWRITE_RETVAL IndexReaderWriter::save()
 {
     pthread_mutex_lock(&lockForWriters);
 
     // If no insert/delete/update is performed, we don't need to save.
+    // Attribute acl changes do not go through the writers, so they are tracked separately.
     bool needToSaveFeedbackIndex = userFeedbackIndex->getSaveIndexFlag();
+    if (this->index->attributeAcl->isModifiedSinceLastSave())
+        this->needToSaveIndexes = true;
     if(this->needToSaveIndexes == false && needToSaveFeedbackIndex == false){
       pthread_mutex_unlock(&lockForWriters);
-    	return;
+    	return OP_SUCCESS;
     }
 
     // we don't have to update histogram information when we want to export.
@@ -209,8 +272,14 @@ void IndexReaderWriter::save()
     writesCounterForMerge = 0;
 
     srch2::util::Logger::console("Saving Indexes ...");
-    if (this->needToSaveIndexes)
-    	this->index->_save(this->cache);
+    if (this->needToSaveIndexes) {
+    	if (!this->index->_save(this->cache)) {
+    		// keep the flags set, so the next save writes the indexes again
+    		pthread_mutex_unlock(&lockForWriters);
+    		return OP_FAIL;
+    	}
+    	this->index->attributeAcl->markSaved();
+    }
     if (needToSaveFeedbackIndex)
     	this->userFeedbackIndex->save(indexDirectoryName);
 
@@ -222,9 +291,10 @@ void IndexReaderWriter::save()
     userFeedbackIndex->setSaveIndexFlag(false);
 
     pthread_mutex_unlock(&lockForWriters);
+    return OP_SUCCESS;
 }
 
-void IndexReaderWriter::save(const std::string& directoryName)
+INDEXWRITE_RETVAL IndexReaderWriter::save(const std::string& directoryName)
 {
     pthread_mutex_lock(&lockForWriters);
 
@@ -232,9 +302,10 @@ void IndexReaderWriter::save(const std::string& directoryName)
     this->merge(false);
     writesCounterForMerge = 0;
 
-    this->index->_save(this->cache, directoryName);
+    bool saved = this->index->_save(this->cache, directoryName);
 
     pthread_mutex_unlock(&lockForWriters);
+    return saved ? OP_SUCCESS : OP_FAIL;
 }
 
 /*
@@ -244,8 +315,10 @@ void IndexReaderWriter::save(const std::string& directoryName)
 
 INDEXWRITE_RETVAL IndexReaderWriter::merge(bool updateHistogram)
 {
+    // The cached active nodes stay valid if the merge does not change the trie nodes
     if (this->cache != NULL && this->index->isMergeRequired())
-        this->cache->clear();
+        this->cache->clearResults();
+    unsigned long trieVersion = getTrieVersion();
 
     // increment the mergeCounterForUpdatingHistogram
     this->mergeCounterForUpdatingHistogram ++;
@@ -256,6 +329,8 @@ INDEXWRITE_RETVAL IndexReaderWriter::merge(bool updateHistogram)
     this->userFeedbackIndex->merge();
 
     INDEXWRITE_RETVAL returnValue = this->index->_merge(this->cache, updateHistogram);
+    if (this->cache != NULL && getTrieVersion() != trieVersion)
+        this->cache->getActiveNodesCache()->clear();
 
     struct timespec tend;
     clock_gettime(CLOCK_REALTIME, &tend);
@@ -265,6 +340,13 @@ INDEXWRITE_RETVAL IndexReaderWriter::merge(bool updateHistogram)
     return returnValue;
 }
 
+unsigned long IndexReaderWriter::getTrieVersion() const
+{
+    boost::shared_ptr<TrieRootNodeAndFreeList> trieRootNode_ReadView;
+    this->index->trie->getTrieRootNode_ReadView(trieRootNode_ReadView);
+    return trieRootNode_ReadView->getVersion();
+}
+
 void * dispatchMergeThread(void *indexer) {
 	(reinterpret_cast <IndexReaderWriter *>(indexer))->startMergeThreadLoop();
 	pthread_exit(0);
@@ -340,7 +422,7 @@ void * dispatchMergeWorkerThread(void *arg) {
 	pthread_mutex_lock(&info->perThreadMutex);
 	// Atomically set the flag to True
 	// Details: https://gcc.gnu.org/onlinedocs/gcc-4.1.2/gcc/Atomic-Builtins.html
-	__sync_or_and_fetch(&info->workerReady, true); 
+	__atomic_store_n(&info->workerReady, true, __ATOMIC_SEQ_CST);
 
 	//  Note: swap part is redundant ( There is no atomic compare only API from gcc)
 	//  Details: https://gcc.gnu.org/onlinedocs/gcc-4.1.2/gcc/Atomic-Builtins.html
@@ -353,7 +435,7 @@ void * dispatchMergeWorkerThread(void *arg) {
 			unsigned processedCount  = index->invertedIndex->workerMergeTask(index->rankerExpression,
 						index->_getNumberOfDocumentsInIndex(), index->schemaInternal, index->trie);
 
-			__sync_and_and_fetch(&info->isDataReady, false); // set the flag to false atomically.
+			__atomic_store_n(&info->isDataReady, false, __ATOMIC_SEQ_CST); // set the flag to false atomically.
 
 			// acquire the lock to make sure that main merge thread is waiting for this condition.
 			// When the main thread is waiting on the condition then this lock is in unlocked state
@@ -32,6 +32,7 @@
 #include <instantsearch/Indexer.h>
 #include "operation/CacheManager.h"
 #include "operation/IndexData.h"
+#include "operation/QueryStatistics.h"
 #include <string>
 #include <sstream>
 #include <vector>
@@ -126,6 +127,13 @@ public:
      */
     INDEXWRITE_RETVAL addRecord(const Record *record, Analyzer *analyzer);
 
+    INDEXWRITE_RETVAL addAnalyzedRecord(const Record *record,
+            std::map<std::string, TokenAttributeHits> &tokenAttributeHitsMap);
+
+    void addAnalyzedRecords(const std::vector<const Record *> &records,
+            std::vector<std::map<std::string, TokenAttributeHits> > &tokenAttributeHitsMaps,
+            std::vector<INDEXWRITE_RETVAL> &returnValues);
+
     // Edits the records access list base on the command type
     INDEXWRITE_RETVAL aclRecordModifyRoles(const std::string &resourcePrimaryKeyID, vector<string> &roleIds, RecordAclCommandType commandType);
 
@@ -160,33 +168,28 @@ public:
 
     inline const void readerPreEnter(IndexReadStateSharedPtr_Token &readToken)
     {
-    	// acquiring the global lock of readers and writers.
-    	// NOTE: readerPreExit will unlock this call when invoked.
-    	this->index->globalRwMutexForReadersWriters.lock_shared();
-    	// Getting the protector copy of readview shared pointers.
-    	// NOTE: These readview shared pointers are gone when the readToken
-    	// gets destroyed.
+    	// Pins an epoch of the calling thread and gets the read views of the last merge.
+    	// NOTE: They are not freed before readerPreExit() is called.
         this->index->getReadView(readToken);
     }
 
     inline const void readerPreExit(IndexReadStateSharedPtr_Token &readToken)
     {
     	/*
-    	 * readToken is released here. This object maintains the
-    	 * guard copy of readview of all four indexes: Trie, II, FI, and QT.
-    	 * As long as these shared pointer copies are not reset, readview copies
+    	 * readToken is released here. This object points to the
+    	 * readviews of all the indexes: Trie, II, FI, DV and QT.
+    	 * As long as its epoch is not exited, readviews retired by merges
     	 * are not deallocated.
     	 * As of now, there is one readToken in the system which is
     	 * a member of QueryEvaluatorInternal. In main search/suggest query
     	 * execution process QueryEvaluator is constructed and deleted per query.
     	 * However one query evaluator object is used for multiple interactions with core
     	 * (query/insertions/deletions). This is why we can't use constructor/destructor
-    	 * (which are nice locations) for storing/releasing the readviews.
+    	 * (which are nice locations) for storing/releasing the readviews. The destructor
+    	 * of QueryEvaluatorInternal only releases a token that was left pinned.
     	 */
-    	readToken.resetSharedPointers();
-    	// Releasing the global lock of readers and writers.
-    	this->index->globalRwMutexForReadersWriters.unlock_shared();
-    	// Readviews will be erased when readToken is destructed.
+    	readToken.release();
+    	// Readviews will be erased after the next merges.
     }
 
     inline const srch2::instantsearch::Schema *getSchema() const
@@ -209,24 +212,20 @@ public:
     }
     void exportData(const string &exportedDataFileName);
 
-    void save();
+    INDEXWRITE_RETVAL save();
 
-    void save(const std::string& directoryName);
+    INDEXWRITE_RETVAL save(const std::string& directoryName);
 
     inline GlobalCache *getCache()
     {
         return this->cache;
     }
 
-    inline const string getIndexHealth() const
+    const string getIndexHealth() const;
+
+    inline QueryStatistics *getQueryStatistics()
     {
-        std::stringstream str;
-        str << "{\"engine_status\":{";
-        str << "\"search_requests\":\"" << this->index->_getReadCount() << "\",";
-        str << "\"write_requests\":\"" <<  this->index->_getWriteCount() << "\",";
-        str << "\"docs_in_index\":\"" << this->index->_getNumberOfDocumentsInIndex() << "\",";
-        str << this->indexHealthInfo.getIndexHealthString() << "}}";
-        return str.str();
+        return &this->queryStatistics;
     }
     
     inline const bool isCommited() const { return this->index->isBulkLoadDone(); }
@@ -260,6 +259,14 @@ public:
 
     inline ForwardIndex * getForwardIndex() const { return this->index->forwardIndex; }
 
+    // Readers that use the forward index without a read token hold the trie read view meanwhile,
+    // so that a merge does not free the forward lists they use.
+    boost::shared_ptr<TrieRootNodeAndFreeList> getTrie_ReadView() const {
+    	boost::shared_ptr<TrieRootNodeAndFreeList> trieRootNodeAndFreeList;
+    	this->index->trie->getTrieRootNode_ReadView(trieRootNodeAndFreeList);
+    	return trieRootNodeAndFreeList;
+    }
+
     pthread_t createAndStartMergeThreadLoop();
 
     void createAndStartMergeWorkerThreads();
@@ -272,6 +279,7 @@ private:
     CacheManager *cache;
 
     IndexHealthInfo indexHealthInfo;
+    QueryStatistics queryStatistics;
 
     pthread_cond_t countThresholdConditionVariable;
     volatile bool mergeThreadStarted;
@@ -293,6 +301,8 @@ private:
 
     INDEXWRITE_RETVAL merge(bool updateHistogram);
     void doMerge();
+    // the version of the current read view of the trie
+    unsigned long getTrieVersion() const;
 
 };
 
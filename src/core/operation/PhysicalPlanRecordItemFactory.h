@@ -28,11 +28,12 @@
 #ifndef __PHYSICALPLANRECORDITEMFACTORY_H__
 #define __PHYSICALPLANRECORDITEMFACTORY_H__
 
-#define INITIAL_NUMBER_OF_RECORD_ITEMS_IN_A_GROUP 10000
-
 #include "util/Assert.h"
+#include "util/Arena.h"
 
 #include <map>
+#include <new>
+#include <algorithm>
 #include <boost/unordered_set.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
@@ -72,28 +73,33 @@ public:
 		return this->recordRuntimeScore;
 	}
 	inline void getRecordMatchingPrefixes(vector<TrieNodePointer> & matchingPrefixes) const{
-		matchingPrefixes.insert(matchingPrefixes.end(),this->matchingPrefixes.begin(),this->matchingPrefixes.end());
+		matchingPrefixes.insert(matchingPrefixes.end(),this->matchingPrefixes,this->matchingPrefixes + this->numberOfMatchingPrefixes);
 	}
 	inline void getRecordMatchEditDistances(vector<unsigned> & editDistances) const{
-		editDistances.insert(editDistances.end(),this->editDistances.begin(),this->editDistances.end());
+		editDistances.insert(editDistances.end(),this->editDistances,this->editDistances + this->numberOfEditDistances);
 	}
 	inline void getRecordMatchAttributeBitmaps(vector<vector<unsigned> > & attributeIdsList) const{
-		for (unsigned i = 0; i < this->attributeIdsList.size(); ++i) {
+		for (unsigned i = 0; i < this->numberOfAttributeIdsLists; ++i) {
 			attributeIdsList.push_back(vector<unsigned>());
-			attributeIdsList.back().assign(this->attributeIdsList[i].begin(), this->attributeIdsList[i].end());
+			attributeIdsList.back().assign(this->attributeIds + this->attributeIdsListOffsets[i],
+					this->attributeIds + this->attributeIdsListOffsets[i + 1]);
 		}
 	}
 	inline void getPositionIndexOffsets(vector<unsigned> & positionIndexOffsets)const {
-		positionIndexOffsets.insert(positionIndexOffsets.end(),this->positionIndexOffsets.begin(),this->positionIndexOffsets.end());
+		positionIndexOffsets.insert(positionIndexOffsets.end(),this->positionIndexOffsets,this->positionIndexOffsets + this->numberOfPositionIndexOffsets);
 	}
 	inline void getTermTypes(vector<TermType> & rTermTypes) const {
-		rTermTypes.insert(rTermTypes.end(),this->termTypes.begin(),this->termTypes.end());
+		rTermTypes.insert(rTermTypes.end(),this->termTypes,this->termTypes + this->numberOfTermTypes);
 	}
 	inline bool getIsGeo(){
 		return this->geoFlag;
 	}
-	vector<TermType> & getTermTypesRef(){
-		return termTypes;
+	// the term types can be changed in place through this array
+	inline TermType * getTermTypesArray(){
+		return this->termTypes;
+	}
+	inline unsigned getNumberOfTermTypes() const{
+		return this->numberOfTermTypes;
 	}
 
 	// setters
@@ -107,49 +113,100 @@ public:
 		this->recordRuntimeScore = runtimeScore;
 	}
 	inline void setRecordMatchingPrefixes(const vector<TrieNodePointer> & matchingPrefixes) {
-		this->matchingPrefixes = matchingPrefixes;
+		assignArray(this->matchingPrefixes, this->numberOfMatchingPrefixes,
+				matchingPrefixes.empty() ? NULL : &matchingPrefixes[0], matchingPrefixes.size());
 	}
 	inline void setRecordMatchEditDistances(const vector<unsigned> & editDistances) {
-		this->editDistances = editDistances;
+		assignArray(this->editDistances, this->numberOfEditDistances,
+				editDistances.empty() ? NULL : &editDistances[0], editDistances.size());
 	}
 	inline void setRecordMatchAttributeBitmaps(const vector<vector<unsigned> > & attributeIdsList) {
-		this->attributeIdsList = attributeIdsList;
+		releaseArray(this->attributeIdsListOffsets);
+		releaseArray(this->attributeIds);
+		this->numberOfAttributeIdsLists = attributeIdsList.size();
+		this->attributeIdsListOffsets = allocateArray<unsigned>(attributeIdsList.size() + 1);
+		unsigned numberOfAttributeIds = 0;
+		this->attributeIdsListOffsets[0] = 0;
+		for (unsigned i = 0; i < attributeIdsList.size(); ++i) {
+			numberOfAttributeIds += attributeIdsList[i].size();
+			this->attributeIdsListOffsets[i + 1] = numberOfAttributeIds;
+		}
+		this->attributeIds = allocateArray<unsigned>(numberOfAttributeIds);
+		for (unsigned i = 0; i < attributeIdsList.size(); ++i) {
+			std::copy(attributeIdsList[i].begin(), attributeIdsList[i].end(),
+					this->attributeIds + this->attributeIdsListOffsets[i]);
+		}
 	}
 	inline void setPositionIndexOffsets(const vector<unsigned> & positionIndexOffsets){
-		this->positionIndexOffsets = positionIndexOffsets;
+		assignArray(this->positionIndexOffsets, this->numberOfPositionIndexOffsets,
+				positionIndexOffsets.empty() ? NULL : &positionIndexOffsets[0], positionIndexOffsets.size());
 	}
 	inline void setTermTypes(const vector<TermType> & rTermType){
-		this->termTypes = rTermType;
+		assignArray(this->termTypes, this->numberOfTermTypes,
+				rTermType.empty() ? NULL : &rTermType[0], rTermType.size());
+		this->termTypesCapacity = this->numberOfTermTypes;
 	}
 	inline void setIsGeo(bool isGeoFlag){
 		this->geoFlag = isGeoFlag;
 	}
 	inline void addTermType(const TermType & rTermType){
-		this->termTypes.push_back(rTermType);
+		if (this->numberOfTermTypes == this->termTypesCapacity) {
+			unsigned newCapacity = this->termTypesCapacity == 0 ? 2 : this->termTypesCapacity * 2;
+			TermType * newTermTypes = allocateArray<TermType>(newCapacity);
+			std::copy(this->termTypes, this->termTypes + this->numberOfTermTypes, newTermTypes);
+			releaseArray(this->termTypes);
+			this->termTypes = newTermTypes;
+			this->termTypesCapacity = newCapacity;
+		}
+		this->termTypes[this->numberOfTermTypes++] = rTermType;
+	}
+
+	// copies the fields which are kept when an item is cloned
+	void copyMatchingInfo(const PhysicalPlanRecordItem & oldObj){
+		this->recordId = oldObj.recordId;
+		this->recordRuntimeScore = oldObj.recordRuntimeScore;
+		assignArray(this->matchingPrefixes, this->numberOfMatchingPrefixes,
+				oldObj.matchingPrefixes, oldObj.numberOfMatchingPrefixes);
+		assignArray(this->editDistances, this->numberOfEditDistances,
+				oldObj.editDistances, oldObj.numberOfEditDistances);
+		releaseArray(this->attributeIdsListOffsets);
+		releaseArray(this->attributeIds);
+		this->numberOfAttributeIdsLists = oldObj.numberOfAttributeIdsLists;
+		this->attributeIdsListOffsets = NULL;
+		this->attributeIds = NULL;
+		if (oldObj.attributeIdsListOffsets != NULL) {
+			unsigned numberOfAttributeIds = oldObj.attributeIdsListOffsets[oldObj.numberOfAttributeIdsLists];
+			this->attributeIdsListOffsets = allocateArray<unsigned>(oldObj.numberOfAttributeIdsLists + 1);
+			std::copy(oldObj.attributeIdsListOffsets,
+					oldObj.attributeIdsListOffsets + oldObj.numberOfAttributeIdsLists + 1, this->attributeIdsListOffsets);
+			this->attributeIds = allocateArray<unsigned>(numberOfAttributeIds);
+			std::copy(oldObj.attributeIds, oldObj.attributeIds + numberOfAttributeIds, this->attributeIds);
+		}
+		assignArray(this->positionIndexOffsets, this->numberOfPositionIndexOffsets,
+				oldObj.positionIndexOffsets, oldObj.numberOfPositionIndexOffsets);
+		assignArray(this->termTypes, this->numberOfTermTypes, oldObj.termTypes, oldObj.numberOfTermTypes);
+		this->termTypesCapacity = this->numberOfTermTypes;
 	}
+
     unsigned getNumberOfBytes(){
     	unsigned totalNumberOfBytes = sizeof(PhysicalPlanRecordItem);
 
     	//matchingPrefixes
-    	totalNumberOfBytes += matchingPrefixes.capacity() * sizeof(TrieNodePointer);
+    	totalNumberOfBytes += numberOfMatchingPrefixes * sizeof(TrieNodePointer);
     	// no need to loop over matching prefixes because TrieNodes are not considered in cache byte usage
 
     	// editDistance
-    	totalNumberOfBytes += editDistances.capacity() * sizeof(unsigned);
-    	// no need to loop over vector
+    	totalNumberOfBytes += numberOfEditDistances * sizeof(unsigned);
 
     	// attributeBitmaps
-    	for (unsigned i = 0; i < attributeIdsList.size(); ++i)
-    		totalNumberOfBytes += attributeIdsList[i].capacity() * sizeof(unsigned);
-    	totalNumberOfBytes += attributeIdsList.capacity() * sizeof(void *);
+    	if (attributeIdsListOffsets != NULL)
+    		totalNumberOfBytes += (numberOfAttributeIdsLists + 1 + attributeIdsListOffsets[numberOfAttributeIdsLists]) * sizeof(unsigned);
 
     	// positionIndexOffsets
-    	totalNumberOfBytes += positionIndexOffsets.capacity() * sizeof(unsigned);
-    	// no need to loop over vector
+    	totalNumberOfBytes += numberOfPositionIndexOffsets * sizeof(unsigned);
 
     	// term types
-    	totalNumberOfBytes += termTypes.capacity() * sizeof(TermType);
-    	// no need to loop over vector
+    	totalNumberOfBytes += termTypesCapacity * sizeof(TermType);
 
     	// valuesOfParticipatingRefiningAttributes
     	for(std::map<std::string,TypedValue>::iterator mapItr = valuesOfParticipatingRefiningAttributes.begin();
@@ -164,72 +221,122 @@ public:
 
     void clear(){
     	valuesOfParticipatingRefiningAttributes.clear();
-    	matchingPrefixes.clear();
-    	editDistances.clear();
-    	attributeIdsList.clear();
-    	positionIndexOffsets.clear();
-    	termTypes.clear();
+    	releaseArray(matchingPrefixes);
+    	releaseArray(editDistances);
+    	releaseArray(attributeIdsListOffsets);
+    	releaseArray(attributeIds);
+    	releaseArray(positionIndexOffsets);
+    	releaseArray(termTypes);
+    	initArrays();
     }
 
-    PhysicalPlanRecordItem(){
+    /*
+     * The variable-length arrays of an item are allocated in arena, which frees them when the
+     * query is done. Items without an arena (e.g. the copies kept in the cache) allocate them
+     * on the heap.
+     */
+    explicit PhysicalPlanRecordItem(srch2::util::Arena * arena = NULL){
+    	this->arena = arena;
     	this->geoFlag = false;
+    	initArrays();
     };
 
-	~PhysicalPlanRecordItem(){};
+	~PhysicalPlanRecordItem(){
+		if (arena == NULL) {
+			clear();
+		}
+	};
 
     std::map<std::string,TypedValue> valuesOfParticipatingRefiningAttributes;
 private:
+    void initArrays(){
+    	matchingPrefixes = NULL;
+    	numberOfMatchingPrefixes = 0;
+    	editDistances = NULL;
+    	numberOfEditDistances = 0;
+    	attributeIdsListOffsets = NULL;
+    	attributeIds = NULL;
+    	numberOfAttributeIdsLists = 0;
+    	positionIndexOffsets = NULL;
+    	numberOfPositionIndexOffsets = 0;
+    	termTypes = NULL;
+    	numberOfTermTypes = 0;
+    	termTypesCapacity = 0;
+    }
+
+    template <class T>
+    T * allocateArray(unsigned n){
+    	if (n == 0) {
+    		return NULL;
+    	}
+    	if (arena != NULL) {
+    		return arena->allocateArray<T>(n);
+    	}
+    	return new T[n];
+    }
+
+    template <class T>
+    void releaseArray(T * array){
+    	if (arena == NULL) {
+    		delete [] array;
+    	}
+    }
+
+    template <class T>
+    void assignArray(T * & array, unsigned & size, const T * values, unsigned n){
+    	if (n > size) {
+    		releaseArray(array);
+    		array = allocateArray<T>(n);
+    	}
+    	std::copy(values, values + n, array);
+    	size = n;
+    }
+
+    // items are only created by a pool or cloned for the cache
+    PhysicalPlanRecordItem(const PhysicalPlanRecordItem &);
+    PhysicalPlanRecordItem & operator=(const PhysicalPlanRecordItem &);
+
+    srch2::util::Arena * arena;
     bool geoFlag; // this flag shows that this Item is for a term or a geo element
 	unsigned recordId;
 	float recordStaticScore;
 	float recordRuntimeScore;
-	vector<TrieNodePointer> matchingPrefixes;
-	vector<unsigned> editDistances;
-	vector<vector<unsigned> >attributeIdsList;
-	vector<unsigned> positionIndexOffsets;
-	vector<TermType> termTypes;
+	TrieNodePointer * matchingPrefixes;
+	unsigned numberOfMatchingPrefixes;
+	unsigned * editDistances;
+	unsigned numberOfEditDistances;
+	// attribute id list i is attributeIds[attributeIdsListOffsets[i] .. attributeIdsListOffsets[i+1])
+	unsigned * attributeIdsListOffsets;
+	unsigned * attributeIds;
+	unsigned numberOfAttributeIdsLists;
+	unsigned * positionIndexOffsets;
+	unsigned numberOfPositionIndexOffsets;
+	TermType * termTypes;
+	unsigned numberOfTermTypes;
+	unsigned termTypesCapacity;
 };
 
 
 /*
- * This class is a pool for PhysicalPlanRecordItem objects
+ * This class is a pool for PhysicalPlanRecordItem objects.
+ *
+ * The items and their arrays are allocated in an arena which is released in one
+ * shot by refresh(), so creating a tuple is a pointer bump instead of a handful of
+ * mallocs. A pool is used by one thread at a time: the pool of QueryEvaluatorInternal
+ * lives as long as its query and ParallelExchangeOperator gives each of its threads
+ * a pool of its own.
  */
 class PhysicalPlanRecordItemPool{
 public:
 	PhysicalPlanRecordItemPool(){
-		/* This code is disabled for now to check the memory effect of record pools
-		size = 0;
-		*/
 	}
 	// returns the number of objects created in this pool so far
 	unsigned getNumberOfObjects(){
-		/* This code is disabled for now to check the memory effect of record pools
-		return extraObjects.size();
-		*/
 		return recordItemObjects.size();
 	}
 	PhysicalPlanRecordItem * createRecordItem(){
-		/* This code is disabled for now to check the memory effect of record pools
-		if(size >= INITIAL_NUMBER_OF_RECORD_ITEMS_IN_A_GROUP){
-			if(size - INITIAL_NUMBER_OF_RECORD_ITEMS_IN_A_GROUP >= extraObjects.size()){
-				PhysicalPlanRecordItem  * newObj = new PhysicalPlanRecordItem();
-				extraObjects.push_back(newObj);
-				size++;
-				return newObj;
-			}else{
-				PhysicalPlanRecordItem * toReturn = extraObjects.at(size - INITIAL_NUMBER_OF_RECORD_ITEMS_IN_A_GROUP);
-				toReturn->clear();
-				size ++;
-				return toReturn;
-			}
-		}else{
-			PhysicalPlanRecordItem * toReturn = &(objects[size]);
-			toReturn->clear();
-			size ++;
-			return toReturn;
-		}
-		*/
-		PhysicalPlanRecordItem * newTuple = new PhysicalPlanRecordItem();
+		void * memory = arena.allocate(sizeof(PhysicalPlanRecordItem), __alignof__(PhysicalPlanRecordItem));
+		PhysicalPlanRecordItem * newTuple = new (memory) PhysicalPlanRecordItem(&arena);
 		recordItemObjects.push_back(newTuple);
 		return newTuple;
 	}
@@ -237,22 +344,7 @@ public:
 	// deallocating it
 	PhysicalPlanRecordItem * cloneForCache(PhysicalPlanRecordItem * oldObj){
 		PhysicalPlanRecordItem  * newObj = new PhysicalPlanRecordItem();
-		newObj->setRecordId(oldObj->getRecordId());
-		newObj->setRecordRuntimeScore(oldObj->getRecordRuntimeScore());
-		vector<TrieNodePointer> matchingPrefixes;
-		oldObj->getRecordMatchingPrefixes(matchingPrefixes);
-		newObj->setRecordMatchingPrefixes(matchingPrefixes);
-		vector<unsigned> editDistances;
-		oldObj->getRecordMatchEditDistances(editDistances);
-		newObj->setRecordMatchEditDistances(editDistances);
-		vector<vector<unsigned> > attributeIdsList;
-		oldObj->getRecordMatchAttributeBitmaps(attributeIdsList);
-		newObj->setRecordMatchAttributeBitmaps(attributeIdsList);
-		vector<unsigned> positionIndexOffsets;
-		oldObj->getPositionIndexOffsets(positionIndexOffsets);
-		newObj->setPositionIndexOffsets(positionIndexOffsets);
-		oldObj->getTermTypes(newObj->getTermTypesRef());
-
+		newObj->copyMatchingInfo(*oldObj);
 		return newObj;
 	}
 
@@ -261,75 +353,38 @@ public:
 	 */
 	PhysicalPlanRecordItem * clone(PhysicalPlanRecordItem * oldObj){
 		PhysicalPlanRecordItem  * newObj = createRecordItem();
-		newObj->setRecordId(oldObj->getRecordId());
-		newObj->setRecordRuntimeScore(oldObj->getRecordRuntimeScore());
-		vector<TrieNodePointer> matchingPrefixes;
-		oldObj->getRecordMatchingPrefixes(matchingPrefixes);
-		newObj->setRecordMatchingPrefixes(matchingPrefixes);
-		vector<unsigned> editDistances;
-		oldObj->getRecordMatchEditDistances(editDistances);
-		newObj->setRecordMatchEditDistances(editDistances);
-		vector<vector<unsigned> > attributeIdsList;
-		oldObj->getRecordMatchAttributeBitmaps(attributeIdsList);
-		newObj->setRecordMatchAttributeBitmaps(attributeIdsList);
-		vector<unsigned> positionIndexOffsets;
-		oldObj->getPositionIndexOffsets(positionIndexOffsets);
-		newObj->setPositionIndexOffsets(positionIndexOffsets);
-		oldObj->getTermTypes(newObj->getTermTypesRef());
+		newObj->copyMatchingInfo(*oldObj);
 		return newObj;
 	}
 
+	// the memory taken by the arena of this pool
+	unsigned getNumberOfBytes() const{
+		return arena.getNumberOfBytes();
+	}
+
 	~PhysicalPlanRecordItemPool(){
 		clear();
 	}
 
 	void clear(){
-		/* This code is disabled for now to check the memory effect of record pools
-		vector<PhysicalPlanRecordItem *> emptyVector;
-		if(extraObjects.size() > 0){
-			for(unsigned i =0 ; i< extraObjects.size() ; ++i){
-				if(extraObjects.at(i) == NULL){
-					ASSERT(false);
-				}else{
-					delete extraObjects.at(i);
-				}
-			}
-			extraObjects.clear();
-			// Clear does not free internal memory of vector. swap internal memory with empty
-			// vector. empty vector will free the memory when it goes out of scope.
-			extraObjects.swap(emptyVector);
-		}
-		*/
 		refresh();
 	}
 
 	/*
-	 * Refresh prepares this pool for another fresh query. Since we
-	 * don't want to delete any objects at this point (it's expensive) we only set the size to
-	 * zero.
+	 * Refresh prepares this pool for another fresh query. The tuples are destroyed
+	 * and the arena is reset; it keeps its largest chunk so the next query does not
+	 * need to allocate.
 	 */
 	void refresh(){
-		/* This code is disabled for now to check the memory effect of record pools
-		size = 0;
-		*/
-		for(int r = 0 ; r < recordItemObjects.size() ; ++r){
-			delete recordItemObjects.at(r);
+		for(unsigned r = 0 ; r < recordItemObjects.size() ; ++r){
+			recordItemObjects[r]->~PhysicalPlanRecordItem();
 		}
 		recordItemObjects.clear();
+		arena.reset();
 	}
 private:
 
-	/*
-	 * Each pool has 10000 tuples created in the beginning. If a reader
-	 * keeps asking for more tuples (more than INITIAL_NUMBER_OF_RECORD_ITEMS_IN_A_GROUP),
-	 * we start allocating new tuples and save them in extraObjects vector.
-	 */
-	/* This code is disabled for now to check the memory effect of record pools
-	PhysicalPlanRecordItem objects[INITIAL_NUMBER_OF_RECORD_ITEMS_IN_A_GROUP];
-	vector<PhysicalPlanRecordItem *> extraObjects;
-	unsigned size;
-	*/
-
+	srch2::util::Arena arena;
 	vector<PhysicalPlanRecordItem *> recordItemObjects;
 };
 
@@ -55,6 +55,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/thread/tss.hpp>
 
 using namespace std;
 
@@ -63,6 +64,11 @@ namespace srch2
 namespace instantsearch
 {
 
+// the record item pool of the operators running on the current thread, the pool is owned by the operator
+static void doNotDeleteRecordItemPool(PhysicalPlanRecordItemPool * pool){
+}
+static boost::thread_specific_ptr<PhysicalPlanRecordItemPool> recordItemPoolOfCurrentThread(doNotDeleteRecordItemPool);
+
 /**
  * Creates an QueryEvaluatorInternal object.
  * @param indexer - An object holding the index structures and cache.
@@ -81,6 +87,9 @@ QueryEvaluatorInternal::QueryEvaluatorInternal(IndexReaderWriter *indexer , Quer
 }
 
 QueryEvaluatorInternal::~QueryEvaluatorInternal() {
+    // unpins the epoch if a reader method left without readerPreExit(), e.g. through an exception.
+    // The evaluator is deleted by the thread that ran its queries, and release() is idempotent.
+    this->indexReadToken.release();
     delete physicalOperatorFactory;
     delete physicalPlanRecordItemPool;
 }
@@ -203,6 +212,7 @@ void QueryEvaluatorInternal::findKMostPopularSuggestionsSorted(Term *term ,
  */
 int QueryEvaluatorInternal::search(LogicalPlan * logicalPlan , QueryResults *queryResults){
 
+    const uint64_t searchStartTime = QueryStatistics::getMicroseconds();
     // used for feedback ranking.
     this->queryStringWithTermsAndOps = logicalPlan->queryStringWithTermsAndOps;
     ASSERT(logicalPlan != NULL);
@@ -232,6 +242,7 @@ int QueryEvaluatorInternal::search(LogicalPlan * logicalPlan , QueryResults *que
              * mutex lock.
              */
             readerPreExit();
+            getQueryStatistics()->addQuery(QueryStatistics::getMicroseconds() - searchStartTime, true);
             return queryResults->impl->sortedFinalResults.size();
         }
     }
@@ -305,7 +316,11 @@ int QueryEvaluatorInternal::search(LogicalPlan * logicalPlan , QueryResults *que
 
 
     PhysicalPlanExecutionParameters dummy(0,true,1,SearchTypeTopKQuery); // this parameter will be created inside KeywordSearchOperator
+    uint64_t phaseStartTime = QueryStatistics::getMicroseconds();
     topOperator->open(this, dummy );
+    uint64_t phaseEndTime = QueryStatistics::getMicroseconds();
+    getQueryStatistics()->addPhase(QueryStatistics::OpenPhase, phaseEndTime - phaseStartTime);
+    phaseStartTime = phaseEndTime;
 
 
     while(true){
@@ -347,17 +362,23 @@ int QueryEvaluatorInternal::search(LogicalPlan * logicalPlan , QueryResults *que
     if(facetOperatorPtr != NULL){
         facetOperatorPtr->getFacetResults(queryResults);
     }
+    phaseEndTime = QueryStatistics::getMicroseconds();
+    getQueryStatistics()->addPhase(QueryStatistics::GetNextPhase, phaseEndTime - phaseStartTime);
+    phaseStartTime = phaseEndTime;
 
     topOperator->close(dummy);
+    getQueryStatistics()->addPhase(QueryStatistics::ClosePhase, QueryStatistics::getMicroseconds() - phaseStartTime);
 
     // set estimated number of results
     queryResults->impl->estimatedNumberOfResults = logicalPlan->getTree()->stats->getEstimatedNumberOfResults();
 
-    // save in cache
-    boost::shared_ptr<QueryResultsCacheEntry> cacheObject ;
-    cacheObject.reset(new QueryResultsCacheEntry());
-    cacheObject->copyFromQueryResultsInternal(queryResults->impl);
-    this->cacheManager->getQueryResultsCache()->setQueryResults(key , cacheObject);
+    // save in cache, unless the search was cancelled before it found all the results
+    if (!this->isCancelled()) {
+        boost::shared_ptr<QueryResultsCacheEntry> cacheObject ;
+        cacheObject.reset(new QueryResultsCacheEntry());
+        cacheObject->copyFromQueryResultsInternal(queryResults->impl);
+        this->cacheManager->getQueryResultsCache()->setQueryResults(key , cacheObject);
+    }
 
 
     if(facetOperatorPtr != NULL){
@@ -376,6 +397,7 @@ int QueryEvaluatorInternal::search(LogicalPlan * logicalPlan , QueryResults *que
      * mutex lock.
      */
     readerPreExit();
+    getQueryStatistics()->addQuery(QueryStatistics::getMicroseconds() - searchStartTime, false);
     return queryResults->impl->sortedFinalResults.size();
 }
 
@@ -432,13 +454,13 @@ void QueryEvaluatorInternal::search(const std::string & primaryKey, QueryResults
 // Get the in memory data stored with the record in the forwardindex. Access through the internal recordid.
 StoredRecordBuffer QueryEvaluatorInternal::getInMemoryData_Safe(unsigned internalRecordId) const {
     // This method is not used in the data flow of read queries, readview is acquired later on inside
-    // forward index method for getting inMemory data..
-    boost::shared_lock<boost::shared_mutex> sLock(this->indexData->globalRwMutexForReadersWriters);
+    // forward index method for getting inMemory data, which also holds the trie read view so that a
+    // merge does not free the forward list meanwhile.
     return this->indexer->getInMemoryData(internalRecordId);
 }
 
 unsigned QueryEvaluatorInternal::getTotalNumberOfRecords(){
-	return this->indexReadToken.forwardIndexReadViewSharedPtr->size();
+	return this->indexReadToken.readState->forwardIndexReadViewSharedPtr->size();
 }
 
 const bool QueryEvaluatorInternal::isBulkLoadDone() const { return this->indexData->isBulkLoadDone(); }
@@ -483,14 +505,29 @@ boost::shared_ptr<PrefixActiveNodeSet> QueryEvaluatorInternal::computeActiveNode
     // 1. Get the longest prefix that has active nodes
     unsigned cachedPrefixLength = 0;
     boost::shared_ptr<PrefixActiveNodeSet> initialPrefixActiveNodeSet ;
-    //TODO: Active node cache is disabled for geo search for now. There is a bug related to Cache/Trie and Geo.
-    // We should fix this bug when we will be actively working on Geo.
-    int cacheResponse = 0 ; // this->cacheManager->getActiveNodesCache()->findLongestPrefixActiveNodes(term, initialPrefixActiveNodeSet); //initialPrefixActiveNodeSet is Busy
-
-    if ( cacheResponse == 0) { // NO CacheHit,  response = 0
+    // The cache only returns sets computed on a read view of the trie with the version of ours
+    int cacheResponse = this->cacheManager->getActiveNodesCache()->findLongestPrefixActiveNodes(charTypeKeyword,
+            term->getThreshold(), this->indexReadToken.readState->trieRootNodeSharedPtr, initialPrefixActiveNodeSet);
+
+    // NO CacheHit (response = 0), or a cached prefix the rest of which could miss active nodes
+    if ( cacheResponse == 0 || (initialPrefixActiveNodeSet->getPrefixLength() < keywordLength
+            && PrefixActiveNodeSet::incrementalComputationCanMissActiveNodes(term->getThreshold(),
+                    this->getSchema()->getSupportSwapInEditDistance()))) {
+        // Compute the whole prefix in one pass over the frozen trie if the read view has one
+        boost::shared_ptr<PrefixActiveNodeSet> frozenPrefixActiveNodeSet =
+                PrefixActiveNodeSet::computeActiveNodeSetFromFrozenTrie(charTypeKeyword, term->getThreshold(),
+                        this->indexReadToken.readState->trieRootNodeSharedPtr, this->getSchema()->getSupportSwapInEditDistance());
+        if (frozenPrefixActiveNodeSet) {
+            if (keywordLength >= 3) {
+                frozenPrefixActiveNodeSet->prepareForIteration(); // this is the last write operation on it
+                this->cacheManager->getActiveNodesCache()->setPrefixActiveNodeSet(frozenPrefixActiveNodeSet);
+            }
+            return frozenPrefixActiveNodeSet;
+        }
         // No prefix has a cached TermActiveNode Set. Create one for the empty std::string "".
-        initialPrefixActiveNodeSet.reset(new PrefixActiveNodeSet(this->indexReadToken.trieRootNodeSharedPtr,
-        		term->getThreshold(), this->getSchema()->getSupportSwapInEditDistance()));
+        if (cacheResponse == 0)
+            initialPrefixActiveNodeSet.reset(new PrefixActiveNodeSet(this->indexReadToken.readState->trieRootNodeSharedPtr,
+                    term->getThreshold(), this->getSchema()->getSupportSwapInEditDistance()));
     }
     cachedPrefixLength = initialPrefixActiveNodeSet->getPrefixLength();
 
@@ -528,9 +565,19 @@ void QueryEvaluatorInternal::setPhysicalOperatorFactory(PhysicalOperatorFactory
 }
 
 PhysicalPlanRecordItemPool * QueryEvaluatorInternal::getPhysicalPlanRecordItemPool(){
+    PhysicalPlanRecordItemPool * poolOfCurrentThread = recordItemPoolOfCurrentThread.get();
+    if(poolOfCurrentThread != NULL){
+        return poolOfCurrentThread;
+    }
     return this->physicalPlanRecordItemPool;
 }
 
+PhysicalPlanRecordItemPool * QueryEvaluatorInternal::setRecordItemPoolOfCurrentThread(PhysicalPlanRecordItemPool * pool){
+    PhysicalPlanRecordItemPool * previousPool = recordItemPoolOfCurrentThread.get();
+    recordItemPoolOfCurrentThread.reset(pool);
+    return previousPool;
+}
+
 QueryEvaluatorRuntimeParametersContainer * QueryEvaluatorInternal::getQueryEvaluatorRuntimeParametersContainer(){
     return &(this->parameters);
 }
@@ -539,6 +586,10 @@ FeedbackIndex * QueryEvaluatorInternal::getFeedbackIndex() {
     return indexer->getFeedbackIndexer();
 }
 
+QueryStatistics * QueryEvaluatorInternal::getQueryStatistics() {
+    return this->indexer->getQueryStatistics();
+}
+
 // Every reader goes through this function before starting the execution of
 // suggest or search
 void QueryEvaluatorInternal::readerPreEnter(){
@@ -61,6 +61,7 @@ class InvertedIndex;
 class PhysicalOperatorFactory;
 class PhysicalPlanRecordItemFactory;
 class FeedbackIndex;
+class QueryStatistics;
 /**
  * QueryEvaluatorInternal is the implementation of QueryEvaluator.
  */
@@ -134,14 +135,27 @@ public:
     PhysicalOperatorFactory * getPhysicalOperatorFactory();
     void setPhysicalOperatorFactory(PhysicalOperatorFactory * physicalOperatorFactory);
     PhysicalPlanRecordItemPool * getPhysicalPlanRecordItemPool();
+    // Operators which run on a thread of the query thread pool must not share the pool of the query
+    // (it is not thread safe). This function makes getPhysicalPlanRecordItemPool() return the given pool
+    // in the calling thread (NULL restores the pool of the query) and returns the previous one.
+    static PhysicalPlanRecordItemPool * setRecordItemPoolOfCurrentThread(PhysicalPlanRecordItemPool * pool);
 
     QueryEvaluatorRuntimeParametersContainer * getQueryEvaluatorRuntimeParametersContainer();
 
+    // true once the caller cancelled the search (see QueryEvaluatorRuntimeParametersContainer::cancelled).
+    // The operators check it in their loops over the records and stop as if their lists had ended.
+    bool isCancelled() const {
+        return this->parameters.cancelled != NULL && *this->parameters.cancelled;
+    }
+
 
     CacheManager * getCacheManager(){
     	return this->cacheManager;
     }
 
+    // the statistics of the queries of the index, operators add to them when they are closed
+    QueryStatistics * getQueryStatistics();
+
 public:
     IndexReadStateSharedPtr_Token indexReadToken;
     void findKMostPopularSuggestionsSorted(Term *term ,
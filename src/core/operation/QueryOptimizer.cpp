@@ -31,6 +31,8 @@
 #include "physical_plan/FilterQueryOperator.h"
 #include "util/Logger.h"
 #include  "physical_plan/FeedbackRankingOperator.h"
+#include "physical_plan/ParallelExchangeOperator.h"
+#include "util/WorkStealingThreadPool.h"
 namespace srch2 {
 namespace instantsearch {
 
@@ -216,6 +218,7 @@ void QueryOptimizer::buildIncompleteSubTreeOptionsAndOr(LogicalPlanNode * root,
             ourOptions.push_back((PhysicalPlanOptimizationNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createRandomAccessVerificationAndOptimizationOperator());
         }else if(root->nodeType == LogicalPlanNodeTypeOr){
             ourOptions.push_back((PhysicalPlanOptimizationNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createUnionSortedByIDOptimizationOperator());
+            ourOptions.push_back((PhysicalPlanOptimizationNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createUnionTopKBlockMaxOptimizationOperator());
             ourOptions.push_back((PhysicalPlanOptimizationNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createRandomAccessVerificationOrOptimizationOperator());
         }else{
             ASSERT(false);
@@ -393,7 +396,7 @@ void QueryOptimizer::injectSortOperatorsForFeedback(PhysicalPlanOptimizationNode
 // Operator is feedback capable iff
 // 1. it does NOT have sorted-by-score output property.
 // OR
-// 2. it is either MergeTopK or SortByScore operators. ( These operators have feedback logic in it)
+// 2. it is either MergeTopK, UnionTopKBlockMax or SortByScore operators. ( These operators have feedback logic in it)
 //
 bool QueryOptimizer::isNodeFeedbackCapable(PhysicalPlanOptimizationNode *node) {
 
@@ -408,7 +411,8 @@ bool QueryOptimizer::isNodeFeedbackCapable(PhysicalPlanOptimizationNode *node) {
 		}
 	}
 	if (!hasSortByScoreProperty || node->getType() == PhysicalPlanNode_SortByScore
-			|| node->getType() == PhysicalPlanNode_MergeTopK) {
+			|| node->getType() == PhysicalPlanNode_MergeTopK
+			|| node->getType() == PhysicalPlanNode_UnionTopKBlockMax) {
 		return true;
 	} else {
 		return false;
@@ -566,7 +570,10 @@ PhysicalPlanNode * QueryOptimizer::buildPhysicalPlanFirstVersionFromTreeStructur
          || chosenTree->getType() ==
          PhysicalPlanNode_GeoNearestNeighbor
          || chosenTree->getType() ==
-         PhysicalPlanNode_GeoSimpleScan)){
+         PhysicalPlanNode_GeoSimpleScan
+         // UnionTopKBlockMax reads the lists of its terms directly, so the filters of its children are never used
+         || chosenTree->getType() ==
+         PhysicalPlanNode_UnionTopKBlockMax)){
     	// we need to create a FilterQueryOperator if we have a filter in the query or if we have record-base access control.
         if(logicalPlan->getPostProcessingInfo()->getFilterQueryEvaluator() != NULL  || logicalPlan->getPostProcessingInfo()->getRoleId()->compare("") != 0){
             filterQueryOp = this->queryEvaluator->getPhysicalOperatorFactory()->
@@ -609,6 +616,11 @@ PhysicalPlanNode * QueryOptimizer::buildPhysicalPlanFirstVersionFromTreeStructur
             executableResult = (PhysicalPlanNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createUnionSortedByIDOperator();
             break;
         }
+        case PhysicalPlanNode_UnionTopKBlockMax:{
+            optimizationResult = (PhysicalPlanOptimizationNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createUnionTopKBlockMaxOptimizationOperator();
+            executableResult = (PhysicalPlanNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createUnionTopKBlockMaxOperator();
+            break;
+        }
         case PhysicalPlanNode_UnionLowestLevelTermVirtualList:{
             optimizationResult = (PhysicalPlanOptimizationNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createUnionLowestLevelTermVirtualListOptimizationOperator();
             executableResult = (PhysicalPlanNode *)this->queryEvaluator->getPhysicalOperatorFactory()->createUnionLowestLevelTermVirtualListOperator();
@@ -700,7 +712,7 @@ void QueryOptimizer::applyOptimizationRulesOnThePlan(PhysicalPlan & physicalPlan
     //TODO
     // calls the optimization rules one by one
     Rule_1(physicalPlan);
-    //Rule_2(physicalPlan);
+    Rule_RunSiblingSubtreesInParallel(physicalPlan);
     //Rule_3(physicalPlan);
     //...
 }
@@ -712,6 +724,79 @@ void QueryOptimizer::Rule_1(PhysicalPlan & physicalPlan){
     //TODO
 }
 
+/*
+ * OR and AND operators open their children one after the other before they return their first record,
+ * and opening a child is where most of the work is done: a sort operator reads its whole subtree and
+ * a term virtual list finds its active nodes and prepares its inverted lists. If a node has at least two
+ * such children and is expected to produce many results, each child is wrapped in a ParallelExchange
+ * operator which opens it and reads its records ahead on the query thread pool. Records still come out
+ * of the children in the same order, so the parent is not changed.
+ */
+void QueryOptimizer::Rule_RunSiblingSubtreesInParallel(PhysicalPlan & physicalPlan){
+    if(physicalPlan.getPlanTree() == NULL){
+        return;
+    }
+    // the feedback ranker and the filter query evaluator are shared by all the operators of the plan
+    // and are not thread safe
+    if(physicalPlan.getExecutionParameters() != NULL && physicalPlan.getExecutionParameters()->feedbackRanker != NULL){
+        return;
+    }
+    if(this->logicalPlan->getPostProcessingInfo() != NULL &&
+            this->logicalPlan->getPostProcessingInfo()->getFilterQueryEvaluator() != NULL){
+        return;
+    }
+    if(srch2::util::WorkStealingThreadPool::getSharedPool()->getNumberOfThreads() < 2){
+        return;
+    }
+    injectParallelExchangeOperators(physicalPlan.getPlanTree()->getPhysicalPlanOptimizationNode(),
+            this->queryEvaluator->getQueryEvaluatorRuntimeParametersContainer()->parallelExecutionMinimumNumberOfResults);
+}
+
+void QueryOptimizer::injectParallelExchangeOperators(PhysicalPlanOptimizationNode * node, unsigned minimumNumberOfResults){
+    for(unsigned childOffset = 0 ; childOffset < node->getChildrenCount() ; ++childOffset){
+        injectParallelExchangeOperators(node->getChildAt(childOffset), minimumNumberOfResults);
+    }
+
+    // only these operators open all of their children before returning records. UnionTopKBlockMax reads the
+    // lists of its children without opening them and MergeByShortestList has only one child which is not
+    // accessed randomly.
+    switch (node->getType()) {
+        case PhysicalPlanNode_MergeTopK:
+        case PhysicalPlanNode_MergeSortedById:
+        case PhysicalPlanNode_UnionSortedById:
+            break;
+        default:
+            return;
+    }
+    if(node->getChildrenCount() < 2 || node->getLogicalPlanNode() == NULL || node->getLogicalPlanNode()->stats == NULL){
+        return;
+    }
+    // an AND is estimated by its shortest child, so the children are compared, not the node
+    unsigned estimatedNumberOfResults = 0;
+    for(unsigned childOffset = 0 ; childOffset < node->getChildrenCount() ; ++childOffset){
+        LogicalPlanNode * childLogicalNode = node->getChildAt(childOffset)->getLogicalPlanNode();
+        if(childLogicalNode != NULL && childLogicalNode->stats != NULL){
+            estimatedNumberOfResults += childLogicalNode->stats->getEstimatedNumberOfResults();
+        }
+    }
+    if(estimatedNumberOfResults < minimumNumberOfResults){
+        return;
+    }
+
+    for(unsigned childOffset = 0 ; childOffset < node->getChildrenCount() ; ++childOffset){
+        PhysicalPlanOptimizationNode * child = node->getChildAt(childOffset);
+        ParallelExchangeOptimizationOperator * exchangeOpOp =
+                this->queryEvaluator->getPhysicalOperatorFactory()->createParallelExchangeOptimizationOperator();
+        ParallelExchangeOperator * exchangeOp =
+                this->queryEvaluator->getPhysicalOperatorFactory()->createParallelExchangeOperator();
+        exchangeOpOp->setExecutableNode(exchangeOp);
+        exchangeOp->setPhysicalPlanOptimizationNode(exchangeOpOp);
+        exchangeOpOp->setLogicalPlanNode(child->getLogicalPlanNode());
+        exchangeOpOp->addChild(child);
+        node->setChildAt(childOffset, exchangeOpOp);
+    }
+}
+
 
 }
 }
@@ -103,6 +103,13 @@ private:
 	 */
 	void Rule_1(PhysicalPlan & physicalPlan);
 
+	/*
+	 * Wraps the children of OR and AND operators in ParallelExchange operators so that they are opened
+	 * at the same time on the query thread pool.
+	 */
+	void Rule_RunSiblingSubtreesInParallel(PhysicalPlan & physicalPlan);
+	void injectParallelExchangeOperators(PhysicalPlanOptimizationNode * node, unsigned minimumNumberOfResults);
+
 	QueryEvaluatorInternal * queryEvaluator;
 	LogicalPlan * logicalPlan;
 };
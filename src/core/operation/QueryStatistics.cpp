@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "QueryStatistics.h"
+
+#include <time.h>
+#include <sstream>
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+void QueryStatistics::addQuery(uint64_t microseconds, bool isQueryResultsCacheHit)
+{
+    this->latency.add(microseconds);
+    if (isQueryResultsCacheHit)
+        this->queryResultsCacheHits.add();
+}
+
+void QueryStatistics::addPhase(Phase phase, uint64_t microseconds)
+{
+    this->phases[phase].add(microseconds);
+}
+
+std::string QueryStatistics::getJsonString() const
+{
+    static const char *phaseNames[NumberOfPhases] = { "open", "get_next", "close" };
+    std::stringstream str;
+    str << "{\"query_results_cache_hits\":" << this->queryResultsCacheHits.get();
+    str << ",\"scanned_postings\":" << this->scannedPostings.get();
+    str << ",\"latency\":" << this->latency.getJsonString("us");
+    str << ",\"plan_phases\":{";
+    for (unsigned phase = 0; phase < NumberOfPhases; ++phase) {
+        if (phase > 0)
+            str << ",";
+        str << "\"" << phaseNames[phase] << "\":" << this->phases[phase].getJsonString("us");
+    }
+    str << "}}";
+    return str.str();
+}
+
+uint64_t QueryStatistics::getMicroseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+}
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __QUERYSTATISTICS_H__
+#define __QUERYSTATISTICS_H__
+
+#include <stdint.h>
+#include <string>
+#include "util/ShardedCounter.h"
+
+namespace srch2
+{
+namespace instantsearch
+{
+
+/*
+ *  The statistics of the queries of an index, reported by IndexReaderWriter::getIndexHealth().
+ *  Every query adds to them, so they are sharded by thread and only summed when they are reported.
+ */
+class QueryStatistics
+{
+public:
+    // the phases of the execution of the physical plan of a query
+    enum Phase {
+        OpenPhase,
+        GetNextPhase,
+        ClosePhase,
+        NumberOfPhases
+    };
+
+    // a query answered by QueryEvaluatorInternal::search(), from the query results cache or not
+    void addQuery(uint64_t microseconds, bool isQueryResultsCacheHit);
+    void addPhase(Phase phase, uint64_t microseconds);
+    // the postings a leaf operator read from the inverted lists, added once when it is closed
+    void addScannedPostings(uint64_t numberOfPostings) {
+        if (numberOfPostings > 0)
+            this->scannedPostings.add(numberOfPostings);
+    }
+
+    // a JSON object with the counters and the latency histograms in microseconds
+    std::string getJsonString() const;
+
+    // the current time in microseconds, on a clock that does not go back
+    static uint64_t getMicroseconds();
+
+private:
+    srch2::util::ShardedHistogram latency;
+    srch2::util::ShardedHistogram phases[NumberOfPhases];
+    srch2::util::ShardedCounter queryResultsCacheHits;
+    srch2::util::ShardedCounter scannedPostings;
+};
+
+}
+}
+
+#endif /* __QUERYSTATISTICS_H__ */
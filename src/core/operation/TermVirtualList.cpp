@@ -46,10 +46,13 @@ void TermVirtualList::initialiseTermVirtualListElement(TrieNodePointer prefixNod
     unsigned invertedListId = leafNode->getInvertedListOffset();
     unsigned invertedListCounter = 0;
 
-    shared_ptr<vectorview<unsigned> > invertedListReadView;
-    this->invertedIndex->getInvertedListReadView(this->invertedListDirectoryReadView,
-    		invertedListId, invertedListReadView);
-    unsigned recordId = invertedListReadView->getElement(invertedListCounter);
+    InvertedListCursor invertedListCursor;
+    this->invertedIndex->getInvertedListCursor(this->invertedListDirectoryReadView,
+    		invertedListId, invertedListCursor);
+    // an empty list (e.g., all its records were deleted) has no element to initialize from
+    if (invertedListCursor.size() == 0)
+        return;
+    unsigned recordId = invertedListCursor.getElement(invertedListCounter);
     // calculate record offset online
     unsigned keywordOffset = this->invertedIndex->getKeywordOffset(this->forwardIndexDirectoryReadView,
     		this->invertedIndexKeywordIdsReadView,
@@ -71,8 +74,8 @@ void TermVirtualList::initialiseTermVirtualListElement(TrieNodePointer prefixNod
             break;
         }
 
-        if (invertedListCounter < invertedListReadView->size()) {
-            recordId = invertedListReadView->getElement(invertedListCounter);
+        if (invertedListCounter < invertedListCursor.size()) {
+            recordId = invertedListCursor.getElement(invertedListCounter);
             // calculate record offset online
             keywordOffset = this->invertedIndex->getKeywordOffset(this->forwardIndexDirectoryReadView,
             		this->invertedIndexKeywordIdsReadView,
@@ -115,8 +118,8 @@ void TermVirtualList::initialiseTermVirtualListElement(TrieNodePointer prefixNod
 
         // Cursor points to the next element on InvertedList
         this->cursorVector.push_back(invertedListCounter);
-        // keep the inverted list readviews in invertedListVector such that we can safely access them
-        this->invertedListReadViewVector.push_back(invertedListReadView);
+        // keep the inverted list cursors such that we can safely access the lists
+        this->invertedListCursorVector.push_back(invertedListCursor);
     }
 }
 
@@ -140,11 +143,12 @@ void TermVirtualList::depthInitializeBitSet(const TrieNode* trieNode, unsigned e
 {
     if (trieNode->isTerminalNode()) {
         unsigned invertedListId = trieNode->getInvertedListOffset();
-        this->invertedIndex->getInvertedListReadView(this->invertedListDirectoryReadView,
-        		invertedListId, invertedListReadView);
-        for (unsigned invertedListCounter = 0; invertedListCounter < invertedListReadView->size(); invertedListCounter++) {
+        InvertedListCursor invertedListCursor;
+        this->invertedIndex->getInvertedListCursor(this->invertedListDirectoryReadView,
+        		invertedListId, invertedListCursor);
+        for (; !invertedListCursor.isDone(); invertedListCursor.next()) {
             // set the bit of the record id to be true
-            if (!bitSet.getAndSet(invertedListReadView->at(invertedListCounter)))
+            if (!bitSet.getAndSet(invertedListCursor.getRecordId()))
                 bitSetSize++;
         }
     }
@@ -212,22 +216,22 @@ TermVirtualList::TermVirtualList(const InvertedIndex* invertedIndex,  const Forw
                 	this->maxScoreForBitSetCase = runTimeScoreOfThisLeafNode;
                 }
                 unsigned invertedListId = leafNode->getInvertedListOffset();
-                this->invertedIndex->getInvertedListReadView(this->invertedListDirectoryReadView,
-                		invertedListId, invertedListReadView);
+                InvertedListCursor invertedListCursor;
+                this->invertedIndex->getInvertedListCursor(this->invertedListDirectoryReadView,
+                		invertedListId, invertedListCursor);
                 // loop the inverted list to add it to the Bitset
-                for (unsigned invertedListCounter = 0; invertedListCounter < invertedListReadView->size(); invertedListCounter++) {
+                for (; !invertedListCursor.isDone(); invertedListCursor.next()) {
                     // We compute the union of these bitsets. We increment the number of bits only if the previous bit was 0.
-                    if (!bitSet.getAndSet(invertedListReadView->at(invertedListCounter)))
+                    if (!bitSet.getAndSet(invertedListCursor.getRecordId()))
                         bitSetSize ++;
                 }
                 //termCount++;
-                //totalInveretListLength  += invertedListReadView->size();
             }
 
             bitSetIter = bitSet.iterator();
         } else { // If we don't use a bitset, we use the TA algorithm
             cursorVector.reserve(iter.size());
-            invertedListReadViewVector.reserve(iter.size());
+            invertedListCursorVector.reserve(iter.size());
             for (; !iter.isDone(); iter.next()) {
                 TrieNodePointer leafNode;
                 TrieNodePointer prefixNode;
@@ -270,7 +274,7 @@ TermVirtualList::TermVirtualList(const InvertedIndex* invertedIndex,  const Forw
             bitSetIter = bitSet.iterator();
         } else {
             cursorVector.reserve(iter.size());
-            invertedListReadViewVector.reserve(iter.size());
+            invertedListCursorVector.reserve(iter.size());
             for (; !iter.isDone(); iter.next()) {
                 TrieNodePointer trieNode;
                 unsigned editDistance;
@@ -303,7 +307,7 @@ TermVirtualList::~TermVirtualList()
     }
     this->itemsHeap.clear();
     this->cursorVector.clear();
-    this->invertedListReadViewVector.clear();
+    this->invertedListCursorVector.clear();
     this->term = NULL;
     this->invertedIndex = NULL;
 
@@ -402,8 +406,8 @@ bool TermVirtualList::getNext(HeapItemForIndexSearcher *returnHeapItem)
 
             unsigned currentHeapMaxCursor = this->cursorVector[currentHeapMax->cursorVectorPosition];
             unsigned currentHeapMaxInvertetedListId = currentHeapMax->invertedListId;
-            const shared_ptr<vectorview<unsigned> > &currentHeapMaxInvertedList = this->invertedListReadViewVector[currentHeapMax->cursorVectorPosition];
-            unsigned currentHeapMaxInvertedListSize = currentHeapMaxInvertedList->size();
+            InvertedListCursor &currentHeapMaxInvertedList = this->invertedListCursorVector[currentHeapMax->cursorVectorPosition];
+            unsigned currentHeapMaxInvertedListSize = currentHeapMaxInvertedList.size();
 
             bool foundValidHit = 0;
 
@@ -411,7 +415,7 @@ bool TermVirtualList::getNext(HeapItemForIndexSearcher *returnHeapItem)
             while (currentHeapMaxCursor < currentHeapMaxInvertedListSize) {
                 // InvertedList has more elements. Push invertedListElement at cursor into virtualList.
 
-                unsigned recordId = currentHeapMaxInvertedList->getElement(currentHeapMaxCursor);
+                unsigned recordId = currentHeapMaxInvertedList.getElement(currentHeapMaxCursor);
                 // calculate record offset online
                 unsigned keywordOffset = this->invertedIndex->getKeywordOffset(this->forwardIndexDirectoryReadView,
                 		this->invertedIndexKeywordIdsReadView,
@@ -507,7 +511,7 @@ unsigned TermVirtualList::getVirtualListTotalLength()
     } else {
         unsigned totalLen = 0;
         for (unsigned i=0; i<itemsHeap.size(); i++) {
-            totalLen += this->invertedListReadViewVector[itemsHeap[i]->cursorVectorPosition]->size();
+            totalLen += this->invertedListCursorVector[itemsHeap[i]->cursorVectorPosition].size();
         }
         return totalLen;
     }
@@ -163,8 +163,6 @@ public:
     int currentRecordID;
     // The Iterator of bitset
     RecordIdSetIterator* bitSetIter;
-    // current inverted list Readview
-    shared_ptr<vectorview<unsigned> > invertedListReadView;
     //int numberOfLeafNodes;
     //int totalInveretListLength ;
     // a flag indicating whether we need to use a bitset
@@ -196,8 +194,9 @@ private:
      *
      * Enables the functions getCursors and setCursors for Caching purpose
      */
-    // a vector to keep all the inverted list readviews in current term virtual list
-    vector<shared_ptr<vectorview<unsigned> > > invertedListReadViewVector;
+    // a vector to keep the cursors of all the inverted lists in current term virtual list.
+    // The cursors keep the read views alive and decode compressed lists one block at a time.
+    vector<InvertedListCursor> invertedListCursorVector;
     vector<unsigned> cursorVector;
     //int addInvertedList(const InvertedList& invertedList);
 
@@ -306,11 +306,16 @@ PhysicalPlanRecordItem * FacetOperator::getNext(const PhysicalPlanExecutionParam
 	break;
     }
 
-	StoredRecordBuffer refiningAttributesData =
-			forwardList->getInMemoryData();
 	// this vector is parallel to attributeIds vector
 	std::vector<TypedValue> attributeDataValues;
-	RecordSerializerUtil::getBatchOfAttributes(fields, schema,refiningAttributesData.start.get(), &attributeDataValues);
+	// the values are read from the doc values, or decoded from the forward list if some of the
+	// fields have no column (multi-valued attributes)
+	if (!this->queryEvaluatorInternal->indexReadToken.readState->docValuesReadViewSharedPtr->getBatchOfAttributes(
+			fieldAttributeIds, resultIter->getRecordId(), &attributeDataValues)) {
+		StoredRecordBuffer refiningAttributesData =
+				forwardList->getInMemoryData();
+		RecordSerializerUtil::getBatchOfAttributes(fields, schema,refiningAttributesData.start.get(), &attributeDataValues);
+	}
 
 	// now iterate on attributes and incrementally update the facet results
 	for(std::vector<std::string>::iterator facetField = fields.begin();
@@ -339,6 +344,7 @@ bool FacetOperator::close(PhysicalPlanExecutionParameters & params){
 	}
 	this->facetTypes.clear();
 	this->fields.clear();
+	this->fieldAttributeIds.clear();
 	this->rangeStarts.clear();
 	this->rangeEnds.clear();
 	this->rangeGaps.clear();
@@ -434,6 +440,7 @@ void FacetOperator::preFilter(QueryEvaluatorInternal *queryEvaluatorInternal){
 		facetResultsContainer->initialize(facetHelper , FacetAggregationTypeCount );
 		this->facetResults.push_back(std::make_pair(facetType , facetResultsContainer));
 		this->facetHelpers.push_back(facetHelper);
+		this->fieldAttributeIds.push_back(schema->getRefiningAttributeId(*facetField));
 
 	}
 }
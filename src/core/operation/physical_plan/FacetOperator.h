@@ -195,7 +195,8 @@ private:
     std::vector<std::string> rangeGaps;
     std::vector<int> numberOfGroupsToReturnVector;
 
-    // These two vectors are parallel with fields.
+    // These three vectors are parallel with fields.
+    std::vector<unsigned> fieldAttributeIds;
 	std::vector<FacetHelper *> facetHelpers;
 	std::vector<std::pair< FacetType , FacetResultsContainer * > > facetResults;
 };
@@ -45,25 +45,99 @@ bool FilterQueryOperator::open(QueryEvaluatorInternal * queryEvaluatorInternal,
 	ASSERT(this->getPhysicalPlanOptimizationNode()->getChildrenCount() == 1);
 	this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->open(queryEvaluatorInternal, params);
 	this->queryEvaluatorInternal = queryEvaluatorInternal;
+	// fetch the names and ids of non searchable attributes from schema
+	const Schema * schema = queryEvaluatorInternal->getSchema();
+	this->attributes.clear();
+	this->attributeIds.clear();
+	for(map<string,unsigned>::const_iterator attr = schema->getRefiningAttributes()->begin();
+			attr != schema->getRefiningAttributes()->end() ; ++attr ){
+		this->attributes.push_back(attr->first);
+		this->attributeIds.push_back(attr->second);
+	}
+	this->batch.clear();
+	this->batchRecordIds.clear();
+	this->selection.clear();
+	this->nextSelected = 0;
+	this->batchSize = FIRST_BATCH_SIZE;
+	this->isChildExhausted = false;
 	return true;
 }
 PhysicalPlanRecordItem * FilterQueryOperator::getNext(const PhysicalPlanExecutionParameters & params) {
-	while(true){
+	if(this->filterQueryEvaluator == NULL){
+		// only access control, which is checked record by record
+		while(true){
+			PhysicalPlanRecordItem * nextRecord = this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->getNext(params);
+			if(nextRecord == NULL){
+				return NULL;
+			}
+			if(hasAccessToRecord(nextRecord->getRecordId())){
+				return nextRecord;
+			}
+		}
+	}
+	while(this->nextSelected == this->selection.size()){
+		if(this->isChildExhausted){
+			return NULL;
+		}
+		fillBatch(params);
+	}
+	return this->batch[this->selection[this->nextSelected++]];
+}
+
+void FilterQueryOperator::fillBatch(const PhysicalPlanExecutionParameters & params){
+	this->batch.clear();
+	this->batchRecordIds.clear();
+	this->selection.clear();
+	this->nextSelected = 0;
+	while(this->batch.size() < this->batchSize){
 		PhysicalPlanRecordItem * nextRecord = this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->getNext(params);
 		if(nextRecord == NULL){
-			return NULL;
+			this->isChildExhausted = true;
+			break;
+		}
+		this->batch.push_back(nextRecord);
+		this->batchRecordIds.push_back(nextRecord->getRecordId());
+	}
+	if(this->batchSize < MAX_BATCH_SIZE){
+		this->batchSize *= 2;
+	}
+
+	// select the records that this role can access and that are not deleted
+	IndexReadStateSharedPtr_Token & readToken = this->queryEvaluatorInternal->indexReadToken;
+	for(unsigned position = 0 ; position < this->batch.size() ; ++position){
+		bool isValid = false;
+		readToken.getForwardList(this->batchRecordIds[position], isValid);
+		if(isValid && hasAccessToRecord(this->batchRecordIds[position])){
+			this->selection.push_back(position);
 		}
-		const Schema * schema = queryEvaluatorInternal->getSchema();
-		if(hasAccessToRecord(nextRecord->getRecordId()) && doPass(schema, nextRecord)){
-			return nextRecord;
+	}
+	if(this->selection.empty()){
+		return;
+	}
+
+	vector<unsigned> candidates(this->selection);
+	if(this->filterQueryEvaluator->evaluateBatch(*readToken.readState->docValuesReadViewSharedPtr,
+			&this->batchRecordIds[0], this->selection)){
+		return;
+	}
+	// the filter cannot be evaluated on the columns
+	const Schema * schema = queryEvaluatorInternal->getSchema();
+	this->selection.clear();
+	for(vector<unsigned>::iterator position = candidates.begin() ; position != candidates.end() ; ++position){
+		if(doPass(schema, this->batch[*position])){
+			this->selection.push_back(*position);
 		}
 	}
-	ASSERT(false); // we can never reach to this point
-	return NULL;
 }
+
 bool FilterQueryOperator::close(PhysicalPlanExecutionParameters & params){
 	this->filterQueryEvaluator = NULL;
 	this->queryEvaluatorInternal = NULL;
+	this->attributes.clear();
+	this->attributeIds.clear();
+	this->batch.clear();
+	this->batchRecordIds.clear();
+	this->selection.clear();
 	this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->close(params);
 	return true;
 }
@@ -88,28 +162,29 @@ FilterQueryOperator::~FilterQueryOperator(){}
 FilterQueryOperator::FilterQueryOperator(RefiningAttributeExpressionEvaluator * filterQueryEvaluator, string &roleId) {
 	this->filterQueryEvaluator = filterQueryEvaluator;
 	this->roleId = roleId;
+	this->queryEvaluatorInternal = NULL;
+	this->nextSelected = 0;
+	this->batchSize = FIRST_BATCH_SIZE;
+	this->isChildExhausted = false;
 }
 
 bool FilterQueryOperator::doPass(const Schema * schema, PhysicalPlanRecordItem * record){
 	// Because we use this operator for filters and for access control. When we just have access control the filter query evaluator is NULL
 	if(this->filterQueryEvaluator == NULL) // filterQueryEvaluator is null. So we don't have any filter
 		return true;
-    // fetch the names and ids of non searchable attributes from schema
-    vector<string> attributes;
-    for(map<string,unsigned>::const_iterator attr = schema->getRefiningAttributes()->begin();
-            attr != schema->getRefiningAttributes()->end() ; ++attr ){
-        attributes.push_back(attr->first);
-    }
-
-    // now fetch the values of different attributes from forward index
+    // now fetch the values of different attributes from the doc values, or from forward index
+    // if some of them have no column (multi-valued attributes)
     vector<TypedValue> typedValues;
     bool isValid = false;
-    const ForwardList * list = this->queryEvaluatorInternal->indexReadToken.getForwardList(record->getRecordId() , isValid);
+    IndexReadStateSharedPtr_Token & readToken = this->queryEvaluatorInternal->indexReadToken;
+    const ForwardList * list = readToken.getForwardList(record->getRecordId() , isValid);
     // return false if this record is not valid (i.e., already deleted)
     if (!isValid)
       return false;
-    StoredRecordBuffer refiningAttributesData = list->getInMemoryData();
-    RecordSerializerUtil::getBatchOfAttributes(attributes, schema,refiningAttributesData.start.get() ,&typedValues);
+    if (!readToken.readState->docValuesReadViewSharedPtr->getBatchOfAttributes(attributeIds, record->getRecordId(), &typedValues)) {
+        StoredRecordBuffer refiningAttributesData = list->getInMemoryData();
+        RecordSerializerUtil::getBatchOfAttributes(attributes, schema,refiningAttributesData.start.get() ,&typedValues);
+    }
 
     // now call the evaluator to see if this record passes the criteria or not
     // A criterion can be for example price:12 or price:[* TO 100]
@@ -55,6 +55,12 @@ namespace instantsearch
  *       |_____________[SORT BY ID]___[Merge TopK]____[FilterQueryOperator]____[TVL A]
  *                                          |_________[FilterQueryOperator]____[TVL B]
  *
+ * The filter is evaluated on batches of records pulled from the child: the records that
+ * pass are kept in a selection vector and returned one by one by getNext(). Range and equality
+ * terms read the doc-values columns of the whole batch (see RefiningAttributeExpressionEvaluator::
+ * evaluateBatch()); other filters are evaluated record by record on the values of each record.
+ * The first batch is small and each batch doubles the size of the previous one, so a parent
+ * that only needs the first few results (e.g., top-k) does not pull many more records than it uses.
  */
 class FilterQueryOperator : public PhysicalPlanNode {
 public:
@@ -66,11 +72,28 @@ public:
 	~FilterQueryOperator();
 	FilterQueryOperator(RefiningAttributeExpressionEvaluator * filterQueryEvaluator, string &roleId) ;
 private:
+	static const unsigned FIRST_BATCH_SIZE = 16;
+	static const unsigned MAX_BATCH_SIZE = 1024;
+
+	// pulls the next batch of records from the child and selects the ones that pass
+	void fillBatch(const PhysicalPlanExecutionParameters & params);
 	bool doPass(const Schema * schema, PhysicalPlanRecordItem * record);
 	bool hasAccessToRecord(unsigned recordId); // check the access of the role to this record
 	RefiningAttributeExpressionEvaluator * filterQueryEvaluator;
 	QueryEvaluatorInternal * queryEvaluatorInternal;
 	string roleId;   // role id for access control
+	// the names and ids of the refining attributes passed to the evaluator, found in open()
+	vector<string> attributes;
+	vector<unsigned> attributeIds;
+
+	// the current batch, the ids of its records and the positions in the batch of the records that pass
+	vector<PhysicalPlanRecordItem *> batch;
+	vector<unsigned> batchRecordIds;
+	vector<unsigned> selection;
+	// the position in selection of the next record to return
+	unsigned nextSelected;
+	unsigned batchSize;
+	bool isChildExhausted;
 };
 
 class FilterQueryOptimizationOperator : public PhysicalPlanOptimizationNode {
@@ -55,7 +55,7 @@ GeoNearestNeighborOperator::~GeoNearestNeighborOperator(){
 bool GeoNearestNeighborOperator::open(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanExecutionParameters & params){
 	this->queryEvaluator = queryEvaluator;
 	// get the forward list read view
-	this->forwardListDirectoryReadView = this->queryEvaluator->indexReadToken.forwardIndexReadViewSharedPtr;
+	this->forwardListDirectoryReadView = this->queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
 	// finding the query region
 	this->queryShape = this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode()->regionShape;
 	// get quadTreeNodeSet which contains all the subtrees in quadtree which have the answers
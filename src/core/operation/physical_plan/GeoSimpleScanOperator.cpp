@@ -55,7 +55,7 @@ bool GeoSimpleScanOperator::open(QueryEvaluatorInternal * queryEvaluator, Physic
 	// first save the pointer to QueryEvaluator
 	this->queryEvaluator = queryEvaluator;
 	// get the forward list read view
-	this->forwardListDirectoryReadView = this->queryEvaluator->indexReadToken.forwardIndexReadViewSharedPtr;
+	this->forwardListDirectoryReadView = this->queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
 	// get the query shape
 	this->queryShape = this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode()->regionShape;
 	// get quadTreeNodeSet which contains all the subtrees in quadtree which have the answers
@@ -139,7 +139,7 @@ bool KeywordSearchOperator::open(QueryEvaluatorInternal * queryEvaluator, Physic
 
 
         if(fuzzyPolicyIter == 0){
-            if(isFuzzy == true && results.size() < params.k){
+            if(isFuzzy == true && results.size() < params.k && !queryEvaluator->isCancelled()){
                 logicalPlan->setFuzzy(true);
                 params.isFuzzy = true;
             }else{
@@ -44,7 +44,7 @@ bool MergeByShortestListOperator::open(QueryEvaluatorInternal * queryEvaluator,
 	this->queryEvaluator = queryEvaluator;
 
 	if(queryEvaluator != NULL){ // Only for mergeByShortestList test case queryEvaluator can be NULL
-		forwardListDirectoryReadView = queryEvaluator->indexReadToken.forwardIndexReadViewSharedPtr;
+		forwardListDirectoryReadView = queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
 	}
 
 	// prepare the cache key
@@ -126,6 +126,10 @@ PhysicalPlanRecordItem * MergeByShortestListOperator::getNext(const PhysicalPlan
 	}
 
 	while(true){
+		// a cancelled search stops here, the shortest list is kept as it is
+		if(this->queryEvaluator != NULL && this->queryEvaluator->isCancelled()){
+			return NULL;
+		}
 		PhysicalPlanRecordItem * nextRecord = NULL;
 		bool recordComesFromCache = false;
 		//1. get the next record from shortest list
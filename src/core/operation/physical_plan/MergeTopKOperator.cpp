@@ -48,7 +48,7 @@ bool MergeTopKOperator::open(QueryEvaluatorInternal * queryEvaluator, PhysicalPl
 	this->queryEvaluator = queryEvaluator;
 
 	if(this->queryEvaluator != NULL){ // only for mergeTopK ctest queryEvaluator can be NULL
-		forwardListDirectoryReadView = queryEvaluator->indexReadToken.forwardIndexReadViewSharedPtr;
+		forwardListDirectoryReadView = queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
 	}
 
 	if (params.feedbackRanker) {
@@ -272,6 +272,10 @@ PhysicalPlanRecordItem * MergeTopKOperator::getNext(const PhysicalPlanExecutionP
 	unsigned numberOfRecordsVisitedForOneResult = 0;
 	// Part2.
 	while(true){
+		// a cancelled search returns the best candidate so far, the lists are kept as they are
+		if(this->queryEvaluator != NULL && this->queryEvaluator->isCancelled()){
+			return topRecordToReturn;
+		}
 		//1.
 		unsigned childToGetNextRecordFrom = getNextChildForSequentialAccess(); // this function implements Round robin
 		//2.
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PhysicalOperators.h"
+#include "ParallelExchangeOperator.h"
+#include "operation/QueryEvaluatorInternal.h"
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace srch2 {
+namespace instantsearch {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////// run the child on the query thread pool //////////////////////////////
+
+ParallelExchangeOperator::ParallelExchangeOperator() {
+	this->queryEvaluator = NULL;
+	this->childParams = NULL;
+	this->recordItemPool = NULL;
+	this->taskGroup = NULL;
+	this->nextRecord = 0;
+	this->numberOfRecordsToPrefetch = INITIAL_NUMBER_OF_PREFETCHED_RECORDS;
+	this->childIsExhausted = false;
+}
+
+ParallelExchangeOperator::~ParallelExchangeOperator(){
+	// waits for the task without throwing, the error was not asked for
+	if(this->taskGroup != NULL){
+		delete this->taskGroup;
+	}
+	if(this->childParams != NULL){
+		delete this->childParams;
+	}
+	if(this->recordItemPool != NULL){
+		delete this->recordItemPool;
+	}
+}
+
+bool ParallelExchangeOperator::open(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanExecutionParameters & params){
+	ASSERT(this->getPhysicalPlanOptimizationNode()->getChildrenCount() == 1);
+	this->queryEvaluator = queryEvaluator;
+
+	// the subtree gets its own copy of the parameters, the ranker is created by the constructor
+	if(this->childParams != NULL){
+		delete this->childParams;
+	}
+	this->childParams = new PhysicalPlanExecutionParameters(params.k, params.isFuzzy, params.prefixMatchPenalty, params.searchType);
+	this->childParams->totalNumberOfRecords = params.totalNumberOfRecords;
+	// the cache entry given by the parent is only read by the child
+	this->childParams->parentIsCacheEnabled = params.parentIsCacheEnabled;
+	this->childParams->cacheObject = params.cacheObject;
+
+	if(this->recordItemPool == NULL){
+		this->recordItemPool = new PhysicalPlanRecordItemPool();
+	}
+
+	this->records.clear();
+	this->nextRecord = 0;
+	this->prefetchedRecords.clear();
+	this->numberOfRecordsToPrefetch = INITIAL_NUMBER_OF_PREFETCHED_RECORDS;
+	this->childIsExhausted = false;
+
+	this->taskGroup = new srch2::util::TaskGroup(srch2::util::WorkStealingThreadPool::getSharedPool());
+	this->taskGroup->run(boost::bind(&ParallelExchangeOperator::openChildAndPrefetchRecords, this));
+	return true;
+}
+
+PhysicalPlanRecordItem * ParallelExchangeOperator::getNext(const PhysicalPlanExecutionParameters & params) {
+	if(this->nextRecord == this->records.size()){
+		waitForChild();
+		this->records.swap(this->prefetchedRecords);
+		this->prefetchedRecords.clear();
+		this->nextRecord = 0;
+		if(this->records.empty()){
+			return NULL;
+		}
+		// the child is read while the parent merges these records
+		if(! this->childIsExhausted){
+			startPrefetchingRecords();
+		}
+	}
+	return this->records[this->nextRecord++];
+}
+
+bool ParallelExchangeOperator::close(PhysicalPlanExecutionParameters & params){
+	waitForChild();
+	this->childParams->cacheObject = NULL;
+	this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->close(*(this->childParams));
+	// the cache entry built by the child in close is returned to the parent
+	params.cacheObject = this->childParams->cacheObject;
+	this->queryEvaluator = NULL;
+	return true;
+}
+
+string ParallelExchangeOperator::toString(){
+	string result = "ParallelExchangeOperator" ;
+	if(this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode() != NULL){
+		result += this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode()->toString();
+	}
+	return result;
+}
+
+bool ParallelExchangeOperator::verifyByRandomAccess(PhysicalPlanRandomAccessVerificationParameters & parameters) {
+	waitForChild();
+	return this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->verifyByRandomAccess(parameters);
+}
+
+void ParallelExchangeOperator::openChildAndPrefetchRecords(){
+	// the operators of the subtree allocate their records from the pool of this operator
+	PhysicalPlanRecordItemPool * previousPool =
+			QueryEvaluatorInternal::setRecordItemPoolOfCurrentThread(this->recordItemPool);
+	try{
+		this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->open(this->queryEvaluator, *(this->childParams));
+	}catch(...){
+		QueryEvaluatorInternal::setRecordItemPoolOfCurrentThread(previousPool);
+		throw;
+	}
+	QueryEvaluatorInternal::setRecordItemPoolOfCurrentThread(previousPool);
+	prefetchRecords();
+}
+
+void ParallelExchangeOperator::prefetchRecords(){
+	PhysicalPlanRecordItemPool * previousPool =
+			QueryEvaluatorInternal::setRecordItemPoolOfCurrentThread(this->recordItemPool);
+	PhysicalPlanNode * child = this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode();
+	try{
+		while(this->prefetchedRecords.size() < this->numberOfRecordsToPrefetch){
+			PhysicalPlanRecordItem * record = child->getNext(*(this->childParams));
+			if(record == NULL){
+				this->childIsExhausted = true;
+				break;
+			}
+			this->prefetchedRecords.push_back(record);
+		}
+	}catch(...){
+		QueryEvaluatorInternal::setRecordItemPoolOfCurrentThread(previousPool);
+		throw;
+	}
+	QueryEvaluatorInternal::setRecordItemPoolOfCurrentThread(previousPool);
+}
+
+void ParallelExchangeOperator::startPrefetchingRecords(){
+	if(this->numberOfRecordsToPrefetch < MAXIMUM_NUMBER_OF_PREFETCHED_RECORDS){
+		this->numberOfRecordsToPrefetch *= 2;
+	}
+	this->taskGroup = new srch2::util::TaskGroup(srch2::util::WorkStealingThreadPool::getSharedPool());
+	this->taskGroup->run(boost::bind(&ParallelExchangeOperator::prefetchRecords, this));
+}
+
+void ParallelExchangeOperator::waitForChild(){
+	if(this->taskGroup == NULL){
+		return;
+	}
+	// the group is deleted even if wait throws the error of the task
+	boost::scoped_ptr<srch2::util::TaskGroup> taskGroup(this->taskGroup);
+	this->taskGroup = NULL;
+	taskGroup->wait();
+}
+
+// The cost of open of a child is considered only once in the cost computation
+// of parent open function.
+PhysicalPlanCost ParallelExchangeOptimizationOperator::getCostOfOpen(const PhysicalPlanExecutionParameters & params){
+	PhysicalPlanCost resultCost;
+	resultCost = resultCost + this->getChildAt(0)->getCostOfOpen(params);
+	return resultCost;
+}
+// The cost of getNext of a child is multiplied by the estimated number of calls to this function
+// when the cost of parent is being calculated.
+PhysicalPlanCost ParallelExchangeOptimizationOperator::getCostOfGetNext(const PhysicalPlanExecutionParameters & params) {
+	PhysicalPlanCost resultCost;
+	resultCost = resultCost + this->getChildAt(0)->getCostOfGetNext(params);
+	return resultCost;
+}
+// the cost of close of a child is only considered once since each node's close function is only called once.
+PhysicalPlanCost ParallelExchangeOptimizationOperator::getCostOfClose(const PhysicalPlanExecutionParameters & params) {
+	PhysicalPlanCost resultCost;
+	resultCost = resultCost + this->getChildAt(0)->getCostOfClose(params);
+	return resultCost;
+}
+PhysicalPlanCost ParallelExchangeOptimizationOperator::getCostOfVerifyByRandomAccess(const PhysicalPlanExecutionParameters & params){
+	PhysicalPlanCost resultCost;
+	resultCost = resultCost + this->getChildAt(0)->getCostOfVerifyByRandomAccess(params);
+	return resultCost;
+}
+void ParallelExchangeOptimizationOperator::getOutputProperties(IteratorProperties & prop){
+	// records are returned in the order of the child
+	this->getChildAt(0)->getOutputProperties(prop);
+}
+void ParallelExchangeOptimizationOperator::getRequiredInputProperties(IteratorProperties & prop){
+	// no input property is required for this operator
+}
+PhysicalPlanNodeType ParallelExchangeOptimizationOperator::getType() {
+	return PhysicalPlanNode_ParallelExchange;
+}
+bool ParallelExchangeOptimizationOperator::validateChildren(){
+	if(getChildrenCount() != 1){
+		return false;
+	}
+	switch (getChildAt(0)->getType()) {
+		case PhysicalPlanNode_RandomAccessTerm:
+		case PhysicalPlanNode_RandomAccessAnd:
+		case PhysicalPlanNode_RandomAccessOr:
+		case PhysicalPlanNode_RandomAccessNot:
+		case PhysicalPlanNode_RandomAccessGeo:
+			return false;
+		default:
+			return true;
+	}
+}
+
+}
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __WRAPPER_PARALLELEXCHANGEOPERATOR_H__
+#define __WRAPPER_PARALLELEXCHANGEOPERATOR_H__
+
+#include "instantsearch/Constants.h"
+#include "operation/PhysicalPlanRecordItemFactory.h"
+#include "util/WorkStealingThreadPool.h"
+#include "PhysicalPlan.h"
+
+using namespace std;
+
+namespace srch2 {
+namespace instantsearch {
+
+/*
+ * This operator runs its single child on a thread of the query thread pool
+ * (WorkStealingThreadPool::getSharedPool()) and returns the records of the child unchanged.
+ * The query optimizer puts it on top of the children of an OR or AND operator, so that the
+ * children are opened and read at the same time while the parent merges their records on the
+ * query thread as before.
+ *
+ * open returns immediately; the task opens the child and reads its first records into a buffer.
+ * When getNext has returned the buffered records, it takes the next ones, which a new task read
+ * in the meantime, and starts reading the following ones. Each task reads twice as many records
+ * as the previous one, up to MAXIMUM_NUMBER_OF_PREFETCHED_RECORDS, so a parent which stops after
+ * its top k records makes the child read few records it does not need.
+ *
+ * verifyByRandomAccess and close wait for the running task, because the operators are not thread
+ * safe. So do getNext and the destructor. An exception thrown by the child in a task is thrown again
+ * by the next of these calls on the query thread. The subtree uses its own execution parameters
+ * (without the feedback ranker) and its own record item pool, because neither is thread safe.
+ */
+class ParallelExchangeOperator : public PhysicalPlanNode {
+	friend class PhysicalOperatorFactory;
+public:
+	bool open(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanExecutionParameters & params);
+	PhysicalPlanRecordItem * getNext(const PhysicalPlanExecutionParameters & params) ;
+	bool close(PhysicalPlanExecutionParameters & params);
+	string toString();
+	bool verifyByRandomAccess(PhysicalPlanRandomAccessVerificationParameters & parameters) ;
+	~ParallelExchangeOperator();
+private:
+	ParallelExchangeOperator();
+
+	static const unsigned INITIAL_NUMBER_OF_PREFETCHED_RECORDS = 64;
+	static const unsigned MAXIMUM_NUMBER_OF_PREFETCHED_RECORDS = 4096;
+
+	// run on a thread of the pool
+	void openChildAndPrefetchRecords();
+	void prefetchRecords();
+	void startPrefetchingRecords();
+	// waits for the running task, if any, and throws its error
+	void waitForChild();
+
+	QueryEvaluatorInternal * queryEvaluator;
+	PhysicalPlanExecutionParameters * childParams;
+	// the records of the subtree are allocated from this pool, they live as long as the operator
+	PhysicalPlanRecordItemPool * recordItemPool;
+	srch2::util::TaskGroup * taskGroup;
+
+	// the records getNext returns, and the next of them
+	vector<PhysicalPlanRecordItem *> records;
+	unsigned nextRecord;
+	// written by the task
+	vector<PhysicalPlanRecordItem *> prefetchedRecords;
+	unsigned numberOfRecordsToPrefetch;
+	bool childIsExhausted;
+};
+
+class ParallelExchangeOptimizationOperator : public PhysicalPlanOptimizationNode {
+	friend class PhysicalOperatorFactory;
+public:
+	// The cost of open of a child is considered only once in the cost computation
+	// of parent open function.
+	PhysicalPlanCost getCostOfOpen(const PhysicalPlanExecutionParameters & params) ;
+	// The cost of getNext of a child is multiplied by the estimated number of calls to this function
+	// when the cost of parent is being calculated.
+	PhysicalPlanCost getCostOfGetNext(const PhysicalPlanExecutionParameters & params) ;
+	// the cost of close of a child is only considered once since each node's close function is only called once.
+	PhysicalPlanCost getCostOfClose(const PhysicalPlanExecutionParameters & params) ;
+	PhysicalPlanCost getCostOfVerifyByRandomAccess(const PhysicalPlanExecutionParameters & params);
+	void getOutputProperties(IteratorProperties & prop);
+	void getRequiredInputProperties(IteratorProperties & prop);
+	PhysicalPlanNodeType getType() ;
+	bool validateChildren();
+};
+
+}
+}
+
+#endif //__WRAPPER_PARALLELEXCHANGEOPERATOR_H__
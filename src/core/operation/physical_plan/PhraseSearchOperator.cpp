@@ -94,8 +94,8 @@ PhysicalPlanRecordItem * PhraseSearchOperator::getNext(const PhysicalPlanExecuti
         }
         vector<unsigned> listOfSlopDistances;
         if (matchPhrase(forwardListPtr, this->phraseSearchInfo, listOfSlopDistances)){
-        	vector<TermType>& recordMatchingTermTypes = nextRecord->getTermTypesRef();
-        	for (unsigned i = 0; i < recordMatchingTermTypes.size(); ++i) {
+        	TermType * recordMatchingTermTypes = nextRecord->getTermTypesArray();
+        	for (unsigned i = 0; i < nextRecord->getNumberOfTermTypes(); ++i) {
         		recordMatchingTermTypes[i] = TERM_TYPE_PHRASE;
         	}
         	//We check length of listOfSlops for defensive programming.
@@ -150,7 +150,8 @@ bool PhraseSearchOperator::verifyByRandomAccess(PhysicalPlanRandomAccessVerifica
 
     vector<unsigned> listOfSlops;
     if (matchPhrase(forwardListPtr, this->phraseSearchInfo, listOfSlops)){
-    	vector<TermType> recordMatchingTermTypes = parameters.recordToVerify->getTermTypesRef();
+    	vector<TermType> recordMatchingTermTypes;
+    	parameters.recordToVerify->getTermTypes(recordMatchingTermTypes);
     	for (unsigned i = 0; i < recordMatchingTermTypes.size(); ++i) {
     		recordMatchingTermTypes[i] = TERM_TYPE_PHRASE;
     	}
@@ -29,6 +29,8 @@
 #include "UnionLowestLevelSimpleScanOperator.h"
 #include "UnionLowestLevelSuggestionOperator.h"
 #include "MergeTopKOperator.h"
+#include "UnionTopKBlockMaxOperator.h"
+#include "ParallelExchangeOperator.h"
 #include "FilterQueryOperator.h"
 #include "PhraseSearchOperator.h"
 #include "FeedbackRankingOperator.h"
@@ -155,6 +157,16 @@ UnionSortedByIDOptimizationOperator * PhysicalOperatorFactory::createUnionSorted
 	optimizationNodes.push_back(op);
 	return op;
 }
+UnionTopKBlockMaxOperator * PhysicalOperatorFactory::createUnionTopKBlockMaxOperator(){
+	UnionTopKBlockMaxOperator *  op = new UnionTopKBlockMaxOperator();
+	executionNodes.push_back(op);
+	return op;
+}
+UnionTopKBlockMaxOptimizationOperator * PhysicalOperatorFactory::createUnionTopKBlockMaxOptimizationOperator(){
+	UnionTopKBlockMaxOptimizationOperator *  op = new UnionTopKBlockMaxOptimizationOperator();
+	optimizationNodes.push_back(op);
+	return op;
+}
 UnionLowestLevelTermVirtualListOperator * PhysicalOperatorFactory::createUnionLowestLevelTermVirtualListOperator(){
 	UnionLowestLevelTermVirtualListOperator * op = new UnionLowestLevelTermVirtualListOperator();
 	executionNodes.push_back(op);
@@ -230,5 +242,15 @@ GeoSimpleScanOptimizationOperator * PhysicalOperatorFactory::createGeoSimpleScan
 	optimizationNodes.push_back(op);
 	return op;
 }
+ParallelExchangeOperator * PhysicalOperatorFactory::createParallelExchangeOperator(){
+	ParallelExchangeOperator * op = new ParallelExchangeOperator();
+	executionNodes.push_back(op);
+	return op;
+}
+ParallelExchangeOptimizationOperator * PhysicalOperatorFactory::createParallelExchangeOptimizationOperator(){
+	ParallelExchangeOptimizationOperator * op = new ParallelExchangeOptimizationOperator();
+	optimizationNodes.push_back(op);
+	return op;
+}
 }
 }
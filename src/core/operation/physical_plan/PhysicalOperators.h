@@ -50,6 +50,10 @@ class UnionLowestLevelSuggestionOperator;
 class UnionLowestLevelSuggestionOptimizationOperator;
 class MergeTopKOperator;
 class MergeTopKOptimizationOperator;
+class UnionTopKBlockMaxOperator;
+class UnionTopKBlockMaxOptimizationOperator;
+class ParallelExchangeOperator;
+class ParallelExchangeOptimizationOperator;
 class FilterQueryOperator;
 class FilterQueryOptimizationOperator;
 class PhysicalOperatorFactory;
@@ -627,6 +631,8 @@ public:
 	MergeByShortestListOptimizationOperator * createMergeByShortestListOptimizationOperator();
 	UnionSortedByIDOperator * createUnionSortedByIDOperator();
 	UnionSortedByIDOptimizationOperator * createUnionSortedByIDOptimizationOperator();
+	UnionTopKBlockMaxOperator * createUnionTopKBlockMaxOperator();
+	UnionTopKBlockMaxOptimizationOperator * createUnionTopKBlockMaxOptimizationOperator();
 	UnionLowestLevelTermVirtualListOperator * createUnionLowestLevelTermVirtualListOperator();
 	UnionLowestLevelTermVirtualListOptimizationOperator * createUnionLowestLevelTermVirtualListOptimizationOperator();
 	UnionLowestLevelSimpleScanOperator * createUnionLowestLevelSimpleScanOperator();
@@ -641,6 +647,8 @@ public:
 	GeoNearestNeighborOptimizationOperator * createGeoNearestNeighborOptimizationOperator();
 	GeoSimpleScanOperator * createGeoSimpleScanOperator();
 	GeoSimpleScanOptimizationOperator * createGeoSimpleScanOptimizationOperator();
+	ParallelExchangeOperator * createParallelExchangeOperator();
+	ParallelExchangeOptimizationOperator * createParallelExchangeOptimizationOperator();
 
 private:
 	vector<PhysicalPlanNode *> executionNodes;
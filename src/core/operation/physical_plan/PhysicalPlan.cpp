@@ -104,6 +104,12 @@ void PhysicalPlanOptimizationNode::printSubTree(unsigned indent){
 		case PhysicalPlanNode_UnionSortedById:
 			Logger::info("[OR SortedByID]");
 			break;
+		case PhysicalPlanNode_UnionTopKBlockMax:
+			Logger::info("[OR TopK BlockMax]");
+			break;
+		case PhysicalPlanNode_ParallelExchange:
+			Logger::info("[EXCHANGE]");
+			break;
 		case PhysicalPlanNode_UnionLowestLevelTermVirtualList:
 			Logger::info("[TVL]");
 			break;
@@ -76,6 +76,7 @@ struct PhysicalPlanExecutionParameters {
 	bool parentIsCacheEnabled;
 	PhysicalOperatorCacheObject * cacheObject ;
 	unsigned totalNumberOfRecords;
+	srch2is::QueryType searchType;
 
 	FeedbackRanker *feedbackRanker;
 
@@ -83,6 +84,7 @@ struct PhysicalPlanExecutionParameters {
 		this->k = k;
 		this->isFuzzy = isFuzzy ;
 		this->prefixMatchPenalty = prefixMatchPenalty;
+		this->searchType = searchType;
 		switch (searchType) {
 			case srch2is::SearchTypeTopKQuery:
 				this->ranker = new DefaultTopKRanker();
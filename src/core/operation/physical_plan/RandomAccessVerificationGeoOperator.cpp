@@ -46,7 +46,7 @@ namespace instantsearch {
 bool RandomAccessVerificationGeoOperator::open(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanExecutionParameters & params){
 	this->queryEvaluator = queryEvaluator;
 	// get the forward list read view
-	this->forwardListDirectoryReadView = this->queryEvaluator->indexReadToken.forwardIndexReadViewSharedPtr;
+	this->forwardListDirectoryReadView = this->queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
 	this->queryShape = this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode()->regionShape;
 
 	// finding the offset of the latitude and longitude attribute in the refining attributes' memory
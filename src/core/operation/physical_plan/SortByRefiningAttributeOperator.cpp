@@ -58,23 +58,32 @@ bool SortByRefiningAttributeOperator::open(QueryEvaluatorInternal * queryEvaluat
      */
     const vector<string> * attributes =
             sortEvaluator->getParticipatingAttributes();
+    vector<unsigned> attributeIds;
+    for(std::vector<string>::const_iterator attributesIterator = attributes->begin() ;
+            attributesIterator != attributes->end() ; ++attributesIterator){
+        attributeIds.push_back(schema->getRefiningAttributeId(*attributesIterator));
+    }
+    IndexReadStateSharedPtr_Token & readToken = queryEvaluatorInternal->indexReadToken;
 
-    // 2. extract the data from forward index.
+    // 2. extract the data from the doc values, or from forward index if some of the attributes
+    //    have no column (multi-valued attributes).
     while(true){
     	PhysicalPlanRecordItem * nextRecord = this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->getNext(params);
     	if(nextRecord == NULL){
           break;
     	}
     	bool isValid = false;
-	const ForwardList * list = queryEvaluatorInternal->indexReadToken.getForwardList(nextRecord->getRecordId(), isValid);
+	const ForwardList * list = readToken.getForwardList(nextRecord->getRecordId(), isValid);
 	if (!isValid) // ignore the record if it's already deleted
           continue;
     	results.push_back(nextRecord);
-	const Byte * refiningAttributesData =
-			list->getInMemoryData().start.get();
-	// now parse the values by VariableLengthAttributeContainer
 	vector<TypedValue> typedValues;
-	RecordSerializerUtil::getBatchOfAttributes(*attributes, schema , refiningAttributesData,&typedValues);
+	if (!readToken.readState->docValuesReadViewSharedPtr->getBatchOfAttributes(attributeIds, nextRecord->getRecordId(), &typedValues)) {
+		const Byte * refiningAttributesData =
+				list->getInMemoryData().start.get();
+		// now parse the values by VariableLengthAttributeContainer
+		RecordSerializerUtil::getBatchOfAttributes(*attributes, schema , refiningAttributesData,&typedValues);
+	}
 	// save the values in QueryResult objects
 	for(std::vector<string>::const_iterator attributesIterator = attributes->begin() ;
 			attributesIterator != attributes->end() ; ++attributesIterator){
@@ -54,8 +54,8 @@ bool SortByScoreOperator::open(QueryEvaluatorInternal * queryEvaluator, Physical
 	// open the single child
 	this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->open(queryEvaluator,params);
 
-	// now get all the records from the child and sort them
-	while(true){
+	// now get all the records from the child and sort them, or the records found until the search was cancelled
+	while(queryEvaluator == NULL || !queryEvaluator->isCancelled()){
 		PhysicalPlanRecordItem * nextRecord = this->getPhysicalPlanOptimizationNode()->getChildAt(0)->getExecutableNode()->getNext(params);
 		if(nextRecord == NULL){
 			break;
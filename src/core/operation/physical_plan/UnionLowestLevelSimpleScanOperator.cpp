@@ -27,6 +27,7 @@
 
 #include "UnionLowestLevelSimpleScanOperator.h"
 #include "operation/QueryEvaluatorInternal.h"
+#include "operation/QueryStatistics.h"
 #include "PhysicalOperatorsHelper.h"
 
 namespace srch2 {
@@ -42,8 +43,8 @@ namespace instantsearch {
 UnionLowestLevelSimpleScanOperator::UnionLowestLevelSimpleScanOperator() {
     queryEvaluator = NULL;
     parentIsCacheEnabled = false;
-    cursorOnInvertedList = 0;
     invertedListOffset = 0;
+    numberOfScannedPostings = 0;
 }
 
 UnionLowestLevelSimpleScanOperator::~UnionLowestLevelSimpleScanOperator(){
@@ -51,9 +52,10 @@ UnionLowestLevelSimpleScanOperator::~UnionLowestLevelSimpleScanOperator(){
 bool UnionLowestLevelSimpleScanOperator::open(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanExecutionParameters & params){
     // first save the pointer to QueryEvaluator
     this->queryEvaluator = queryEvaluator;
-    invertedListDirectoryReadView = this->queryEvaluator->indexReadToken.invertedIndexReadViewSharedPtr;
-    invertedIndexKeywordIdsReadView = this->queryEvaluator->indexReadToken.invertedIndexKeywordIdsReadViewSharedPtr;
-    forwardIndexDirectoryReadView = this->queryEvaluator->indexReadToken.forwardIndexReadViewSharedPtr;
+    this->numberOfScannedPostings = 0;
+    invertedListDirectoryReadView = this->queryEvaluator->indexReadToken.readState->invertedIndexReadViewSharedPtr;
+    invertedIndexKeywordIdsReadView = this->queryEvaluator->indexReadToken.readState->invertedIndexKeywordIdsReadViewSharedPtr;
+    forwardIndexDirectoryReadView = this->queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
 
     // 1. get the pointer to logical plan node
     LogicalPlanNode * logicalPlanNode = this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode();
@@ -71,14 +73,13 @@ bool UnionLowestLevelSimpleScanOperator::open(QueryEvaluatorInternal * queryEval
             unsigned distance;
             iter.getItem(prefixNode, leafNode, distance);
             // get inverted list pointer and save it
-            shared_ptr<vectorview<unsigned> > invertedListReadView;
-            this->queryEvaluator->indexReadToken.getInvertedListReadView(leafNode->getInvertedListOffset() , invertedListReadView);
+            InvertedListCursor invertedListCursor;
+            this->queryEvaluator->indexReadToken.getInvertedListCursor(leafNode->getInvertedListOffset() , invertedListCursor);
             //Empty inverted lists should not be included in the lists of lowest level operators.
-            if(invertedListReadView->size() == 0){
+            if(invertedListCursor.size() == 0){
             	continue;
             }
-            this->invertedListsSharedPointers.push_back(invertedListReadView);
-            this->invertedLists.push_back(invertedListReadView.get());
+            this->invertedListCursors.push_back(invertedListCursor);
             this->invertedListPrefixes.push_back(prefixNode);
             this->invertedListLeafNodes.push_back(leafNode);
             this->invertedListDistances.push_back(distance);
@@ -92,14 +93,13 @@ bool UnionLowestLevelSimpleScanOperator::open(QueryEvaluatorInternal * queryEval
 			unsigned editDistance;
 			iter.getItem(trieNode, editDistance);
 	        // get inverted list pointer and save it
-	        shared_ptr<vectorview<unsigned> > invertedListReadView;
-	        this->queryEvaluator->indexReadToken.getInvertedListReadView(trieNode->getInvertedListOffset() , invertedListReadView);
+	        InvertedListCursor invertedListCursor;
+	        this->queryEvaluator->indexReadToken.getInvertedListCursor(trieNode->getInvertedListOffset() , invertedListCursor);
 	        //Empty inverted lists should not be included in the lists of lowest level operators.
-            if(invertedListReadView->size() == 0){
+            if(invertedListCursor.size() == 0){
             	continue;
             }
-	        this->invertedListsSharedPointers.push_back(invertedListReadView);
-	        this->invertedLists.push_back(invertedListReadView.get());
+	        this->invertedListCursors.push_back(invertedListCursor);
 	        this->invertedListPrefixes.push_back(trieNode);
 	        this->invertedListLeafNodes.push_back(trieNode);
 	        this->invertedListDistances.push_back(editDistance);
@@ -112,12 +112,13 @@ bool UnionLowestLevelSimpleScanOperator::open(QueryEvaluatorInternal * queryEval
         // either parent is not passing cache hit info or
         // there was no cache hit
         this->invertedListOffset = 0;
-        this->cursorOnInvertedList = 0;
     }else if(params.cacheObject != NULL){
         UnionLowestLevelSimpleScanCacheEntry * cacheEntry =
                 (UnionLowestLevelSimpleScanCacheEntry *)params.cacheObject;
         this->invertedListOffset = cacheEntry->invertedListOffset;
-        this->cursorOnInvertedList = cacheEntry->cursorOnInvertedList;
+        if(this->invertedListOffset < this->invertedListCursors.size()){
+            this->invertedListCursors.at(this->invertedListOffset).seek(cacheEntry->cursorOnInvertedList);
+        }
         this->parentIsCacheEnabled = true;
     }
 
@@ -126,8 +127,8 @@ bool UnionLowestLevelSimpleScanOperator::open(QueryEvaluatorInternal * queryEval
      */
     //cout << "\tshortestinfo(" << invertedListLeafNodes.size() << "$";
     //unsigned totalSizeOfInvertedLists = 0;
-    //for(unsigned ii = 0; ii < invertedLists.size() ; ++ii){
-    //	totalSizeOfInvertedLists += invertedLists.at(ii)->size();
+    //for(unsigned ii = 0; ii < invertedListCursors.size() ; ++ii){
+    //	totalSizeOfInvertedLists += invertedListCursors.at(ii).size();
     //}
     //cout << totalSizeOfInvertedLists << ")\t";
 
@@ -136,11 +137,12 @@ bool UnionLowestLevelSimpleScanOperator::open(QueryEvaluatorInternal * queryEval
 }
 PhysicalPlanRecordItem * UnionLowestLevelSimpleScanOperator::getNext(const PhysicalPlanExecutionParameters & params) {
 
-    if(this->invertedListOffset >= this->invertedLists.size()){
+    if(this->invertedListOffset >= this->invertedListCursors.size()){
         return NULL;
     }
+    InvertedListCursor * invertedListCursor = &this->invertedListCursors.at(this->invertedListOffset);
     // we dont have any list with size zero
-    ASSERT(this->cursorOnInvertedList < this->invertedLists.at(this->invertedListOffset)->size());
+    ASSERT(!invertedListCursor->isDone());
 
     // 1. get the pointer to logical plan node
     LogicalPlanNode * logicalPlanNode = this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode();
@@ -148,7 +150,8 @@ PhysicalPlanRecordItem * UnionLowestLevelSimpleScanOperator::getNext(const Physi
     Term * term = logicalPlanNode->getTerm(params.isFuzzy);
 
     // find the next record and check the its validity
-    unsigned recordID = this->invertedLists.at(this->invertedListOffset)->at(this->cursorOnInvertedList);
+    unsigned recordID = invertedListCursor->getRecordId();
+    this->numberOfScannedPostings++;
 
     unsigned keywordOffset =
             this->queryEvaluator->indexReadToken.getKeywordOffset(recordID, this->invertedListIDs.at(this->invertedListOffset));
@@ -165,17 +168,19 @@ PhysicalPlanRecordItem * UnionLowestLevelSimpleScanOperator::getNext(const Physi
         	foundValidHit = 1;
         	break;
         }
-        this->cursorOnInvertedList ++;
-        if (this->cursorOnInvertedList < this->invertedLists.at(this->invertedListOffset)->size()) {
-            recordID = this->invertedLists.at(this->invertedListOffset)->at(this->cursorOnInvertedList);
+        invertedListCursor->next();
+        if (!invertedListCursor->isDone()) {
+            recordID = invertedListCursor->getRecordId();
+            this->numberOfScannedPostings++;
             // calculate record offset online
             keywordOffset =
                         this->queryEvaluator->indexReadToken.getKeywordOffset(recordID, this->invertedListIDs.at(this->invertedListOffset));
         } else {
             this->invertedListOffset ++;
-            this->cursorOnInvertedList = 0;
-            if(this->invertedListOffset < this->invertedLists.size()){
-                recordID = this->invertedLists.at(this->invertedListOffset)->at(this->cursorOnInvertedList);
+            if(this->invertedListOffset < this->invertedListCursors.size()){
+                invertedListCursor = &this->invertedListCursors.at(this->invertedListOffset);
+                recordID = invertedListCursor->getRecordId();
+                this->numberOfScannedPostings++;
                 // calculate record offset online
                 keywordOffset =
                             this->queryEvaluator->indexReadToken.getKeywordOffset(recordID, this->invertedListIDs.at(this->invertedListOffset));
@@ -220,10 +225,9 @@ PhysicalPlanRecordItem * UnionLowestLevelSimpleScanOperator::getNext(const Physi
 
 
     // prepare for next call
-    this->cursorOnInvertedList ++;
-    if(this->cursorOnInvertedList >= this->invertedLists.at(this->invertedListOffset)->size()){
+    invertedListCursor->next();
+    if(invertedListCursor->isDone()){
         this->invertedListOffset ++;
-        this->cursorOnInvertedList = 0;
     }
 
 
@@ -233,19 +237,23 @@ bool UnionLowestLevelSimpleScanOperator::close(PhysicalPlanExecutionParameters &
 
     // set cache object
 	if(this->parentIsCacheEnabled){
+		unsigned cursorOnInvertedList = 0;
+		if(this->invertedListOffset < this->invertedListCursors.size()){
+			cursorOnInvertedList = this->invertedListCursors.at(this->invertedListOffset).getPosition();
+		}
 		UnionLowestLevelSimpleScanCacheEntry * cacheEntry =
-				new UnionLowestLevelSimpleScanCacheEntry(this->invertedListOffset , this->cursorOnInvertedList);
+				new UnionLowestLevelSimpleScanCacheEntry(this->invertedListOffset , cursorOnInvertedList);
 		params.cacheObject = cacheEntry;
 	}
 
-    this->invertedListsSharedPointers.clear();
-    this->invertedLists.clear();
+    this->invertedListCursors.clear();
     this->invertedListDistances.clear();
     this->invertedListLeafNodes.clear();
     this->invertedListPrefixes.clear();
     this->invertedListIDs.clear();
-    this->cursorOnInvertedList = 0;
     this->invertedListOffset = 0;
+    this->queryEvaluator->getQueryStatistics()->addScannedPostings(this->numberOfScannedPostings);
+    this->numberOfScannedPostings = 0;
     this->queryEvaluator = NULL;
 
     return true;
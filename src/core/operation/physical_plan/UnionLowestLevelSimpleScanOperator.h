@@ -73,14 +73,15 @@ private:
 	shared_ptr<vectorview<InvertedListContainerPtr> > invertedListDirectoryReadView;
     shared_ptr<vectorview<unsigned> > invertedIndexKeywordIdsReadView;
 	shared_ptr<vectorview<ForwardListPtr> >  forwardIndexDirectoryReadView;
-	vector< vectorview<unsigned> * > invertedLists;
-	vector< shared_ptr<vectorview<unsigned> > > invertedListsSharedPointers;
+	// cursors on the inverted lists, which decode compressed lists one block at a time
+	vector< InvertedListCursor > invertedListCursors;
 	vector< unsigned > invertedListDistances;
 	vector< TrieNodePointer > invertedListPrefixes;
 	vector< TrieNodePointer > invertedListLeafNodes;
 	vector<unsigned> invertedListIDs;
 	unsigned invertedListOffset;
-	unsigned cursorOnInvertedList;
+	// the postings read by getNext(), added to the query statistics by close()
+	unsigned numberOfScannedPostings;
 };
 
 class UnionLowestLevelSimpleScanCacheEntry : public PhysicalOperatorCacheObject {
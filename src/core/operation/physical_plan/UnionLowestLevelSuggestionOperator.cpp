@@ -43,9 +43,9 @@ UnionLowestLevelSuggestionOperator::~UnionLowestLevelSuggestionOperator(){
 bool UnionLowestLevelSuggestionOperator::open(QueryEvaluatorInternal * queryEvaluatorIntrnal, PhysicalPlanExecutionParameters & params){
 
     this->queryEvaluatorIntrnal = queryEvaluatorIntrnal;
-    invertedListDirectoryReadView = this->queryEvaluatorIntrnal->indexReadToken.invertedIndexReadViewSharedPtr;
-    invertedIndexKeywordIdsReadView = this->queryEvaluatorIntrnal->indexReadToken.invertedIndexKeywordIdsReadViewSharedPtr;
-    forwardIndexDirectoryReadView = this->queryEvaluatorIntrnal->indexReadToken.forwardIndexReadViewSharedPtr;
+    invertedListDirectoryReadView = this->queryEvaluatorIntrnal->indexReadToken.readState->invertedIndexReadViewSharedPtr;
+    invertedIndexKeywordIdsReadView = this->queryEvaluatorIntrnal->indexReadToken.readState->invertedIndexKeywordIdsReadViewSharedPtr;
+    forwardIndexDirectoryReadView = this->queryEvaluatorIntrnal->indexReadToken.readState->forwardIndexReadViewSharedPtr;
     // 1. first iterate on active nodes and find best estimated leaf nodes.
     Term * term = this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode()->getTerm(params.isFuzzy);
     unsigned numberOfSuggestionsToFind = 350;
@@ -59,17 +59,17 @@ bool UnionLowestLevelSuggestionOperator::open(QueryEvaluatorInternal * queryEval
             numberOfSuggestionsToFind , suggestionPairs);
 
 
-    // save shared pointer to inverted list read views for performance improvement
+    // save cursors on the inverted lists for performance improvement
     for(std::vector<SuggestionInfo >::iterator suggestionInfoItr = suggestionPairs.begin();
 			suggestionInfoItr != suggestionPairs.end(); ++suggestionInfoItr){
-        shared_ptr<vectorview<unsigned> > invertedListReadView;
-        queryEvaluatorIntrnal->indexReadToken.getInvertedListReadView(
-        		suggestionInfoItr->suggestedCompleteTermNode->getInvertedListOffset(), invertedListReadView);
+        InvertedListCursor invertedListCursor;
+        queryEvaluatorIntrnal->indexReadToken.getInvertedListCursor(
+        		suggestionInfoItr->suggestedCompleteTermNode->getInvertedListOffset(), invertedListCursor);
         //Empty inverted lists should not be included in the lists of lowest level operators.
-        if(invertedListReadView->size() == 0){
+        if(invertedListCursor.size() == 0){
         	continue;
         }
-        suggestionPairsInvertedListReadViews.push_back(invertedListReadView);
+        suggestionPairsInvertedListCursors.push_back(invertedListCursor);
 
     }
 
@@ -114,7 +114,7 @@ PhysicalPlanRecordItem * UnionLowestLevelSuggestionOperator::getNext(const Physi
 }
 bool UnionLowestLevelSuggestionOperator::close(PhysicalPlanExecutionParameters & params){
     suggestionPairs.clear();
-    suggestionPairsInvertedListReadViews.clear();
+    suggestionPairsInvertedListCursors.clear();
     recordItemsHeap.clear();
     return true;
 }
@@ -122,7 +122,7 @@ bool UnionLowestLevelSuggestionOperator::close(PhysicalPlanExecutionParameters &
 void UnionLowestLevelSuggestionOperator::initializeHeap(Term * term, Ranker * ranker, float prefixMatchPenalty){
 
 	// move on suggestions and for each one find the first valid record and put it in heap
-	for(unsigned suggestionIndex = 0 ; suggestionIndex < suggestionPairsInvertedListReadViews.size() ; ++suggestionIndex){
+	for(unsigned suggestionIndex = 0 ; suggestionIndex < suggestionPairsInvertedListCursors.size() ; ++suggestionIndex){
 
 		unsigned firstInvertedListCursotToAdd = 0;
 		vector<unsigned> matchedAttributeIdsList;
@@ -130,10 +130,10 @@ void UnionLowestLevelSuggestionOperator::initializeHeap(Term * term, Ranker * ra
 		while(true){
 			// inverted list of this suggestion is completely invalid so we don't put anything from this
 			// suggestion in heap
-			if(suggestionPairsInvertedListReadViews.at(suggestionIndex)->size() <= firstInvertedListCursotToAdd){
+			if(suggestionPairsInvertedListCursors.at(suggestionIndex).size() <= firstInvertedListCursotToAdd){
 				break;
 			}
-			unsigned recordId = suggestionPairsInvertedListReadViews.at(suggestionIndex)->getElement(firstInvertedListCursotToAdd);
+			unsigned recordId = suggestionPairsInvertedListCursors.at(suggestionIndex).getElement(firstInvertedListCursotToAdd);
 			unsigned keywordOffset = queryEvaluatorIntrnal->indexReadToken.getKeywordOffset(
 					recordId, suggestionPairs[suggestionIndex].suggestedCompleteTermNode->getInvertedListOffset());
 			// We check the record only if it's valid
@@ -180,10 +180,10 @@ bool UnionLowestLevelSuggestionOperator::getNextHeapItem(Term * term, Ranker * r
 	vector<unsigned> matchedAttributeIdsList;
 	float termRecordStaticScore = 0;
 	while(true){
-		if(suggestionPairsInvertedListReadViews.at(item.suggestionIndex)->size() <= firstInvertedListCursotToAdd){
+		if(suggestionPairsInvertedListCursors.at(item.suggestionIndex).size() <= firstInvertedListCursotToAdd){
 			break;
 		}
-		unsigned recordId = suggestionPairsInvertedListReadViews.at(item.suggestionIndex)->getElement(firstInvertedListCursotToAdd);
+		unsigned recordId = suggestionPairsInvertedListCursors.at(item.suggestionIndex).getElement(firstInvertedListCursotToAdd);
 		unsigned keywordOffset = queryEvaluatorIntrnal->indexReadToken.getKeywordOffset(
 				recordId, suggestionPairs[item.suggestionIndex].suggestedCompleteTermNode->getInvertedListOffset());
 		// We check the record only if it's valid
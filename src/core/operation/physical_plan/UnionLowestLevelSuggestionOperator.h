@@ -100,8 +100,8 @@ private:
 
 	// vector of all suggestions of the keyword
 	std::vector<SuggestionInfo > suggestionPairs;
-	// inverted lists corresponding to suggestions. We keep them in this vector for improving efficiency.
-	std::vector<shared_ptr<vectorview<unsigned> > > suggestionPairsInvertedListReadViews;
+	// cursors on the inverted lists corresponding to suggestions. We keep them in this vector for improving efficiency.
+	std::vector<InvertedListCursor> suggestionPairsInvertedListCursors;
 	// this heap keeps the most top unread records of inverted lists and always keeps the best one
 	// according to runtime score on top
 	std::vector<SuggestionCursorHeapItem> recordItemsHeap;
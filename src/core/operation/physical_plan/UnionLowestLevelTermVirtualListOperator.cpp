@@ -27,6 +27,7 @@
 
 #include "UnionLowestLevelTermVirtualListOperator.h"
 #include "operation/QueryEvaluatorInternal.h"
+#include "operation/QueryStatistics.h"
 #include "PhysicalOperatorsHelper.h"
 #include "cmath"
 
@@ -41,6 +42,7 @@ namespace instantsearch {
 
 UnionLowestLevelTermVirtualListOperator::UnionLowestLevelTermVirtualListOperator() {
     this->parentIsCacheEnabled = false;
+    this->numberOfScannedPostings = 0;
 }
 
 UnionLowestLevelTermVirtualListOperator::~UnionLowestLevelTermVirtualListOperator(){
@@ -52,14 +54,15 @@ bool UnionLowestLevelTermVirtualListOperator::open(QueryEvaluatorInternal * quer
 
 	// first save the pointer to QueryEvaluator
 	this->queryEvaluator = queryEvaluator;
+	this->numberOfScannedPostings = 0;
 	// 1. get the pointer to logical plan node
 	LogicalPlanNode * logicalPlanNode = this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode();
 	// 2. Get the Term object
 	Term * term = logicalPlanNode->getTerm(params.isFuzzy);
 
-	this->invertedListDirectoryReadView = this->queryEvaluator->indexReadToken.invertedIndexReadViewSharedPtr;
-	invertedIndexKeywordIdsReadView = this->queryEvaluator->indexReadToken.invertedIndexKeywordIdsReadViewSharedPtr;
-	forwardIndexDirectoryReadView = this->queryEvaluator->indexReadToken.forwardIndexReadViewSharedPtr;
+	this->invertedListDirectoryReadView = this->queryEvaluator->indexReadToken.readState->invertedIndexReadViewSharedPtr;
+	invertedIndexKeywordIdsReadView = this->queryEvaluator->indexReadToken.readState->invertedIndexKeywordIdsReadViewSharedPtr;
+	forwardIndexDirectoryReadView = this->queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
     this->prefixActiveNodeSet = logicalPlanNode->stats->getActiveNodeSetForEstimation(params.isFuzzy);
     this->term = term;
     this->prefixMatchPenalty = params.prefixMatchPenalty;
@@ -69,7 +72,7 @@ bool UnionLowestLevelTermVirtualListOperator::open(QueryEvaluatorInternal * quer
 	if (this->getTermType() == TERM_TYPE_PREFIX) { //case 1: Term is prefix
 		LeafNodeSetIteratorForPrefix iter(prefixActiveNodeSet.get(), term->getThreshold());
 		cursorVector.reserve(iter.size());
-		invertedListReadViewVector.reserve(iter.size());
+		invertedListCursorVector.reserve(iter.size());
 		for (; !iter.isDone(); iter.next()) {
 			TrieNodePointer leafNode;
 			TrieNodePointer prefixNode;
@@ -90,7 +93,7 @@ bool UnionLowestLevelTermVirtualListOperator::open(QueryEvaluatorInternal * quer
 		// We will keep the smaller one according to  https://bitbucket.org/srch2inc/srch2-ngn/src/2b4293ccaccaaecd9c16526bd5c6bbfd02dded52/src/core/operation/ActiveNode.h?at=master#cl-457
 		LeafNodeSetIteratorForComplete iter(prefixActiveNodeSet.get() , term->getThreshold());
 		cursorVector.reserve(iter.size());
-		invertedListReadViewVector.reserve(iter.size());
+		invertedListCursorVector.reserve(iter.size());
 		for(; !iter.isDone(); iter.next()){
 			TrieNodePointer trieNode;
 			unsigned editDistance;
@@ -163,8 +166,8 @@ PhysicalPlanRecordItem * UnionLowestLevelTermVirtualListOperator::getNext(const
 
         unsigned currentHeapMaxCursor = this->cursorVector[currentHeapMax->cursorVectorPosition];
         unsigned currentHeapMaxInvertetedListId = currentHeapMax->invertedListId;
-        const shared_ptr<vectorview<unsigned> > &currentHeapMaxInvertedList = this->invertedListReadViewVector[currentHeapMax->cursorVectorPosition];
-        unsigned currentHeapMaxInvertedListSize = currentHeapMaxInvertedList->size();
+        InvertedListCursor &currentHeapMaxInvertedList = this->invertedListCursorVector[currentHeapMax->cursorVectorPosition];
+        unsigned currentHeapMaxInvertedListSize = currentHeapMaxInvertedList.size();
 
         bool foundValidHit = 0;
 
@@ -172,8 +175,9 @@ PhysicalPlanRecordItem * UnionLowestLevelTermVirtualListOperator::getNext(const
         while (currentHeapMaxCursor < currentHeapMaxInvertedListSize) {
             // InvertedList has more elements. Push invertedListElement at cursor into virtualList.
 
-            unsigned recordId = currentHeapMaxInvertedList->getElement(currentHeapMaxCursor);
+            unsigned recordId = currentHeapMaxInvertedList.getElement(currentHeapMaxCursor);
             // calculate record offset online
+            this->numberOfScannedPostings++;
             unsigned keywordOffset = this->queryEvaluator->indexReadToken.getKeywordOffset(recordId, currentHeapMaxInvertetedListId);
             vector<unsigned> matchedAttributeIdsList;
             currentHeapMaxCursor++;
@@ -232,6 +236,7 @@ bool UnionLowestLevelTermVirtualListOperator::close(PhysicalPlanExecutionParamet
 		params.cacheObject = cacheEntry;
 	}
 
+    queryEvaluator->getQueryStatistics()->addScannedPostings(this->numberOfScannedPostings);
     queryEvaluator = NULL;
     for (vector<UnionLowestLevelTermVirtualListOperatorHeapItem* >::iterator iter = this->itemsHeap.begin(); iter != this->itemsHeap.end(); iter++) {
         UnionLowestLevelTermVirtualListOperatorHeapItem *currentItem = *iter;
@@ -240,7 +245,7 @@ bool UnionLowestLevelTermVirtualListOperator::close(PhysicalPlanExecutionParamet
     }
     this->itemsHeap.clear();
     this->cursorVector.clear();
-    this->invertedListReadViewVector.clear();
+    this->invertedListCursorVector.clear();
     this->term = NULL;
     // We don't delete activenodesets here. Be careful to delete them by PhysicalPlanNode
     return true;
@@ -329,14 +334,15 @@ void UnionLowestLevelTermVirtualListOperator::initialiseTermVirtualListElement(T
     unsigned invertedListId = leafNode->getInvertedListOffset();
     unsigned invertedListCounter = 0;
 
-    shared_ptr<vectorview<unsigned> > invertedListReadView;
-    this->queryEvaluator->indexReadToken.getInvertedListReadView(invertedListId, invertedListReadView);
+    InvertedListCursor invertedListCursor;
+    this->queryEvaluator->indexReadToken.getInvertedListCursor(invertedListId, invertedListCursor);
     //Empty inverted lists should not be included in the lists of lowest level operators.
-    if(invertedListReadView->size() == 0){
+    if(invertedListCursor.size() == 0){
     	return;
     }
-    unsigned recordId = invertedListReadView->getElement(invertedListCounter);
+    unsigned recordId = invertedListCursor.getElement(invertedListCounter);
     // calculate record offset online
+    this->numberOfScannedPostings++;
     unsigned keywordOffset = this->queryEvaluator->indexReadToken.getKeywordOffset(recordId, invertedListId);
     ++ invertedListCounter;
 
@@ -353,9 +359,10 @@ void UnionLowestLevelTermVirtualListOperator::initialiseTermVirtualListElement(T
             break;
         }
 
-        if (invertedListCounter < invertedListReadView->size()) {
-            recordId = invertedListReadView->getElement(invertedListCounter);
+        if (invertedListCounter < invertedListCursor.size()) {
+            recordId = invertedListCursor.getElement(invertedListCounter);
             // calculate record offset online
+            this->numberOfScannedPostings++;
             keywordOffset = this->queryEvaluator->indexReadToken.getKeywordOffset(recordId, invertedListId);
             ++invertedListCounter;
         } else {
@@ -398,8 +405,8 @@ void UnionLowestLevelTermVirtualListOperator::initialiseTermVirtualListElement(T
 
         // Cursor points to the next element on InvertedList
         this->cursorVector.push_back(invertedListCounter);
-        // keep the inverted list readviews in invertedListVector such that we can safely access them
-        this->invertedListReadViewVector.push_back(invertedListReadView);
+        // keep the inverted list cursors such that we can safely access the lists
+        this->invertedListCursorVector.push_back(invertedListCursor);
     }
 }
 
@@ -203,6 +203,8 @@ private:
     bool parentIsCacheEnabled;
 
     QueryEvaluatorInternal * queryEvaluator;
+    // the postings read from the inverted lists, added to the query statistics by close()
+    unsigned numberOfScannedPostings;
     // the current recordId, initial value is -1
     int currentRecordID;
     // current inverted list Readview
@@ -225,8 +227,9 @@ private:
      *
      * Enables the functions getCursors and setCursors for Caching purpose
      */
-    // a vector to keep all the inverted list readviews in current term virtual list
-    vector<shared_ptr<vectorview<unsigned> > > invertedListReadViewVector;
+    // a vector to keep the cursors of all the inverted lists in current term virtual list.
+    // The cursors keep the read views alive and decode compressed lists one block at a time.
+    vector<InvertedListCursor> invertedListCursorVector;
     vector<unsigned> cursorVector;
 };
 
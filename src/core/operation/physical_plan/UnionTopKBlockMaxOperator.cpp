@@ -0,0 +1,523 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PhysicalOperators.h"
+#include "UnionTopKBlockMaxOperator.h"
+#include "operation/QueryEvaluatorInternal.h"
+#include "operation/QueryStatistics.h"
+#include "PhysicalOperatorsHelper.h"
+#include "FeedbackRankingOperator.h"
+#include <cmath>
+
+namespace srch2 {
+namespace instantsearch {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////// union with topK using block max scores //////////////////////////////
+#ifdef ANDROID
+   double inline log2(double x) { return log(x) / log (2);  }
+#endif
+
+UnionTopKBlockMaxOperator::UnionTopKBlockMaxOperator() {
+	this->queryEvaluator = NULL;
+	this->feedbackRanker = NULL;
+	this->numberOfReadBlocks = 0;
+	this->numberOfScannedPostings = 0;
+}
+
+UnionTopKBlockMaxOperator::~UnionTopKBlockMaxOperator(){
+	delete this->feedbackRanker;
+	/*
+	 *   list items are deleted in the close function.
+	 */
+}
+
+bool UnionTopKBlockMaxOperator::open(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanExecutionParameters & params){
+
+	this->queryEvaluator = queryEvaluator;
+	this->forwardListDirectoryReadView = queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr;
+	this->prefixMatchPenalty = params.prefixMatchPenalty;
+	this->isFuzzy = params.isFuzzy;
+	this->numberOfReadBlocks = 0;
+	this->numberOfScannedPostings = 0;
+
+	if (params.feedbackRanker) {
+		// store the ranker object and do not pass it to children.
+		this->feedbackRanker = params.feedbackRanker;
+		params.feedbackRanker = NULL;
+	}
+
+	/*
+	 * 1. find the leaf nodes of all terms, like TVL does, and prepare a cursor on their inverted lists
+	 * 2. compute the upper bound of each list from its skip data and make the heap of lists
+	 * Children are not opened, they only describe the terms.
+	 */
+	for(unsigned childOffset = 0 ; childOffset != this->getPhysicalPlanOptimizationNode()->getChildrenCount() ; ++childOffset){
+		LogicalPlanNode * termLogicalPlanNode =
+				this->getPhysicalPlanOptimizationNode()->getChildAt(childOffset)->getLogicalPlanNode();
+		Term * term = termLogicalPlanNode->getTerm(params.isFuzzy);
+		this->terms.push_back(term);
+		boost::shared_ptr<PrefixActiveNodeSet> prefixActiveNodeSet =
+				termLogicalPlanNode->stats->getActiveNodeSetForEstimation(params.isFuzzy);
+		if (term->getTermType() == TERM_TYPE_PREFIX) {
+			for (LeafNodeSetIteratorForPrefix iter(prefixActiveNodeSet.get(), term->getThreshold()); !iter.isDone(); iter.next()) {
+				TrieNodePointer leafNode;
+				TrieNodePointer prefixNode;
+				unsigned distance;
+				iter.getItem(prefixNode, leafNode, distance);
+				initializeListItem(childOffset, prefixNode, leafNode, distance, prefixNode != leafNode);
+			}
+		} else {
+			for (LeafNodeSetIteratorForComplete iter(prefixActiveNodeSet.get(), term->getThreshold()); !iter.isDone(); iter.next()) {
+				TrieNodePointer trieNode;
+				unsigned editDistance;
+				iter.getItem(trieNode, editDistance);
+				initializeListItem(childOffset, trieNode, trieNode, editDistance, false);
+			}
+		}
+	}
+	make_heap(this->listsHeap.begin(), this->listsHeap.end(), UnionTopKBlockMaxOperator::ListItemCmp());
+
+	this->candidates.clear();
+	this->candidatesHeap.clear();
+	return true;
+}
+
+PhysicalPlanRecordItem * UnionTopKBlockMaxOperator::getNext(const PhysicalPlanExecutionParameters & params) {
+	/*
+	 * 1. find the best candidate which is not returned yet
+	 * 2. if its score is higher than the bound of all lists, no unread record can beat it and no unread
+	 * ---- match can change its score, so return it.
+	 * 3. else, read the next block of the list with the highest bound and go to 1.
+	 */
+	float maxFeedbackBoostForQuery = 1.0;
+	if (this->feedbackRanker)
+		maxFeedbackBoostForQuery = this->feedbackRanker->getMaxBoostForThisQuery();
+
+	while(true){
+		CandidateHeapEntry bestCandidate;
+		bool hasCandidate = getBestCandidate(bestCandidate);
+		// a cancelled search returns the candidates read so far
+		if(this->listsHeap.empty() || this->queryEvaluator->isCancelled()){
+			if(hasCandidate == false){
+				return NULL;
+			}
+			break;
+		}
+		float maxScoreOfUnreadRecords = Ranker::computeFeedbackBoostedScore(
+				this->listsHeap.front()->upperBound, maxFeedbackBoostForQuery);
+		if(hasCandidate && bestCandidate.first > maxScoreOfUnreadRecords){
+			break;
+		}
+
+		pop_heap(this->listsHeap.begin(), this->listsHeap.end(), UnionTopKBlockMaxOperator::ListItemCmp());
+		UnionTopKBlockMaxListItem * listItem = this->listsHeap.back();
+		this->listsHeap.pop_back();
+		readNextBlock(listItem);
+		if(computeUpperBound(listItem)){
+			this->listsHeap.push_back(listItem);
+			push_heap(this->listsHeap.begin(), this->listsHeap.end(), UnionTopKBlockMaxOperator::ListItemCmp());
+		}
+	}
+
+	CandidateHeapEntry bestCandidate = this->candidatesHeap.front();
+	pop_heap(this->candidatesHeap.begin(), this->candidatesHeap.end(), UnionTopKBlockMaxOperator::CandidateHeapEntryCmp());
+	this->candidatesHeap.pop_back();
+	return prepareRecordItem(bestCandidate.second, bestCandidate.first);
+}
+
+bool UnionTopKBlockMaxOperator::close(PhysicalPlanExecutionParameters & params){
+	for (unsigned i = 0; i < this->listItems.size(); ++i) {
+		delete this->listItems[i];
+	}
+	this->listItems.clear();
+	this->listsHeap.clear();
+	this->candidates.clear();
+	this->candidatesHeap.clear();
+	this->terms.clear();
+	this->queryEvaluator->getQueryStatistics()->addScannedPostings(this->numberOfScannedPostings);
+	this->queryEvaluator = NULL;
+	return true;
+}
+
+string UnionTopKBlockMaxOperator::toString(){
+	string result = "UnionTopKBlockMaxOperator";
+	if(this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode() != NULL){
+		result += this->getPhysicalPlanOptimizationNode()->getLogicalPlanNode()->toString();
+	}
+	return result;
+}
+
+bool UnionTopKBlockMaxOperator::verifyByRandomAccess(PhysicalPlanRandomAccessVerificationParameters & parameters) {
+	// children are not opened, so terms are verified here, like verifyByRandomAccessOrHelper does on children
+	bool verified = false;
+	vector<float> runtimeScores;
+	for(unsigned childOffset = 0 ; childOffset != this->getPhysicalPlanOptimizationNode()->getChildrenCount() ; ++childOffset){
+		LogicalPlanNode * termLogicalPlanNode =
+				this->getPhysicalPlanOptimizationNode()->getChildAt(childOffset)->getLogicalPlanNode();
+		boost::shared_ptr<PrefixActiveNodeSet> prefixActiveNodeSet =
+				termLogicalPlanNode->stats->getActiveNodeSetForEstimation(parameters.isFuzzy);
+		if(verifyByRandomAccessHelper(this->queryEvaluator, prefixActiveNodeSet.get(),
+				termLogicalPlanNode->getTerm(parameters.isFuzzy), parameters)){
+			verified = true;
+			runtimeScores.push_back(parameters.runTimeTermRecordScore);
+		}
+	}
+	if(verified == true){
+		parameters.runTimeTermRecordScore = parameters.ranker->computeAggregatedRuntimeScoreForOr(runtimeScores);
+	}
+	return verified;
+}
+
+unsigned UnionTopKBlockMaxOperator::getNumberOfSkippedBlocks() const {
+	unsigned numberOfSkippedBlocks = 0;
+	for (unsigned i = 0; i < this->listItems.size(); ++i) {
+		const InvertedListCursor & cursor = this->listItems[i]->cursor;
+		if (cursor.isCompressed() && !cursor.isDone()) {
+			numberOfSkippedBlocks += this->listItems[i]->remainingMaxScores.size() -
+					cursor.getPosition() / CompressedInvertedList::BLOCK_SIZE;
+		}
+	}
+	return numberOfSkippedBlocks;
+}
+
+void UnionTopKBlockMaxOperator::initializeListItem(unsigned termOffset, TrieNodePointer matchingNode,
+		TrieNodePointer leafNode, unsigned editDistance, bool isPrefixMatch){
+	unsigned invertedListId = leafNode->getInvertedListOffset();
+	InvertedListCursor cursor;
+	this->queryEvaluator->indexReadToken.getInvertedListCursor(invertedListId, cursor);
+	//Empty inverted lists should not be included in the lists of this operator.
+	if(cursor.size() == 0){
+		return;
+	}
+
+	UnionTopKBlockMaxListItem * listItem = new UnionTopKBlockMaxListItem();
+	listItem->termOffset = termOffset;
+	listItem->invertedListId = invertedListId;
+	listItem->matchingNode = matchingNode;
+	listItem->editDistance = editDistance;
+	listItem->isPrefixMatch = isPrefixMatch;
+	listItem->cursor = cursor;
+	if(cursor.isCompressed()){
+		// only the skip data is read here, no block is decoded
+		unsigned numberOfBlocks = (cursor.size() + CompressedInvertedList::BLOCK_SIZE - 1) / CompressedInvertedList::BLOCK_SIZE;
+		listItem->remainingMaxScores.resize(numberOfBlocks);
+		float remainingMaxScore = 0;
+		for(unsigned blockIndex = numberOfBlocks; blockIndex > 0; --blockIndex){
+			float blockMaxScore = 0;
+			listItem->cursor.seek((blockIndex - 1) * CompressedInvertedList::BLOCK_SIZE);
+			listItem->cursor.getBlockMaxScore(blockMaxScore);
+			if(blockMaxScore > remainingMaxScore){
+				remainingMaxScore = blockMaxScore;
+			}
+			listItem->remainingMaxScores[blockIndex - 1] = remainingMaxScore;
+		}
+		listItem->cursor.seek(0);
+	}
+	this->listItems.push_back(listItem);
+	if(computeUpperBound(listItem)){
+		this->listsHeap.push_back(listItem);
+	}
+}
+
+bool UnionTopKBlockMaxOperator::computeUpperBound(UnionTopKBlockMaxListItem * listItem){
+	InvertedListCursor & cursor = listItem->cursor;
+	if(cursor.isCompressed()){
+		if(cursor.isDone()){
+			return false;
+		}
+		listItem->upperBound = computeTermRecordRuntimeScore(listItem,
+				listItem->remainingMaxScores[cursor.getPosition() / CompressedInvertedList::BLOCK_SIZE]);
+		return true;
+	}
+	// Without skip data, the list is read one valid record at a time and, since lists are
+	// sorted by score, the score of the next valid record bounds the rest of the list.
+	while(!cursor.isDone()){
+		unsigned recordId = cursor.getRecordId();
+		cursor.next();
+		this->numberOfScannedPostings++;
+		unsigned keywordOffset = this->queryEvaluator->indexReadToken.getKeywordOffset(recordId, listItem->invertedListId);
+		listItem->nextAttributeIdsList.clear();
+		if (keywordOffset != FORWARDLIST_NOTVALID &&
+				this->queryEvaluator->indexReadToken.isValidTermPositionHit(recordId, keywordOffset,
+						this->terms[listItem->termOffset]->getAttributesToFilter(),
+						this->terms[listItem->termOffset]->getFilterAttrOperation(),
+						listItem->nextAttributeIdsList, listItem->nextStaticScore)) {
+			listItem->nextRecordId = recordId;
+			listItem->nextKeywordOffset = keywordOffset;
+			listItem->upperBound = computeTermRecordRuntimeScore(listItem, listItem->nextStaticScore);
+			return true;
+		}
+	}
+	return false;
+}
+
+void UnionTopKBlockMaxOperator::readNextBlock(UnionTopKBlockMaxListItem * listItem){
+	this->numberOfReadBlocks++;
+	InvertedListCursor & cursor = listItem->cursor;
+	if(cursor.isCompressed() == false){
+		addTermMatch(listItem, listItem->nextRecordId, listItem->nextKeywordOffset,
+				listItem->nextStaticScore, listItem->nextAttributeIdsList);
+		return;
+	}
+
+	Term * term = this->terms[listItem->termOffset];
+	unsigned position = cursor.getPosition();
+	unsigned endOfBlock = (position / CompressedInvertedList::BLOCK_SIZE + 1) * CompressedInvertedList::BLOCK_SIZE;
+	if(endOfBlock > cursor.size()){
+		endOfBlock = cursor.size();
+	}
+	vector<unsigned> matchedAttributeIdsList;
+	for(; position < endOfBlock; ++position){
+		unsigned recordId = cursor.getElement(position);
+		this->numberOfScannedPostings++;
+		unsigned keywordOffset = this->queryEvaluator->indexReadToken.getKeywordOffset(recordId, listItem->invertedListId);
+		float termRecordStaticScore = 0;
+		matchedAttributeIdsList.clear();
+		// We check the record only if it's valid
+		if (keywordOffset != FORWARDLIST_NOTVALID &&
+				this->queryEvaluator->indexReadToken.isValidTermPositionHit(recordId, keywordOffset,
+						term->getAttributesToFilter(), term->getFilterAttrOperation(), matchedAttributeIdsList,
+						termRecordStaticScore)) {
+			addTermMatch(listItem, recordId, keywordOffset, termRecordStaticScore, matchedAttributeIdsList);
+		}
+	}
+	cursor.seek(endOfBlock);
+}
+
+void UnionTopKBlockMaxOperator::addTermMatch(UnionTopKBlockMaxListItem * listItem, unsigned recordId, unsigned keywordOffset,
+		float termRecordStaticScore, const vector<unsigned> & attributeIdsList){
+	float termRecordRuntimeScore = computeTermRecordRuntimeScore(listItem, termRecordStaticScore);
+
+	boost::unordered_map<unsigned, UnionTopKBlockMaxCandidate>::iterator candidateIter = this->candidates.find(recordId);
+	if(candidateIter == this->candidates.end()){ // new candidate
+		candidateIter = this->candidates.insert(make_pair(recordId, UnionTopKBlockMaxCandidate())).first;
+		candidateIter->second.isReturned = false;
+		candidateIter->second.runtimeScore = -1;
+	}
+	UnionTopKBlockMaxCandidate & candidate = candidateIter->second;
+	if(candidate.isReturned){
+		return;
+	}
+
+	// keep the best match of each term
+	UnionTopKBlockMaxTermMatch * termMatch = NULL;
+	for(unsigned i = 0; i < candidate.termMatches.size(); ++i){
+		if(candidate.termMatches[i].termOffset == listItem->termOffset){
+			termMatch = &candidate.termMatches[i];
+			break;
+		}
+	}
+	if(termMatch == NULL){
+		candidate.termMatches.push_back(UnionTopKBlockMaxTermMatch());
+		termMatch = &candidate.termMatches.back();
+		termMatch->termOffset = listItem->termOffset;
+	}else if(termMatch->runtimeScore >= termRecordRuntimeScore){
+		return;
+	}
+	termMatch->runtimeScore = termRecordRuntimeScore;
+	termMatch->matchingNode = listItem->matchingNode;
+	termMatch->editDistance = listItem->editDistance;
+	termMatch->attributeIdsList = attributeIdsList;
+	termMatch->positionIndexOffset = keywordOffset;
+
+	float runtimeScore = getFeedbackBoostedScore(recordId, termRecordRuntimeScore);
+	if(runtimeScore > candidate.runtimeScore){
+		candidate.runtimeScore = runtimeScore;
+		this->candidatesHeap.push_back(make_pair(runtimeScore, recordId));
+		push_heap(this->candidatesHeap.begin(), this->candidatesHeap.end(), UnionTopKBlockMaxOperator::CandidateHeapEntryCmp());
+	}
+}
+
+float UnionTopKBlockMaxOperator::computeTermRecordRuntimeScore(const UnionTopKBlockMaxListItem * listItem,
+		float termRecordStaticScore) const{
+	Term * term = this->terms[listItem->termOffset];
+	return DefaultTopKRanker::computeTermRecordRuntimeScore(termRecordStaticScore,
+			listItem->editDistance,
+			term->getKeyword()->size(),
+			listItem->isPrefixMatch,
+			this->prefixMatchPenalty , term->getSimilarityBoost()) * term->getBoost();
+}
+
+float UnionTopKBlockMaxOperator::getFeedbackBoostedScore(unsigned recordId, float runtimeScore) const{
+	if (this->feedbackRanker == NULL) {
+		return runtimeScore;
+	}
+	return Ranker::computeFeedbackBoostedScore(runtimeScore, this->feedbackRanker->getFeedbackBoostForRecord(recordId));
+}
+
+bool UnionTopKBlockMaxOperator::getBestCandidate(CandidateHeapEntry & bestCandidate){
+	// remove the stale entries from the top of the heap
+	while(this->candidatesHeap.empty() == false){
+		const CandidateHeapEntry & top = this->candidatesHeap.front();
+		const UnionTopKBlockMaxCandidate & candidate = this->candidates[top.second];
+		if(candidate.isReturned == false && candidate.runtimeScore == top.first){
+			bestCandidate = top;
+			return true;
+		}
+		pop_heap(this->candidatesHeap.begin(), this->candidatesHeap.end(), UnionTopKBlockMaxOperator::CandidateHeapEntryCmp());
+		this->candidatesHeap.pop_back();
+	}
+	return false;
+}
+
+PhysicalPlanRecordItem * UnionTopKBlockMaxOperator::prepareRecordItem(unsigned recordId, float runtimeScore){
+	UnionTopKBlockMaxCandidate & candidate = this->candidates[recordId];
+	candidate.isReturned = true;
+
+	PhysicalPlanRecordItem * newItem = this->queryEvaluator->getPhysicalPlanRecordItemPool()->createRecordItem();
+	newItem->setRecordId(recordId);
+	newItem->setRecordRuntimeScore(runtimeScore);
+	// matches are reported in the order of the terms, like the union of the children would
+	vector<TrieNodePointer> prefixes;
+	vector<vector<unsigned> > matchedAttributeIdsList;
+	vector<unsigned> editDistances;
+	vector<unsigned> positionIndexOffsets;
+	vector<TermType> termTypes;
+	for(unsigned termOffset = 0; termOffset < this->terms.size(); ++termOffset){
+		for(unsigned i = 0; i < candidate.termMatches.size(); ++i){
+			const UnionTopKBlockMaxTermMatch & termMatch = candidate.termMatches[i];
+			if(termMatch.termOffset != termOffset){
+				continue;
+			}
+			prefixes.push_back(termMatch.matchingNode);
+			matchedAttributeIdsList.push_back(termMatch.attributeIdsList);
+			editDistances.push_back(termMatch.editDistance);
+			positionIndexOffsets.push_back(termMatch.positionIndexOffset);
+			termTypes.push_back(this->terms[termOffset]->getTermType());
+		}
+	}
+	newItem->setRecordMatchingPrefixes(prefixes);
+	newItem->setRecordMatchAttributeBitmaps(matchedAttributeIdsList);
+	newItem->setRecordMatchEditDistances(editDistances);
+	newItem->setPositionIndexOffsets(positionIndexOffsets);
+	newItem->setTermTypes(termTypes);
+	// the matches are not needed anymore
+	candidate.termMatches.clear();
+	return newItem;
+}
+
+// The cost of open of a child is considered only once in the cost computation
+// of parent open function.
+PhysicalPlanCost UnionTopKBlockMaxOptimizationOperator::getCostOfOpen(const PhysicalPlanExecutionParameters & params){
+	PhysicalPlanCost resultCost;
+	// children are not opened. The cost is going over the leaf nodes of all terms (like TVL)
+	// and reading the skip data of their lists to compute the bounds.
+	for(unsigned childOffset = 0 ; childOffset != this->getChildrenCount() ; ++childOffset){
+		LogicalPlanNode * termLogicalPlanNode = this->getChildAt(childOffset)->getLogicalPlanNode();
+		resultCost.cost += termLogicalPlanNode->stats->getEstimatedNumberOfLeafNodes();
+		resultCost.cost += termLogicalPlanNode->stats->getEstimatedNumberOfResults() / CompressedInvertedList::BLOCK_SIZE;
+	}
+	return resultCost;
+}
+// The cost of getNext of a child is multiplied by the estimated number of calls to this function
+// when the cost of parent is being calculated.
+PhysicalPlanCost UnionTopKBlockMaxOptimizationOperator::getCostOfGetNext(const PhysicalPlanExecutionParameters & params) {
+	/*
+	 * Notation :
+	 * K = number of top results to find
+	 * R = estimated number of results of the OR
+	 * P = sum of estimated lengths of the lists of children
+	 * L = sum of estimated number of leaf nodes (lists) of children
+	 *
+	 * Since lists are sorted by score, the top K results are mostly found in the first blocks of the
+	 * lists. Each list whose bound goes above the score of the K-th result is read at least one block,
+	 * so in the worst case min(L,K) lists are read one block (BLOCK_SIZE records or the whole list) to find
+	 * K results. The rest of the lists is only read when results are few, which is (P/R) records per result.
+	 * Each read block updates the heap of lists and each candidate is pushed to the heap of candidates.
+	 *
+	 * cost = P/R + min(L,K) * min(BLOCK_SIZE, P/L) / K + log2(L+1) + log2(K+1)
+	 */
+	double K = params.k;
+	if(K < 1){
+		K = 1;
+	}
+	double R = this->getLogicalPlanNode()->stats->getEstimatedNumberOfResults();
+	if(R < 1){
+		R = 1;
+	}
+	double P = 0;
+	double L = 0;
+	for(unsigned childOffset = 0 ; childOffset != this->getChildrenCount() ; ++childOffset){
+		LogicalPlanNode * termLogicalPlanNode = this->getChildAt(childOffset)->getLogicalPlanNode();
+		P += termLogicalPlanNode->stats->getEstimatedNumberOfResults();
+		L += termLogicalPlanNode->stats->getEstimatedNumberOfLeafNodes();
+	}
+	if(L < 1){
+		L = 1;
+	}
+	double recordsPerList = P / L;
+	if(recordsPerList > CompressedInvertedList::BLOCK_SIZE){
+		recordsPerList = CompressedInvertedList::BLOCK_SIZE;
+	}
+	PhysicalPlanCost resultCost;
+	resultCost.cost = P / R + ((L < K ? L : K) * recordsPerList) / K + log2(L + 1) + log2(K + 1);
+	return resultCost;
+}
+// the cost of close of a child is only considered once since each node's close function is only called once.
+PhysicalPlanCost UnionTopKBlockMaxOptimizationOperator::getCostOfClose(const PhysicalPlanExecutionParameters & params) {
+	PhysicalPlanCost resultCost;
+	// cost of deleting list items
+	for(unsigned childOffset = 0 ; childOffset != this->getChildrenCount() ; ++childOffset){
+		resultCost.cost += this->getChildAt(childOffset)->getLogicalPlanNode()->stats->getEstimatedNumberOfLeafNodes();
+	}
+	return resultCost;
+}
+PhysicalPlanCost UnionTopKBlockMaxOptimizationOperator::getCostOfVerifyByRandomAccess(const PhysicalPlanExecutionParameters & params){
+	PhysicalPlanCost resultCost;
+	// cost of verifying terms
+	for(unsigned childOffset = 0 ; childOffset != this->getChildrenCount() ; ++childOffset){
+		resultCost = resultCost + this->getChildAt(childOffset)->getCostOfVerifyByRandomAccess(params);
+	}
+	return resultCost;
+}
+void UnionTopKBlockMaxOptimizationOperator::getOutputProperties(IteratorProperties & prop){
+	prop.addProperty(PhysicalPlanIteratorProperty_SortByScore);
+}
+void UnionTopKBlockMaxOptimizationOperator::getRequiredInputProperties(IteratorProperties & prop){
+	// children are only used to describe the terms, TVL output is already sorted by score so
+	// no sort operator is injected between this operator and its children
+	prop.addProperty(PhysicalPlanIteratorProperty_SortByScore);
+}
+PhysicalPlanNodeType UnionTopKBlockMaxOptimizationOperator::getType() {
+	return PhysicalPlanNode_UnionTopKBlockMax;
+}
+bool UnionTopKBlockMaxOptimizationOperator::validateChildren(){
+	if(getChildrenCount() == 0){
+		return false;
+	}
+	// this operator reads the inverted lists of its terms itself, so all children must be TVL
+	for(unsigned i = 0 ; i < getChildrenCount() ; i++){
+		if(getChildAt(i)->getType() != PhysicalPlanNode_UnionLowestLevelTermVirtualList){
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+}
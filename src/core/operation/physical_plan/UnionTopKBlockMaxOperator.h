@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __WRAPPER_UNIONTOPKBLOCKMAXOPERATOR_H__
+#define __WRAPPER_UNIONTOPKBLOCKMAXOPERATOR_H__
+
+#include "instantsearch/Constants.h"
+#include "index/ForwardIndex.h"
+#include "index/Trie.h"
+#include "index/InvertedIndex.h"
+#include "operation/HistogramManager.h"
+#include "PhysicalPlan.h"
+
+#include <boost/unordered_map.hpp>
+
+using namespace std;
+
+namespace srch2 {
+namespace instantsearch {
+
+class FeedbackRanker;
+
+/*
+ * One inverted list read by UnionTopKBlockMaxOperator, i.e. one leaf node of one of the terms.
+ */
+struct UnionTopKBlockMaxListItem {
+	unsigned termOffset;
+	unsigned invertedListId;
+	// the trie node which is reported as the matching prefix of the records of this list
+	TrieNodePointer matchingNode;
+	unsigned editDistance;
+	bool isPrefixMatch;
+	InvertedListCursor cursor;
+	// remainingMaxScores[b] is the maximum static score of blocks b and after, computed from
+	// the skip data of the list. Blocks are not guaranteed to be in score order, so the bound of
+	// a list must cover all of its remaining blocks, not only the next one.
+	vector<float> remainingMaxScores;
+	// upper bound of the runtime score of the records of this list which are not read yet
+	float upperBound;
+
+	// A list without a compressed read view has no skip data. Its records are read one by one and
+	// the next valid record is kept here, its score being the bound of the rest of the list.
+	unsigned nextRecordId;
+	unsigned nextKeywordOffset;
+	float nextStaticScore;
+	vector<unsigned> nextAttributeIdsList;
+};
+
+/*
+ * The best match of a term in a candidate record of UnionTopKBlockMaxOperator
+ */
+struct UnionTopKBlockMaxTermMatch {
+	unsigned termOffset;
+	float runtimeScore;
+	TrieNodePointer matchingNode;
+	unsigned editDistance;
+	vector<unsigned> attributeIdsList;
+	unsigned positionIndexOffset;
+};
+
+struct UnionTopKBlockMaxCandidate {
+	// score of the record so far, i.e. the maximum of the scores of its term matches (OR aggregation),
+	// boosted by feedback if the query has a feedback ranker
+	float runtimeScore;
+	bool isReturned;
+	vector<UnionTopKBlockMaxTermMatch> termMatches;
+};
+
+/*
+ * This operator finds the top results of an OR of terms directly on the inverted lists of the terms,
+ * using the maximum score of each block of a compressed inverted list (the skip data stored with the list)
+ * to avoid decoding the blocks that cannot have a record in the current top results.
+ *
+ * The lists of all leaf nodes of all terms are kept in a heap ordered by the upper bound of the
+ * score of their unread records. The operator reads the list with the highest bound one block at a
+ * time and keeps the score of each record it sees. Since the score of an OR is the maximum of the
+ * scores of the terms, a candidate whose score is higher than the bound of all the lists cannot be
+ * changed or beaten by any unread record, so it is returned. A list whose bound never goes above the
+ * score of the last returned record is never decoded, and a block is only decoded when its own bound
+ * (or a later block's) is high enough.
+ *
+ * This is similar to block-max WAND/MaxScore evaluation. Since inverted lists are sorted by score and
+ * not by record id, the bounds are consumed in score order (like the Threshold Algorithm) instead of
+ * by moving pivots on record ids.
+ * Example :
+ * q = A OR B*
+ *
+ * [UnionTopKBlockMaxOperator]_____ [TVL A]
+ *        |
+ *        |_____ [TVL B*]
+ *
+ * The children only describe the terms (term, active nodes and estimates). They are never opened and
+ * the operator reads their inverted lists itself.
+ */
+class UnionTopKBlockMaxOperator : public PhysicalPlanNode {
+	friend class PhysicalOperatorFactory;
+public:
+	bool open(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanExecutionParameters & params);
+	PhysicalPlanRecordItem *
+	getNext(const PhysicalPlanExecutionParameters & params) ;
+	bool close(PhysicalPlanExecutionParameters & params);
+	string toString();
+	bool verifyByRandomAccess(PhysicalPlanRandomAccessVerificationParameters & parameters) ;
+	~UnionTopKBlockMaxOperator();
+
+	// number of blocks (or records of lists without skip data) read since open, and number of
+	// blocks whose bound was never reached. These are used by tests.
+	unsigned getNumberOfReadBlocks() const {
+		return numberOfReadBlocks;
+	}
+	unsigned getNumberOfSkippedBlocks() const;
+private:
+
+	class ListItemCmp {
+	public:
+		bool operator()(const UnionTopKBlockMaxListItem *lhs, const UnionTopKBlockMaxListItem *rhs) const {
+			return lhs->upperBound < rhs->upperBound;
+		}
+	};
+
+	// entries of the candidates heap, an entry is stale if the score of its record has changed
+	// since it was pushed, or if the record is already returned
+	typedef pair<float, unsigned> CandidateHeapEntry;
+	class CandidateHeapEntryCmp {
+	public:
+		bool operator()(const CandidateHeapEntry & lhs, const CandidateHeapEntry & rhs) const {
+			return DefaultTopKRanker::compareRecordsLessThan(lhs.first, lhs.second, rhs.first, rhs.second);
+		}
+	};
+
+	QueryEvaluatorInternal * queryEvaluator;
+
+	FeedbackRanker* feedbackRanker;
+
+	shared_ptr<vectorview<ForwardListPtr> > forwardListDirectoryReadView;
+
+	float prefixMatchPenalty;
+	bool isFuzzy;
+	vector<Term *> terms;
+
+	vector<UnionTopKBlockMaxListItem *> listItems;
+	// heap of the lists which have more records, on upperBound
+	vector<UnionTopKBlockMaxListItem *> listsHeap;
+
+	boost::unordered_map<unsigned, UnionTopKBlockMaxCandidate> candidates;
+	vector<CandidateHeapEntry> candidatesHeap;
+
+	unsigned numberOfReadBlocks;
+	// added to the query statistics by close()
+	unsigned numberOfScannedPostings;
+
+	void initializeListItem(unsigned termOffset, TrieNodePointer matchingNode, TrieNodePointer leafNode,
+			unsigned editDistance, bool isPrefixMatch);
+	// computes the upper bound of the list from its current position, returns false if the list is done
+	bool computeUpperBound(UnionTopKBlockMaxListItem * listItem);
+	// reads the current block of the list and adds its valid records to the candidates
+	void readNextBlock(UnionTopKBlockMaxListItem * listItem);
+	void addTermMatch(UnionTopKBlockMaxListItem * listItem, unsigned recordId, unsigned keywordOffset,
+			float termRecordStaticScore, const vector<unsigned> & attributeIdsList);
+	float computeTermRecordRuntimeScore(const UnionTopKBlockMaxListItem * listItem,
+			float termRecordStaticScore) const;
+	float getFeedbackBoostedScore(unsigned recordId, float runtimeScore) const;
+	// returns false if the candidates heap has no valid entry
+	bool getBestCandidate(CandidateHeapEntry & bestCandidate);
+	// marks the candidate as returned and makes the record item from its term matches
+	PhysicalPlanRecordItem * prepareRecordItem(unsigned recordId, float runtimeScore);
+
+	UnionTopKBlockMaxOperator() ;
+};
+
+class UnionTopKBlockMaxOptimizationOperator : public PhysicalPlanOptimizationNode {
+	friend class PhysicalOperatorFactory;
+public:
+	// The cost of open of a child is considered only once in the cost computation
+	// of parent open function.
+	PhysicalPlanCost getCostOfOpen(const PhysicalPlanExecutionParameters & params) ;
+	// The cost of getNext of a child is multiplied by the estimated number of calls to this function
+	// when the cost of parent is being calculated.
+	PhysicalPlanCost getCostOfGetNext(const PhysicalPlanExecutionParameters & params) ;
+	// the cost of close of a child is only considered once since each node's close function is only called once.
+	PhysicalPlanCost getCostOfClose(const PhysicalPlanExecutionParameters & params) ;
+	PhysicalPlanCost getCostOfVerifyByRandomAccess(const PhysicalPlanExecutionParameters & params);
+	void getOutputProperties(IteratorProperties & prop);
+	void getRequiredInputProperties(IteratorProperties & prop);
+	PhysicalPlanNodeType getType() ;
+	bool validateChildren();
+};
+
+}
+}
+
+#endif //__WRAPPER_UNIONTOPKBLOCKMAXOPERATOR_H__
@@ -188,6 +188,22 @@ LogicalPlanNode * LogicalPlan::createGeoLogicalPlanNode(Shape *regionShape){
 	return node;
 }
 
+static void clearForcedPhysicalNodes(LogicalPlanNode * node){
+	if(node == NULL){
+		return;
+	}
+	node->forcedPhysicalNode = PhysicalPlanNode_NOT_SPECIFIED;
+	for(vector<LogicalPlanNode *>::iterator child = node->children.begin(); child != node->children.end() ; ++child){
+		clearForcedPhysicalNodes(*child);
+	}
+}
+
+void LogicalPlan::resetExecutionState(bool isFuzzy){
+	HistogramManager::freeStatsOfLogicalPlanTree(tree);
+	clearForcedPhysicalNodes(tree);
+	setFuzzy(isFuzzy);
+}
+
 
 }
 }
@@ -38,12 +38,14 @@
 #include "index/ForwardIndex.h"
 #include "util/Assert.h"
 #include "util/Logger.h"
+#include "util/Arena.h"
 
 #include <vector>
 #include <queue>
 #include <string>
 #include <set>
 #include <map>
+#include <new>
 
 
 using srch2::util::Logger;
@@ -124,15 +126,19 @@ public:
 };
 
 
+/*
+ * The results live as long as their factory, so they are allocated in an arena
+ * which is released in one shot when the factory is destroyed.
+ */
 class QueryResultFactoryInternal{
 public:
 	QueryResult * createQueryResult(){
-		QueryResult * newResult = new QueryResult();
+		QueryResult * newResult = new (allocateQueryResult()) QueryResult();
 		queryResultPointers.push_back(newResult);
 		return newResult;
 	}
 	QueryResult * createQueryResult(QueryResult & queryResult){
-		QueryResult * newResult = new QueryResult(queryResult);
+		QueryResult * newResult = new (allocateQueryResult()) QueryResult(queryResult);
 		queryResultPointers.push_back(newResult);
 		return newResult;
 	}
@@ -140,10 +146,15 @@ public:
 	    Logger::debug("Query results are being destroyed in factory destructor." );
 		for(std::vector<QueryResult *>::iterator iter = queryResultPointers.begin();
 					iter != queryResultPointers.end() ; ++iter){
-			delete *iter;
+			(*iter)->~QueryResult();
 		}
 	}
 	std::vector<QueryResult *> queryResultPointers;
+private:
+	void * allocateQueryResult(){
+		return arena.allocate(sizeof(QueryResult), __alignof__(QueryResult));
+	}
+	srch2::util::Arena arena;
 };
 
 ////////////////////////////////////// QueryResultsInternal Header //////////////////////////////////
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FlatSnapshot.h"
+#include "util/Version.h"
+#include "util/Logger.h"
+#include "util/Assert.h"
+#include "util/FileOps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+
+using srch2::util::Logger;
+using srch2::util::MappedFile;
+
+namespace srch2 {
+namespace instantsearch {
+
+static uint8_t getCurrentEndianness() {
+    // same convention as IndexVersion: 0 for big endian and 1 for little endian
+    unsigned endianness = 0x01;
+    return ((uint8_t *) &endianness)[0];
+}
+
+FlatSnapshotWriter::FlatSnapshotWriter(const std::string &fileName) {
+    this->fileName = fileName;
+    this->temporaryFileName = fileName + ".tmp";
+    this->position = 0;
+    this->inSection = false;
+    this->finished = false;
+
+    this->out.open(this->temporaryFileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!this->out.good())
+        throw std::runtime_error("Error opening " + this->temporaryFileName);
+
+    // the header is written by finish() when the section table offset is known.
+    FlatSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    this->append(&header, sizeof(header));
+}
+
+FlatSnapshotWriter::~FlatSnapshotWriter() {
+    if (!this->finished) {
+        if (this->out.is_open())
+            this->out.close();
+        ::remove(this->temporaryFileName.c_str());
+    }
+}
+
+void FlatSnapshotWriter::beginSection(uint32_t sectionId) {
+    ASSERT(!this->inSection);
+    this->pad();
+    FlatSnapshotSectionEntry entry;
+    entry.sectionId = sectionId;
+    entry.reserved = 0;
+    entry.offset = this->position;
+    entry.length = 0;
+    this->sections.push_back(entry);
+    this->inSection = true;
+}
+
+void FlatSnapshotWriter::append(const void *data, size_t length) {
+    if (length == 0)
+        return;
+    this->out.write((const char *) data, length);
+    this->checkStream();
+    this->position += length;
+}
+
+uint64_t FlatSnapshotWriter::getCurrentSectionLength() const {
+    ASSERT(this->inSection);
+    return this->position - this->sections.back().offset;
+}
+
+void FlatSnapshotWriter::endSection() {
+    ASSERT(this->inSection);
+    this->sections.back().length = this->position - this->sections.back().offset;
+    this->inSection = false;
+}
+
+void FlatSnapshotWriter::pad() {
+    static const char zeros[FLAT_SNAPSHOT_ALIGNMENT] = { 0 };
+    unsigned remainder = this->position % FLAT_SNAPSHOT_ALIGNMENT;
+    if (remainder != 0)
+        this->append(zeros, FLAT_SNAPSHOT_ALIGNMENT - remainder);
+}
+
+void FlatSnapshotWriter::checkStream() {
+    if (!this->out.good())
+        throw std::runtime_error("Error writing " + this->temporaryFileName);
+}
+
+void FlatSnapshotWriter::finish() {
+    ASSERT(!this->inSection);
+    this->pad();
+
+    FlatSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FLAT_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.formatVersion = FLAT_SNAPSHOT_FORMAT_VERSION;
+    header.indexVersion = INDEX_VERSION;
+    header.endianness = getCurrentEndianness();
+    header.bitness = sizeof(void *);
+    header.numberOfSections = this->sections.size();
+    header.sectionTableOffset = this->position;
+
+    if (!this->sections.empty())
+        this->append(&this->sections[0], this->sections.size() * sizeof(FlatSnapshotSectionEntry));
+
+    this->out.seekp(0);
+    this->out.write((const char *) &header, sizeof(header));
+    this->out.flush();
+    this->checkStream();
+    this->out.close();
+
+    // the data must be on the disk before the rename publishes it, and the rename itself is only
+    // durable once the directory is synced.
+    if (!srch2::util::syncFile(this->temporaryFileName))
+        throw std::runtime_error("Error syncing " + this->temporaryFileName);
+    if (::rename(this->temporaryFileName.c_str(), this->fileName.c_str()) != 0)
+        throw std::runtime_error("Error renaming " + this->temporaryFileName);
+    this->finished = true;
+    if (!srch2::util::syncParentDir(this->fileName))
+        throw std::runtime_error("Error syncing the directory of " + this->fileName);
+}
+
+bool FlatSnapshotReader::isFlatSnapshot(const std::string &fileName) {
+    std::ifstream in(fileName.c_str(), std::ios::binary);
+    char magic[8];
+    if (!in.read(magic, sizeof(magic)))
+        return false;
+    return memcmp(magic, FLAT_SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+FlatSnapshotReader::FlatSnapshotReader(const std::string &fileName) {
+    this->mappedFile = MappedFile::open(fileName);
+    const char *data = this->mappedFile->getData();
+    uint64_t size = this->mappedFile->getSize();
+
+    if (size < sizeof(FlatSnapshotHeader))
+        throw std::runtime_error("Truncated index snapshot " + fileName);
+
+    const FlatSnapshotHeader *header = (const FlatSnapshotHeader *) data;
+    if (memcmp(header->magic, FLAT_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+            || header->formatVersion != FLAT_SNAPSHOT_FORMAT_VERSION
+            || header->indexVersion != INDEX_VERSION
+            || header->endianness != getCurrentEndianness()
+            || header->bitness != sizeof(void *)) {
+        Logger::error("Invalid index file. Either index files are built with a previous version"
+                " of the engine or copied from a different machine/architecture.");
+        throw std::runtime_error("Incompatible index snapshot " + fileName);
+    }
+
+    this->numberOfSections = header->numberOfSections;
+    if (header->sectionTableOffset > size
+            || this->numberOfSections * sizeof(FlatSnapshotSectionEntry) > size - header->sectionTableOffset)
+        throw std::runtime_error("Corrupted section table in index snapshot " + fileName);
+    this->sectionTable = (const FlatSnapshotSectionEntry *) (data + header->sectionTableOffset);
+
+    for (unsigned i = 0; i < this->numberOfSections; ++i) {
+        const FlatSnapshotSectionEntry &entry = this->sectionTable[i];
+        if (entry.offset > size || entry.length > size - entry.offset)
+            throw std::runtime_error("Corrupted section in index snapshot " + fileName);
+    }
+}
+
+const FlatSnapshotSectionEntry *FlatSnapshotReader::findSection(uint32_t sectionId) const {
+    for (unsigned i = 0; i < this->numberOfSections; ++i) {
+        if (this->sectionTable[i].sectionId == sectionId)
+            return &this->sectionTable[i];
+    }
+    return NULL;
+}
+
+bool FlatSnapshotReader::hasSection(uint32_t sectionId) const {
+    return this->findSection(sectionId) != NULL;
+}
+
+const char *FlatSnapshotReader::getSection(uint32_t sectionId, uint64_t &length) const {
+    const FlatSnapshotSectionEntry *entry = this->findSection(sectionId);
+    if (entry == NULL)
+        throw std::runtime_error("Missing section in index snapshot " + this->mappedFile->getFileName());
+    length = entry->length;
+    return this->mappedFile->getData() + entry->offset;
+}
+
+FlatSnapshotSegments::FlatSnapshotSegments(const std::string &kind, unsigned segmentSize) {
+    ASSERT(segmentSize > 0);
+    this->kind = kind;
+    this->segmentSize = segmentSize;
+    this->numberOfSegmentsWritten = 0;
+}
+
+void FlatSnapshotSegments::reserve(unsigned numberOfElements) {
+    unsigned numberOfSegments = (numberOfElements + this->segmentSize - 1) / this->segmentSize;
+    if (numberOfSegments > this->changedSegments.size())
+        this->changedSegments.resize(numberOfSegments, 1);
+}
+
+std::string FlatSnapshotSegments::getSegmentFileName(const std::string &fileName, unsigned segmentId,
+        uint32_t generation) const {
+    std::stringstream name;
+    name << fileName << "." << this->kind << "." << segmentId << "." << generation;
+    return name.str();
+}
+
+void FlatSnapshotSegments::beginSave(const std::string &fileName, unsigned numberOfElements) {
+    // files of a save that failed before its manifest was published
+    for (unsigned i = 0; i < this->writtenFiles.size(); ++i)
+        ::remove(this->writtenFiles[i].c_str());
+    this->writtenFiles.clear();
+    this->replacedFiles.clear();
+    this->numberOfSegmentsWritten = 0;
+
+    this->pendingFileName = fileName;
+    if (fileName == this->savedFileName)
+        this->pendingGenerations = this->generations;
+    else
+        this->pendingGenerations.clear();
+    unsigned numberOfSegments = (numberOfElements + this->segmentSize - 1) / this->segmentSize;
+    if (fileName == this->savedFileName) {
+        for (unsigned segmentId = numberOfSegments; segmentId < this->pendingGenerations.size(); ++segmentId) {
+            if (this->pendingGenerations[segmentId] != 0)
+                this->replacedFiles.push_back(this->getSegmentFileName(fileName, segmentId,
+                        this->pendingGenerations[segmentId]));
+        }
+    }
+    this->pendingGenerations.resize(numberOfSegments, 0);
+}
+
+bool FlatSnapshotSegments::isSegmentToSave(unsigned segmentId) const {
+    ASSERT(segmentId < this->pendingGenerations.size());
+    if (this->pendingGenerations[segmentId] == 0)
+        return true;
+    return segmentId >= this->changedSegments.size() || this->changedSegments[segmentId] != 0;
+}
+
+std::string FlatSnapshotSegments::startSegment(unsigned segmentId) {
+    ASSERT(segmentId < this->pendingGenerations.size());
+    uint32_t &generation = this->pendingGenerations[segmentId];
+    if (generation != 0)
+        this->replacedFiles.push_back(this->getSegmentFileName(this->pendingFileName, segmentId, generation));
+    ++generation;
+    std::string fileName = this->getSegmentFileName(this->pendingFileName, segmentId, generation);
+    this->writtenFiles.push_back(fileName);
+    ++this->numberOfSegmentsWritten;
+    return fileName;
+}
+
+void FlatSnapshotSegments::addManifestSection(FlatSnapshotWriter &manifest, uint32_t sectionId) const {
+    manifest.addSection(sectionId, this->pendingGenerations.empty() ? NULL : &this->pendingGenerations[0],
+            this->pendingGenerations.size() * sizeof(uint32_t));
+}
+
+void FlatSnapshotSegments::commitSave() {
+    for (unsigned i = 0; i < this->replacedFiles.size(); ++i)
+        ::remove(this->replacedFiles[i].c_str());
+    this->replacedFiles.clear();
+    this->writtenFiles.clear();
+
+    this->savedFileName = this->pendingFileName;
+    this->generations.swap(this->pendingGenerations);
+    this->pendingGenerations.clear();
+    std::fill(this->changedSegments.begin(), this->changedSegments.end(), 0);
+}
+
+unsigned FlatSnapshotSegments::load(const std::string &fileName, const FlatSnapshotReader &manifest,
+        uint32_t sectionId) {
+    uint64_t numberOfSegments;
+    const uint32_t *generations = manifest.getSectionAsArray<uint32_t>(sectionId, numberOfSegments);
+    this->generations.assign(generations, generations + numberOfSegments);
+    for (unsigned segmentId = 0; segmentId < numberOfSegments; ++segmentId) {
+        if (this->generations[segmentId] == 0)
+            throw std::runtime_error("Missing segment in index snapshot " + fileName);
+    }
+    this->savedFileName = fileName;
+    this->changedSegments.assign(numberOfSegments, 0);
+    return numberOfSegments;
+}
+
+}
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CORE_SERIALIZATION_FLATSNAPSHOT_H__
+#define __CORE_SERIALIZATION_FLATSNAPSHOT_H__
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include "util/MappedFile.h"
+
+namespace srch2 {
+namespace instantsearch {
+
+/*
+ *  Flat index snapshot layout
+ *  ---------------------------------------------------------------------------------------
+ *  | header | section 1 | padding | section 2 | padding | ... | section table |
+ *  ---------------------------------------------------------------------------------------
+ *
+ *  Unlike the boost archives written by Serializer, a flat snapshot stores the index structures as
+ *  plain arrays addressed by offsets, never by pointers. The file is loaded by mapping it into memory
+ *  (see util/MappedFile.h), and the read views of the index point directly into the mapping, so
+ *  loading does not deserialize the arrays and the page cache is shared by all processes on a host.
+ *
+ *  Only the forward index and the inverted index are saved as flat snapshots. Loading the forward
+ *  index still creates a ForwardList object for every record, although its data stays in the
+ *  mapping, so loading time remains linear in the number of records. The trie, the quadtree and the
+ *  other index structures are still loaded from boost archives.
+ *
+ *  Every section starts at a FLAT_SNAPSHOT_ALIGNMENT aligned offset, so that arrays of fixed width
+ *  elements can be accessed in place. The header carries the same compatibility information as
+ *  IndexVersion (index version, endianness and pointer size) and loading a snapshot written by an
+ *  incompatible engine throws an exception.
+ */
+
+#define FLAT_SNAPSHOT_MAGIC "SRCH2FLT"
+#define FLAT_SNAPSHOT_FORMAT_VERSION 1
+#define FLAT_SNAPSHOT_ALIGNMENT 64
+
+// Ids of the sections stored in flat snapshots. Never reuse or renumber an id.
+typedef enum {
+    // inverted index
+    FlatSection_InvertedListOffsets = 1, // uint64_t[numberOfLists + 1], offsets into the record id array
+    FlatSection_InvertedListRecordIds = 2, // unsigned[], the inverted lists without a compressed list one after the other
+    FlatSection_InvertedListKeywordIds = 3, // unsigned[numberOfLists]
+    FlatSection_CompressedListHeaders = 4, // FlatCompressedListHeader[numberOfLists], see InvertedIndex.cpp
+    FlatSection_CompressedListBlocks = 5, // InvertedListBlockInfo[], the blocks of all the compressed lists
+    FlatSection_CompressedListPackedWords = 6, // unsigned[], the packed words of all the compressed lists
+    // forward index
+    FlatSection_ForwardIndexInfo = 10, // FlatForwardIndexInfo, see ForwardIndex.cpp
+    FlatSection_ForwardListHeaders = 11, // FlatForwardListHeader[numberOfForwardLists]
+    FlatSection_ForwardListPayload = 12, // variable length data of forward lists
+    FlatSection_StoredRecordOffsets = 13, // uint64_t[numberOfForwardLists + 1], offsets into the stored record data
+    FlatSection_StoredRecordData = 14, // the stored records of the forward lists one after the other
+    FlatSection_ExternalRecordIdMapKeys = 15, // the keys of the map, each prefixed by its ULEB128 length
+    FlatSection_ExternalRecordIdMapSlots = 16, // the slots of the hash table, see ExternalRecordIdMap.cpp
+    // doc values
+    FlatSection_DocValuesInfo = 30, // FlatDocValuesInfo, see DocValues.cpp
+    FlatSection_DocValuesColumns = 31, // FlatDocValuesColumn[numberOfColumns]
+    FlatSection_DocValuesArrays = 32, // the value (or ordinal) array of each column, 8 byte aligned
+    FlatSection_DocValuesDictionaryOffsets = 33, // uint64_t[], the offsets of the values of each dictionary
+    FlatSection_DocValuesDictionaryData = 34, // the distinct values of the text columns one after the other
+    // manifests of segmented snapshots, see FlatSnapshotSegments
+    FlatSection_ForwardListSegments = 20, // uint32_t[numberOfSegments], the generation of each segment
+    FlatSection_StoredRecordSegments = 21, // uint32_t[numberOfSegments]
+    FlatSection_InvertedListSegments = 22 // uint32_t[numberOfSegments]
+} FlatSnapshotSectionId;
+
+struct FlatSnapshotHeader {
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t indexVersion;
+    uint8_t endianness;
+    uint8_t bitness;
+    uint16_t reserved;
+    uint32_t numberOfSections;
+    uint64_t sectionTableOffset;
+};
+
+struct FlatSnapshotSectionEntry {
+    uint32_t sectionId;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t length;
+};
+
+/*
+ *  Writes a flat snapshot. The data is written to "<fileName>.tmp", which is renamed to fileName by
+ *  finish(). Since the rename is atomic, a snapshot that is currently mapped by the engine is never
+ *  modified: the mapping keeps the old file alive until it is released. finish() syncs the temporary
+ *  file before the rename and the directory after it, so a finished snapshot survives a crash.
+ */
+class FlatSnapshotWriter {
+public:
+    // throws std::runtime_error if the temporary file cannot be created.
+    FlatSnapshotWriter(const std::string &fileName);
+    // removes the temporary file if finish() was not called.
+    ~FlatSnapshotWriter();
+
+    void beginSection(uint32_t sectionId);
+    void append(const void *data, size_t length);
+    template<class T>
+    void appendValue(const T &value) {
+        this->append(&value, sizeof(T));
+    }
+    // number of bytes appended to the current section so far
+    uint64_t getCurrentSectionLength() const;
+    void endSection();
+
+    void addSection(uint32_t sectionId, const void *data, size_t length) {
+        this->beginSection(sectionId);
+        this->append(data, length);
+        this->endSection();
+    }
+
+    // writes the section table and the header, and publishes the file. Throws std::runtime_error if
+    // the file cannot be written, synced or renamed.
+    void finish();
+
+private:
+    void pad();
+    void checkStream();
+
+    std::string fileName;
+    std::string temporaryFileName;
+    std::ofstream out;
+    uint64_t position;
+    bool inSection;
+    bool finished;
+    std::vector<FlatSnapshotSectionEntry> sections;
+};
+
+class FlatSnapshotReader {
+public:
+    // returns true if the file exists and starts with the flat snapshot magic.
+    static bool isFlatSnapshot(const std::string &fileName);
+
+    // maps the file and validates its header and section table.
+    // throws std::runtime_error if the file is not a compatible flat snapshot.
+    FlatSnapshotReader(const std::string &fileName);
+
+    bool hasSection(uint32_t sectionId) const;
+
+    // throws std::runtime_error if the section does not exist.
+    const char *getSection(uint32_t sectionId, uint64_t &length) const;
+
+    template<class T>
+    const T *getSectionAsArray(uint32_t sectionId, uint64_t &numberOfElements) const {
+        uint64_t length;
+        const char *data = this->getSection(sectionId, length);
+        numberOfElements = length / sizeof(T);
+        return (const T *) data;
+    }
+
+    // index structures keep this pointer to keep the mapping alive while they point into it.
+    const boost::shared_ptr<srch2::util::MappedFile> &getMappedFile() const {
+        return this->mappedFile;
+    }
+
+private:
+    const FlatSnapshotSectionEntry *findSection(uint32_t sectionId) const;
+
+    boost::shared_ptr<srch2::util::MappedFile> mappedFile;
+    const FlatSnapshotSectionEntry *sectionTable;
+    uint32_t numberOfSections;
+};
+
+/*
+ *  Segmented snapshots
+ *
+ *  A large index structure of which only a small part changes between two saves is saved as fixed size
+ *  segments of its elements. Each segment is a flat snapshot "<fileName>.<kind>.<segmentId>.<generation>",
+ *  and "<fileName>" itself is a flat snapshot (the manifest) that stores the generation of every segment.
+ *  The structure marks the elements it changes, and a save to the same file name writes only the segments
+ *  with changed elements.
+ *
+ *  A segment that is written always gets a new generation, so a save never modifies a file that the
+ *  current manifest refers to. The manifest is replaced atomically after the segments are written and the
+ *  files of the replaced generations are removed only then, so a crash during a save leaves the previous
+ *  snapshot intact.
+ *
+ *  Not thread-safe. The changes are marked and the saves are done by the writer, which holds the writer
+ *  lock of the index.
+ */
+class FlatSnapshotSegments {
+public:
+    // kind distinguishes the segments of different arrays of one structure in file names.
+    FlatSnapshotSegments(const std::string &kind, unsigned segmentSize);
+
+    unsigned getSegmentSize() const {
+        return this->segmentSize;
+    }
+
+    // Marks the segment of the element as changed. Several threads may mark elements concurrently
+    // as long as the segment was already reserved by reserve().
+    void markChanged(unsigned elementId) {
+        unsigned segmentId = elementId / this->segmentSize;
+        if (segmentId >= this->changedSegments.size())
+            this->changedSegments.resize(segmentId + 1, 1);
+        this->changedSegments[segmentId] = 1;
+    }
+
+    void reserve(unsigned numberOfElements);
+
+    // Starts a save of numberOfElements elements with the manifest fileName. Every segment is written if
+    // the last save or load used another file name.
+    void beginSave(const std::string &fileName, unsigned numberOfElements);
+    unsigned getNumberOfSegmentsToSave() const {
+        return this->pendingGenerations.size();
+    }
+    bool isSegmentToSave(unsigned segmentId) const;
+    // returns the name of the file to write the segment to.
+    std::string startSegment(unsigned segmentId);
+    void addManifestSection(FlatSnapshotWriter &manifest, uint32_t sectionId) const;
+    // Called after the manifest is published: removes the files of the replaced generations.
+    void commitSave();
+
+    // Reads the generations from the manifest. Returns the number of segments.
+    unsigned load(const std::string &fileName, const FlatSnapshotReader &manifest, uint32_t sectionId);
+    std::string getSegmentFileName(unsigned segmentId) const {
+        return this->getSegmentFileName(this->savedFileName, segmentId, this->generations[segmentId]);
+    }
+
+    // number of segments written by the last save
+    unsigned getNumberOfSegmentsWritten() const {
+        return this->numberOfSegmentsWritten;
+    }
+
+private:
+    std::string getSegmentFileName(const std::string &fileName, unsigned segmentId, uint32_t generation) const;
+
+    std::string kind;
+    unsigned segmentSize;
+    // one byte per segment (not vector<bool>) so that different segments can be marked concurrently
+    std::vector<uint8_t> changedSegments;
+
+    // manifest and generations of the last save or load, 0 if a segment has no file
+    std::string savedFileName;
+    std::vector<uint32_t> generations;
+
+    // state of the save in progress
+    std::string pendingFileName;
+    std::vector<uint32_t> pendingGenerations;
+    std::vector<std::string> writtenFiles;
+    std::vector<std::string> replacedFiles;
+    unsigned numberOfSegmentsWritten;
+};
+
+}
+}
+
+#endif /* __CORE_SERIALIZATION_FLATSNAPSHOT_H__ */
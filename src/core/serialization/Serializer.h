@@ -41,6 +41,7 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include "util/Version.h"
 #include "util/Logger.h"
+#include "util/FileOps.h"
 using namespace std;
 using namespace srch2::util;
 
@@ -138,6 +139,8 @@ public:
         oa << IndexVersion::currentVersion;
         oa << dataObject;
         ofs.close();
+        if (!srch2::util::syncFile(serializedFileName))
+            throw std::runtime_error("Error syncing " + serializedFileName);
     }
     Serializer();
     ~Serializer();
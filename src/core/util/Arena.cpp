@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Arena.h"
+
+namespace srch2 {
+namespace util {
+
+Arena::Arena(std::size_t initialChunkSize, std::size_t maximumChunkSize) {
+    this->current = NULL;
+    this->end = NULL;
+    this->nextChunkSize = initialChunkSize;
+    this->maximumChunkSize = maximumChunkSize < initialChunkSize ? initialChunkSize : maximumChunkSize;
+    this->numberOfBytes = 0;
+}
+
+Arena::~Arena() {
+    for (unsigned i = 0; i < this->chunks.size(); ++i) {
+        delete [] this->chunks[i];
+    }
+}
+
+void *Arena::allocateSlow(std::size_t numberOfBytes, std::size_t alignment) {
+    std::size_t chunkSize = this->nextChunkSize;
+    if (this->nextChunkSize < this->maximumChunkSize) {
+        this->nextChunkSize *= 2;
+    }
+    // an allocation bigger than a chunk gets a chunk of its own
+    if (chunkSize < numberOfBytes + alignment) {
+        chunkSize = numberOfBytes + alignment;
+    }
+    char *chunk = new char[chunkSize];
+    this->chunks.push_back(chunk);
+    this->chunkSizes.push_back(chunkSize);
+    this->numberOfBytes += chunkSize;
+
+    char *begin = (char *)(((std::size_t)chunk + alignment - 1) & ~(alignment - 1));
+    // keep bumping in the chunk with the most room left
+    if (this->current == NULL || chunk + chunkSize - (begin + numberOfBytes) > this->end - this->current) {
+        this->current = begin + numberOfBytes;
+        this->end = chunk + chunkSize;
+    }
+    return begin;
+}
+
+void Arena::reset() {
+    if (this->chunks.empty()) {
+        return;
+    }
+    // keep the largest chunk for the next round
+    unsigned largest = 0;
+    for (unsigned i = 1; i < this->chunks.size(); ++i) {
+        if (this->chunkSizes[i] > this->chunkSizes[largest]) {
+            largest = i;
+        }
+    }
+    for (unsigned i = 0; i < this->chunks.size(); ++i) {
+        if (i != largest) {
+            delete [] this->chunks[i];
+        }
+    }
+    char *chunk = this->chunks[largest];
+    std::size_t chunkSize = this->chunkSizes[largest];
+    this->chunks.assign(1, chunk);
+    this->chunkSizes.assign(1, chunkSize);
+    this->numberOfBytes = chunkSize;
+    this->current = chunk;
+    this->end = chunk + chunkSize;
+}
+
+}
+}
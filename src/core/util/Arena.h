@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CORE_UTIL_ARENA_H__
+#define __CORE_UTIL_ARENA_H__
+
+#include <cstddef>
+#include <vector>
+
+namespace srch2 {
+namespace util {
+
+/*
+ *  A bump allocator for objects which all die at the same time, e.g., the tuples and results of one
+ *  query. Allocation moves a pointer in the current chunk and there is no per-object free: reset()
+ *  releases everything at once. The chunks grow geometrically so that small queries take little
+ *  memory, and reset() keeps the largest chunk so that the next query does not allocate at all.
+ *
+ *  The arena does not call destructors; the owner of objects with non-trivial destructors calls
+ *  them before reset(). It is not thread safe.
+ */
+class Arena {
+public:
+    explicit Arena(std::size_t initialChunkSize = 4 * 1024, std::size_t maximumChunkSize = 1024 * 1024);
+    ~Arena();
+
+    // alignment must be a power of two
+    void *allocate(std::size_t numberOfBytes, std::size_t alignment = sizeof(void *)) {
+        char *begin = (char *)(((std::size_t)this->current + alignment - 1) & ~(alignment - 1));
+        if (this->current == NULL || begin + numberOfBytes > this->end) {
+            return allocateSlow(numberOfBytes, alignment);
+        }
+        this->current = begin + numberOfBytes;
+        return begin;
+    }
+
+    // uninitialized memory for n objects of a POD type, NULL if n is 0
+    template <class T>
+    T *allocateArray(std::size_t n) {
+        if (n == 0) {
+            return NULL;
+        }
+        return (T *)allocate(n * sizeof(T), __alignof__(T));
+    }
+
+    // frees all the allocations at once
+    void reset();
+
+    // the memory taken by the chunks
+    std::size_t getNumberOfBytes() const {
+        return this->numberOfBytes;
+    }
+
+private:
+    void *allocateSlow(std::size_t numberOfBytes, std::size_t alignment);
+
+    std::vector<char *> chunks;
+    std::vector<std::size_t> chunkSizes;
+    char *current;
+    char *end;
+    std::size_t nextChunkSize;
+    std::size_t maximumChunkSize;
+    std::size_t numberOfBytes;
+
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+};
+
+}
+}
+
+#endif // __CORE_UTIL_ARENA_H__
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CORE_UTIL_BLOCKPACKING_H__
+#define __CORE_UTIL_BLOCKPACKING_H__
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace srch2 {
+namespace util {
+
+/*
+ *  Bit packing of blocks of 128 unsigned integers in the layout of SIMD-BP128.
+ *
+ *  The values of a block are split in four lanes (value i goes to lane i % 4), and each lane
+ *  is packed with the same bit width, so a block of width b takes exactly 4 * b words and word k
+ *  of lane l is stored at position 4 * k + l. With this layout one 128-bit register holds the
+ *  same word of the four lanes, and unpacking decodes four values per shift and mask.
+ *  The scalar code produces and reads the same layout, so packed data does not depend on the CPU.
+ *
+ *  Values are packed relative to a base (frame of reference): the caller passes the minimum of
+ *  the block, and the width is the number of bits of (maximum - base).
+ */
+class BlockPacking {
+public:
+    static const unsigned BLOCK_SIZE = 128;
+    static const unsigned LANES = 4;
+    static const unsigned VALUES_PER_LANE = BLOCK_SIZE / LANES;
+
+    static unsigned getBitWidth(unsigned value) {
+        return value == 0 ? 0 : 32 - __builtin_clz(value);
+    }
+
+    // number of words of a packed block of the given width
+    static unsigned getNumberOfWords(unsigned bitWidth) {
+        return LANES * bitWidth;
+    }
+
+    // packs BLOCK_SIZE values of "in" into getNumberOfWords(bitWidth) words of "out".
+    // Every value must be in [base, base + 2^bitWidth).
+    static void pack(const unsigned *in, unsigned base, unsigned bitWidth, unsigned *out) {
+        unsigned numberOfWords = getNumberOfWords(bitWidth);
+        memset(out, 0, numberOfWords * sizeof(unsigned));
+        if (bitWidth == 0)
+            return;
+        for (unsigned lane = 0; lane < LANES; ++lane) {
+            unsigned bitPosition = 0;
+            for (unsigned i = 0; i < VALUES_PER_LANE; ++i, bitPosition += bitWidth) {
+                unsigned value = in[LANES * i + lane] - base;
+                unsigned word = bitPosition / 32;
+                unsigned shift = bitPosition % 32;
+                out[LANES * word + lane] |= value << shift;
+                if (shift + bitWidth > 32)
+                    out[LANES * (word + 1) + lane] |= value >> (32 - shift);
+            }
+        }
+    }
+
+    // unpacks a block written by pack() into BLOCK_SIZE values of "out"
+    static void unpack(const unsigned *in, unsigned base, unsigned bitWidth, unsigned *out) {
+        if (bitWidth == 0) {
+            for (unsigned i = 0; i < BLOCK_SIZE; ++i)
+                out[i] = base;
+            return;
+        }
+#ifdef __SSE2__
+        unpackSSE2(in, base, bitWidth, out);
+#else
+        unpackScalar(in, base, bitWidth, out);
+#endif
+    }
+
+    static void unpackScalar(const unsigned *in, unsigned base, unsigned bitWidth, unsigned *out) {
+        const unsigned mask = bitWidth == 32 ? ~0u : (1u << bitWidth) - 1;
+        for (unsigned lane = 0; lane < LANES; ++lane) {
+            unsigned bitPosition = 0;
+            for (unsigned i = 0; i < VALUES_PER_LANE; ++i, bitPosition += bitWidth) {
+                unsigned word = bitPosition / 32;
+                unsigned shift = bitPosition % 32;
+                unsigned value = in[LANES * word + lane] >> shift;
+                if (shift + bitWidth > 32)
+                    value |= in[LANES * (word + 1) + lane] << (32 - shift);
+                out[LANES * i + lane] = (value & mask) + base;
+            }
+        }
+    }
+
+#ifdef __SSE2__
+    static void unpackSSE2(const unsigned *in, unsigned base, unsigned bitWidth, unsigned *out) {
+        const __m128i mask = _mm_set1_epi32(bitWidth == 32 ? ~0u : (1u << bitWidth) - 1);
+        const __m128i baseVector = _mm_set1_epi32(base);
+        const __m128i *input = (const __m128i *) in;
+        __m128i *output = (__m128i *) out;
+        __m128i current = _mm_loadu_si128(input++);
+        unsigned shift = 0;
+        for (unsigned i = 0; i < VALUES_PER_LANE; ++i) {
+            __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(shift));
+            shift += bitWidth;
+            if (shift >= 32) {
+                shift -= 32;
+                // the last value of a lane ends exactly at the end of the block
+                if (i + 1 < VALUES_PER_LANE) {
+                    current = _mm_loadu_si128(input++);
+                    if (shift > 0)
+                        value = _mm_or_si128(value, _mm_sll_epi32(current, _mm_cvtsi32_si128(bitWidth - shift)));
+                }
+            }
+            _mm_storeu_si128(output + i, _mm_add_epi32(_mm_and_si128(value, mask), baseVector));
+        }
+    }
+#endif
+};
+
+}
+}
+
+#endif // __CORE_UTIL_BLOCKPACKING_H__
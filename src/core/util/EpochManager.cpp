@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "EpochManager.h"
+
+#include <climits>
+#include <sched.h>
+#include <boost/thread/tss.hpp>
+#include "util/Assert.h"
+
+namespace srch2 {
+namespace util {
+
+// the epoch of a slot whose thread is not in
+static const unsigned long NOT_PINNED = ULONG_MAX;
+
+struct EpochManager::ReaderSlot {
+    // written by the thread of the slot, read by writers
+    volatile unsigned long pinnedEpoch;
+    // only used by the thread of the slot
+    unsigned nestingDepth;
+    unsigned index;
+    // the slots never share a cache line
+    char padding[128 - sizeof(unsigned long) - 2 * sizeof(unsigned)];
+};
+
+// A thread gets the lowest number no live thread has when it first enters an epoch, and gives it back
+// when it exits, so the numbers stay below the number of threads. A thread must exit every epoch it
+// entered before it ends, since the next thread with its number takes over its slots.
+static const unsigned MAXIMUM_NUMBER_OF_THREADS = 64 * 256;
+static volatile unsigned isThreadNumberTaken[MAXIMUM_NUMBER_OF_THREADS];
+
+static void releaseThreadNumber(unsigned *threadNumber) {
+    __sync_lock_release(&isThreadNumberTaken[*threadNumber]);
+    delete threadNumber;
+}
+
+static boost::thread_specific_ptr<unsigned> threadNumberOfCurrentThread(releaseThreadNumber);
+
+static unsigned getThreadNumber() {
+    unsigned *threadNumber = threadNumberOfCurrentThread.get();
+    if (threadNumber != NULL)
+        return *threadNumber;
+    for (unsigned i = 0; i < MAXIMUM_NUMBER_OF_THREADS; ++i) {
+        if (isThreadNumberTaken[i] == 0 && __sync_lock_test_and_set(&isThreadNumberTaken[i], 1) == 0) {
+            threadNumberOfCurrentThread.reset(new unsigned(i));
+            return i;
+        }
+    }
+    ASSERT(false);
+    return MAXIMUM_NUMBER_OF_THREADS;
+}
+
+EpochManager::EpochManager() {
+    for (unsigned i = 0; i < MAXIMUM_NUMBER_OF_CHUNKS; ++i)
+        this->chunks[i] = NULL;
+    this->globalEpoch = 1;
+}
+
+EpochManager::~EpochManager() {
+    for (unsigned i = 0; i < MAXIMUM_NUMBER_OF_CHUNKS; ++i)
+        delete[] this->chunks[i];
+}
+
+EpochManager::ReaderSlot *EpochManager::getSlot(unsigned threadNumber) const {
+    ReaderSlot *chunk = this->chunks[threadNumber / SLOTS_PER_CHUNK];
+    return chunk == NULL ? NULL : chunk + threadNumber % SLOTS_PER_CHUNK;
+}
+
+EpochManager::ReaderSlot *EpochManager::enter() {
+    const unsigned threadNumber = getThreadNumber();
+    ReaderSlot *slot = this->getSlot(threadNumber);
+    if (slot == NULL) {
+        // the first thread of the chunk allocates it, another one that tries at the same time drops its copy
+        const unsigned chunkIndex = threadNumber / SLOTS_PER_CHUNK;
+        ReaderSlot *chunk = new ReaderSlot[SLOTS_PER_CHUNK];
+        for (unsigned i = 0; i < SLOTS_PER_CHUNK; ++i) {
+            chunk[i].pinnedEpoch = NOT_PINNED;
+            chunk[i].nestingDepth = 0;
+            chunk[i].index = chunkIndex * SLOTS_PER_CHUNK + i;
+        }
+        if (!__sync_bool_compare_and_swap(&this->chunks[chunkIndex], (ReaderSlot *) NULL, chunk))
+            delete[] chunk;
+        slot = this->getSlot(threadNumber);
+    }
+    if (slot->nestingDepth++ == 0) {
+        slot->pinnedEpoch = this->globalEpoch;
+        // the pinned epoch must be visible to writers before the reader reads a published pointer
+        __sync_synchronize();
+    }
+    return slot;
+}
+
+void EpochManager::exit(ReaderSlot *slot) {
+    if (--slot->nestingDepth == 0) {
+        // the reads of the reader must be done before a writer sees it out
+        __sync_synchronize();
+        slot->pinnedEpoch = NOT_PINNED;
+    }
+}
+
+bool EpochManager::isEnteredByCurrentThread() const {
+    const unsigned *threadNumber = threadNumberOfCurrentThread.get();
+    if (threadNumber == NULL)
+        return false;
+    const ReaderSlot *slot = this->getSlot(*threadNumber);
+    return slot != NULL && slot->nestingDepth > 0;
+}
+
+unsigned EpochManager::getSlotIndex(const ReaderSlot *slot) {
+    return slot->index;
+}
+
+unsigned long EpochManager::advanceEpoch() {
+    // a full barrier, so the pointer published before is visible to the readers of the new epoch
+    return __sync_fetch_and_add(&this->globalEpoch, 1);
+}
+
+unsigned long EpochManager::getOldestPinnedEpoch() const {
+    __sync_synchronize();
+    unsigned long oldestEpoch = this->globalEpoch;
+    for (unsigned i = 0; i < MAXIMUM_NUMBER_OF_CHUNKS; ++i) {
+        const ReaderSlot *chunk = this->chunks[i];
+        for (unsigned j = 0; chunk != NULL && j < SLOTS_PER_CHUNK; ++j) {
+            const unsigned long pinnedEpoch = chunk[j].pinnedEpoch;
+            if (pinnedEpoch < oldestEpoch)
+                oldestEpoch = pinnedEpoch;
+        }
+    }
+    return oldestEpoch;
+}
+
+void EpochManager::synchronize() {
+    const unsigned long epoch = this->advanceEpoch();
+    const unsigned *threadNumber = threadNumberOfCurrentThread.get();
+    const ReaderSlot *slotOfCaller = threadNumber == NULL ? NULL : this->getSlot(*threadNumber);
+    for (unsigned i = 0; i < MAXIMUM_NUMBER_OF_CHUNKS; ++i) {
+        // chunks allocated after the scan started only have slots that pin newer epochs
+        const ReaderSlot *chunk = this->chunks[i];
+        for (unsigned j = 0; chunk != NULL && j < SLOTS_PER_CHUNK; ++j) {
+            while (&chunk[j] != slotOfCaller && chunk[j].pinnedEpoch <= epoch)
+                sched_yield();
+        }
+    }
+}
+
+void EpochRetireList::retire(const boost::shared_ptr<const void> &object) {
+    this->objects.push_back(std::make_pair(this->epochManager.advanceEpoch(), object));
+    this->reclaim();
+}
+
+void EpochRetireList::reclaim() {
+    if (this->objects.empty())
+        return;
+    const unsigned long oldestPinnedEpoch = this->epochManager.getOldestPinnedEpoch();
+    while (!this->objects.empty() && this->objects.front().first < oldestPinnedEpoch)
+        this->objects.pop_front();
+}
+
+}
+}
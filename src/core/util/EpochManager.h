@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __CORE_UTIL_EPOCHMANAGER_H__
+#define __CORE_UTIL_EPOCHMANAGER_H__
+
+#include <deque>
+#include <utility>
+#include <boost/shared_ptr.hpp>
+
+namespace srch2 {
+namespace util {
+
+/*
+ *  Epoch based reclamation of the objects that the writer replaces while readers may still use them.
+ *
+ *  A reader pins the current epoch with enter() before it reads a published pointer, and unpins it
+ *  with exit() when it is done with everything it reached from it. Each thread has its own slot, on its
+ *  own cache line, so entering and exiting only write memory that no other reader writes.
+ *
+ *  The writer publishes the new pointer first and then retires the old object (EpochRetireList).
+ *  Retiring starts a new epoch and tags the object with the previous one. The object is released once
+ *  no reader has an epoch pinned that is not newer than its tag, because every reader that entered
+ *  after the new epoch started reads the new pointer.
+ *
+ *  Every structure with its own writer has its own EpochManager, so a writer only waits for the
+ *  readers of its structure (see synchronize()) and never for a thread that is pinned in another one.
+ */
+class EpochManager {
+public:
+    struct ReaderSlot;
+
+    EpochManager();
+    // No thread may be in anymore
+    ~EpochManager();
+
+    // Pins the current epoch for the calling thread. Calls nest, the epoch of the outermost one is kept.
+    ReaderSlot *enter();
+    // must be called by the thread that got slot from enter()
+    static void exit(ReaderSlot *slot);
+    // true if the calling thread has an epoch of this manager pinned
+    bool isEnteredByCurrentThread() const;
+
+    // A small number that identifies the thread of slot among the threads that entered, used to
+    // spread counters of readers over cache lines. A thread has the same number in every manager.
+    static unsigned getSlotIndex(const ReaderSlot *slot);
+
+    // Starts a new epoch, returns the one objects retired now are tagged with
+    unsigned long advanceEpoch();
+    // The oldest epoch pinned by a reader, or the current epoch if no reader is in
+    unsigned long getOldestPinnedEpoch() const;
+    // Waits until every reader that entered before the call has exited. The epoch the calling thread
+    // may have pinned itself is ignored. Readers that enter later see every write made before the call.
+    void synchronize();
+
+private:
+    // The slot of a thread is found by its thread number (see getSlotIndex()), in chunks that are
+    // allocated when a thread with a higher number enters for the first time and never freed.
+    static const unsigned SLOTS_PER_CHUNK = 64;
+    static const unsigned MAXIMUM_NUMBER_OF_CHUNKS = 256;
+
+    ReaderSlot *getSlot(unsigned threadNumber) const;
+
+    ReaderSlot * volatile chunks[MAXIMUM_NUMBER_OF_CHUNKS];
+    // starts at 1 so that no tag is older than every pinned epoch
+    volatile unsigned long globalEpoch;
+
+    EpochManager(const EpochManager &);
+    EpochManager &operator=(const EpochManager &);
+};
+
+/*
+ *  The objects a writer retired, each one kept alive until no reader of epochManager can reach it
+ *  anymore. Only the writer uses the list, it is not thread-safe.
+ */
+class EpochRetireList {
+public:
+    EpochRetireList(EpochManager &epochManager): epochManager(epochManager) {}
+    // The remaining objects are released. No reader may still use them.
+    ~EpochRetireList() {}
+    // releases every object, no reader may still use them
+    void clear() {
+        this->objects.clear();
+    }
+
+    // The object must not be reachable from a published pointer anymore
+    void retire(const boost::shared_ptr<const void> &object);
+    // releases the objects no reader can reach anymore
+    void reclaim();
+
+    unsigned size() const {
+        return this->objects.size();
+    }
+
+private:
+    EpochManager &epochManager;
+    // in the order they were retired, so the tags only grow
+    std::deque<std::pair<unsigned long, boost::shared_ptr<const void> > > objects;
+};
+
+}
+}
+
+#endif /* __CORE_UTIL_EPOCHMANAGER_H__ */
@@ -28,6 +28,8 @@
 #include <limits.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include "FileOps.h"
 #include "Logger.h"
 
@@ -78,5 +80,32 @@ int createDir(const char *pathName)
     return 0;
 }
 
+static bool syncPath(const char *pathName, int flags)
+{
+    int fd = open(pathName, flags);
+    if (fd == -1) {
+        Logger::error("open %s for sync fail: %s", pathName, strerror(errno));
+        return false;
+    }
+    bool synced = (fsync(fd) == 0);
+    if (!synced)
+        Logger::error("fsync %s fail: %s", pathName, strerror(errno));
+    close(fd);
+    return synced;
+}
+
+bool syncFile(const string &fileName)
+{
+    return syncPath(fileName.c_str(), O_RDWR);
+}
+
+bool syncParentDir(const string &fileName)
+{
+    string dirName = getFilePath(fileName);
+    if (dirName.empty())
+        dirName = (!fileName.empty() && fileName[0] == '/') ? "/" : ".";
+    return syncPath(dirName.c_str(), O_RDONLY);
+}
+
 }
 }
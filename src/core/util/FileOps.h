@@ -34,6 +34,10 @@ namespace util {
 string getFilePath(string fullPathFileName);
 bool checkDirExistence(const char *dirName);
 int createDir(const char *pathName);
+// flush the data of a file to the disk, returns false on failure
+bool syncFile(const string &fileName);
+// flush the directory that contains fileName, which makes the creation or renaming of the file durable
+bool syncParentDir(const string &fileName);
 
 }
 }
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MappedFile.h"
+#include "Logger.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdexcept>
+
+namespace srch2 {
+namespace util {
+
+boost::shared_ptr<MappedFile> MappedFile::open(const std::string &fileName) {
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd == -1) {
+        Logger::error("Cannot open %s for mapping: %s", fileName.c_str(), strerror(errno));
+        throw std::runtime_error("Error opening " + fileName);
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1 || fileStat.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot map empty or unreadable file " + fileName);
+    }
+
+    size_t size = fileStat.st_size;
+    // PROT_WRITE with MAP_PRIVATE gives copy-on-write pages: the file on disk is never modified.
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the descriptor is closed.
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        Logger::error("Cannot map %s: %s", fileName.c_str(), strerror(errno));
+        throw std::runtime_error("Error mapping " + fileName);
+    }
+
+    return boost::shared_ptr<MappedFile>(new MappedFile(fileName, (char *) addr, size));
+}
+
+MappedFile::MappedFile(const std::string &fileName, char *data, size_t size) :
+        fileName(fileName), data(data), size(size) {
+}
+
+MappedFile::~MappedFile() {
+    if (this->data != NULL) {
+        munmap(this->data, this->size);
+    }
+}
+
+}
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CORE_UTIL_MAPPEDFILE_H__
+#define __CORE_UTIL_MAPPEDFILE_H__
+
+#include <string>
+#include <cstddef>
+#include <boost/shared_ptr.hpp>
+
+namespace srch2 {
+namespace util {
+
+/*
+ *  A read-mostly memory mapping of a whole file.
+ *
+ *  The file is mapped with MAP_PRIVATE, so that its pages are shared through the page cache by every
+ *  process mapping the same file, and a write to a page only creates a private copy of that page.
+ *  Index structures use this property: their read views point directly into the mapping, and the
+ *  rare in-place updates done by the single writer never reach the file on disk.
+ *
+ *  The mapping is released when the object is destroyed, so users that keep pointers into the
+ *  mapping must also keep a shared pointer to this object.
+ */
+class MappedFile {
+public:
+    // throws std::runtime_error if the file cannot be opened or mapped.
+    static boost::shared_ptr<MappedFile> open(const std::string &fileName);
+
+    ~MappedFile();
+
+    const char *getData() const {
+        return this->data;
+    }
+
+    size_t getSize() const {
+        return this->size;
+    }
+
+    const std::string &getFileName() const {
+        return this->fileName;
+    }
+
+private:
+    MappedFile(const std::string &fileName, char *data, size_t size);
+    // not copyable
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    std::string fileName;
+    char *data;
+    size_t size;
+};
+
+}
+}
+
+#endif /* __CORE_UTIL_MAPPEDFILE_H__ */
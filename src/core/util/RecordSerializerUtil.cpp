@@ -34,8 +34,9 @@
 #include <set>
 #include <sstream>
 #include <algorithm>
-#include "thirdparty/snappy-1.0.4/snappy.h"
+#include "util/StoredFieldCodec.h"
 #include "util/DateAndTimeHandler.h"
+#include "util/Logger.h"
 
 using namespace srch2::instantsearch;
 
@@ -122,6 +123,8 @@ void RecordSerializerUtil::convertCompactToJSONString(Schema * storedAttrSchema,
 		jsonBuffer.append("{") ;
 		jsonBuffer+='"'; jsonBuffer+=*(storedAttrSchema->getPrimaryKey()); jsonBuffer+='"';
 		jsonBuffer+=":\""; jsonBuffer+=externalRecordId; jsonBuffer+="\",";
+		// holds the value of a compressed attribute; the values stored raw are read in place
+		std::string decodedValue;
 		for ( ; iter != storedAttrSchema->getSearchableAttribute().end(); iter++)
 		{
 			if (attrToReturn &&
@@ -133,39 +136,34 @@ void RecordSerializerUtil::convertCompactToJSONString(Schema * storedAttrSchema,
 				continue;
 			}
 			unsigned id = storedAttrSchema->getSearchableAttributeId(iter->first);
-			unsigned lenOffset = compactRecDeserializer.getSearchableOffset(id);
-			const char *attrdata = buffer.start.get() + *((unsigned *)(buffer.start.get() + lenOffset));
-			unsigned len = *(((unsigned *)(buffer.start.get() + lenOffset)) + 1) -
-					*((unsigned *)(buffer.start.get() + lenOffset));
-
-			std::string uncompressedInMemoryRecordString;
-			snappy::Uncompress(attrdata,len, &uncompressedInMemoryRecordString);
+			const char *value;
+			unsigned valueLength;
+			getSearchableAttributeValue(compactRecDeserializer, id, buffer.start.get(), value, valueLength,
+					decodedValue);
 			jsonBuffer+='"'; jsonBuffer+=iter->first; jsonBuffer+='"';
 			jsonBuffer+=':';
 			if (storedAttrSchema->isSearchableAttributeMultiValued(id)) {
 				jsonBuffer+='[';
-				size_t lastpos = 0;
+				const char *valueEnd = value + valueLength;
+				const char *delimiterEnd = MULTI_VAL_ATTR_DELIMITER + MULTI_VAL_ATTR_DELIMITER_LEN;
 				while(1) {
-					size_t pos = uncompressedInMemoryRecordString.find(" $$ ", lastpos) ;
-					if (pos == string::npos)
+					const char *pos = std::search(value, valueEnd, MULTI_VAL_ATTR_DELIMITER, delimiterEnd);
+					if (pos == valueEnd)
 						break;
-					string result =  uncompressedInMemoryRecordString.substr(lastpos, pos - lastpos);
 					jsonBuffer+='"';
-					cleanAndAppendToBuffer(result, jsonBuffer);
+					cleanAndAppendToBuffer(value, pos - value, jsonBuffer);
 					jsonBuffer+='"';
 					jsonBuffer+=',';
-					lastpos = pos + 4;
+					value = pos + MULTI_VAL_ATTR_DELIMITER_LEN;
 				}
-				string result =  uncompressedInMemoryRecordString.substr(lastpos,
-															uncompressedInMemoryRecordString.length());
 				jsonBuffer+='"';
-				cleanAndAppendToBuffer(result, jsonBuffer);
+				cleanAndAppendToBuffer(value, valueEnd - value, jsonBuffer);
 				jsonBuffer+='"';
 				jsonBuffer+=']';
 				jsonBuffer+=',';
 			} else {
 				jsonBuffer+='"';
-				cleanAndAppendToBuffer(uncompressedInMemoryRecordString, jsonBuffer);
+				cleanAndAppendToBuffer(value, valueLength, jsonBuffer);
 				jsonBuffer+='"';
 				jsonBuffer+=',';
 			}
@@ -233,8 +231,24 @@ void RecordSerializerUtil::convertCompactToJSONString(Schema * storedAttrSchema,
 		jsonBuffer.append("}");
 }
 
-void RecordSerializerUtil::cleanAndAppendToBuffer(const string& in, string& out) {
-	unsigned inLen = in.length();
+void RecordSerializerUtil::getSearchableAttributeValue(RecordSerializer& recSerializer,
+		unsigned searchableAttributeId, const char *data, const char *&value, unsigned &valueLength,
+		string& buffer) {
+	const unsigned *offsets = (const unsigned *)(data + recSerializer.getSearchableOffset(searchableAttributeId));
+	if (!StoredFieldCodec::decode(data + offsets[0], offsets[1] - offsets[0], value, valueLength, buffer)) {
+		Logger::warn("Could not decode the value of a stored attribute.");
+	}
+}
+
+void RecordSerializerUtil::getSearchableAttributeValue(RecordSerializer& recSerializer,
+		unsigned searchableAttributeId, const char *data, string& value) {
+	const unsigned *offsets = (const unsigned *)(data + recSerializer.getSearchableOffset(searchableAttributeId));
+	if (!StoredFieldCodec::decode(data + offsets[0], offsets[1] - offsets[0], value)) {
+		Logger::warn("Could not decode the value of a stored attribute.");
+	}
+}
+
+void RecordSerializerUtil::cleanAndAppendToBuffer(const char *in, unsigned inLen, string& out) {
 	unsigned inIdx = 0;
 	while (inIdx < inLen) {
 		// remove non printable characters
@@ -276,12 +290,20 @@ void RecordSerializerUtil::getBatchOfAttributes(
         const std::vector<string> & refiningAttributes, const Schema * schema, const Byte* data,
         std::vector<TypedValue> * typedValuesArg)  {
 
-    std::vector<TypedValue>& typedValues = (*typedValuesArg);
     Schema *storedSchema = Schema::create();
     RecordSerializerUtil::populateStoredSchema(storedSchema, schema);
     RecordSerializer recSerializer(*storedSchema);
+    getBatchOfAttributes(refiningAttributes, schema, recSerializer, data, typedValuesArg);
+    delete storedSchema;
+}
+
+void RecordSerializerUtil::getBatchOfAttributes(
+        const std::vector<string> & refiningAttributes, const Schema * schema,
+        RecordSerializer& recSerializer, const Byte* data,
+        std::vector<TypedValue> * typedValuesArg)  {
+
+    std::vector<TypedValue>& typedValues = (*typedValuesArg);
     // now extract the scores
-    unsigned startOffset = 0;
     for(unsigned i = 0 ; i < refiningAttributes.size(); ++i){
     	const string& name = refiningAttributes[i];
     	FilterType type = getAttributeType(name, schema);
@@ -290,7 +312,6 @@ void RecordSerializerUtil::getBatchOfAttributes(
         convertByteArrayToTypedValue(name , multiVal, type, recSerializer, data , &attributeValue);
         typedValues.push_back(attributeValue);
     }
-    delete storedSchema;
 }
 
 FilterType RecordSerializerUtil::getAttributeType(const string& name,
@@ -412,13 +433,9 @@ void RecordSerializerUtil::convertByteArrayToTypedValue(const string& name,
         }
 		case ATTRIBUTE_TYPE_TEXT:
 		{
-			unsigned lenOffset = 0;
-			if (recSerializer.getStorageSchema().getSearchableAttributeId(name) != -1) {
-				lenOffset = recSerializer.getSearchableOffset(name);
-				const char *attrdata = data + *((unsigned *)(data + lenOffset));
-				unsigned len = *(((unsigned *)(data + lenOffset)) + 1) -
-						*((unsigned *)(data + lenOffset));
-				snappy::Uncompress(attrdata,len, &stringValue);
+			int searchableAttributeId = recSerializer.getStorageSchema().getSearchableAttributeId(name);
+			if (searchableAttributeId != -1) {
+				getSearchableAttributeValue(recSerializer, searchableAttributeId, data, stringValue);
 				std::transform(stringValue.begin(), stringValue.end(), stringValue.begin(), ::tolower);
 			} else {
 				ASSERT(false);  // for Debug mode
@@ -428,13 +445,9 @@ void RecordSerializerUtil::convertByteArrayToTypedValue(const string& name,
 		}
 		case ATTRIBUTE_TYPE_TIME:
 		{
-			unsigned lenOffset = 0;
-			if (recSerializer.getStorageSchema().getSearchableAttributeId(name) != -1) {
-				lenOffset = recSerializer.getSearchableOffset(name);
-				const char *attrdata = data + *((unsigned *)(data + lenOffset));
-				unsigned len = *(((unsigned *)(data + lenOffset)) + 1) -
-						*((unsigned *)(data + lenOffset));
-				snappy::Uncompress(attrdata,len, &stringValue);
+			int searchableAttributeId = recSerializer.getStorageSchema().getSearchableAttributeId(name);
+			if (searchableAttributeId != -1) {
+				getSearchableAttributeValue(recSerializer, searchableAttributeId, data, stringValue);
 				longValue = DateAndTimeHandler::convertDateTimeStringToSecondsFromEpoch(stringValue);
 			} else {
 				ASSERT(false);  // for Debug mode
@@ -449,15 +462,11 @@ void RecordSerializerUtil::convertByteArrayToTypedValue(const string& name,
 		}
 	}else{ // case of multi value
 
-		unsigned lenOffset = 0;
+		int searchableAttributeId = recSerializer.getStorageSchema().getSearchableAttributeId(name);
 		string stringValue = "";
 		vector<string> multiValues;
-		if (recSerializer.getStorageSchema().getSearchableAttributeId(name) != -1) {
-			lenOffset = recSerializer.getSearchableOffset(name);
-			const char *attrdata = data + *((unsigned *)(data + lenOffset));
-			unsigned len = *(((unsigned *)(data + lenOffset)) + 1) -
-					*((unsigned *)(data + lenOffset));
-			snappy::Uncompress(attrdata,len, &stringValue);
+		if (searchableAttributeId != -1) {
+			getSearchableAttributeValue(recSerializer, searchableAttributeId, data, stringValue);
 			size_t lastpos = 0;
 			while(1) {
 				size_t pos = stringValue.find(MULTI_VAL_ATTR_DELIMITER, lastpos) ;
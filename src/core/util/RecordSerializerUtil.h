@@ -53,8 +53,19 @@ public:
 			const string& externalRecordId, string& jsonBuffer);
 	static void convertCompactToJSONString(Schema * storedAttrSchema, StoredRecordBuffer buffer,
 			const string& externalRecordId, string& jsonBuffer, const vector<string>* attrToReturn);
+
+	/*
+	 * Points value at the decoded value of a variable-length attribute (a searchable attribute of the
+	 * stored schema) of a stored record. A value stored raw is read in place, without a copy; a
+	 * compressed one is decompressed into buffer (see StoredFieldCodec).
+	 */
+	static void getSearchableAttributeValue(RecordSerializer& recSerializer, unsigned searchableAttributeId,
+			const char *data, const char *&value, unsigned &valueLength, string& buffer);
+	// same as above, always copies the value
+	static void getSearchableAttributeValue(RecordSerializer& recSerializer, unsigned searchableAttributeId,
+			const char *data, string& value);
 private:
-	static void cleanAndAppendToBuffer(const string& in, string& out);
+	static void cleanAndAppendToBuffer(const char *in, unsigned inLen, string& out);
 	RecordSerializerUtil();
 	virtual ~RecordSerializerUtil();
 
@@ -65,6 +76,12 @@ public:
             const std::vector<string> & nonSearchableAttributeIndexs,
             const Schema * schema, const Byte * data, std::vector<TypedValue> * scores);
 
+    // same as above, with the serializer of the stored schema (see populateStoredSchema()) built by the caller
+    static void getBatchOfAttributes(
+            const std::vector<string> & nonSearchableAttributeIndexs,
+            const Schema * schema, RecordSerializer& recSerializer, const Byte * data,
+            std::vector<TypedValue> * scores);
+
 private:
 
     static FilterType getAttributeType(const string& name, const Schema * schema) ;
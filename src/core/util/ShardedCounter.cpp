@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ShardedCounter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <boost/thread/tss.hpp>
+
+namespace srch2 {
+namespace util {
+
+static void *allocateCacheLineAligned(size_t size) {
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, size) != 0)
+        throw std::bad_alloc();
+    memset(memory, 0, size);
+    return memory;
+}
+
+static volatile unsigned numberOfThreadsWithShard = 0;
+static boost::thread_specific_ptr<unsigned> shardIndexOfCurrentThread;
+
+unsigned ShardedCounter::getShardIndexOfCurrentThread() {
+    unsigned *shardIndex = shardIndexOfCurrentThread.get();
+    if (shardIndex == NULL) {
+        shardIndex = new unsigned(__sync_fetch_and_add(&numberOfThreadsWithShard, 1) % NUMBER_OF_SHARDS);
+        shardIndexOfCurrentThread.reset(shardIndex);
+    }
+    return *shardIndex;
+}
+
+ShardedCounter::ShardedCounter(uint64_t initialValue) {
+    this->shards = (Shard *) allocateCacheLineAligned(NUMBER_OF_SHARDS * sizeof(Shard));
+    this->shards[0].value = initialValue;
+}
+
+ShardedCounter::~ShardedCounter() {
+    free(this->shards);
+}
+
+uint64_t ShardedCounter::get() const {
+    uint64_t value = 0;
+    for (unsigned i = 0; i < NUMBER_OF_SHARDS; ++i)
+        value += this->shards[i].value;
+    return value;
+}
+
+ShardedHistogram::ShardedHistogram() {
+    this->shards = (Shard *) allocateCacheLineAligned(ShardedCounter::NUMBER_OF_SHARDS * sizeof(Shard));
+}
+
+ShardedHistogram::~ShardedHistogram() {
+    free(this->shards);
+}
+
+unsigned ShardedHistogram::getBucket(uint64_t value) {
+    if (value == 0)
+        return 0;
+    // the number of bits of value
+    unsigned bucket = 64 - __builtin_clzll(value);
+    return bucket < NUMBER_OF_BUCKETS ? bucket : NUMBER_OF_BUCKETS - 1;
+}
+
+void ShardedHistogram::add(uint64_t value) {
+    Shard &shard = this->shards[ShardedCounter::getShardIndexOfCurrentThread()];
+    __sync_fetch_and_add(&shard.buckets[getBucket(value)], 1);
+    __sync_fetch_and_add(&shard.count, 1);
+    __sync_fetch_and_add(&shard.total, value);
+    uint64_t max = shard.max;
+    while (value > max) {
+        const uint64_t previousMax = __sync_val_compare_and_swap(&shard.max, max, value);
+        if (previousMax == max)
+            break;
+        max = previousMax;
+    }
+}
+
+void ShardedHistogram::getSnapshot(Snapshot &snapshot) const {
+    memset(&snapshot, 0, sizeof(snapshot));
+    for (unsigned i = 0; i < ShardedCounter::NUMBER_OF_SHARDS; ++i) {
+        const Shard &shard = this->shards[i];
+        snapshot.count += shard.count;
+        snapshot.total += shard.total;
+        if (shard.max > snapshot.max)
+            snapshot.max = shard.max;
+        for (unsigned bucket = 0; bucket < NUMBER_OF_BUCKETS; ++bucket)
+            snapshot.buckets[bucket] += shard.buckets[bucket];
+    }
+}
+
+std::string ShardedHistogram::getJsonString(const std::string &unit) const {
+    Snapshot snapshot;
+    getSnapshot(snapshot);
+    std::stringstream str;
+    str << "{\"count\":" << snapshot.count << ",\"total_" << unit << "\":" << snapshot.total
+            << ",\"max_" << unit << "\":" << snapshot.max << ",\"histogram_" << unit << "\":{";
+    // the key of a bucket is its exclusive upper bound, like in MergePhaseHistograms
+    for (unsigned bucket = 0; bucket < NUMBER_OF_BUCKETS; ++bucket) {
+        if (bucket > 0)
+            str << ",";
+        if (bucket + 1 < NUMBER_OF_BUCKETS)
+            str << "\"<" << (1u << bucket) << "\":";
+        else
+            str << "\">=" << (1u << (bucket - 1)) << "\":";
+        str << snapshot.buckets[bucket];
+    }
+    str << "}}";
+    return str.str();
+}
+
+}
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CORE_UTIL_SHARDEDCOUNTER_H__
+#define __CORE_UTIL_SHARDEDCOUNTER_H__
+
+#include <stdint.h>
+#include <string>
+
+namespace srch2 {
+namespace util {
+
+/*
+ *  A counter that many threads add to and that is read rarely, e.g., by the /info request.
+ *
+ *  Each thread adds to its own shard, on its own cache line, so adding does not invalidate the
+ *  cache lines of other cores. The shards are only summed when the counter is read. Threads get a
+ *  shard in the order they first add to a sharded counter; when there are more threads than shards
+ *  some of them share one, which is why adding is still atomic.
+ */
+class ShardedCounter {
+public:
+    static const unsigned NUMBER_OF_SHARDS = 64;
+
+    ShardedCounter(uint64_t initialValue = 0);
+    ~ShardedCounter();
+
+    void add(uint64_t value = 1) {
+        addToShard(getShardIndexOfCurrentThread(), value);
+    }
+    // for callers that already know a small number identifying their thread
+    void addToShard(unsigned shardIndex, uint64_t value) {
+        __sync_fetch_and_add(&this->shards[shardIndex % NUMBER_OF_SHARDS].value, value);
+    }
+
+    // the sum of the shards. Adds that run concurrently may or may not be included.
+    uint64_t get() const;
+
+    // The shard of the calling thread, the same one for all the sharded counters and histograms
+    static unsigned getShardIndexOfCurrentThread();
+
+private:
+    struct Shard {
+        volatile uint64_t value;
+        char padding[64 - sizeof(uint64_t)];
+    };
+    // aligned on a cache line
+    Shard *shards;
+
+    ShardedCounter(const ShardedCounter &);
+    ShardedCounter &operator=(const ShardedCounter &);
+};
+
+/*
+ *  A histogram of values, e.g., latencies in microseconds, sharded by thread like ShardedCounter.
+ *  Bucket i counts the values less than 2^i, and not less than 2^(i-1), and the last bucket counts
+ *  the larger ones.
+ */
+class ShardedHistogram {
+public:
+    static const unsigned NUMBER_OF_BUCKETS = 24;
+
+    struct Snapshot {
+        uint64_t count;
+        uint64_t total;
+        uint64_t max;
+        uint64_t buckets[NUMBER_OF_BUCKETS];
+    };
+
+    ShardedHistogram();
+    ~ShardedHistogram();
+
+    void add(uint64_t value);
+
+    // sums the shards
+    void getSnapshot(Snapshot &snapshot) const;
+
+    // A JSON object with the count, total, maximum and buckets, for instance
+    // {"count":2,"total_us":5,"max_us":4,"histogram_us":{"<1":0,"<2":1,...,">=4194304":0}}
+    std::string getJsonString(const std::string &unit) const;
+
+    static unsigned getBucket(uint64_t value);
+
+private:
+    struct Shard {
+        volatile uint64_t count;
+        volatile uint64_t total;
+        volatile uint64_t max;
+        volatile uint64_t buckets[NUMBER_OF_BUCKETS];
+        char padding[64 - ((NUMBER_OF_BUCKETS + 3) * sizeof(uint64_t)) % 64];
+    };
+    // aligned on a cache line
+    Shard *shards;
+
+    ShardedHistogram(const ShardedHistogram &);
+    ShardedHistogram &operator=(const ShardedHistogram &);
+};
+
+}
+}
+
+#endif /* __CORE_UTIL_SHARDEDCOUNTER_H__ */
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "StoredFieldCodec.h"
+#include <map>
+#include <cstring>
+#include <pthread.h>
+#include <zlib.h>
+#include "thirdparty/snappy-1.0.4/snappy.h"
+
+using namespace std;
+
+namespace srch2 {
+namespace util {
+
+namespace {
+// dictionary id (adler32 of the dictionary) -> dictionary
+map<unsigned, string> registeredDictionaries;
+pthread_rwlock_t registeredDictionariesLock = PTHREAD_RWLOCK_INITIALIZER;
+
+// the decoded length of a deflated value follows the encoding byte
+const unsigned DEFLATE_HEADER_LENGTH = 1 + sizeof(unsigned);
+
+// NULL if the dictionary is not registered. Registered dictionaries are never removed, so the
+// returned string stays valid.
+const string *findDictionary(unsigned id) {
+    const string *dictionary = NULL;
+    pthread_rwlock_rdlock(&registeredDictionariesLock);
+    map<unsigned, string>::const_iterator iter = registeredDictionaries.find(id);
+    if (iter != registeredDictionaries.end()) {
+        dictionary = &iter->second;
+    }
+    pthread_rwlock_unlock(&registeredDictionariesLock);
+    return dictionary;
+}
+
+void encodeRaw(const char *value, unsigned valueLength, string &encoded) {
+    encoded.reserve(1 + valueLength);
+    encoded.assign(1, (char) StoredFieldCodec::STORED_FIELD_RAW);
+    encoded.append(value, valueLength);
+}
+
+// Returns false if the value does not get smaller
+bool encodeSnappy(const char *value, unsigned valueLength, string &encoded) {
+    encoded.resize(1 + snappy::MaxCompressedLength(valueLength));
+    encoded[0] = (char) StoredFieldCodec::STORED_FIELD_SNAPPY;
+    size_t compressedLength;
+    snappy::RawCompress(value, valueLength, &encoded[1], &compressedLength);
+    encoded.resize(1 + compressedLength);
+    return compressedLength < valueLength;
+}
+
+// Returns false if the value does not get smaller
+bool encodeDeflate(const char *value, unsigned valueLength, const string &dictionary, string &encoded) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return false;
+    }
+    bool success = false;
+    if (deflateSetDictionary(&stream, (const Bytef *) dictionary.data(), dictionary.size()) == Z_OK) {
+        encoded.resize(DEFLATE_HEADER_LENGTH + deflateBound(&stream, valueLength));
+        encoded[0] = (char) StoredFieldCodec::STORED_FIELD_DEFLATE;
+        memcpy(&encoded[1], &valueLength, sizeof(unsigned));
+        stream.next_in = (Bytef *) value;
+        stream.avail_in = valueLength;
+        stream.next_out = (Bytef *) &encoded[DEFLATE_HEADER_LENGTH];
+        stream.avail_out = encoded.size() - DEFLATE_HEADER_LENGTH;
+        if (deflate(&stream, Z_FINISH) == Z_STREAM_END) {
+            encoded.resize(DEFLATE_HEADER_LENGTH + stream.total_out);
+            success = encoded.size() < 1 + valueLength;
+        }
+    }
+    deflateEnd(&stream);
+    return success;
+}
+}
+
+unsigned StoredFieldCodec::registerDictionary(const string &dictionary) {
+    unsigned id = adler32(adler32(0L, Z_NULL, 0), (const Bytef *) dictionary.data(), dictionary.size());
+    pthread_rwlock_wrlock(&registeredDictionariesLock);
+    registeredDictionaries.insert(make_pair(id, dictionary));
+    pthread_rwlock_unlock(&registeredDictionariesLock);
+    return id;
+}
+
+void StoredFieldCodec::encode(const char *value, unsigned valueLength, const string *dictionary,
+        string &encoded) {
+    if (dictionary != NULL && !dictionary->empty()) {
+        if (encodeDeflate(value, valueLength, *dictionary, encoded)) {
+            return;
+        }
+    } else if (valueLength >= MINIMUM_COMPRESSED_LENGTH) {
+        if (encodeSnappy(value, valueLength, encoded)) {
+            return;
+        }
+    }
+    encodeRaw(value, valueLength, encoded);
+}
+
+bool StoredFieldCodec::decode(const char *encoded, unsigned encodedLength, const char *&value,
+        unsigned &valueLength, string &buffer) {
+    value = "";
+    valueLength = 0;
+    if (encodedLength == 0) {
+        return false;
+    }
+    switch (encoded[0]) {
+    case STORED_FIELD_RAW:
+        value = encoded + 1;
+        valueLength = encodedLength - 1;
+        return true;
+    case STORED_FIELD_SNAPPY:
+        if (!snappy::Uncompress(encoded + 1, encodedLength - 1, &buffer)) {
+            return false;
+        }
+        break;
+    case STORED_FIELD_DEFLATE:
+        if (!inflateWithDictionary(encoded, encodedLength, buffer)) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    value = buffer.data();
+    valueLength = buffer.size();
+    return true;
+}
+
+bool StoredFieldCodec::decode(const char *encoded, unsigned encodedLength, string &value) {
+    if (encodedLength > 0 && encoded[0] == STORED_FIELD_RAW) {
+        value.assign(encoded + 1, encodedLength - 1);
+        return true;
+    }
+    const char *decoded;
+    unsigned decodedLength;
+    if (!decode(encoded, encodedLength, decoded, decodedLength, value)) {
+        value.clear();
+        return false;
+    }
+    return true;
+}
+
+bool StoredFieldCodec::inflateWithDictionary(const char *encoded, unsigned encodedLength,
+        string &value) {
+    if (encodedLength < DEFLATE_HEADER_LENGTH) {
+        return false;
+    }
+    unsigned valueLength;
+    memcpy(&valueLength, encoded + 1, sizeof(unsigned));
+    value.resize(valueLength);
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.next_in = (Bytef *) (encoded + DEFLATE_HEADER_LENGTH);
+    stream.avail_in = encodedLength - DEFLATE_HEADER_LENGTH;
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    // an empty value has no output buffer, so point at a dummy byte
+    Bytef dummy;
+    stream.next_out = valueLength > 0 ? (Bytef *) &value[0] : &dummy;
+    stream.avail_out = valueLength;
+    int status = inflate(&stream, Z_FINISH);
+    if (status == Z_NEED_DICT) {
+        const string *dictionary = findDictionary(stream.adler);
+        if (dictionary != NULL
+                && inflateSetDictionary(&stream, (const Bytef *) dictionary->data(), dictionary->size()) == Z_OK) {
+            status = inflate(&stream, Z_FINISH);
+        }
+    }
+    bool success = status == Z_STREAM_END && stream.total_out == valueLength;
+    inflateEnd(&stream);
+    return success;
+}
+
+}
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CORE_UTIL_STOREDFIELDCODEC_H__
+#define __CORE_UTIL_STOREDFIELDCODEC_H__
+
+#include <string>
+
+namespace srch2 {
+namespace util {
+
+/*
+ *  Encodes the value of a variable-length attribute of a stored record (see RecordSerializer).
+ *  Each value is encoded on its own, so a response that returns some of the attributes of a record
+ *  only decodes those attributes. The first byte of an encoded value tells how the rest is stored:
+ *
+ *    STORED_FIELD_RAW      the value itself. Short values, and values that do not compress, are
+ *                          stored raw and are read in place without a copy.
+ *    STORED_FIELD_SNAPPY   the snappy compressed value.
+ *    STORED_FIELD_DEFLATE  a zlib stream compressed with a preset dictionary. Small documents
+ *                          compress poorly on their own; a dictionary of the strings common to
+ *                          the records of a core (e.g., the words of the values of a category
+ *                          attribute) improves the ratio. The zlib header keeps the adler32 of
+ *                          the dictionary, which decode() uses to find it in the dictionaries
+ *                          registered by registerDictionary().
+ */
+class StoredFieldCodec {
+public:
+    enum Encoding {
+        STORED_FIELD_RAW = 0,
+        STORED_FIELD_SNAPPY = 1,
+        STORED_FIELD_DEFLATE = 2
+    };
+
+    // values shorter than this are stored raw
+    static const unsigned MINIMUM_COMPRESSED_LENGTH = 64;
+
+    // Makes a dictionary known to decode() and returns its id. Dictionaries are never unregistered,
+    // so that the records encoded with them stay readable.
+    static unsigned registerDictionary(const std::string &dictionary);
+
+    // dictionary is NULL or registered by registerDictionary()
+    static void encode(const char *value, unsigned valueLength, const std::string *dictionary,
+            std::string &encoded);
+    static void encode(const std::string &value, const std::string *dictionary, std::string &encoded) {
+        encode(value.data(), value.size(), dictionary, encoded);
+    }
+
+    /*
+     * Points value at the decoded value. If the value is stored raw, value points into encoded;
+     * otherwise it is decompressed into buffer. Returns false, with an empty value, if the encoded
+     * value is corrupt or its dictionary is not registered.
+     */
+    static bool decode(const char *encoded, unsigned encodedLength, const char *&value,
+            unsigned &valueLength, std::string &buffer);
+    // same as above, always copies the value
+    static bool decode(const char *encoded, unsigned encodedLength, std::string &value);
+
+private:
+    static bool inflateWithDictionary(const char *compressed, unsigned compressedLength,
+            std::string &value);
+};
+
+}
+}
+
+#endif /* __CORE_UTIL_STOREDFIELDCODEC_H__ */
@@ -28,7 +28,7 @@
 #define __CORE_UTIL_VERSION_H__
 
 #define ENGINE_VERSION "4.4.4"
-#define INDEX_VERSION 7 // Increment this every time we make some changes to indexes
+#define INDEX_VERSION 12 // Increment this every time we make some changes to indexes
 #include <string>
 /**
  *  Helper class for version system. 
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "WorkStealingThreadPool.h"
+#include "Logger.h"
+
+#include <exception>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+
+namespace srch2 {
+namespace util {
+
+static WorkStealingThreadPool *sharedPool = NULL;
+static boost::once_flag sharedPoolOnceFlag = BOOST_ONCE_INIT;
+
+static void createSharedPool() {
+    // the shared pool lives until the process exits
+    sharedPool = new WorkStealingThreadPool(boost::thread::hardware_concurrency());
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(unsigned numberOfThreads) {
+    if (numberOfThreads == 0)
+        numberOfThreads = 1;
+    this->numberOfQueuedTasks = 0;
+    this->nextQueue = 0;
+    this->numberOfSleepingWorkers = 0;
+    this->isStopping = false;
+    for (unsigned i = 0; i < numberOfThreads; ++i)
+        this->queues.push_back(new TaskQueue());
+    for (unsigned i = 0; i < numberOfThreads; ++i)
+        this->threads.push_back(new boost::thread(boost::bind(&WorkStealingThreadPool::workerLoop, this, i)));
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+    {
+        boost::unique_lock<boost::mutex> lock(this->idleMutex);
+        this->isStopping = true;
+    }
+    this->taskAvailable.notify_all();
+    for (unsigned i = 0; i < this->threads.size(); ++i) {
+        this->threads[i]->join();
+        delete this->threads[i];
+    }
+    for (unsigned i = 0; i < this->queues.size(); ++i)
+        delete this->queues[i];
+}
+
+void WorkStealingThreadPool::submit(const Task &task) {
+    unsigned queueIndex;
+    unsigned *currentWorkerIndex = this->workerIndex.get();
+    if (currentWorkerIndex != NULL) {
+        queueIndex = *currentWorkerIndex;
+    } else {
+        queueIndex = __sync_fetch_and_add(&this->nextQueue, 1) % this->queues.size();
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(this->queues[queueIndex]->mutex);
+        this->queues[queueIndex]->tasks.push_back(task);
+    }
+    // both are full barriers, see numberOfSleepingWorkers
+    __sync_fetch_and_add(&this->numberOfQueuedTasks, 1);
+    if (__sync_fetch_and_add(&this->numberOfSleepingWorkers, 0) > 0) {
+        boost::unique_lock<boost::mutex> lock(this->idleMutex);
+        this->taskAvailable.notify_one();
+    }
+}
+
+WorkStealingThreadPool *WorkStealingThreadPool::getSharedPool() {
+    boost::call_once(createSharedPool, sharedPoolOnceFlag);
+    return sharedPool;
+}
+
+void WorkStealingThreadPool::workerLoop(unsigned index) {
+    this->workerIndex.reset(new unsigned(index));
+    Task task;
+    while (true) {
+        // own queue first, most recent task first, then steal the oldest task of another worker
+        if (takeTask(index, true, task)) {
+            try {
+                task();
+            } catch (const std::exception &e) {
+                Logger::error("Task of the query thread pool failed: %s", e.what());
+            }
+            task = Task();
+            continue;
+        }
+        boost::unique_lock<boost::mutex> lock(this->idleMutex);
+        __sync_fetch_and_add(&this->numberOfSleepingWorkers, 1);
+        while (__sync_fetch_and_add(&this->numberOfQueuedTasks, 0) <= 0 && !this->isStopping)
+            this->taskAvailable.wait(lock);
+        __sync_fetch_and_sub(&this->numberOfSleepingWorkers, 1);
+        if (this->isStopping)
+            return;
+    }
+}
+
+bool WorkStealingThreadPool::takeTask(unsigned firstQueue, bool fromBack, Task &task) {
+    for (unsigned i = 0; i < this->queues.size(); ++i) {
+        TaskQueue *queue = this->queues[(firstQueue + i) % this->queues.size()];
+        boost::unique_lock<boost::mutex> lock(queue->mutex);
+        if (queue->tasks.empty())
+            continue;
+        if (i == 0 && fromBack) {
+            task = queue->tasks.back();
+            queue->tasks.pop_back();
+        } else {
+            task = queue->tasks.front();
+            queue->tasks.pop_front();
+        }
+        lock.unlock();
+        __sync_fetch_and_sub(&this->numberOfQueuedTasks, 1);
+        return true;
+    }
+    return false;
+}
+
+TaskGroup::TaskGroup(WorkStealingThreadPool *pool) {
+    this->pool = pool;
+    this->state.reset(new State());
+    this->state->numberOfUnfinishedTasks = 0;
+    this->state->hasFailedTask = false;
+}
+
+TaskGroup::~TaskGroup() {
+    waitForUnfinishedTasks();
+    if (this->state->hasFailedTask)
+        Logger::error("Task of the query thread pool failed: %s", this->state->error.c_str());
+}
+
+void TaskGroup::run(const WorkStealingThreadPool::Task &task) {
+    {
+        boost::unique_lock<boost::mutex> lock(this->state->mutex);
+        this->state->pendingTasks.push_back(task);
+        this->state->numberOfUnfinishedTasks++;
+    }
+    this->pool->submit(boost::bind(&TaskGroup::runPendingTask, this->state));
+}
+
+void TaskGroup::wait() {
+    waitForUnfinishedTasks();
+    // the tasks are finished, nothing else changes the state
+    if (this->state->hasFailedTask) {
+        this->state->hasFailedTask = false;
+        throw std::runtime_error(this->state->error);
+    }
+}
+
+void TaskGroup::waitForUnfinishedTasks() {
+    boost::unique_lock<boost::mutex> lock(this->state->mutex);
+    while (this->state->numberOfUnfinishedTasks != 0) {
+        if (this->state->pendingTasks.empty()) {
+            // the other tasks are running on the workers. They only wait for their own tasks, so they finish.
+            this->state->finished.wait(lock);
+            continue;
+        }
+        // help instead of blocking, most recent task first. Its pool task will find nothing to run.
+        WorkStealingThreadPool::Task task = this->state->pendingTasks.back();
+        this->state->pendingTasks.pop_back();
+        lock.unlock();
+        runTask(this->state.get(), task);
+        lock.lock();
+    }
+}
+
+void TaskGroup::runPendingTask(boost::shared_ptr<State> state) {
+    WorkStealingThreadPool::Task task;
+    {
+        boost::unique_lock<boost::mutex> lock(state->mutex);
+        if (state->pendingTasks.empty())
+            return;
+        task = state->pendingTasks.front();
+        state->pendingTasks.pop_front();
+    }
+    runTask(state.get(), task);
+}
+
+void TaskGroup::runTask(State *state, const WorkStealingThreadPool::Task &task) {
+    std::string error;
+    bool failed = false;
+    try {
+        task();
+    } catch (const std::exception &e) {
+        error = e.what();
+        failed = true;
+    } catch (...) {
+        error = "unknown exception";
+        failed = true;
+    }
+    boost::unique_lock<boost::mutex> lock(state->mutex);
+    // the waiting thread gets the first error
+    if (failed && !state->hasFailedTask) {
+        state->hasFailedTask = true;
+        state->error = error;
+    }
+    state->numberOfUnfinishedTasks--;
+    if (state->numberOfUnfinishedTasks == 0)
+        state->finished.notify_all();
+}
+
+}
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CORE_UTIL_WORKSTEALINGTHREADPOOL_H__
+#define __CORE_UTIL_WORKSTEALINGTHREADPOOL_H__
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace srch2 {
+namespace util {
+
+/*
+ *  A fixed set of threads which run short tasks submitted by query threads.
+ *
+ *  Every worker has its own queue. A task submitted by a worker goes to the back of the queue of
+ *  that worker and is taken from the back (the most recent task, whose data is still in cache),
+ *  while an idle worker steals from the front of the queues of the others. Tasks submitted by other
+ *  threads are spread over the queues in round robin.
+ *
+ *  A thread which waits for its tasks should help by running its own pending tasks (see TaskGroup::wait)
+ *  instead of blocking, so that tasks which submit and wait for other tasks cannot exhaust the workers.
+ */
+class WorkStealingThreadPool {
+public:
+    typedef boost::function<void ()> Task;
+
+    explicit WorkStealingThreadPool(unsigned numberOfThreads);
+    // waits for the running tasks and stops the workers. Tasks still in the queues are not run.
+    ~WorkStealingThreadPool();
+
+    void submit(const Task &task);
+
+    unsigned getNumberOfThreads() const {
+        return this->threads.size();
+    }
+
+    // the pool shared by all queries of the process, with one thread per core
+    static WorkStealingThreadPool *getSharedPool();
+
+private:
+    struct TaskQueue {
+        boost::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<TaskQueue *> queues;
+    std::vector<boost::thread *> threads;
+
+    // Only updated with atomic operations, so that submitting and taking a task lock nothing but
+    // one queue. The count can be briefly negative when a task is taken before it is counted.
+    volatile int numberOfQueuedTasks;
+    volatile unsigned nextQueue;
+
+    // used only to put idle workers to sleep and wake them up. A worker counts itself as sleeping
+    // before it checks numberOfQueuedTasks, and submit checks numberOfSleepingWorkers after it counts
+    // the task, so one of them sees the other and no wake up is lost.
+    boost::mutex idleMutex;
+    boost::condition_variable taskAvailable;
+    volatile int numberOfSleepingWorkers;
+    bool isStopping;
+
+    // index of the queue of the current thread if it is a worker of this pool
+    boost::thread_specific_ptr<unsigned> workerIndex;
+
+    void workerLoop(unsigned index);
+    bool takeTask(unsigned firstQueue, bool fromBack, Task &task);
+
+    // not copyable
+    WorkStealingThreadPool(const WorkStealingThreadPool &);
+    WorkStealingThreadPool &operator=(const WorkStealingThreadPool &);
+};
+
+/*
+ *  A set of tasks submitted to a pool that can be waited for together.
+ *
+ *  The tasks are kept in a queue of the group, and the pool only gets a task which runs the next
+ *  one of them. So wait() can run the pending tasks of its own group, but never a task of another
+ *  request. The group is destroyed after wait(); the state is shared with the tasks still queued
+ *  in the pool, which find the queue of the group empty.
+ *
+ *  If a task throws an exception, wait() throws a std::runtime_error with its message on the
+ *  waiting thread once all the tasks are finished, as if the tasks had been run by that thread.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkStealingThreadPool *pool);
+    ~TaskGroup();
+
+    void run(const WorkStealingThreadPool::Task &task);
+    // runs the pending tasks of this group, then waits for the ones running on the workers.
+    // Throws the error of the first task that failed since the last call.
+    void wait();
+
+private:
+    struct State {
+        boost::mutex mutex;
+        boost::condition_variable finished;
+        std::deque<WorkStealingThreadPool::Task> pendingTasks;
+        unsigned numberOfUnfinishedTasks;
+        bool hasFailedTask;
+        std::string error;
+    };
+
+    WorkStealingThreadPool *pool;
+    boost::shared_ptr<State> state;
+
+    // wait() without throwing, the destructor only logs the error
+    void waitForUnfinishedTasks();
+
+    // runs the oldest pending task of the group if there is one
+    static void runPendingTask(boost::shared_ptr<State> state);
+    static void runTask(State *state, const WorkStealingThreadPool::Task &task);
+
+    // not copyable
+    TaskGroup(const TaskGroup &);
+    TaskGroup &operator=(const TaskGroup &);
+};
+
+}
+}
+
+#endif /* __CORE_UTIL_WORKSTEALINGTHREADPOOL_H__ */
@@ -48,13 +48,24 @@ struct array {
 public:
     T *extent;
     size_t capacity;
+    // false if extent points to memory owned by someone else, e.g. a mapped index snapshot
+    bool ownsExtent;
 
     array(size_t c)
     : extent(new T[c]),
-      capacity(c) {    }
+      capacity(c),
+      ownsExtent(true) {    }
+
+    // wraps an external extent of c elements, which is never freed by this array.
+    array(T *externalExtent, size_t c)
+    : extent(externalExtent),
+      capacity(c),
+      ownsExtent(false) {    }
+
     ~array()
     {
-        delete [] extent;
+        if (ownsExtent)
+            delete [] extent;
     }
 };
 
@@ -83,6 +94,15 @@ public:
         this->setNeedToFreeArray(true);
     }
 
+    // creates a view of "size" elements of an existing array. The view takes the ownership of the array.
+    vectorview(array<T>* existingArray, size_t size)
+    {
+        m_array = existingArray;
+        this->setSize(size);
+        this->setWriteView();
+        this->setNeedToFreeArray(true);
+    }
+
     ~vectorview()
     {
         // only the last readview can release the array
@@ -339,6 +359,19 @@ public:
         pthread_spin_init(&m_spinlock, 0);
     }
 
+    // Creates a committed cowvector whose read view is the external extent of "size" elements,
+    // e.g. an array in a mapped index snapshot. The extent is never freed, and the first append
+    // reallocates the write view as it does after a load(). In-place updates of existing elements
+    // go to the extent, so it must be writable (a MAP_PRIVATE mapping is).
+    cowvector(T* externalExtent, size_t size)
+    {
+        m_readView.reset(new vectorview<T>(new array<T>(externalExtent, size), size));
+        m_readView->setReadView();
+        m_writeView = new vectorview<T>(*m_readView);
+        m_writeView->setNeedToFreeArray(false);
+        pthread_spin_init(&m_spinlock, 0);
+    }
+
     virtual ~cowvector()
     {
         if(m_readView.get() != m_writeView)
@@ -44,6 +44,7 @@
 #include "boost/algorithm/string_regex.hpp"
 #include "boost/filesystem/path.hpp"
 #include "index/Trie.h"
+#include "util/StoredFieldCodec.h"
 
 using namespace std;
 namespace srch2is = srch2::instantsearch;
@@ -117,6 +118,9 @@ const char* const ConfigManager::maxSearchThreadsString = "maxsearchthreads";
 const char* const ConfigManager::mergeEveryMWritesString = "mergeeverymwrites";
 const char* const ConfigManager::mergeEveryNSecondsString = "mergeeverynseconds";
 const char* const ConfigManager::mergePolicyString = "mergepolicy";
+const char* const ConfigManager::writeAheadLogString = "writeaheadlog";
+const char* const ConfigManager::writeAheadLogEnabledString = "enabled";
+const char* const ConfigManager::checkpointEveryNSecondsString = "checkpointeverynseconds";
 const char* const ConfigManager::nameString = "name";
 const char* const ConfigManager::porterStemFilterString = "porterstemfilter";
 const char* const ConfigManager::prefixMatchPenaltyString = "prefixmatchpenalty";
@@ -143,6 +147,7 @@ const char* const ConfigManager::schemaString = "schema";
 const char* const ConfigManager::searchableString = "searchable";
 const char* const ConfigManager::searcherTypeString = "searchertype";
 const char* const ConfigManager::srch2HomeString = "srch2home";
+const char* const ConfigManager::storedFieldDictionaryString = "storedfielddictionary";
 const char* const ConfigManager::stopFilterString = "stopfilter";
 const char* const ConfigManager::protectedWordFilterString =
         "protectedkeywordsfilter";
@@ -349,6 +354,7 @@ CoreInfo_t::CoreInfo_t(const CoreInfo_t &src) {
 
     recordBoostFieldFlag = src.recordBoostFieldFlag;
     recordBoostField = src.recordBoostField;
+    storedFieldDictionary = src.storedFieldDictionary;
     queryTermBoost = src.queryTermBoost;
     indexCreateOrLoad = src.indexCreateOrLoad;
 
@@ -475,6 +481,29 @@ void ConfigManager::parseIndexConfig(const xml_node &indexConfigNode,
             return;
         }
     }
+
+    // storedFieldDictionary is an optional field: a file of strings common to the records, used as
+    // a preset dictionary to compress the stored values of the attributes (see StoredFieldCodec).
+    // The dictionary must stay available as long as the index built with it is used.
+    coreInfo->storedFieldDictionary = "";
+    childNode = indexConfigNode.child(storedFieldDictionaryString);
+    if (childNode && childNode.text()) {
+        string path = string(childNode.text().get());
+        boost::algorithm::trim(path);
+        if (path != "") {
+            path = boost::filesystem::path(srch2Home + path).normalize().string();
+            std::ifstream dictionaryFile(path.c_str(), std::ios::binary);
+            if (!dictionaryFile.good()) {
+                Logger::error("In core %s : The storedFieldDictionary file %s cannot be read.", coreInfo->name.c_str(), path.c_str());
+                configSuccess = false;
+                return;
+            }
+            std::stringstream dictionary;
+            dictionary << dictionaryFile.rdbuf();
+            coreInfo->storedFieldDictionary = dictionary.str();
+            srch2::util::StoredFieldCodec::registerDictionary(coreInfo->storedFieldDictionary);
+        }
+    }
 }
 
 
@@ -2232,6 +2261,30 @@ void ConfigManager::parseUpdateHandler(const xml_node &updateHandlerNode,
             (unsigned) ((coreInfo->mergeEveryMWrites * 1.0)
                     / updateHistogramWorkRatioOverTime); // 10000 for mergeEvery 1000 Writes
 
+    // <writeAheadLog><enabled>: logs the writes between two saves of the indexes. Disabled by default.
+    coreInfo->writeAheadLogEnabled = false;
+    childNode = updateHandlerNode.child(writeAheadLogString).child(writeAheadLogEnabledString);
+    if (childNode && childNode.text()) {
+        string walEnabled = childNode.text().get();
+        if (isValidBool(walEnabled)) {
+            coreInfo->writeAheadLogEnabled = childNode.text().as_bool();
+        } else {
+            Logger::warn("In core %s : The provided writeAheadLog enabled flag is not valid, so the log is disabled.", coreInfo->name.c_str());
+        }
+    }
+
+    // <writeAheadLog><checkpointEveryNSeconds>: how often the indexes are saved and the log is emptied
+    childNode = updateHandlerNode.child(writeAheadLogString).child(checkpointEveryNSecondsString);
+    coreInfo->checkpointEveryNSeconds = 600;
+    if (childNode && childNode.text()) {
+        string cens = childNode.text().get();
+        if (this->isValidMergeEveryNSeconds(cens)) {
+            coreInfo->checkpointEveryNSeconds = childNode.text().as_uint();
+        } else {
+            Logger::warn("In core %s : checkpointEveryNSeconds is not set correctly, so the engine will use the default value 600.", coreInfo->name.c_str());
+        }
+    }
+
 }
 
 bool checkValidity(string &parameter) {
@@ -2534,6 +2587,14 @@ uint32_t CoreInfo_t::getMergeEveryMWrites() const {
     return mergeEveryMWrites;
 }
 
+bool CoreInfo_t::isWriteAheadLogEnabled() const {
+    return writeAheadLogEnabled;
+}
+
+uint32_t CoreInfo_t::getCheckpointEveryNSeconds() const {
+    return checkpointEveryNSeconds;
+}
+
 uint32_t CoreInfo_t::getUpdateHistogramEveryPMerges() const {
     return updateHistogramEveryPMerges;
 }
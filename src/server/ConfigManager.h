@@ -507,6 +507,9 @@ private:
     static const char* const mergeEveryMWritesString;
     static const char* const mergeEveryNSecondsString;
     static const char* const mergePolicyString;
+    static const char* const writeAheadLogString;
+    static const char* const writeAheadLogEnabledString;
+    static const char* const checkpointEveryNSecondsString;
     static const char* const nameString;
     static const char* const porterStemFilterString;
     static const char* const tokenizerFilterString;
@@ -529,6 +532,7 @@ private:
     static const char* const searchableString;
     static const char* const searcherTypeString;
     static const char* const srch2HomeString;
+    static const char* const storedFieldDictionaryString;
     static const char* const stopFilterString;
     static const char* const protectedWordFilterString;
     static const char* const supportSwapInEditDistanceString;
@@ -675,6 +679,7 @@ public:
       { return &refiningAttributesInfo; }
     bool isRecordBoostAttributeSet() const { return recordBoostFieldFlag; }
     const std::string& getAttributeRecordBoostName() const { return recordBoostField; }
+    const std::string& getStoredFieldDictionary() const { return storedFieldDictionary; }
 
     bool isFacetEnabled() const { return facetEnabled; }
     const vector<string> *getFacetAttributes() const { return &facetAttributes; }
@@ -704,6 +709,9 @@ public:
     uint32_t getMergeEveryNSeconds() const;
     uint32_t getMergeEveryMWrites() const;
 
+    bool isWriteAheadLogEnabled() const;
+    uint32_t getCheckpointEveryNSeconds() const;
+
     uint32_t getUpdateHistogramEveryPMerges() const;
     uint32_t getUpdateHistogramEveryQWrites() const;
 
@@ -824,6 +832,8 @@ protected:
     bool recordBoostFieldFlag;
     string recordBoostField;
     string getrecordBoostField() const { return recordBoostField; }
+    // the content of the storedFieldDictionary file, empty if there is none
+    string storedFieldDictionary;
     unsigned queryTermBoost;
     IndexCreateOrLoad indexCreateOrLoad;
     IndexCreateOrLoad getindexCreateOrLoad() const { return indexCreateOrLoad; }
@@ -889,6 +899,10 @@ protected:
     unsigned mergeEveryNSeconds;
     unsigned mergeEveryMWrites;
 
+    // <config><updatehandler><writeAheadLog>
+    bool writeAheadLogEnabled;
+    unsigned checkpointEveryNSeconds;
+
     // no config option for this yet
     unsigned updateHistogramEveryPMerges;
     unsigned updateHistogramEveryQWrites;
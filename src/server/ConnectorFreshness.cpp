@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ConnectorFreshness.h"
+#include <sys/time.h>
+#include <algorithm>
+
+namespace srch2
+{
+namespace httpwrapper
+{
+
+ConnectorFreshness::ConnectorFreshness()
+    : timeOfLastPoll(0), numberOfPolls(0), numberOfChanges(0), freshnessLag(0), maxFreshnessLag(0)
+{
+}
+
+int64_t ConnectorFreshness::getTimeInMilliseconds()
+{
+    // the wall clock, as the times of the changes come from the database
+    timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+void ConnectorFreshness::reportPoll(unsigned numberOfChanges, time_t timeOfNewestChange)
+{
+    const int64_t now = getTimeInMilliseconds();
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    this->timeOfLastPoll = now;
+    ++this->numberOfPolls;
+    this->numberOfChanges += numberOfChanges;
+    if (numberOfChanges == 0) {
+        // the indexes have every change of the database
+        this->freshnessLag = 0;
+    } else if (timeOfNewestChange > 0) {
+        // the times of the changes have a precision of one second
+        this->freshnessLag = std::max<int64_t>(0, now - (int64_t) timeOfNewestChange * 1000);
+        this->maxFreshnessLag = std::max(this->maxFreshnessLag, this->freshnessLag);
+    }
+}
+
+Json::Value ConnectorFreshness::getJson() const
+{
+    Json::Value freshness(Json::objectValue);
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    if (this->numberOfPolls == 0) {
+        return freshness;
+    }
+    freshness["freshness_lag_ms"] = (Json::Int64) this->freshnessLag;
+    freshness["max_freshness_lag_ms"] = (Json::Int64) this->maxFreshnessLag;
+    freshness["last_poll_age_ms"] = (Json::Int64) (getTimeInMilliseconds() - this->timeOfLastPoll);
+    freshness["polls"] = (Json::UInt64) this->numberOfPolls;
+    freshness["changes"] = (Json::UInt64) this->numberOfChanges;
+    return freshness;
+}
+
+}
+}
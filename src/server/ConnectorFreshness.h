@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __CONNECTORFRESHNESS_H__
+#define __CONNECTORFRESHNESS_H__
+
+#include "json/value.h"
+#include <ctime>
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+
+namespace srch2
+{
+namespace httpwrapper
+{
+
+/*
+ * How far the indexes of a core lag behind the database its data connector listens to, reported
+ * in /info. The listener of the connector reports each poll of the changes of the database
+ * (see ServerInterface::reportPoll()).
+ *
+ * The lag of a change is the time from the change in the database to the poll that applied it.
+ * freshness_lag_ms is the lag of the newest change applied by the last poll, or 0 if the last poll
+ * found no change, i.e., the indexes had every change of the database. last_poll_age_ms is the time
+ * since the last poll; it keeps growing if the listener stops. The changes become searchable at the
+ * next merge of the indexes.
+ */
+class ConnectorFreshness
+{
+public:
+    ConnectorFreshness();
+
+    // timeOfNewestChange is in seconds since the epoch, 0 if unknown
+    void reportPoll(unsigned numberOfChanges, time_t timeOfNewestChange);
+
+    // an empty object before the first poll
+    Json::Value getJson() const;
+
+private:
+    static int64_t getTimeInMilliseconds();
+
+    mutable boost::mutex mutex;
+    // 0 before the first poll
+    int64_t timeOfLastPoll;
+    uint64_t numberOfPolls;
+    uint64_t numberOfChanges;
+    // the lag of the newest change of the last poll, 0 if it found no change
+    int64_t freshnessLag;
+    int64_t maxFreshnessLag;
+};
+
+}
+}
+
+#endif // __CONNECTORFRESHNESS_H__
@@ -26,10 +26,13 @@
  */
 #include <sys/time.h>
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <set>
+#include <algorithm>
+#include <cstring>
 //#include <sys/signal.h>
 #include <signal.h>
 
@@ -40,6 +43,7 @@
 
 #include "HTTPRequestHandler.h"
 #include "IndexWriteUtil.h"
+#include "WriteAheadLog.h"
 #include "instantsearch/TypedValue.h"
 #include "instantsearch/ResultsPostProcessor.h"
 #include "ParsedParameterContainer.h"
@@ -56,6 +60,7 @@
 #include "util/RecordSerializerUtil.h"
 #include "DataConnectorThread.h"
 #include "index/FeedbackIndex.h"
+#include "util/WorkStealingThreadPool.h"
 
 #define SEARCH_TYPE_OF_RANGE_QUERY_WITHOUT_KEYWORDS 2
 
@@ -148,12 +153,43 @@ namespace {
         evbuffer_free(returnbuffer);
     }
 
+    // Sends a JSON document written into buf by a JsonResponseWriter. The document is wrapped
+    // in the JSONP callback after the fact, so it is never copied into a string.
+    void bmhelper_evhttp_send_streamed_reply(evhttp_request *req, int code,
+            const char *reason, evbuffer *buf, const evkeyvalq &headers) {
+        evbuffer_add(buf, "\n", 1);
+        const char *jsonpCallBack = evhttp_find_header(&headers,
+                URLParser::jsonpCallBackName);
+        if (jsonpCallBack) {
+            size_t sz;
+            char *jsonpCallBack_cstar = evhttp_uridecode(jsonpCallBack, 0, &sz);
+            evbuffer_prepend(buf, "(", 1);
+            evbuffer_prepend(buf, jsonpCallBack_cstar, strlen(jsonpCallBack_cstar));
+            evbuffer_add(buf, ")", 1);
+            // libevent uses malloc for memory allocation. Hence, use free
+            free(jsonpCallBack_cstar);
+        }
+        bmhelper_add_content_length(req, buf);
+        evhttp_send_reply(req, code, reason, buf);
+    }
+
     void response_to_invalid_request (evhttp_request *req, Json::Value &response){
         response["error"] = HTTP_INVALID_REQUEST_MESSAGE;
         bmhelper_evhttp_send_reply(req, HTTP_BADREQUEST, "INVALID REQUEST", global_customized_writer.write(response));
         Logger::error(HTTP_INVALID_REQUEST_MESSAGE);
     }
 
+    // Writes the write-ahead log entries of a write request before its changes are applied. If they
+    // could not be written, replies with an error and the caller returns without applying the changes.
+    bool write_ahead_log_commit(evhttp_request *req, WriteAheadLogScope &writeAheadLogScope) {
+        if (writeAheadLogScope.commit())
+            return true;
+        Json::Value response(Json::objectValue);
+        response[JSON_MESSAGE] = "The changes were not applied because they could not be written to the write-ahead log";
+        bmhelper_evhttp_send_reply(req, HTTP_INTERNAL, "INTERNAL SERVER ERROR", global_customized_writer.write(response));
+        return false;
+    }
+
     // This helper function is to wrap a Json::Value into a Json::Array and then return the later object.
     Json::Value wrap_with_json_array(Json::Value value){
         Json::Value array(Json::arrayValue);
@@ -198,216 +234,137 @@ void HTTPRequestHandler::cleanAndAppendToBuffer(const string& in, string& out) {
 
 /**
  * Iterate over the recordIDs in queryResults and get the record.
- * Add the record information to the request.out string.
+ * Add the record information to the response.
  */
-boost::shared_ptr<Json::Value> HTTPRequestHandler::printResults(evhttp_request *req,
+void HTTPRequestHandler::printResults(JsonResponseWriter &writer, const SearchRequest &request,
         const evkeyvalq &headers, const LogicalPlan &queryPlan,
         const CoreInfo_t *indexDataConfig,
         const QueryResults *queryResults, const Query *query,
         const Indexer *indexer, const unsigned start, const unsigned end,
         const unsigned retrievedResults, const string& aclRoleId, const string & message,
         const unsigned ts1, struct timespec &tstart, struct timespec &tend ,
-        const vector<RecordSnippet>& recordSnippets, unsigned hlTime, bool onlyFacets) {
+        const vector<RecordSnippet>& recordSnippets, unsigned hlTime, bool onlyFacets,
+        SeparatedResults *separatedResults) {
 
-    boost::shared_ptr<Json::Value> root (new Json::Value());
+    // The members are written in the order they are computed. results_found and
+    // payload_access_time are only known after the results are written.
+    writer.beginObject();
     // For logging
     string logQueries;
     unsigned resultFound = retrievedResults;
-    (*root)["searcher_time"] = ts1;
+    writer.key("searcher_time");
+    writer.value(ts1);
     clock_gettime(CLOCK_REALTIME, &tstart);
 
     vector<string> attributesToReturnFromQuery = queryPlan.getAttrToReturn();
-    vector<string> *attributesToReturnFromQueryPtr;
-
-    if (attributesToReturnFromQuery.size() != 0)
-      attributesToReturnFromQueryPtr = &attributesToReturnFromQuery;
-    else
-     attributesToReturnFromQueryPtr = NULL;
-
+    const vector<string> *attrToReturn = NULL;
+    bool returnStoredRecord = getAttributesToReturn(indexDataConfig, attributesToReturnFromQuery, attrToReturn);
 
     if(onlyFacets == false){ // We send the matching records only if "facet != only".
-        (*root)["results"].resize(end - start);
-        unsigned counter = 0;
-        if (query->getQueryTerms()->empty()) //check if the query type is range query without keywords
-        {
-            for (unsigned i = start; i < end; ++i) {
-            	unsigned internalRecordId = queryResults->getInternalRecordId(i);
-            	StoredRecordBuffer inMemoryData = indexer->getInMemoryData(internalRecordId);
-            	if (inMemoryData.start.get() == NULL) {
-            		--resultFound;
-            		continue;
-            	}
-                (*root)["results"][counter]["record_id"] = queryResults->getRecordId(
-                        i);
-                (*root)["results"][counter]["score"] = (0
-                        - queryResults->getResultScore(i).getFloatTypedValue()); //the actual distance between the point of record and the center point of the range
-                if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_STORED_ATTR){
-                    string sbuffer;
-                    //This case executes when all the attributes are to be returned. However we let the user
-                    //override if field list parameter is given in query
-                    genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                            sbuffer, attributesToReturnFromQueryPtr, aclRoleId);
-                    // The class CustomizableJsonWriter allows us to
-                    // attach the data string to the JSON tree without parsing it.
-                    (*root)["results"][counter][global_internal_record.first] = sbuffer;
-                } else if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_SELECTED_ATTR){
-                	string sbuffer;
-                	const vector<string> *attrToReturn = indexDataConfig->getAttributesToReturn();
-
-                	//Return the attributes specified in the config file
-                	//If query has field list parameter we override attrToReturn using the attributes from query
-                	//otherwise we use attributes mentioned in config file
-                	if(attributesToReturnFromQuery.size() > 0){
-                	    attrToReturn = attributesToReturnFromQueryPtr;
-                	}
-
-                	genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                	                            sbuffer, attrToReturn, aclRoleId);
-
-                	// The class CustomizableJsonWriter allows us to
-                	// attach the data string to the JSON tree without parsing it.
-                	(*root)["results"][counter][global_internal_record.first] = sbuffer;
-                }else{
-                    //Return the attributes specified explicitly in the query otherwise no attributes are returned
-                    string stringBuffer;
-                    if(attributesToReturnFromQuery.size() > 0){
-                        genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                                stringBuffer, attributesToReturnFromQueryPtr, aclRoleId);
-                        (*root)["results"][counter][global_internal_record.first] = stringBuffer;
-                    }
-
-                }
-                ++counter;
+        RecordJsonGenerator recordJsonGenerator(indexer, attrToReturn, aclRoleId);
+        string sbuffer;
+        sbuffer.reserve(1024);  //<< TODO: set this to max allowed snippet len
+        bool isRangeQueryWithoutKeywords = query->getQueryTerms()->empty();
+
+        ResultsWriter resultsWriter(writer, separatedResults);
+        resultsWriter.begin();
+        for (unsigned i = start; i < end; ++i) {
+            unsigned internalRecordId = queryResults->getInternalRecordId(i);
+            StoredRecordBuffer inMemoryData = indexer->getInMemoryData(internalRecordId);
+            if (inMemoryData.start.get() == NULL) {
+                --resultFound;
+                continue;
             }
-
-        } else // the query is including keywords:(1)only keywords (2)keywords+geo
-        {
-            for (unsigned i = start; i < end; ++i) {
-            	unsigned internalRecordId = queryResults->getInternalRecordId(i);
-            	StoredRecordBuffer inMemoryData = indexer->getInMemoryData(internalRecordId);
-            	if (inMemoryData.start.get() == NULL) {
-            		--resultFound;
-            		continue;
-            	}
-                (*root)["results"][counter]["record_id"] = queryResults->getRecordId(i);
-                (*root)["results"][counter]["score"] = queryResults->getResultScore(i)
-                        .getFloatTypedValue();
+            JsonResponseWriter &resultWriter = resultsWriter.beginResult();
+            resultWriter.key("record_id");
+            resultWriter.value(queryResults->getRecordId(i));
+            resultWriter.key("score");
+            double score;
+            if (isRangeQueryWithoutKeywords) {
+                //the actual distance between the point of record and the center point of the range
+                score = (double)(0 - queryResults->getResultScore(i).getFloatTypedValue());
+                resultWriter.value(score);
+            } else {
+                score = (double)queryResults->getResultScore(i).getFloatTypedValue();
+                resultWriter.value(score);
 
                 // print edit distance vector
                 vector<unsigned> editDistances;
                 queryResults->getEditDistances(i, editDistances);
-
-                (*root)["results"][counter]["edit_dist"].resize(editDistances.size());
+                resultWriter.key("edit_dist");
+                resultWriter.beginArray();
                 for (unsigned int j = 0; j < editDistances.size(); ++j) {
-                    (*root)["results"][counter]["edit_dist"][j] = editDistances[j];
+                    resultWriter.value(editDistances[j]);
                 }
+                resultWriter.endArray();
 
                 // print matching keywords vector
                 vector<std::string> matchingKeywords;
                 queryResults->getMatchingKeywords(i, matchingKeywords);
-
-                (*root)["results"][counter]["matching_prefix"].resize(
-                        matchingKeywords.size());
+                resultWriter.key("matching_prefix");
+                resultWriter.beginArray();
                 for (unsigned int j = 0; j < matchingKeywords.size(); ++j) {
-                    (*root)["results"][counter]["matching_prefix"][j] =
-                            matchingKeywords[j];
-                }
-                if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_STORED_ATTR) {
-                    unsigned internalRecordId = queryResults->getInternalRecordId(i);
-                    string sbuffer;
-
-                    //This case executes when all the attributes are to be returned. However we let the user
-                    //override if field list parameter is given in query
-                    genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                                                sbuffer, attributesToReturnFromQueryPtr, aclRoleId);
-
-                    // The class CustomizableJsonWriter allows us to
-                    // attach the data string to the JSON tree without parsing it.
-                    (*root)["results"][counter][global_internal_record.first] = sbuffer;
-                } else if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_SELECTED_ATTR){
-                	unsigned internalRecordId = queryResults->getInternalRecordId(i);
-                    string sbuffer;
-                    const vector<string> *attrToReturn = indexDataConfig->getAttributesToReturn();
-
-                    //Return the attributes specified in the config file
-                    //If query has field list parameter we override attrToReturn using the attributes from query
-                    //otherwise we use attributes mentioned in config file
-                    if(attributesToReturnFromQuery.size() > 0){
-                        attrToReturn = attributesToReturnFromQueryPtr;
-                    }
-
-                    genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                                                sbuffer, attrToReturn, aclRoleId);
-
-                	// The class CustomizableJsonWriter allows us to
-                	// attach the data string to the JSON tree without parsing it.
-                	(*root)["results"][counter][global_internal_record.first] = sbuffer;
-                }else{
-                    //Return the attributes specified explicitly in the query otherwise no attributes are returned
-                    string stringBuffer;
-                    if(attributesToReturnFromQuery.size() > 0){
-                        genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                                stringBuffer, attributesToReturnFromQueryPtr, aclRoleId);
-                        (*root)["results"][counter][global_internal_record.first] = stringBuffer;
-                    }
+                    resultWriter.value(matchingKeywords[j]);
                 }
-                string sbuffer = string();
-                sbuffer.reserve(1024);  //<< TODO: set this to max allowed snippet len
-                genSnippetJSONString(i, start, recordSnippets, sbuffer, queryResults);
-                (*root)["results"][counter][global_internal_snippet.first] = sbuffer;
-                ++counter;
+                resultWriter.endArray();
             }
-
-            (*root)["query_keywords"].resize(query->getQueryTerms()->size());
-            for (unsigned i = 0; i < query->getQueryTerms()->size(); i++) {
-                string &term = *(query->getQueryTerms()->at(i)->getKeyword());
-                (*root)["query_keywords"][i] = term;
-                if (i)
-                    logQueries += "";
-                logQueries += term;
+            if (returnStoredRecord) {
+                // the stored record is attached to the response without parsing it
+                resultWriter.key(global_internal_record.second);
+                recordJsonGenerator.write(resultWriter, inMemoryData, queryResults->getRecordId(i));
             }
-            (*root)["query_keywords_complete"].resize(query->getQueryTerms()->size());
-            for (unsigned i = 0; i < query->getQueryTerms()->size(); i++) {
-                bool isCompleteTermType = (query->getQueryTerms()->at(i)->getTermType() == srch2is::TERM_TYPE_COMPLETE );
-                (*root)["query_keywords_complete"][i] = isCompleteTermType;
+            if (!isRangeQueryWithoutKeywords) {
+                sbuffer.clear();
+                genSnippetJSONString(i, start, recordSnippets, sbuffer, queryResults);
+                resultWriter.key(global_internal_snippet.second);
+                resultWriter.rawValue(sbuffer);
             }
-
-
-            (*root)["fuzzy"] = (int) queryPlan.isFuzzy();
+            resultsWriter.endResult(score);
         }
-    }else{ // facet only case: we only want query information
-    	if ( query->getQueryTerms()->empty() == false) //check if the query type is range query without keywords
-    	{
-            (*root)["query_keywords"].resize(query->getQueryTerms()->size());
-            for (unsigned i = 0; i < query->getQueryTerms()->size(); i++) {
-                string &term = *(query->getQueryTerms()->at(i)->getKeyword());
-                (*root)["query_keywords"][i] = term;
-                if (i)
-                    logQueries += "";
-                logQueries += term;
-            }
-            (*root)["query_keywords_complete"].resize(query->getQueryTerms()->size());
-            for (unsigned i = 0; i < query->getQueryTerms()->size(); i++) {
-                bool isCompleteTermType = (query->getQueryTerms()->at(i)->getTermType() == srch2is::TERM_TYPE_COMPLETE );
-                (*root)["query_keywords_complete"][i] = isCompleteTermType;
-            }
-            (*root)["fuzzy"] = (int) queryPlan.isFuzzy();
-    	}
+        resultsWriter.end();
     }
 
+    // query information, the only information in the facet only case
+    if (query->getQueryTerms()->empty() == false) // check if the query type is range query without keywords
+    {
+        writer.key("query_keywords");
+        writer.beginArray();
+        for (unsigned i = 0; i < query->getQueryTerms()->size(); i++) {
+            string &term = *(query->getQueryTerms()->at(i)->getKeyword());
+            writer.value(term);
+            if (i)
+                logQueries += "";
+            logQueries += term;
+        }
+        writer.endArray();
+        writer.key("query_keywords_complete");
+        writer.beginArray();
+        for (unsigned i = 0; i < query->getQueryTerms()->size(); i++) {
+            bool isCompleteTermType = (query->getQueryTerms()->at(i)->getTermType() == srch2is::TERM_TYPE_COMPLETE );
+            writer.value(isCompleteTermType);
+        }
+        writer.endArray();
+        writer.key("fuzzy");
+        writer.value((int) queryPlan.isFuzzy());
+    }
 
     clock_gettime(CLOCK_REALTIME, &tend);
     unsigned ts2 = (tend.tv_sec - tstart.tv_sec) * 1000
             + (tend.tv_nsec - tstart.tv_nsec) / 1000000;
-    (*root)["payload_access_time"] = ts2;
+    writer.key("payload_access_time");
+    writer.value(ts2);
 
     // return some meta data
 
-    (*root)["type"] = queryPlan.getQueryType();
-    (*root)["offset"] = start;
-    (*root)["limit"] = end - start;
+    writer.key("type");
+    writer.value((int) queryPlan.getQueryType());
+    writer.key("offset");
+    writer.value(start);
+    writer.key("limit");
+    writer.value(end - start);
 
-    (*root)["results_found"] = resultFound;
+    writer.key("results_found");
+    writer.value(resultFound);
 
     long int estimatedNumberOfResults = queryResults->getEstimatedNumberOfResults();
     // Since estimation of number of results can return a wrong number, if this value is less
@@ -418,10 +375,12 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::printResults(evhttp_request *
     if(estimatedNumberOfResults != -1){
         // at this point we know for sure that estimatedNumberOfResults is positive, so we can cast
         // it to unsigned (because the thirdparty library we use here does not accept long integers.)
-        (*root)["estimated_number_of_results"] = (unsigned)estimatedNumberOfResults;
+        writer.key("estimated_number_of_results");
+        writer.value((unsigned)estimatedNumberOfResults);
     }
     if(queryResults->isResultsApproximated() == true){
-        (*root)["result_set_approximation"] = true;
+        writer.key("result_set_approximation");
+        writer.value(true);
     }
 
     const std::map<std::string, std::pair< FacetType , std::vector<std::pair<std::string, float> > > > * facetResults =
@@ -442,56 +401,49 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::printResults(evhttp_request *
     //                         }
     //]
     if (!facetResults->empty()) { // we have facet results to print
-        (*root)["facets"].resize(facetResults->size());
-
-        unsigned attributeCounter = 0;
+        writer.key("facets");
+        writer.beginArray();
         for (std::map<std::string, std::pair< FacetType , std::vector<std::pair<std::string, float> > > >::const_iterator attr =
                 facetResults->begin(); attr != facetResults->end(); ++attr) {
-            (*root)["facets"][attributeCounter]["facet_field_name"] = attr->first;
-            (*root)["facets"][attributeCounter]["facet_info"].resize(
-                    attr->second.second.size());
+            writer.beginObject();
+            writer.key("facet_field_name");
+            writer.value(attr->first);
+            writer.key("facet_info");
+            writer.beginArray();
             for (std::vector<std::pair<std::string, float> >::const_iterator category =
                     attr->second.second.begin(); category != attr->second.second.end();
                     ++category) {
-
-                /*
-                 * Offset is the relative position based on
-                 * the start position of the iterator. e.g.
-                 *
-                 * {<a,1>,<b,2>,<c,3>}
-                 *
-                 * The offset of <a,1> will be 0, <b,2> will be 1, and
-                 * <c,3> will be 2
-                 */
-                int offset = (category - attr->second.second.begin());
-
+                writer.beginObject();
+                writer.key("category_name");
                 if(category == attr->second.second.begin() && attr->second.first == srch2is::FacetTypeRange){
-                    (*root)["facets"][attributeCounter]["facet_info"][offset]["category_name"] = "lessThanStart";
+                    writer.value("lessThanStart");
                 }else{
-                    (*root)["facets"][attributeCounter]["facet_info"][offset]["category_name"] =
-                            category->first;
+                    writer.value(category->first);
                 }
-                (*root)["facets"][attributeCounter]["facet_info"][offset]["category_value"] =
-                        category->second;
+                writer.key("category_value");
+                writer.value((double)category->second);
+                writer.endObject();
             }
-
-            attributeCounter++;
+            writer.endArray();
+            writer.endObject();
         }
+        writer.endArray();
     }
 
-    (*root)["message"] = message;
+    writer.key("message");
+    writer.value(message);
+    writer.endObject();
     Logger::info(
             "ip: %s, port: %d GET query: %s, searcher_time: %d ms, highlighter_time: %d ms, payload_access_time: %d ms",
-            req->remote_host, req->remote_port, req->uri + 1, ts1, hlTime, ts2);
-    return root;
+            request.remoteHost.c_str(), request.remotePort, request.uri.c_str() + 1, ts1, hlTime, ts2);
 }
 
 
 /**
  * Iterate over the recordIDs in queryResults and get the record.
- * Add the record information to the request.out string.
+ * Add the record information to the response.
  */
-boost::shared_ptr<Json::Value> HTTPRequestHandler::printOneResultRetrievedById(evhttp_request *req, const evkeyvalq &headers,
+void HTTPRequestHandler::printOneResultRetrievedById(JsonResponseWriter &writer, const SearchRequest &request, const evkeyvalq &headers,
         const LogicalPlan &queryPlan,
         const CoreInfo_t *indexDataConfig,
         const QueryResults *queryResults,
@@ -499,27 +451,24 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::printOneResultRetrievedById(e
         const string & aclRoleId,
         const string & message,
         const unsigned ts1,
-        struct timespec &tstart, struct timespec &tend){
+        struct timespec &tstart, struct timespec &tend,
+        SeparatedResults *separatedResults){
 
-    boost::shared_ptr<Json::Value> root(new Json::Value());
-    // For logging
-    string logQueries;
+    writer.beginObject();
 
     vector<string> attributesToReturnFromQuery = queryPlan.getAttrToReturn();
-    vector<string> *attributesToReturnFromQueryPtr;
-
-    if (attributesToReturnFromQuery.size() != 0)
-      attributesToReturnFromQueryPtr = &attributesToReturnFromQuery;
-    else
-      attributesToReturnFromQueryPtr = NULL;
+    const vector<string> *attrToReturn = NULL;
+    bool returnStoredRecord = getAttributesToReturn(indexDataConfig, attributesToReturnFromQuery, attrToReturn);
 
-    (*root)["searcher_time"] = ts1;
-    (*root)["results"].resize(queryResults->getNumberOfResults());
+    writer.key("searcher_time");
+    writer.value(ts1);
 
     clock_gettime(CLOCK_REALTIME, &tstart);
-    unsigned counter = 0;
+    RecordJsonGenerator recordJsonGenerator(indexer, attrToReturn, aclRoleId);
 
     unsigned resultFound = queryResults->getNumberOfResults();
+    ResultsWriter resultsWriter(writer, separatedResults);
+    resultsWriter.begin();
     for (unsigned i = 0; i < queryResults->getNumberOfResults(); ++i) {
     	unsigned internalRecordId = queryResults->getInternalRecordId(i);
     	StoredRecordBuffer inMemoryData = indexer->getInMemoryData(internalRecordId);
@@ -527,74 +476,70 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::printOneResultRetrievedById(e
     		--resultFound;
     		continue;
     	}
-        (*root)["results"][counter]["record_id"] = queryResults->getRecordId(i);
-
-        if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_STORED_ATTR) {
-            unsigned internalRecordId = queryResults->getInternalRecordId(i);
-            string sbuffer;
-
-            //This case executes when all the attributes are to be returned. However we let the user
-            //override if field list parameter is given in query
-            genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                    sbuffer, attributesToReturnFromQueryPtr, aclRoleId);
-
-            (*root)["results"][counter][global_internal_record.first] = sbuffer;
-        } else if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_SELECTED_ATTR){
-            unsigned internalRecordId = queryResults->getInternalRecordId(i);
-            string sbuffer;
-            const vector<string> *attrToReturn = indexDataConfig->getAttributesToReturn();
-
-            //Return the attributes specified in the config file
-            //If query has field list parameter we override attrToReturn using the attributes from query
-            //otherwise we use attributes mentioned in config file
-            if(attributesToReturnFromQuery.size() > 0){
-                attrToReturn = attributesToReturnFromQueryPtr;
-            }
-            genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                                        sbuffer, attrToReturn, aclRoleId);
-
-            // The class CustomizableJsonWriter allows us to
-            // attach the data string to the JSON tree without parsing it.
-            (*root)["results"][counter][global_internal_record.first] = sbuffer;
-        }else{
-            //Return the attributes specified explicitly in the query otherwise no attributes are returned
-            string stringBuffer;
-            if(attributesToReturnFromQuery.size() > 0){
-                genRecordJsonString(indexer, inMemoryData, queryResults->getRecordId(i),
-                        stringBuffer, attributesToReturnFromQueryPtr, aclRoleId);
-                (*root)["results"][counter][global_internal_record.first] = stringBuffer;
-            }
+        JsonResponseWriter &resultWriter = resultsWriter.beginResult();
+        resultWriter.key("record_id");
+        resultWriter.value(queryResults->getRecordId(i));
+        if (returnStoredRecord) {
+            // the stored record is attached to the response without parsing it
+            resultWriter.key(global_internal_record.second);
+            recordJsonGenerator.write(resultWriter, inMemoryData, queryResults->getRecordId(i));
         }
-        ++counter;
+        // a record retrieved by id has no score
+        resultsWriter.endResult(0);
     }
+    resultsWriter.end();
 
     clock_gettime(CLOCK_REALTIME, &tend);
     unsigned ts2 = (tend.tv_sec - tstart.tv_sec) * 1000
             + (tend.tv_nsec - tstart.tv_nsec) / 1000000;
-    (*root)["payload_access_time"] = ts2;
+    writer.key("payload_access_time");
+    writer.value(ts2);
 
     // return some meta data
 
-    (*root)["type"] = queryPlan.getQueryType();
-    (*root)["results_found"] = resultFound;
+    writer.key("type");
+    writer.value((int) queryPlan.getQueryType());
+    writer.key("results_found");
+    writer.value(resultFound);
 
-    (*root)["message"] = message;
+    writer.key("message");
+    writer.value(message);
+    writer.endObject();
     Logger::info(
             "ip: %s, port: %d GET query: %s, searcher_time: %d ms, payload_access_time: %d ms",
-            req->remote_host, req->remote_port, req->uri + 1, ts1, ts2);
-    return root;
+            request.remoteHost.c_str(), request.remotePort, request.uri.c_str() + 1, ts1, ts2);
 }
 
-void HTTPRequestHandler::genRecordJsonString(const srch2is::Indexer *indexer, StoredRecordBuffer buffer,
-		const string& extrnalRecordId, string& sbuffer, const string& aclRoleId){
-	genRecordJsonString(indexer, buffer, extrnalRecordId,
-	                    		 sbuffer, NULL, aclRoleId);
+/*
+ * Finds the attributes of the stored records to return. Returns false if no record should be
+ * returned. attrToReturn is set to NULL if all the attributes the role can access are returned.
+ */
+bool HTTPRequestHandler::getAttributesToReturn(const CoreInfo_t *indexDataConfig,
+		const vector<string> &attributesToReturnFromQuery, const vector<string> *&attrToReturn) {
+	const vector<string> *attributesToReturnFromQueryPtr =
+			attributesToReturnFromQuery.size() != 0 ? &attributesToReturnFromQuery : NULL;
+	if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_STORED_ATTR) {
+		//This case executes when all the attributes are to be returned. However we let the user
+		//override if field list parameter is given in query
+		attrToReturn = attributesToReturnFromQueryPtr;
+		return true;
+	} else if (indexDataConfig->getSearchResponseFormat() == RESPONSE_WITH_SELECTED_ATTR) {
+		//Return the attributes specified in the config file
+		//If query has field list parameter we override attrToReturn using the attributes from query
+		//otherwise we use attributes mentioned in config file
+		attrToReturn = indexDataConfig->getAttributesToReturn();
+		if (attributesToReturnFromQueryPtr != NULL) {
+			attrToReturn = attributesToReturnFromQueryPtr;
+		}
+		return true;
+	}
+	//Return the attributes specified explicitly in the query otherwise no attributes are returned
+	attrToReturn = attributesToReturnFromQueryPtr;
+	return attributesToReturnFromQueryPtr != NULL;
 }
-void HTTPRequestHandler::genRecordJsonString(const srch2is::Indexer *indexer, StoredRecordBuffer buffer,
-		const string& externalRecordId, string& sbuffer, const vector<string>* attrToReturn,
-		const string& aclRoleId){
 
-	vector<string>  accessibleAttrsList;
+HTTPRequestHandler::RecordJsonGenerator::RecordJsonGenerator(const srch2is::Indexer *indexer,
+		const vector<string>* attrToReturn, const string& aclRoleId) {
 	// perform access control check on fields to be returned to a user.
 	if (attrToReturn == NULL) {
 		// attributes to return are not specified. Hence, Go over the fields in the schema and check
@@ -627,13 +572,22 @@ void HTTPRequestHandler::genRecordJsonString(const srch2is::Indexer *indexer, St
 			}
 		}
 	}
-	Schema * storedSchema = Schema::create();
+	storedSchema = Schema::create();
 	RecordSerializerUtil::populateStoredSchema(storedSchema, indexer->getSchema());
-	RecordSerializerUtil::convertCompactToJSONString(storedSchema, buffer, externalRecordId, sbuffer,
-			&accessibleAttrsList);
+}
+
+HTTPRequestHandler::RecordJsonGenerator::~RecordJsonGenerator() {
 	delete storedSchema;
 }
 
+void HTTPRequestHandler::RecordJsonGenerator::write(JsonResponseWriter &writer, StoredRecordBuffer buffer,
+		const string& externalRecordId) {
+	jsonBuffer.clear();
+	RecordSerializerUtil::convertCompactToJSONString(storedSchema, buffer, externalRecordId, jsonBuffer,
+			&accessibleAttrsList);
+	writer.rawValue(jsonBuffer);
+}
+
 void HTTPRequestHandler::genSnippetJSONString(unsigned recIdx, unsigned start,
 		const vector<RecordSnippet>& recordSnippets, string& sbuffer,const QueryResults *queryResults) {
 	unsigned _idx = recIdx - start;
@@ -710,6 +664,7 @@ void HTTPRequestHandler::writeCommand(evhttp_request *req,
 
     Json::Value response(Json::objectValue);
     bool isSuccess = true;
+    WriteAheadLogScope writeAheadLogScope(server->writeAheadLog);
     switch (req->type) {
     case EVHTTP_REQ_PUT: {
         size_t length = EVBUFFER_LENGTH(req->input_buffer);
@@ -743,6 +698,13 @@ void HTTPRequestHandler::writeCommand(evhttp_request *req,
             Json::Value insert_responses(Json::arrayValue);
             // append to each response
             if(root.type() == Json::arrayValue) { // The input is an array of JSON objects.
+                for ( int index = 0; index < root.size(); ++index ) {
+                    writeAheadLogScope.append(IndexWriteUtil::_insertLogEntry(root[index]));
+                }
+                if (!write_ahead_log_commit(req, writeAheadLogScope)) {
+                    delete record;
+                    return;
+                }
                 // Iterates over the sequence elements.
                 insert_responses.resize(root.size());
                 for ( int index = 0; index < root.size(); ++index ) {
@@ -789,10 +751,16 @@ void HTTPRequestHandler::writeCommand(evhttp_request *req,
                 		response[JSON_LOG] = log_str.str();
                 		bmhelper_evhttp_send_reply(req, HTTP_BADREQUEST, "INVALID REQUEST",
                 				global_customized_writer.write(response));
+                		delete record;
                 		return;
                 	}
                 }
 
+                writeAheadLogScope.append(IndexWriteUtil::_insertLogEntry(doc));
+                if (!write_ahead_log_commit(req, writeAheadLogScope)) {
+                    delete record;
+                    return;
+                }
                 Json::Value each_response = IndexWriteUtil::_insertCommand(server->indexer,
                         server->indexDataConfig, doc, record);
 
@@ -816,6 +784,11 @@ void HTTPRequestHandler::writeCommand(evhttp_request *req,
         evkeyvalq headers;
         evhttp_parse_query(req->uri, &headers);
 
+        writeAheadLogScope.append(IndexWriteUtil::_deleteLogEntry(req->uri));
+        if (!write_ahead_log_commit(req, writeAheadLogScope)) {
+            evhttp_clear_headers(&headers);
+            return;
+        }
         Json::Value deleteResponse = IndexWriteUtil::_deleteCommand_QueryURI(server->indexer,
                 server->indexDataConfig, headers);
         response[JSON_MESSAGE] = "The delete was processed successfully";
@@ -848,6 +821,7 @@ void HTTPRequestHandler::aclModifyRolesForRecord(evhttp_request *req, Srch2Serve
 	bool isSuccess = true;
 	Json::Value edit_responses(Json::arrayValue);
 
+	WriteAheadLogScope writeAheadLogScope(server->writeAheadLog);
 	if(server->indexDataConfig->getHasRecordAcl()){ // this core has record Acl
 
 		size_t length = EVBUFFER_LENGTH(req->input_buffer);
@@ -872,21 +846,33 @@ void HTTPRequestHandler::aclModifyRolesForRecord(evhttp_request *req, Srch2Serve
 			Logger::warn("JSON object parse error");
 		}else{
 			if(root.type() == Json::arrayValue) { // The input is an array of JSON objects.
-				vector<string> roleIds;
+				// the ids of all the objects are extracted and logged before any change is applied
+				vector<string> primaryKeyIDs(root.size());
+				vector<vector<string> > roleIdsOfRecords(root.size());
+				vector<string> logs(root.size());
 				for ( int index = 0; index < root.size(); ++index ) {
 					Json::Value defaultValueToReturn = Json::Value("");
 					const Json::Value doc = root.get(index,
 							defaultValueToReturn);
-					string primaryKeyID;
 					std::stringstream log_str;
 					// extract all the role ids from the query
-					if( JSONRecordParser::_extractResourceAndRoleIds(roleIds, primaryKeyID, doc, server->indexDataConfig, log_str) ){
-						if(roleIds.size() != 0){
-							log_str << global_customized_writer.write(IndexWriteUtil::_aclRecordModifyRoles(server->indexer, primaryKeyID, roleIds, commandType));
+					if( JSONRecordParser::_extractResourceAndRoleIds(roleIdsOfRecords[index], primaryKeyIDs[index], doc, server->indexDataConfig, log_str) ){
+						if(roleIdsOfRecords[index].size() != 0){
+							writeAheadLogScope.append(IndexWriteUtil::_aclRecordModifyRolesLogEntry(primaryKeyIDs[index], roleIdsOfRecords[index], commandType));
 						}
+					}else{
+						roleIdsOfRecords[index].clear();
+					}
+					logs[index] = log_str.str();
+				}
+				if (!write_ahead_log_commit(req, writeAheadLogScope))
+					return;
+				for ( int index = 0; index < root.size(); ++index ) {
+					std::stringstream log_str;
+					log_str << logs[index];
+					if(roleIdsOfRecords[index].size() != 0){
+						log_str << global_customized_writer.write(IndexWriteUtil::_aclRecordModifyRoles(server->indexer, primaryKeyIDs[index], roleIdsOfRecords[index], commandType));
 					}
-
-					roleIds.clear();
 					edit_responses[index] = log_str.str();
 				}
 			}else{ // The input is only one JSON object.
@@ -897,6 +883,9 @@ void HTTPRequestHandler::aclModifyRolesForRecord(evhttp_request *req, Srch2Serve
 				// extract all the role ids from the query
 				if( JSONRecordParser::_extractResourceAndRoleIds(roleIds, primaryKeyID, doc, server->indexDataConfig, log_str) ){
 					if(roleIds.size() != 0){
+						writeAheadLogScope.append(IndexWriteUtil::_aclRecordModifyRolesLogEntry(primaryKeyID, roleIds, commandType));
+						if (!write_ahead_log_commit(req, writeAheadLogScope))
+							return;
 						log_str << global_customized_writer.write(IndexWriteUtil::_aclRecordModifyRoles(server->indexer, primaryKeyID, roleIds, commandType));
 					}
 				}
@@ -931,6 +920,7 @@ void HTTPRequestHandler::aclModifyRecordsForRole(evhttp_request *req, Srch2Serve
 	bool isSuccess = true;
 	Json::Value responseOfAction(Json::arrayValue);
 
+	WriteAheadLogScope writeAheadLogScope(server->writeAheadLog);
 	if(server->indexDataConfig->getHasRecordAcl()){ // this resource core has a role core
 
 		size_t length = EVBUFFER_LENGTH(req->input_buffer);
@@ -958,6 +948,10 @@ void HTTPRequestHandler::aclModifyRecordsForRole(evhttp_request *req, Srch2Serve
 				vector<string> resourceIds;
 				vector<string> removedIds;
 				string removedRoleIds = "";
+				// the ids of all the objects are checked and logged before any change is applied
+				vector<string> roleIDs(root.size());
+				vector<vector<string> > resourceIdsOfRoles(root.size());
+				vector<string> logs(root.size());
 				for ( int index = 0; index < root.size(); ++index ) {
 					Json::Value defaultValueToReturn = Json::Value("");
 					const Json::Value doc = root.get(index,
@@ -989,13 +983,25 @@ void HTTPRequestHandler::aclModifyRecordsForRole(evhttp_request *req, Srch2Serve
 						}
 
 						if(resourceIds.size() != 0){
-							log_str << global_customized_writer.write(IndexWriteUtil::_aclModifyRecordsOfRole(server->indexer, roleID, resourceIds, commandType));
+							writeAheadLogScope.append(IndexWriteUtil::_aclModifyRecordsOfRoleLogEntry(roleID, resourceIds, commandType));
+							roleIDs[index] = roleID;
+							resourceIdsOfRoles[index] = resourceIds;
 						}
 					}
 
 					resourceIds.clear();
 					removedIds.clear();
 					removedRoleIds = "";
+					logs[index] = log_str.str();
+				}
+				if (!write_ahead_log_commit(req, writeAheadLogScope))
+					return;
+				for ( int index = 0; index < root.size(); ++index ) {
+					std::stringstream log_str;
+					log_str << logs[index];
+					if(resourceIdsOfRoles[index].size() != 0){
+						log_str << global_customized_writer.write(IndexWriteUtil::_aclModifyRecordsOfRole(server->indexer, roleIDs[index], resourceIdsOfRoles[index], commandType));
+					}
 					responseOfAction[index] = log_str.str();
 				}
 			}else{ // The input is only one JSON object.
@@ -1028,6 +1034,9 @@ void HTTPRequestHandler::aclModifyRecordsForRole(evhttp_request *req, Srch2Serve
 					}
 
 					if(resourceIds.size() != 0){
+						writeAheadLogScope.append(IndexWriteUtil::_aclModifyRecordsOfRoleLogEntry(roleID, resourceIds, commandType));
+						if (!write_ahead_log_commit(req, writeAheadLogScope))
+							return;
 						log_str << global_customized_writer.write(IndexWriteUtil::_aclModifyRecordsOfRole(server->indexer, roleID, resourceIds, commandType));
 					}
 				}
@@ -1096,6 +1105,7 @@ void HTTPRequestHandler::updateCommand(evhttp_request *req,
 
     Json::Value response(Json::objectValue);
     bool isSuccess = true;
+    WriteAheadLogScope writeAheadLogScope(server->writeAheadLog);
     switch (req->type) {
     case EVHTTP_REQ_PUT: {
         size_t length = EVBUFFER_LENGTH(req->input_buffer);
@@ -1129,6 +1139,14 @@ void HTTPRequestHandler::updateCommand(evhttp_request *req,
             Json::Value update_responses(Json::arrayValue);
             if (root.type() == Json::arrayValue) {
                 //the record parameter is an array of json objects
+                for(Json::UInt index = 0; index < root.size(); index++) {
+                    writeAheadLogScope.append(IndexWriteUtil::_updateLogEntry(req->uri, root[index]));
+                }
+                if (!write_ahead_log_commit(req, writeAheadLogScope)) {
+                    delete record;
+                    evhttp_clear_headers(&headers);
+                    return;
+                }
                 update_responses.resize(root.size());
                 for(Json::UInt index = 0; index < root.size(); index++) {
                     Json::Value defaultValueToReturn = Json::Value("");
@@ -1144,6 +1162,12 @@ void HTTPRequestHandler::updateCommand(evhttp_request *req,
             } else {
                 // the record parameter is a single json object
                 const Json::Value doc = root;
+                writeAheadLogScope.append(IndexWriteUtil::_updateLogEntry(req->uri, doc));
+                if (!write_ahead_log_commit(req, writeAheadLogScope)) {
+                    delete record;
+                    evhttp_clear_headers(&headers);
+                    return;
+                }
                 update_responses.append(IndexWriteUtil::_updateCommand(server->indexer,
                         server->indexDataConfig, headers, doc, record));
                 record->clear();
@@ -1175,7 +1199,7 @@ void HTTPRequestHandler::saveCommand(evhttp_request *req, Srch2Server *server) {
     Json::Value response(Json::objectValue);
     switch (req->type) {
     case EVHTTP_REQ_PUT: {
-        response[JSON_LOG] = wrap_with_json_array( IndexWriteUtil::_saveCommand(server->indexer));
+        response[JSON_LOG] = wrap_with_json_array(server->saveIndexes());
         response[JSON_MESSAGE] = "The indexes have been saved to disk successfully";
 
         //Call the save function implemented by each database connector.
@@ -1303,6 +1327,10 @@ void HTTPRequestHandler::infoCommand(evhttp_request *req, Srch2Server *server,
         response[c_key] = server->indexer->getIndexHealth();
     }
     response["version"] = versioninfo;
+    response["query_plan_cache"] = server->queryPlanCache.getJson();
+    if (server->indexDataConfig->getDataSourceType() == DATA_SOURCE_DATABASE) {
+        response["connector"] = server->connectorFreshness.getJson();
+    }
 
     bmhelper_evhttp_send_reply(req, HTTP_OK, "OK", global_customized_writer.write(response) , headers);
     evhttp_clear_headers(&headers);
@@ -1615,6 +1643,7 @@ void HTTPRequestHandler::attributeAclModify(evhttp_request *req, Srch2Server *se
 	        bool parseSuccess = reader.parse(post_data, post_data + length, root, false);
 	        bool error = false;
         	Json::Value aclAttributeResponses(Json::arrayValue);
+	        WriteAheadLogScope writeAheadLogScope(server->writeAheadLog);
 	        if (parseSuccess == false) {
 	            log_str << "API : "<< apiName << ", Error: JSON object parse error";
 	            response[JSON_LOG] = log_str.str();
@@ -1625,6 +1654,10 @@ void HTTPRequestHandler::attributeAclModify(evhttp_request *req, Srch2Server *se
 	            return;
 	        } else {
 	        	const AttributeAccessControl& attrAcl = server->indexer->getAttributeAcl();
+	        	// an array is logged as one entry, which is replayed up to its first failing object as well
+	        	writeAheadLogScope.append(IndexWriteUtil::_attributeAclLogEntry(root, action, apiName));
+	        	if (!write_ahead_log_commit(req, writeAheadLogScope))
+	        		return;
 	        	if (root.type() == Json::arrayValue) {
 	        		aclAttributeResponses.resize(root.size());
 	        		//the record parameter is an array of json objects
@@ -1688,40 +1721,118 @@ void HTTPRequestHandler::attributeAclModify(evhttp_request *req, Srch2Server *se
 
 void HTTPRequestHandler::searchCommand(evhttp_request *req,
         Srch2Server *server) {
+    evbuffer *returnbuffer = create_buffer(req);
+    if (returnbuffer == NULL)
+        return;
     evkeyvalq headers;
 
     std::stringstream errorStream;
-    boost::shared_ptr<Json::Value> root = doSearchOneCore( req, server, &headers, errorStream );
-
-    if (root ){
-        bmhelper_evhttp_send_reply(req, HTTP_OK, "OK", global_customized_writer.write(*root), headers);
+    JsonResponseWriter writer(returnbuffer);
+    if (doSearchOneCore( SearchRequest(req), server, &headers, errorStream, writer )){
+        bmhelper_evhttp_send_streamed_reply(req, HTTP_OK, "OK", returnbuffer, headers);
     } else{
-        Json::Value errorResponse(Json::objectValue);
-        errorResponse["error"] = errorStream.str();
-        bmhelper_evhttp_send_reply(req, HTTP_BADREQUEST, "Bad Request", global_customized_writer.write(errorResponse), headers);
+        writer.beginObject();
+        writer.key("error");
+        writer.value(errorStream.str());
+        writer.endObject();
+        bmhelper_evhttp_send_streamed_reply(req, HTTP_BADREQUEST, "Bad Request", returnbuffer, headers);
     }
+    evbuffer_free(returnbuffer);
     evhttp_clear_headers(&headers);
 }
 
-boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_request *req,
-        Srch2Server *server, evkeyvalq* headers, std::stringstream &errorStream) {
-
-    boost::shared_ptr<Json::Value> root;
-    ParsedParameterContainer paramContainer;
+namespace {
+    bool isParameterNameLess(const pair<string, string> &left, const pair<string, string> &right) {
+        return left.first < right.first;
+    }
 
-    if(server->indexDataConfig->getHasRecordAcl()){
-    	paramContainer.hasRoleCore = true;
+    /*
+     * The key of the plan of a search in the query plan cache: its parameters sorted by name, so that
+     * the same search with its parameters in another order has the same key. The values of a repeated
+     * parameter keep their order. Empty if the plan cannot be reused because a parameter refers to
+     * the current time, which the parser replaces with its value.
+     */
+    string getQueryPlanCacheKey(const evkeyvalq &headers) {
+        vector<pair<string, string> > parameters;
+        for (const evkeyval *header = headers.tqh_first; header != NULL; header = header->next.tqe_next) {
+            // the parser takes NOW in any case, see DateAndTimeHandler::verifyDateTimeString()
+            if (boost::algorithm::icontains(header->value, "NOW")) {
+                return "";
+            }
+            parameters.push_back(make_pair(string(header->key), string(header->value)));
+        }
+        std::stable_sort(parameters.begin(), parameters.end(), isParameterNameLess);
+        std::stringstream key;
+        for (unsigned i = 0; i < parameters.size(); ++i) {
+            key << parameters[i].first.size() << ":" << parameters[i].first << "="
+                    << parameters[i].second.size() << ":" << parameters[i].second << "&";
+        }
+        return key.str();
     }
 
-    evhttp_parse_query(req->uri, headers);
-    // simple example for query is : q={boost=2}name:foo~0.5 AND bar^3*&fq=name:"John"
-    //1. first create query parser to parse the url
-    QueryParser qp(*headers, &paramContainer);
-    bool isSyntaxValid = qp.parse();
-    if (!isSyntaxValid) {
-        // if the query is not valid print the error message to the response
-        errorStream << paramContainer.getMessageString();
-        return root;
+    /*
+     * The parsed query of a search, taken from the query plan cache of the core or new. If the search
+     * is executed, the plan is reset and given back to the cache when the search returns, otherwise,
+     * e.g., if the query is not valid or an exception is thrown, it is deleted.
+     */
+    struct SearchPlanHolder {
+        Srch2Server *server;
+        const string key;
+        const unsigned aclVersion;
+        ParsedQuery *parsedQuery;
+        bool isReused;
+        bool isExecuted;
+
+        SearchPlanHolder(Srch2Server *server, const string &key)
+            : server(server), key(key), aclVersion(server->indexer->getAttributeAcl().getVersion()),
+              parsedQuery(NULL), isExecuted(false) {
+            if (!key.empty()) {
+                parsedQuery = server->queryPlanCache.checkOut(key, aclVersion);
+            }
+            isReused = parsedQuery != NULL;
+            if (!isReused) {
+                parsedQuery = new ParsedQuery();
+            }
+        }
+        ~SearchPlanHolder() {
+            if (isExecuted && !key.empty()) {
+                parsedQuery->logicalPlan->resetExecutionState(parsedQuery->isFuzzy);
+                server->queryPlanCache.checkIn(key, aclVersion, parsedQuery);
+            } else {
+                delete parsedQuery;
+            }
+        }
+    };
+}
+
+bool HTTPRequestHandler::doSearchOneCore(const SearchRequest &request,
+        Srch2Server *server, evkeyvalq* headers, std::stringstream &errorStream,
+        JsonResponseWriter &writer, SeparatedResults *separatedResults, const volatile bool *cancelled) {
+
+    evhttp_parse_query(request.uri.c_str(), headers);
+    // a repeated search reuses the plan of an earlier one, see QueryPlanCache
+    SearchPlanHolder plan(server, getQueryPlanCacheKey(*headers));
+    ParsedParameterContainer &paramContainer = *plan.parsedQuery->paramContainer;
+    LogicalPlan &logicalPlan = *plan.parsedQuery->logicalPlan;
+
+    if (!plan.isReused) {
+        if(server->indexDataConfig->getHasRecordAcl()){
+            paramContainer.hasRoleCore = true;
+        }
+
+        // simple example for query is : q={boost=2}name:foo~0.5 AND bar^3*&fq=name:"John"
+        //1. first create query parser to parse the url
+        QueryParser qp(*headers, &paramContainer);
+        bool isSyntaxValid = qp.parse();
+        if (!isSyntaxValid) {
+            // if the query is not valid print the error message to the response
+            errorStream << paramContainer.getMessageString();
+            return false;
+        }
+        if (server->indexDataConfig->isUserFeedbackEnabled()) {
+            // set only if user feedback is enabled else leave it empty.
+            logicalPlan.queryStringWithTermsAndOps = qp.fetchCleanQueryString();
+        }
     }
 
 //    clock_gettime(CLOCK_REALTIME, &tend);
@@ -1737,32 +1848,30 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_reques
 //    clock_gettime(CLOCK_REALTIME, &tstart2);
 
     const CoreInfo_t *indexDataContainerConf = server->indexDataConfig;
-    //2. validate the query
-    QueryValidator qv(*(server->indexer->getSchema()),
-            *(server->indexDataConfig), &paramContainer,
-            server->indexer->getAttributeAcl());
-
-    bool valid = qv.validate();
-
-    if (!valid) {
-        // if the query is not valid, print the error message to the response
-        errorStream << paramContainer.getMessageString();
-        return root;
-    }
-    //3. rewrite the query and apply analyzer and other stuff ...
-    QueryRewriter qr(server->indexDataConfig,
-            *(server->indexer->getSchema()),
-            *(AnalyzerFactory::getCurrentThreadAnalyzer(indexDataContainerConf)),
-            &paramContainer, server->indexer->getAttributeAcl());
-    LogicalPlan logicalPlan;
-    if (server->indexDataConfig->isUserFeedbackEnabled()) {
-    	// set only if user feedback is enabled else leave it empty.
-    	logicalPlan.queryStringWithTermsAndOps = qp.fetchCleanQueryString();
-    }
-    if(qr.rewrite(logicalPlan) == false){
-        // if the query is not valid, print the error message to the response
-        errorStream << paramContainer.getMessageString();
-        return root;
+    if (!plan.isReused) {
+        //2. validate the query
+        QueryValidator qv(*(server->indexer->getSchema()),
+                *(server->indexDataConfig), &paramContainer,
+                server->indexer->getAttributeAcl());
+
+        bool valid = qv.validate();
+
+        if (!valid) {
+            // if the query is not valid, print the error message to the response
+            errorStream << paramContainer.getMessageString();
+            return false;
+        }
+        //3. rewrite the query and apply analyzer and other stuff ...
+        QueryRewriter qr(server->indexDataConfig,
+                *(server->indexer->getSchema()),
+                *(AnalyzerFactory::getCurrentThreadAnalyzer(indexDataContainerConf)),
+                &paramContainer, server->indexer->getAttributeAcl());
+        if(qr.rewrite(logicalPlan) == false){
+            // if the query is not valid, print the error message to the response
+            errorStream << paramContainer.getMessageString();
+            return false;
+        }
+        plan.parsedQuery->isFuzzy = logicalPlan.isFuzzy();
     }
 
 //    clock_gettime(CLOCK_REALTIME, &tend);
@@ -1774,10 +1883,18 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_reques
     srch2is::QueryResultFactory * resultsFactory =
             new srch2is::QueryResultFactory();
     // TODO : is it possible to make executor and planGen singleton ?
-    QueryExecutor qe(logicalPlan, resultsFactory, server , indexDataContainerConf);
+    QueryExecutor qe(logicalPlan, resultsFactory, server , indexDataContainerConf, cancelled);
     // in here just allocate an empty QueryResults object, it will be initialized in execute.
     QueryResults * finalResults = new QueryResults();
     qe.execute(finalResults);
+    if (cancelled != NULL && *cancelled) {
+        // nobody waits for the results anymore, they may be incomplete
+        errorStream << "The search was cancelled.";
+        delete finalResults;
+        delete resultsFactory;
+        plan.isExecuted = true;
+        return false;
+    }
 
     // compute elapsed time in ms , end the timer
     clock_gettime(CLOCK_REALTIME, &tend);
@@ -1798,7 +1915,7 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_reques
     		!paramContainer.onlyFacets &&
     		paramContainer.isHighlightOn && logicalPlan.getQueryType() != SearchTypeRetrieveById) {
 
-    	ServerHighLighter highlighter =  ServerHighLighter(finalResults, server, paramContainer,
+    	ServerHighLighter highlighter(finalResults, server, paramContainer,
     			logicalPlan.getOffset(), logicalPlan.getNumberOfResultsToRetrieve());
     	highlightInfo.reserve(logicalPlan.getNumberOfResultsToRetrieve());
     	highlighter.generateSnippets(highlightInfo);
@@ -1813,16 +1930,17 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_reques
             + (hltend.tv_nsec - hltstart.tv_nsec) / 1000000;
 
     //5. call the print function to print out the results
+    bool printed = true;
     switch (logicalPlan.getQueryType()) {
     case srch2is::SearchTypeTopKQuery:
         finalResults->printStats();
-        root = HTTPRequestHandler::printResults(req, *headers, logicalPlan,
+        HTTPRequestHandler::printResults(writer, request, *headers, logicalPlan,
                 indexDataContainerConf, finalResults, logicalPlan.getExactQuery(),
                 server->indexer, logicalPlan.getOffset(),
                 finalResults->getNumberOfResults(),
                 finalResults->getNumberOfResults(), paramContainer.roleId,
                 paramContainer.getMessageString(), ts1, tstart, tend, highlightInfo, hlTime,
-                paramContainer.onlyFacets);
+                paramContainer.onlyFacets, separatedResults);
 
         break;
 
@@ -1834,27 +1952,27 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_reques
         if (logicalPlan.getOffset() + logicalPlan.getNumberOfResultsToRetrieve()
                 > finalResults->getNumberOfResults()) {
             // Case where you have return 10,20, but we got only 0,15 results.
-            root = HTTPRequestHandler::printResults(req, *headers, logicalPlan,
+            HTTPRequestHandler::printResults(writer, request, *headers, logicalPlan,
                     indexDataContainerConf, finalResults,
                     logicalPlan.getExactQuery(), server->indexer,
                     logicalPlan.getOffset(), finalResults->getNumberOfResults(),
                     finalResults->getNumberOfResults(), paramContainer.roleId,
                     paramContainer.getMessageString(), ts1, tstart, tend , highlightInfo, hlTime,
-                    paramContainer.onlyFacets);
+                    paramContainer.onlyFacets, separatedResults);
         } else { // Case where you have return 10,20, but we got only 0,25 results and so return 10,20
-            root = HTTPRequestHandler::printResults(req, *headers, logicalPlan,
+            HTTPRequestHandler::printResults(writer, request, *headers, logicalPlan,
                     indexDataContainerConf, finalResults,
                     logicalPlan.getExactQuery(), server->indexer,
                     logicalPlan.getOffset(),
                     logicalPlan.getOffset() + logicalPlan.getNumberOfResultsToRetrieve(),
                     finalResults->getNumberOfResults(), paramContainer.roleId,
                     paramContainer.getMessageString(), ts1, tstart, tend, highlightInfo, hlTime,
-                    paramContainer.onlyFacets);
+                    paramContainer.onlyFacets, separatedResults);
         }
         break;
     case srch2is::SearchTypeRetrieveById:
         finalResults->printStats();
-        root = HTTPRequestHandler::printOneResultRetrievedById(req,
+        HTTPRequestHandler::printOneResultRetrievedById(writer, request,
                 *headers,
                 logicalPlan ,
                 indexDataContainerConf,
@@ -1862,9 +1980,10 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_reques
                 server->indexer ,
                 paramContainer.roleId,
                 paramContainer.getMessageString() ,
-                ts1, tstart , tend);
+                ts1, tstart , tend, separatedResults);
         break;
     default:
+        printed = false;
         break;
     }
 
@@ -1876,35 +1995,125 @@ boost::shared_ptr<Json::Value> HTTPRequestHandler::doSearchOneCore(evhttp_reques
     // Free the objects
     delete finalResults;
     delete resultsFactory;
-    return root;
+    plan.isExecuted = true;
+    return printed;
+}
+
+SearchRequest::SearchRequest(const evhttp_request *req)
+    : uri(req->uri), remotePort(req->remote_port) {
+    if (req->remote_host != NULL) {
+        this->remoteHost = req->remote_host;
+    }
 }
 
+namespace {
+    // the value of an unsigned parameter of a request, or defaultValue if it is missing or not a number
+    unsigned getUnsignedParameter(const evkeyvalq &headers, const char *name, unsigned defaultValue) {
+        const char *value = evhttp_find_header(&headers, name);
+        if (value == NULL || !isUnsigned(value)) {
+            return defaultValue;
+        }
+        return static_cast<unsigned>(strtoul(value, NULL, 10));
+    }
+
+    // uri with the parameter name set to value, the other parameters are kept as they are
+    string setUriParameter(const string &uri, const char *name, unsigned value) {
+        const size_t queryStart = uri.find('?');
+        std::stringstream result;
+        result << uri.substr(0, queryStart) << "?";
+        if (queryStart != string::npos) {
+            const string query = uri.substr(queryStart + 1);
+            vector<string> parameters;
+            boost::split(parameters, query, boost::is_any_of("&"));
+            for (unsigned i = 0; i < parameters.size(); ++i) {
+                if (parameters[i].empty() || parameters[i].substr(0, parameters[i].find('=')) == name) {
+                    continue;
+                }
+                result << parameters[i] << "&";
+            }
+        }
+        result << name << "=" << value;
+        return result.str();
+    }
+}
+
+bool HTTPRequestHandler::searchOneCoreOfAll(const SearchRequest &request, const vector<Srch2Server *> &servers,
+        unsigned coreOffset, JsonResponseWriter &writer, SeparatedResults *separatedResults,
+        std::stringstream &errorStream, const volatile bool *cancelled) {
+    evkeyvalq headers;
+    bool succeeded;
+    try {
+        succeeded = doSearchOneCore(request, servers[coreOffset], &headers, errorStream, writer,
+                separatedResults, cancelled);
+    } catch (...) {
+        evhttp_clear_headers(&headers);
+        throw;
+    }
+    evhttp_clear_headers(&headers);
+    return succeeded;
+}
+
+/*
+ * Searches all the cores in parallel on the shared thread pool. The response has the response of
+ * each core by core name or, if merge=topk, one page of the results of all the cores sorted by score
+ * and the rest of the response of each core.
+ *
+ * A core which does not answer within timeAllowed milliseconds gets an error in the response. Its
+ * search is cancelled and stops at the next record it reads, after the response was sent.
+ */
 void HTTPRequestHandler::searchAllCommand(evhttp_request *req, const CoreNameServerMap_t * coreNameServerMap){
 
+    evbuffer *returnbuffer = create_buffer(req);
+    if (returnbuffer == NULL)
+        return;
     evkeyvalq headers;
-    Json::Value root(Json::objectValue);
-    int cSuccess = 0;
-    for( CoreNameServerMap_t::const_iterator it = coreNameServerMap->begin(); 
-            it != coreNameServerMap->end(); ++it){
-        std::stringstream errorStream;
-        boost::shared_ptr<Json::Value> subRoot = doSearchOneCore( req, it->second, &headers, errorStream );
-        Json::Value errorResponse(Json::objectValue);
-        errorResponse["error"] = errorStream.str();
-
-        if (subRoot ){
-            root[it->first] = *subRoot;
-            cSuccess +=1;
-        } else {
-            root[it->first] = errorResponse;
-        }
+    evhttp_parse_query(req->uri, &headers);
+
+    // 0 means no deadline
+    const unsigned timeAllowed = getUnsignedParameter(headers, QueryParser::timeAllowedParamName, 0);
+    const char *merge = evhttp_find_header(&headers, QueryParser::mergeResultsParamName);
+    const bool mergeResults = merge != NULL && string(merge) == QueryParser::mergeResultsTopK;
+
+    SearchRequest request(req);
+    unsigned offset = 0;
+    unsigned numberOfResults = 0;
+    if (mergeResults && !coreNameServerMap->empty()) {
+        // every core returns its best offset + rows results, and the page is taken from all of them
+        offset = getUnsignedParameter(headers, QueryParser::startParamName, 0);
+        numberOfResults = getUnsignedParameter(headers, QueryParser::rowsParamName,
+                coreNameServerMap->begin()->second->indexDataConfig->getDefaultResultsToRetrieve());
+        request.uri = setUriParameter(request.uri, QueryParser::startParamName, 0);
+        request.uri = setUriParameter(request.uri, QueryParser::rowsParamName, offset + numberOfResults);
+    }
+
+    vector<string> coreNames;
+    vector<Srch2Server *> servers;
+    for (CoreNameServerMap_t::const_iterator it = coreNameServerMap->begin();
+            it != coreNameServerMap->end(); ++it) {
+        coreNames.push_back(it->first);
+        servers.push_back(it->second);
+    }
+    // the search of a core keeps its own copy of the request and of the servers
+    boost::shared_ptr<SearchAllCores> searches = SearchAllCores::start(coreNames,
+            boost::bind(&HTTPRequestHandler::searchOneCoreOfAll, request, servers, _1, _2, _3, _4, _5),
+            mergeResults, srch2::util::WorkStealingThreadPool::getSharedPool());
+    searches->wait(timeAllowed);
+
+    JsonResponseWriter writer(returnbuffer);
+    const unsigned cSuccess = searches->getNumberOfSucceededCores();
+    if (mergeResults) {
+        searches->writeMergedResults(writer, offset, numberOfResults);
+    } else {
+        searches->writeResponses(writer);
     }
 
     //We return SUCCESS as long as one of the cores succeeds.
     if (cSuccess > 0){
-        bmhelper_evhttp_send_reply(req, HTTP_OK, "OK", global_customized_writer.write(root), headers);
+        bmhelper_evhttp_send_streamed_reply(req, HTTP_OK, "OK", returnbuffer, headers);
     } else {
-        bmhelper_evhttp_send_reply(req, HTTP_BADREQUEST, "Bad Request", global_customized_writer.write(root), headers);
+        bmhelper_evhttp_send_streamed_reply(req, HTTP_BADREQUEST, "Bad Request", returnbuffer, headers);
     }
+    evbuffer_free(returnbuffer);
     evhttp_clear_headers(&headers);
 }
 
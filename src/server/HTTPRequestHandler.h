@@ -47,6 +47,9 @@
 #include <event.h>
 #include <evhttp.h>
 #include "highlighter/Highlighter.h"
+#include "util/JsonResponseWriter.h"
+#include "SearchAllCores.h"
+#include <boost/shared_ptr.hpp>
 
 namespace srch2
 {
@@ -55,6 +58,20 @@ namespace httpwrapper
 // named access to multiple "cores" (ala Solr)
 typedef std::map<const std::string, srch2http::Srch2Server *> CoreNameServerMap_t;
 
+/*
+ * The parts of a search request that the search of a core reads. They are copied from the
+ * evhttp_request so that a core searched on the thread pool by searchAllCommand() can still
+ * finish after it missed its deadline and the request was answered and freed.
+ */
+struct SearchRequest
+{
+    std::string uri;
+    std::string remoteHost;
+    unsigned short remotePort;
+
+    explicit SearchRequest(const evhttp_request *req);
+};
+
 class HTTPRequestHandler
 {
     public:
@@ -82,10 +99,21 @@ class HTTPRequestHandler
 
 	private:
 
-        static boost::shared_ptr<Json::Value> doSearchOneCore(evhttp_request *req,Srch2Server *server, 
-                evkeyvalq* headers, std::stringstream &errorStream) ;
+        /*
+         * Streams the response of a search in one core to writer. Returns false without writing
+         * anything if the query is not valid; the reason is written to errorStream. The results
+         * go to separatedResults instead of the response if it is not NULL.
+         */
+        static bool doSearchOneCore(const SearchRequest &request, Srch2Server *server,
+                evkeyvalq* headers, std::stringstream &errorStream, JsonResponseWriter &writer,
+                SeparatedResults *separatedResults = NULL, const volatile bool *cancelled = NULL) ;
+
+        // searches one core of searchAllCommand() on the thread pool, see SearchAllCores
+        static bool searchOneCoreOfAll(const SearchRequest &request, const std::vector<Srch2Server *> &servers,
+                unsigned coreOffset, JsonResponseWriter &writer, SeparatedResults *separatedResults,
+                std::stringstream &errorStream, const volatile bool *cancelled);
 
-		static boost::shared_ptr<Json::Value> printResults(evhttp_request *req, const evkeyvalq &headers,
+		static void printResults(JsonResponseWriter &writer, const SearchRequest &request, const evkeyvalq &headers,
 				const LogicalPlan &queryPlan,
 				const CoreInfo_t *indexDataConfig,
 				const QueryResults *queryResults,
@@ -99,10 +127,11 @@ class HTTPRequestHandler
 				const unsigned ts1,
 				struct timespec &tstart, struct timespec &tend,
 				const vector<RecordSnippet>& recordSnippets, unsigned hltime,
-				bool onlyFacets = false
+				bool onlyFacets = false,
+				SeparatedResults *separatedResults = NULL
 				);
 
-		static boost::shared_ptr<Json::Value> printOneResultRetrievedById(evhttp_request *req, const evkeyvalq &headers,
+		static void printOneResultRetrievedById(JsonResponseWriter &writer, const SearchRequest &request, const evkeyvalq &headers,
 				const LogicalPlan &queryPlan,
 				const CoreInfo_t *indexDataConfig,
 				const QueryResults *queryResults,
@@ -110,7 +139,8 @@ class HTTPRequestHandler
 				const string & aclRoleId,
 				const string & message,
 				const unsigned ts1,
-				struct timespec &tstart, struct timespec &tend);
+				struct timespec &tstart, struct timespec &tend,
+				SeparatedResults *separatedResults = NULL);
 
 		static void printSuggestions(evhttp_request *req, const evkeyvalq &headers,
 				const vector<string> & suggestions,
@@ -119,10 +149,25 @@ class HTTPRequestHandler
 				const unsigned ts1,
 				struct timespec &tstart, struct timespec &tend);
 		static void cleanAndAppendToBuffer(const string& in, string& out);
-		static void genRecordJsonString(const srch2is::Indexer *indexer, StoredRecordBuffer buffer,
-				const string& externalId, string& sbuffer, const string& aclRoleId);
-		static void genRecordJsonString(const srch2is::Indexer *indexer, StoredRecordBuffer buffer,
-				const string& externalId, string& sbuffer,const vector<string>* attrToReturn, const string& aclRoleId);
+		static bool getAttributesToReturn(const CoreInfo_t *indexDataConfig,
+				const vector<string> &attributesToReturnFromQuery, const vector<string> *&attrToReturn);
+
+		/*
+		 * Converts the stored records of one response to JSON. The stored schema and the
+		 * attributes the role can access are computed once for all the records.
+		 */
+		class RecordJsonGenerator {
+		public:
+			RecordJsonGenerator(const srch2is::Indexer *indexer, const vector<string>* attrToReturn,
+					const string& aclRoleId);
+			~RecordJsonGenerator();
+			void write(JsonResponseWriter &writer, StoredRecordBuffer buffer, const string& externalRecordId);
+		private:
+			Schema *storedSchema;
+			vector<string> accessibleAttrsList;
+			// reused for all the records
+			string jsonBuffer;
+		};
 		static void genSnippetJSONString(unsigned recIdx, unsigned start,
 				const vector<RecordSnippet>& recordSnippets, string& sbuffer,
 				const QueryResults *queryResults);
@@ -44,6 +44,32 @@ const char* c_resume = "resume";
 
 const char* c_failed = "failed";
 const char* c_success = "success";
+
+// write-ahead log entries
+const char* c_log_operation = "op";
+const char* c_log_doc = "doc";
+const char* c_log_uri = "uri";
+const char* c_log_primary_key = "primaryKey";
+const char* c_log_role_id = "roleId";
+const char* c_log_role_ids = "roleIds";
+const char* c_log_resource_ids = "resourceIds";
+const char* c_log_command = "command";
+const char* c_log_api = "api";
+const char* c_log_acl_record_roles = "aclRecordRoles";
+const char* c_log_acl_role_records = "aclRoleRecords";
+const char* c_log_acl_attribute = "aclAttribute";
+
+Json::Value stringsToJsonArray(const vector<string> &strings) {
+	Json::Value array(Json::arrayValue);
+	for (unsigned i = 0; i < strings.size(); ++i)
+		array.append(strings[i]);
+	return array;
+}
+
+void jsonArrayToStrings(const Json::Value &array, vector<string> &strings) {
+	for (Json::UInt i = 0; i < array.size(); ++i)
+		strings.push_back(array[i].asString());
+}
 }
 
 Json::Value IndexWriteUtil::_insertCommand(Indexer *indexer,
@@ -274,10 +300,12 @@ Json::Value IndexWriteUtil::_updateCommand(Indexer *indexer,
 	return response;
 }
 
-Json::Value IndexWriteUtil::_saveCommand(Indexer *indexer) {
+Json::Value IndexWriteUtil::_saveCommand(Indexer *indexer, bool *saved) {
 	Json::Value response(Json::objectValue);
-	indexer->save();
-	response[c_action_save] = c_success;
+	bool success = (indexer->save() == srch2::instantsearch::OP_SUCCESS);
+	response[c_action_save] = success ? c_success : c_failed;
+	if (saved != NULL)
+		*saved = success;
 	return response;
 }
 
@@ -407,3 +435,113 @@ Json::Value IndexWriteUtil::_aclModifyRecordsOfRole(Indexer *indexer, string &ro
 	return response;
 }
 
+
+Json::Value IndexWriteUtil::_insertLogEntry(const Json::Value &root) {
+	Json::Value entry(Json::objectValue);
+	entry[c_log_operation] = c_action_insert;
+	entry[c_log_doc] = root;
+	return entry;
+}
+
+Json::Value IndexWriteUtil::_deleteLogEntry(const char *uri) {
+	Json::Value entry(Json::objectValue);
+	entry[c_log_operation] = c_action_delete;
+	entry[c_log_uri] = uri;
+	return entry;
+}
+
+Json::Value IndexWriteUtil::_updateLogEntry(const char *uri, const Json::Value &root) {
+	Json::Value entry(Json::objectValue);
+	entry[c_log_operation] = c_action_update;
+	entry[c_log_uri] = uri;
+	entry[c_log_doc] = root;
+	return entry;
+}
+
+Json::Value IndexWriteUtil::_aclRecordModifyRolesLogEntry(const string &primaryKeyID,
+		const vector<string> &roleIds, srch2::instantsearch::RecordAclCommandType commandType) {
+	Json::Value entry(Json::objectValue);
+	entry[c_log_operation] = c_log_acl_record_roles;
+	entry[c_log_primary_key] = primaryKeyID;
+	entry[c_log_role_ids] = stringsToJsonArray(roleIds);
+	entry[c_log_command] = (int) commandType;
+	return entry;
+}
+
+Json::Value IndexWriteUtil::_aclModifyRecordsOfRoleLogEntry(const string &roleId,
+		const vector<string> &resourceIds, srch2::instantsearch::RecordAclCommandType commandType) {
+	Json::Value entry(Json::objectValue);
+	entry[c_log_operation] = c_log_acl_role_records;
+	entry[c_log_role_id] = roleId;
+	entry[c_log_resource_ids] = stringsToJsonArray(resourceIds);
+	entry[c_log_command] = (int) commandType;
+	return entry;
+}
+
+Json::Value IndexWriteUtil::_attributeAclLogEntry(const Json::Value &root, srch2::instantsearch::AclActionType action,
+		const string &apiName) {
+	Json::Value entry(Json::objectValue);
+	entry[c_log_operation] = c_log_acl_attribute;
+	entry[c_log_doc] = root;
+	entry[c_log_command] = (int) action;
+	entry[c_log_api] = apiName;
+	return entry;
+}
+
+// Replays one entry of the write-ahead log the same way the HTTP handler applied it.
+void IndexWriteUtil::_applyLogEntry(Indexer *indexer,
+		const CoreInfo_t *indexDataContainerConf, const Json::Value &entry) {
+	const string operation = entry.get(c_log_operation, "").asString();
+	Json::Value response;
+	if (operation == c_action_insert) {
+		const Json::Value &doc = entry[c_log_doc];
+		Record *record = new Record(indexer->getSchema());
+		vector<string> roleIds;
+		std::stringstream log_str;
+		if (indexDataContainerConf->getHasRecordAcl()
+				&& JSONRecordParser::_extractRoleIds(roleIds, doc, indexDataContainerConf, log_str)) {
+			record->setRoleIds(roleIds);
+		}
+		response = _insertCommand(indexer, indexDataContainerConf, doc, record);
+		delete record;
+	} else if (operation == c_action_delete) {
+		evkeyvalq headers;
+		evhttp_parse_query(entry[c_log_uri].asCString(), &headers);
+		response = _deleteCommand_QueryURI(indexer, indexDataContainerConf, headers);
+		evhttp_clear_headers(&headers);
+	} else if (operation == c_action_update) {
+		evkeyvalq headers;
+		evhttp_parse_query(entry[c_log_uri].asCString(), &headers);
+		Record *record = new Record(indexer->getSchema());
+		response = _updateCommand(indexer, indexDataContainerConf, headers, entry[c_log_doc], record);
+		delete record;
+		evhttp_clear_headers(&headers);
+	} else if (operation == c_log_acl_record_roles) {
+		string primaryKeyID = entry[c_log_primary_key].asString();
+		vector<string> roleIds;
+		jsonArrayToStrings(entry[c_log_role_ids], roleIds);
+		response = _aclRecordModifyRoles(indexer, primaryKeyID, roleIds,
+				(srch2::instantsearch::RecordAclCommandType) entry[c_log_command].asInt());
+	} else if (operation == c_log_acl_role_records) {
+		string roleId = entry[c_log_role_id].asString();
+		vector<string> resourceIds;
+		jsonArrayToStrings(entry[c_log_resource_ids], resourceIds);
+		response = _aclModifyRecordsOfRole(indexer, roleId, resourceIds,
+				(srch2::instantsearch::RecordAclCommandType) entry[c_log_command].asInt());
+	} else if (operation == c_log_acl_attribute) {
+		const Json::Value &doc = entry[c_log_doc];
+		srch2::instantsearch::AclActionType action = (srch2::instantsearch::AclActionType) entry[c_log_command].asInt();
+		if (doc.type() == Json::arrayValue) {
+			// the handler stops at the first object that fails
+			for (Json::UInt index = 0; index < doc.size(); ++index) {
+				if (!indexer->getAttributeAcl().processSingleJSONAttributeAcl(doc[index], action,
+						entry[c_log_api].asString(), response))
+					break;
+			}
+		} else {
+			indexer->getAttributeAcl().processSingleJSONAttributeAcl(doc, action, entry[c_log_api].asString(), response);
+		}
+	} else {
+		Logger::error("Unknown operation '%s' in the write-ahead log", operation.c_str());
+	}
+}
@@ -35,6 +35,7 @@
 #include "thirdparty/snappy-1.0.4/snappy.h"
 #include "URLParser.h"
 #include "util/RecordSerializerUtil.h"
+#include "operation/AttributeAccessControl.h"
 using namespace snappy;
 
 namespace srch2
@@ -52,7 +53,8 @@ struct IndexWriteUtil
 
     static Json::Value _updateCommand(Indexer *indexer, const CoreInfo_t *indexDataContainerConf, const evkeyvalq &headers, const Json::Value &root, Record *record);
 
-    static Json::Value _saveCommand(Indexer *indexer);
+    // saved, if not NULL, is set to whether every index file reached the disk
+    static Json::Value _saveCommand(Indexer *indexer, bool *saved = NULL);
 
     static Json::Value _exportCommand(Indexer *indexer, const char* exportedDataFileName);
 
@@ -62,6 +64,22 @@ struct IndexWriteUtil
 
     static Json::Value _aclModifyRecordsOfRole(Indexer *indexer, string &roleId, vector<string> &resourceIds, srch2::instantsearch::RecordAclCommandType commandType);
 
+    // Entries of the write-ahead log (see WriteAheadLog.h). Each one describes a write request
+    // of one record or ACL, which _applyLogEntry() replays after the indexes are loaded.
+    static Json::Value _insertLogEntry(const Json::Value &root);
+
+    static Json::Value _deleteLogEntry(const char *uri);
+
+    static Json::Value _updateLogEntry(const char *uri, const Json::Value &root);
+
+    static Json::Value _aclRecordModifyRolesLogEntry(const string &primaryKeyID, const vector<string> &roleIds, srch2::instantsearch::RecordAclCommandType commandType);
+
+    static Json::Value _aclModifyRecordsOfRoleLogEntry(const string &roleId, const vector<string> &resourceIds, srch2::instantsearch::RecordAclCommandType commandType);
+
+    static Json::Value _attributeAclLogEntry(const Json::Value &root, srch2::instantsearch::AclActionType action, const string &apiName);
+
+    static void _applyLogEntry(Indexer *indexer, const CoreInfo_t *indexDataContainerConf, const Json::Value &entry);
+
 };
 
 }}
@@ -32,12 +32,14 @@
 #include <map>
 #include <cstring>
 #include <cstdlib>
+#include <deque>
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
 #include "JSONRecordParser.h"
 #include <instantsearch/GlobalCache.h>
 
 #include "thirdparty/utf8/utf8.h"
-#include "thirdparty/snappy-1.0.4/snappy.h"
 #include "util/Logger.h"
 #include "ParserUtility.h"
 #include <instantsearch/Analyzer.h>
@@ -47,10 +49,11 @@
 #include "boost/algorithm/string/split.hpp"
 #include "boost/algorithm/string/classification.hpp"
 #include "util/RecordSerializerUtil.h"
+#include "util/StoredFieldCodec.h"
+#include "util/WorkStealingThreadPool.h"
+#include "util/Assert.h"
 #include "include/instantsearch/Constants.h"
 
-using namespace snappy;
-
 using namespace std;
 namespace srch2is = srch2::instantsearch;
 using namespace srch2::util;
@@ -289,9 +292,9 @@ bool JSONRecordParser::setRecordRefiningValue(srch2is::Record *record,
 }
 
 bool JSONRecordParser::setCompactRecordSearchableValue(
-        const srch2is::Record *record, RecordSerializer& compactRecSerializer,
-        std::stringstream &error) {
-    string compressedInputLine;
+        const srch2is::Record *record, const CoreInfo_t *indexDataContainerConf,
+        RecordSerializer& compactRecSerializer, std::stringstream &error) {
+    string encodedValue;
     typedef map<string, unsigned>::const_iterator SearchableAttrIter;
     // Note: storageSchema is a schema for in-memory data and it differs from actual schema populated
     // from config file and kept in the index.
@@ -311,10 +314,10 @@ bool JSONRecordParser::setCompactRecordSearchableValue(
         } else {
             record->getRefiningAttributeValue(iter->first, singleString);
         }
-        snappy::Compress(singleString.c_str(), singleString.length(),
-                &compressedInputLine);
+        StoredFieldCodec::encode(singleString,
+                &indexDataContainerConf->getStoredFieldDictionary(), encodedValue);
         compactRecSerializer.addSearchableAttribute(iter->first,
-                compressedInputLine);
+                encodedValue);
     }
     return true;
 }
@@ -475,7 +478,7 @@ bool JSONRecordParser::_JSONValueObjectToRecord(srch2is::Record *record,
     // Creating in-memory compact representation below by using the Record object. Sanity check of input
     // data is done before creating the record object.
     // 1. storing variable length attributes
-    if(!setCompactRecordSearchableValue(record,compactRecSerializer,error)){
+    if(!setCompactRecordSearchableValue(record,indexDataContainerConf,compactRecSerializer,error)){
         return false;
     }
     // 2. Now we need to store the Fixed attributes (int and float)
@@ -756,8 +759,126 @@ srch2is::Schema* JSONRecordParser::createAndPopulateSchema(const CoreInfo_t *ind
     return schema;
 }
 
+namespace {
+
+// A batch of consecutive lines of the data file. Its lines are parsed and analyzed by one task of the
+// shared thread pool, and then its records are added to the index by the loading thread in file order.
+struct BulkLoadBatch {
+    vector<string> lines;
+    vector<unsigned> lineNumbers;
+    vector<srch2is::Record *> records;
+    vector<bool> parseSuccess;
+    vector<string> errors;
+    vector<map<string, srch2is::TokenAttributeHits> > tokenAttributeHitsMaps;
+    TaskGroup *taskGroup;
+
+    BulkLoadBatch(): taskGroup(NULL) {}
+    ~BulkLoadBatch() {
+        delete taskGroup;
+        for (unsigned i = 0; i < records.size(); ++i)
+            delete records[i];
+    }
+};
+
+// Analyzers and record serializers are not thread-safe, so each running task borrows its own pair.
+// They are all created by the loading thread because the analyzer factory is not thread-safe either.
+class BulkLoadAnalysisContexts {
+public:
+    BulkLoadAnalysisContexts(unsigned numberOfContexts, const CoreInfo_t *indexDataContainerConf,
+            Schema *storedAttrSchema) {
+        for (unsigned i = 0; i < numberOfContexts; ++i) {
+            analyzers.push_back(AnalyzerFactory::createAnalyzer(indexDataContainerConf));
+            serializers.push_back(new RecordSerializer(*storedAttrSchema));
+            freeContexts.push_back(i);
+        }
+    }
+    ~BulkLoadAnalysisContexts() {
+        for (unsigned i = 0; i < analyzers.size(); ++i) {
+            delete analyzers[i];
+            delete serializers[i];
+        }
+    }
+
+    // there are as many contexts as batches in flight, so one is always free
+    unsigned borrow() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        ASSERT(!freeContexts.empty());
+        unsigned context = freeContexts.back();
+        freeContexts.pop_back();
+        return context;
+    }
+    void giveBack(unsigned context) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        freeContexts.push_back(context);
+    }
+
+    vector<srch2is::Analyzer *> analyzers;
+    vector<RecordSerializer *> serializers;
+
+private:
+    boost::mutex mutex;
+    vector<unsigned> freeContexts;
+};
+
+void analyzeBulkLoadBatch(BulkLoadBatch *batch, BulkLoadAnalysisContexts *contexts,
+        const srch2is::Schema *schema, const CoreInfo_t *indexDataContainerConf) {
+    unsigned context = contexts->borrow();
+    srch2is::Analyzer *analyzer = contexts->analyzers[context];
+    RecordSerializer &compactRecSerializer = *contexts->serializers[context];
+
+    unsigned numberOfLines = batch->lines.size();
+    batch->records.resize(numberOfLines, NULL);
+    batch->parseSuccess.resize(numberOfLines, false);
+    batch->errors.resize(numberOfLines);
+    batch->tokenAttributeHitsMaps.resize(numberOfLines);
+    for (unsigned i = 0; i < numberOfLines; ++i) {
+        batch->records[i] = new srch2is::Record(schema);
+        std::stringstream error;
+        batch->parseSuccess[i] = JSONRecordParser::populateRecordFromJSON(batch->lines[i],
+                indexDataContainerConf, batch->records[i], error, compactRecSerializer);
+        if (batch->parseSuccess[i]) {
+            analyzer->tokenizeRecord(batch->records[i], batch->tokenAttributeHitsMaps[i]);
+        } else {
+            batch->errors[i] = error.str();
+        }
+        // the line is not needed anymore
+        string().swap(batch->lines[i]);
+    }
+
+    contexts->giveBack(context);
+}
+
+// adds the records of the batch to the index and deletes the batch
+void indexBulkLoadBatch(BulkLoadBatch *batch, srch2is::Indexer *indexer, unsigned &indexedRecordsCount) {
+    // the loading thread helps the pool while the batch is not analyzed yet
+    batch->taskGroup->wait();
+
+    const unsigned reportFreq = 10000;
+    for (unsigned i = 0; i < batch->records.size(); ++i) {
+        if (batch->parseSuccess[i]) {
+            // Add the record to the index
+            indexer->addAnalyzedRecord(batch->records[i], batch->tokenAttributeHitsMaps[i]);
+            indexedRecordsCount++;
+        } else {
+            Logger::error("at line: %d" , batch->lineNumbers[i]);
+            Logger::error("%s", batch->errors[i].c_str());
+        }
+        if (indexedRecordsCount % reportFreq == 0) {
+            Logger::console("Indexing first %d records.\r", indexedRecordsCount);
+        }
+    }
+    delete batch;
+}
+
+}
+
 /*
  *  Create indexes using records from json file and return the total indexed records.
+ *
+ *  The file is loaded in a pipeline: this thread reads batches of lines, the tasks of the shared thread pool
+ *  parse and analyze them in parallel, and this thread adds the analyzed records to the index in file order,
+ *  so the internal record ids are the same as with a serial load. The commit() that follows the load sorts
+ *  and scores the inverted lists in parallel as well.
  */
 unsigned DaemonDataSource::createNewIndexFromFile(srch2is::Indexer* indexer, Schema * storedAttrSchema,
         const CoreInfo_t *indexDataContainerConf)
@@ -771,21 +892,22 @@ unsigned DaemonDataSource::createNewIndexFromFile(srch2is::Indexer* indexer, Sch
     }
 
     string line;
-    srch2is::Record *record = new srch2is::Record(indexer->getSchema());
 
     unsigned lineCounter = 0;
     unsigned indexedRecordsCount = 0;
-    // use same analyzer object for all the records
-    srch2is::Analyzer *analyzer = AnalyzerFactory::createAnalyzer(indexDataContainerConf); 
 
-    RecordSerializer compactRecSerializer = RecordSerializer(*storedAttrSchema);
+    WorkStealingThreadPool *pool = WorkStealingThreadPool::getSharedPool();
+    const unsigned batchSize = 1000;
+    // bounds the memory used by the lines and records that are read but not indexed yet
+    const unsigned maxNumberOfBatchesInFlight = 2 * pool->getNumberOfThreads() + 1;
+    BulkLoadAnalysisContexts contexts(maxNumberOfBatchesInFlight, indexDataContainerConf, storedAttrSchema);
+    std::deque<BulkLoadBatch *> batchesInFlight;
 
     if(in.good()){
         bool isArrayOfJsonRecords = false;
+        BulkLoadBatch *batch = new BulkLoadBatch();
         while(getline(in, line))
         {
-            bool parseSuccess = false;
-
         // remove the trailing space or "," characters
         while (!line.empty() && (
                     line.at(line.length() - 1) == ' ' ||
@@ -796,7 +918,7 @@ unsigned DaemonDataSource::createNewIndexFromFile(srch2is::Indexer* indexer, Sch
         }
 
             boost::trim(line);
-            if (indexedRecordsCount == 0 &&  line == "[") {
+            if (lineCounter == 0 &&  line == "[") {
                 // Solr style data source - array of JSON records
                 isArrayOfJsonRecords = true;
                 continue;
@@ -806,35 +928,36 @@ unsigned DaemonDataSource::createNewIndexFromFile(srch2is::Indexer* indexer, Sch
                 break; // assume nothing follows array (will ignore more records or another array)
             }
 
-            std::stringstream error;
-            parseSuccess = JSONRecordParser::populateRecordFromJSON(line, indexDataContainerConf, record, error, compactRecSerializer);
-
-            if(parseSuccess)
-            {
-                // Add the record to the index
-                //indexer->addRecordBeforeCommit(record, 0);
-                indexer->addRecord(record, analyzer);
-                indexedRecordsCount++;
-            }
-            else
-            {
-                Logger::error("at line: %d" , lineCounter);
-                Logger::error("%s", error.str().c_str());
-            }
-            record->clear();
-            int reportFreq = 10000;
+            batch->lines.push_back(line);
+            batch->lineNumbers.push_back(lineCounter);
             ++lineCounter;
-            if (indexedRecordsCount % reportFreq == 0) {
-                Logger::console("Indexing first %d records.\r", indexedRecordsCount);
+
+            if (batch->lines.size() == batchSize) {
+                if (batchesInFlight.size() == maxNumberOfBatchesInFlight) {
+                    indexBulkLoadBatch(batchesInFlight.front(), indexer, indexedRecordsCount);
+                    batchesInFlight.pop_front();
+                }
+                batch->taskGroup = new TaskGroup(pool);
+                batch->taskGroup->run(boost::bind(&analyzeBulkLoadBatch, batch, &contexts,
+                        indexer->getSchema(), indexDataContainerConf));
+                batchesInFlight.push_back(batch);
+                batch = new BulkLoadBatch();
             }
         }
+
+        // the last batch is analyzed by this thread
+        batch->taskGroup = new TaskGroup(pool);
+        while (!batchesInFlight.empty()) {
+            indexBulkLoadBatch(batchesInFlight.front(), indexer, indexedRecordsCount);
+            batchesInFlight.pop_front();
+        }
+        analyzeBulkLoadBatch(batch, &contexts, indexer->getSchema(), indexDataContainerConf);
+        indexBulkLoadBatch(batch, indexer, indexedRecordsCount);
     }
     Logger::console("Indexed %d / %d records.", indexedRecordsCount, lineCounter);
     Logger::console("Finalizing ...");
     in.close();
 
-    delete analyzer;
-    delete record;
     return indexedRecordsCount;
 }
 
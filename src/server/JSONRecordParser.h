@@ -81,6 +81,7 @@ private:
             const Json::Value &root, const CoreInfo_t *indexDataContainerConf,
             std::stringstream &error);
     static bool setCompactRecordSearchableValue(const srch2is::Record *record,
+            const CoreInfo_t *indexDataContainerConf,
             RecordSerializer& compactRecSerializer,std::stringstream &error);
     static bool setCompactRecordRefiningValue(const srch2is::Record *record,
             RecordSerializer& compactRecSerializer,std::stringstream &error);
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "QueryPlanCache.h"
+#include "ParsedParameterContainer.h"
+#include <instantsearch/LogicalPlan.h>
+
+namespace srch2
+{
+namespace httpwrapper
+{
+
+ParsedQuery::ParsedQuery()
+    : paramContainer(new ParsedParameterContainer()), logicalPlan(new srch2::instantsearch::LogicalPlan()),
+      isFuzzy(false)
+{
+}
+
+ParsedQuery::~ParsedQuery()
+{
+    delete this->logicalPlan;
+    delete this->paramContainer;
+}
+
+QueryPlanCache::QueryPlanCache(unsigned maximumNumberOfPlans)
+    : numberOfIdlePlans(0), maximumNumberOfPlans(maximumNumberOfPlans), hits(0), misses(0)
+{
+}
+
+QueryPlanCache::~QueryPlanCache()
+{
+    std::vector<ParsedQuery *> removedPlans;
+    while (!this->entries.empty()) {
+        removeEntry(this->entries.begin(), removedPlans);
+    }
+    for (unsigned i = 0; i < removedPlans.size(); ++i) {
+        delete removedPlans[i];
+    }
+}
+
+void QueryPlanCache::removeEntry(std::map<std::string, Entry>::iterator entry,
+        std::vector<ParsedQuery *> &removedPlans)
+{
+    removedPlans.insert(removedPlans.end(), entry->second.idlePlans.begin(), entry->second.idlePlans.end());
+    this->numberOfIdlePlans -= entry->second.idlePlans.size();
+    this->recentlyUsedKeys.erase(entry->second.recentUse);
+    this->entries.erase(entry);
+}
+
+ParsedQuery *QueryPlanCache::checkOut(const std::string &key, unsigned aclVersion)
+{
+    std::vector<ParsedQuery *> removedPlans;
+    ParsedQuery *parsedQuery = NULL;
+    {
+        boost::unique_lock<boost::mutex> lock(this->mutex);
+        std::map<std::string, Entry>::iterator entry = this->entries.find(key);
+        if (entry != this->entries.end()) {
+            if (entry->second.aclVersion != aclVersion) {
+                removeEntry(entry, removedPlans);
+            } else if (!entry->second.idlePlans.empty()) {
+                parsedQuery = entry->second.idlePlans.back();
+                entry->second.idlePlans.pop_back();
+                --this->numberOfIdlePlans;
+                this->recentlyUsedKeys.splice(this->recentlyUsedKeys.begin(), this->recentlyUsedKeys,
+                        entry->second.recentUse);
+            }
+        }
+        if (parsedQuery != NULL) {
+            ++this->hits;
+        } else {
+            ++this->misses;
+        }
+    }
+    // the stale plans are deleted outside of the lock
+    for (unsigned i = 0; i < removedPlans.size(); ++i) {
+        delete removedPlans[i];
+    }
+    return parsedQuery;
+}
+
+void QueryPlanCache::checkIn(const std::string &key, unsigned aclVersion, ParsedQuery *parsedQuery)
+{
+    // a cache without room keeps no plan, and must not evict the entry it has just added
+    if (this->maximumNumberOfPlans == 0) {
+        delete parsedQuery;
+        return;
+    }
+    std::vector<ParsedQuery *> removedPlans;
+    {
+        boost::unique_lock<boost::mutex> lock(this->mutex);
+        std::map<std::string, Entry>::iterator entry = this->entries.find(key);
+        if (entry != this->entries.end() && entry->second.aclVersion != aclVersion) {
+            removeEntry(entry, removedPlans);
+            entry = this->entries.end();
+        }
+        if (entry == this->entries.end()) {
+            entry = this->entries.insert(std::make_pair(key, Entry())).first;
+            entry->second.aclVersion = aclVersion;
+            this->recentlyUsedKeys.push_front(key);
+            entry->second.recentUse = this->recentlyUsedKeys.begin();
+        } else {
+            this->recentlyUsedKeys.splice(this->recentlyUsedKeys.begin(), this->recentlyUsedKeys,
+                    entry->second.recentUse);
+        }
+        entry->second.idlePlans.push_back(parsedQuery);
+        ++this->numberOfIdlePlans;
+        while (this->numberOfIdlePlans > this->maximumNumberOfPlans) {
+            removeEntry(this->entries.find(this->recentlyUsedKeys.back()), removedPlans);
+        }
+    }
+    for (unsigned i = 0; i < removedPlans.size(); ++i) {
+        delete removedPlans[i];
+    }
+}
+
+Json::Value QueryPlanCache::getJson() const
+{
+    Json::Value statistics(Json::objectValue);
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    statistics["hits"] = (Json::UInt64) this->hits;
+    statistics["misses"] = (Json::UInt64) this->misses;
+    const uint64_t lookups = this->hits + this->misses;
+    statistics["hit_rate"] = lookups == 0 ? 0.0 : (double) this->hits / lookups;
+    statistics["plans"] = this->numberOfIdlePlans;
+    return statistics;
+}
+
+}
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __QUERYPLANCACHE_H__
+#define __QUERYPLANCACHE_H__
+
+#include "json/value.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <boost/thread/mutex.hpp>
+
+namespace srch2
+{
+namespace instantsearch
+{
+class LogicalPlan;
+}
+
+namespace httpwrapper
+{
+
+class ParsedParameterContainer;
+
+/*
+ * A search request parsed, validated and rewritten into a logical plan.
+ */
+struct ParsedQuery
+{
+    ParsedQuery();
+    // deletes the plan before the parameters, as the plan uses their filter and sort evaluators
+    ~ParsedQuery();
+
+    ParsedParameterContainer *paramContainer;
+    srch2::instantsearch::LogicalPlan *logicalPlan;
+    // the fuzzy flag of the plan set by the rewriter, which the execution of the plan changes
+    bool isFuzzy;
+
+private:
+    ParsedQuery(const ParsedQuery &);
+    ParsedQuery &operator=(const ParsedQuery &);
+};
+
+/*
+ * The parsed queries of the recent search requests of a core, keyed by their normalized query
+ * parameters, so that a repeated request, e.g. of autocomplete, skips the parser, the validator
+ * and the rewriter with its analyzer, and its plan goes straight to the optimizer.
+ *
+ * The execution of a plan annotates it, so a plan is used by one request at a time: checkOut()
+ * takes an idle plan out of the cache and checkIn() gives it back once the response is written.
+ * Concurrent requests with the same key use their own plans, and all of them are kept.
+ *
+ * The config and the schema of a core do not change while its server runs, so a plan only
+ * becomes stale when the attribute acl changes. Its version is kept with the plans of a key.
+ */
+class QueryPlanCache
+{
+public:
+    static const unsigned DEFAULT_MAXIMUM_NUMBER_OF_PLANS = 1024;
+
+    QueryPlanCache(unsigned maximumNumberOfPlans = DEFAULT_MAXIMUM_NUMBER_OF_PLANS);
+    ~QueryPlanCache();
+
+    // NULL if there is no idle plan for the key parsed with the acl of aclVersion
+    ParsedQuery *checkOut(const std::string &key, unsigned aclVersion);
+
+    // Keeps an executed plan for the next request with the key. The plans of the least
+    // recently used keys are deleted when there are more than the maximum number of plans.
+    // With a maximum of 0 the cache is disabled and the plan is deleted.
+    void checkIn(const std::string &key, unsigned aclVersion, ParsedQuery *parsedQuery);
+
+    // the hits, misses, hit rate and number of idle plans
+    Json::Value getJson() const;
+
+private:
+    struct Entry
+    {
+        unsigned aclVersion;
+        std::vector<ParsedQuery *> idlePlans;
+        // the position of the key in recentlyUsedKeys
+        std::list<std::string>::iterator recentUse;
+    };
+
+    void removeEntry(std::map<std::string, Entry>::iterator entry, std::vector<ParsedQuery *> &removedPlans);
+
+    mutable boost::mutex mutex;
+    std::map<std::string, Entry> entries;
+    // the most recently used key first
+    std::list<std::string> recentlyUsedKeys;
+    unsigned numberOfIdlePlans;
+    const unsigned maximumNumberOfPlans;
+    uint64_t hits;
+    uint64_t misses;
+
+    QueryPlanCache(const QueryPlanCache &);
+    QueryPlanCache &operator=(const QueryPlanCache &);
+};
+
+}
+}
+
+#endif // __QUERYPLANCACHE_H__
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "SearchAllCores.h"
+#include "util/Logger.h"
+#include "util/WorkStealingThreadPool.h"
+#include <algorithm>
+#include <exception>
+#include <boost/bind.hpp>
+#include <boost/thread/thread_time.hpp>
+
+using std::string;
+using std::vector;
+using srch2::util::Logger;
+
+namespace srch2
+{
+namespace httpwrapper
+{
+
+namespace
+{
+    // a result of a core in the merged results
+    struct MergedResult
+    {
+        double score;
+        unsigned coreOffset;
+        unsigned resultOffset;
+        // the best score first, the results with the same score in the order of the cores
+        bool operator<(const MergedResult &other) const
+        {
+            return this->score > other.score;
+        }
+    };
+}
+
+ResultsWriter::ResultsWriter(JsonResponseWriter &writer, SeparatedResults *separatedResults)
+    : writer(writer), separatedResults(separatedResults),
+      resultBuffer(separatedResults != NULL ? evbuffer_new() : NULL), resultWriter(resultBuffer)
+{
+}
+
+ResultsWriter::~ResultsWriter()
+{
+    if (this->resultBuffer != NULL) {
+        evbuffer_free(this->resultBuffer);
+    }
+}
+
+void ResultsWriter::begin()
+{
+    if (this->separatedResults == NULL) {
+        this->writer.key("results");
+        this->writer.beginArray();
+    }
+}
+
+JsonResponseWriter &ResultsWriter::beginResult()
+{
+    JsonResponseWriter &currentWriter = this->separatedResults == NULL ? this->writer : this->resultWriter;
+    currentWriter.beginObject();
+    return currentWriter;
+}
+
+void ResultsWriter::endResult(double score)
+{
+    if (this->separatedResults == NULL) {
+        this->writer.endObject();
+        return;
+    }
+    this->resultWriter.key("core");
+    this->resultWriter.value(this->separatedResults->coreName);
+    this->resultWriter.endObject();
+    string result(evbuffer_get_length(this->resultBuffer), '\0');
+    evbuffer_remove(this->resultBuffer, &result[0], result.size());
+    this->separatedResults->scores.push_back(score);
+    this->separatedResults->results.push_back(result);
+}
+
+void ResultsWriter::end()
+{
+    if (this->separatedResults == NULL) {
+        this->writer.endArray();
+    }
+}
+
+SearchAllCores::SearchAllCores(const vector<string> &coreNames, const SearchOneCore &searchOneCore,
+        bool mergeResults)
+    : coreNames(coreNames), searchOneCore(searchOneCore), mergeResults(mergeResults), cancelled(false)
+{
+    for (unsigned coreOffset = 0; coreOffset < coreNames.size(); ++coreOffset) {
+        this->responses.push_back(evbuffer_new());
+    }
+    this->separatedResults.resize(coreNames.size());
+    for (unsigned coreOffset = 0; coreOffset < coreNames.size(); ++coreOffset) {
+        this->separatedResults[coreOffset].coreName = coreNames[coreOffset];
+    }
+    this->errors.resize(coreNames.size());
+    this->succeeded.resize(coreNames.size(), false);
+    this->finished.resize(coreNames.size(), false);
+    this->numberOfUnfinishedCores = coreNames.size();
+}
+
+SearchAllCores::~SearchAllCores()
+{
+    for (unsigned coreOffset = 0; coreOffset < this->responses.size(); ++coreOffset) {
+        evbuffer_free(this->responses[coreOffset]);
+    }
+}
+
+boost::shared_ptr<SearchAllCores> SearchAllCores::start(const vector<string> &coreNames,
+        const SearchOneCore &searchOneCore, bool mergeResults, srch2::util::WorkStealingThreadPool *pool)
+{
+    boost::shared_ptr<SearchAllCores> searches(new SearchAllCores(coreNames, searchOneCore, mergeResults));
+    for (unsigned coreOffset = 0; coreOffset < coreNames.size(); ++coreOffset) {
+        pool->submit(boost::bind(&SearchAllCores::searchCore, searches, coreOffset));
+    }
+    return searches;
+}
+
+void SearchAllCores::searchCore(boost::shared_ptr<SearchAllCores> searches, unsigned coreOffset)
+{
+    std::stringstream errorStream;
+    evbuffer *response = searches->responses[coreOffset];
+    JsonResponseWriter writer(response);
+    SeparatedResults *separatedResults = searches->mergeResults ? &searches->separatedResults[coreOffset] : NULL;
+    bool succeeded = false;
+    try {
+        // a search which did not start before the deadline is not needed anymore
+        if (!searches->cancelled) {
+            succeeded = searches->searchOneCore(coreOffset, writer, separatedResults, errorStream,
+                    &searches->cancelled);
+        }
+    } catch (std::exception &e) {
+        Logger::error(e.what());
+        errorStream << "The engine failed to process this request. Please check srch2 server logs for more details.";
+    }
+    if (!succeeded) {
+        // an exception may have left a part of the response
+        evbuffer_drain(response, evbuffer_get_length(response));
+        if (separatedResults != NULL) {
+            separatedResults->scores.clear();
+            separatedResults->results.clear();
+        }
+    }
+
+    boost::unique_lock<boost::mutex> lock(searches->mutex);
+    searches->errors[coreOffset] = errorStream.str();
+    searches->succeeded[coreOffset] = succeeded;
+    searches->finished[coreOffset] = true;
+    --searches->numberOfUnfinishedCores;
+    searches->coreFinished.notify_all();
+}
+
+void SearchAllCores::wait(unsigned timeAllowed)
+{
+    const boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeAllowed);
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    while (this->numberOfUnfinishedCores > 0) {
+        if (timeAllowed == 0) {
+            this->coreFinished.wait(lock);
+        } else if (!this->coreFinished.timed_wait(lock, deadline)) {
+            break;
+        }
+    }
+    // the cores which finish later do not change the members of the answered ones
+    this->answered = this->finished;
+    if (this->numberOfUnfinishedCores > 0) {
+        this->cancelled = true;
+    }
+}
+
+unsigned SearchAllCores::getNumberOfSucceededCores() const
+{
+    unsigned numberOfSucceededCores = 0;
+    for (unsigned coreOffset = 0; coreOffset < this->coreNames.size(); ++coreOffset) {
+        if (this->answered[coreOffset] && this->succeeded[coreOffset]) {
+            ++numberOfSucceededCores;
+        }
+    }
+    return numberOfSucceededCores;
+}
+
+void SearchAllCores::writeError(JsonResponseWriter &writer, unsigned coreOffset) const
+{
+    writer.beginObject();
+    writer.key("error");
+    if (!this->answered[coreOffset]) {
+        writer.value("The core did not answer within timeAllowed.");
+    } else {
+        writer.value(this->errors[coreOffset]);
+    }
+    writer.endObject();
+}
+
+void SearchAllCores::writeResponses(JsonResponseWriter &writer) const
+{
+    writer.beginObject();
+    for (unsigned coreOffset = 0; coreOffset < this->coreNames.size(); ++coreOffset) {
+        writer.key(this->coreNames[coreOffset]);
+        if (this->answered[coreOffset] && this->succeeded[coreOffset]) {
+            evbuffer *response = this->responses[coreOffset];
+            writer.rawValue((const char *) evbuffer_pullup(response, -1), evbuffer_get_length(response));
+        } else {
+            writeError(writer, coreOffset);
+        }
+    }
+    writer.endObject();
+}
+
+void SearchAllCores::writeMergedResults(JsonResponseWriter &writer, unsigned offset,
+        unsigned numberOfResults) const
+{
+    vector<MergedResult> mergedResults;
+    for (unsigned coreOffset = 0; coreOffset < this->coreNames.size(); ++coreOffset) {
+        if (!this->answered[coreOffset] || !this->succeeded[coreOffset]) {
+            continue;
+        }
+        const vector<double> &scores = this->separatedResults[coreOffset].scores;
+        for (unsigned resultOffset = 0; resultOffset < scores.size(); ++resultOffset) {
+            MergedResult mergedResult;
+            mergedResult.score = scores[resultOffset];
+            mergedResult.coreOffset = coreOffset;
+            mergedResult.resultOffset = resultOffset;
+            mergedResults.push_back(mergedResult);
+        }
+    }
+    std::stable_sort(mergedResults.begin(), mergedResults.end());
+
+    writer.beginObject();
+    writer.key("results");
+    writer.beginArray();
+    unsigned numberOfWrittenResults = 0;
+    for (unsigned i = offset; i < mergedResults.size() && numberOfWrittenResults < numberOfResults; ++i) {
+        writer.rawValue(this->separatedResults[mergedResults[i].coreOffset].results[mergedResults[i].resultOffset]);
+        ++numberOfWrittenResults;
+    }
+    writer.endArray();
+    writer.key("offset");
+    writer.value(offset);
+    writer.key("limit");
+    writer.value(numberOfWrittenResults);
+    writer.key("results_found");
+    writer.value((unsigned) mergedResults.size());
+
+    // the rest of the response of each core, e.g., its facets
+    writer.key("cores");
+    writer.beginObject();
+    for (unsigned coreOffset = 0; coreOffset < this->coreNames.size(); ++coreOffset) {
+        writer.key(this->coreNames[coreOffset]);
+        if (this->answered[coreOffset] && this->succeeded[coreOffset]) {
+            evbuffer *response = this->responses[coreOffset];
+            writer.rawValue((const char *) evbuffer_pullup(response, -1), evbuffer_get_length(response));
+        } else {
+            writeError(writer, coreOffset);
+        }
+    }
+    writer.endObject();
+    writer.endObject();
+}
+
+}
+}
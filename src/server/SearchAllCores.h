@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __SEARCHALLCORES_H__
+#define __SEARCHALLCORES_H__
+
+#include "util/JsonResponseWriter.h"
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace srch2
+{
+namespace util
+{
+class WorkStealingThreadPool;
+}
+
+namespace httpwrapper
+{
+
+/*
+ * The results of a search in one core, kept apart from the rest of its response so that
+ * /_all/search can merge the results of several cores by score without parsing the responses.
+ */
+struct SeparatedResults
+{
+    // the name of the core, added to each result as "core"
+    std::string coreName;
+    // the score and the encoded JSON object of each result, in the order of the core
+    std::vector<double> scores;
+    std::vector<std::string> results;
+};
+
+/*
+ * Writes the results of a search as the "results" array of the response, or, if separatedResults
+ * is not NULL, into separatedResults and not into the response.
+ *
+ * Example:
+ *      ResultsWriter resultsWriter(writer, separatedResults);
+ *      resultsWriter.begin();
+ *      JsonResponseWriter &resultWriter = resultsWriter.beginResult();
+ *      resultWriter.key("record_id");
+ *      resultWriter.value(recordId);
+ *      resultsWriter.endResult(score);
+ *      resultsWriter.end();
+ */
+class ResultsWriter
+{
+public:
+    ResultsWriter(JsonResponseWriter &writer, SeparatedResults *separatedResults);
+    ~ResultsWriter();
+
+    void begin();
+    // opens the object of the next result and returns the writer of its members
+    JsonResponseWriter &beginResult();
+    void endResult(double score);
+    void end();
+
+private:
+    JsonResponseWriter &writer;
+    SeparatedResults *separatedResults;
+    // the result being written when the results are kept apart
+    evbuffer *resultBuffer;
+    JsonResponseWriter resultWriter;
+
+    ResultsWriter(const ResultsWriter &);
+    ResultsWriter &operator=(const ResultsWriter &);
+};
+
+/*
+ * The searches of the cores of one /_all/search request. Each core is searched by a task on a
+ * thread pool, the shared one of the server, and the request thread waits for them at most timeAllowed milliseconds.
+ * The searches of the cores which miss the deadline are cancelled: a search which has not started
+ * yet is skipped, and a running one is given the cancel flag to stop at the next record. A core
+ * which misses the deadline keeps the searches alive until its task ends, so the function which
+ * searches a core must not use the evhttp_request, which is freed once it was answered.
+ */
+class SearchAllCores
+{
+public:
+    /*
+     * Searches the core at coreOffset. Returns false if the query is not valid, with the reason
+     * written to errorStream. The results go to separatedResults if it is not NULL. The search
+     * should stop as soon as *cancelled is set, its results are not used anymore.
+     */
+    typedef boost::function<bool (unsigned coreOffset, JsonResponseWriter &writer,
+            SeparatedResults *separatedResults, std::stringstream &errorStream,
+            const volatile bool *cancelled)> SearchOneCore;
+
+    // Starts the search of each core on pool. The results are kept apart from the responses if mergeResults is set.
+    static boost::shared_ptr<SearchAllCores> start(const std::vector<std::string> &coreNames,
+            const SearchOneCore &searchOneCore, bool mergeResults, srch2::util::WorkStealingThreadPool *pool);
+
+    ~SearchAllCores();
+
+    // Waits until every core answered, or at most timeAllowed milliseconds if it is not 0. The
+    // searches of the cores which did not answer are cancelled.
+    void wait(unsigned timeAllowed);
+
+    // the number of cores which answered in time without an error
+    unsigned getNumberOfSucceededCores() const;
+
+    // writes the response or the error of each core by core name
+    void writeResponses(JsonResponseWriter &writer) const;
+
+    // writes one page of the results of all the cores sorted by score, and the rest of the response of each core
+    void writeMergedResults(JsonResponseWriter &writer, unsigned offset, unsigned numberOfResults) const;
+
+private:
+    SearchAllCores(const std::vector<std::string> &coreNames, const SearchOneCore &searchOneCore,
+            bool mergeResults);
+
+    static void searchCore(boost::shared_ptr<SearchAllCores> searches, unsigned coreOffset);
+    void writeError(JsonResponseWriter &writer, unsigned coreOffset) const;
+
+    const std::vector<std::string> coreNames;
+    const SearchOneCore searchOneCore;
+    const bool mergeResults;
+    // the response each core writes and its separated results, read once the core finished
+    std::vector<evbuffer *> responses;
+    std::vector<SeparatedResults> separatedResults;
+    std::vector<std::string> errors;
+    // guarded by mutex
+    std::vector<bool> succeeded;
+    std::vector<bool> finished;
+    unsigned numberOfUnfinishedCores;
+    // set by wait() when it stops waiting, the cores which finished before
+    std::vector<bool> answered;
+    // set by wait() if it stopped waiting before every core finished, read by the searches without locking
+    volatile bool cancelled;
+
+    boost::mutex mutex;
+    boost::condition_variable coreFinished;
+
+    SearchAllCores(const SearchAllCores &);
+    SearchAllCores &operator=(const SearchAllCores &);
+};
+
+}
+}
+
+#endif // __SEARCHALLCORES_H__
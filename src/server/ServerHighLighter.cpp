@@ -38,15 +38,26 @@
 #include "util/RecordSerializer.h"
 #include "query/QueryResultsInternal.h"
 #include "util/RecordSerializerUtil.h"
+#include "util/WorkStealingThreadPool.h"
+#include "util/encoding.h"
+#include "operation/IndexerInternal.h"
+#include "operation/CacheManager.h"
+#include <boost/bind.hpp>
+#include <sstream>
 
 using namespace srch2::util;
 using namespace srch2::instantsearch;
 
 namespace srch2 {
 namespace httpwrapper {
+
+// pages with fewer results than twice this number are highlighted by the request thread alone
+static const unsigned MIN_RECORDS_PER_SNIPPET_TASK = 16;
+
 /*
- *   The function loops over all the query results and calls genSnippetsForSingleRecord for
- *   each query result.
+ *   The function splits the query results of the page in ranges and calls genSnippetsForRange
+ *   for each range. The first range is done by the request thread and the others by tasks of the
+ *   thread pool, if there are enough results to be worth it.
  */
 void ServerHighLighter::generateSnippets(vector<RecordSnippet>& highlightInfo){
 
@@ -54,12 +65,44 @@ void ServerHighLighter::generateSnippets(vector<RecordSnippet>& highlightInfo){
 	if (upperLimit > HighlightRecOffset + HighlightRecCount)
 		upperLimit = HighlightRecOffset + HighlightRecCount;
 	unsigned lowerLimit = HighlightRecOffset;
+	if (lowerLimit >= upperLimit)
+		return;
+	unsigned numberOfRecords = upperLimit - lowerLimit;
+	unsigned firstSnippet = highlightInfo.size();
+	highlightInfo.resize(firstSnippet + numberOfRecords);
+	RecordSnippet *snippets = &highlightInfo[firstSnippet];
+
+	unsigned numberOfTasks = numberOfRecords / MIN_RECORDS_PER_SNIPPET_TASK;
+	if (numberOfTasks > pool->getNumberOfThreads())
+		numberOfTasks = pool->getNumberOfThreads();
+	if (numberOfTasks <= 1) {
+		genSnippetsForRange(contexts[0], lowerLimit, upperLimit, snippets);
+		return;
+	}
+
+	// the contexts are created by this thread because the analyzer factory is not thread-safe
+	while (contexts.size() < numberOfTasks)
+		contexts.push_back(createSnippetContext(false));
+	TaskGroup taskGroup(pool);
+	unsigned firstRangeUpperLimit = lowerLimit + numberOfRecords / numberOfTasks;
+	unsigned rangeLowerLimit = firstRangeUpperLimit;
+	for (unsigned task = 1; task < numberOfTasks; ++task) {
+		unsigned rangeUpperLimit = lowerLimit + numberOfRecords * (task + 1) / numberOfTasks;
+		taskGroup.run(boost::bind(&ServerHighLighter::genSnippetsForRange, this, contexts[task],
+				rangeLowerLimit, rangeUpperLimit, snippets + (rangeLowerLimit - lowerLimit)));
+		rangeLowerLimit = rangeUpperLimit;
+	}
+	genSnippetsForRange(contexts[0], lowerLimit, firstRangeUpperLimit, snippets);
+	taskGroup.wait();
+}
+
+// generates the snippets of the query results in [lowerLimit, upperLimit) into snippets[0 .. upperLimit - lowerLimit)
+void ServerHighLighter::genSnippetsForRange(SnippetContext *context, unsigned lowerLimit, unsigned upperLimit,
+		RecordSnippet *snippets) {
 	for (unsigned i = lowerLimit; i < upperLimit; ++i) {
-		RecordSnippet recordSnippets;
-		unsigned recordId = queryResults->getInternalRecordId(i);
-		genSnippetsForSingleRecord(queryResults, i, recordSnippets);
-		recordSnippets.recordId =recordId;
-		highlightInfo.push_back(recordSnippets);
+		RecordSnippet& recordSnippets = snippets[i - lowerLimit];
+		genSnippetsForSingleRecord(context, queryResults, i, recordSnippets);
+		recordSnippets.recordId = queryResults->getInternalRecordId(i);
 	}
 }
 
@@ -89,11 +132,33 @@ void buildKeywordHighlightInfo(const QueryResults * qr, unsigned recIdx,
 		keywordStrToHighlight.push_back(keywordInfo);
 	}
 }
+
+/*
+ *   The part of the keys of the snippet cache that depends on the keywords matched by a record.
+ *   It must be built before the highlight algorithm changes the flags of the keywords.
+ */
+static void buildKeywordsCacheKey(const vector<keywordHighlightInfo>& keywordStrToHighlight, string& key) {
+	std::stringstream keyStream;
+	string keyword;
+	for (unsigned i = 0; i < keywordStrToHighlight.size(); ++i) {
+		charTypeVectorToUtf8String(keywordStrToHighlight[i].key, keyword);
+		keyStream << keyword.size() << ":" << keyword << "," << keywordStrToHighlight[i].flag << ","
+				<< keywordStrToHighlight[i].editDistance;
+		const vector<unsigned>& attributeIds = keywordStrToHighlight[i].attributeIdsList;
+		for (unsigned j = 0; j < attributeIds.size(); ++j)
+			keyStream << "," << attributeIds[j];
+		keyStream << ";";
+	}
+	key = keyStream.str();
+}
+
 /*
  *   The function generates snippet for all the highlight attributes of a given query result.
- *   Attribute values are fetched from a compact representation stored in forward index.
+ *   Attribute values are fetched from a compact representation stored in forward index, unless
+ *   the snippets of the attribute are in the snippet cache.
  */
-void ServerHighLighter::genSnippetsForSingleRecord(const QueryResults *qr, unsigned recIdx, RecordSnippet& recordSnippets) {
+void ServerHighLighter::genSnippetsForSingleRecord(SnippetContext *context, const QueryResults *qr,
+		unsigned recIdx, RecordSnippet& recordSnippets) {
 
 		/*
 		 *  Code below is a setup for highlighter module
@@ -102,10 +167,12 @@ void ServerHighLighter::genSnippetsForSingleRecord(const QueryResults *qr, unsig
 
 		vector<keywordHighlightInfo> keywordStrToHighlight;
 		buildKeywordHighlightInfo(qr, recIdx, keywordStrToHighlight);
+		string keywordsCacheKey;
+		buildKeywordsCacheKey(keywordStrToHighlight, keywordsCacheKey);
 
-        StoredRecordBuffer buffer =  server->indexer->getInMemoryData(recordId);
-        if (buffer.start.get() == NULL)
-        	return;
+        // the stored record is fetched only if an attribute is not in the cache
+        StoredRecordBuffer buffer;
+        bool isBufferFetched = false;
         const vector<std::pair<unsigned, string> >&highlightAttributes = server->indexDataConfig->getHighlightAttributeIdsVector();
         for (unsigned i = 0 ; i < highlightAttributes.size(); ++i) {
     		AttributeSnippet attrSnippet;
@@ -116,17 +183,32 @@ void ServerHighLighter::genSnippetsForSingleRecord(const QueryResults *qr, unsig
         			aclRoleValue, highlightAttributes[i].second);
         	if (!isFieldAccessible)
         		continue;  // ignore unaccessible attributes. Do not generate snippet.
-        	unsigned lenOffset = compactRecDeserializer->getSearchableOffset(id);
-        	const char *attrdata = buffer.start.get() + *((unsigned *)(buffer.start.get() + lenOffset));
-        	unsigned len = *(((unsigned *)(buffer.start.get() + lenOffset)) + 1) -
-        			*((unsigned *)(buffer.start.get() + lenOffset));
-        	snappy::Uncompress(attrdata,len, &uncompressedInMemoryRecordString);
-        	try{
-				this->highlightAlgorithms->getSnippet(qr, recIdx, highlightAttributes[i].first,
-						uncompressedInMemoryRecordString, attrSnippet.snippet,
-						storedAttrSchema->isSearchableAttributeMultiValued(id), keywordStrToHighlight);
-        	}catch(const exception& ex) {
-        		Logger::debug("could not generate a snippet for an record/attr %d/%d", recordId, id);
+
+        	std::stringstream cacheKeyStream;
+        	cacheKeyStream << recordId << "/" << id << "/" << keywordsCacheKey << phrasesCacheKey;
+        	string cacheKey = cacheKeyStream.str();
+        	boost::shared_ptr<SnippetCacheEntry> cachedSnippets;
+        	if (snippetCache->getSnippets(cacheKey, cachedSnippets)) {
+        		attrSnippet.snippet = cachedSnippets->snippets;
+        	} else {
+        		if (!isBufferFetched) {
+        			buffer = server->indexer->getInMemoryData(recordId);
+        			isBufferFetched = true;
+        		}
+        		if (buffer.start.get() == NULL)
+        			return;
+        		RecordSerializerUtil::getSearchableAttributeValue(*context->compactRecDeserializer, id,
+        				buffer.start.get(), context->uncompressedInMemoryRecordString);
+        		try{
+        			context->highlightAlgorithm->getSnippet(qr, recIdx, highlightAttributes[i].first,
+        					context->uncompressedInMemoryRecordString, attrSnippet.snippet,
+        					storedAttrSchema->isSearchableAttributeMultiValued(id), keywordStrToHighlight);
+        			cachedSnippets.reset(new SnippetCacheEntry());
+        			cachedSnippets->snippets = attrSnippet.snippet;
+        			snippetCache->setSnippets(cacheKey, cachedSnippets);
+        		}catch(const exception& ex) {
+        			Logger::debug("could not generate a snippet for an record/attr %d/%d", recordId, id);
+        		}
         	}
         	attrSnippet.FieldId = highlightAttributes[i].second;
         	if (attrSnippet.snippet.size() > 0)
@@ -136,12 +218,51 @@ void ServerHighLighter::genSnippetsForSingleRecord(const QueryResults *qr, unsig
         	Logger::warn("could not generate a snippet because search keywords could not be found in any attribute of record!!");
 }
 
+/*
+ *   Creates the highlight algorithm of a context. The contexts of the pool tasks have their own
+ *   analyzer, the one of the request thread uses the analyzer of the thread.
+ */
+ServerHighLighter::SnippetContext *ServerHighLighter::createSnippetContext(bool isRequestThread) {
+	SnippetContext *context = new SnippetContext();
+	context->analyzer = NULL;
+	std::map<string, PhraseInfo> contextPhrasesInfoMap(phrasesInfoMap);
+	/*
+	 *  We have two ways of generating snippets.
+	 *  1. Using term offsets stored in the forward index.
+	 *  OR
+	 *  2. By generating offset information at runtime using analyzer.
+	 *
+	 *  If isEnabledCharPositionIndex returns true then the term offset information is available
+	 *  in the forward index. In that case we use the term offset based logic.
+	 */
+	// Note: check for server schema not the configuration.
+	if (isEnabledCharPositionIndex(server->indexer->getSchema()->getPositionIndexType())) {
+		context->highlightAlgorithm  = new TermOffsetAlgorithm(server->indexer,
+				 contextPhrasesInfoMap, hconf);
+	} else {
+		Analyzer *currentAnalyzer;
+		if (isRequestThread) {
+			currentAnalyzer = AnalyzerFactory::getCurrentThreadAnalyzerWithSynonyms(server->indexDataConfig);
+		} else {
+			context->analyzer = AnalyzerFactory::createAnalyzer(server->indexDataConfig, false);
+			currentAnalyzer = context->analyzer;
+		}
+		context->highlightAlgorithm  = new AnalyzerBasedAlgorithm(currentAnalyzer,
+				 contextPhrasesInfoMap, hconf);
+	}
+	context->compactRecDeserializer = new RecordSerializer(*storedAttrSchema);
+	context->uncompressedInMemoryRecordString.reserve(4096);
+	return context;
+}
+
 ServerHighLighter::ServerHighLighter(QueryResults * queryResults,Srch2Server *server,
-		ParsedParameterContainer& param, unsigned offset, unsigned count) {
+		const ParsedParameterContainer& param, unsigned offset, unsigned count,
+		WorkStealingThreadPool *pool) {
 
 	this->queryResults = queryResults;
+	this->server = server;
+	this->pool = pool != NULL ? pool : WorkStealingThreadPool::getSharedPool();
 
-	HighlightConfig hconf;
 	string pre, post;
 	server->indexDataConfig->getExactHighLightMarkerPre(pre);
 	server->indexDataConfig->getExactHighLightMarkerPost(post);
@@ -151,40 +272,35 @@ ServerHighLighter::ServerHighLighter(QueryResults * queryResults,Srch2Server *se
 	hconf.highlightMarkers.push_back(make_pair(pre, post));
 	server->indexDataConfig->getHighLightSnippetSize(hconf.snippetSize);
 	this->aclRoleValue = param.roleId;
-	if (!isEnabledWordPositionIndex(server->indexer->getSchema()->getPositionIndexType())){
-		// we do not need phrase information because position index is not enabled.
-		param.PhraseKeyWordsInfoMap.clear();
+	// the parameters are not changed since they may be kept with the plan in the query plan cache
+	if (isEnabledWordPositionIndex(server->indexer->getSchema()->getPositionIndexType())){
+		phrasesInfoMap = param.PhraseKeyWordsInfoMap;
 	}
-	/*
-	 *  We have two ways of generating snippets.
-	 *  1. Using term offsets stored in the forward index.
-	 *  OR
-	 *  2. By generating offset information at runtime using analyzer.
-	 *
-	 *  If isEnabledCharPositionIndex returns true then the term offset information is available
-	 *  in the forward index. In that case we use the term offset based logic.
-	 */
-	// Note: check for server schema not the configuration.
-	if (isEnabledCharPositionIndex(server->indexer->getSchema()->getPositionIndexType())) {
-		this->highlightAlgorithms  = new TermOffsetAlgorithm(server->indexer,
-				 param.PhraseKeyWordsInfoMap, hconf);
-	} else {
-		Analyzer *currentAnalyzer = AnalyzerFactory::getCurrentThreadAnalyzerWithSynonyms(server->indexDataConfig);
-		this->highlightAlgorithms  = new AnalyzerBasedAlgorithm(currentAnalyzer,
-				 param.PhraseKeyWordsInfoMap, hconf);
+	// else we do not need phrase information because position index is not enabled.
+	std::stringstream phrasesCacheKeyStream;
+	for (std::map<string, PhraseInfo>::iterator phrase = phrasesInfoMap.begin();
+			phrase != phrasesInfoMap.end(); ++phrase) {
+		phrasesCacheKeyStream << "\"" << phrase->first << "\"" << phrase->second.toString() << ";";
 	}
-	this->server = server;
+	phrasesCacheKey = phrasesCacheKeyStream.str();
+	// the markers and the snippet size are settings of the core, so they are not part of the keys
+	IndexReaderWriter *indexReaderWriter = dynamic_cast<IndexReaderWriter *>(server->indexer);
+	snippetCache = dynamic_cast<CacheManager *>(indexReaderWriter->getCache())->getSnippetCache();
+
 	storedAttrSchema = Schema::create();
 	RecordSerializerUtil::populateStoredSchema(storedAttrSchema, server->indexer->getSchema());
-	compactRecDeserializer = new RecordSerializer(*storedAttrSchema);
+	contexts.push_back(createSnippetContext(true));
 	this->HighlightRecOffset = offset;
 	this->HighlightRecCount = count;
-	this->uncompressedInMemoryRecordString.reserve(4096);
 }
 
 ServerHighLighter::~ServerHighLighter() {
-	delete this->compactRecDeserializer;
-	delete this->highlightAlgorithms;
+	for (unsigned i = 0; i < contexts.size(); ++i) {
+		delete contexts[i]->highlightAlgorithm;
+		delete contexts[i]->analyzer;
+		delete contexts[i]->compactRecDeserializer;
+		delete contexts[i];
+	}
 	delete storedAttrSchema;
     std::map<string, vector<unsigned> *>::iterator iter =
     						prefixToCompleteStore.begin();
@@ -39,11 +39,14 @@
 namespace srch2 {
 namespace instantsearch {
 class QueryResults;
+class Analyzer;
+class SnippetCache;
 }}
 
 namespace srch2 {
 namespace util {
 class RecordSerializer;
+class WorkStealingThreadPool;
 } }
 
 using namespace srch2::instantsearch;
@@ -56,24 +59,58 @@ namespace httpwrapper {
 class Srch2Server;
 class ParsedParameterContainer;
 
+/*
+ *  Generates the snippets of a page of query results. The snippets of large pages are generated
+ *  in parallel by the tasks of a thread pool, the shared one unless another one is given, each
+ *  one for a range of the results.
+ *  The snippets of an attribute are kept in the snippet cache of the core with the record id and
+ *  the keywords of the query, so that they are generated only once when the same records are
+ *  returned again.
+ */
 class ServerHighLighter {
 public:
 	ServerHighLighter(QueryResults * queryResults,Srch2Server *server,
-			ParsedParameterContainer& param, unsigned offset, unsigned count);
+			const ParsedParameterContainer& param, unsigned offset, unsigned count,
+			WorkStealingThreadPool *pool = NULL);
 	virtual ~ServerHighLighter();
 	void generateSnippets(vector<RecordSnippet>& highlightInfo);
 private:
-	void genSnippetsForSingleRecord(const QueryResults *qr, unsigned idx, RecordSnippet& recordSnippets);
+	/*
+	 *  Highlight algorithms, analyzers and record deserializers are not thread-safe, so every task
+	 *  generating snippets has its own context.
+	 */
+	struct SnippetContext {
+		HighlightAlgorithm* highlightAlgorithm;
+		// NULL if the context uses the analyzer of the request thread or the term offsets
+		Analyzer *analyzer;
+		RecordSerializer *compactRecDeserializer;
+		std::string uncompressedInMemoryRecordString;
+	};
+	SnippetContext *createSnippetContext(bool isRequestThread);
+	void genSnippetsForRange(SnippetContext *context, unsigned lowerLimit, unsigned upperLimit,
+			RecordSnippet *snippets);
+	void genSnippetsForSingleRecord(SnippetContext *context, const QueryResults *qr, unsigned idx,
+			RecordSnippet& recordSnippets);
 	QueryResults * queryResults;
-	HighlightAlgorithm* highlightAlgorithms;
 	Srch2Server *server;
-	RecordSerializer *compactRecDeserializer;
 	Schema * storedAttrSchema;
+	HighlightConfig hconf;
+	// copied into the highlight algorithm of every context
+	std::map<string, PhraseInfo> phrasesInfoMap;
+	// the phrases of the query as they appear in the keys of the snippet cache
+	string phrasesCacheKey;
+	SnippetCache *snippetCache;
+	WorkStealingThreadPool *pool;
+	// the first context is used by the request thread
+	vector<SnippetContext *> contexts;
 	unsigned HighlightRecOffset;
 	unsigned HighlightRecCount;
-	std::string uncompressedInMemoryRecordString;
     std::map<string, vector<unsigned> *> prefixToCompleteStore;
     string aclRoleValue;
+
+	// not copyable
+	ServerHighLighter(const ServerHighLighter &);
+	ServerHighLighter &operator=(const ServerHighLighter &);
 };
 
 } /* namespace httpwrapper */
@@ -28,6 +28,7 @@
 #include "Srch2Server.h"
 #include "util/RecordSerializerUtil.h"
 #include "operation/AttributeAccessControl.h"
+#include <boost/bind.hpp>
 
 #ifndef ANDROID
 #   include <sys/statvfs.h>
@@ -336,6 +337,66 @@ void Srch2Server::createAndBootStrapIndexer() {
     delete schema;
     // start merger thread
     indexer->createAndStartMergeThreadLoop();
+
+    if (indexDataConfig->isWriteAheadLogEnabled())
+        openWriteAheadLog();
+}
+
+void Srch2Server::openWriteAheadLog() {
+    const string &directoryName = indexDataConfig->getIndexPath();
+    if (!checkDirExistence(directoryName.c_str()) && createDir(directoryName.c_str()) != 0) {
+        Logger::error("%s: Cannot create index directory %s, write-ahead log is disabled.",
+                this->coreName.c_str(), directoryName.c_str());
+        return;
+    }
+    writeAheadLog = new WriteAheadLog(directoryName);
+    if (!writeAheadLog->isOpen()) {
+        Logger::error("%s: Cannot open write-ahead log, write-ahead log is disabled.",
+                this->coreName.c_str());
+        delete writeAheadLog;
+        writeAheadLog = NULL;
+        return;
+    }
+
+    // Everything in the log was acknowledged to a client after the last checkpoint,
+    // so apply it again and checkpoint right away to start from an empty log.
+    unsigned replayedEntries = writeAheadLog->replay(
+            boost::bind(&IndexWriteUtil::_applyLogEntry, indexer, indexDataConfig, _1));
+    if (replayedEntries > 0) {
+        Logger::console("%s: Replayed %u entries from the write-ahead log.",
+                this->coreName.c_str(), replayedEntries);
+        saveIndexes();
+    }
+
+    checkpointThread = new boost::thread(boost::bind(&Srch2Server::checkpointLoop, this));
+}
+
+void Srch2Server::checkpointLoop() {
+    try {
+        while (true) {
+            boost::this_thread::sleep(boost::posix_time::seconds(
+                    indexDataConfig->getCheckpointEveryNSeconds()));
+            if (writeAheadLog->getSizeInBytes() > 0)
+                saveIndexes();
+        }
+    } catch (boost::thread_interrupted &) {
+        // server is shutting down
+    }
+}
+
+Json::Value Srch2Server::saveIndexes() {
+    if (writeAheadLog == NULL)
+        return IndexWriteUtil::_saveCommand(indexer);
+
+    boost::unique_lock<boost::shared_mutex> checkpointLock(writeAheadLog->getCheckpointMutex());
+    bool saved = false;
+    Json::Value response = IndexWriteUtil::_saveCommand(indexer, &saved);
+    // the log is the only copy of the changes until the saved files are on the disk
+    if (saved)
+        writeAheadLog->truncate();
+    else
+        Logger::error("Saving the indexes failed, keeping the write-ahead log");
+    return response;
 }
 
 /*
@@ -38,6 +38,9 @@
 #include "util/mypthread.h"
 
 #include "IndexWriteUtil.h"
+#include "WriteAheadLog.h"
+#include "ConnectorFreshness.h"
+#include "QueryPlanCache.h"
 #include "json/json.h"
 #include "util/Logger.h"
 #include "util/FileOps.h"
@@ -48,6 +51,7 @@
 #include <stdint.h>
 #include <fstream>
 #include <sstream>
+#include <boost/thread.hpp>
 
 namespace srch2is = srch2::instantsearch;
 using std::string;
@@ -74,9 +78,20 @@ public:
     long long stat_fork_time; /* Time needed to perform latets fork() */
     long long stat_rejected_conn; /* Clients rejected because of maxclients */
 
+    // NULL unless <writeAheadLog> is enabled for this core.
+    WriteAheadLog *writeAheadLog;
+
+    // reported by the data connector of the core, if its data source is a database
+    ConnectorFreshness connectorFreshness;
+
+    // the plans of the recent searches of the core
+    QueryPlanCache queryPlanCache;
+
     Srch2Server() {
         this->indexer = NULL;
         this->indexDataConfig = NULL;
+        this->writeAheadLog = NULL;
+        this->checkpointThread = NULL;
     }
 
     void init(const ConfigManager *config) {
@@ -99,11 +114,27 @@ public:
     void setCoreName(const string &name);
     const string &getCoreName();
 
+    // Save the indexes to disk. With a write-ahead log this is a checkpoint:
+    // new writes are held off while the indexes are saved and the log truncated.
+    Json::Value saveIndexes();
+
     virtual ~Srch2Server() {
+        if (checkpointThread != NULL) {
+            checkpointThread->interrupt();
+            checkpointThread->join();
+            delete checkpointThread;
+        }
+        delete writeAheadLog;
     }
 
 protected:
     string coreName;
+    boost::thread *checkpointThread;
+
+    // Open the write-ahead log in the index directory, replay whatever it holds
+    // on top of the loaded indexes and start the periodic checkpoint thread.
+    void openWriteAheadLog();
+    void checkpointLoop();
 };
 
 class HTTPServerEndpoints {
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "WriteAheadLog.h"
+#include "json/json.h"
+#include "util/Logger.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <boost/crc.hpp>
+
+using namespace std;
+using srch2::util::Logger;
+
+namespace srch2
+{
+namespace httpwrapper
+{
+
+const char *const WriteAheadLog::fileName = "writeAheadLog.wal";
+
+namespace {
+
+const unsigned frameHeaderSize = 2 * sizeof(uint32_t);
+
+uint32_t computeChecksum(const char *data, size_t length) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data, length);
+    return crc.checksum();
+}
+
+bool writeFully(int fileDescriptor, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = ::write(fileDescriptor, data, length);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+}
+
+WriteAheadLog::WriteAheadLog(const string &directoryName):
+        filePath(directoryName + "/" + fileName), lastAppendedSequenceNumber(0),
+        lastFlushedSequenceNumber(0), lastAppliedSequenceNumber(0), hasDamagedTail(false),
+        sizeInBytes(0), isFlushing(false) {
+    this->fileDescriptor = ::open(this->filePath.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (this->fileDescriptor < 0) {
+        Logger::error("Cannot open the write-ahead log %s: %s", this->filePath.c_str(), strerror(errno));
+        return;
+    }
+    struct stat fileStat;
+    if (fstat(this->fileDescriptor, &fileStat) == 0)
+        this->sizeInBytes = fileStat.st_size;
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (this->isOpen()) {
+        waitUntilDurable(this->lastAppendedSequenceNumber);
+        ::close(this->fileDescriptor);
+    }
+}
+
+uint64_t WriteAheadLog::append(const vector<Json::Value> &entries) {
+    Json::FastWriter writer;
+    string frames;
+    for (unsigned i = 0; i < entries.size(); ++i) {
+        string payload = writer.write(entries[i]);
+        uint32_t header[2];
+        header[0] = payload.size();
+        header[1] = computeChecksum(payload.data(), payload.size());
+        frames.append((const char *) header, frameHeaderSize);
+        frames.append(payload);
+    }
+
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    this->pendingFrames.append(frames);
+    this->lastAppendedSequenceNumber += entries.size();
+    return this->lastAppendedSequenceNumber;
+}
+
+bool WriteAheadLog::waitUntilDurable(uint64_t sequenceNumber) {
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    while (this->lastFlushedSequenceNumber < sequenceNumber) {
+        if (this->isFlushing) {
+            // another request is writing; its fdatasync() may cover our entries too
+            this->flushFinished.wait(lock);
+            continue;
+        }
+        // this request writes all the pending frames, including those of the requests waiting for it
+        this->isFlushing = true;
+        string frames;
+        frames.swap(this->pendingFrames);
+        uint64_t firstSequenceNumber = this->lastFlushedSequenceNumber + 1;
+        uint64_t flushedSequenceNumber = this->lastAppendedSequenceNumber;
+        uint64_t lastCompleteSize = this->sizeInBytes;
+        bool canWrite = this->isOpen() && !this->hasDamagedTail;
+        lock.unlock();
+
+        bool written = canWrite && writeFully(this->fileDescriptor, frames.data(), frames.size())
+                && fdatasync(this->fileDescriptor) == 0;
+        bool damaged = false;
+        if (!written && canWrite) {
+            Logger::error("Cannot write the write-ahead log %s: %s", this->filePath.c_str(), strerror(errno));
+            // a torn frame would end the log on replay and drop the frames written after it
+            if (ftruncate(this->fileDescriptor, lastCompleteSize) != 0) {
+                Logger::error("Cannot truncate the write-ahead log %s: %s", this->filePath.c_str(), strerror(errno));
+                damaged = true;
+            }
+        }
+
+        lock.lock();
+        this->isFlushing = false;
+        if (written) {
+            this->sizeInBytes += frames.size();
+        } else {
+            // the requests of the batch report the failure and do not apply their changes
+            this->failedBatches.push_back(make_pair(firstSequenceNumber, flushedSequenceNumber));
+            this->hasDamagedTail = this->hasDamagedTail || damaged;
+        }
+        this->lastFlushedSequenceNumber = flushedSequenceNumber;
+        this->flushFinished.notify_all();
+    }
+    for (unsigned i = 0; i < this->failedBatches.size(); ++i) {
+        if (this->failedBatches[i].first <= sequenceNumber && sequenceNumber <= this->failedBatches[i].second)
+            return false;
+    }
+    return true;
+}
+
+void WriteAheadLog::waitForTurnToApply(uint64_t firstSequenceNumber) {
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    while (this->lastAppliedSequenceNumber + 1 < firstSequenceNumber)
+        this->applyFinished.wait(lock);
+}
+
+void WriteAheadLog::finishApplying(uint64_t lastSequenceNumber) {
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    this->lastAppliedSequenceNumber = lastSequenceNumber;
+    this->applyFinished.notify_all();
+}
+
+unsigned WriteAheadLog::replay(const boost::function<void (const Json::Value &)> &applyEntry) {
+    if (!this->isOpen())
+        return 0;
+
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    off_t fileSize = lseek(this->fileDescriptor, 0, SEEK_END);
+    string content(fileSize, '\0');
+    off_t readBytes = 0;
+    while (readBytes < fileSize) {
+        ssize_t count = pread(this->fileDescriptor, &content[readBytes], fileSize - readBytes, readBytes);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        readBytes += count;
+    }
+
+    unsigned numberOfEntries = 0;
+    size_t offset = 0;
+    Json::Reader reader;
+    while (offset + frameHeaderSize <= (size_t) readBytes) {
+        uint32_t header[2];
+        memcpy(header, content.data() + offset, frameHeaderSize);
+        if (offset + frameHeaderSize + header[0] > (size_t) readBytes
+                || computeChecksum(content.data() + offset + frameHeaderSize, header[0]) != header[1]) {
+            break;
+        }
+        Json::Value entry;
+        const char *payload = content.data() + offset + frameHeaderSize;
+        if (!reader.parse(payload, payload + header[0], entry, false))
+            break;
+        applyEntry(entry);
+        ++numberOfEntries;
+        offset += frameHeaderSize + header[0];
+    }
+
+    if (offset < (size_t) fileSize) {
+        Logger::warn("The write-ahead log %s has a damaged tail of %d bytes, which is removed.",
+                this->filePath.c_str(), (int) (fileSize - offset));
+        if (ftruncate(this->fileDescriptor, offset) != 0)
+            Logger::error("Cannot truncate the write-ahead log %s: %s", this->filePath.c_str(), strerror(errno));
+    }
+    this->sizeInBytes = offset;
+    return numberOfEntries;
+}
+
+void WriteAheadLog::truncate() {
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    // no request is logging, but the last one may still be flushing
+    while (this->isFlushing)
+        this->flushFinished.wait(lock);
+    this->pendingFrames.clear();
+    this->lastFlushedSequenceNumber = this->lastAppendedSequenceNumber;
+    this->failedBatches.clear();
+    if (this->isOpen() && (ftruncate(this->fileDescriptor, 0) != 0 || fdatasync(this->fileDescriptor) != 0)) {
+        Logger::error("Cannot truncate the write-ahead log %s: %s", this->filePath.c_str(), strerror(errno));
+        return;
+    }
+    this->hasDamagedTail = false;
+    this->sizeInBytes = 0;
+}
+
+uint64_t WriteAheadLog::getSizeInBytes() {
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    return this->sizeInBytes + this->pendingFrames.size();
+}
+
+WriteAheadLogScope::WriteAheadLogScope(WriteAheadLog *writeAheadLog):
+        writeAheadLog(writeAheadLog), lastSequenceNumber(0) {
+    if (writeAheadLog != NULL) {
+        boost::shared_lock<boost::shared_mutex> lock(writeAheadLog->getCheckpointMutex());
+        this->checkpointLock.swap(lock);
+    }
+}
+
+WriteAheadLogScope::~WriteAheadLogScope() {
+    if (this->lastSequenceNumber != 0)
+        this->writeAheadLog->finishApplying(this->lastSequenceNumber);
+}
+
+void WriteAheadLogScope::append(const Json::Value &entry) {
+    if (this->writeAheadLog != NULL)
+        this->entries.push_back(entry);
+}
+
+bool WriteAheadLogScope::commit() {
+    if (this->writeAheadLog == NULL || this->entries.empty())
+        return true;
+    uint64_t lastSequenceNumber = this->writeAheadLog->append(this->entries);
+    uint64_t firstSequenceNumber = lastSequenceNumber - this->entries.size() + 1;
+    this->entries.clear();
+    bool durable = this->writeAheadLog->waitUntilDurable(lastSequenceNumber);
+    this->writeAheadLog->waitForTurnToApply(firstSequenceNumber);
+    if (!durable) {
+        this->writeAheadLog->finishApplying(lastSequenceNumber);
+        return false;
+    }
+    this->lastSequenceNumber = lastSequenceNumber;
+    return true;
+}
+
+}
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _WRITEAHEADLOG_H_
+#define _WRITEAHEADLOG_H_
+
+#include "json/value.h"
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace srch2
+{
+namespace httpwrapper
+{
+
+/*
+ * An append-only log of the write requests of a core (record inserts, updates and deletes, and
+ * record and attribute ACL changes) that were applied after the last save of its indexes.
+ * The entries are built and applied by IndexWriteUtil.
+ * On startup the entries are replayed on top of the loaded indexes, and every save of the
+ * indexes (checkpoint) empties the log.
+ *
+ * Each entry is a JSON object written as a frame:
+ *     [uint32 length of the payload][uint32 CRC-32 of the payload][payload]
+ * A frame that is cut or corrupted by a crash ends the log and is removed when the log is read.
+ *
+ * The entries are buffered by append() and written by waitUntilDurable(). Concurrent requests that
+ * wait for their entries are served by a single write and fdatasync() (group commit). If the write
+ * fails, every request of the batch is told so and the file is cut back to its last complete frame.
+ *
+ * A request applies its changes only after its entries are on disk, and in the order of its entries
+ * in the log (waitForTurnToApply() and finishApplying()), so that the log replays them in that order.
+ */
+class WriteAheadLog
+{
+public:
+    static const char *const fileName;
+
+    explicit WriteAheadLog(const std::string &directoryName);
+    ~WriteAheadLog();
+
+    bool isOpen() const {
+        return this->fileDescriptor >= 0;
+    }
+
+    // Buffers the entries of a request as consecutive frames and returns the sequence number of the last one.
+    uint64_t append(const std::vector<Json::Value> &entries);
+
+    // Returns when the entries up to sequenceNumber are written. Returns false if the write of the
+    // entry sequenceNumber failed.
+    bool waitUntilDurable(uint64_t sequenceNumber);
+
+    // Returns when the changes of the entries before firstSequenceNumber are applied.
+    void waitForTurnToApply(uint64_t firstSequenceNumber);
+
+    // Called after the changes of the entries up to lastSequenceNumber are applied (or dropped).
+    void finishApplying(uint64_t lastSequenceNumber);
+
+    // Calls the function on every entry of the log file in order and returns the number of entries.
+    unsigned replay(const boost::function<void (const Json::Value &)> &applyEntry);
+
+    // Empties the log after the indexes are saved. The caller holds the checkpoint lock exclusively.
+    void truncate();
+
+    uint64_t getSizeInBytes();
+
+    // Shared by the write requests while they log and apply their changes, and taken exclusively by
+    // a checkpoint so that it never drops an entry whose change is not saved yet.
+    boost::shared_mutex &getCheckpointMutex() {
+        return this->checkpointMutex;
+    }
+
+private:
+    std::string filePath;
+    int fileDescriptor;
+
+    boost::shared_mutex checkpointMutex;
+
+    boost::mutex mutex;
+    boost::condition_variable flushFinished;
+    boost::condition_variable applyFinished;
+    // frames appended but not written yet
+    std::string pendingFrames;
+    uint64_t lastAppendedSequenceNumber;
+    // the entries up to this one were written or failed
+    uint64_t lastFlushedSequenceNumber;
+    uint64_t lastAppliedSequenceNumber;
+    // the first and last sequence numbers of the batches whose write failed since the last truncate()
+    std::vector<std::pair<uint64_t, uint64_t> > failedBatches;
+    // set when a failed write could not be cut off the file, so that no frame is written after it
+    bool hasDamagedTail;
+    uint64_t sizeInBytes;
+    bool isFlushing;
+
+    // not copyable
+    WriteAheadLog(const WriteAheadLog &);
+    WriteAheadLog &operator=(const WriteAheadLog &);
+};
+
+/*
+ * Held by a write request while it logs and applies its changes. It does nothing if the log is NULL.
+ *
+ *    WriteAheadLogScope walScope(server->writeAheadLog);
+ *    walScope.append(IndexWriteUtil::_insertLogEntry(doc));
+ *    if (!walScope.commit())
+ *        ... reject the request ...
+ *    ... apply the insert ...
+ *
+ * commit() writes the entries and waits for the requests logged before this one to apply their
+ * changes, and the destructor lets the requests logged after it apply theirs.
+ */
+class WriteAheadLogScope
+{
+public:
+    explicit WriteAheadLogScope(WriteAheadLog *writeAheadLog);
+    ~WriteAheadLogScope();
+
+    void append(const Json::Value &entry);
+
+    // Returns true when the entries of this request are on disk and it is its turn to apply its changes.
+    // Returns false if the entries could not be written, in which case the changes must not be applied.
+    bool commit();
+
+private:
+    WriteAheadLog *writeAheadLog;
+    boost::shared_lock<boost::shared_mutex> checkpointLock;
+    std::vector<Json::Value> entries;
+    uint64_t lastSequenceNumber;
+};
+
+}
+}
+
+#endif // _WRITEAHEADLOG_H_
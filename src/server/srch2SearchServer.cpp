@@ -152,6 +152,15 @@ void* heartBeatHandler(void *arg){
     return NULL;
 }
 
+// Lets the heart-beat thread notice there is one activity. The flag is only written by the first
+// request after the heart-beat thread cleared it, so that the other requests only read the cache line
+// instead of taking it away from the other cores.
+static inline void notifyHeartBeat(){
+    if (!has_one_pulse){
+        has_one_pulse = true;
+    }
+}
+
 
 // These are global variables that store host and port information for srch2 engine
 unsigned short globalDefaultPort;
@@ -408,8 +417,7 @@ static void cb_single_core_operator_route(evhttp_request *req, void *arg){
     evhttp_add_header(req->output_headers, "Content-Type",
             "application/json; charset=UTF-8");
 
-    // set has_one_pulse to true to let the heart-beat thread notice there is one activity.
-    has_one_pulse = true; 
+    notifyHeartBeat();
 
     if (checkOperationPermission(req, srch2Server, cbArgs.portType) == false) {
         return;
@@ -496,8 +504,7 @@ static void cb_all_core_operator_route(evhttp_request *req, void *arg){
     evhttp_add_header(req->output_headers, "Content-Type",
             "application/json; charset=UTF-8");
 
-    // set has_one_pulse to true to let the heart-beat thread notice there is one activity.
-    has_one_pulse = true;
+    notifyHeartBeat();
 
     try{
         switch (cbArgs.portType){
@@ -598,7 +605,7 @@ void graceful_exit(CoreNameServerMap_t &coreNameServerMap, vector<struct event_b
         ,PortSocketMap_t &globalPortSocketMap, ConfigManager *serverConf, CbArgsVector_t &cbArgsVector){
 
     for (CoreNameServerMap_t::iterator iterator = coreNameServerMap.begin(); iterator != coreNameServerMap.end(); iterator++) {
-        iterator->second->indexer->save();
+        iterator->second->saveIndexes();
 
         //Call the save function implemented by each database connector.
         DataConnectorThread::saveConnectorTimestamps();
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "JsonResponseWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace srch2 {
+namespace httpwrapper {
+
+JsonResponseWriter::JsonResponseWriter(evbuffer *buffer) {
+    this->buffer = buffer;
+    this->afterKey = false;
+}
+
+void JsonResponseWriter::beginValue() {
+    if (this->afterKey) {
+        // key() has written the separator
+        this->afterKey = false;
+        return;
+    }
+    if (this->hasMembers.empty()) {
+        return;
+    }
+    if (this->hasMembers.back()) {
+        evbuffer_add(this->buffer, ",", 1);
+    } else {
+        this->hasMembers.back() = true;
+    }
+}
+
+void JsonResponseWriter::beginObject() {
+    beginValue();
+    evbuffer_add(this->buffer, "{", 1);
+    this->hasMembers.push_back(false);
+}
+
+void JsonResponseWriter::endObject() {
+    this->hasMembers.pop_back();
+    evbuffer_add(this->buffer, "}", 1);
+}
+
+void JsonResponseWriter::beginArray() {
+    beginValue();
+    evbuffer_add(this->buffer, "[", 1);
+    this->hasMembers.push_back(false);
+}
+
+void JsonResponseWriter::endArray() {
+    this->hasMembers.pop_back();
+    evbuffer_add(this->buffer, "]", 1);
+}
+
+void JsonResponseWriter::key(const char *name) {
+    beginValue();
+    appendQuoted(name, strlen(name));
+    evbuffer_add(this->buffer, ":", 1);
+    this->afterKey = true;
+}
+
+void JsonResponseWriter::key(const std::string &name) {
+    beginValue();
+    appendQuoted(name.c_str(), name.size());
+    evbuffer_add(this->buffer, ":", 1);
+    this->afterKey = true;
+}
+
+void JsonResponseWriter::value(int value) {
+    beginValue();
+    evbuffer_add_printf(this->buffer, "%d", value);
+}
+
+void JsonResponseWriter::value(unsigned value) {
+    beginValue();
+    evbuffer_add_printf(this->buffer, "%u", value);
+}
+
+// the format of Json::valueToString(double): 17 significant digits with the trailing zeros
+// of the fraction removed, but one
+void JsonResponseWriter::value(double value) {
+    beginValue();
+    char formatted[32];
+    int length = snprintf(formatted, sizeof(formatted), "%#.16g", value);
+    if (length > 0 && formatted[length - 1] == '0') {
+        int lastNonZero = length - 1;
+        while (lastNonZero > 0 && formatted[lastNonZero] == '0') {
+            --lastNonZero;
+        }
+        int i = lastNonZero;
+        while (i >= 0 && formatted[i] >= '0' && formatted[i] <= '9') {
+            --i;
+        }
+        if (i >= 0 && formatted[i] == '.') {
+            length = lastNonZero + 2;
+        }
+    }
+    evbuffer_add(this->buffer, formatted, length);
+}
+
+void JsonResponseWriter::value(bool value) {
+    beginValue();
+    if (value) {
+        evbuffer_add(this->buffer, "true", 4);
+    } else {
+        evbuffer_add(this->buffer, "false", 5);
+    }
+}
+
+void JsonResponseWriter::value(const char *value) {
+    beginValue();
+    appendQuoted(value, strlen(value));
+}
+
+void JsonResponseWriter::value(const std::string &value) {
+    beginValue();
+    // Json::Value stores C strings, so the DOM writers stop at the first NUL as well
+    appendQuoted(value.c_str(), strlen(value.c_str()));
+}
+
+void JsonResponseWriter::rawValue(const char *json, size_t length) {
+    beginValue();
+    evbuffer_add(this->buffer, json, length);
+}
+
+void JsonResponseWriter::rawValue(const std::string &json) {
+    rawValue(json.data(), json.size());
+}
+
+// Escapes the characters Json::valueToQuotedString escapes. The runs of characters which need no
+// escaping are added with one call.
+void JsonResponseWriter::appendQuoted(const char *value, size_t length) {
+    evbuffer_add(this->buffer, "\"", 1);
+    size_t runStart = 0;
+    for (size_t i = 0; i < length; ++i) {
+        const char c = value[i];
+        const char *escaped = NULL;
+        switch (c) {
+        case '"':
+            escaped = "\\\"";
+            break;
+        case '\\':
+            escaped = "\\\\";
+            break;
+        case '\b':
+            escaped = "\\b";
+            break;
+        case '\f':
+            escaped = "\\f";
+            break;
+        case '\n':
+            escaped = "\\n";
+            break;
+        case '\r':
+            escaped = "\\r";
+            break;
+        case '\t':
+            escaped = "\\t";
+            break;
+        default:
+            if (c > 0 && c <= 0x1F) {
+                if (i > runStart) {
+                    evbuffer_add(this->buffer, value + runStart, i - runStart);
+                }
+                evbuffer_add_printf(this->buffer, "\\u%04X", (int) c);
+                runStart = i + 1;
+            }
+            continue;
+        }
+        if (i > runStart) {
+            evbuffer_add(this->buffer, value + runStart, i - runStart);
+        }
+        evbuffer_add(this->buffer, escaped, 2);
+        runStart = i + 1;
+    }
+    if (length > runStart) {
+        evbuffer_add(this->buffer, value + runStart, length - runStart);
+    }
+    evbuffer_add(this->buffer, "\"", 1);
+}
+
+}
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __WRAPPER_UTIL_JSONRESPONSEWRITER_H__
+#define __WRAPPER_UTIL_JSONRESPONSEWRITER_H__
+
+#include <string>
+#include <vector>
+#include <event2/buffer.h>
+
+namespace srch2 {
+namespace httpwrapper {
+
+/*
+ *  Writes a JSON document directly into the evbuffer of an HTTP response, so that large
+ *  responses are not built as a Json::Value tree and serialized into a string first.
+ *
+ *  The caller opens and closes objects and arrays and names the members of objects with key().
+ *  The writer adds the separators. Numbers and strings are formatted like Json::FastWriter does,
+ *  and rawValue() attaches an already encoded value, e.g., a stored record, without parsing it.
+ *
+ *  Example:
+ *      writer.beginObject();
+ *      writer.key("results_found");
+ *      writer.value(10u);
+ *      writer.key("record");
+ *      writer.rawValue(recordJson);
+ *      writer.endObject();
+ */
+class JsonResponseWriter {
+public:
+    explicit JsonResponseWriter(evbuffer *buffer);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    // the name of the next member of the current object
+    void key(const char *name);
+    void key(const std::string &name);
+
+    void value(int value);
+    void value(unsigned value);
+    void value(double value);
+    void value(bool value);
+    void value(const char *value);
+    void value(const std::string &value);
+    // appends an encoded JSON value as it is
+    void rawValue(const char *json, size_t length);
+    void rawValue(const std::string &json);
+
+    evbuffer *getBuffer() const {
+        return this->buffer;
+    }
+
+private:
+    // adds the separator before a value and marks the current object or array non-empty
+    void beginValue();
+    void appendQuoted(const char *value, size_t length);
+
+    evbuffer *buffer;
+    // one entry for each open object or array, true once it has a member
+    std::vector<bool> hasMembers;
+    bool afterKey;
+};
+
+}
+}
+
+#endif // __WRAPPER_UTIL_JSONRESPONSEWRITER_H__
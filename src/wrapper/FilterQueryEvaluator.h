@@ -27,7 +27,9 @@
 #ifndef __WRAPPER_FILTERQUERYEVALUATOR_H__
 #define __WRAPPER_FILTERQUERYEVALUATOR_H__
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <map>
 #include <vector>
@@ -45,6 +47,7 @@
 #include "util/Assert.h"
 #include "util/DateAndTimeHandler.h"
 #include "operation/AttributeAccessControl.h"
+#include "index/DocValues.h"
 
 using namespace std;
 using srch2::instantsearch::TypedValue;
@@ -70,6 +73,12 @@ public:
     virtual bool evaluate(
             std::map<std::string, TypedValue> & nonSearchableAttributeValues)= 0;
 
+    // see RefiningAttributeExpressionEvaluator::evaluateBatch()
+    virtual bool evaluateBatch(const DocValuesReadView & docValues,
+            const unsigned * recordIds, std::vector<unsigned> & selection) {
+        return false;
+    }
+
 	virtual string getUniqueStringForCaching() = 0;
     virtual ~QueryExpression() {
     }
@@ -90,6 +99,7 @@ public:
     RangeQueryExpression(std::string field,
             std::vector<std::pair<MessageType, string> > *messages) {
         this->attributeName = field;
+        this->attributeId = -1;
         this->negative = false;
         this->messages = messages;
     }
@@ -133,7 +143,7 @@ public:
     bool validate(const Schema & schema, const string& aclRoleValue,
     		const AttributeAccessControl& attributeAcl, bool attrAclOn) {
         //1. Check to make sure attributeName is a non-searchable attribute
-        int attributeId = schema.getRefiningAttributeId(attributeName);
+        attributeId = schema.getRefiningAttributeId(attributeName);
         if (attributeId < 0)
             return false;
 
@@ -211,6 +221,30 @@ public:
         return result;
     }
 
+    /*
+     * The same check as evaluate() on the column of the attribute, for a batch of records.
+     */
+    bool evaluateBatch(const DocValuesReadView & docValues,
+            const unsigned * recordIds, std::vector<unsigned> & selection) {
+        if (attributeId < 0)
+            return false;
+        const DocValuesColumnReadView * column = docValues.getColumn(attributeId);
+        if (column == NULL)
+            return false;
+        TypedValue lowerBound;
+        TypedValue upperBound;
+        if (attributeValueLower.compare("*") != 0) {
+            lowerBound.setTypedValue(column->getType(), attributeValueLower);
+        }
+        if (attributeValueUpper.compare("*") != 0) {
+            upperBound.setTypedValue(column->getType(), attributeValueUpper);
+        }
+        return column->selectInRange(
+                attributeValueLower.compare("*") != 0 ? &lowerBound : NULL,
+                attributeValueUpper.compare("*") != 0 ? &upperBound : NULL,
+                negative, recordIds, selection);
+    }
+
     ~RangeQueryExpression() {
     }
 
@@ -226,6 +260,8 @@ public:
 private:
     // the name of the attribute which is checked against the range
     std::string attributeName;
+    // the refining attribute id of attributeName, set by validate()
+    int attributeId;
     // the lower bound value
     string attributeValueLower;
     // the upper bound value
@@ -263,6 +299,7 @@ public:
         this->negative = false;
         this->operation = srch2::instantsearch::EQUALS;
         this->attributeName = field;
+        this->attributeId = -1;
         this->messages = messages;
     }
 
@@ -297,7 +334,7 @@ public:
     bool validate(const Schema & schema, const string& aclRoleValue,
     		const AttributeAccessControl& attributeAcl, bool attrAclOn) {
         //1. Check to make sure attributeName is a non-searchable attribute
-        int attributeId = schema.getRefiningAttributeId(attributeName);
+        attributeId = schema.getRefiningAttributeId(attributeName);
         if (attributeId < 0)
             return false;
 
@@ -327,26 +364,11 @@ public:
     }
 
     bool evaluate(std::map<std::string, TypedValue> & nonSearchableAttributeValues) {
-
-        // Compatible with SOLR : * means anything not empty.
-        // Because the actual value can contain * if range bound is * we change it
-        // to empty string and negate the variable negative.
-        if (attributeValue.compare("*") == 0) {
-            attributeValue = "";
-            negative = !negative;
-        }
         // first find the value coming from the record
         TypedValue value = nonSearchableAttributeValues[this->attributeName];
 
-        if (attributeValue.compare("") == 0
-                && (value.getType() == srch2is::ATTRIBUTE_TYPE_INT
-                        || value.getType() == srch2is::ATTRIBUTE_TYPE_LONG
-                        || value.getType() == srch2is::ATTRIBUTE_TYPE_FLOAT
-                        || value.getType() == srch2is::ATTRIBUTE_TYPE_DOUBLE)) {
-            attributeValue = value.minimumValue().toString() + "";
-        }
         TypedValue valueToCheck;
-        valueToCheck.setTypedValue(value.getType(), attributeValue);
+        getValueToCheck(value.getType(), valueToCheck);
 
         bool result = (value == valueToCheck);
         if (!negative) { // no '-' in the beginning of the field
@@ -356,6 +378,22 @@ public:
         }
     }
 
+    /*
+     * The same check as evaluate() on the column of the attribute, for a batch of records.
+     * A value is equal to valueToCheck iff it is in the range [valueToCheck, valueToCheck].
+     */
+    bool evaluateBatch(const DocValuesReadView & docValues,
+            const unsigned * recordIds, std::vector<unsigned> & selection) {
+        if (attributeId < 0)
+            return false;
+        const DocValuesColumnReadView * column = docValues.getColumn(attributeId);
+        if (column == NULL)
+            return false;
+        TypedValue valueToCheck;
+        getValueToCheck(column->getType(), valueToCheck);
+        return column->selectInRange(&valueToCheck, &valueToCheck, negative, recordIds, selection);
+    }
+
     ~EqualityQueryExpression() {
     }
 
@@ -370,9 +408,31 @@ public:
 
 private:
     std::string attributeName;
+    // the refining attribute id of attributeName, set by validate()
+    int attributeId;
     string attributeValue;
     AttributeCriterionOperation operation;
     bool negative;
+
+    void getValueToCheck(FilterType type, TypedValue & valueToCheck) {
+        // Compatible with SOLR : * means anything not empty.
+        // Because the actual value can contain * if range bound is * we change it
+        // to empty string and negate the variable negative.
+        if (attributeValue.compare("*") == 0) {
+            attributeValue = "";
+            negative = !negative;
+        }
+        if (attributeValue.compare("") == 0
+                && (type == srch2is::ATTRIBUTE_TYPE_INT
+                        || type == srch2is::ATTRIBUTE_TYPE_LONG
+                        || type == srch2is::ATTRIBUTE_TYPE_FLOAT
+                        || type == srch2is::ATTRIBUTE_TYPE_DOUBLE)) {
+            TypedValue value;
+            value.setTypedValue(type, attributeValue);
+            attributeValue = value.minimumValue().toString() + "";
+        }
+        valueToCheck.setTypedValue(type, attributeValue);
+    }
 };
 
 // this class gets a string which is an expression of nuon-searchable attribute names,it evluates the expression
@@ -533,6 +593,54 @@ public:
         return false;
     }
 
+    /*
+     * Evaluates the terms on the doc-values columns of a batch of records. With AND each term narrows
+     * the selection of the previous one; with OR each term selects from the whole batch and the
+     * selections are merged. Complex expressions and multi-valued attributes have no column, so a
+     * filter query with one of them is evaluated record by record.
+     */
+    bool evaluateBatch(const DocValuesReadView & docValues,
+            const unsigned * recordIds, std::vector<unsigned> & selection) {
+        switch (this->termFQBooleanOperator) {
+        case srch2::instantsearch::BooleanOperatorAND:
+            for (std::vector<QueryExpression *>::iterator criterion =
+                    expressions.begin(); criterion != expressions.end();
+                    ++criterion) {
+                if (selection.empty()) {
+                    return true;
+                }
+                if (!(*criterion)->evaluateBatch(docValues, recordIds, selection)) {
+                    return false;
+                }
+            }
+            return true;
+        case srch2::instantsearch::BooleanOperatorOR: {
+            std::vector<unsigned> passed;
+            std::vector<unsigned> criterionSelection;
+            std::vector<unsigned> mergedSelection;
+            for (std::vector<QueryExpression *>::iterator criterion =
+                    expressions.begin(); criterion != expressions.end();
+                    ++criterion) {
+                criterionSelection = selection;
+                if (!(*criterion)->evaluateBatch(docValues, recordIds, criterionSelection)) {
+                    return false;
+                }
+                mergedSelection.clear();
+                std::set_union(passed.begin(), passed.end(),
+                        criterionSelection.begin(), criterionSelection.end(),
+                        std::back_inserter(mergedSelection));
+                passed.swap(mergedSelection);
+            }
+            selection.swap(passed);
+            return true;
+        }
+        default:
+            break;
+        }
+        ASSERT(false);
+        return false;
+    }
+
     bool validate(const Schema & schema, const string& aclRole,
     		const AttributeAccessControl& attributeAcl, bool attrAclOn) {
         for (std::vector<QueryExpression *>::iterator criterion = expressions
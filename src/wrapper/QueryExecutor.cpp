@@ -39,8 +39,9 @@ namespace httpwrapper {
 // we need config manager to pass estimatedNumberOfResultsThresholdGetAll & numberOfEstimatedResultsToFindGetAll
 // in the case of getAllResults.
 QueryExecutor::QueryExecutor(LogicalPlan & queryPlan,
-        QueryResultFactory * resultsFactory, Srch2Server *server, const CoreInfo_t * config) :
-        queryPlan(queryPlan), configuration(config) {
+        QueryResultFactory * resultsFactory, Srch2Server *server, const CoreInfo_t * config,
+        const volatile bool *cancelled) :
+        queryPlan(queryPlan), configuration(config), cancelled(cancelled) {
     this->queryResultFactory = resultsFactory;
     this->server = server;
 }
@@ -69,6 +70,7 @@ void QueryExecutor::execute(QueryResults * finalResults) {
     QueryEvaluatorRuntimeParametersContainer runTimeParameters(configuration->getKeywordPopularityThreshold(),
     		configuration->getGetAllResultsNumberOfResultsThreshold() ,
     		configuration->getGetAllResultsNumberOfResultsToFindInEstimationMode());
+    runTimeParameters.cancelled = this->cancelled;
     this->queryEvaluator = new srch2is::QueryEvaluator(server->indexer , &runTimeParameters );
 
     //do the search
@@ -46,7 +46,9 @@ class QueryExecutor
 
 public:
 
-	QueryExecutor(LogicalPlan & queryPlan , QueryResultFactory * resultsFactory ,Srch2Server *server, const CoreInfo_t * configuration );
+	// the search stops as soon as *cancelled is set, if it is not NULL
+	QueryExecutor(LogicalPlan & queryPlan , QueryResultFactory * resultsFactory ,Srch2Server *server, const CoreInfo_t * configuration ,
+			const volatile bool *cancelled = NULL);
 
 	void execute(QueryResults * finalResults);
 	void executeKeywordSearch(QueryResults * finalResults);
@@ -59,6 +61,7 @@ private:
 	Srch2Server * server;
 	QueryEvaluator * queryEvaluator;
 	const CoreInfo_t * configuration;
+	const volatile bool *cancelled;
 };
 
 }
@@ -64,6 +64,8 @@ const char* const QueryParser::filterQueryParamName = "fq"; //solr
 const char* const QueryParser::queryFieldBoostParamName = "qf"; //solr
 const char* const QueryParser::isFuzzyParamName = "fuzzy"; //srch2
 const char* const QueryParser::docIdParamName = "docid"; //srch2
+const char* const QueryParser::mergeResultsParamName = "merge"; //srch2
+const char* const QueryParser::mergeResultsTopK = "topk"; //srch2
 
 // local parameter params
 const char* const QueryParser::lpKeyValDelimiter = "="; //solr
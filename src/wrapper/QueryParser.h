@@ -114,6 +114,8 @@ public:
     // returns the query string without local parameters, fuzzy modifier, and boost modifiers.
     string fetchCleanQueryString();
 private:
+    // /_all/search reads the paging, timeAllowed and merge parameters before a core parses the query
+    friend class HTTPRequestHandler;
 
     ParsedParameterContainer * container;
     const evkeyvalq & headers;
@@ -153,6 +155,8 @@ private:
     static const char* const queryFieldBoostParamName;//solr
     static const char* const isFuzzyParamName; //srch2
     static const char* const docIdParamName;
+    static const char* const mergeResultsParamName; //srch2, only read by /_all/search
+    static const char* const mergeResultsTopK; //srch2
 
     // local parameter params
     static const char* const lpKeyValDelimiter; //solr
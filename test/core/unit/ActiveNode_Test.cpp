@@ -375,6 +375,39 @@ void testPrefixActiveNodeSet()
     ASSERT(checkContainment(similarPrefixes, "cantee"));
     similarPrefixes.clear();
 
+    // case 7.1: a swap of two adjacent characters costs 1
+    prefixActiveNodeSet.reset(new PrefixActiveNodeSet(trie, 1, true));
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('c'); prefixActiveNodeSet = newPrefixActiveNodeSet;
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('n'); prefixActiveNodeSet = newPrefixActiveNodeSet;
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('a'); prefixActiveNodeSet = newPrefixActiveNodeSet;
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('c');
+
+    newPrefixActiveNodeSet->getComputedSimilarPrefixes(trie, similarPrefixes);
+    ASSERT(similarPrefixes.size() == 1);
+    ASSERT(checkContainment(similarPrefixes, "canc"));
+    similarPrefixes.clear();
+
+    // case 7.2: the same prefix computed from the frozen trie in one pass
+    boost::shared_ptr<TrieRootNodeAndFreeList> readView;
+    trie->getTrieRootNode_ReadView(readView);
+    vector<CharType> prefix = getCharTypeVector("cnac");
+    newPrefixActiveNodeSet = PrefixActiveNodeSet::computeActiveNodeSetFromFrozenTrie(prefix, 1, readView, true);
+    newPrefixActiveNodeSet->getComputedSimilarPrefixes(trie, similarPrefixes);
+    ASSERT(similarPrefixes.size() == 1);
+    ASSERT(checkContainment(similarPrefixes, "canc"));
+    similarPrefixes.clear();
+
+    // case 7.3: without swaps the same prefix is two edits away from "canc"
+    prefixActiveNodeSet.reset(new PrefixActiveNodeSet(trie, 1, false));
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('c'); prefixActiveNodeSet = newPrefixActiveNodeSet;
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('n'); prefixActiveNodeSet = newPrefixActiveNodeSet;
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('a'); prefixActiveNodeSet = newPrefixActiveNodeSet;
+    newPrefixActiveNodeSet = prefixActiveNodeSet->computeActiveNodeSetIncrementally('c');
+
+    newPrefixActiveNodeSet->getComputedSimilarPrefixes(trie, similarPrefixes);
+    ASSERT(similarPrefixes.empty());
+    similarPrefixes.clear();
+
     // finally, we can delete the trie
     delete trie;
     /**/
@@ -26,10 +26,16 @@
  */
 
 #include "operation/CacheBase.h"
+#include "operation/CacheManager.h"
+#include "index/Trie.h"
 
 #include <instantsearch/GlobalCache.h>
 #include <assert.h>
 #include "util/Assert.h"
+#include <sstream>
+#include <set>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
 
 using namespace std;
 using namespace srch2::util;
@@ -66,6 +72,247 @@ void test1(srch2is::CacheContainer<CachedStruct> * cacheContainer){
 
 }
 
+string getKey(unsigned i){
+	ostringstream convert;
+	convert << i;
+	return convert.str();
+}
+
+// CLOCK replacement: an entry which is read after it is added survives the next eviction
+void test2(){
+	srch2is::CacheContainer<CachedStruct> * cacheContainer = new srch2is::CacheContainer<CachedStruct>(200);
+	ASSERT(cacheContainer->getNumberOfShards() == 1);
+
+	// find how many entries fit in the budget
+	unsigned capacity = 0;
+	while(true){
+		boost::shared_ptr<CachedStruct> ai(new CachedStruct(capacity));
+		string key = getKey(capacity);
+		cacheContainer->put(key , ai);
+		CacheStatistics statistics;
+		cacheContainer->getStatistics(statistics);
+		if(statistics.evictions > 0){
+			break;
+		}
+		capacity++;
+	}
+	ASSERT(capacity > 1);
+	cacheContainer->clear();
+
+	for(unsigned i = 0; i < capacity; i++){
+		boost::shared_ptr<CachedStruct> ai(new CachedStruct(i));
+		string key = getKey(i);
+		ASSERT(cacheContainer->put(key , ai));
+	}
+	boost::shared_ptr<CachedStruct> aiHit ;
+	string firstKey = getKey(0);
+	ASSERT(cacheContainer->get(firstKey , aiHit));
+
+	boost::shared_ptr<CachedStruct> ai(new CachedStruct(capacity));
+	string newKey = getKey(capacity);
+	ASSERT(cacheContainer->put(newKey , ai));
+	ASSERT(cacheContainer->checkCacheConsistency());
+	ASSERT(cacheContainer->get(firstKey , aiHit) && aiHit->a == 0);
+	string secondKey = getKey(1);
+	ASSERT(! cacheContainer->get(secondKey , aiHit));
+	ASSERT(cacheContainer->get(newKey , aiHit) && aiHit->a == (int)capacity);
+
+	CacheStatistics statistics;
+	cacheContainer->getStatistics(statistics);
+	ASSERT(statistics.hits == 3);
+	ASSERT(statistics.misses == 1);
+	ASSERT(statistics.numberOfEntries == capacity);
+	ASSERT(statistics.numberOfBytesUsed <= statistics.byteBudget);
+	delete cacheContainer;
+}
+
+void readAndWrite(srch2is::CacheContainer<CachedStruct> * cacheContainer, unsigned threadId){
+	for(unsigned i = 0; i < 20000; i++){
+		string key = getKey((i * 7 + threadId) % 5000);
+		boost::shared_ptr<CachedStruct> aiHit ;
+		if(cacheContainer->get(key , aiHit)){
+			ASSERT(getKey(aiHit->a) == key);
+		}else{
+			boost::shared_ptr<CachedStruct> ai(new CachedStruct((i * 7 + threadId) % 5000));
+			cacheContainer->put(key , ai);
+		}
+	}
+}
+
+// large caches are sharded, concurrent readers and writers keep every shard consistent
+void test3(){
+	srch2is::CacheContainer<CachedStruct> * cacheContainer = new srch2is::CacheContainer<CachedStruct>(134217728);
+	ASSERT(cacheContainer->getNumberOfShards() > 1);
+
+	boost::thread_group threads;
+	for(unsigned t = 0; t < 8; t++){
+		threads.create_thread(boost::bind(readAndWrite, cacheContainer, t));
+	}
+	threads.join_all();
+	ASSERT(cacheContainer->checkCacheConsistency());
+
+	CacheStatistics statistics;
+	cacheContainer->getStatistics(statistics);
+	ASSERT(statistics.hits + statistics.misses == 8 * 20000);
+	ASSERT(statistics.numberOfEntries == 5000);
+	ASSERT(statistics.evictions == 0);
+	ASSERT(statistics.byteBudget == 134217728);
+	delete cacheContainer;
+}
+
+typedef boost::shared_ptr<TrieRootNodeAndFreeList> TrieRootNodeSharedPtr;
+
+// the set of prefix computed keystroke by keystroke, ready to be cached
+boost::shared_ptr<PrefixActiveNodeSet> getActiveNodeSet(const TrieRootNodeSharedPtr &readView,
+		const string &prefix, unsigned editDistanceThreshold){
+	boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet(
+			new PrefixActiveNodeSet(readView, editDistanceThreshold, false));
+	for(unsigned i = 0; i < prefix.size(); i++){
+		activeNodeSet = activeNodeSet->computeActiveNodeSetIncrementally(prefix[i]);
+	}
+	activeNodeSet->prepareForIteration();
+	return activeNodeSet;
+}
+
+vector<CharType> getCharacters(const string &keyword){
+	vector<CharType> characters;
+	utf8StringToCharTypeVector(keyword, characters);
+	return characters;
+}
+
+// the (depth, edit distance) pairs of the active nodes, which do not depend on the read view
+multiset<pair<unsigned, unsigned> > getActiveNodeDepths(const boost::shared_ptr<PrefixActiveNodeSet> &activeNodeSet){
+	multiset<pair<unsigned, unsigned> > depths;
+	for(ActiveNodeSetIterator iter(activeNodeSet.get(), activeNodeSet->getEditDistanceThreshold()); !iter.isDone(); iter.next()){
+		const TrieNode *trieNode;
+		unsigned distance;
+		iter.getItem(trieNode, distance);
+		depths.insert(make_pair(trieNode->getDepth(), distance));
+	}
+	return depths;
+}
+
+// the active nodes cache finds the longest cached prefix of a query and checks the trie version
+void test4(){
+	Trie *trie = new Trie();
+	unsigned invertedIndexOffset = 0;
+	const char *keywords[] = {"can", "canada", "cancel", "cancer", "candy", "dog"};
+	for(unsigned i = 0; i < 6; i++){
+		trie->addKeyword(keywords[i], invertedIndexOffset);
+	}
+	trie->commit();
+	trie->finalCommit_finalizeHistogramInformation(NULL, NULL, 0);
+	TrieRootNodeSharedPtr readView;
+	trie->getTrieRootNode_ReadView(readView);
+
+	ActiveNodesCache *cache = new ActiveNodesCache(1048576);
+	boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet;
+	// single characters are never cached
+	activeNodeSet = getActiveNodeSet(readView, "c", 1);
+	ASSERT(cache->setPrefixActiveNodeSet(activeNodeSet) == 0);
+	activeNodeSet = getActiveNodeSet(readView, "ca", 1);
+	ASSERT(cache->setPrefixActiveNodeSet(activeNodeSet) == 1);
+	activeNodeSet = getActiveNodeSet(readView, "canc", 1);
+	ASSERT(cache->setPrefixActiveNodeSet(activeNodeSet) == 1);
+	ASSERT(cache->checkCacheConsistency());
+
+	boost::shared_ptr<PrefixActiveNodeSet> hit;
+	ASSERT(cache->findLongestPrefixActiveNodes(getCharacters("cancer"), 1, readView, hit) == 1);
+	ASSERT(hit->getPrefixLength() == 4);
+	ASSERT(cache->findLongestPrefixActiveNodes(getCharacters("cand"), 1, readView, hit) == 1);
+	ASSERT(hit->getPrefixLength() == 2);
+	ASSERT(cache->findLongestPrefixActiveNodes(getCharacters("cancer"), 0, readView, hit) == 0);
+	ASSERT(cache->findLongestPrefixActiveNodes(getCharacters("dog"), 1, readView, hit) == 0);
+
+	vector<unsigned long> hitDepths;
+	cache->getHitDepths(hitDepths);
+	ASSERT(hitDepths.size() == ActiveNodesCache::MAXIMUM_COUNTED_HIT_DEPTH + 1);
+	ASSERT(hitDepths[2] == 1 && hitDepths[4] == 1);
+
+	// a merge that adds no keyword keeps the trie version, the hit is moved to the new read view
+	trie->addKeyword_ThreadSafe("cancer", invertedIndexOffset);
+	trie->merge(NULL, NULL, 0, false);
+	TrieRootNodeSharedPtr sameVersionReadView;
+	trie->getTrieRootNode_ReadView(sameVersionReadView);
+	ASSERT(sameVersionReadView != readView);
+	ASSERT(sameVersionReadView->getVersion() == readView->getVersion());
+	ASSERT(cache->findLongestPrefixActiveNodes(getCharacters("cancer"), 1, sameVersionReadView, hit) == 1);
+	ASSERT(hit->getTrieRootNodeSharedPtr() == sameVersionReadView);
+	ASSERT(getActiveNodeDepths(hit) == getActiveNodeDepths(getActiveNodeSet(sameVersionReadView, "canc", 1)));
+	ASSERT(cache->getNumberOfRemappedHits() == 1);
+	ASSERT(cache->checkCacheConsistency());
+
+	// a new keyword changes the version, the cached sets cannot be used anymore
+	trie->addKeyword_ThreadSafe("canal", invertedIndexOffset);
+	trie->merge(NULL, NULL, 0, false);
+	TrieRootNodeSharedPtr newVersionReadView;
+	trie->getTrieRootNode_ReadView(newVersionReadView);
+	ASSERT(newVersionReadView->getVersion() != readView->getVersion());
+	ASSERT(cache->findLongestPrefixActiveNodes(getCharacters("cancer"), 1, newVersionReadView, hit) == 0);
+
+	CacheStatistics statistics;
+	cache->getStatistics(statistics);
+	ASSERT(statistics.hits == 3);
+	ASSERT(statistics.misses == 3);
+	delete cache;
+	delete trie;
+}
+
+// a small budget evicts sets and keeps the prefix trie consistent
+void test5(){
+	Trie *trie = new Trie();
+	unsigned invertedIndexOffset = 0;
+	for(unsigned i = 0; i < 500; i++){
+		trie->addKeyword("keyword" + getKey(i), invertedIndexOffset);
+	}
+	trie->commit();
+	trie->finalCommit_finalizeHistogramInformation(NULL, NULL, 0);
+	TrieRootNodeSharedPtr readView;
+	trie->getTrieRootNode_ReadView(readView);
+
+	ActiveNodesCache *cache = new ActiveNodesCache(16384);
+	for(unsigned i = 0; i < 500; i++){
+		string prefix = "keyword" + getKey(i);
+		boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet = getActiveNodeSet(readView, prefix, 1);
+		cache->setPrefixActiveNodeSet(activeNodeSet);
+		ASSERT(cache->checkCacheConsistency());
+	}
+	CacheStatistics statistics;
+	cache->getStatistics(statistics);
+	ASSERT(statistics.evictions > 0);
+	ASSERT(statistics.numberOfBytesUsed <= statistics.byteBudget);
+
+	cache->clear();
+	ASSERT(cache->checkCacheConsistency());
+	boost::shared_ptr<PrefixActiveNodeSet> hit;
+	ASSERT(cache->findLongestPrefixActiveNodes(getCharacters("keyword499"), 1, readView, hit) == 0);
+	delete cache;
+	delete trie;
+}
+
+// the snippets of a record are found with the same record, attribute and keywords and are cleared with the other caches
+void test6(){
+	CacheManager *cacheManager = new CacheManager(9 * 1024 * 1024);
+	SnippetCache *snippetCache = cacheManager->getSnippetCache();
+	string key = "3/1/5:apple,1,0;";
+	boost::shared_ptr<SnippetCacheEntry> entry(new SnippetCacheEntry());
+	entry->snippets.push_back("an <b>apple</b> pie");
+	snippetCache->setSnippets(key, entry);
+
+	boost::shared_ptr<SnippetCacheEntry> hit;
+	ASSERT(snippetCache->getSnippets(key, hit));
+	ASSERT(hit->snippets.size() == 1 && hit->snippets[0] == "an <b>apple</b> pie");
+	string otherAttributeKey = "3/2/5:apple,1,0;";
+	ASSERT(!snippetCache->getSnippets(otherAttributeKey, hit));
+	ASSERT(cacheManager->getCacheStatisticsString().find("\"snippets\":{\"hits\":\"1\",\"misses\":\"1\"") != string::npos);
+
+	// merges do not invalidate snippets since record ids are not reused
+	cacheManager->clearResults();
+	ASSERT(snippetCache->getSnippets(key, hit));
+	cacheManager->clear();
+	ASSERT(!snippetCache->getSnippets(key, hit));
+	delete cacheManager;
+}
 
 int main(int argc, char *argv[])
 {
@@ -73,6 +320,11 @@ int main(int argc, char *argv[])
 	srch2is::CacheContainer<CachedStruct> * cacheContainer = new srch2is::CacheContainer<CachedStruct>(200);
 
 	test1(cacheContainer);
+	test2();
+	test3();
+	test4();
+	test5();
+	test6();
 
     cout << "CacheContainer Unit Test: Passed\n";
 }
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "index/CompressedInvertedList.h"
+#include "index/InvertedIndex.h"
+#include "util/BlockPacking.h"
+#include "util/Assert.h"
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+
+using namespace std;
+using namespace srch2::instantsearch;
+using srch2::util::BlockPacking;
+
+// Packs a block for every bit width and checks that both decoders return the original values.
+void testBlockPacking()
+{
+    for (unsigned bitWidth = 0; bitWidth <= 32; ++bitWidth) {
+        unsigned base = rand() % 1000;
+        unsigned values[BlockPacking::BLOCK_SIZE];
+        for (unsigned i = 0; i < BlockPacking::BLOCK_SIZE; ++i) {
+            unsigned delta = bitWidth == 0 ? 0 : (unsigned) rand() * 2654435761u;
+            if (bitWidth < 32)
+                delta &= (1u << bitWidth) - 1;
+            values[i] = base + delta;
+        }
+        if (bitWidth > 0)
+            values[7] = base + (bitWidth == 32 ? ~0u : (1u << bitWidth) - 1); // largest value of the width
+
+        vector<unsigned> packed(BlockPacking::getNumberOfWords(bitWidth) + 1, 0xdeadbeef);
+        BlockPacking::pack(values, base, bitWidth, &packed[0]);
+        // pack() must not write after the block
+        ASSERT(packed.back() == 0xdeadbeef);
+
+        unsigned decoded[BlockPacking::BLOCK_SIZE];
+        BlockPacking::unpack(&packed[0], base, bitWidth, decoded);
+        for (unsigned i = 0; i < BlockPacking::BLOCK_SIZE; ++i)
+            ASSERT(decoded[i] == values[i]);
+        if (bitWidth > 0) {
+            BlockPacking::unpackScalar(&packed[0], base, bitWidth, decoded);
+            for (unsigned i = 0; i < BlockPacking::BLOCK_SIZE; ++i)
+                ASSERT(decoded[i] == values[i]);
+        }
+    }
+}
+
+// Builds lists around the block boundaries and checks the blocks and their skip data.
+void testCompressedInvertedList()
+{
+    const unsigned sizes[] = { 0, 1, 127, 128, 129, 256, 1000 };
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(unsigned); ++s) {
+        unsigned size = sizes[s];
+        vector<unsigned> recordIds(size);
+        vector<float> scores(size);
+        CompressedInvertedList list;
+        for (unsigned i = 0; i < size; ++i) {
+            recordIds[i] = rand() % 100000;
+            scores[i] = (float) (size - i) + (rand() % 100) / 100.0; // roughly descending like a real list
+            list.append(recordIds[i], scores[i]);
+        }
+        list.finalize();
+        ASSERT(list.size() == size);
+        ASSERT(list.getNumberOfBlocks() == (size + CompressedInvertedList::BLOCK_SIZE - 1) / CompressedInvertedList::BLOCK_SIZE);
+
+        unsigned decoded[CompressedInvertedList::BLOCK_SIZE];
+        for (unsigned blockIndex = 0; blockIndex < list.getNumberOfBlocks(); ++blockIndex) {
+            unsigned first = blockIndex * CompressedInvertedList::BLOCK_SIZE;
+            unsigned blockSize = list.decodeBlock(blockIndex, decoded);
+            ASSERT(blockSize == list.getBlockSize(blockIndex));
+            unsigned maxRecordId = 0;
+            float maxScore = 0;
+            for (unsigned i = 0; i < blockSize; ++i) {
+                ASSERT(decoded[i] == recordIds[first + i]);
+                maxRecordId = max(maxRecordId, recordIds[first + i]);
+                maxScore = max(maxScore, scores[first + i]);
+            }
+            ASSERT(list.getBlockInfo(blockIndex).maxRecordId == maxRecordId);
+            ASSERT(list.getBlockInfo(blockIndex).maxScore == maxScore);
+        }
+
+        // a list over the same arrays, like one loaded from a snapshot, decodes the same way
+        CompressedInvertedList mappedList(list.size(), list.getBlocks(), list.getNumberOfBlocks(),
+                list.getPackedWords(), list.getNumberOfPackedWords());
+        for (unsigned blockIndex = 0; blockIndex < mappedList.getNumberOfBlocks(); ++blockIndex) {
+            unsigned blockSize = mappedList.decodeBlock(blockIndex, decoded);
+            for (unsigned i = 0; i < blockSize; ++i)
+                ASSERT(decoded[i] == recordIds[blockIndex * CompressedInvertedList::BLOCK_SIZE + i]);
+        }
+    }
+}
+
+// Cursors on a compressed list and on the uncompressed read view of the same list must agree.
+void testInvertedListCursor()
+{
+    const unsigned size = 300;
+    cowvector<unsigned> invList(size);
+    CompressedInvertedList *compressedList = new CompressedInvertedList();
+    for (unsigned i = 0; i < size; ++i) {
+        unsigned recordId = (i * 7919) % 1000;
+        invList.getWriteView()->push_back(recordId);
+        compressedList->append(recordId, (float) (size - i));
+    }
+    compressedList->finalize();
+    invList.commit();
+    shared_ptr<vectorview<unsigned> > readView;
+    invList.getReadView(readView);
+
+    boost::shared_ptr<const CompressedInvertedList> compressedListPointer(compressedList);
+    InvertedListCursor compressedCursor(compressedListPointer);
+    InvertedListCursor rawCursor(readView);
+    ASSERT(compressedCursor.isCompressed());
+    ASSERT(!rawCursor.isCompressed());
+    ASSERT(compressedCursor.size() == size && rawCursor.size() == size);
+
+    // sequential scan
+    unsigned numberOfElements = 0;
+    for (; !compressedCursor.isDone(); compressedCursor.next(), rawCursor.next()) {
+        ASSERT(!rawCursor.isDone());
+        ASSERT(compressedCursor.getRecordId() == rawCursor.getRecordId());
+        ++numberOfElements;
+    }
+    ASSERT(rawCursor.isDone());
+    ASSERT(numberOfElements == size);
+
+    // random access, e.g. cursor positions restored from the cache
+    for (unsigned i = 0; i < 100; ++i) {
+        unsigned position = rand() % size;
+        ASSERT(compressedCursor.getElement(position) == readView->getElement(position));
+    }
+
+    // skip data
+    compressedCursor.seek(5);
+    float maxScore;
+    unsigned maxRecordId;
+    ASSERT(compressedCursor.getBlockMaxScore(maxScore) && maxScore == (float) size);
+    ASSERT(compressedCursor.getBlockMaxRecordId(maxRecordId) && maxRecordId < 1000);
+    compressedCursor.skipToNextBlock();
+    ASSERT(compressedCursor.getPosition() == CompressedInvertedList::BLOCK_SIZE);
+    ASSERT(compressedCursor.getBlockMaxScore(maxScore) && maxScore == (float) (size - CompressedInvertedList::BLOCK_SIZE));
+    compressedCursor.skipToNextBlock();
+    compressedCursor.skipToNextBlock();
+    ASSERT(compressedCursor.isDone());
+    ASSERT(!compressedCursor.getBlockMaxScore(maxScore));
+    ASSERT(!rawCursor.getBlockMaxScore(maxScore));
+}
+
+// a container loaded from a snapshot only has its compressed list and decodes the raw ids on first write-path access
+void testCompressedOnlyContainer()
+{
+    const unsigned size = 300;
+    std::vector<unsigned> recordIds;
+    CompressedInvertedList *compressedList = new CompressedInvertedList();
+    for (unsigned i = 0; i < size; ++i) {
+        recordIds.push_back((i * 7919) % 1000);
+        compressedList->append(recordIds.back(), (float) (size - i));
+    }
+    compressedList->finalize();
+    boost::shared_ptr<const CompressedInvertedList> compressedListPointer(compressedList);
+    InvertedListContainer container(compressedListPointer);
+    ASSERT(container.getReadViewSize() == size);
+    ASSERT(container.getWriteViewSize() == size);
+
+    InvertedListCursor cursor;
+    container.getInvertedListCursor(cursor);
+    ASSERT(cursor.isCompressed());
+
+    shared_ptr<vectorview<unsigned> > readView;
+    container.getInvertedList(readView);
+    ASSERT(readView->size() == size);
+    for (unsigned i = 0; i < size; ++i) {
+        ASSERT(readView->getElement(i) == recordIds[i]);
+        ASSERT(container.getInvertedListElement(i) == recordIds[i]);
+    }
+    container.addInvertedListElement(1000);
+    ASSERT(container.getWriteViewSize() == size + 1);
+}
+
+// after a commit or merge only the compressed list is kept, and readers of the released cowvector are not affected
+void testReleaseUncompressedList()
+{
+    InvertedListContainer uncompressedContainer(10);
+    ASSERT(uncompressedContainer.releaseUncompressedList() == NULL);
+
+    const unsigned size = 300;
+    CompressedInvertedList *compressedList = new CompressedInvertedList();
+    for (unsigned i = 0; i < size; ++i)
+        compressedList->append(i * 3, (float) (size - i));
+    compressedList->finalize();
+    InvertedListContainer container((boost::shared_ptr<const CompressedInvertedList>(compressedList)));
+
+    shared_ptr<vectorview<unsigned> > readView;
+    container.getInvertedList(readView);
+    cowvector<unsigned> *releasedList = container.releaseUncompressedList();
+    ASSERT(releasedList != NULL);
+    ASSERT(container.releaseUncompressedList() == NULL);
+    delete releasedList;
+    for (unsigned i = 0; i < size; ++i)
+        ASSERT(readView->getElement(i) == i * 3);
+
+    ASSERT(container.getReadViewSize() == size);
+    ASSERT(container.getWriteViewSize() == size);
+    InvertedListCursor cursor;
+    container.getInvertedListCursor(cursor);
+    ASSERT(cursor.isCompressed());
+    ASSERT(container.getInvertedListElement(size - 1) == (size - 1) * 3);
+}
+
+int main(int argc, char *argv[])
+{
+    srand(time(NULL));
+    testBlockPacking();
+    cout << "BlockPacking test passed" << endl;
+    testCompressedInvertedList();
+    cout << "CompressedInvertedList test passed" << endl;
+    testInvertedListCursor();
+    cout << "InvertedListCursor test passed" << endl;
+    testCompressedOnlyContainer();
+    cout << "Compressed-only InvertedListContainer test passed" << endl;
+    testReleaseUncompressedList();
+    cout << "Released InvertedListContainer test passed" << endl;
+    cout << "CompressedInvertedList Unit Tests: Passed" << endl;
+    return 0;
+}
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "index/DocValues.h"
+#include "util/RecordSerializer.h"
+#include "util/RecordSerializerUtil.h"
+#include "util/Assert.h"
+#include "util/StoredFieldCodec.h"
+#include "serialization/FlatSnapshot.h"
+#include <instantsearch/Schema.h>
+#include <instantsearch/TypedValue.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace srch2::instantsearch;
+using namespace srch2::util;
+
+// a schema with a column of each kind and a multi-valued attribute, which has no column
+Schema *createSchema()
+{
+    Schema *schema = Schema::create(srch2::instantsearch::DefaultIndex);
+    schema->setPrimaryKey("id");
+    schema->setSearchableAttribute("title");
+    schema->setRefiningAttribute("price", ATTRIBUTE_TYPE_FLOAT, "0");
+    schema->setRefiningAttribute("year", ATTRIBUTE_TYPE_INT, "0");
+    schema->setRefiningAttribute("views", ATTRIBUTE_TYPE_LONG, "0");
+    schema->setRefiningAttribute("category", ATTRIBUTE_TYPE_TEXT, "");
+    schema->setRefiningAttribute("tags", ATTRIBUTE_TYPE_TEXT, "", true);
+    return schema;
+}
+
+// builds the stored record of a record the way the server does
+StoredRecordBuffer createStoredRecord(const Schema *schema, const string &title, float price, int year,
+        long views, const string &category, const string &tags)
+{
+    Schema *storedSchema = Schema::create();
+    RecordSerializerUtil::populateStoredSchema(storedSchema, schema);
+    RecordSerializer serializer(*storedSchema);
+    string encoded;
+    StoredFieldCodec::encode(title, NULL, encoded);
+    serializer.addSearchableAttribute("title", encoded);
+    StoredFieldCodec::encode(category, NULL, encoded);
+    serializer.addSearchableAttribute("category", encoded);
+    StoredFieldCodec::encode(tags, NULL, encoded);
+    serializer.addSearchableAttribute("tags", encoded);
+    serializer.addRefiningAttribute("price", price);
+    serializer.addRefiningAttribute("year", year);
+    serializer.addRefiningAttribute("views", views);
+    RecordSerializerBuffer buffer = serializer.serialize();
+    char *data = new char[buffer.length];
+    memcpy(data, buffer.start, buffer.length);
+    delete storedSchema;
+    return StoredRecordBuffer(data, buffer.length);
+}
+
+vector<string> getColumnNames()
+{
+    vector<string> names;
+    names.push_back("category");
+    names.push_back("price");
+    names.push_back("views");
+    names.push_back("year");
+    return names;
+}
+
+vector<unsigned> getAttributeIds(const Schema *schema, const vector<string> &names)
+{
+    vector<unsigned> ids;
+    for (unsigned i = 0; i < names.size(); ++i)
+        ids.push_back(schema->getRefiningAttributeId(names[i]));
+    return ids;
+}
+
+// The values read from the columns must be the ones decoded from the stored records.
+void checkRecord(const Schema *schema, const DocValuesReadView &readView, unsigned recordId,
+        const StoredRecordBuffer &storedRecord)
+{
+    vector<string> names = getColumnNames();
+    vector<TypedValue> expectedValues;
+    RecordSerializerUtil::getBatchOfAttributes(names, schema, storedRecord.start.get(), &expectedValues);
+    vector<TypedValue> values;
+    ASSERT(readView.getBatchOfAttributes(getAttributeIds(schema, names), recordId, &values));
+    ASSERT(values.size() == names.size());
+    for (unsigned i = 0; i < names.size(); ++i) {
+        ASSERT(values[i].getType() == expectedValues[i].getType());
+        ASSERT(values[i] == expectedValues[i]);
+    }
+}
+
+void testColumns()
+{
+    Schema *schema = createSchema();
+    DocValues docValues(schema);
+    vector<StoredRecordBuffer> storedRecords;
+    storedRecords.push_back(createStoredRecord(schema, "first", 1.5, 2001, 10000000000L, "Books", "a $$ b"));
+    storedRecords.push_back(createStoredRecord(schema, "second", 2.25, 2002, 7, "Music", "c"));
+    storedRecords.push_back(createStoredRecord(schema, "third", -3, 2003, -1, "books", ""));
+    for (unsigned i = 0; i < storedRecords.size(); ++i)
+        docValues.addRecord(i, storedRecords[i]);
+    ASSERT(docValues.getNumberOfRecords() == 3);
+
+    // nothing is visible before the commit, so readers decode the stored records
+    boost::shared_ptr<const DocValuesReadView> readView;
+    docValues.getReadView(readView);
+    vector<TypedValue> values;
+    ASSERT(!readView->getBatchOfAttributes(getAttributeIds(schema, getColumnNames()), 0, &values));
+    ASSERT(values.empty());
+
+    docValues.commit();
+    docValues.getReadView(readView);
+    for (unsigned i = 0; i < storedRecords.size(); ++i)
+        checkRecord(schema, *readView, i, storedRecords[i]);
+    // text values are lower-cased, so both records share the dictionary entry
+    TypedValue category;
+    readView->getColumn(schema->getRefiningAttributeId("category"))->getTypedValue(2, category);
+    ASSERT(category.getTextTypedValue() == "books");
+
+    // multi-valued attributes have no column
+    ASSERT(readView->getColumn(schema->getRefiningAttributeId("tags")) == NULL);
+    vector<unsigned> attributeIds;
+    attributeIds.push_back(schema->getRefiningAttributeId("price"));
+    attributeIds.push_back(schema->getRefiningAttributeId("tags"));
+    ASSERT(!readView->getBatchOfAttributes(attributeIds, 0, &values));
+    ASSERT(values.empty());
+
+    delete schema;
+}
+
+// A record appended after the commit is only visible in the read views taken after the next merge.
+void testMerge()
+{
+    Schema *schema = createSchema();
+    DocValues docValues(schema);
+    StoredRecordBuffer first = createStoredRecord(schema, "first", 1, 1, 1, "one", "");
+    docValues.addRecord(0, first);
+    docValues.commit();
+
+    boost::shared_ptr<const DocValuesReadView> oldReadView;
+    docValues.getReadView(oldReadView);
+    StoredRecordBuffer second = createStoredRecord(schema, "second", 2, 2, 2, "two", "");
+    docValues.addRecord(1, second);
+    // a freed record appends default values
+    docValues.addRecord(2, StoredRecordBuffer());
+    // enough records to reallocate the arrays under the old read view
+    for (unsigned i = 3; i < 3000; ++i)
+        docValues.addRecord(i, first);
+
+    vector<unsigned> attributeIds = getAttributeIds(schema, getColumnNames());
+    vector<TypedValue> values;
+    ASSERT(!oldReadView->getBatchOfAttributes(attributeIds, 1, &values));
+    docValues.merge();
+    ASSERT(!oldReadView->getBatchOfAttributes(attributeIds, 1, &values));
+    checkRecord(schema, *oldReadView, 0, first);
+
+    boost::shared_ptr<const DocValuesReadView> readView;
+    docValues.getReadView(readView);
+    checkRecord(schema, *readView, 0, first);
+    checkRecord(schema, *readView, 1, second);
+    checkRecord(schema, *readView, 2999, first);
+    ASSERT(readView->getBatchOfAttributes(attributeIds, 2, &values));
+    ASSERT(values[0].getTextTypedValue() == "");
+    ASSERT(values[1].getFloatTypedValue() == 0);
+    ASSERT(values[2].getLongTypedValue() == 0);
+    ASSERT(values[3].getIntTypedValue() == 0);
+
+    oldReadView.reset();
+    readView.reset();
+    delete schema;
+}
+
+// the positions in recordIds of the records whose column value is in [lowerBound, upperBound]
+vector<unsigned> selectInRange(const DocValuesColumnReadView *column, const TypedValue *lowerBound,
+        const TypedValue *upperBound, bool negative, const vector<unsigned> &recordIds)
+{
+    vector<unsigned> selection;
+    for (unsigned i = 0; i < recordIds.size(); ++i)
+        selection.push_back(i);
+    ASSERT(column->selectInRange(lowerBound, upperBound, negative, &recordIds[0], selection));
+    return selection;
+}
+
+void testSelectInRange()
+{
+    Schema *schema = createSchema();
+    DocValues docValues(schema);
+    for (unsigned i = 0; i < 100; ++i)
+        docValues.addRecord(i, createStoredRecord(schema, "title", i * 0.5, 2000 + i % 10, i, i % 2 ? "odd" : "even", ""));
+    docValues.commit();
+    boost::shared_ptr<const DocValuesReadView> readView;
+    docValues.getReadView(readView);
+
+    // a batch is any subset of the records, in the order of the child operator
+    vector<unsigned> recordIds;
+    recordIds.push_back(41);
+    recordIds.push_back(3);
+    recordIds.push_back(7);
+    recordIds.push_back(90);
+    recordIds.push_back(10);
+
+    const DocValuesColumnReadView *year = readView->getColumn(schema->getRefiningAttributeId("year"));
+    ASSERT(year->getType() == ATTRIBUTE_TYPE_INT);
+    TypedValue lowerBound, upperBound;
+    lowerBound.setTypedValue(ATTRIBUTE_TYPE_INT, "2001");
+    upperBound.setTypedValue(ATTRIBUTE_TYPE_INT, "2003");
+    vector<unsigned> selection = selectInRange(year, &lowerBound, &upperBound, false, recordIds);
+    ASSERT(selection.size() == 2 && selection[0] == 0 && selection[1] == 1);
+    selection = selectInRange(year, &lowerBound, &upperBound, true, recordIds);
+    ASSERT(selection.size() == 3 && selection[0] == 2 && selection[1] == 3 && selection[2] == 4);
+    selection = selectInRange(year, NULL, &lowerBound, false, recordIds);
+    ASSERT(selection.size() == 3 && selection[0] == 0 && selection[1] == 3 && selection[2] == 4);
+
+    const DocValuesColumnReadView *price = readView->getColumn(schema->getRefiningAttributeId("price"));
+    lowerBound.setTypedValue(ATTRIBUTE_TYPE_FLOAT, "5");
+    selection = selectInRange(price, &lowerBound, NULL, false, recordIds);
+    ASSERT(selection.size() == 3 && selection[0] == 0 && selection[1] == 3 && selection[2] == 4);
+    // equality is the range [value, value]
+    selection = selectInRange(price, &lowerBound, &lowerBound, false, recordIds);
+    ASSERT(selection.size() == 1 && selection[0] == 4);
+
+    const DocValuesColumnReadView *category = readView->getColumn(schema->getRefiningAttributeId("category"));
+    ASSERT(category->getType() == ATTRIBUTE_TYPE_TEXT);
+    lowerBound.setTypedValue(ATTRIBUTE_TYPE_TEXT, "odd");
+    selection = selectInRange(category, &lowerBound, &lowerBound, false, recordIds);
+    ASSERT(selection.size() == 3 && selection[0] == 0 && selection[1] == 1 && selection[2] == 2);
+
+    // a selection narrowed by a previous term stays sorted
+    selection.clear();
+    selection.push_back(1);
+    selection.push_back(3);
+    selection.push_back(4);
+    lowerBound.setTypedValue(ATTRIBUTE_TYPE_LONG, "10");
+    ASSERT(readView->getColumn(schema->getRefiningAttributeId("views"))->selectInRange(
+            &lowerBound, NULL, false, &recordIds[0], selection));
+    ASSERT(selection.size() == 2 && selection[0] == 3 && selection[1] == 4);
+
+    // a record newer than the read view leaves the selection as it is
+    recordIds.push_back(100);
+    selection.clear();
+    for (unsigned i = 0; i < recordIds.size(); ++i)
+        selection.push_back(i);
+    ASSERT(!year->selectInRange(NULL, NULL, false, &recordIds[0], selection));
+    ASSERT(selection.size() == recordIds.size());
+
+    readView.reset();
+    delete schema;
+}
+
+// The columns loaded from a snapshot are the saved ones, and records appended after the load are merged
+// on top of the mapped arrays.
+void testSaveAndLoad()
+{
+    Schema *schema = createSchema();
+    DocValues docValues(schema);
+    vector<StoredRecordBuffer> storedRecords;
+    for (unsigned i = 0; i < 1000; ++i)
+        storedRecords.push_back(createStoredRecord(schema, "title", i * 0.5, 2000 + i % 10, -(long) i,
+                i % 3 ? "odd" : "Even", ""));
+    for (unsigned i = 0; i < storedRecords.size(); ++i)
+        docValues.addRecord(i, storedRecords[i]);
+    docValues.commit();
+
+    const string snapshotFileName = "DocValues_Test.snapshot";
+    FlatSnapshotWriter writer(snapshotFileName);
+    docValues.save(writer);
+    writer.finish();
+
+    // a snapshot of another number of records is not loaded
+    DocValues otherDocValues(schema);
+    ASSERT(!otherDocValues.load(FlatSnapshotReader(snapshotFileName), storedRecords.size() + 1));
+    ASSERT(otherDocValues.getNumberOfRecords() == 0);
+
+    DocValues loadedDocValues(schema);
+    ASSERT(loadedDocValues.load(FlatSnapshotReader(snapshotFileName), storedRecords.size()));
+    ASSERT(loadedDocValues.getNumberOfRecords() == storedRecords.size());
+    boost::shared_ptr<const DocValuesReadView> readView;
+    loadedDocValues.getReadView(readView);
+    for (unsigned i = 0; i < storedRecords.size(); ++i)
+        checkRecord(schema, *readView, i, storedRecords[i]);
+
+    // a new dictionary value and a known one
+    StoredRecordBuffer newRecord = createStoredRecord(schema, "new", 7, 7, 7, "new", "");
+    loadedDocValues.addRecord(storedRecords.size(), newRecord);
+    loadedDocValues.addRecord(storedRecords.size() + 1, storedRecords[0]);
+    loadedDocValues.merge();
+    boost::shared_ptr<const DocValuesReadView> mergedReadView;
+    loadedDocValues.getReadView(mergedReadView);
+    checkRecord(schema, *mergedReadView, 0, storedRecords[0]);
+    checkRecord(schema, *mergedReadView, storedRecords.size(), newRecord);
+    checkRecord(schema, *mergedReadView, storedRecords.size() + 1, storedRecords[0]);
+    checkRecord(schema, *readView, storedRecords.size() - 1, storedRecords.back());
+
+    readView.reset();
+    mergedReadView.reset();
+    ::remove(snapshotFileName.c_str());
+    delete schema;
+}
+
+int main(int argc, char *argv[])
+{
+    testColumns();
+    cout << "DocValues columns test passed" << endl;
+    testMerge();
+    cout << "DocValues merge test passed" << endl;
+    testSelectInRange();
+    cout << "DocValues selectInRange test passed" << endl;
+    testSaveAndLoad();
+    cout << "DocValues save/load test passed" << endl;
+    return 0;
+}
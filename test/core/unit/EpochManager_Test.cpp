@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Tests the epoch based reclamation of util/EpochManager.h: a retired object is released only after
+ * the readers that entered before it was retired have exited, while readers and a writer run
+ * concurrently, and that synchronize waits for the readers that are in, but not for the readers of
+ * another manager.
+ *
+ * It also prints the number of read views taken per second by 1 to 8 threads, with an epoch and
+ * with a shared pointer copied under a spinlock as the indexes did before.
+ */
+
+#include "util/EpochManager.h"
+#include "util/Assert.h"
+#include "util/mypthread.h"
+#include "util/mytime.h"
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <iostream>
+#include <assert.h>
+
+using namespace std;
+using namespace srch2::util;
+using namespace srch2::instantsearch;
+
+// the value of a published object, set to 0 when it is destroyed
+struct PublishedObject {
+    volatile unsigned value;
+    PublishedObject(unsigned value) {
+        this->value = value;
+    }
+    ~PublishedObject() {
+        this->value = 0;
+    }
+};
+
+EpochManager epochManager;
+
+// a retired object is released once the readers that may reach it have exited
+void testRetire()
+{
+    EpochRetireList retireList(epochManager);
+    boost::shared_ptr<PublishedObject> object(new PublishedObject(1));
+    boost::weak_ptr<PublishedObject> weakObject(object);
+
+    // no reader is in, the object is released right away
+    retireList.retire(object);
+    object.reset();
+    ASSERT(weakObject.expired());
+    ASSERT(retireList.size() == 0);
+
+    object.reset(new PublishedObject(2));
+    weakObject = object;
+    EpochManager::ReaderSlot *slot = epochManager.enter();
+    retireList.retire(object);
+    object.reset();
+    ASSERT(!weakObject.expired());
+    ASSERT(retireList.size() == 1);
+
+    // a nested enter keeps the epoch of the outer one
+    ASSERT(epochManager.enter() == slot);
+    EpochManager::exit(slot);
+    retireList.reclaim();
+    ASSERT(!weakObject.expired());
+
+    EpochManager::exit(slot);
+    retireList.reclaim();
+    ASSERT(weakObject.expired());
+    ASSERT(retireList.size() == 0);
+
+    // a reader that enters after the object was retired does not keep it
+    object.reset(new PublishedObject(3));
+    weakObject = object;
+    retireList.retire(object);
+    object.reset();
+    slot = epochManager.enter();
+    retireList.reclaim();
+    ASSERT(weakObject.expired());
+    EpochManager::exit(slot);
+}
+
+PublishedObject * volatile publishedObject = NULL;
+volatile bool isStopping = false;
+
+void readPublishedObject(unsigned *numberOfReads)
+{
+    unsigned reads = 0;
+    while (!isStopping) {
+        EpochManager::ReaderSlot *slot = epochManager.enter();
+        PublishedObject *object = publishedObject;
+        // the object must not be destroyed while the reader is in
+        for (unsigned i = 0; i < 16; ++i)
+            ASSERT(object->value != 0);
+        EpochManager::exit(slot);
+        reads++;
+    }
+    *numberOfReads = reads;
+}
+
+// readers never see a destroyed object while the writer replaces it
+void testConcurrentReadersAndWriter()
+{
+    EpochRetireList retireList(epochManager);
+    publishedObject = new PublishedObject(1);
+    isStopping = false;
+
+    const unsigned numberOfReaders = 4;
+    vector<unsigned> numberOfReads(numberOfReaders, 0);
+    boost::thread_group readers;
+    for (unsigned t = 0; t < numberOfReaders; ++t)
+        readers.create_thread(boost::bind(readPublishedObject, &numberOfReads[t]));
+
+    for (unsigned i = 2; i < 20000; ++i) {
+        PublishedObject *oldObject = publishedObject;
+        __sync_synchronize();
+        publishedObject = new PublishedObject(i);
+        retireList.retire(boost::shared_ptr<const void>(oldObject));
+        if (i % 64 == 0)
+            boost::this_thread::yield();
+    }
+    isStopping = true;
+    readers.join_all();
+
+    retireList.reclaim();
+    ASSERT(retireList.size() == 0);
+    delete publishedObject;
+    publishedObject = NULL;
+}
+
+// synchronize returns only after the readers that entered before it have exited
+volatile bool isSynchronized;
+
+void synchronizeReaders()
+{
+    epochManager.synchronize();
+    isSynchronized = true;
+}
+
+void testSynchronize()
+{
+    // no reader is in
+    epochManager.synchronize();
+
+    // the epoch the caller pinned itself is ignored
+    EpochManager::ReaderSlot *slot = epochManager.enter();
+    epochManager.synchronize();
+
+    // a reader of another thread holds it back until it exits
+    isSynchronized = false;
+    boost::thread writer(synchronizeReaders);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    ASSERT(!isSynchronized);
+    EpochManager::exit(slot);
+    writer.join();
+    ASSERT(isSynchronized);
+}
+
+// a reader of one manager never holds back the writer of another one, even on the same thread
+void testSeparateManagers()
+{
+    EpochManager otherEpochManager;
+    ASSERT(!epochManager.isEnteredByCurrentThread());
+
+    EpochManager::ReaderSlot *slot = epochManager.enter();
+    ASSERT(epochManager.isEnteredByCurrentThread());
+    ASSERT(!otherEpochManager.isEnteredByCurrentThread());
+
+    // the thread has the same number in both managers
+    EpochManager::ReaderSlot *otherSlot = otherEpochManager.enter();
+    ASSERT(otherSlot != slot);
+    ASSERT(EpochManager::getSlotIndex(otherSlot) == EpochManager::getSlotIndex(slot));
+    EpochManager::exit(otherSlot);
+    ASSERT(!otherEpochManager.isEnteredByCurrentThread());
+
+    // another thread synchronizes the other manager while this one is in the first
+    boost::thread writer(boost::bind(&EpochManager::synchronize, &otherEpochManager));
+    writer.join();
+    otherEpochManager.synchronize();
+
+    EpochManager::exit(slot);
+    ASSERT(!epochManager.isEnteredByCurrentThread());
+}
+
+pthread_spinlock_t readViewSpinlock;
+boost::shared_ptr<PublishedObject> sharedReadView;
+
+void takeReadViews(bool withEpoch, unsigned numberOfIterations)
+{
+    unsigned sum = 0;
+    for (unsigned i = 0; i < numberOfIterations; ++i) {
+        if (withEpoch) {
+            EpochManager::ReaderSlot *slot = epochManager.enter();
+            sum += publishedObject->value;
+            EpochManager::exit(slot);
+        } else {
+            boost::shared_ptr<PublishedObject> readView;
+            pthread_spin_lock(&readViewSpinlock);
+            readView = sharedReadView;
+            pthread_spin_unlock(&readViewSpinlock);
+            sum += readView->value;
+        }
+    }
+    ASSERT(sum != 0);
+}
+
+double getReadViewsPerSecond(bool withEpoch, unsigned numberOfThreads)
+{
+    const unsigned numberOfIterations = 1000000;
+    timespec start, end;
+    clock_gettime(CLOCK_REALTIME, &start);
+    boost::thread_group threads;
+    for (unsigned t = 0; t < numberOfThreads; ++t)
+        threads.create_thread(boost::bind(takeReadViews, withEpoch, numberOfIterations));
+    threads.join_all();
+    clock_gettime(CLOCK_REALTIME, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    return numberOfThreads * numberOfIterations / seconds;
+}
+
+void benchmarkReadViews()
+{
+    pthread_spin_init(&readViewSpinlock, 0);
+    publishedObject = new PublishedObject(1);
+    sharedReadView.reset(new PublishedObject(1));
+    cout << "threads\tepoch (views/s)\tshared pointer (views/s)" << endl;
+    for (unsigned numberOfThreads = 1; numberOfThreads <= 8; numberOfThreads *= 2) {
+        cout << numberOfThreads << "\t" << (unsigned long) getReadViewsPerSecond(true, numberOfThreads)
+                << "\t" << (unsigned long) getReadViewsPerSecond(false, numberOfThreads) << endl;
+    }
+    delete publishedObject;
+    publishedObject = NULL;
+    sharedReadView.reset();
+    pthread_spin_destroy(&readViewSpinlock);
+}
+
+int main(int argc, char *argv[])
+{
+    testRetire();
+    testConcurrentReadersAndWriter();
+    testSynchronize();
+    testSeparateManagers();
+    benchmarkReadViews();
+
+    cout << "EpochManager Unit Tests: Passed" << endl;
+    return 0;
+}
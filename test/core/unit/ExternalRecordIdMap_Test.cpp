@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "index/ExternalRecordIdMap.h"
+#include "serialization/FlatSnapshot.h"
+#include "util/Assert.h"
+#include <boost/thread.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+using namespace srch2::instantsearch;
+
+const string snapshotFileName = "testExternalRecordIdMap.idx";
+
+string getKey(unsigned i)
+{
+    stringstream key;
+    key << "record-" << i;
+    return key.str();
+}
+
+// Erased keys are not found, and setting them again brings them back with the new value.
+void testSetGetErase()
+{
+    ExternalRecordIdMap map;
+    unsigned value;
+    ASSERT(!map.getValue("", value));
+    ASSERT(!map.getValue("a", value));
+
+    // enough keys to grow the table several times
+    for (unsigned i = 0; i < 100000; ++i)
+        map.setValue(getKey(i), i);
+    ASSERT(map.size() == 100000);
+    for (unsigned i = 0; i < 100000; ++i) {
+        ASSERT(map.getValue(getKey(i), value));
+        ASSERT(value == i);
+    }
+    ASSERT(!map.getValue(getKey(100000), value));
+
+    for (unsigned i = 0; i < 100000; i += 2)
+        map.erase(getKey(i));
+    map.erase(getKey(0));
+    ASSERT(map.size() == 50000);
+    ASSERT(!map.getValue(getKey(0), value));
+    ASSERT(map.getValue(getKey(1), value) && value == 1);
+
+    map.setValue(getKey(0), 7);
+    map.setValue(getKey(1), 8);
+    ASSERT(map.size() == 50001);
+    ASSERT(map.getValue(getKey(0), value) && value == 7);
+    ASSERT(map.getValue(getKey(1), value) && value == 8);
+
+    // a key longer than the chunks of the arena
+    string longKey(100000, 'k');
+    map.setValue(longKey, 3);
+    ASSERT(map.getValue(longKey, value) && value == 3);
+    ASSERT(!map.getValue(longKey.substr(1), value));
+
+    // erasing and adding keys over and over rehashes the table instead of filling it with erased slots
+    for (unsigned i = 200000; i < 400000; ++i) {
+        map.setValue(getKey(i), i);
+        map.erase(getKey(i));
+    }
+    ASSERT(map.size() == 50002);
+    ASSERT(map.getValue(getKey(3), value) && value == 3);
+}
+
+struct Reader {
+    ExternalRecordIdMap *map;
+    unsigned *numberOfKeysWritten;
+    bool *done;
+    bool *failed;
+
+    void operator()() {
+        while (!__atomic_load_n(done, __ATOMIC_ACQUIRE)) {
+            unsigned numberOfKeys = __atomic_load_n(numberOfKeysWritten, __ATOMIC_ACQUIRE);
+            for (unsigned i = 0; i < numberOfKeys; i += 97) {
+                unsigned value;
+                if (!map->getValue(getKey(i), value) || value != i)
+                    *failed = true;
+            }
+        }
+    }
+};
+
+// Readers find every key added before they look, while the writer keeps growing the table.
+void testConcurrentReaders()
+{
+    ExternalRecordIdMap map;
+    unsigned numberOfKeysWritten = 0;
+    bool done = false;
+    bool failed = false;
+    boost::thread_group readers;
+    for (unsigned i = 0; i < 4; ++i) {
+        Reader reader = { &map, &numberOfKeysWritten, &done, &failed };
+        readers.create_thread(reader);
+    }
+    for (unsigned i = 0; i < 200000; ++i) {
+        map.setValue(getKey(i), i);
+        __atomic_store_n(&numberOfKeysWritten, i + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&done, true, __ATOMIC_RELEASE);
+    readers.join_all();
+    ASSERT(!failed);
+}
+
+// A loaded table has the same content, and it can still be changed.
+void testSaveAndLoad()
+{
+    ExternalRecordIdMap map;
+    for (unsigned i = 0; i < 1000; ++i)
+        map.setValue(getKey(i), i);
+    map.erase(getKey(10));
+    {
+        FlatSnapshotWriter writer(snapshotFileName);
+        map.save(writer);
+        writer.finish();
+    }
+
+    ExternalRecordIdMap loadedMap;
+    loadedMap.setValue("replaced", 1);
+    {
+        FlatSnapshotReader reader(snapshotFileName);
+        ASSERT(ExternalRecordIdMap::hasSnapshot(reader));
+        loadedMap.load(reader);
+    }
+    ::remove(snapshotFileName.c_str());
+
+    unsigned value;
+    ASSERT(loadedMap.size() == 999);
+    ASSERT(!loadedMap.getValue("replaced", value));
+    ASSERT(!loadedMap.getValue(getKey(10), value));
+    for (unsigned i = 0; i < 1000; ++i) {
+        if (i != 10)
+            ASSERT(loadedMap.getValue(getKey(i), value) && value == i);
+    }
+    for (unsigned i = 1000; i < 5000; ++i)
+        loadedMap.setValue(getKey(i), i);
+    loadedMap.setValue(getKey(10), 10);
+    for (unsigned i = 0; i < 5000; ++i)
+        ASSERT(loadedMap.getValue(getKey(i), value) && value == i);
+
+    // a corrupted table is rejected
+    {
+        FlatSnapshotWriter writer(snapshotFileName);
+        writer.addSection(FlatSection_ExternalRecordIdMapKeys, "x", 1);
+        // 16 slots of a key offset, a hash and a value; the first key is out of the keys
+        vector<uint64_t> slots(32, (uint64_t) -1);
+        slots[0] = 5;
+        slots[1] = 0;
+        writer.addSection(FlatSection_ExternalRecordIdMapSlots, &slots[0], slots.size() * sizeof(uint64_t));
+        writer.finish();
+    }
+    bool thrown = false;
+    try {
+        FlatSnapshotReader reader(snapshotFileName);
+        loadedMap.load(reader);
+    } catch (std::runtime_error &ex) {
+        thrown = true;
+    }
+    ::remove(snapshotFileName.c_str());
+    ASSERT(thrown);
+    ASSERT(loadedMap.getValue(getKey(4999), value) && value == 4999);
+}
+
+int main(int argc, char *argv[])
+{
+    testSetGetErase();
+    cout << "ExternalRecordIdMap set/get/erase test passed" << endl;
+    testConcurrentReaders();
+    cout << "ExternalRecordIdMap concurrent readers test passed" << endl;
+    testSaveAndLoad();
+    cout << "ExternalRecordIdMap save/load test passed" << endl;
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "serialization/FlatSnapshot.h"
+#include "util/cowvector/cowvector.h"
+#include "util/Assert.h"
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <stdio.h>
+
+using namespace std;
+using namespace srch2::instantsearch;
+
+const string snapshotFileName = "testFlatSnapshot.idx";
+
+// Writes two sections and checks that the reader finds them at aligned offsets with the same content.
+void testWriteAndRead()
+{
+    unsigned values[5] = { 3, 1, 4, 1, 5 };
+    {
+        FlatSnapshotWriter writer(snapshotFileName);
+        writer.addSection(FlatSection_InvertedListKeywordIds, values, sizeof(values));
+        writer.beginSection(FlatSection_ForwardListPayload);
+        writer.append("abc", 3);
+        writer.appendValue<uint32_t>(42);
+        ASSERT(writer.getCurrentSectionLength() == 7);
+        writer.endSection();
+        writer.finish();
+    }
+
+    ASSERT(FlatSnapshotReader::isFlatSnapshot(snapshotFileName));
+    FlatSnapshotReader reader(snapshotFileName);
+    ASSERT(reader.hasSection(FlatSection_InvertedListKeywordIds));
+    ASSERT(reader.hasSection(FlatSection_ForwardListPayload));
+    ASSERT(!reader.hasSection(FlatSection_ForwardListHeaders));
+
+    uint64_t numberOfValues;
+    const unsigned *mappedValues = reader.getSectionAsArray<unsigned>(FlatSection_InvertedListKeywordIds, numberOfValues);
+    ASSERT(numberOfValues == 5);
+    ASSERT((size_t) mappedValues % FLAT_SNAPSHOT_ALIGNMENT == 0);
+    for (unsigned i = 0; i < numberOfValues; ++i)
+        ASSERT(mappedValues[i] == values[i]);
+
+    uint64_t length;
+    const char *payload = reader.getSection(FlatSection_ForwardListPayload, length);
+    ASSERT(length == 7);
+    ASSERT(string(payload, 3) == "abc");
+    ASSERT(*(const uint32_t *) (payload + 3) == 42);
+
+    bool thrown = false;
+    try {
+        reader.getSection(FlatSection_ForwardListHeaders, length);
+    } catch (std::runtime_error &e) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
+// A file that is not a flat snapshot must be rejected, so that the loader falls back to boost archives.
+void testRejectInvalidFile()
+{
+    {
+        ofstream out(snapshotFileName.c_str(), ios::binary | ios::trunc);
+        out << "22 serialization::archive";
+    }
+    ASSERT(!FlatSnapshotReader::isFlatSnapshot(snapshotFileName));
+    bool thrown = false;
+    try {
+        FlatSnapshotReader reader(snapshotFileName);
+    } catch (std::runtime_error &e) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+    ASSERT(!FlatSnapshotReader::isFlatSnapshot("nonExistingFlatSnapshot.idx"));
+}
+
+// A cowvector created over a mapped array reads the mapping in place. Appending to the write view
+// reallocates it, and the read view keeps pointing into the mapping until the next merge.
+void testCowvectorOverMappedArray()
+{
+    unsigned values[4] = { 10, 20, 30, 40 };
+    {
+        FlatSnapshotWriter writer(snapshotFileName);
+        writer.addSection(FlatSection_InvertedListRecordIds, values, sizeof(values));
+        writer.finish();
+    }
+    FlatSnapshotReader reader(snapshotFileName);
+    uint64_t numberOfValues;
+    unsigned *mappedValues = const_cast<unsigned *>(
+            reader.getSectionAsArray<unsigned>(FlatSection_InvertedListRecordIds, numberOfValues));
+
+    cowvector<unsigned> *cowv = new cowvector<unsigned>(mappedValues, numberOfValues);
+    shared_ptr<vectorview<unsigned> > readView;
+    cowv->getReadView(readView);
+    ASSERT(readView->isReadView());
+    ASSERT(readView->size() == 4);
+    ASSERT(&readView->getElement(0) == mappedValues);
+
+    vectorview<unsigned>* &writeView = cowv->getWriteView();
+    ASSERT(writeView->getArray() == readView->getArray());
+    writeView->push_back(50);
+    ASSERT(writeView->getArray() != readView->getArray());
+    ASSERT(writeView->getNeedToFreeArray() == true);
+    ASSERT(writeView->size() == 5);
+    ASSERT(readView->size() == 4);
+    for (unsigned i = 0; i < 4; ++i) {
+        ASSERT(writeView->getElement(i) == values[i]);
+        ASSERT(readView->getElement(i) == values[i]);
+    }
+
+    cowv->merge();
+    shared_ptr<vectorview<unsigned> > newReadView;
+    cowv->getReadView(newReadView);
+    ASSERT(newReadView->size() == 5);
+    ASSERT(newReadView->getElement(4) == 50);
+
+    // neither the cowvector nor the old read view may free the mapped array
+    readView.reset();
+    newReadView.reset();
+    delete cowv;
+    ASSERT(mappedValues[3] == 40);
+}
+
+// Saves the segments of five elements, changes one element and saves again. Only the segment of that
+// element is written the second time, and the manifest points to the new file for it and to the old
+// files for the others.
+static void saveSegments(FlatSnapshotSegments &segments, unsigned numberOfElements, uint32_t version)
+{
+    segments.beginSave(snapshotFileName, numberOfElements);
+    for (unsigned segmentId = 0; segmentId < segments.getNumberOfSegmentsToSave(); ++segmentId) {
+        if (segments.isSegmentToSave(segmentId)) {
+            FlatSnapshotWriter writer(segments.startSegment(segmentId));
+            writer.addSection(FlatSection_ForwardListPayload, &version, sizeof(version));
+            writer.finish();
+        }
+    }
+    FlatSnapshotWriter manifest(snapshotFileName);
+    segments.addManifestSection(manifest, FlatSection_ForwardListSegments);
+    manifest.finish();
+    segments.commitSave();
+}
+
+static uint32_t readSegmentVersion(const string &fileName)
+{
+    FlatSnapshotReader reader(fileName);
+    uint64_t length;
+    return *(const uint32_t *) reader.getSection(FlatSection_ForwardListPayload, length);
+}
+
+void testSaveChangedSegments()
+{
+    FlatSnapshotSegments segments("test", 2);
+    for (unsigned elementId = 0; elementId < 5; ++elementId)
+        segments.markChanged(elementId);
+    saveSegments(segments, 5, 1);
+    ASSERT(segments.getNumberOfSegmentsWritten() == 3);
+    string oldSegmentFileName = segments.getSegmentFileName(1);
+
+    // nothing changed, so nothing is written
+    saveSegments(segments, 5, 2);
+    ASSERT(segments.getNumberOfSegmentsWritten() == 0);
+
+    segments.markChanged(3);
+    saveSegments(segments, 5, 3);
+    ASSERT(segments.getNumberOfSegmentsWritten() == 1);
+    ASSERT(segments.getSegmentFileName(1) != oldSegmentFileName);
+    ASSERT(!ifstream(oldSegmentFileName.c_str()).good());
+
+    FlatSnapshotSegments loadedSegments("test", 2);
+    FlatSnapshotReader manifest(snapshotFileName);
+    ASSERT(loadedSegments.load(snapshotFileName, manifest, FlatSection_ForwardListSegments) == 3);
+    ASSERT(readSegmentVersion(loadedSegments.getSegmentFileName(0)) == 1);
+    ASSERT(readSegmentVersion(loadedSegments.getSegmentFileName(1)) == 3);
+    ASSERT(readSegmentVersion(loadedSegments.getSegmentFileName(2)) == 1);
+    for (unsigned segmentId = 0; segmentId < 3; ++segmentId)
+        ::remove(loadedSegments.getSegmentFileName(segmentId).c_str());
+}
+
+int main(int argc, char *argv[])
+{
+    testWriteAndRead();
+    cout << "FlatSnapshot write and read test passed" << endl;
+    testRejectInvalidFile();
+    cout << "FlatSnapshot invalid file test passed" << endl;
+    testCowvectorOverMappedArray();
+    cout << "FlatSnapshot cowvector test passed" << endl;
+    testSaveChangedSegments();
+    cout << "FlatSnapshot changed segments test passed" << endl;
+    ::remove(snapshotFileName.c_str());
+    return 0;
+}
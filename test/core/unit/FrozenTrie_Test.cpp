@@ -0,0 +1,567 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Tests the frozen read view of the trie (index/FrozenTrie.h) against the pointer based trie,
+ * and compares the two layouts on fuzzy prefix search throughput. It also reports the memory the
+ * frozen copy adds to the read view and the time it adds to a merge.
+ *
+ * The keywords are random strings generated with a fixed seed, so the benchmark numbers can be
+ * compared across runs. Use --keywords <n> to change the size of the vocabulary.
+ */
+
+#include "index/Trie.h"
+#include "index/FrozenTrie.h"
+#include "operation/ActiveNode.h"
+#include "util/Assert.h"
+#include "util/encoding.h"
+#include "util/mytime.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <set>
+#include <cstring>
+#include <cstdlib>
+#include <assert.h>
+
+using namespace std;
+using namespace srch2::instantsearch;
+
+typedef boost::shared_ptr<TrieRootNodeAndFreeList> TrieRootNodeSharedPtr;
+// a trie node with its edit distance to the prefix and the edit distance of the prefix of the query
+// it was reached from
+typedef pair<const TrieNode *, pair<unsigned, unsigned> > ActiveNode;
+
+void addActiveNodes(const boost::shared_ptr<PrefixActiveNodeSet> &activeNodeSet, unsigned editDistanceThreshold,
+        set<ActiveNode> &activeNodes)
+{
+    for (ActiveNodeSetIterator iter(activeNodeSet.get(), editDistanceThreshold); !iter.isDone(); iter.next()) {
+        const TrieNode *trieNode;
+        unsigned distance;
+        iter.getItem(trieNode, distance);
+        activeNodes.insert(make_pair(trieNode, make_pair(distance, activeNodeSet->getEditdistanceofPrefix(trieNode))));
+    }
+}
+
+string randomKeyword(unsigned minLength, unsigned maxLength)
+{
+    // a skewed alphabet gives the trie shared prefixes like a natural vocabulary has
+    static const char alphabet[] = "eeeaaaoooiiinnsstrrlcdmpuhgbfywkvxzjq";
+    unsigned length = minLength + rand() % (maxLength - minLength + 1);
+    string keyword;
+    for (unsigned i = 0; i < length; ++i)
+        keyword += alphabet[rand() % (sizeof(alphabet) - 1)];
+    return keyword;
+}
+
+Trie *buildTrie(const vector<string> &keywords)
+{
+    Trie *trie = new Trie();
+    unsigned invertedIndexOffset = 0;
+    for (unsigned i = 0; i < keywords.size(); ++i)
+        trie->addKeyword(keywords[i], invertedIndexOffset);
+    trie->commit();
+    trie->finalCommit_finalizeHistogramInformation(NULL, NULL, 0);
+    return trie;
+}
+
+// active nodes of the prefix computed keystroke by keystroke with PrefixActiveNodeSet
+void getActiveNodesFromTrie(const TrieRootNodeSharedPtr &readView, const string &prefix,
+        unsigned editDistanceThreshold, set<ActiveNode> &activeNodes, bool supportSwapInEditDistance = false)
+{
+    vector<CharType> prefixCharacters;
+    utf8StringToCharTypeVector(prefix, prefixCharacters);
+    boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet(
+            new PrefixActiveNodeSet(readView, editDistanceThreshold, supportSwapInEditDistance));
+    for (unsigned i = 0; i < prefixCharacters.size(); ++i)
+        activeNodeSet = activeNodeSet->computeActiveNodeSetIncrementally(prefixCharacters[i]);
+    addActiveNodes(activeNodeSet, editDistanceThreshold, activeNodes);
+}
+
+void getActiveNodesFromFrozenTrie(const FrozenTrie *frozenTrie, const string &prefix,
+        unsigned editDistanceThreshold, set<ActiveNode> &activeNodes, bool supportSwapInEditDistance = false)
+{
+    vector<CharType> prefixCharacters;
+    utf8StringToCharTypeVector(prefix, prefixCharacters);
+    vector<FrozenActiveNode> frozenActiveNodes;
+    frozenTrie->computeActiveNodes(prefixCharacters, editDistanceThreshold, supportSwapInEditDistance, frozenActiveNodes);
+    for (unsigned i = 0; i < frozenActiveNodes.size(); ++i)
+        activeNodes.insert(make_pair(frozenTrie->getTrieNode(frozenActiveNodes[i].nodeIndex),
+                make_pair(frozenActiveNodes[i].editDistance, frozenActiveNodes[i].prefixEditDistance)));
+}
+
+// the active node set built from the frozen trie in one pass
+void getActiveNodesFromFrozenActiveNodeSet(const TrieRootNodeSharedPtr &readView, const string &prefix,
+        unsigned editDistanceThreshold, set<ActiveNode> &activeNodes, bool supportSwapInEditDistance = false)
+{
+    vector<CharType> prefixCharacters;
+    utf8StringToCharTypeVector(prefix, prefixCharacters);
+    boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet = PrefixActiveNodeSet::computeActiveNodeSetFromFrozenTrie(
+            prefixCharacters, editDistanceThreshold, readView, supportSwapInEditDistance);
+    ASSERT(activeNodeSet);
+    ASSERT(activeNodeSet->getPrefixLength() == prefixCharacters.size());
+    addActiveNodes(activeNodeSet, editDistanceThreshold, activeNodes);
+}
+
+// The pivotal active nodes of the prefix from the definition: a node is pivotal if its character
+// matches the character i of the prefix, or if it ends a swap of the characters i - 1 and i, and
+// its distance is the (Levenshtein or swap) edit distance of the prefix up to i plus the deletion of
+// the rest of the prefix. The rows are computed on the trie nodes down to every node whose row is
+// not entirely above the threshold.
+// Characters from CHARTYPE_FUZZY_UPPERBOUND on cannot be edited, and such a character of the
+// prefix is only matched right after a matched character followed by deletions, whose costs are
+// kept in matchedRows.
+const unsigned NOT_EDITABLE = 1000;
+
+unsigned getEditCost(CharType character)
+{
+    return character < CHARTYPE_FUZZY_UPPERBOUND ? 1 : NOT_EDITABLE;
+}
+
+unsigned getDeletionCostAfter(const vector<CharType> &prefix, unsigned i)
+{
+    unsigned cost = 0;
+    for (; i < prefix.size(); ++i)
+        cost += getEditCost(prefix[i]);
+    return cost;
+}
+
+void addReferenceActiveNodes(const TrieNode *node, const vector<CharType> &prefix, unsigned editDistanceThreshold,
+        bool supportSwapInEditDistance, vector<vector<unsigned> > &rows, vector<vector<unsigned> > &matchedRows,
+        vector<CharType> &path, set<ActiveNode> &activeNodes)
+{
+    const unsigned depth = path.size();
+    const unsigned length = prefix.size();
+    const CharType character = path[depth - 1];
+    vector<unsigned> &row = rows[depth];
+    vector<unsigned> &matchedRow = matchedRows[depth];
+    row.assign(length + 1, 0);
+    matchedRow.assign(length + 1, NOT_EDITABLE);
+    row[0] = rows[depth - 1][0] + getEditCost(character);
+    unsigned pivotalDistance = editDistanceThreshold + 1, pivotalPrefixEditDistance = 0;
+    for (unsigned i = 1; i <= length; ++i) {
+        unsigned matched = NOT_EDITABLE;
+        if (prefix[i - 1] == character)
+            matched = getEditCost(character) == 1 ? rows[depth - 1][i - 1] : matchedRows[depth - 1][i - 1];
+        if (supportSwapInEditDistance && i >= 2 && depth >= 2 && prefix[i - 2] == character
+                && prefix[i - 1] == path[depth - 2] && character != path[depth - 2]
+                && max(getEditCost(character), getEditCost(path[depth - 2])) == 1)
+            matched = min(matched, rows[depth - 2][i - 2] + 1);
+        if (matched + getDeletionCostAfter(prefix, i) < pivotalDistance) {
+            pivotalDistance = matched + getDeletionCostAfter(prefix, i);
+            pivotalPrefixEditDistance = matched;
+        }
+        unsigned substitution = rows[depth - 1][i - 1] + max(getEditCost(prefix[i - 1]), getEditCost(character));
+        row[i] = min(min(matched, substitution),
+                min(rows[depth - 1][i] + getEditCost(character), row[i - 1] + getEditCost(prefix[i - 1])));
+        matchedRow[i] = min(matched, matchedRow[i - 1] + getEditCost(prefix[i - 1]));
+    }
+    if (pivotalDistance <= editDistanceThreshold)
+        activeNodes.insert(make_pair(node, make_pair(pivotalDistance, pivotalPrefixEditDistance)));
+    if (*min_element(row.begin(), row.end()) > editDistanceThreshold)
+        return;
+    for (unsigned child = 0; child < node->getChildrenCount(); ++child) {
+        path.push_back(node->getChild(child)->getCharacter());
+        addReferenceActiveNodes(node->getChild(child), prefix, editDistanceThreshold, supportSwapInEditDistance,
+                rows, matchedRows, path, activeNodes);
+        path.pop_back();
+    }
+}
+
+void getReferenceActiveNodes(const TrieRootNodeSharedPtr &readView, const string &prefix,
+        unsigned editDistanceThreshold, bool supportSwapInEditDistance, set<ActiveNode> &activeNodes)
+{
+    vector<CharType> prefixCharacters;
+    utf8StringToCharTypeVector(prefix, prefixCharacters);
+    vector<vector<unsigned> > rows(prefixCharacters.size() + editDistanceThreshold + 2);
+    rows[0].push_back(0);
+    for (unsigned i = 0; i < prefixCharacters.size(); ++i)
+        rows[0].push_back(rows[0].back() + getEditCost(prefixCharacters[i]));
+    vector<vector<unsigned> > matchedRows(rows);
+    if (getDeletionCostAfter(prefixCharacters, 0) <= editDistanceThreshold)
+        activeNodes.insert(make_pair(readView->root, make_pair(getDeletionCostAfter(prefixCharacters, 0), 0u)));
+    vector<CharType> path;
+    for (unsigned child = 0; child < readView->root->getChildrenCount(); ++child) {
+        path.push_back(readView->root->getChild(child)->getCharacter());
+        addReferenceActiveNodes(readView->root->getChild(child), prefixCharacters, editDistanceThreshold,
+                supportSwapInEditDistance, rows, matchedRows, path, activeNodes);
+        path.pop_back();
+    }
+}
+
+// every frozen node must have the same content as the trie node it was built from
+void testFrozenLayout(const Trie *trie, const vector<string> &keywords)
+{
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+    const FrozenTrie *frozenTrie = readView->getFrozenTrie();
+    ASSERT(frozenTrie != NULL);
+    ASSERT(frozenTrie->getNumberOfNodes() == (unsigned) trie->getNumberOfNodes());
+    ASSERT(frozenTrie->getTrieNode(FrozenTrie::ROOT_INDEX) == readView->root);
+
+    for (unsigned nodeIndex = 0; nodeIndex < frozenTrie->getNumberOfNodes(); ++nodeIndex) {
+        const FrozenTrieNode &node = frozenTrie->getNode(nodeIndex);
+        const TrieNode *trieNode = frozenTrie->getTrieNode(nodeIndex);
+        ASSERT(frozenTrie->getCharacter(nodeIndex) == trieNode->getCharacter());
+        ASSERT(node.getChildrenCount() == trieNode->getChildrenCount());
+        ASSERT(node.getDepth() == trieNode->getDepth());
+        ASSERT(node.isTerminalNode() == trieNode->isTerminalNode());
+        ASSERT(node.id == trieNode->getId());
+        ASSERT(node.minId == trieNode->getMinId());
+        ASSERT(node.maxId == trieNode->getMaxId());
+        for (unsigned child = 0; child < node.getChildrenCount(); ++child) {
+            ASSERT(frozenTrie->getTrieNode(node.firstChild + child) == trieNode->getChild(child));
+            ASSERT(frozenTrie->findChild(nodeIndex, trieNode->getChild(child)->getCharacter())
+                    == (int) (node.firstChild + child));
+        }
+    }
+
+    for (unsigned i = 0; i < keywords.size(); ++i) {
+        vector<CharType> keyword;
+        utf8StringToCharTypeVector(keywords[i], keyword);
+        int nodeIndex = frozenTrie->findNode(keyword);
+        ASSERT(nodeIndex != FrozenTrie::NOT_FOUND);
+        ASSERT(frozenTrie->getTrieNode(nodeIndex) == trie->getTrieNode(readView->root, keyword));
+        ASSERT(frozenTrie->getNode(nodeIndex).isTerminalNode());
+    }
+    vector<CharType> missingKeyword;
+    utf8StringToCharTypeVector("qqqqqqqqqqqqqqqqqqqqqqqqq", missingKeyword);
+    ASSERT(frozenTrie->findNode(missingKeyword) == FrozenTrie::NOT_FOUND);
+}
+
+// the frozen trie must find the same active nodes as PrefixActiveNodeSet. Thresholds 1 and 2 use
+// their own instantiations of the bit-parallel computation and 3 the generic one.
+void testActiveNodes(const Trie *trie, const vector<string> &prefixes)
+{
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+    for (unsigned editDistanceThreshold = 0; editDistanceThreshold <= 2; ++editDistanceThreshold) {
+        for (unsigned i = 0; i < prefixes.size(); ++i) {
+            set<ActiveNode> expected, actual, actualSet;
+            getActiveNodesFromTrie(readView, prefixes[i], editDistanceThreshold, expected);
+            getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), prefixes[i], editDistanceThreshold, actual);
+            ASSERT(expected == actual);
+            getActiveNodesFromFrozenActiveNodeSet(readView, prefixes[i], editDistanceThreshold, actualSet);
+            ASSERT(expected == actualSet);
+        }
+    }
+
+    // from threshold 3 on, PrefixActiveNodeSet can miss a pivotal active node
+    for (unsigned i = 0; i < prefixes.size(); ++i) {
+        set<ActiveNode> expected, actual;
+        getActiveNodesFromTrie(readView, prefixes[i], 3, expected);
+        getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), prefixes[i], 3, actual);
+        for (set<ActiveNode>::const_iterator iter = expected.begin(); iter != expected.end(); ++iter)
+            ASSERT(actual.count(*iter) == 1);
+    }
+
+    vector<CharType> prefix;
+    utf8StringToCharTypeVector(prefixes[0], prefix);
+    ASSERT(!PrefixActiveNodeSet::computeActiveNodeSetFromFrozenTrie(prefix, 3, readView, false));
+}
+
+// With swaps, the frozen trie must find the active nodes of the definition. The incremental
+// computation finds the same ones up to threshold 1 and a subset of them at threshold 2.
+void testActiveNodesWithSwaps(const Trie *trie, const vector<string> &prefixes)
+{
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+    for (unsigned editDistanceThreshold = 0; editDistanceThreshold <= 3; ++editDistanceThreshold) {
+        for (unsigned i = 0; i < prefixes.size(); ++i) {
+            // the prefix and the prefix with two adjacent characters swapped
+            string swappedPrefix = prefixes[i];
+            unsigned position = i % (swappedPrefix.size() - 1);
+            swap(swappedPrefix[position], swappedPrefix[position + 1]);
+            const string testedPrefixes[] = { prefixes[i], swappedPrefix };
+            for (unsigned j = 0; j < 2; ++j) {
+                set<ActiveNode> reference, actual, levenshteinReference, levenshteinActual;
+                getReferenceActiveNodes(readView, testedPrefixes[j], editDistanceThreshold, true, reference);
+                getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), testedPrefixes[j], editDistanceThreshold, actual, true);
+                ASSERT(reference == actual);
+                getReferenceActiveNodes(readView, testedPrefixes[j], editDistanceThreshold, false, levenshteinReference);
+                getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), testedPrefixes[j], editDistanceThreshold,
+                        levenshteinActual, false);
+                ASSERT(levenshteinReference == levenshteinActual);
+                if (editDistanceThreshold > 2)
+                    continue;
+
+                set<ActiveNode> expected, actualSet;
+                getActiveNodesFromTrie(readView, testedPrefixes[j], editDistanceThreshold, expected, true);
+                getActiveNodesFromFrozenActiveNodeSet(readView, testedPrefixes[j], editDistanceThreshold, actualSet, true);
+                ASSERT(actualSet == actual);
+                if (PrefixActiveNodeSet::incrementalComputationCanMissActiveNodes(editDistanceThreshold, true)) {
+                    for (set<ActiveNode>::const_iterator iter = expected.begin(); iter != expected.end(); ++iter)
+                        ASSERT(actual.count(*iter) == 1);
+                } else {
+                    ASSERT(expected == actual);
+                }
+            }
+        }
+    }
+
+    // "ana" reaches "naan" with an insertion and a swap, which the incremental computation misses
+    Trie *smallTrie = buildTrie(vector<string>(1, "naan"));
+    smallTrie->getTrieRootNode_ReadView(readView);
+    set<ActiveNode> expected, actual;
+    getActiveNodesFromTrie(readView, "ana", 2, expected, true);
+    getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), "ana", 2, actual, true);
+    ASSERT(actual.size() == expected.size() + 1);
+    delete smallTrie;
+}
+
+// prefixes longer than a machine word fall back to the dynamic programming rows
+// Characters from CHARTYPE_FUZZY_UPPERBOUND on, like Zhuyin, can only be matched, by the frozen
+// trie as by the incremental computation.
+void testActiveNodesWithExactOnlyCharacters()
+{
+    static const char *characters[] = { "a", "b", "c", "n", "\xe3\x84\x8e", "\xe3\x84\xa8", "\xe3\x84\xa5", "\xe3\x84\x97" };
+    const unsigned numberOfCharacters = sizeof(characters) / sizeof(characters[0]);
+    vector<string> keywords;
+    for (unsigned i = 0; i < 2000; ++i) {
+        string keyword;
+        for (unsigned length = 1 + rand() % 6; length > 0; --length)
+            keyword += characters[rand() % numberOfCharacters];
+        keywords.push_back(keyword);
+    }
+    Trie *trie = buildTrie(keywords);
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+
+    for (unsigned editDistanceThreshold = 0; editDistanceThreshold <= 2; ++editDistanceThreshold) {
+        for (unsigned i = 0; i < 300; ++i) {
+            // a keyword with a character replaced, or a random string
+            string prefix;
+            for (unsigned length = 1 + rand() % 6; length > 0; --length)
+                prefix += characters[rand() % numberOfCharacters];
+            if (i % 2 == 0)
+                prefix = keywords[i] + characters[i % numberOfCharacters];
+            for (unsigned supportSwapInEditDistance = 0; supportSwapInEditDistance < 2; ++supportSwapInEditDistance) {
+                set<ActiveNode> reference, expected, actual;
+                getReferenceActiveNodes(readView, prefix, editDistanceThreshold, supportSwapInEditDistance, reference);
+                getActiveNodesFromTrie(readView, prefix, editDistanceThreshold, expected, supportSwapInEditDistance);
+                getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), prefix, editDistanceThreshold, actual,
+                        supportSwapInEditDistance);
+                ASSERT(reference == actual);
+                if (PrefixActiveNodeSet::incrementalComputationCanMissActiveNodes(editDistanceThreshold,
+                        supportSwapInEditDistance)) {
+                    for (set<ActiveNode>::const_iterator iter = expected.begin(); iter != expected.end(); ++iter)
+                        ASSERT(actual.count(*iter) == 1);
+                } else {
+                    ASSERT(expected == actual);
+                }
+            }
+        }
+    }
+    delete trie;
+}
+
+void testLongPrefixes()
+{
+    vector<string> keywords;
+    for (unsigned i = 0; i < 50; ++i)
+        keywords.push_back(randomKeyword(60, 80));
+    Trie *trie = buildTrie(keywords);
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+
+    for (unsigned editDistanceThreshold = 0; editDistanceThreshold <= 2; ++editDistanceThreshold) {
+        for (unsigned i = 0; i < keywords.size(); ++i) {
+            string prefix = keywords[i].substr(0, 62 + i % 6);
+            if (i % 3 == 1)
+                prefix[40] = 'q';
+            else if (i % 3 == 2)
+                prefix.erase(30, 1);
+            set<ActiveNode> expected, actual;
+            getActiveNodesFromTrie(readView, prefix, editDistanceThreshold, expected);
+            getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), prefix, editDistanceThreshold, actual);
+            ASSERT(expected == actual);
+
+            // with swaps, and a swap in the prefix
+            if (i % 3 == 0)
+                swap(prefix[20], prefix[21]);
+            set<ActiveNode> reference, actualWithSwaps;
+            getReferenceActiveNodes(readView, prefix, editDistanceThreshold, true, reference);
+            getActiveNodesFromFrozenTrie(readView->getFrozenTrie(), prefix, editDistanceThreshold, actualWithSwaps, true);
+            ASSERT(reference == actualWithSwaps);
+        }
+    }
+    delete trie;
+}
+
+// the frozen trie of a merged read view must reflect the keywords added before the merge
+void testMerge()
+{
+    vector<string> keywords;
+    keywords.push_back("cancer");
+    keywords.push_back("canada");
+    keywords.push_back("cat");
+    Trie *trie = buildTrie(keywords);
+
+    unsigned invertedIndexOffset = 0;
+    trie->addKeyword_ThreadSafe(string("canteen"), invertedIndexOffset);
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+    vector<CharType> canteen;
+    utf8StringToCharTypeVector("canteen", canteen);
+    ASSERT(readView->getFrozenTrie()->findNode(canteen) == FrozenTrie::NOT_FOUND);
+
+    trie->merge(NULL, NULL, 0, false);
+    trie->getTrieRootNode_ReadView(readView);
+    ASSERT(readView->getFrozenTrie()->findNode(canteen) != FrozenTrie::NOT_FOUND);
+    keywords.push_back("canteen");
+    testFrozenLayout(trie, keywords);
+
+    // a merge that does not change the trie nodes shares the frozen trie, and its root
+    // is the root of the new read view
+    const FrozenTrie *frozenTrie = readView->getFrozenTrie();
+    trie->merge(NULL, NULL, 0, false);
+    TrieRootNodeSharedPtr sameReadView;
+    trie->getTrieRootNode_ReadView(sameReadView);
+    ASSERT(sameReadView != readView);
+    ASSERT(sameReadView->getFrozenTrie() == frozenTrie);
+    ASSERT(sameReadView->getFrozenTrieNode(FrozenTrie::ROOT_INDEX) == sameReadView->root);
+
+    // updating the histogram values rebuilds it
+    trie->merge(NULL, NULL, 0, true);
+    TrieRootNodeSharedPtr updatedReadView;
+    trie->getTrieRootNode_ReadView(updatedReadView);
+    ASSERT(updatedReadView->getFrozenTrie() != frozenTrie);
+    testFrozenLayout(trie, keywords);
+    delete trie;
+}
+
+double getElapsedSeconds(const timespec &start, const timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+void benchmark(const Trie *trie, const vector<string> &prefixes)
+{
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+    const FrozenTrie *frozenTrie = readView->getFrozenTrie();
+
+    unsigned numberOfNodes = trie->getNumberOfNodes();
+    cout << "Nodes: " << numberOfNodes << endl;
+    // the read view keeps the trie nodes, and the frozen trie is an extra copy of them
+    unsigned frozenBytes = frozenTrie->getNumberOfBytes();
+    cout << "Bytes per node, trie nodes: " << (double) (trie->getNumberOfBytes() - frozenBytes) / numberOfNodes
+            << ", added by the frozen trie: " << (double) frozenBytes / numberOfNodes
+            << " (search arrays: " << (double) frozenTrie->getNumberOfBytesOfSearchArrays() / numberOfNodes
+            << "), read view total: " << (double) trie->getNumberOfBytes() / numberOfNodes << endl;
+
+    for (unsigned editDistanceThreshold = 0; editDistanceThreshold <= 2; ++editDistanceThreshold) {
+        timespec start, end;
+        unsigned trieActiveNodes = 0, frozenActiveNodes = 0;
+
+        clock_gettime(CLOCK_REALTIME, &start);
+        for (unsigned i = 0; i < prefixes.size(); ++i) {
+            boost::shared_ptr<PrefixActiveNodeSet> activeNodeSet(
+                    new PrefixActiveNodeSet(readView, editDistanceThreshold, false));
+            for (unsigned j = 0; j < prefixes[i].size(); ++j)
+                activeNodeSet = activeNodeSet->computeActiveNodeSetIncrementally(prefixes[i][j]);
+            trieActiveNodes += activeNodeSet->getNumberOfActiveNodes();
+        }
+        clock_gettime(CLOCK_REALTIME, &end);
+        double trieSeconds = getElapsedSeconds(start, end);
+
+        clock_gettime(CLOCK_REALTIME, &start);
+        vector<FrozenActiveNode> activeNodes;
+        vector<CharType> prefix;
+        for (unsigned i = 0; i < prefixes.size(); ++i) {
+            utf8StringToCharTypeVector(prefixes[i], prefix);
+            activeNodes.clear();
+            frozenTrie->computeActiveNodes(prefix, editDistanceThreshold, false, activeNodes);
+            frozenActiveNodes += activeNodes.size();
+        }
+        clock_gettime(CLOCK_REALTIME, &end);
+        double frozenSeconds = getElapsedSeconds(start, end);
+
+        ASSERT(trieActiveNodes == frozenActiveNodes);
+        cout << "ed=" << editDistanceThreshold << ": " << prefixes.size() << " prefixes, "
+                << trieActiveNodes << " active nodes. Prefixes per second, TrieNode: "
+                << prefixes.size() / trieSeconds << ", frozen: " << prefixes.size() / frozenSeconds << endl;
+    }
+}
+
+// Measures the share of rebuilding the frozen trie in a merge that updates the histogram values.
+void benchmarkMerge(Trie *trie)
+{
+    const unsigned numberOfMerges = 5;
+    timespec start, end;
+
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (unsigned i = 0; i < numberOfMerges; ++i)
+        trie->merge(NULL, NULL, 0, true);
+    clock_gettime(CLOCK_REALTIME, &end);
+    double mergeSeconds = getElapsedSeconds(start, end) / numberOfMerges;
+
+    TrieRootNodeSharedPtr readView;
+    trie->getTrieRootNode_ReadView(readView);
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (unsigned i = 0; i < numberOfMerges; ++i)
+        FrozenTrie frozenTrie(readView->root);
+    clock_gettime(CLOCK_REALTIME, &end);
+    double freezeSeconds = getElapsedSeconds(start, end) / numberOfMerges;
+
+    cout << "Merge with histogram update: " << mergeSeconds * 1000 << " ms, of which building the frozen trie: "
+            << freezeSeconds * 1000 << " ms (" << 100 * freezeSeconds / mergeSeconds << "%)" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned numberOfKeywords = 20000;
+    if (argc > 2 && strcmp(argv[1], "--keywords") == 0)
+        numberOfKeywords = atoi(argv[2]);
+
+    srand(1);
+    vector<string> keywords;
+    for (unsigned i = 0; i < numberOfKeywords; ++i)
+        keywords.push_back(randomKeyword(2, 10));
+    vector<string> prefixes;
+    for (unsigned i = 0; i < 200; ++i)
+        prefixes.push_back(keywords[rand() % keywords.size()].substr(0, 2 + rand() % 5));
+
+    testMerge();
+    cout << "FrozenTrie merge test passed" << endl;
+
+    Trie *trie = buildTrie(keywords);
+    testFrozenLayout(trie, keywords);
+    cout << "FrozenTrie layout test passed" << endl;
+    testActiveNodes(trie, prefixes);
+    testActiveNodesWithSwaps(trie, prefixes);
+    testActiveNodesWithExactOnlyCharacters();
+    testLongPrefixes();
+    cout << "FrozenTrie active node test passed" << endl;
+
+    benchmark(trie, prefixes);
+    benchmarkMerge(trie);
+    delete trie;
+
+    cout << "\nFrozenTrie Unit Tests: Passed\n";
+    return 0;
+}
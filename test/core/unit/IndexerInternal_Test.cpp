@@ -38,6 +38,7 @@
 #include <functional>
 #include <vector>
 #include <cstring>
+#include <sstream>
 
 #include <time.h>
 #include <stdio.h>
@@ -191,6 +192,156 @@ void testIndexData()
     syn->free();
 }
 
+// Records added with tokens computed beforehand (as the parallel bulk loader does) must give the same
+// index as records analyzed by IndexData, and the chunked parallel commit must give the same ids and scores.
+void testBulkLoadOfAnalyzedRecords()
+{
+    Schema *schema = Schema::create(srch2::instantsearch::DefaultIndex);
+    schema->setPrimaryKey("article_id");
+    schema->setSearchableAttribute("article_title", 3);
+    schema->setSearchableAttribute("article_body", 1);
+
+    SynonymContainer *syn = SynonymContainer::getInstance("", SYNONYM_DONOT_KEEP_ORIGIN);
+    syn->init();
+    Analyzer *analyzer = new Analyzer(NULL, NULL, NULL, syn, "");
+
+    IndexData *serialIndexData = IndexData::create(".", analyzer, schema,
+            srch2::instantsearch::DISABLE_STEMMER_NORMALIZER);
+    IndexData *analyzedIndexData = IndexData::create(".", analyzer, schema,
+            srch2::instantsearch::DISABLE_STEMMER_NORMALIZER);
+
+    const unsigned numberOfRecords = 5000;
+    const unsigned numberOfWords = 300;
+    Record *record = new Record(schema);
+    for (unsigned i = 0; i < numberOfRecords; ++i) {
+        stringstream title, body;
+        for (unsigned j = 0; j < 3; ++j)
+            title << "t" << (i * 7 + j * 13) % numberOfWords << " ";
+        for (unsigned j = 0; j < 1 + i % 9; ++j)
+            body << "w" << (i * 31 + j * 17) % numberOfWords << " ";
+        record->clear();
+        record->setPrimaryKey(i + 1);
+        record->setSearchableAttributeValue("article_title", title.str());
+        record->setSearchableAttributeValue("article_body", body.str());
+        record->setRecordBoost(1 + i % 5);
+
+        ASSERT(serialIndexData->_addRecord(record, analyzer) == OP_SUCCESS);
+        map<string, TokenAttributeHits> tokenAttributeHitsMap;
+        analyzer->tokenizeRecord(record, tokenAttributeHitsMap);
+        ASSERT(analyzedIndexData->_addAnalyzedRecord(record, tokenAttributeHitsMap) == OP_SUCCESS);
+    }
+    // duplicate primary keys are rejected the same way
+    ASSERT(serialIndexData->_addRecord(record, analyzer) == OP_FAIL);
+    map<string, TokenAttributeHits> tokenAttributeHitsMap;
+    analyzer->tokenizeRecord(record, tokenAttributeHitsMap);
+    ASSERT(analyzedIndexData->_addAnalyzedRecord(record, tokenAttributeHitsMap) == OP_FAIL);
+
+    serialIndexData->finishBulkLoad();
+    analyzedIndexData->finishBulkLoad();
+
+    shared_ptr<vectorview<ForwardListPtr> > serialForwardListDirectory, analyzedForwardListDirectory;
+    serialIndexData->forwardIndex->getForwardListDirectory_ReadView(serialForwardListDirectory);
+    analyzedIndexData->forwardIndex->getForwardListDirectory_ReadView(analyzedForwardListDirectory);
+    for (unsigned recordId = 0; recordId < numberOfRecords; ++recordId) {
+        bool valid;
+        const ForwardList *serialForwardList = serialIndexData->forwardIndex->getForwardList(
+                serialForwardListDirectory, recordId, valid);
+        const ForwardList *analyzedForwardList = analyzedIndexData->forwardIndex->getForwardList(
+                analyzedForwardListDirectory, recordId, valid);
+        ASSERT(serialForwardList->getNumberOfKeywords() == analyzedForwardList->getNumberOfKeywords());
+        for (unsigned k = 0; k < serialForwardList->getNumberOfKeywords(); ++k) {
+            ASSERT(serialForwardList->getKeywordId(k) == analyzedForwardList->getKeywordId(k));
+            ASSERT(serialForwardList->getKeywordRecordStaticScore(k) ==
+                    analyzedForwardList->getKeywordRecordStaticScore(k));
+        }
+        (void)serialForwardList;
+        (void)analyzedForwardList;
+    }
+
+    typedef boost::shared_ptr<TrieRootNodeAndFreeList > TrieRootNodeSharedPtr;
+    TrieRootNodeSharedPtr serialRoot, analyzedRoot;
+    serialIndexData->trie->getTrieRootNode_ReadView(serialRoot);
+    analyzedIndexData->trie->getTrieRootNode_ReadView(analyzedRoot);
+    shared_ptr<vectorview<InvertedListContainerPtr> > serialInvertedListDirectory, analyzedInvertedListDirectory;
+    serialIndexData->invertedIndex->getInvertedIndexDirectory_ReadView(serialInvertedListDirectory);
+    analyzedIndexData->invertedIndex->getInvertedIndexDirectory_ReadView(analyzedInvertedListDirectory);
+    for (unsigned w = 0; w < numberOfWords; ++w) {
+        for (unsigned prefix = 0; prefix < 2; ++prefix) {
+            stringstream keyword;
+            keyword << (prefix == 0 ? "t" : "w") << w;
+            const TrieNode *serialNode = serialIndexData->trie->getTrieNodeFromUtf8String(serialRoot->root, keyword.str());
+            const TrieNode *analyzedNode = analyzedIndexData->trie->getTrieNodeFromUtf8String(analyzedRoot->root, keyword.str());
+            ASSERT((serialNode == NULL) == (analyzedNode == NULL));
+            if (serialNode == NULL)
+                continue;
+            ASSERT(serialNode->getId() == analyzedNode->getId());
+            shared_ptr<vectorview<unsigned> > serialList, analyzedList;
+            serialIndexData->invertedIndex->getInvertedListReadView(serialInvertedListDirectory,
+                    serialNode->getInvertedListOffset(), serialList);
+            analyzedIndexData->invertedIndex->getInvertedListReadView(analyzedInvertedListDirectory,
+                    analyzedNode->getInvertedListOffset(), analyzedList);
+            ASSERT(serialList->size() > 0 && serialList->size() == analyzedList->size());
+            for (unsigned i = 0; i < serialList->size(); ++i)
+                ASSERT(serialList->getElement(i) == analyzedList->getElement(i));
+        }
+    }
+
+    delete record;
+    delete serialIndexData;
+    delete analyzedIndexData;
+    delete analyzer;
+    delete schema;
+    syn->free();
+}
+
+// A batch of analyzed records gets the same return values as adding the records one by one, and the
+// records are searchable after the commit.
+void testBatchOfAnalyzedRecords()
+{
+    Schema *schema = Schema::create(srch2::instantsearch::DefaultIndex);
+    schema->setPrimaryKey("article_id");
+    schema->setSearchableAttribute("article_title", 3);
+
+    SynonymContainer *syn = SynonymContainer::getInstance("", SYNONYM_DONOT_KEEP_ORIGIN);
+    syn->init();
+    Analyzer *analyzer = new Analyzer(NULL, NULL, NULL, syn, "");
+    IndexMetaData *indexMetaData = new IndexMetaData( new CacheManager(), 3, 5, 1, 5, ".");
+    Indexer *index = Indexer::create(indexMetaData, analyzer, schema);
+
+    const unsigned numberOfRecords = 100;
+    vector<const Record *> records;
+    vector<map<string, TokenAttributeHits> > tokenAttributeHitsMaps(numberOfRecords + 1);
+    for (unsigned i = 0; i <= numberOfRecords; ++i) {
+        Record *record = new Record(schema);
+        // the last record has the primary key of the first one
+        record->setPrimaryKey(i % numberOfRecords + 1);
+        stringstream title;
+        title << "title" << i;
+        record->setSearchableAttributeValue("article_title", title.str());
+        analyzer->tokenizeRecord(record, tokenAttributeHitsMaps[i]);
+        records.push_back(record);
+    }
+    vector<INDEXWRITE_RETVAL> returnValues;
+    index->addAnalyzedRecords(records, tokenAttributeHitsMaps, returnValues);
+    ASSERT(returnValues.size() == numberOfRecords + 1);
+    for (unsigned i = 0; i < numberOfRecords; ++i)
+        ASSERT(returnValues[i] == OP_SUCCESS);
+    ASSERT(returnValues[numberOfRecords] == OP_FAIL);
+
+    index->commit();
+    ASSERT(index->getNumberOfDocumentsInIndex() == numberOfRecords);
+    ASSERT(index->lookupRecord("1") == LU_PRESENT_IN_READVIEW_AND_WRITEVIEW);
+    ASSERT(index->lookupRecord("100") == LU_PRESENT_IN_READVIEW_AND_WRITEVIEW);
+
+    for (unsigned i = 0; i < records.size(); ++i)
+        delete records[i];
+    delete index;
+    delete indexMetaData;
+    delete analyzer;
+    delete schema;
+    syn->free();
+}
+
 void test1()
 {
     Schema *schema = Schema::create(srch2::instantsearch::DefaultIndex);
@@ -380,6 +531,8 @@ int main(int argc, char *argv[])
     //test3();
 
     testIndexData();
+    testBulkLoadOfAnalyzedRecords();
+    testBatchOfAnalyzedRecords();
     cout << "IndexerInternal Unit Tests: Passed\n";
 
     return 0;
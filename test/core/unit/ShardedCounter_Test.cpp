@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Tests the counters and histograms of util/ShardedCounter.h: the sums of the shards while many
+ * threads add to them, the buckets of the histogram values, and the JSON of a histogram.
+ */
+
+#include "util/ShardedCounter.h"
+#include "util/Assert.h"
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <assert.h>
+
+using namespace std;
+using namespace srch2::util;
+using namespace srch2::instantsearch;
+
+static const unsigned NUMBER_OF_THREADS = 8;
+static const unsigned NUMBER_OF_ADDS = 100000;
+
+void addToCounter(ShardedCounter *counter, unsigned *shardIndex)
+{
+    *shardIndex = ShardedCounter::getShardIndexOfCurrentThread();
+    for (unsigned i = 0; i < NUMBER_OF_ADDS; ++i)
+        counter->add();
+    // a thread keeps its shard
+    ASSERT(*shardIndex == ShardedCounter::getShardIndexOfCurrentThread());
+}
+
+void testCounter()
+{
+    ShardedCounter counter(5);
+    ASSERT(counter.get() == 5);
+    counter.add(10);
+    counter.addToShard(ShardedCounter::NUMBER_OF_SHARDS + 3, 2);
+    ASSERT(counter.get() == 17);
+
+    // more threads than shards share some shards, and no add is lost
+    ShardedCounter sharedCounter;
+    const unsigned numberOfThreads = ShardedCounter::NUMBER_OF_SHARDS + NUMBER_OF_THREADS;
+    vector<unsigned> shardIndexes(numberOfThreads);
+    boost::thread_group threads;
+    for (unsigned i = 0; i < numberOfThreads; ++i)
+        threads.create_thread(boost::bind(addToCounter, &sharedCounter, &shardIndexes[i]));
+    threads.join_all();
+    ASSERT(sharedCounter.get() == (uint64_t) numberOfThreads * NUMBER_OF_ADDS);
+    for (unsigned i = 0; i < numberOfThreads; ++i)
+        ASSERT(shardIndexes[i] < ShardedCounter::NUMBER_OF_SHARDS);
+}
+
+void addToHistogram(ShardedHistogram *histogram)
+{
+    for (unsigned i = 0; i < NUMBER_OF_ADDS; ++i)
+        histogram->add(i % 8);
+}
+
+void testHistogram()
+{
+    ASSERT(ShardedHistogram::getBucket(0) == 0);
+    ASSERT(ShardedHistogram::getBucket(1) == 1);
+    ASSERT(ShardedHistogram::getBucket(2) == 2);
+    ASSERT(ShardedHistogram::getBucket(3) == 2);
+    ASSERT(ShardedHistogram::getBucket(4) == 3);
+    ASSERT(ShardedHistogram::getBucket(1023) == 10);
+    ASSERT(ShardedHistogram::getBucket(1024) == 11);
+    ASSERT(ShardedHistogram::getBucket(~(uint64_t) 0) == ShardedHistogram::NUMBER_OF_BUCKETS - 1);
+
+    ShardedHistogram histogram;
+    histogram.add(1);
+    histogram.add(4);
+    ShardedHistogram::Snapshot snapshot;
+    histogram.getSnapshot(snapshot);
+    ASSERT(snapshot.count == 2);
+    ASSERT(snapshot.total == 5);
+    ASSERT(snapshot.max == 4);
+    ASSERT(snapshot.buckets[1] == 1);
+    ASSERT(snapshot.buckets[3] == 1);
+    string json = histogram.getJsonString("us");
+    ASSERT(json.find("{\"count\":2,\"total_us\":5,\"max_us\":4,\"histogram_us\":{\"<1\":0,\"<2\":1,\"<4\":0,\"<8\":1,") == 0);
+    ASSERT(json.find("\">=4194304\":0}}") != string::npos);
+
+    // the values 0 to 7, added by several threads
+    ShardedHistogram sharedHistogram;
+    boost::thread_group threads;
+    for (unsigned i = 0; i < NUMBER_OF_THREADS; ++i)
+        threads.create_thread(boost::bind(addToHistogram, &sharedHistogram));
+    threads.join_all();
+    sharedHistogram.getSnapshot(snapshot);
+    const uint64_t numberOfValues = (uint64_t) NUMBER_OF_THREADS * NUMBER_OF_ADDS;
+    ASSERT(snapshot.count == numberOfValues);
+    ASSERT(snapshot.total == numberOfValues / 8 * 28);
+    ASSERT(snapshot.max == 7);
+    ASSERT(snapshot.buckets[0] == numberOfValues / 8);
+    ASSERT(snapshot.buckets[1] == numberOfValues / 8);
+    ASSERT(snapshot.buckets[2] == numberOfValues / 4);
+    ASSERT(snapshot.buckets[3] == numberOfValues / 2);
+}
+
+int main(int argc, char *argv[])
+{
+    testCounter();
+    testHistogram();
+
+    cout << "ShardedCounter Unit Tests: Passed" << endl;
+    return 0;
+}
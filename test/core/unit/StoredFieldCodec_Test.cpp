@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/StoredFieldCodec.h"
+#include "util/RecordSerializer.h"
+#include "util/RecordSerializerUtil.h"
+#include "util/Assert.h"
+#include <instantsearch/Schema.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace srch2::instantsearch;
+using namespace srch2::util;
+
+void checkRoundTrip(const string &value, const string *dictionary, StoredFieldCodec::Encoding expectedEncoding)
+{
+    string encoded;
+    StoredFieldCodec::encode(value, dictionary, encoded);
+    ASSERT(encoded[0] == (char) expectedEncoding);
+
+    string decoded;
+    ASSERT(StoredFieldCodec::decode(encoded.data(), encoded.size(), decoded));
+    ASSERT(decoded == value);
+
+    const char *valuePointer;
+    unsigned valueLength;
+    string buffer;
+    ASSERT(StoredFieldCodec::decode(encoded.data(), encoded.size(), valuePointer, valueLength, buffer));
+    ASSERT(string(valuePointer, valueLength) == value);
+    // a raw value is read in place
+    if (expectedEncoding == StoredFieldCodec::STORED_FIELD_RAW) {
+        ASSERT(valuePointer == encoded.data() + 1);
+        ASSERT(buffer.empty());
+    }
+}
+
+// short values and values that do not compress are stored raw, the others are compressed
+void testEncodings()
+{
+    checkRoundTrip("", NULL, StoredFieldCodec::STORED_FIELD_RAW);
+    checkRoundTrip("Diplomate Cafe", NULL, StoredFieldCodec::STORED_FIELD_RAW);
+
+    string repeated;
+    for (unsigned i = 0; i < 20; ++i) {
+        repeated += "yum yum ";
+    }
+    checkRoundTrip(repeated, NULL, StoredFieldCodec::STORED_FIELD_SNAPPY);
+
+    string random;
+    srand(7);
+    for (unsigned i = 0; i < 200; ++i) {
+        random += (char) (rand() % 256);
+    }
+    checkRoundTrip(random, NULL, StoredFieldCodec::STORED_FIELD_RAW);
+}
+
+// a dictionary compresses small values that do not compress on their own
+void testDictionary()
+{
+    string dictionary = "Los Angeles restaurant cafe Italian Chinese Mexican food delivery";
+    StoredFieldCodec::registerDictionary(dictionary);
+
+    string value = "Italian restaurant Los Angeles";
+    string encoded;
+    StoredFieldCodec::encode(value, NULL, encoded);
+    ASSERT(encoded[0] == (char) StoredFieldCodec::STORED_FIELD_RAW);
+    string encodedWithDictionary;
+    StoredFieldCodec::encode(value, &dictionary, encodedWithDictionary);
+    ASSERT(encodedWithDictionary[0] == (char) StoredFieldCodec::STORED_FIELD_DEFLATE);
+    ASSERT(encodedWithDictionary.size() < encoded.size());
+    checkRoundTrip(value, &dictionary, StoredFieldCodec::STORED_FIELD_DEFLATE);
+
+    // a value encoded with a dictionary which is not registered cannot be decoded
+    string unknownDictionary = dictionary + " Japanese";
+    StoredFieldCodec::encode(value, &unknownDictionary, encoded);
+    ASSERT(encoded[0] == (char) StoredFieldCodec::STORED_FIELD_DEFLATE);
+    string decoded;
+    ASSERT(!StoredFieldCodec::decode(encoded.data(), encoded.size(), decoded));
+    ASSERT(decoded.empty());
+}
+
+void testCorruptValues()
+{
+    string decoded;
+    ASSERT(!StoredFieldCodec::decode("", 0, decoded));
+    const char unknownEncoding[] = { 9, 'a', 'b' };
+    ASSERT(!StoredFieldCodec::decode(unknownEncoding, sizeof(unknownEncoding), decoded));
+    const char truncatedDeflate[] = { StoredFieldCodec::STORED_FIELD_DEFLATE, 1 };
+    ASSERT(!StoredFieldCodec::decode(truncatedDeflate, sizeof(truncatedDeflate), decoded));
+}
+
+// only the attributes to return are decoded when a stored record is converted to JSON
+void testStoredRecordToJSON()
+{
+    Schema *schema = Schema::create(srch2::instantsearch::DefaultIndex);
+    schema->setPrimaryKey("id");
+    schema->setSearchableAttribute("name");
+    schema->setSearchableAttribute("description");
+    schema->setSearchableAttribute("tags", 1, true);
+    Schema *storedSchema = Schema::create();
+    RecordSerializerUtil::populateStoredSchema(storedSchema, schema);
+
+    string description;
+    for (unsigned i = 0; i < 20; ++i) {
+        description += "a \"quoted\" word ";
+    }
+    RecordSerializer serializer(*storedSchema);
+    string encoded;
+    StoredFieldCodec::encode(string("Diplomate Cafe"), NULL, encoded);
+    serializer.addSearchableAttribute("name", encoded);
+    StoredFieldCodec::encode(description, NULL, encoded);
+    ASSERT(encoded[0] == (char) StoredFieldCodec::STORED_FIELD_SNAPPY);
+    serializer.addSearchableAttribute("description", encoded);
+    StoredFieldCodec::encode(string("coffee $$ tea"), NULL, encoded);
+    serializer.addSearchableAttribute("tags", encoded);
+    RecordSerializerBuffer buffer = serializer.serialize();
+    char *data = new char[buffer.length];
+    memcpy(data, buffer.start, buffer.length);
+    StoredRecordBuffer storedRecord(data, buffer.length);
+
+    string json;
+    vector<string> attributesToReturn;
+    attributesToReturn.push_back("name");
+    attributesToReturn.push_back("tags");
+    RecordSerializerUtil::convertCompactToJSONString(storedSchema, storedRecord, "1", json, &attributesToReturn);
+    ASSERT(json == "{\"id\":\"1\",\"name\":\"Diplomate Cafe\",\"tags\":[\"coffee\",\"tea\"]}");
+
+    json.clear();
+    attributesToReturn.clear();
+    attributesToReturn.push_back("description");
+    RecordSerializerUtil::convertCompactToJSONString(storedSchema, storedRecord, "1", json, &attributesToReturn);
+    string expectedDescription;
+    for (unsigned i = 0; i < 20; ++i) {
+        expectedDescription += "a \\\"quoted\\\" word ";
+    }
+    ASSERT(json == "{\"id\":\"1\",\"description\":\"" + expectedDescription + "\"}");
+
+    delete storedSchema;
+    delete schema;
+}
+
+int main(int argc, char *argv[])
+{
+    testEncodings();
+    cout << "StoredFieldCodec encodings test passed" << endl;
+    testDictionary();
+    cout << "StoredFieldCodec dictionary test passed" << endl;
+    testCorruptValues();
+    cout << "StoredFieldCodec corrupt values test passed" << endl;
+    testStoredRecordToJSON();
+    cout << "StoredFieldCodec stored record to JSON test passed" << endl;
+    return 0;
+}
@@ -28,6 +28,7 @@
 #include "index/Trie.h"
 #include "util/Assert.h"
 #include "serialization/Serializer.h"
+#include <boost/weak_ptr.hpp>
 #include <iostream>
 #include <functional>
 #include <vector>
@@ -745,6 +746,46 @@ void test5()
     delete trie1;
 }
 
+// Removes the nodes of a deleted keyword while a reader holds the read view. The reader keeps seeing
+// the old trie, and the objects retired with that read view live until the reader is gone.
+void test6()
+{
+    Trie *trie1 = new Trie();
+    unsigned invertedIndexOffset;
+    trie1->addKeyword("cancer", invertedIndexOffset);
+    trie1->addKeyword("canada", invertedIndexOffset);
+    trie1->addKeyword("cat", invertedIndexOffset);
+    trie1->commit();
+    trie1->finalCommit_finalizeHistogramInformation(NULL, NULL, 0);
+
+    typedef boost::shared_ptr<TrieRootNodeAndFreeList > TrieRootNodeSharedPtr;
+    TrieRootNodeSharedPtr oldReadView;
+    trie1->getTrieRootNode_ReadView(oldReadView);
+    boost::shared_ptr<int> retiredObject(new int(0));
+    boost::weak_ptr<int> retiredObjectTracker(retiredObject);
+    trie1->retireWithReadView(retiredObject);
+    retiredObject.reset();
+
+    trie1->addEmptyLeafNodeId(trie1->getTrieNodeFromUtf8String(oldReadView->root, "canada")->getId());
+    trie1->merge(NULL, NULL, 0, false);
+    trie1->removeDeletedNodes();
+
+    TrieRootNodeSharedPtr newReadView;
+    trie1->getTrieRootNode_ReadView(newReadView);
+    ASSERT(trie1->getTrieNodeFromUtf8String(newReadView->root, "canada") == NULL);
+    ASSERT(trie1->getTrieNodeFromUtf8String(newReadView->root, "cancer")->isTerminalNode());
+    ASSERT(trie1->getTrieNodeFromUtf8String(newReadView->root, "cat")->isTerminalNode());
+    ASSERT(trie1->getTrieNodeFromUtf8String(oldReadView->root, "canada")->isTerminalNode());
+    ASSERT(!retiredObjectTracker.expired());
+
+    // the next merge frees the old read views without readers
+    oldReadView.reset();
+    trie1->merge(NULL, NULL, 0, false);
+    ASSERT(retiredObjectTracker.expired());
+
+    delete trie1;
+}
+
 int main(int argc, char *argv[]) {
 
     bool verbose = false;
@@ -773,6 +814,10 @@ int main(int argc, char *argv[]) {
     // test the function getAncestorPrefixes()
     test5();
 
+    cout << "test6" << endl;
+    // test removing the nodes of deleted keywords while a reader holds the read view
+    test6();
+
     cout << "\nTrie Unit Tests: Passed\n";
 
     return 0;
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "operation/physical_plan/PhysicalPlan.h"
+#include "operation/physical_plan/PhysicalOperators.h"
+#include "operation/physical_plan/ParallelExchangeOperator.h"
+#include "operation/physical_plan/UnionLowestLevelTermVirtualListOperator.h"
+#include "operation/QueryEvaluatorInternal.h"
+#include "operation/QueryOptimizer.h"
+#include "operation/HistogramManager.h"
+#include "analyzer/AnalyzerInternal.h"
+#include "util/WorkStealingThreadPool.h"
+#include <instantsearch/Schema.h>
+#include <instantsearch/Record.h>
+#include <instantsearch/LogicalPlan.h>
+#include "util/Assert.h"
+
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <stdexcept>
+
+using namespace srch2::instantsearch;
+using srch2::util::WorkStealingThreadPool;
+using srch2::util::TaskGroup;
+
+typedef pair<unsigned, float> RecordIdAndScore;
+
+boost::mutex counterMutex;
+unsigned counter = 0;
+
+void increment(){
+	boost::unique_lock<boost::mutex> lock(counterMutex);
+	counter++;
+}
+
+// a task which waits for tasks of its own, the waiting thread must run them if all workers are busy
+void runNestedTasks(WorkStealingThreadPool * pool, unsigned depth){
+	increment();
+	if(depth == 0){
+		return;
+	}
+	TaskGroup group(pool);
+	for(unsigned i = 0; i < 3; ++i){
+		group.run(boost::bind(runNestedTasks, pool, depth - 1));
+	}
+	group.wait();
+}
+
+boost::condition_variable workerBlockedOrReleased;
+bool isWorkerBlocked = false;
+bool isWorkerReleased = false;
+
+void blockWorker(){
+	boost::unique_lock<boost::mutex> lock(counterMutex);
+	isWorkerBlocked = true;
+	workerBlockedOrReleased.notify_all();
+	while(!isWorkerReleased){
+		workerBlockedOrReleased.wait(lock);
+	}
+}
+
+bool otherRequestTaskRan = false;
+
+void runOtherRequestTask(){
+	boost::unique_lock<boost::mutex> lock(counterMutex);
+	otherRequestTaskRan = true;
+}
+
+void throwException(){
+	throw std::runtime_error("task failed");
+}
+
+// a thread waiting for its group only runs the tasks of that group
+void testWaitRunsOnlyOwnTasks(){
+	WorkStealingThreadPool pool(1);
+	pool.submit(blockWorker);
+	{
+		boost::unique_lock<boost::mutex> lock(counterMutex);
+		while(!isWorkerBlocked){
+			workerBlockedOrReleased.wait(lock);
+		}
+	}
+	pool.submit(runOtherRequestTask);
+
+	counter = 0;
+	{
+		TaskGroup group(&pool);
+		for(unsigned i = 0; i < 10; ++i){
+			group.run(increment);
+		}
+		// the exception of a task is thrown again by wait, once the other tasks are finished
+		group.run(throwException);
+		bool isThrown = false;
+		try{
+			group.wait();
+		}catch(const std::runtime_error & e){
+			isThrown = string(e.what()) == "task failed";
+		}
+		ASSERT(isThrown);
+	}
+	ASSERT(counter == 10);
+	{
+		boost::unique_lock<boost::mutex> lock(counterMutex);
+		ASSERT(!otherRequestTaskRan);
+		isWorkerReleased = true;
+	}
+	workerBlockedOrReleased.notify_all();
+}
+
+void testThreadPool(){
+	WorkStealingThreadPool pool(2);
+	ASSERT(pool.getNumberOfThreads() == 2);
+
+	counter = 0;
+	TaskGroup group(&pool);
+	for(unsigned i = 0; i < 10000; ++i){
+		group.run(increment);
+	}
+	group.wait();
+	ASSERT(counter == 10000);
+
+	// 1 + 3 + 9 + 27 + 81 tasks, more waiting tasks than workers
+	counter = 0;
+	group.run(boost::bind(runNestedTasks, &pool, 4));
+	group.wait();
+	ASSERT(counter == 121);
+
+	// a group can be used again after wait
+	counter = 0;
+	group.run(increment);
+	group.wait();
+	ASSERT(counter == 1);
+}
+
+/*
+ * Record i has "dog" if i is even and "cat" if i%3 is 0.
+ */
+Indexer * buildIndex(IndexMetaData * indexMetaData){
+	Schema *schema = Schema::create(srch2::instantsearch::DefaultIndex);
+	schema->setPrimaryKey("article_id");
+	schema->setSearchableAttribute("article_title", 7);
+	Record *record = new Record(schema);
+	Analyzer *analyzer = new Analyzer(NULL, NULL, NULL, NULL, "");
+	Indexer *indexer = Indexer::create(indexMetaData, analyzer, schema);
+
+	for(unsigned i = 0; i < 3000; ++i){
+		stringstream title;
+		if(i % 2 == 0) title << "dog ";
+		if(i % 3 == 0) title << "cat ";
+		title << "title";
+		record->clear();
+		record->setPrimaryKey(i + 1);
+		record->setSearchableAttributeValue("article_title", title.str());
+		record->setRecordBoost(1 + (i * 7919) % 100);
+		indexer->addRecord(record, analyzer);
+	}
+	indexer->commit();
+
+	delete record;
+	delete analyzer;
+	delete schema;
+	return indexer;
+}
+
+PhysicalPlanOptimizationNode * buildSortedTermNode(QueryEvaluatorInternal * queryEvaluator, LogicalPlanNode * termNode){
+	PhysicalOperatorFactory * operatorFactory = queryEvaluator->getPhysicalOperatorFactory();
+	UnionLowestLevelTermVirtualListOperator * tvlOp = operatorFactory->createUnionLowestLevelTermVirtualListOperator();
+	UnionLowestLevelTermVirtualListOptimizationOperator * tvlOpOp =
+			operatorFactory->createUnionLowestLevelTermVirtualListOptimizationOperator();
+	tvlOp->setPhysicalPlanOptimizationNode(tvlOpOp);
+	tvlOpOp->setExecutableNode(tvlOp);
+	tvlOpOp->setLogicalPlanNode(termNode);
+
+	SortByIdOperator * sortOp = operatorFactory->createSortByIdOperator();
+	SortByIdOptimizationOperator * sortOpOp = operatorFactory->createSortByIdOptimizationOperator();
+	sortOp->setPhysicalPlanOptimizationNode(sortOpOp);
+	sortOpOp->setExecutableNode(sortOp);
+	sortOpOp->setLogicalPlanNode(termNode);
+	sortOpOp->addChild(tvlOpOp);
+	return sortOpOp;
+}
+
+PhysicalPlanOptimizationNode * buildExchangeNode(QueryEvaluatorInternal * queryEvaluator, PhysicalPlanOptimizationNode * child){
+	PhysicalOperatorFactory * operatorFactory = queryEvaluator->getPhysicalOperatorFactory();
+	ParallelExchangeOperator * exchangeOp = operatorFactory->createParallelExchangeOperator();
+	ParallelExchangeOptimizationOperator * exchangeOpOp = operatorFactory->createParallelExchangeOptimizationOperator();
+	exchangeOp->setPhysicalPlanOptimizationNode(exchangeOpOp);
+	exchangeOpOp->setExecutableNode(exchangeOp);
+	exchangeOpOp->setLogicalPlanNode(child->getLogicalPlanNode());
+	exchangeOpOp->addChild(child);
+	ASSERT(exchangeOpOp->validateChildren());
+	return exchangeOpOp;
+}
+
+// cat AND dog, by MergeSortedById, with or without exchange operators on top of the sorted children
+void getMergeResults(QueryEvaluatorInternal * queryEvaluator, LogicalPlanNode * andNode, bool parallel,
+		vector<RecordIdAndScore> & results){
+	PhysicalOperatorFactory * operatorFactory = queryEvaluator->getPhysicalOperatorFactory();
+	MergeSortedByIDOperator * mergeOp = operatorFactory->createMergeSortedByIDOperator();
+	MergeSortedByIDOptimizationOperator * mergeOpOp = operatorFactory->createMergeSortedByIDOptimizationOperator();
+	mergeOp->setPhysicalPlanOptimizationNode(mergeOpOp);
+	mergeOpOp->setExecutableNode(mergeOp);
+	mergeOpOp->setLogicalPlanNode(andNode);
+	for(unsigned i = 0; i < andNode->children.size(); ++i){
+		PhysicalPlanOptimizationNode * child = buildSortedTermNode(queryEvaluator, andNode->children[i]);
+		if(parallel){
+			child = buildExchangeNode(queryEvaluator, child);
+		}
+		mergeOpOp->addChild(child);
+	}
+
+	PhysicalPlanExecutionParameters params(10, false, 0.5, SearchTypeGetAllResultsQuery);
+	mergeOp->open(queryEvaluator, params);
+	while(true){
+		PhysicalPlanRecordItem * record = mergeOp->getNext(params);
+		if(record == NULL){
+			break;
+		}
+		results.push_back(make_pair(record->getRecordId(), record->getRecordRuntimeScore()));
+	}
+	mergeOp->close(params);
+}
+
+bool hasExchangeOperator(PhysicalPlanOptimizationNode * node){
+	if(node->getType() == PhysicalPlanNode_ParallelExchange){
+		return true;
+	}
+	for(unsigned i = 0; i < node->getChildrenCount(); ++i){
+		if(hasExchangeOperator(node->getChildAt(i))){
+			return true;
+		}
+	}
+	return false;
+}
+
+// returns true if the optimizer put exchange operators in the plan
+bool getOptimizedPlanResults(QueryEvaluatorInternal * queryEvaluator, LogicalPlan * logicalPlan,
+		vector<RecordIdAndScore> & results){
+	PhysicalPlanExecutionParameters params(3000, false, 0.5, SearchTypeGetAllResultsQuery);
+	QueryOptimizer queryOptimizer(queryEvaluator);
+	PhysicalPlan physicalPlan(queryEvaluator);
+	physicalPlan.setExecutionParameters(&params);
+	queryOptimizer.buildAndOptimizePhysicalPlan(physicalPlan, logicalPlan, 0);
+	PhysicalPlanNode * root = physicalPlan.getPlanTree();
+	root->open(queryEvaluator, params);
+	while(true){
+		PhysicalPlanRecordItem * record = root->getNext(params);
+		if(record == NULL){
+			break;
+		}
+		results.push_back(make_pair(record->getRecordId(), record->getRecordRuntimeScore()));
+	}
+	root->close(params);
+	return hasExchangeOperator(root->getPhysicalPlanOptimizationNode());
+}
+
+/*
+ * q = cat AND dog
+ * The records and scores must not change when the children of the AND are opened in parallel.
+ */
+void testParallelExchange(QueryEvaluatorInternal * queryEvaluator){
+	LogicalPlan logicalPlan;
+	LogicalPlanNode * andNode = logicalPlan.createOperatorLogicalPlanNode(LogicalPlanNodeTypeAnd);
+	andNode->children.push_back(logicalPlan.createTermLogicalPlanNode("cat", TERM_TYPE_COMPLETE, 1, 1, 0,
+			vector<unsigned>(), ATTRIBUTES_OP_OR));
+	andNode->children.push_back(logicalPlan.createTermLogicalPlanNode("dog", TERM_TYPE_COMPLETE, 1, 1, 0,
+			vector<unsigned>(), ATTRIBUTES_OP_OR));
+	logicalPlan.setTree(andNode);
+	logicalPlan.setFuzzy(false);
+	logicalPlan.setQueryType(SearchTypeGetAllResultsQuery);
+	HistogramManager histogramManager(queryEvaluator);
+	histogramManager.annotate(&logicalPlan);
+
+	vector<RecordIdAndScore> serialResults;
+	getMergeResults(queryEvaluator, andNode, false, serialResults);
+	ASSERT(serialResults.size() == 500);
+
+	vector<RecordIdAndScore> parallelResults;
+	getMergeResults(queryEvaluator, andNode, true, parallelResults);
+	ASSERT(parallelResults == serialResults);
+
+	// the plan chosen by the optimizer, with and without exchange operators
+	vector<RecordIdAndScore> optimizedSerialResults;
+	queryEvaluator->getQueryEvaluatorRuntimeParametersContainer()->parallelExecutionMinimumNumberOfResults = 100000;
+	ASSERT(! getOptimizedPlanResults(queryEvaluator, &logicalPlan, optimizedSerialResults));
+	ASSERT(optimizedSerialResults.size() == serialResults.size());
+
+	vector<RecordIdAndScore> optimizedParallelResults;
+	queryEvaluator->getQueryEvaluatorRuntimeParametersContainer()->parallelExecutionMinimumNumberOfResults = 0;
+	bool hasExchange = getOptimizedPlanResults(queryEvaluator, &logicalPlan, optimizedParallelResults);
+	ASSERT(hasExchange == (WorkStealingThreadPool::getSharedPool()->getNumberOfThreads() >= 2));
+	ASSERT(optimizedParallelResults == optimizedSerialResults);
+}
+
+int main(int argc, char *argv[]) {
+	testThreadPool();
+	testWaitRunsOnlyOwnTasks();
+
+	IndexMetaData *indexMetaData = new IndexMetaData(new CacheManager(), 3, 5, 1, 5, ".");
+	Indexer * indexer = buildIndex(indexMetaData);
+	QueryEvaluatorRuntimeParametersContainer runtimeParameters;
+	QueryEvaluator * queryEvaluator = new QueryEvaluator(indexer, &runtimeParameters);
+
+	queryEvaluator->impl->readerPreEnter();
+	testParallelExchange(queryEvaluator->impl);
+	queryEvaluator->impl->readerPreExit();
+
+	delete queryEvaluator;
+	delete indexer;
+	delete indexMetaData;
+	cout << "ParallelExchange_Test: Passed\n" << endl;
+}
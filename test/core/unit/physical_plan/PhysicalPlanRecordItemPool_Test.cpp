@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "operation/physical_plan/PhysicalPlan.h"
+#include "operation/PhysicalPlanRecordItemFactory.h"
+#include "util/Arena.h"
+#include "util/Assert.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace srch2::instantsearch;
+using srch2::util::Arena;
+
+// Allocations are aligned, do not overlap, and big ones get a chunk of their own.
+void testArena(){
+	Arena arena(64, 1024);
+	ASSERT(arena.allocateArray<unsigned>(0) == NULL);
+	vector<unsigned *> arrays;
+	for(unsigned i = 0 ; i < 1000 ; ++i){
+		unsigned * array = arena.allocateArray<unsigned>(i % 7 + 1);
+		ASSERT(((size_t)array) % __alignof__(unsigned) == 0);
+		for(unsigned j = 0 ; j < i % 7 + 1 ; ++j){
+			array[j] = i;
+		}
+		arrays.push_back(array);
+	}
+	double * big = arena.allocateArray<double>(1000);
+	ASSERT(((size_t)big) % __alignof__(double) == 0);
+	for(unsigned j = 0 ; j < 1000 ; ++j){
+		big[j] = j;
+	}
+	for(unsigned i = 0 ; i < arrays.size() ; ++i){
+		for(unsigned j = 0 ; j < i % 7 + 1 ; ++j){
+			ASSERT(arrays[i][j] == i);
+		}
+	}
+
+	// reset keeps only the largest chunk, which serves the next allocations
+	size_t bytesBeforeReset = arena.getNumberOfBytes();
+	arena.reset();
+	ASSERT(arena.getNumberOfBytes() >= 1000 * sizeof(double));
+	ASSERT(arena.getNumberOfBytes() < bytesBeforeReset);
+	size_t bytesAfterReset = arena.getNumberOfBytes();
+	arena.allocateArray<double>(500);
+	ASSERT(arena.getNumberOfBytes() == bytesAfterReset);
+}
+
+void fillItem(PhysicalPlanRecordItem * item, unsigned recordId){
+	item->setRecordId(recordId);
+	item->setRecordRuntimeScore(recordId * 0.5);
+	vector<unsigned> editDistances(recordId % 3, recordId);
+	item->setRecordMatchEditDistances(editDistances);
+	vector<vector<unsigned> > attributeIdsList;
+	for(unsigned i = 0 ; i < recordId % 4 ; ++i){
+		attributeIdsList.push_back(vector<unsigned>(i, recordId + i));
+	}
+	item->setRecordMatchAttributeBitmaps(attributeIdsList);
+	vector<unsigned> positionIndexOffsets(1, recordId);
+	item->setPositionIndexOffsets(positionIndexOffsets);
+	for(unsigned i = 0 ; i < recordId % 5 ; ++i){
+		item->addTermType(i % 2 == 0 ? TERM_TYPE_PREFIX : TERM_TYPE_COMPLETE);
+	}
+}
+
+void checkItem(PhysicalPlanRecordItem * item, unsigned recordId){
+	ASSERT(item->getRecordId() == recordId);
+	ASSERT(item->getRecordRuntimeScore() == recordId * 0.5);
+	vector<unsigned> editDistances;
+	item->getRecordMatchEditDistances(editDistances);
+	ASSERT(editDistances == vector<unsigned>(recordId % 3, recordId));
+	vector<vector<unsigned> > attributeIdsList;
+	item->getRecordMatchAttributeBitmaps(attributeIdsList);
+	ASSERT(attributeIdsList.size() == recordId % 4);
+	for(unsigned i = 0 ; i < attributeIdsList.size() ; ++i){
+		ASSERT(attributeIdsList[i] == vector<unsigned>(i, recordId + i));
+	}
+	vector<unsigned> positionIndexOffsets;
+	item->getPositionIndexOffsets(positionIndexOffsets);
+	ASSERT(positionIndexOffsets == vector<unsigned>(1, recordId));
+	vector<TermType> termTypes;
+	item->getTermTypes(termTypes);
+	ASSERT(termTypes.size() == recordId % 5);
+	for(unsigned i = 0 ; i < termTypes.size() ; ++i){
+		ASSERT(termTypes[i] == (i % 2 == 0 ? TERM_TYPE_PREFIX : TERM_TYPE_COMPLETE));
+	}
+}
+
+// The items of a pool and their clones keep their arrays until the pool is refreshed,
+// and the clones for the cache outlive it.
+void testRecordItemPool(){
+	PhysicalPlanRecordItemPool * pool = new PhysicalPlanRecordItemPool();
+	vector<PhysicalPlanRecordItem *> cacheItems;
+	for(unsigned round = 0 ; round < 3 ; ++round){
+		vector<PhysicalPlanRecordItem *> items;
+		for(unsigned recordId = 0 ; recordId < 10000 ; ++recordId){
+			PhysicalPlanRecordItem * item = pool->createRecordItem();
+			fillItem(item, recordId);
+			items.push_back(item);
+		}
+		for(unsigned recordId = 0 ; recordId < 10000 ; ++recordId){
+			checkItem(items[recordId], recordId);
+			checkItem(pool->clone(items[recordId]), recordId);
+		}
+		for(unsigned recordId = 0 ; recordId < 10000 ; recordId += 100){
+			cacheItems.push_back(pool->cloneForCache(items[recordId]));
+		}
+		ASSERT(pool->getNumberOfObjects() == 20000);
+		pool->refresh();
+		ASSERT(pool->getNumberOfObjects() == 0);
+	}
+	delete pool;
+
+	for(unsigned i = 0 ; i < cacheItems.size() ; ++i){
+		checkItem(cacheItems[i], (i % 100) * 100);
+		// setting an array again must not leak or corrupt the heap copy
+		fillItem(cacheItems[i], (i % 100) * 100 + 7);
+		checkItem(cacheItems[i], (i % 100) * 100 + 7);
+		delete cacheItems[i];
+	}
+}
+
+int main(int argc, char *argv[]){
+	testArena();
+	cout << "Arena test passed" << endl;
+	testRecordItemPool();
+	cout << "PhysicalPlanRecordItemPool test passed" << endl;
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "operation/physical_plan/PhysicalPlan.h"
+#include "operation/physical_plan/PhysicalOperators.h"
+#include "operation/physical_plan/UnionTopKBlockMaxOperator.h"
+#include "operation/physical_plan/UnionLowestLevelTermVirtualListOperator.h"
+#include "operation/QueryEvaluatorInternal.h"
+#include "operation/HistogramManager.h"
+#include "analyzer/AnalyzerInternal.h"
+#include <instantsearch/Schema.h>
+#include <instantsearch/Record.h>
+#include <instantsearch/LogicalPlan.h>
+#include "util/Assert.h"
+
+#include <map>
+#include <sstream>
+
+using namespace srch2::instantsearch;
+
+typedef pair<float, unsigned> ScoreAndRecordId;
+
+// the cancel flag of the searches of the test
+volatile bool isSearchCancelled = false;
+
+bool greaterThan(const ScoreAndRecordId & lhs, const ScoreAndRecordId & rhs){
+	return DefaultTopKRanker::compareRecordsGreaterThan(lhs.first, lhs.second, rhs.first, rhs.second);
+}
+
+/*
+ * Record i has "dog" if i is even and one of "cat", "car" or "cart" if i%3, i%5 or i%7 is 0.
+ * Boosts and lengths vary so that lists have many blocks with different max scores.
+ */
+Indexer * buildIndex(IndexMetaData * indexMetaData){
+	Schema *schema = Schema::create(srch2::instantsearch::DefaultIndex);
+	schema->setPrimaryKey("article_id");
+	schema->setSearchableAttribute("article_title", 7);
+	Record *record = new Record(schema);
+	Analyzer *analyzer = new Analyzer(NULL, NULL, NULL, NULL, "");
+	Indexer *indexer = Indexer::create(indexMetaData, analyzer, schema);
+
+	for(unsigned i = 0; i < 3000; ++i){
+		stringstream title;
+		if(i % 2 == 0) title << "dog ";
+		if(i % 3 == 0) title << "cat ";
+		if(i % 5 == 0) title << "car ";
+		if(i % 7 == 0) title << "cart ";
+		for(unsigned j = 0; j < i % 13; ++j){
+			title << "filler" << j << " ";
+		}
+		title << "title";
+		record->clear();
+		record->setPrimaryKey(i + 1);
+		record->setSearchableAttributeValue("article_title", title.str());
+		record->setRecordBoost(1 + (i * 7919) % 100);
+		indexer->addRecord(record, analyzer);
+	}
+	indexer->commit();
+
+	delete record;
+	delete analyzer;
+	delete schema;
+	return indexer;
+}
+
+// all the results of a term in score order, by TVL
+void getTermResults(QueryEvaluatorInternal * queryEvaluator, LogicalPlanNode * termNode,
+		map<unsigned, float> & unionResults){
+	PhysicalOperatorFactory * operatorFactory = queryEvaluator->getPhysicalOperatorFactory();
+	UnionLowestLevelTermVirtualListOperator * tvlOp = operatorFactory->createUnionLowestLevelTermVirtualListOperator();
+	UnionLowestLevelTermVirtualListOptimizationOperator * tvlOpOp =
+			operatorFactory->createUnionLowestLevelTermVirtualListOptimizationOperator();
+	tvlOp->setPhysicalPlanOptimizationNode(tvlOpOp);
+	tvlOpOp->setExecutableNode(tvlOp);
+	tvlOpOp->setLogicalPlanNode(termNode);
+
+	PhysicalPlanExecutionParameters params(10, false, 0.5, SearchTypeTopKQuery);
+	tvlOp->open(queryEvaluator, params);
+	while(true){
+		PhysicalPlanRecordItem * record = tvlOp->getNext(params);
+		if(record == NULL){
+			break;
+		}
+		// OR takes the maximum score of terms
+		if(unionResults.find(record->getRecordId()) == unionResults.end() ||
+				unionResults[record->getRecordId()] < record->getRecordRuntimeScore()){
+			unionResults[record->getRecordId()] = record->getRecordRuntimeScore();
+		}
+	}
+	tvlOp->close(params);
+}
+
+UnionTopKBlockMaxOperator * buildOperator(QueryEvaluatorInternal * queryEvaluator, LogicalPlanNode * orNode){
+	PhysicalOperatorFactory * operatorFactory = queryEvaluator->getPhysicalOperatorFactory();
+	UnionTopKBlockMaxOperator * unionOp = operatorFactory->createUnionTopKBlockMaxOperator();
+	UnionTopKBlockMaxOptimizationOperator * unionOpOp = operatorFactory->createUnionTopKBlockMaxOptimizationOperator();
+	unionOp->setPhysicalPlanOptimizationNode(unionOpOp);
+	unionOpOp->setExecutableNode(unionOp);
+	unionOpOp->setLogicalPlanNode(orNode);
+	for(unsigned i = 0; i < orNode->children.size(); ++i){
+		UnionLowestLevelTermVirtualListOptimizationOperator * tvlOpOp =
+				operatorFactory->createUnionLowestLevelTermVirtualListOptimizationOperator();
+		tvlOpOp->setLogicalPlanNode(orNode->children[i]);
+		unionOpOp->addChild(tvlOpOp);
+	}
+	ASSERT(unionOpOp->validateChildren());
+	return unionOp;
+}
+
+/*
+ * q = ca* OR dog
+ * The operator must return the same records and scores as the union of TVLs, in score order,
+ * and it must not read all the blocks to find the top results.
+ */
+void testTopKOr(QueryEvaluatorInternal * queryEvaluator){
+	LogicalPlan logicalPlan;
+	LogicalPlanNode * orNode = logicalPlan.createOperatorLogicalPlanNode(LogicalPlanNodeTypeOr);
+	orNode->children.push_back(logicalPlan.createTermLogicalPlanNode("ca", TERM_TYPE_PREFIX, 1, 1, 0,
+			vector<unsigned>(), ATTRIBUTES_OP_OR));
+	orNode->children.push_back(logicalPlan.createTermLogicalPlanNode("dog", TERM_TYPE_COMPLETE, 2, 1, 0,
+			vector<unsigned>(), ATTRIBUTES_OP_OR));
+	logicalPlan.setTree(orNode);
+	logicalPlan.setFuzzy(false);
+	HistogramManager histogramManager(queryEvaluator);
+	histogramManager.annotate(&logicalPlan);
+
+	map<unsigned, float> unionResults;
+	getTermResults(queryEvaluator, orNode->children[0], unionResults);
+	getTermResults(queryEvaluator, orNode->children[1], unionResults);
+	vector<ScoreAndRecordId> correctResults;
+	for(map<unsigned, float>::iterator result = unionResults.begin(); result != unionResults.end(); ++result){
+		correctResults.push_back(make_pair(result->second, result->first));
+	}
+	sort(correctResults.begin(), correctResults.end(), greaterThan);
+
+	// 1. top 10 results
+	UnionTopKBlockMaxOperator * unionOp = buildOperator(queryEvaluator, orNode);
+	PhysicalPlanExecutionParameters params(10, false, 0.5, SearchTypeTopKQuery);
+	unionOp->open(queryEvaluator, params);
+	for(unsigned i = 0; i < 10; ++i){
+		PhysicalPlanRecordItem * record = unionOp->getNext(params);
+		ASSERT(record != NULL);
+		ASSERT(record->getRecordId() == correctResults[i].second);
+		ASSERT(record->getRecordRuntimeScore() == correctResults[i].first);
+	}
+	ASSERT(unionOp->getNumberOfSkippedBlocks() > 0);
+	ASSERT(unionOp->getNumberOfSkippedBlocks() > unionOp->getNumberOfReadBlocks());
+	unionOp->close(params);
+
+	// 2. all results, every block is read in the end
+	unionOp->open(queryEvaluator, params);
+	vector<ScoreAndRecordId> operatorResults;
+	while(true){
+		PhysicalPlanRecordItem * record = unionOp->getNext(params);
+		if(record == NULL){
+			break;
+		}
+		operatorResults.push_back(make_pair(record->getRecordRuntimeScore(), record->getRecordId()));
+	}
+	ASSERT(unionOp->getNumberOfSkippedBlocks() == 0);
+	unionOp->close(params);
+	ASSERT(operatorResults == correctResults);
+
+	// 3. random access
+	unionOp->open(queryEvaluator, params);
+	PhysicalPlanRandomAccessVerificationParameters verificationParameters(params.ranker,
+			queryEvaluator->indexReadToken.readState->forwardIndexReadViewSharedPtr);
+	verificationParameters.isFuzzy = false;
+	verificationParameters.prefixMatchPenalty = 0.5;
+	PhysicalPlanRecordItem * recordToVerify = queryEvaluator->getPhysicalPlanRecordItemPool()->createRecordItem();
+	for(unsigned recordId = 0; recordId < 100; ++recordId){
+		recordToVerify->setRecordId(recordId);
+		verificationParameters.recordToVerify = recordToVerify;
+		bool verified = unionOp->verifyByRandomAccess(verificationParameters);
+		ASSERT(verified == (unionResults.find(recordId) != unionResults.end()));
+	}
+	unionOp->close(params);
+
+	// 4. a cancelled search reads no more blocks and only returns the candidates it has
+	unionOp->open(queryEvaluator, params);
+	ASSERT(unionOp->getNext(params) != NULL);
+	const unsigned numberOfReadBlocks = unionOp->getNumberOfReadBlocks();
+	isSearchCancelled = true;
+	unsigned numberOfResultsAfterCancel = 0;
+	while(unionOp->getNext(params) != NULL){
+		numberOfResultsAfterCancel++;
+	}
+	ASSERT(unionOp->getNumberOfReadBlocks() == numberOfReadBlocks);
+	ASSERT(numberOfResultsAfterCancel + 1 < correctResults.size());
+	isSearchCancelled = false;
+	unionOp->close(params);
+}
+
+int main(int argc, char *argv[]) {
+	IndexMetaData *indexMetaData = new IndexMetaData(new CacheManager(), 3, 5, 1, 5, ".");
+	Indexer * indexer = buildIndex(indexMetaData);
+	QueryEvaluatorRuntimeParametersContainer runtimeParameters;
+	runtimeParameters.cancelled = &isSearchCancelled;
+	QueryEvaluator * queryEvaluator = new QueryEvaluator(indexer, &runtimeParameters);
+
+	queryEvaluator->impl->readerPreEnter();
+	testTopKOr(queryEvaluator->impl);
+	queryEvaluator->impl->readerPreExit();
+
+	delete queryEvaluator;
+	delete indexer;
+	delete indexMetaData;
+	cout << "UnionTopKBlockMax_Test: Passed\n" << endl;
+}
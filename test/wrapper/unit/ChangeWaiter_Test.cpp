@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This test case tests the waits of the listener of a data connector between two polls of its
+ * database: the delay doubles after each poll without changes up to the listenerWaitTime, a poll
+ * with changes resets it, and a write to a watched database file ends the wait at once.
+ */
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/time.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "util/Assert.h"
+#include "ChangeWaiter.h"
+
+using namespace std;
+using namespace srch2::instantsearch;
+
+static long long getTimeInMilliseconds() {
+    timeval now;
+    gettimeofday(&now, NULL);
+    return (long long) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+// the milliseconds one wait of waiter took
+static long long timeWait(ChangeWaiter &waiter, bool changesFound) {
+    long long start = getTimeInMilliseconds();
+    waiter.wait(changesFound);
+    return getTimeInMilliseconds() - start;
+}
+
+static void appendToFile(const string &path) {
+    FILE *file = fopen(path.c_str(), "a");
+    ASSERT(file != NULL);
+    fputs("change\n", file);
+    fclose(file);
+}
+
+// writes the shared-memory index of the database, which the waiter ignores, then the database
+static void writeDatabase(const string &path) {
+    usleep(100 * 1000);
+    appendToFile(path + "-shm");
+    usleep(300 * 1000);
+    appendToFile(path);
+}
+
+// without a watched file the waiter sleeps, twice as long after each poll without changes
+static void testFallbackPolling() {
+    ChangeWaiter waiter(1);
+    ASSERT(timeWait(waiter, false) >= ChangeWaiter::MIN_WAIT_TIME_MS);
+    ASSERT(timeWait(waiter, false) >= 2 * ChangeWaiter::MIN_WAIT_TIME_MS);
+    ASSERT(timeWait(waiter, false) >= 4 * ChangeWaiter::MIN_WAIT_TIME_MS);
+
+    // a poll with changes is followed by the next one at once, and the delay starts again
+    ASSERT(timeWait(waiter, true) < ChangeWaiter::MIN_WAIT_TIME_MS);
+    long long waitTime = timeWait(waiter, false);
+    ASSERT(waitTime >= ChangeWaiter::MIN_WAIT_TIME_MS && waitTime < 4 * ChangeWaiter::MIN_WAIT_TIME_MS);
+
+    // a file in a directory which does not exist can not be watched, the waiter keeps sleeping
+    ASSERT(!waiter.watchFile("/nonexistent-directory-of-ChangeWaiter_Test/database"));
+    ASSERT(timeWait(waiter, false) >= 2 * ChangeWaiter::MIN_WAIT_TIME_MS);
+    cout << "testFallbackPolling passed." << endl;
+}
+
+// the delay does not grow past the listenerWaitTime, at least MIN_WAIT_TIME_MS
+static void testMaximumWaitTime() {
+    ChangeWaiter waiter(0);
+    long long totalWaitTime = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        totalWaitTime += timeWait(waiter, false);
+    }
+    // 15 times MIN_WAIT_TIME_MS if the delay doubled
+    ASSERT(totalWaitTime >= 4 * ChangeWaiter::MIN_WAIT_TIME_MS);
+    ASSERT(totalWaitTime < 12 * ChangeWaiter::MIN_WAIT_TIME_MS);
+    cout << "testMaximumWaitTime passed." << endl;
+}
+
+// a write to the watched database ends the wait before the timeout
+static void testWatchedFile() {
+    char directory[] = "/tmp/ChangeWaiter_TestXXXXXX";
+    ASSERT(mkdtemp(directory) != NULL);
+    const string path = string(directory) + "/database";
+    appendToFile(path);
+
+    ChangeWaiter waiter(10);
+    ASSERT(waiter.watchFile(path));
+    // waits of 50, 100, 200, 400 and 800 ms without a change, the next one times out after 1600 ms
+    long long waitTime = 0;
+    for (unsigned i = 0; i < 5; ++i) {
+        waitTime += timeWait(waiter, false);
+    }
+    ASSERT(waitTime >= 31 * ChangeWaiter::MIN_WAIT_TIME_MS);
+
+    boost::thread writer(boost::bind(writeDatabase, path));
+    waitTime = timeWait(waiter, false);
+    writer.join();
+    // the write of the shared-memory index at 100 ms did not end the wait, the write at 400 ms did
+    ASSERT(waitTime >= 300);
+    ASSERT(waitTime < 32 * ChangeWaiter::MIN_WAIT_TIME_MS);
+
+    // the database may be written again soon, the delay starts again. The close of the file after
+    // the write may end this wait at once.
+    waitTime = timeWait(waiter, false);
+    ASSERT(waitTime < 8 * ChangeWaiter::MIN_WAIT_TIME_MS);
+
+    unlink((path + "-shm").c_str());
+    unlink(path.c_str());
+    rmdir(directory);
+    cout << "testWatchedFile passed." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    testFallbackPolling();
+    testMaximumWaitTime();
+    testWatchedFile();
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This test case tests the freshness of the indexes of a core that /info reports for its data
+ * connector: the number of polls and changes, the time since the last poll and the lag of the
+ * changes applied by the polls.
+ */
+
+#include <iostream>
+#include <ctime>
+#include <unistd.h>
+#include "util/Assert.h"
+#include "ConnectorFreshness.h"
+#include "json/json.h"
+
+using namespace std;
+using namespace srch2::instantsearch;
+using srch2::httpwrapper::ConnectorFreshness;
+
+static void testBeforeFirstPoll() {
+    ConnectorFreshness freshness;
+    Json::Value json = freshness.getJson();
+    ASSERT(json.isObject());
+    ASSERT(json.size() == 0);
+    cout << "testBeforeFirstPoll passed." << endl;
+}
+
+static void testPolls() {
+    ConnectorFreshness freshness;
+
+    // a poll without changes
+    freshness.reportPoll(0, 0);
+    Json::Value json = freshness.getJson();
+    ASSERT(json["polls"].asUInt64() == 1);
+    ASSERT(json["changes"].asUInt64() == 0);
+    ASSERT(json["freshness_lag_ms"].asInt64() == 0);
+    ASSERT(json["max_freshness_lag_ms"].asInt64() == 0);
+    ASSERT(json["last_poll_age_ms"].asInt64() >= 0 && json["last_poll_age_ms"].asInt64() < 1000);
+
+    // the newest change was made 5 seconds ago, the times of the changes are in seconds
+    freshness.reportPoll(3, time(NULL) - 5);
+    json = freshness.getJson();
+    ASSERT(json["polls"].asUInt64() == 2);
+    ASSERT(json["changes"].asUInt64() == 3);
+    ASSERT(json["freshness_lag_ms"].asInt64() >= 5000 && json["freshness_lag_ms"].asInt64() < 7000);
+    ASSERT(json["max_freshness_lag_ms"] == json["freshness_lag_ms"]);
+    const Json::Int64 maxFreshnessLag = json["max_freshness_lag_ms"].asInt64();
+
+    // a smaller lag does not change the maximum
+    freshness.reportPoll(2, time(NULL) - 1);
+    json = freshness.getJson();
+    ASSERT(json["changes"].asUInt64() == 5);
+    ASSERT(json["freshness_lag_ms"].asInt64() >= 1000 && json["freshness_lag_ms"].asInt64() < 3000);
+    ASSERT(json["max_freshness_lag_ms"].asInt64() == maxFreshnessLag);
+
+    // the time of the changes is not known, the lag is kept
+    const Json::Int64 freshnessLag = json["freshness_lag_ms"].asInt64();
+    freshness.reportPoll(1, 0);
+    json = freshness.getJson();
+    ASSERT(json["polls"].asUInt64() == 4);
+    ASSERT(json["changes"].asUInt64() == 6);
+    ASSERT(json["freshness_lag_ms"].asInt64() == freshnessLag);
+
+    // a change stamped in the future by the clock of the database has no lag
+    freshness.reportPoll(1, time(NULL) + 60);
+    json = freshness.getJson();
+    ASSERT(json["freshness_lag_ms"].asInt64() == 0);
+    ASSERT(json["max_freshness_lag_ms"].asInt64() == maxFreshnessLag);
+
+    // a poll that finds no change means the indexes caught up
+    freshness.reportPoll(2, time(NULL) - 5);
+    freshness.reportPoll(0, 0);
+    json = freshness.getJson();
+    ASSERT(json["freshness_lag_ms"].asInt64() == 0);
+    cout << "testPolls passed." << endl;
+}
+
+// an idle database has no lag, but the time since the last poll keeps growing if the listener stops polling
+static void testLastPollAge() {
+    ConnectorFreshness freshness;
+    freshness.reportPoll(0, 0);
+    usleep(200 * 1000);
+    Json::Value json = freshness.getJson();
+    ASSERT(json["last_poll_age_ms"].asInt64() >= 200);
+    ASSERT(json["freshness_lag_ms"].asInt64() == 0);
+
+    freshness.reportPoll(0, 0);
+    json = freshness.getJson();
+    ASSERT(json["last_poll_age_ms"].asInt64() < 200);
+    cout << "testLastPollAge passed." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    testBeforeFirstPoll();
+    testPolls();
+    testLastPollAge();
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This test case tests the streaming JSON writer of the search responses: the documents it writes
+ * into an evbuffer are the ones Json::FastWriter writes for the same values, and raw values are
+ * attached without changes.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <limits.h>
+#include <event2/buffer.h>
+#include "util/Assert.h"
+#include "util/JsonResponseWriter.h"
+#include "json/json.h"
+
+using namespace std;
+using namespace srch2::instantsearch;
+namespace srch2http = srch2::httpwrapper;
+using srch2http::JsonResponseWriter;
+
+static string drain(evbuffer *buffer) {
+    string result(evbuffer_get_length(buffer), '\0');
+    if (!result.empty())
+        evbuffer_remove(buffer, &result[0], result.size());
+    return result;
+}
+
+// Json::FastWriter ends the document with a new line
+static string fastWrite(const Json::Value &value) {
+    Json::FastWriter writer;
+    string result = writer.write(value);
+    return result.substr(0, result.size() - 1);
+}
+
+static void testScalars() {
+    evbuffer *buffer = evbuffer_new();
+    JsonResponseWriter writer(buffer);
+
+    const double doubles[] = { 0, 1, -2.5, 5.19141, 0.1, 1e20, 1.5e-7, 123456789.125, (double) 0.3f };
+    for (unsigned i = 0; i < sizeof(doubles) / sizeof(doubles[0]); ++i) {
+        writer.value(doubles[i]);
+        ASSERT(drain(buffer) == fastWrite(Json::Value(doubles[i])));
+    }
+    const int ints[] = { 0, -1, 42, INT_MIN, INT_MAX };
+    for (unsigned i = 0; i < sizeof(ints) / sizeof(ints[0]); ++i) {
+        writer.value(ints[i]);
+        ASSERT(drain(buffer) == fastWrite(Json::Value(ints[i])));
+    }
+    writer.value(UINT_MAX);
+    ASSERT(drain(buffer) == fastWrite(Json::Value(UINT_MAX)));
+    writer.value(true);
+    ASSERT(drain(buffer) == "true");
+
+    const char *strings[] = { "", "plain", "quote \" and \\ backslash", "tab\tnew line\n\r\b\f",
+            "control \x01\x1f", "utf-8 caf\xc3\xa9" };
+    for (unsigned i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i) {
+        writer.value(string(strings[i]));
+        ASSERT(drain(buffer) == fastWrite(Json::Value(strings[i])));
+    }
+    evbuffer_free(buffer);
+    cout << "testScalars passed." << endl;
+}
+
+static void testDocument() {
+    evbuffer *buffer = evbuffer_new();
+    JsonResponseWriter writer(buffer);
+    writer.beginObject();
+    writer.key("results");
+    writer.beginArray();
+    for (unsigned i = 0; i < 3; ++i) {
+        writer.beginObject();
+        writer.key("record_id");
+        writer.value("id" + string(1, '0' + i));
+        writer.key("edit_dist");
+        writer.beginArray();
+        for (unsigned j = 0; j < i; ++j)
+            writer.value(j);
+        writer.endArray();
+        writer.key("record");
+        writer.rawValue("{\"name\":\"x\"}");
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.key("facets");
+    writer.beginArray();
+    writer.endArray();
+    writer.key("message");
+    writer.value("");
+    writer.endObject();
+
+    // the same document as a tree; members of a Json::Value are sorted, so compare the trees
+    Json::Value expected(Json::objectValue);
+    expected["results"].resize(3);
+    for (unsigned i = 0; i < 3; ++i) {
+        expected["results"][i]["record_id"] = "id" + string(1, '0' + i);
+        expected["results"][i]["edit_dist"].resize(i);
+        for (unsigned j = 0; j < i; ++j)
+            expected["results"][i]["edit_dist"][j] = (int) j;
+        expected["results"][i]["record"]["name"] = "x";
+    }
+    expected["facets"].resize(0);
+    expected["message"] = "";
+
+    string written = drain(buffer);
+    Json::Reader reader;
+    Json::Value parsed;
+    ASSERT(reader.parse(written, parsed, false));
+    ASSERT(parsed == expected);
+    ASSERT(written.find("\"results\":[{\"record_id\":\"id0\",\"edit_dist\":[],\"record\":{\"name\":\"x\"}},") == 1);
+    evbuffer_free(buffer);
+    cout << "testDocument passed." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    testScalars();
+    testDocument();
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This test case tests the cache of the parsed queries of the search requests: a plan is used by one
+ * request at a time, is invalidated by a change of the attribute acl, and the plans of the least
+ * recently used keys are deleted when the cache is full.
+ */
+
+#include <iostream>
+#include <string>
+#include "util/Assert.h"
+#include "QueryPlanCache.h"
+#include "ParsedParameterContainer.h"
+#include <instantsearch/LogicalPlan.h>
+
+using namespace std;
+using namespace srch2::instantsearch;
+namespace srch2http = srch2::httpwrapper;
+using srch2http::QueryPlanCache;
+using srch2http::ParsedQuery;
+
+static void testCheckOutAndCheckIn() {
+    QueryPlanCache cache;
+    ASSERT(cache.checkOut("q=foo", 0) == NULL);
+
+    ParsedQuery *parsedQuery = new ParsedQuery();
+    cache.checkIn("q=foo", 0, parsedQuery);
+    ASSERT(cache.getJson()["plans"].asUInt() == 1);
+
+    // the plan is used by one request at a time
+    ASSERT(cache.checkOut("q=foo", 0) == parsedQuery);
+    ASSERT(cache.checkOut("q=foo", 0) == NULL);
+    ASSERT(cache.checkOut("q=bar", 0) == NULL);
+
+    // concurrent requests with the same key keep their own plans
+    ParsedQuery *otherParsedQuery = new ParsedQuery();
+    cache.checkIn("q=foo", 0, parsedQuery);
+    cache.checkIn("q=foo", 0, otherParsedQuery);
+    ASSERT(cache.getJson()["plans"].asUInt() == 2);
+
+    Json::Value statistics = cache.getJson();
+    ASSERT(statistics["hits"].asUInt() == 1);
+    ASSERT(statistics["misses"].asUInt() == 3);
+    ASSERT(statistics["hit_rate"].asDouble() == 0.25);
+}
+
+static void testAclVersion() {
+    QueryPlanCache cache;
+    cache.checkIn("q=foo&roleId=admin", 3, new ParsedQuery());
+    // the plans parsed with an older acl are deleted
+    ASSERT(cache.checkOut("q=foo&roleId=admin", 4) == NULL);
+    ASSERT(cache.getJson()["plans"].asUInt() == 0);
+
+    cache.checkIn("q=foo&roleId=admin", 4, new ParsedQuery());
+    ParsedQuery *parsedQuery = cache.checkOut("q=foo&roleId=admin", 4);
+    ASSERT(parsedQuery != NULL);
+    delete parsedQuery;
+}
+
+static void testLeastRecentlyUsedKeysAreDeleted() {
+    QueryPlanCache cache(2);
+    cache.checkIn("q=a", 0, new ParsedQuery());
+    cache.checkIn("q=b", 0, new ParsedQuery());
+    // a is used again, so b is the least recently used key
+    cache.checkIn("q=a", 0, cache.checkOut("q=a", 0));
+    cache.checkIn("q=c", 0, new ParsedQuery());
+    ASSERT(cache.getJson()["plans"].asUInt() == 2);
+    ASSERT(cache.checkOut("q=b", 0) == NULL);
+
+    ParsedQuery *parsedQuery = cache.checkOut("q=a", 0);
+    ASSERT(parsedQuery != NULL);
+    delete parsedQuery;
+    parsedQuery = cache.checkOut("q=c", 0);
+    ASSERT(parsedQuery != NULL);
+    delete parsedQuery;
+}
+
+static void testZeroMaximumDisablesTheCache() {
+    QueryPlanCache cache(0);
+    cache.checkIn("q=a", 0, new ParsedQuery());
+    cache.checkIn("q=a", 0, new ParsedQuery());
+    ASSERT(cache.getJson()["plans"].asUInt() == 0);
+    ASSERT(cache.checkOut("q=a", 0) == NULL);
+}
+
+static void testResetExecutionState() {
+    ParsedQuery parsedQuery;
+    LogicalPlan &logicalPlan = *parsedQuery.logicalPlan;
+    LogicalPlanNode *andNode = logicalPlan.createOperatorLogicalPlanNode(LogicalPlanNodeTypeAnd);
+    vector<unsigned> fieldFilter;
+    LogicalPlanNode *termNode = logicalPlan.createTermLogicalPlanNode("foo", TERM_TYPE_PREFIX, 1, 1, 1,
+            fieldFilter, ATTRIBUTES_OP_AND);
+    andNode->children.push_back(termNode);
+    logicalPlan.setTree(andNode);
+    logicalPlan.setFuzzy(true);
+    parsedQuery.isFuzzy = logicalPlan.isFuzzy();
+    const string key = logicalPlan.getUniqueStringForCaching();
+
+    // what an execution changes
+    logicalPlan.setFuzzy(false);
+    termNode->forcedPhysicalNode = PhysicalPlanNode_UnionLowestLevelSuggestion;
+
+    logicalPlan.resetExecutionState(parsedQuery.isFuzzy);
+    ASSERT(logicalPlan.isFuzzy());
+    ASSERT(termNode->forcedPhysicalNode == PhysicalPlanNode_NOT_SPECIFIED);
+    ASSERT(termNode->stats == NULL);
+    ASSERT(logicalPlan.getUniqueStringForCaching() == key);
+}
+
+int main(int argc, char *argv[]) {
+    testCheckOutAndCheckIn();
+    testAclVersion();
+    testLeastRecentlyUsedKeysAreDeleted();
+    testZeroMaximumDisablesTheCache();
+    testResetExecutionState();
+
+    cout << "QueryPlanCache Unit Test: Passed" << endl;
+    return 0;
+}
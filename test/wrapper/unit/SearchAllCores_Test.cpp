@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This test case tests the searches of /_all/search: every core is searched on the thread pool,
+ * a core which misses timeAllowed gets an error while the others answer and its search is cancelled,
+ * and merge=topk takes one
+ * page of the results of all the cores sorted by score from the results each core kept apart.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <event2/buffer.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "util/Assert.h"
+#include "util/WorkStealingThreadPool.h"
+#include "SearchAllCores.h"
+#include "json/json.h"
+
+using namespace std;
+using namespace srch2::instantsearch;
+namespace srch2http = srch2::httpwrapper;
+using srch2http::JsonResponseWriter;
+using srch2http::ResultsWriter;
+using srch2http::SearchAllCores;
+using srch2http::SeparatedResults;
+using srch2::util::WorkStealingThreadPool;
+
+// a core searched by the test
+struct FakeCore {
+    string name;
+    vector<double> scores;
+    // the query is not valid in the core if it is not empty
+    string error;
+    // the search waits until it is cancelled, at most 10 seconds
+    bool isSlow;
+};
+
+static vector<FakeCore> fakeCores;
+static boost::mutex slowCoreMutex;
+static boost::condition_variable slowCoreEnded;
+static bool isSlowCoreFinished;
+static bool wasSlowCoreCancelled;
+
+static bool searchFakeCore(unsigned coreOffset, JsonResponseWriter &writer,
+        SeparatedResults *separatedResults, std::stringstream &errorStream,
+        const volatile bool *cancelled) {
+    const FakeCore &core = fakeCores[coreOffset];
+    if (core.isSlow) {
+        // the flag is polled, as the core search checks it while it reads the records
+        for (unsigned i = 0; i < 1000 && !*cancelled; ++i)
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        boost::unique_lock<boost::mutex> lock(slowCoreMutex);
+        wasSlowCoreCancelled = *cancelled;
+    }
+    if (!core.error.empty()) {
+        errorStream << core.error;
+    } else {
+        writer.beginObject();
+        ResultsWriter resultsWriter(writer, separatedResults);
+        resultsWriter.begin();
+        for (unsigned i = 0; i < core.scores.size(); ++i) {
+            JsonResponseWriter &resultWriter = resultsWriter.beginResult();
+            resultWriter.key("record_id");
+            resultWriter.value(core.name + string(1, '0' + i));
+            resultWriter.key("score");
+            resultWriter.value(core.scores[i]);
+            resultsWriter.endResult(core.scores[i]);
+        }
+        resultsWriter.end();
+        writer.key("message");
+        writer.value(core.name);
+        writer.endObject();
+    }
+    if (core.isSlow) {
+        boost::unique_lock<boost::mutex> lock(slowCoreMutex);
+        isSlowCoreFinished = true;
+        slowCoreEnded.notify_all();
+    }
+    return core.error.empty();
+}
+
+static void addFakeCore(const string &name, double scores[], unsigned numberOfScores,
+        const string &error = "", bool isSlow = false) {
+    FakeCore core;
+    core.name = name;
+    core.scores.assign(scores, scores + numberOfScores);
+    core.error = error;
+    core.isSlow = isSlow;
+    fakeCores.push_back(core);
+}
+
+static vector<string> getCoreNames() {
+    vector<string> coreNames;
+    for (unsigned i = 0; i < fakeCores.size(); ++i)
+        coreNames.push_back(fakeCores[i].name);
+    return coreNames;
+}
+
+static void waitForSlowCore() {
+    boost::unique_lock<boost::mutex> lock(slowCoreMutex);
+    while (!isSlowCoreFinished)
+        slowCoreEnded.wait(lock);
+}
+
+static Json::Value drain(evbuffer *buffer) {
+    string written(evbuffer_get_length(buffer), '\0');
+    evbuffer_remove(buffer, &written[0], written.size());
+    Json::Reader reader;
+    Json::Value parsed;
+    ASSERT(reader.parse(written, parsed, false));
+    return parsed;
+}
+
+// every core answers with its response, or with its error if the query is not valid in it
+static void testResponses(WorkStealingThreadPool *pool) {
+    fakeCores.clear();
+    double scores[] = { 3, 2, 1 };
+    addFakeCore("a", scores, 3);
+    addFakeCore("b", scores, 1);
+    addFakeCore("c", scores, 0, "not valid");
+    addFakeCore("d", scores, 2);
+
+    boost::shared_ptr<SearchAllCores> searches = SearchAllCores::start(getCoreNames(),
+            searchFakeCore, false, pool);
+    searches->wait(0);
+    ASSERT(searches->getNumberOfSucceededCores() == 3);
+
+    evbuffer *buffer = evbuffer_new();
+    JsonResponseWriter writer(buffer);
+    searches->writeResponses(writer);
+    Json::Value response = drain(buffer);
+    ASSERT(response.size() == 4);
+    ASSERT(response["a"]["results"].size() == 3);
+    ASSERT(response["a"]["results"][0]["record_id"].asString() == "a0");
+    ASSERT(!response["a"]["results"][0].isMember("core"));
+    ASSERT(response["a"]["message"].asString() == "a");
+    ASSERT(response["b"]["results"].size() == 1);
+    ASSERT(response["c"]["error"].asString() == "not valid");
+    ASSERT(response["d"]["results"].size() == 2);
+    evbuffer_free(buffer);
+    cout << "testResponses passed." << endl;
+}
+
+// a core which misses timeAllowed gets an error, and its search is cancelled
+static void testTimeout(WorkStealingThreadPool *pool, bool mergeResults) {
+    fakeCores.clear();
+    double scores[] = { 0.5, 0.25 };
+    addFakeCore("fast", scores, 2);
+    addFakeCore("slow", scores, 2, "", true);
+    addFakeCore("other", scores, 1);
+    isSlowCoreFinished = false;
+    wasSlowCoreCancelled = false;
+
+    boost::shared_ptr<SearchAllCores> searches = SearchAllCores::start(getCoreNames(),
+            searchFakeCore, mergeResults, pool);
+    searches->wait(100);
+    ASSERT(searches->getNumberOfSucceededCores() == 2);
+
+    evbuffer *buffer = evbuffer_new();
+    JsonResponseWriter writer(buffer);
+    if (mergeResults) {
+        searches->writeMergedResults(writer, 0, 10);
+    } else {
+        searches->writeResponses(writer);
+    }
+    // the response is written, the slow core stops by itself and ends with the last reference to the searches
+    searches.reset();
+    waitForSlowCore();
+    ASSERT(wasSlowCoreCancelled);
+
+    Json::Value response = drain(buffer);
+    if (mergeResults) {
+        ASSERT(response["results_found"].asUInt() == 3);
+        for (unsigned i = 0; i < response["results"].size(); ++i)
+            ASSERT(response["results"][i]["core"].asString() != "slow");
+        response = response["cores"];
+    }
+    ASSERT(response["fast"]["message"].asString() == "fast");
+    ASSERT(response["other"]["message"].asString() == "other");
+    ASSERT(response["slow"]["error"].asString() == "The core did not answer within timeAllowed.");
+    evbuffer_free(buffer);
+    cout << "testTimeout(" << mergeResults << ") passed." << endl;
+}
+
+// one page of the results of all the cores, the best score first and each one with its core
+static void testMergedResults(WorkStealingThreadPool *pool) {
+    fakeCores.clear();
+    double scoresOfA[] = { 0.9, 0.5, 0.1 };
+    double scoresOfB[] = { 0.8, 0.7 };
+    double scoresOfC[] = { 0.95 };
+    addFakeCore("a", scoresOfA, 3);
+    addFakeCore("b", scoresOfB, 2);
+    addFakeCore("c", scoresOfC, 1);
+    addFakeCore("d", scoresOfC, 1, "not valid");
+
+    boost::shared_ptr<SearchAllCores> searches = SearchAllCores::start(getCoreNames(),
+            searchFakeCore, true, pool);
+    searches->wait(0);
+
+    evbuffer *buffer = evbuffer_new();
+    JsonResponseWriter writer(buffer);
+    searches->writeMergedResults(writer, 1, 3);
+    Json::Value response = drain(buffer);
+
+    ASSERT(response["offset"].asUInt() == 1);
+    ASSERT(response["limit"].asUInt() == 3);
+    ASSERT(response["results_found"].asUInt() == 6);
+    const Json::Value &results = response["results"];
+    ASSERT(results.size() == 3);
+    const char *recordIds[] = { "a0", "b0", "b1" };
+    const double expectedScores[] = { 0.9, 0.8, 0.7 };
+    for (unsigned i = 0; i < 3; ++i) {
+        ASSERT(results[i]["record_id"].asString() == recordIds[i]);
+        ASSERT(results[i]["core"].asString() == string(recordIds[i], 1));
+        ASSERT(results[i]["score"].asDouble() == expectedScores[i]);
+    }
+
+    // the rest of the response of each core, without its results
+    const Json::Value &cores = response["cores"];
+    ASSERT(cores.size() == 4);
+    ASSERT(cores["a"]["message"].asString() == "a");
+    ASSERT(!cores["a"].isMember("results"));
+    ASSERT(cores["c"]["message"].asString() == "c");
+    ASSERT(cores["d"]["error"].asString() == "not valid");
+
+    // a page after the last result
+    evbuffer_drain(buffer, evbuffer_get_length(buffer));
+    searches->writeMergedResults(writer, 6, 3);
+    response = drain(buffer);
+    ASSERT(response["results"].size() == 0);
+    ASSERT(response["limit"].asUInt() == 0);
+    evbuffer_free(buffer);
+    cout << "testMergedResults passed." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    // more threads than fast cores, so the slow core cannot hold back the others
+    WorkStealingThreadPool pool(4);
+    testResponses(&pool);
+    testTimeout(&pool, false);
+    testTimeout(&pool, true);
+    testMergedResults(&pool);
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This test case tests that the snippets of a page of results are the same whether the page is
+ * highlighted by the request thread alone or split in ranges highlighted by the tasks of a thread
+ * pool, with the analyzer of each task or with the term offsets of the forward index.
+ *
+ * The core is created in a temporary directory from generated records.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <evhttp.h>
+#include "util/Assert.h"
+#include "util/WorkStealingThreadPool.h"
+#include "ConfigManager.h"
+#include "Srch2Server.h"
+#include "ServerHighLighter.h"
+#include "ParsedParameterContainer.h"
+#include "QueryParser.h"
+#include "QueryValidator.h"
+#include "QueryRewriter.h"
+#include "QueryExecutor.h"
+#include "AnalyzerFactory.h"
+#include "operation/IndexerInternal.h"
+#include "operation/CacheManager.h"
+#include <instantsearch/LogicalPlan.h>
+#include <instantsearch/QueryResults.h>
+
+using namespace std;
+using namespace srch2::instantsearch;
+namespace srch2http = srch2::httpwrapper;
+using srch2http::ConfigManager;
+using srch2http::Srch2Server;
+using srch2http::ServerHighLighter;
+using srch2http::ParsedParameterContainer;
+using srch2::util::WorkStealingThreadPool;
+
+static const unsigned NUMBER_OF_RECORDS = 100;
+
+// every record has the keywords of the queries at a different place of its attributes
+static void writeRecords(const string &path) {
+    const char *words[] = { "orchard", "harvest", "banana", "river", "market", "season", "valley", "basket" };
+    const unsigned numberOfWords = sizeof(words) / sizeof(words[0]);
+    ofstream records(path.c_str());
+    for (unsigned i = 0; i < NUMBER_OF_RECORDS; ++i) {
+        records << "{\"id\":\"" << i << "\",\"title\":\"" << words[i % numberOfWords] << " apple "
+                << words[(i + 3) % numberOfWords] << "\",\"body\":\"";
+        for (unsigned j = 0; j < 60; ++j) {
+            if (j == (i * 7) % 60)
+                records << "apple ";
+            records << words[(i + j) % numberOfWords] << " ";
+        }
+        records << "the end of record " << i << "\"}" << endl;
+    }
+}
+
+static void writeConfig(const string &directory, bool enableCharOffsetIndex) {
+    ofstream config((directory + "/conf.xml").c_str());
+    config << "<config>\n"
+           << "  <srch2Home>" << directory << "/</srch2Home>\n"
+           << "  <licenseFile>license.txt</licenseFile>\n"
+           << "  <listeningHostname>0.0.0.0</listeningHostname>\n"
+           << "  <listeningPort>8087</listeningPort>\n"
+           << "  <dataDir>indexes</dataDir>\n"
+           << "  <dataSourceType>1</dataSourceType>\n"
+           << "  <dataFile>records.json</dataFile>\n"
+           << "  <indexConfig>\n"
+           << "    <indexType>0</indexType>\n"
+           << "    <supportSwapInEditDistance>true</supportSwapInEditDistance>\n"
+           << "    <defaultQueryTermBoost>1</defaultQueryTermBoost>\n"
+           << "    <enablePositionIndex>1</enablePositionIndex>\n"
+           << "    <enableCharOffsetIndex>" << enableCharOffsetIndex << "</enableCharOffsetIndex>\n"
+           << "  </indexConfig>\n"
+           << "  <query>\n"
+           << "    <rankingalgorithm>\n"
+           << "      <recordScoreExpression>idf_score*doc_boost</recordScoreExpression>\n"
+           << "    </rankingalgorithm>\n"
+           << "    <fuzzyMatchPenalty>0.75</fuzzyMatchPenalty>\n"
+           << "    <queryTermSimilarityThreshold>0.75</queryTermSimilarityThreshold>\n"
+           << "    <prefixMatchPenalty>0.85</prefixMatchPenalty>\n"
+           << "    <cacheSize>65536000</cacheSize>\n"
+           << "    <rows>10</rows>\n"
+           << "    <fieldBasedSearch>0</fieldBasedSearch>\n"
+           << "    <searcherType>0</searcherType>\n"
+           << "    <queryTermFuzzyType>0</queryTermFuzzyType>\n"
+           << "    <queryTermPrefixType>0</queryTermPrefixType>\n"
+           << "    <queryResponseWriter>\n"
+           << "      <responseFormat>1</responseFormat>\n"
+           << "    </queryResponseWriter>\n"
+           << "    <highlighter>\n"
+           << "      <snippetSize>60</snippetSize>\n"
+           << "      <fuzzyTagPre value='&lt;f&gt;'></fuzzyTagPre>\n"
+           << "      <fuzzyTagPost value='&lt;/f&gt;'></fuzzyTagPost>\n"
+           << "      <exactTagPre value='&lt;e&gt;'></exactTagPre>\n"
+           << "      <exactTagPost value='&lt;/e&gt;'></exactTagPost>\n"
+           << "    </highlighter>\n"
+           << "  </query>\n"
+           << "  <updatehandler>\n"
+           << "    <maxDocs>15000000</maxDocs>\n"
+           << "    <maxMemory>10000000</maxMemory>\n"
+           << "    <mergePolicy>\n"
+           << "      <mergeEveryNSeconds>10</mergeEveryNSeconds>\n"
+           << "      <mergeEveryMWrites>10</mergeEveryMWrites>\n"
+           << "    </mergePolicy>\n"
+           << "  </updatehandler>\n"
+           << "  <schema>\n"
+           << "    <fields>\n"
+           << "      <field name=\"title\" type=\"text\" indexed=\"true\" highlight=\"true\"/>\n"
+           << "      <field name=\"body\" type=\"text\" indexed=\"true\" highlight=\"true\"/>\n"
+           << "    </fields>\n"
+           << "    <uniqueKey>id</uniqueKey>\n"
+           << "  </schema>\n"
+           << "  <updateLog>\n"
+           << "    <logLevel>3</logLevel>\n"
+           << "    <accessLogFile>log.txt</accessLogFile>\n"
+           << "  </updateLog>\n"
+           << "</config>\n";
+}
+
+// the snippets of the results of the query on one page, highlighted with the threads of pool
+static void highlight(Srch2Server *server, const string &uri, WorkStealingThreadPool *pool,
+        vector<RecordSnippet> &snippets) {
+    // the snippets of the other run are not taken from the cache
+    IndexReaderWriter *indexReaderWriter = dynamic_cast<IndexReaderWriter *>(server->indexer);
+    dynamic_cast<CacheManager *>(indexReaderWriter->getCache())->getSnippetCache()->clear();
+
+    evkeyvalq headers;
+    evhttp_parse_query(uri.c_str(), &headers);
+    ParsedParameterContainer paramContainer;
+    LogicalPlan logicalPlan;
+    srch2http::QueryParser queryParser(headers, &paramContainer);
+    ASSERT(queryParser.parse());
+    srch2http::QueryValidator queryValidator(*(server->indexer->getSchema()), *(server->indexDataConfig),
+            &paramContainer, server->indexer->getAttributeAcl());
+    ASSERT(queryValidator.validate());
+    srch2http::QueryRewriter queryRewriter(server->indexDataConfig, *(server->indexer->getSchema()),
+            *(srch2http::AnalyzerFactory::getCurrentThreadAnalyzer(server->indexDataConfig)),
+            &paramContainer, server->indexer->getAttributeAcl());
+    ASSERT(queryRewriter.rewrite(logicalPlan));
+
+    QueryResultFactory resultsFactory;
+    srch2http::QueryExecutor queryExecutor(logicalPlan, &resultsFactory, server, server->indexDataConfig);
+    QueryResults queryResults;
+    queryExecutor.execute(&queryResults);
+    ASSERT(queryResults.getNumberOfResults() == NUMBER_OF_RECORDS);
+
+    ServerHighLighter highlighter(&queryResults, server, paramContainer, logicalPlan.getOffset(),
+            logicalPlan.getNumberOfResultsToRetrieve(), pool);
+    highlighter.generateSnippets(snippets);
+    evhttp_clear_headers(&headers);
+}
+
+static void testSameSnippets(bool enableCharOffsetIndex) {
+    char directory[] = "/tmp/ServerHighLighter_TestXXXXXX";
+    ASSERT(mkdtemp(directory) != NULL);
+    writeRecords(string(directory) + "/records.json");
+    writeConfig(directory, enableCharOffsetIndex);
+
+    ConfigManager config(string(directory) + "/conf.xml");
+    ASSERT(config.loadConfigFile());
+    Srch2Server server;
+    server.setCoreName(config.getDefaultCoreName());
+    server.init(&config);
+
+    // one thread highlights the page alone, four split it in ranges of 25 results
+    WorkStealingThreadPool serialPool(1);
+    WorkStealingThreadPool parallelPool(4);
+    const char *uris[] = { "/search?q=apple&rows=100", "/search?q=appl*&rows=100" };
+    for (unsigned u = 0; u < sizeof(uris) / sizeof(uris[0]); ++u) {
+        vector<RecordSnippet> serialSnippets;
+        vector<RecordSnippet> parallelSnippets;
+        highlight(&server, uris[u], &serialPool, serialSnippets);
+        highlight(&server, uris[u], &parallelPool, parallelSnippets);
+
+        ASSERT(serialSnippets.size() == NUMBER_OF_RECORDS);
+        ASSERT(parallelSnippets.size() == serialSnippets.size());
+        for (unsigned i = 0; i < serialSnippets.size(); ++i) {
+            ASSERT(parallelSnippets[i].recordId == serialSnippets[i].recordId);
+            ASSERT(serialSnippets[i].fieldSnippets.size() == 2);
+            ASSERT(parallelSnippets[i].fieldSnippets.size() == serialSnippets[i].fieldSnippets.size());
+            for (unsigned j = 0; j < serialSnippets[i].fieldSnippets.size(); ++j) {
+                const AttributeSnippet &serial = serialSnippets[i].fieldSnippets[j];
+                const AttributeSnippet &parallel = parallelSnippets[i].fieldSnippets[j];
+                ASSERT(parallel.FieldId == serial.FieldId);
+                ASSERT(parallel.snippet == serial.snippet);
+                ASSERT(serial.snippet.size() > 0 && serial.snippet[0].find("<e>appl") != string::npos);
+            }
+        }
+    }
+    system((string("rm -rf ") + directory).c_str());
+    cout << "testSameSnippets(" << enableCharOffsetIndex << ") passed." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    testSameSnippets(false);
+    testSameSnippets(true);
+    return 0;
+}
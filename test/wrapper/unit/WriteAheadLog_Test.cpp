@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2016, SRCH2
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of the SRCH2 nor the
+ *      names of its contributors may be used to endorse or promote products
+ *      derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SRCH2 BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * This test case tests the write-ahead log of a core: entries that are made durable are
+ * replayed in order, a frame cut by a crash is dropped, a truncated log is empty,
+ * concurrent writers are all made durable by the group commit and apply their changes in
+ * the order of the log, and every writer of a batch whose write fails is told so.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include "util/Assert.h"
+#include "util/Logger.h"
+#include "WriteAheadLog.h"
+#include "json/json.h"
+
+using namespace std;
+using namespace srch2::instantsearch;
+using namespace srch2::util;
+namespace srch2http = srch2::httpwrapper;
+using srch2http::WriteAheadLog;
+using srch2http::WriteAheadLogScope;
+
+static const string directoryName = ".";
+
+static void collectEntry(vector<Json::Value> *entries, const Json::Value &entry) {
+    entries->push_back(entry);
+}
+
+static unsigned replayLog(vector<Json::Value> &entries) {
+    entries.clear();
+    WriteAheadLog writeAheadLog(directoryName);
+    ASSERT(writeAheadLog.isOpen());
+    return writeAheadLog.replay(boost::bind(&collectEntry, &entries, _1));
+}
+
+static Json::Value makeEntry(int id) {
+    Json::Value entry(Json::objectValue);
+    entry["op"] = "insert";
+    entry["id"] = id;
+    return entry;
+}
+
+static uint64_t appendEntry(WriteAheadLog &writeAheadLog, int id) {
+    return writeAheadLog.append(vector<Json::Value>(1, makeEntry(id)));
+}
+
+// entries appended and made durable are read back in order after reopening the log
+void testAppendAndReplay() {
+    {
+        WriteAheadLog writeAheadLog(directoryName);
+        ASSERT(writeAheadLog.isOpen());
+        writeAheadLog.truncate();
+        uint64_t lastSequenceNumber = 0;
+        for (int i = 0; i < 100; ++i)
+            lastSequenceNumber = appendEntry(writeAheadLog, i);
+        bool isDurable = writeAheadLog.waitUntilDurable(lastSequenceNumber);
+        ASSERT(isDurable);
+        ASSERT(writeAheadLog.getSizeInBytes() > 0);
+    }
+    vector<Json::Value> entries;
+    unsigned numberOfEntries = replayLog(entries);
+    ASSERT(numberOfEntries == 100);
+    for (int i = 0; i < 100; ++i)
+        ASSERT(entries[i]["id"].asInt() == i);
+    cout << "testAppendAndReplay passed." << endl;
+}
+
+// a frame cut in the middle is dropped and removed, the frames before it are kept
+void testTornTail() {
+    string filePath = directoryName + "/" + WriteAheadLog::fileName;
+    int fileDescriptor = open(filePath.c_str(), O_RDWR);
+    ASSERT(fileDescriptor >= 0);
+    off_t size = lseek(fileDescriptor, 0, SEEK_END);
+    int result = ftruncate(fileDescriptor, size - 3);
+    ASSERT(result == 0);
+    close(fileDescriptor);
+
+    vector<Json::Value> entries;
+    unsigned numberOfEntries = replayLog(entries);
+    ASSERT(numberOfEntries == 99);
+    ASSERT(entries[98]["id"].asInt() == 98);
+    // the damaged tail was removed, so new entries follow the last complete frame
+    {
+        WriteAheadLog writeAheadLog(directoryName);
+        bool isDurable = writeAheadLog.waitUntilDurable(appendEntry(writeAheadLog, 1000));
+        ASSERT(isDurable);
+    }
+    numberOfEntries = replayLog(entries);
+    ASSERT(numberOfEntries == 100);
+    ASSERT(entries[99]["id"].asInt() == 1000);
+    cout << "testTornTail passed." << endl;
+}
+
+void testTruncate() {
+    {
+        WriteAheadLog writeAheadLog(directoryName);
+        writeAheadLog.truncate();
+        ASSERT(writeAheadLog.getSizeInBytes() == 0);
+    }
+    vector<Json::Value> entries;
+    unsigned numberOfEntries = replayLog(entries);
+    ASSERT(numberOfEntries == 0);
+    cout << "testTruncate passed." << endl;
+}
+
+// the ids of the entries in the order in which their changes were "applied"
+static vector<int> appliedIds;
+static boost::mutex appliedIdsMutex;
+
+static void writeEntries(WriteAheadLog *writeAheadLog, int threadId, unsigned numberOfEntries) {
+    for (unsigned i = 0; i < numberOfEntries; ++i) {
+        WriteAheadLogScope writeAheadLogScope(writeAheadLog);
+        int id = threadId * numberOfEntries + i;
+        writeAheadLogScope.append(makeEntry(id));
+        bool isDurable = writeAheadLogScope.commit();
+        ASSERT(isDurable);
+        boost::unique_lock<boost::mutex> lock(appliedIdsMutex);
+        appliedIds.push_back(id);
+    }
+}
+
+// every entry of concurrent writers is durable once its request commits, and the changes are
+// applied in the order of the entries in the log
+void testConcurrentGroupCommit() {
+    const int numberOfThreads = 8;
+    const unsigned numberOfEntries = 50;
+    appliedIds.clear();
+    {
+        WriteAheadLog writeAheadLog(directoryName);
+        writeAheadLog.truncate();
+        boost::thread_group threads;
+        for (int t = 0; t < numberOfThreads; ++t)
+            threads.create_thread(boost::bind(&writeEntries, &writeAheadLog, t, numberOfEntries));
+        threads.join_all();
+    }
+    vector<Json::Value> entries;
+    unsigned numberOfReplayedEntries = replayLog(entries);
+    ASSERT(numberOfReplayedEntries == numberOfThreads * numberOfEntries);
+    ASSERT(appliedIds.size() == entries.size());
+    vector<bool> seen(numberOfThreads * numberOfEntries, false);
+    for (unsigned i = 0; i < entries.size(); ++i) {
+        seen[entries[i]["id"].asInt()] = true;
+        ASSERT(entries[i]["id"].asInt() == appliedIds[i]);
+    }
+    for (unsigned i = 0; i < seen.size(); ++i)
+        ASSERT(seen[i]);
+    cout << "testConcurrentGroupCommit passed." << endl;
+}
+
+static void writeEntriesToFullDevice(WriteAheadLog *writeAheadLog, int threadId, unsigned numberOfEntries) {
+    for (unsigned i = 0; i < numberOfEntries; ++i) {
+        WriteAheadLogScope writeAheadLogScope(writeAheadLog);
+        writeAheadLogScope.append(makeEntry(threadId * numberOfEntries + i));
+        bool isDurable = writeAheadLogScope.commit();
+        ASSERT(!isDurable);
+    }
+}
+
+// the log file is /dev/full, where every write fails: no writer of a failed batch is told that
+// its entries are durable, including the writers whose entries were written by another thread
+void testFailedGroupCommit() {
+    char directory[] = "/tmp/WriteAheadLog_TestXXXXXX";
+    ASSERT(mkdtemp(directory) != NULL);
+    string filePath = string(directory) + "/" + WriteAheadLog::fileName;
+    int result = symlink("/dev/full", filePath.c_str());
+    ASSERT(result == 0);
+    {
+        WriteAheadLog writeAheadLog(directory);
+        ASSERT(writeAheadLog.isOpen());
+        boost::thread_group threads;
+        for (int t = 0; t < 8; ++t)
+            threads.create_thread(boost::bind(&writeEntriesToFullDevice, &writeAheadLog, t, 20));
+        threads.join_all();
+        ASSERT(writeAheadLog.getSizeInBytes() == 0);
+    }
+    unlink(filePath.c_str());
+    rmdir(directory);
+    cout << "testFailedGroupCommit passed." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    testAppendAndReplay();
+    testTornTail();
+    testTruncate();
+    testConcurrentGroupCommit();
+    testFailedGroupCommit();
+
+    unlink((directoryName + "/" + WriteAheadLog::fileName).c_str());
+    return 0;
+}